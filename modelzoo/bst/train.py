@@ -74,6 +74,7 @@ class BST():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_attention=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -92,6 +93,7 @@ class BST():
         self.bf16 = False if self.tf else bf16
         self.is_training = True
         self._adaptive_emb = adaptive_emb
+        self._fused_attention = fused_attention and not self.bf16
 
         self._final_hidden_units = final_hidden_units
         self._max_seqence_length = max_seqence_length
@@ -146,6 +148,22 @@ class BST():
                                         activation=tf.nn.relu,
                                         name=name + '_value')
 
+            if self._fused_attention:
+                # only mask the cur_seq_len part, see below
+                hist_mask = tf.sequence_mask(seq_len, maxlen=seq_size - 1)
+                cur_id_mask = tf.ones([tf.shape(hist_mask)[0], 1],
+                                      dtype=tf.bool)
+                mask = tf.concat([cur_id_mask, hist_mask], axis=1)
+                att_res_net = tf.nn.multi_head_attention(query_net,
+                                                         key_net,
+                                                         value_net,
+                                                         head_count,
+                                                         key_mask=mask)
+                return tf.layers.dense(att_res_net,
+                                       units=emb_dim,
+                                       activation=tf.nn.relu,
+                                       name='multi_head_attention')
+
             query_net = tf.concat(tf.split(query_net, head_count, axis=-1),
                                   axis=0)
             key_net = tf.concat(tf.split(key_net, head_count, axis=-1), axis=0)
@@ -793,6 +811,7 @@ def main(tf_config=None, server=None):
                 bf16=args.bf16,
                 stock_tf=args.tf,
                 adaptive_emb=args.adaptive_emb,
+                fused_attention=args.fused_attention and not args.tf,
                 inputs=next_element,
                 input_layer_partitioner=input_layer_partitioner,
                 dense_layer_partitioner=dense_layer_partitioner)
@@ -919,6 +938,10 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_attention', \
+                        help='Whether to compute the multi-head attention with the fused MultiHeadAttention op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
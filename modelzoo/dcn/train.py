@@ -105,6 +105,7 @@ class DCN():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_cross=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -120,6 +121,8 @@ class DCN():
         self.bf16 = False if self.tf else bf16
         self.is_training = True
         self._adaptive_emb = adaptive_emb
+        # CrossNetwork only supports float32.
+        self._fused_cross = fused_cross and not self.tf and not self.bf16
 
         self._dnn_hidden_units = dnn_hidden_units
         self._deep_learning_rate = deep_learning_rate
@@ -159,6 +162,7 @@ class DCN():
         # add diag_scale
         x = x0 = cross_input
         last_dim = cross_input.shape[-1]
+        kernels, biases = [], []
 
         for layer_id in range(layer_num):
             with tf.variable_scope(layer_name + '_%d' % layer_id,
@@ -170,10 +174,16 @@ class DCN():
                     shape=(last_dim),
                 )
                 b = tf.get_variable(name=layer_name+'_b', dtype=cross_input.dtype, shape=(last_dim))
-                xw = tf.reduce_sum(x * w, axis=1, keepdims=True)
-                x = tf.math.add(tf.math.add(x0 * xw, b), x)
+                if self._fused_cross:
+                    kernels.append(w)
+                    biases.append(b)
+                else:
+                    xw = tf.reduce_sum(x * w, axis=1, keepdims=True)
+                    x = tf.math.add(tf.math.add(x0 * xw, b), x)
 
                 self._add_layer_summary(cross_input, cross_layer_scope.name)
+        if self._fused_cross:
+            x = tf.nn.cross_network(x0, kernels, biases)
         return x
 
     # create model
@@ -773,6 +783,7 @@ def main(tf_config=None, server=None):
                 bf16=args.bf16,
                 stock_tf=args.tf,
                 adaptive_emb=args.adaptive_emb,
+                fused_cross=args.fused_cross,
                 inputs=next_element,
                 input_layer_partitioner=input_layer_partitioner,
                 dense_layer_partitioner=dense_layer_partitioner)
@@ -895,6 +906,10 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_cross',
+                        help='Whether to compute the cross network with the fused CrossNetwork op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
@@ -109,6 +109,7 @@ class DCN():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_cross=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -124,6 +125,8 @@ class DCN():
         self.bf16 = False if self.tf else bf16
         self.is_training = True
         self._adaptive_emb = adaptive_emb
+        # CrossNetworkV2 only supports float32.
+        self._fused_cross = fused_cross and not self.tf and not self.bf16
 
         self._projection_dim = projection_dim
 
@@ -161,7 +164,45 @@ class DCN():
                 self._add_layer_summary(dnn_input, dnn_layer_scope.name)
         return dnn_input
 
+    # the variables of tf.layers.dense, for the fused cross network
+    def _dense_variables(self, input_dim, units, layers, name=None):
+        with tf.variable_scope(name, default_name='dense'):
+            layers[0].append(tf.get_variable(
+                'kernel',
+                shape=(input_dim, units),
+                initializer=tf.glorot_uniform_initializer()))
+            layers[1].append(tf.get_variable(
+                'bias', shape=(units), initializer=tf.zeros_initializer()))
+
+    def _fused_cross_net(self, cross_input, layer_num=2, layer_name=''):
+        last_dim = cross_input.shape[-1]
+        dense_layers = ([], [])
+        projection_layers = ([], [])
+        for layer_id in range(layer_num):
+            with tf.variable_scope(layer_name + '_%d' % layer_id,
+                                   partitioner=self._dense_layer_partitioner,
+                                   reuse=tf.AUTO_REUSE) as cross_layer_scope:
+                if self._projection_dim is None:
+                    self._dense_variables(last_dim, last_dim, dense_layers,
+                                          name=cross_layer_scope)
+                else:
+                    self._dense_variables(last_dim, self._projection_dim,
+                                          projection_layers)
+                    self._dense_variables(self._projection_dim, last_dim,
+                                          dense_layers)
+        cross_input = tf.nn.cross_network_v2(
+            cross_input,
+            dense_layers[0],
+            dense_layers[1],
+            projection_kernels=projection_layers[0],
+            projection_biases=projection_layers[1],
+            input_residual=True)
+        self._add_layer_summary(cross_input, cross_layer_scope.name)
+        return cross_input
+
     def _cross_net(self, cross_input, layer_num=2, layer_name=''):
+        if self._fused_cross:
+            return self._fused_cross_net(cross_input, layer_num, layer_name)
         # add diag_scale
         x = cross_input
         print("input", cross_input)
@@ -809,6 +850,7 @@ def main(tf_config=None, server=None):
                 bf16=args.bf16,
                 stock_tf=args.tf,
                 adaptive_emb=args.adaptive_emb,
+                fused_cross=args.fused_cross,
                 inputs=next_element,
                 input_layer_partitioner=input_layer_partitioner,
                 dense_layer_partitioner=dense_layer_partitioner)
@@ -935,6 +977,10 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_cross',
+                        help='Whether to compute the cross network with the fused CrossNetworkV2 op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
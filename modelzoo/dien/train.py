@@ -40,6 +40,9 @@ NEG_COLUMNS = ['NOCLK_HISTORY_ITEM', 'NOCLK_HISTORY_CATEGORY']
 SEQ_COLUMNS = HIS_COLUMNS + NEG_COLUMNS
 LABEL_COLUMN = ['CLICKED']
 TRAIN_DATA_COLUMNS = LABEL_COLUMN + UNSEQ_COLUMNS + SEQ_COLUMNS
+# Added to the features by the length-bucketing input pipeline
+SEQ_MASK_COLUMN = 'SEQ_MASK'
+SEQ_LENGTH_COLUMN = 'SEQ_LENGTH'
 
 EMBEDDING_DIM = 18
 HIDDEN_SIZE = 18 * 2
@@ -126,6 +129,9 @@ class DIEN():
                  dynamic_ev=None,
                  ev_opt=None,
                  multihash=None,
+                 fused_gru=False,
+                 dice=False,
+                 fused_dice=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -134,6 +140,8 @@ class DIEN():
             raise ValueError('Dense column or sparse column is not defined.')
         self._feature = inputs[0]
         self._label = inputs[1]
+        self._sequence_mask = self._feature.pop(SEQ_MASK_COLUMN, None)
+        self._sequence_length = self._feature.pop(SEQ_LENGTH_COLUMN, None)
 
         self._uid_emb_column = feature_column['uid_emb_column']
         self._item_cate_column = feature_column['item_cate_column']
@@ -157,6 +165,9 @@ class DIEN():
         self._dynamic_ev = dynamic_ev
         self._ev_opt = ev_opt
         self._multihash = multihash
+        self._fused_gru = fused_gru and not self.bf16
+        self._use_dice = dice
+        self._fused_dice = dice and fused_dice and not self.bf16
 
         self._learning_rate = learning_rate
         self._optimizer_type = optimizer_type
@@ -323,13 +334,29 @@ class DIEN():
             return output, scores
         return output
 
+    def _dice(self, x, name):
+        '''Dice activation, with the statistics of the batch'''
+        with tf.variable_scope(name, reuse=tf.AUTO_REUSE):
+            alpha = tf.get_variable('alpha', [x.get_shape()[-1]],
+                                    initializer=tf.constant_initializer(0.0),
+                                    dtype=x.dtype)
+        if self._fused_dice:
+            return tf.nn.dice(x, alpha)
+        epsilon = 1e-9
+        mean = tf.reduce_mean(x, axis=0)
+        std = tf.sqrt(tf.reduce_mean(tf.square(x - mean) + epsilon, axis=0))
+        p = tf.sigmoid((x - mean) / (std + epsilon))
+        return alpha * (1.0 - p) * x + p * x
+
     def _top_fc_layer(self, inputs):
         bn1 = tf.layers.batch_normalization(inputs=inputs, name='bn1')
         dnn1 = tf.layers.dense(bn1, 200, activation=None, name='dnn1')
-        dnn1 = tf.nn.relu(dnn1)
+        dnn1 = self._dice(dnn1, 'dice_1') if self._use_dice \
+            else tf.nn.relu(dnn1)
 
         dnn2 = tf.layers.dense(dnn1, 80, activation=None, name='dnn2')
-        dnn2 = tf.nn.relu(dnn2)
+        dnn2 = self._dice(dnn2, 'dice_2') if self._use_dice \
+            else tf.nn.relu(dnn2)
 
         dnn3 = tf.layers.dense(dnn2, 2, activation=None, name='dnn3')
         logits = tf.layers.dense(dnn3, 1, activation=None, name='logits')
@@ -368,6 +395,16 @@ class DIEN():
 
     def _embedding_input_layer(self):
         for key in SEQ_COLUMNS:
+            if self._sequence_mask is not None:
+                # Already split and padded by the length-bucketing input
+                # pipeline, only the positions valid in the mask are kept.
+                # The negative sequences are aligned with the history.
+                padded = self._feature[key]
+                self._feature[key] = tf.SparseTensor(
+                    indices=tf.where(self._sequence_mask),
+                    values=tf.boolean_mask(padded, self._sequence_mask),
+                    dense_shape=tf.shape(padded, out_type=tf.int64))
+                continue
             self._feature[key] = tf.strings.split(self._feature[key], '')
             self._feature[key] = tf.sparse.slice(
                 self._feature[key], [0, 0], [self._batch_size, MAX_SEQ_LENGTH])
@@ -454,7 +491,11 @@ class DIEN():
         ]
         his_item_emb = tf.concat([his_item_embedding, his_category_embedding],
                                  2)
-        sequence_length = self._assert_all_equal_and_return(sequence_lengths)
+        if self._sequence_length is not None:
+            sequence_length = self._sequence_length
+        else:
+            sequence_length = self._assert_all_equal_and_return(
+                sequence_lengths)
 
         # get negative samples item embedding
         noclk_his_item_embedding = self._get_embedding_input(
@@ -468,6 +509,29 @@ class DIEN():
 
         return uid_emb, item_emb, his_item_emb, noclk_his_item_emb, sequence_length
 
+    def _gru_sequence(self, inputs, sequence_length, att_scores=None):
+        '''GRU over the sequences with the fused GRUSequence op, or AUGRU with
+        att_scores, with the variables of GRUCell and VecAttGRUCell'''
+        input_size = inputs.get_shape()[-1].value
+        units = self._hidden_size
+        with tf.variable_scope('gates'):
+            gate_kernel = tf.get_variable('kernel',
+                                          [input_size + units, 2 * units])
+            gate_bias = tf.get_variable(
+                'bias', [2 * units], initializer=tf.constant_initializer(1.0))
+        with tf.variable_scope('candidate'):
+            candidate_kernel = tf.get_variable('kernel',
+                                               [input_size + units, units])
+            candidate_bias = tf.get_variable(
+                'bias', [units], initializer=tf.zeros_initializer())
+        return tf.nn.gru_sequence(inputs,
+                                  gate_kernel,
+                                  gate_bias,
+                                  candidate_kernel,
+                                  candidate_bias,
+                                  sequence_length=sequence_length,
+                                  att_scores=att_scores)
+
     # create model
     def _create_model(self):
         # input layer to get embedding of features
@@ -484,16 +548,24 @@ class DIEN():
                 noclk_his_item_emb = tf.cast(noclk_his_item_emb, tf.bfloat16)
 
             item_his_eb_sum = tf.reduce_sum(his_item_emb, 1)
-            mask = tf.sequence_mask(sequence_length)
+            if self._sequence_mask is not None:
+                mask = self._sequence_mask
+            else:
+                mask = tf.sequence_mask(sequence_length)
 
         # RNN layer_1
         with tf.variable_scope('rnn_1'):
-            run_output_1, _ = tf.nn.dynamic_rnn(
-                tf.nn.rnn_cell.GRUCell(self._hidden_size),
-                inputs=his_item_emb,
-                sequence_length=sequence_length,
-                dtype=self._data_type,
-                scope='gru1')
+            if self._fused_gru:
+                with tf.variable_scope('gru1/gru_cell'):
+                    run_output_1, _ = self._gru_sequence(
+                        his_item_emb, sequence_length)
+            else:
+                run_output_1, _ = tf.nn.dynamic_rnn(
+                    tf.nn.rnn_cell.GRUCell(self._hidden_size),
+                    inputs=his_item_emb,
+                    sequence_length=sequence_length,
+                    dtype=self._data_type,
+                    scope='gru1')
             tf.summary.histogram('GRU_outputs', run_output_1)
 
         # Aux loss
@@ -526,12 +598,17 @@ class DIEN():
 
         # RNN layer_2
         with tf.variable_scope('rnn_2'):
-            _, final_state2 = tf.nn.dynamic_rnn(
-                VecAttGRUCell(self._hidden_size),
-                inputs=[run_output_1, tf.expand_dims(alphas, -1)],
-                sequence_length=sequence_length,
-                dtype=self._data_type,
-                scope='gru2')
+            if self._fused_gru:
+                with tf.variable_scope('gru2'):
+                    _, final_state2 = self._gru_sequence(
+                        run_output_1, sequence_length, att_scores=alphas)
+            else:
+                _, final_state2 = tf.nn.dynamic_rnn(
+                    VecAttGRUCell(self._hidden_size),
+                    inputs=[run_output_1, tf.expand_dims(alphas, -1)],
+                    sequence_length=sequence_length,
+                    dtype=self._data_type,
+                    scope='gru2')
             tf.summary.histogram('GRU2_Final_State', final_state2)
 
         top_input = tf.concat([
@@ -621,6 +698,15 @@ def build_model_input(filename, neg_filename, batch_size, num_epochs):
         features = all_columns
         return features, labels
 
+    def parse_csv_sequence(value, neg_value):
+        # Parses a single sample and splits its behavior sequences, so that
+        # samples can be batched by sequence length.
+        features, labels = parse_csv(value, neg_value)
+        for key in SEQ_COLUMNS:
+            features[key] = tf.strings.split([features[key]],
+                                             '\x02').values[:MAX_SEQ_LENGTH]
+        return features, labels
+
     def parse_parquet(value, neg_value):
         tf.logging.info('Parsing {}'.format(filename))
         value.update(neg_value)
@@ -662,9 +748,28 @@ def build_model_input(filename, neg_filename, batch_size, num_epochs):
                                   seed=args.seed)  # set seed for reproducing
         if not args.workqueue:
             dataset = dataset.repeat(num_epochs)
-        dataset = dataset.batch(batch_size)
-        dataset = dataset.map(parse_csv,
-                              num_parallel_calls=tf.data.experimental.AUTOTUNE)
+        if args.bucket_by_length and not args.tf:
+            '''Bucket samples by behavior sequence length'''
+            from tensorflow.python.data.experimental.ops import grouping
+            dataset = dataset.map(parse_csv_sequence,
+                                  num_parallel_calls=tf.data.experimental.AUTOTUNE)
+            boundaries = list(range(10, MAX_SEQ_LENGTH, 10))
+            dataset = dataset.apply(
+                grouping.bucket_by_sequence_length_with_mask(
+                    (0, HIS_COLUMNS[0]), boundaries,
+                    [batch_size] * (len(boundaries) + 1)))
+            def add_mask(batch, mask, lengths):
+                features, labels = batch
+                features = collections.OrderedDict(features)
+                features[SEQ_MASK_COLUMN] = mask
+                features[SEQ_LENGTH_COLUMN] = lengths
+                return features, labels
+
+            dataset = dataset.map(add_mask)
+        else:
+            dataset = dataset.batch(batch_size)
+            dataset = dataset.map(parse_csv,
+                                  num_parallel_calls=tf.data.experimental.AUTOTUNE)
     dataset = dataset.prefetch(2)
     return dataset
 
@@ -972,6 +1077,9 @@ def main(tf_config=None, server=None):
                  ev_opt=ev_opt,
                  inputs=next_element,
                  multihash=args.multihash,
+                 fused_gru=args.fused_gru and not args.tf,
+                 dice=args.dice,
+                 fused_dice=args.fused_dice and not args.tf,
                  input_layer_partitioner=input_layer_partitioner,
                  dense_layer_partitioner=dense_layer_partitioner)
 
@@ -1093,6 +1201,18 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_gru', \
+                        help='Whether to run the GRU and AUGRU layers with the fused GRUSequence ops. Default to False.',
+                        type=boolean_string,
+                        default=False)
+    parser.add_argument('--dice', \
+                        help='Whether to use the Dice activation instead of ReLU in the top MLP. Default to False.',
+                        type=boolean_string,
+                        default=False)
+    parser.add_argument('--fused_dice', \
+                        help='Whether to compute Dice with the fused DiceTraining op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
@@ -1125,6 +1245,10 @@ def get_arg_parser():
                         help='Whether to enable shuffle operation for Parquet Dataset. Default to False.',
                         type=boolean_string,
                         default=False)
+    parser.add_argument("--bucket_by_length", \
+                        help='Whether to batch CSV samples of similar behavior sequence length together. Default to False.',
+                        type=boolean_string,
+                        default=False)
     return parser
 
 
@@ -66,6 +66,9 @@ class DIN():
                  dynamic_ev=None,
                  ev_opt=None,
                  multihash=None,
+                 fused_attention=False,
+                 dice=False,
+                 fused_dice=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -93,6 +96,9 @@ class DIN():
         self._dynamic_ev = dynamic_ev
         self._ev_opt = ev_opt
         self._multihash = multihash
+        self._fused_attention = fused_attention and not self.bf16
+        self._use_dice = dice
+        self._fused_dice = dice and fused_dice and not self.bf16
 
         self._learning_rate = learning_rate
         self._optimizer_type = optimizer_type
@@ -169,6 +175,14 @@ class DIN():
                                 activation=None,
                                 name='f1' + stag)
         query = self._prelu(query)
+        if self._fused_attention and mode == 'SUM' and softmax_stag \
+            and not forCnn:
+            output, scores = tf.nn.din_attention(
+                query, facts, mask,
+                *self._attention_weights(4 * facts_size, stag))
+            if return_alphas:
+                return output, scores
+            return output
         queries = tf.tile(query, [1, tf.shape(facts)[1]])
         queries = tf.reshape(queries, tf.shape(facts))
         din_all = tf.concat([queries, facts, queries - facts, queries * facts],
@@ -213,13 +227,43 @@ class DIN():
             return output, scores
         return output
 
+    def _attention_weights(self, input_size, stag):
+        '''variables of the attention layers, named as by tf.layers.dense'''
+        weights = []
+        for name, units in [('f1_att', 80), ('f2_att', 40), ('f3_att', 1)]:
+            with tf.variable_scope(name + stag):
+                weights.append(
+                    tf.get_variable('kernel', [input_size, units],
+                                    initializer=tf.glorot_uniform_initializer()))
+                weights.append(
+                    tf.get_variable('bias', [units],
+                                    initializer=tf.zeros_initializer()))
+            input_size = units
+        return weights
+
+    def _dice(self, x, name):
+        '''Dice activation, with the statistics of the batch'''
+        with tf.variable_scope(name, reuse=tf.AUTO_REUSE):
+            alpha = tf.get_variable('alpha', [x.get_shape()[-1]],
+                                    initializer=tf.constant_initializer(0.0),
+                                    dtype=x.dtype)
+        if self._fused_dice:
+            return tf.nn.dice(x, alpha)
+        epsilon = 1e-9
+        mean = tf.reduce_mean(x, axis=0)
+        std = tf.sqrt(tf.reduce_mean(tf.square(x - mean) + epsilon, axis=0))
+        p = tf.sigmoid((x - mean) / (std + epsilon))
+        return alpha * (1.0 - p) * x + p * x
+
     def _top_fc_layer(self, inputs):
         bn1 = tf.layers.batch_normalization(inputs=inputs, name='bn1')
         dnn1 = tf.layers.dense(bn1, 200, activation=None, name='dnn1')
-        dnn1 = tf.nn.relu(dnn1)
+        dnn1 = self._dice(dnn1, 'dice_1') if self._use_dice \
+            else tf.nn.relu(dnn1)
 
         dnn2 = tf.layers.dense(dnn1, 80, activation=None, name='dnn2')
-        dnn2 = tf.nn.relu(dnn2)
+        dnn2 = self._dice(dnn2, 'dice_2') if self._use_dice \
+            else tf.nn.relu(dnn2)
 
         dnn3 = tf.layers.dense(dnn2, 2, activation=None, name='dnn3')
         logits = tf.layers.dense(dnn3, 1, activation=None, name='logits')
@@ -784,6 +828,9 @@ def main(tf_config=None, server=None):
                 ev_opt=ev_opt,
                 inputs=next_element,
                 multihash=args.multihash,
+                fused_attention=args.fused_attention and not args.tf,
+                dice=args.dice,
+                fused_dice=args.fused_dice and not args.tf,
                 input_layer_partitioner=input_layer_partitioner,
                 dense_layer_partitioner=dense_layer_partitioner)
 
@@ -905,6 +952,18 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_attention', \
+                        help='Whether to compute the attention layer with the fused DinAttention op. Default to False.',
+                        type=boolean_string,
+                        default=False)
+    parser.add_argument('--dice', \
+                        help='Whether to use the Dice activation instead of ReLU in the top MLP. Default to False.',
+                        type=boolean_string,
+                        default=False)
+    parser.add_argument('--fused_dice', \
+                        help='Whether to compute Dice with the fused DiceTraining op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
@@ -78,6 +78,7 @@ class DLRM():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_interaction=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -94,6 +95,7 @@ class DLRM():
         self.bf16 = False if self.tf else bf16
         self.is_training = True
         self._adaptive_emb = adaptive_emb
+        self._fused_interaction = fused_interaction and not self.tf
 
         self._mlp_bot = mlp_bot
         self._mlp_top = mlp_top
@@ -195,8 +197,12 @@ class DLRM():
                 for cols in self._sparse_column:
                     mlp_input.append(column_tensors[cols])
                 mlp_input = tf.stack(mlp_input, axis=1)
-                mlp_input = self._dot_op(mlp_input)
-                mlp_input = tf.concat([dense_inputs, mlp_input], 1)
+                if self._fused_interaction:
+                    mlp_input = tf.nn.dot_interaction(mlp_input,
+                                                      dense=dense_inputs)
+                else:
+                    mlp_input = self._dot_op(mlp_input)
+                    mlp_input = tf.concat([dense_inputs, mlp_input], 1)
         elif self.interaction_op == 'cat':
             mlp_input = tf.concat([dense_inputs, sparse_inputs], 1)
 
@@ -689,6 +695,7 @@ def main(tf_config=None, server=None):
                  stock_tf=args.tf,
                  adaptive_emb=args.adaptive_emb,
                  interaction_op=args.interaction_op,
+                 fused_interaction=args.fused_interaction,
                  inputs=next_element,
                  input_layer_partitioner=input_layer_partitioner,
                  dense_layer_partitioner=dense_layer_partitioner)
@@ -818,6 +825,10 @@ def get_arg_parser():
                         help='Whether to enable Auto graph fusion feature. Default to True',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_interaction',
+                        help='Whether to compute the dot interaction with the fused DotInteraction op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--micro_batch',
                         help='Set num for Auto Mirco Batch. Default close.',
                         type=int,
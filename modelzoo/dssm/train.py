@@ -20,6 +20,7 @@ import os
 import sys
 import math
 import collections
+import numpy as np
 from tensorflow.python.client import timeline
 import json
 
@@ -179,6 +180,12 @@ class DSSM():
                 item_emb = tf.feature_column.input_layer(
                     self._feature, self._item_column)
 
+        # the item ids, to retrieve the items from an ANN index
+        item_id = self._feature['adgroup_id']
+        if item_id.dtype == tf.string:
+            item_id = tf.strings.to_number(item_id, out_type=tf.int64)
+        self.item_id = tf.cast(tf.reshape(item_id, [-1]), tf.int64)
+
         if self.bf16:
             user_emb = tf.cast(user_emb, dtype=tf.bfloat16)
             item_emb = tf.cast(item_emb, dtype=tf.bfloat16)
@@ -206,6 +213,8 @@ class DSSM():
         # norm
         user_emb = tf.math.l2_normalize(user_emb, axis=1)
         item_emb = tf.math.l2_normalize(item_emb, axis=1)
+        self.user_emb = user_emb
+        self.item_emb = item_emb
 
         user_item_sim = tf.reduce_sum(tf.multiply(user_emb, item_emb),
                                       axis=1,
@@ -263,6 +272,30 @@ class DSSM():
         tf.summary.scalar('eval_auc', self.auc)
 
 
+# top-k retrieval of the items from an ANN index of their embeddings
+class Retrieval():
+    def __init__(self, model, index_type, top_k, probe):
+        dim = int(model.item_emb.shape[-1])
+        self.top_k = top_k
+        # the catalog, the items of the test data
+        self.item_ids = tf.placeholder(tf.int64, [None], name='catalog_ids')
+        self.item_embs = tf.placeholder(tf.float32, [None, dim],
+                                        name='catalog_embs')
+        if index_type == 'hnsw':
+            index = tf.nn.hnsw_index(dim, shared_name='dssm_items')
+        else:
+            index = tf.nn.ivf_pq_index(dim, shared_name='dssm_items')
+        self.update = tf.nn.ann_index_update(index, self.item_ids,
+                                             self.item_embs)
+        _, self.ann_ids = tf.nn.ann_index_search(index, model.user_emb,
+                                                 top_k, probe=probe)
+        # brute force, to measure the recall of the index
+        k = tf.minimum(top_k, tf.shape(self.item_ids)[0])
+        _, top = tf.math.top_k(
+            tf.matmul(model.user_emb, self.item_embs, transpose_b=True), k)
+        self.exact_ids = tf.gather(self.item_ids, top)
+
+
 # generate dataset pipline
 def build_model_input(filename, batch_size, num_epochs):
     def parse_csv(value):
@@ -550,6 +583,59 @@ def eval(sess_config, input_hooks, model, data_init_op, steps, checkpoint_dir):
                 print("ACC = {}\nAUC = {}".format(eval_acc, eval_auc))
 
 
+def retrieval_eval(sess_config, input_hooks, model, retrieval, data_init_op,
+                   steps, checkpoint_dir):
+    model.is_training = False
+    hooks = []
+    hooks.extend(input_hooks)
+
+    scaffold = tf.train.Scaffold(
+        local_init_op=tf.group(tf.local_variables_initializer(), data_init_op))
+    session_creator = tf.train.ChiefSessionCreator(
+        scaffold=scaffold, checkpoint_dir=checkpoint_dir, config=sess_config)
+
+    with tf.train.MonitoredSession(session_creator=session_creator,
+                                   hooks=hooks) as sess:
+        # embeddings of the items of the test data, the last one of an id wins
+        catalog = {}
+        for _in in range(steps):
+            ids, embs = sess.run([model.item_id, model.item_emb])
+            catalog.update(zip(ids, embs))
+        catalog_ids = np.array(list(catalog.keys()), dtype=np.int64)
+        catalog_embs = np.stack(list(catalog.values()))
+        feed_dict = {
+            retrieval.item_ids: catalog_ids,
+            retrieval.item_embs: catalog_embs
+        }
+        start = time.time()
+        num_updated = sess.run(retrieval.update, feed_dict=feed_dict)
+        print("Indexed {} items in {:.2f}s".format(num_updated,
+                                                  time.time() - start))
+
+        # the clicked items in the top-k of the index and of brute force
+        sess.run(data_init_op)
+        clicks = ann_hits = exact_hits = 0
+        overlap = []
+        for _in in range(steps):
+            labels, ids, ann_ids, exact_ids = sess.run(
+                [model._label, model.item_id, retrieval.ann_ids,
+                 retrieval.exact_ids],
+                feed_dict=feed_dict)
+            for label, item_id, ann, exact in zip(
+                    np.reshape(labels, [-1]), ids, ann_ids, exact_ids):
+                overlap.append(
+                    len(set(ann) & set(exact)) / float(max(len(exact), 1)))
+                if label > 0:
+                    clicks += 1
+                    ann_hits += item_id in ann
+                    exact_hits += item_id in exact
+        print("Evaluation complete:[{}/{}]".format(steps, steps))
+    print("Retrieval Recall@{}: ANN = {}, brute force = {}".format(
+        retrieval.top_k, ann_hits / float(max(clicks, 1)),
+        exact_hits / float(max(clicks, 1))))
+    print("ANN overlap with brute force = {}".format(np.mean(overlap)))
+
+
 def main(tf_config=None, server=None):
     # check dataset and count data set size
     print("Checking dataset...")
@@ -661,12 +747,20 @@ def main(tf_config=None, server=None):
                  input_layer_partitioner=input_layer_partitioner,
                  dense_layer_partitioner=dense_layer_partitioner)
 
+    retrieval = None
+    if args.ann_index and not args.tf:
+        retrieval = Retrieval(model, args.ann_index, args.ann_top_k,
+                              args.ann_probe)
+
     # Run model training and evaluation
     train(sess_config, hooks, model, train_init_op, train_steps,
           checkpoint_dir, tf_config, server)
     if not (args.no_eval or tf_config):
         eval(sess_config, hooks, model, test_init_op, test_steps,
              checkpoint_dir)
+        if retrieval:
+            retrieval_eval(sess_config, hooks, model, retrieval, test_init_op,
+                           test_steps, checkpoint_dir)
 
 
 def boolean_string(string):
@@ -765,6 +859,19 @@ def get_arg_parser():
                         help='Whether to enable embedding fusion, Default to True.',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--ann_index', \
+                        help='Evaluate the top-k retrieval of the test items from an ANN index. Default closed.',
+                        type=str,
+                        choices=[None, 'hnsw', 'ivf_pq'],
+                        default=None)
+    parser.add_argument('--ann_top_k', \
+                        help='Number of items retrieved from the ANN index. Default to 100.',
+                        type=int,
+                        default=100)
+    parser.add_argument('--ann_probe', \
+                        help='Search breadth of the ANN index, ef of HNSW or lists probed of IVF-PQ. Default to 128.',
+                        type=int,
+                        default=128)
     parser.add_argument('--ev', \
                         help='Whether to enable DeepRec EmbeddingVariable. Default False.',
                         type=boolean_string,
@@ -108,6 +108,7 @@ class MaskNet():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_maskblock=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -128,6 +129,12 @@ class MaskNet():
         self.is_training = True
         self._adaptive_emb = adaptive_emb
         self.use_bn = use_bn
+        # the fused op has no batch normalization of the mask dnn
+        self._fused_maskblock = fused_maskblock and not self.bf16 \
+            and not self.use_bn
+        if fused_maskblock and self.use_bn:
+            print("Fused MaskBlock is not enabled with batch normalization.")
+            print("Please set --use_bn to False to use it.")
 
         self._dnn_hidden_units = dnn_hidden_units
         self._deep_learning_rate = deep_learning_rate
@@ -166,9 +173,41 @@ class MaskNet():
 
         return dnn_input
 
+    # MaskBlock as one MaskBlock op, only used without batch normalization.
+    # The variables are named as those of _maskblock.
+    def _fused_maskblock_layer(self, V_emb, V_hidden, hidden_dim, output_dim,
+                               reduction_ratio):
+        emb_dim = V_emb.shape[1]
+        aggregation_dim = hidden_dim * reduction_ratio
+        with tf.variable_scope('_0'):
+            aggregation_kernel = tf.get_variable(
+                'kernel', [emb_dim, aggregation_dim])
+            aggregation_bias = tf.get_variable(
+                'bias', [aggregation_dim], initializer=tf.zeros_initializer())
+        with tf.variable_scope('_1'):
+            projection_kernel = tf.get_variable(
+                'kernel', [aggregation_dim, hidden_dim])
+            projection_bias = tf.get_variable(
+                'bias', [hidden_dim], initializer=tf.zeros_initializer())
+        with tf.variable_scope('dense'):
+            output_kernel = tf.get_variable('kernel', [hidden_dim, output_dim])
+        # the layer gets the unique name of the graph, layer_normalization_N,
+        # and its weights as in its call
+        LN = tf.keras.layers.LayerNormalization()
+        with tf.name_scope(LN.name):
+            LN.build(tf.TensorShape([None, output_dim]))
+        return tf.nn.mask_block(V_emb, V_hidden, aggregation_kernel,
+                                aggregation_bias, projection_kernel,
+                                projection_bias, output_kernel, LN.gamma,
+                                LN.beta, epsilon=LN.epsilon)
+
     # Implement MaskBlock
     def _maskblock(self, V_emb, V_hidden, hidden_dim, output_dim, reduction_ratio=1, dropout_rate=0, layer_norm=True, index=None):
         with tf.variable_scope('mask_block' + str(index), default_name='mask_block', reuse=tf.AUTO_REUSE) as mask_block_scope:
+            if self._fused_maskblock:
+                return self._fused_maskblock_layer(
+                    V_emb, V_hidden, int(hidden_dim), output_dim,
+                    reduction_ratio)
             V_mask = self._dnn(dnn_input=V_emb, dnn_hidden_units=[
                                hidden_dim*reduction_ratio, hidden_dim])
             hidden_val = tf.layers.dense(V_mask * V_hidden, output_dim, use_bias=False)
@@ -710,6 +749,8 @@ def main(tf_config=None, server=None):
                     bf16=args.bf16,
                     stock_tf=args.tf,
                     adaptive_emb=args.adaptive_emb,
+                    use_bn=args.use_bn,
+                    fused_maskblock=args.fused_maskblock and not args.tf,
                     inputs=next_element,
                     input_layer_partitioner=input_layer_partitioner,
                     dense_layer_partitioner=dense_layer_partitioner)
@@ -863,6 +904,14 @@ def get_arg_parser():
                         help='Whether to enable shuffle operation for Parquet Dataset. Default to False.',
                         type=boolean_string,
                         default=False)
+    parser.add_argument('--use_bn', \
+                        help='Whether to normalize the mask dnn of MaskBlock by batch normalization. Default to True.',
+                        type=boolean_string,
+                        default=True)
+    parser.add_argument('--fused_maskblock', \
+                        help='Whether to run each MaskBlock as one fused MaskBlock op, requires --use_bn False. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument("--group_embedding", \
                         help='Whether to enable Group Embedding. Defualt to None.',
                         type=str,
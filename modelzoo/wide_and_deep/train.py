@@ -106,6 +106,7 @@ class WDL():
                  bf16=False,
                  stock_tf=None,
                  adaptive_emb=False,
+                 fused_concat_matmul=False,
                  input_layer_partitioner=None,
                  dense_layer_partitioner=None):
         if not inputs:
@@ -122,6 +123,7 @@ class WDL():
         self.bf16 = False if self.tf else bf16
         self.is_training = True
         self._adaptive_emb = adaptive_emb
+        self._fused_concat_matmul = fused_concat_matmul and not self.bf16
 
         self._dnn_hidden_units = dnn_hidden_units
         self._linear_learning_rate = linear_learning_rate
@@ -147,16 +149,30 @@ class WDL():
             with tf.variable_scope(layer_name + '_%d' % layer_id,
                                    partitioner=self._dense_layer_partitioner,
                                    reuse=tf.AUTO_REUSE) as dnn_layer_scope:
-                dnn_input = tf.layers.dense(
-                    dnn_input,
-                    units=num_hidden_units,
-                    activation=tf.nn.relu,
-                    kernel_initializer=tf.glorot_uniform_initializer(),
-                    name=dnn_layer_scope)
+                if isinstance(dnn_input, list):
+                    dnn_input = self._concat_dense(dnn_input,
+                                                   num_hidden_units)
+                else:
+                    dnn_input = tf.layers.dense(
+                        dnn_input,
+                        units=num_hidden_units,
+                        activation=tf.nn.relu,
+                        kernel_initializer=tf.glorot_uniform_initializer(),
+                        name=dnn_layer_scope)
 
                 self._add_layer_summary(dnn_input, dnn_layer_scope.name)
         return dnn_input
 
+    # dense layer of the concatenation of the inputs, as one ConcatMatMul op,
+    # with the variable names of tf.layers.dense
+    def _concat_dense(self, inputs, units):
+        depth = sum(int(input.shape[1]) for input in inputs)
+        kernel = tf.get_variable('kernel', [depth, units],
+                                 initializer=tf.glorot_uniform_initializer())
+        bias = tf.get_variable('bias', [units],
+                               initializer=tf.zeros_initializer())
+        return tf.nn.concat_matmul(inputs, kernel, bias, relu=True)
+
     # create model
     def _create_model(self):
         # Dnn part
@@ -165,6 +181,7 @@ class WDL():
             with tf.variable_scope('input_from_feature_columns',
                                    partitioner=self._input_layer_partitioner,
                                    reuse=tf.AUTO_REUSE):
+                cols_to_output_tensors = {}
                 if self._adaptive_emb and not self.tf:
                     '''Adaptive Embedding Feature Part 1 of 2'''
                     adaptive_mask_tensors = {}
@@ -174,12 +191,20 @@ class WDL():
                     net = tf.feature_column.input_layer(
                         features=self._feature,
                         feature_columns=self._deep_column,
+                        cols_to_output_tensors=cols_to_output_tensors,
                         adaptive_mask_tensors=adaptive_mask_tensors)
                 else:
                     net = tf.feature_column.input_layer(
                         features=self._feature,
-                        feature_columns=self._deep_column)
-                self._add_layer_summary(net, 'input_from_feature_columns')
+                        feature_columns=self._deep_column,
+                        cols_to_output_tensors=cols_to_output_tensors)
+                if self._fused_concat_matmul:
+                    # The columns in the order of their concatenation in net,
+                    # which is never computed.
+                    net = [cols_to_output_tensors[col] for col in sorted(
+                        self._deep_column, key=lambda col: col.name)]
+                else:
+                    self._add_layer_summary(net, 'input_from_feature_columns')
 
             # hidden layers
             dnn_scope = tf.variable_scope('dnn_layers', \
@@ -725,6 +750,7 @@ def main(tf_config=None, server=None):
                 bf16=args.bf16,
                 stock_tf=args.tf,
                 adaptive_emb=args.adaptive_emb,
+                fused_concat_matmul=args.fused_concat_matmul and not args.tf,
                 inputs=next_element,
                 input_layer_partitioner=input_layer_partitioner,
                 dense_layer_partitioner=dense_layer_partitioner)
@@ -833,6 +859,10 @@ def get_arg_parser():
                         help='Whether to enable embedding fusion, Default to True.',
                         type=boolean_string,
                         default=True)
+    parser.add_argument('--fused_concat_matmul', \
+                        help='Whether to compute the first hidden layer of the deep part with a fused ConcatMatMul op. Default to False.',
+                        type=boolean_string,
+                        default=False)
     parser.add_argument('--ev', \
                         help='Whether to enable DeepRec EmbeddingVariable. Default False.',
                         type=boolean_string,
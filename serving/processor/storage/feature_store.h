@@ -1,5 +1,6 @@
 #ifndef SERVING_PROCESSOR_STORAGE_FEATURE_STORE_H_
 #define SERVING_PROCESSOR_STORAGE_FEATURE_STORE_H_
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -93,6 +94,26 @@ class FeatureStore {
                             size_t bytes_per_key,            // sizeof(TKey)
                             size_t bytes_per_values,         // sizeof(TValue) * embedding*dim
                             size_t N) = 0;                   // embedding vocabulary size
+    // Write Store Sync in commands of at most `keys_per_command` keys,
+    // which a store may pipeline on its connection.
+    virtual Status BulkSet(uint64_t model_version,
+                           uint64_t feature2id,
+                           const char* const keys,
+                           const char* const values,
+                           size_t bytes_per_key,
+                           size_t bytes_per_values,
+                           size_t N,
+                           size_t keys_per_command) {
+      for (size_t i = 0; i < N; i += keys_per_command) {
+        size_t n = std::min(keys_per_command, N - i);
+        Status s = BatchSet(model_version, feature2id,
+                            keys + i * bytes_per_key,
+                            values + i * bytes_per_values,
+                            bytes_per_key, bytes_per_values, n);
+        if (!s.ok()) return s;
+      }
+      return Status::OK();
+    }
     // Read Store Async
     virtual Status BatchGetAsync(uint64_t model_version,     // model version
                                  uint64_t feature2id,        // featureID encode uint64
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "serving/processor/storage/feature_store_loader.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace processor {
+namespace {
+
+// The rows of one variable partition in the bundle data files.
+struct BulkLoadTensor {
+  const BulkLoadVariable* variable;
+  std::string name;
+  int64 num_rows = 0;
+  std::unique_ptr<RandomAccessFile> keys_file;
+  int64 keys_offset = 0;
+  std::unique_ptr<RandomAccessFile> values_file;
+  int64 values_offset = 0;
+};
+
+struct BulkLoadChunk {
+  const BulkLoadTensor* tensor;
+  int64 begin;
+  int64 num_rows;
+};
+
+Status AddTensor(BundleReader* reader, const BulkLoadVariable& variable,
+                 const std::string& name,
+                 std::vector<std::unique_ptr<BulkLoadTensor>>* tensors) {
+  const std::string tensor_key = strings::StrCat(name, "-keys");
+  const std::string tensor_value = strings::StrCat(name, "-values");
+  TensorShape key_shape, value_shape;
+  TF_RETURN_IF_ERROR(reader->LookupTensorShape(tensor_key, &key_shape));
+  TF_RETURN_IF_ERROR(reader->LookupTensorShape(tensor_value, &value_shape));
+  if (value_shape.dims() != 2 || value_shape.dim_size(1) != variable.dim_len) {
+    return errors::InvalidArgument(
+        "value_shape.dim_size(1) not equal the dim_len of ", name, ". ",
+        value_shape.DebugString(), " vs ", variable.dim_len);
+  }
+  if (key_shape.dim_size(0) != value_shape.dim_size(0)) {
+    return errors::DataLoss("Keys and values of ", name,
+                            " have different row counts. ",
+                            key_shape.dim_size(0), " vs ",
+                            value_shape.dim_size(0));
+  }
+
+  std::unique_ptr<BulkLoadTensor> tensor(new BulkLoadTensor);
+  tensor->variable = &variable;
+  tensor->name = name;
+  tensor->num_rows = key_shape.dim_size(0);
+  if (tensor->num_rows == 0) {
+    LOG(WARNING) << "Current variable partitions' key num is 0. " << name;
+    return Status::OK();
+  }
+  // The data files are read directly, the bundle reader isn't thread safe.
+  int64 size = 0;
+  TF_RETURN_IF_ERROR(reader->GetTensorInfo(
+      tensor_key, &size, &tensor->keys_file, &tensor->keys_offset));
+  if (size != tensor->num_rows * variable.key_size) {
+    return errors::DataLoss("Unexpected size of ", tensor_key, ": ", size);
+  }
+  TF_RETURN_IF_ERROR(reader->GetTensorInfo(
+      tensor_value, &size, &tensor->values_file, &tensor->values_offset));
+  if (size != tensor->num_rows * variable.dim_len * variable.value_size) {
+    return errors::DataLoss("Unexpected size of ", tensor_value, ": ", size);
+  }
+  tensors->push_back(std::move(tensor));
+  return Status::OK();
+}
+
+// Resolves `variable` or its partitions `variable`/part_<i>, as KvImport.
+Status AddVariable(BundleReader* reader, const BulkLoadVariable& variable,
+                   std::vector<std::unique_ptr<BulkLoadTensor>>* tensors) {
+  TensorShape key_shape;
+  Status s = reader->LookupTensorShape(
+      strings::StrCat(variable.tensor_name, "-keys"), &key_shape);
+  if (s.ok()) {
+    return AddTensor(reader, variable, variable.tensor_name, tensors);
+  }
+  if (!errors::IsNotFound(s)) return s;
+
+  const std::string part_name = strings::StrCat(variable.tensor_name, "/part_");
+  TF_RETURN_IF_ERROR(reader->LookupTensorShape(
+      strings::StrCat(part_name, 0, "-keys"), &key_shape));
+  for (int i = 0; ; ++i) {
+    const std::string name = strings::StrCat(part_name, i);
+    s = reader->LookupTensorShape(strings::StrCat(name, "-keys"), &key_shape);
+    if (errors::IsNotFound(s)) break;
+    TF_RETURN_IF_ERROR(s);
+    TF_RETURN_IF_ERROR(AddTensor(reader, variable, name, tensors));
+  }
+  return Status::OK();
+}
+
+Status ReadRows(RandomAccessFile* file, int64 offset, size_t n,
+                std::vector<char>* buffer) {
+  buffer->resize(n);
+  StringPiece result;
+  TF_RETURN_IF_ERROR(file->Read(offset, n, &result, buffer->data()));
+  if (result.size() != n) {
+    return errors::DataLoss("Requested ", n, " bytes but read ",
+                            result.size(), " bytes.");
+  }
+  if (result.data() != buffer->data()) {
+    memcpy(buffer->data(), result.data(), n);
+  }
+  return Status::OK();
+}
+
+} // namespace
+
+FeatureStoreBulkLoader::FeatureStoreBulkLoader(
+    StoreFactory store_factory, const BulkLoadOptions& options)
+    : store_factory_(std::move(store_factory)), options_(options) {
+  options_.num_connections = std::max(options_.num_connections, 1);
+  options_.rows_per_chunk = std::max(options_.rows_per_chunk, size_t(1));
+  options_.keys_per_command = std::max(options_.keys_per_command, size_t(1));
+}
+
+Status FeatureStoreBulkLoader::Load(
+    const std::string& ckpt_prefix, uint64_t model_version,
+    const std::vector<BulkLoadVariable>& variables, BulkLoadStats* stats) {
+  const uint64 start_micros = Env::Default()->NowMicros();
+  std::vector<std::unique_ptr<BulkLoadTensor>> tensors;
+  {
+    BundleReader reader(Env::Default(), ckpt_prefix);
+    TF_RETURN_IF_ERROR(reader.status());
+    for (const BulkLoadVariable& variable : variables) {
+      TF_RETURN_IF_ERROR(AddVariable(&reader, variable, &tensors));
+    }
+  }
+
+  std::vector<BulkLoadChunk> chunks;
+  for (const auto& tensor : tensors) {
+    for (int64 begin = 0; begin < tensor->num_rows;
+         begin += options_.rows_per_chunk) {
+      chunks.push_back({tensor.get(), begin,
+          std::min<int64>(options_.rows_per_chunk, tensor->num_rows - begin)});
+    }
+  }
+
+  const int num_workers = std::max(1, std::min<int>(
+      options_.num_connections, chunks.size()));
+  std::vector<std::unique_ptr<FeatureStore>> stores(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    stores[i].reset(store_factory_());
+    if (stores[i] == nullptr) {
+      return errors::Internal("Failed to create feature store connection.");
+    }
+  }
+
+  std::atomic<size_t> next_chunk(0);
+  std::atomic<int64> num_keys(0);
+  std::atomic<int64> num_bytes(0);
+  mutex mu;
+  Status status;
+  auto failed = [&mu, &status]() {
+    mutex_lock l(mu);
+    return !status.ok();
+  };
+  auto worker = [&](FeatureStore* store) {
+    std::vector<char> keys;
+    std::vector<char> values;
+    for (size_t i = next_chunk++; i < chunks.size() && !failed();
+         i = next_chunk++) {
+      const BulkLoadChunk& chunk = chunks[i];
+      const BulkLoadTensor* tensor = chunk.tensor;
+      const BulkLoadVariable* variable = tensor->variable;
+      const size_t bytes_per_values = variable->dim_len * variable->value_size;
+      Status s = ReadRows(tensor->keys_file.get(),
+                          tensor->keys_offset + chunk.begin * variable->key_size,
+                          chunk.num_rows * variable->key_size, &keys);
+      if (s.ok()) {
+        s = ReadRows(tensor->values_file.get(),
+                     tensor->values_offset + chunk.begin * bytes_per_values,
+                     chunk.num_rows * bytes_per_values, &values);
+      }
+      if (s.ok()) {
+        s = store->BulkSet(model_version, variable->feature2id, keys.data(),
+                           values.data(), variable->key_size,
+                           bytes_per_values, chunk.num_rows,
+                           options_.keys_per_command);
+      }
+      if (!s.ok()) {
+        mutex_lock l(mu);
+        if (status.ok()) {
+          status = Status(s.code(), strings::StrCat(
+              "Failed to load ", tensor->name, ": ", s.error_message()));
+        }
+        return;
+      }
+      num_keys += chunk.num_rows;
+      num_bytes += keys.size() + values.size();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_workers; ++i) {
+    threads.emplace_back(worker, stores[i].get());
+  }
+  worker(stores[0].get());
+  for (auto& t : threads) t.join();
+  TF_RETURN_IF_ERROR(status);
+
+  if (options_.publish_version) {
+    TF_RETURN_IF_ERROR(stores[0]->SetModelVersion(model_version,
+                                                  model_version));
+  }
+
+  if (stats != nullptr) {
+    stats->num_keys = num_keys;
+    stats->num_bytes = num_bytes;
+    stats->seconds = (Env::Default()->NowMicros() - start_micros) / 1e6;
+  }
+  LOG(INFO) << "Loaded " << num_keys << " keys of " << variables.size()
+            << " variables into feature store, model_version: "
+            << model_version << ", "
+            << (Env::Default()->NowMicros() - start_micros) / 1000 << " ms.";
+  return Status::OK();
+}
+
+} // namespace processor
+} // namespace tensorflow
@@ -0,0 +1,69 @@
+#ifndef SERVING_PROCESSOR_STORAGE_FEATURE_STORE_LOADER_H_
+#define SERVING_PROCESSOR_STORAGE_FEATURE_STORE_LOADER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "serving/processor/storage/feature_store.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace processor {
+
+struct BulkLoadOptions {
+  // Writer threads, each with its own FeatureStore connection.
+  int num_connections = 8;
+  // Rows read from the checkpoint and written by a writer at a time.
+  size_t rows_per_chunk = 64 * 1024;
+  // Keys of one multi-key write command.
+  size_t keys_per_command = 1024;
+  // Sets the model version of the store to the loaded version once all
+  // variables are written. Otherwise the caller switches versions.
+  bool publish_version = false;
+};
+
+// An EmbeddingVariable of the checkpoint, partitioned ones are saved as
+// `tensor_name`/part_<i>.
+struct BulkLoadVariable {
+  std::string tensor_name;
+  uint64_t feature2id = 0;
+  size_t key_size = sizeof(int64_t);
+  size_t value_size = sizeof(float);
+  size_t dim_len = 0;
+};
+
+struct BulkLoadStats {
+  int64_t num_keys = 0;
+  int64_t num_bytes = 0;
+  double seconds = 0;
+};
+
+// Pushes the EmbeddingVariables of a checkpoint into a FeatureStore, e.g.
+// for remote-EV serving of a new model.
+//
+// The rows of all variables and partitions are split into chunks that the
+// writers read from the bundle data files in parallel and write with
+// FeatureStore::BulkSet. Keys are namespaced by model version, so the rows
+// of a new version do not disturb the reads of the version being served.
+class FeatureStoreBulkLoader {
+ public:
+  // Returns a new connection owned by the loader.
+  typedef std::function<FeatureStore*()> StoreFactory;
+
+  FeatureStoreBulkLoader(StoreFactory store_factory,
+                         const BulkLoadOptions& options);
+
+  Status Load(const std::string& ckpt_prefix, uint64_t model_version,
+              const std::vector<BulkLoadVariable>& variables,
+              BulkLoadStats* stats = nullptr);
+
+ private:
+  StoreFactory store_factory_;
+  BulkLoadOptions options_;
+};
+
+} // namespace processor
+} // namespace tensorflow
+
+#endif // SERVING_PROCESSOR_STORAGE_FEATURE_STORE_LOADER_H_
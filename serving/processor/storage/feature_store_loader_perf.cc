@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "serving/processor/storage/feature_store_loader.h"
+#include "serving/processor/storage/redis_feature_store.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+// Loads a synthetic EV checkpoint into a local redis-server and reports
+// keys/s for several connection counts and command sizes.
+//
+// Usage: feature_store_loader_perf [num_keys] [dim] [redis_port]
+using namespace tensorflow;
+using namespace tensorflow::processor;
+
+int main(int argc, char** argv) {
+  const int64 num_keys = argc > 1 ? atoll(argv[1]) : 1000000;
+  const int64 dim = argc > 2 ? atoll(argv[2]) : 16;
+  const int port = argc > 3 ? atoi(argv[3]) : 6379;
+
+  std::string prefix;
+  Env::Default()->LocalTempFilename(&prefix);
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    Tensor keys(DT_INT64, TensorShape({num_keys}));
+    Tensor values(DT_FLOAT, TensorShape({num_keys, dim}));
+    for (int64 i = 0; i < num_keys; ++i) {
+      keys.flat<int64>()(i) = i;
+      for (int64 j = 0; j < dim; ++j) {
+        values.matrix<float>()(i, j) = i + j * 0.1f;
+      }
+    }
+    TF_CHECK_OK(writer.Add("ev-keys", keys));
+    TF_CHECK_OK(writer.Add("ev-values", values));
+    TF_CHECK_OK(writer.Finish());
+  }
+
+  LocalRedis::Config config;
+  config.ip = "127.0.0.1";
+  config.port = port;
+  std::vector<BulkLoadVariable> variables(1);
+  variables[0].tensor_name = "ev";
+  variables[0].dim_len = dim;
+
+  // Every run overwrites the keys of the same version.
+  const uint64_t model_version = 1;
+  for (int num_connections : {1, 4, 8, 16}) {
+    for (size_t keys_per_command : {1, 128, 1024}) {
+      BulkLoadOptions options;
+      options.num_connections = num_connections;
+      options.keys_per_command = keys_per_command;
+      FeatureStoreBulkLoader loader(
+          [&config]() { return new LocalRedis(config); }, options);
+      BulkLoadStats stats;
+      Status s = loader.Load(prefix, model_version, variables, &stats);
+      if (!s.ok()) {
+        printf("Load failed: %s\n", s.ToString().c_str());
+        return 1;
+      }
+      printf("connections: %d, keys/command: %zu, %lld keys, %.2f sec, "
+             "%.0f keys/s, %.1f MB/s\n",
+             num_connections, keys_per_command, (long long)stats.num_keys,
+             stats.seconds, stats.num_keys / stats.seconds,
+             stats.num_bytes / stats.seconds / (1 << 20));
+    }
+  }
+  return 0;
+}
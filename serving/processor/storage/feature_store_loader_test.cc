@@ -0,0 +1,185 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "serving/processor/storage/feature_store_loader.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace processor {
+
+namespace {
+
+// Rows of all connections by model version, feature and key.
+struct MemoryStoreData {
+  mutex mu;
+  std::map<std::tuple<uint64_t, uint64_t, int64>,
+           std::vector<float>> rows;
+  int64_t full_version = -1;
+  int num_connections = 0;
+};
+
+class MemoryStore : public FeatureStore {
+ public:
+  explicit MemoryStore(MemoryStoreData* data) : data_(data) {
+    mutex_lock l(data_->mu);
+    ++data_->num_connections;
+  }
+
+  Status Cleanup() override { return Status::OK(); }
+
+  Status BatchGet(uint64_t model_version, uint64_t feature2id,
+                  const char* const keys, char* const values,
+                  size_t bytes_per_key, size_t bytes_per_values,
+                  size_t N, const char* default_value) override {
+    return errors::Unimplemented("");
+  }
+
+  Status BatchSet(uint64_t model_version, uint64_t feature2id,
+                  const char* const keys, const char* const values,
+                  size_t bytes_per_key, size_t bytes_per_values,
+                  size_t N) override {
+    mutex_lock l(data_->mu);
+    for (size_t i = 0; i < N; ++i) {
+      const float* v =
+          reinterpret_cast<const float*>(values + i * bytes_per_values);
+      data_->rows[std::make_tuple(
+          model_version, feature2id,
+          *reinterpret_cast<const int64*>(keys + i * bytes_per_key))] =
+          std::vector<float>(v, v + bytes_per_values / sizeof(float));
+    }
+    return Status::OK();
+  }
+
+  Status SetModelVersion(int64_t full_version,
+                         int64_t latest_version) override {
+    mutex_lock l(data_->mu);
+    data_->full_version = full_version;
+    return Status::OK();
+  }
+
+  Status BatchGetAsync(uint64_t model_version, uint64_t feature2id,
+                       const char* const keys, char* const values,
+                       size_t bytes_per_key, size_t bytes_per_values,
+                       size_t N, const char* default_value,
+                       BatchGetCallback cb) override {
+    return errors::Unimplemented("");
+  }
+
+  Status BatchSetAsync(uint64_t model_version, uint64_t feature2id,
+                       const char* const keys, const char* const values,
+                       size_t bytes_per_key, size_t bytes_per_values,
+                       size_t N, BatchSetCallback cb) override {
+    return errors::Unimplemented("");
+  }
+
+ private:
+  MemoryStoreData* data_;
+};
+
+void AddEV(BundleWriter* writer, const std::string& name, int64 begin,
+           int64 num_rows, int64 dim) {
+  Tensor keys(DT_INT64, TensorShape({num_rows}));
+  Tensor values(DT_FLOAT, TensorShape({num_rows, dim}));
+  for (int64 i = 0; i < num_rows; ++i) {
+    keys.flat<int64>()(i) = begin + i;
+    for (int64 j = 0; j < dim; ++j) {
+      values.matrix<float>()(i, j) = (begin + i) * 10 + j;
+    }
+  }
+  TF_ASSERT_OK(writer->Add(name + "-keys", keys));
+  TF_ASSERT_OK(writer->Add(name + "-values", values));
+}
+
+} // namespace
+
+TEST(FeatureStoreBulkLoaderTest, LoadPartitionedVariables) {
+  const std::string prefix =
+      io::JoinPath(testing::TmpDir(), "feature_store_loader_ckpt");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    AddEV(&writer, "ev", 0, 1000, 4);
+    AddEV(&writer, "part_ev/part_0", 0, 300, 8);
+    AddEV(&writer, "part_ev/part_1", 300, 0, 8);
+    AddEV(&writer, "part_ev/part_2", 300, 700, 8);
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  MemoryStoreData data;
+  BulkLoadOptions options;
+  options.num_connections = 4;
+  options.rows_per_chunk = 128;
+  options.keys_per_command = 16;
+  options.publish_version = true;
+  FeatureStoreBulkLoader loader(
+      [&data]() { return new MemoryStore(&data); }, options);
+
+  std::vector<BulkLoadVariable> variables(2);
+  variables[0].tensor_name = "ev";
+  variables[0].feature2id = 1;
+  variables[0].dim_len = 4;
+  variables[1].tensor_name = "part_ev";
+  variables[1].feature2id = 2;
+  variables[1].dim_len = 8;
+  BulkLoadStats stats;
+  TF_ASSERT_OK(loader.Load(prefix, 7, variables, &stats));
+
+  EXPECT_EQ(2000, stats.num_keys);
+  EXPECT_EQ(1000 * (8 + 16) + 1000 * (8 + 32), stats.num_bytes);
+  EXPECT_EQ(4, data.num_connections);
+  EXPECT_EQ(7, data.full_version);
+  ASSERT_EQ(2000, data.rows.size());
+  for (int64 key = 0; key < 1000; ++key) {
+    const auto& ev_row = data.rows[std::make_tuple(7, 1, key)];
+    ASSERT_EQ(4, ev_row.size());
+    EXPECT_EQ(key * 10 + 3, ev_row[3]);
+    const auto& part_row = data.rows[std::make_tuple(7, 2, key)];
+    ASSERT_EQ(8, part_row.size());
+    EXPECT_EQ(key * 10 + 7, part_row[7]);
+  }
+}
+
+TEST(FeatureStoreBulkLoaderTest, DimMismatch) {
+  const std::string prefix =
+      io::JoinPath(testing::TmpDir(), "feature_store_loader_dim_ckpt");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    AddEV(&writer, "ev", 0, 10, 4);
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  MemoryStoreData data;
+  FeatureStoreBulkLoader loader(
+      [&data]() { return new MemoryStore(&data); }, BulkLoadOptions());
+  std::vector<BulkLoadVariable> variables(1);
+  variables[0].tensor_name = "ev";
+  variables[0].dim_len = 8;
+  EXPECT_TRUE(errors::IsInvalidArgument(loader.Load(prefix, 1, variables)));
+  EXPECT_TRUE(data.rows.empty());
+}
+
+} // namespace processor
+} // namespace tensorflow
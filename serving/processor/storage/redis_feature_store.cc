@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -542,6 +543,70 @@ Status LocalRedis::BatchSet(uint64_t model_version,
   return Status::OK();
 }
 
+Status LocalRedis::BulkSet(uint64_t model_version,
+                           uint64_t feature2id,
+                           const char* const keys,
+                           const char* const values,
+                           size_t bytes_per_key,
+                           size_t bytes_per_values,
+                           size_t N,
+                           size_t keys_per_command) {
+  if (N == 0) return Status::OK();
+  if (keys_per_command == 0) keys_per_command = N;
+  const size_t size_model_version = sizeof(model_version);
+  const size_t size_feature2id = sizeof(feature2id);
+  const size_t key_length = bytes_per_key + size_model_version + size_feature2id;
+  // Values are sent from the caller's buffer, only the prefixed keys are
+  // copied.
+  std::vector<char> redis_keys(N * key_length);
+  for (size_t i = 0; i < N; ++i) {
+    char* key = redis_keys.data() + i * key_length;
+    memcpy(key, &model_version, size_model_version);
+    memcpy(key + size_model_version, &feature2id, size_feature2id);
+    memcpy(key + size_model_version + size_feature2id,
+           keys + i * bytes_per_key, bytes_per_key);
+  }
+
+  std::vector<const char*> argv(2 * keys_per_command + 1);
+  std::vector<size_t> argvlen(2 * keys_per_command + 1);
+  argv[0] = "MSET";
+  argvlen[0] = 4;
+  size_t num_commands = 0;
+  for (size_t begin = 0; begin < N; begin += keys_per_command) {
+    size_t n = std::min(keys_per_command, N - begin);
+    for (size_t i = 0; i < n; ++i) {
+      argv[2 * i + 1] = redis_keys.data() + (begin + i) * key_length;
+      argvlen[2 * i + 1] = key_length;
+      argv[2 * i + 2] = values + (begin + i) * bytes_per_values;
+      argvlen[2 * i + 2] = bytes_per_values;
+    }
+    // Copies the arguments to the output buffer of the connection.
+    if (REDIS_OK != redisAppendCommandArgv(c_, 2 * n + 1, argv.data(),
+                                           argvlen.data())) {
+      return Status(error::Code::INTERNAL,
+          "[Redis] run redisAppendCommandArgv-MSET failed: " +
+          std::string(c_->errstr));
+    }
+    ++num_commands;
+  }
+
+  Status s;
+  for (size_t i = 0; i < num_commands; ++i) {
+    redisReply *reply = nullptr;
+    if (REDIS_OK != redisGetReply(c_, (void**)&reply)) {
+      return Status(error::Code::INTERNAL,
+          "[Redis] run redisGetReply-MSET failed: " + std::string(c_->errstr));
+    }
+    if (s.ok() && REDIS_REPLY_STATUS != reply->type) {
+      LOG(ERROR) << "pipelined MSET failed: " << reply->str;
+      s = Status(error::Code::INTERNAL,
+          "[Redis] run pipelined MSET failed." + std::string(reply->str));
+    }
+    freeReplyObject(reply);
+  }
+  return s;
+}
+
 Status LocalRedis::BatchGetAsync(uint64_t model_version,
                                  uint64_t feature2id,
                                  const char* const keys,
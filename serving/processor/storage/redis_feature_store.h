@@ -56,6 +56,17 @@ class LocalRedis : public FeatureStore {
                     size_t bytes_per_values,
                     size_t N);
 
+    // Appends all MSET commands to the connection before reading their
+    // replies, one round trip instead of one per command.
+    Status BulkSet(uint64_t model_version,
+                   uint64_t feature2id,
+                   const char* const keys,
+                   const char* const values,
+                   size_t bytes_per_key,
+                   size_t bytes_per_values,
+                   size_t N,
+                   size_t keys_per_command);
+
     Status BatchGetAsync(uint64_t model_version,
                          uint64_t feature2id,
                          const char* const keys,
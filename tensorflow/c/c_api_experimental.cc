@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/core/common_runtime/eager/attr_builder.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_server_lib.h"
+#include "tensorflow/core/framework/embedding/heavy_hitter_sketch.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/framework/tensor.pb.h"
@@ -1167,3 +1168,37 @@ void TF_ImportGraphDefOptionsSetValidateColocationConstraints(
     TF_ImportGraphDefOptions* opts, unsigned char enable) {
   opts->opts.validate_colocation_constraints = enable;
 }
+
+int TF_EmbeddingVariableHeavyHitters(const char* name, int k, int64_t* ids,
+                                     int64_t* freqs, const float* coverages,
+                                     int num_coverages,
+                                     int64_t* working_set_sizes,
+                                     int64_t* total, TF_Status* status) {
+  const tensorflow::int64 capacity =
+      tensorflow::embedding::HeavyHitterSketch::DefaultCapacity();
+  if (capacity <= 0) {
+    status->status = tensorflow::errors::FailedPrecondition(
+        "Set TF_EV_HEAVY_HITTER_CAPACITY to enable heavy hitter sketches.");
+    return 0;
+  }
+  tensorflow::embedding::HeavyHitterSketch merged(capacity);
+  if (!tensorflow::embedding::HeavyHitterRegistry::Global()->Merge(name,
+                                                                   &merged)) {
+    status->status = tensorflow::errors::NotFound(
+        "No heavy hitter sketch for EmbeddingVariable ", name);
+    return 0;
+  }
+  tensorflow::embedding::HeavyHitterReport report;
+  merged.Report(k, std::vector<float>(coverages, coverages + num_coverages),
+                &report);
+  for (size_t i = 0; i < report.ids.size(); ++i) {
+    ids[i] = report.ids[i];
+    freqs[i] = report.freqs[i];
+  }
+  for (int i = 0; i < num_coverages; ++i) {
+    working_set_sizes[i] = report.working_set_sizes[i];
+  }
+  if (total != nullptr) *total = report.total;
+  status->status = tensorflow::Status::OK();
+  return report.ids.size();
+}
@@ -402,6 +402,22 @@ TF_CAPI_EXPORT extern void
 TF_ImportGraphDefOptionsSetValidateColocationConstraints(
     TF_ImportGraphDefOptions* opts, unsigned char enable);
 
+// Reports the most frequently looked up ids of the EmbeddingVariable `name`
+// in this process, merged over its partitions `name`/part_<i>. The sketches
+// are maintained if the environment variable TF_EV_HEAVY_HITTER_CAPACITY is
+// set to the number of ids tracked per variable.
+//
+// Writes up to `k` ids and estimated frequencies, by decreasing frequency, to
+// `ids` and `freqs`, and returns their number. For each of the
+// `num_coverages` fractions in `coverages` writes the estimated number of
+// ids that receive that fraction of the lookups to `working_set_sizes`, or
+// -1 if it exceeds the capacity of the sketch. `total` receives the number
+// of ids looked up and may be NULL.
+TF_CAPI_EXPORT extern int TF_EmbeddingVariableHeavyHitters(
+    const char* name, int k, int64_t* ids, int64_t* freqs,
+    const float* coverages, int num_coverages, int64_t* working_set_sizes,
+    int64_t* total, TF_Status* status);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -43,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/port.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -975,7 +976,7 @@ void ColocationGraph::AssignGpuStreamIdx(Node *node) {
 
 void ColocationGraph::GetSoftDeviceCandidates(
     const Node& node, const Member& root_member, int root_id,
-    std::vector<Device*>* possible_devices) {
+    std::vector<Device*>* possible_devices) const {
   // Try to find supported devices that don't violate resource devices.
   // The soft_device_name is the same as the requested device name
   // without specifying the device type or ID (if assigned and requested
@@ -1040,11 +1041,70 @@ Status ColocationGraph::GetDevicesForNode(
     return Status::OK();
   }
 
-  Member& root_member = members_[node_root];
-
   // We have not yet computed the possible devices for the
   // colocated node set containing 'node', so we do so now using the
   // constraints on the root node.
+  std::vector<Device*> devices;
+  TF_RETURN_IF_ERROR(ComputePossibleDevices(node, node_root, &devices));
+
+  // Cache the result of the possible devices for this node group.
+  Member& root_member = members_[node_root];
+  root_member.set_possible_devices(std::move(devices));
+  *possible_devices = &root_member.possible_devices();
+  return Status::OK();
+}
+
+void ColocationGraph::PrecomputePossibleDevices(
+    thread::ThreadPool* thread_pool) {
+  // The roots of the groups to compute and a node of each. Groups with an
+  // assigned node are constrained further when the node is placed.
+  std::vector<std::pair<int, const Node*>> groups;
+  std::vector<int> group_of_root(graph_.num_node_ids(), -1);
+  std::vector<bool> has_assigned_node;
+  for (const Node* node : graph_.op_nodes()) {
+    const int root = FindAndUpdateRoot(node->id());
+    if (group_of_root[root] < 0) {
+      group_of_root[root] = groups.size();
+      groups.emplace_back(root, node);
+      has_assigned_node.push_back(false);
+    }
+    if (node->has_assigned_device_name()) {
+      has_assigned_node[group_of_root[root]] = true;
+    }
+  }
+  std::vector<std::pair<int, const Node*>> pending;
+  for (size_t i = 0; i < groups.size(); ++i) {
+    if (!has_assigned_node[i] &&
+        members_[groups[i].first].possible_devices().empty()) {
+      pending.push_back(groups[i]);
+    }
+  }
+
+  // The devices of a group only depend on its root member, so they are
+  // computed in parallel and cached in order. A group that fails is left
+  // for GetDevicesForNode to report.
+  std::vector<std::vector<Device*>> devices(pending.size());
+  Shard(thread_pool->NumThreads(), thread_pool, pending.size(),
+        /*cost_per_unit=*/5000, [&](int64 begin, int64 end) {
+          for (int64 i = begin; i < end; ++i) {
+            if (!ComputePossibleDevices(pending[i].second, pending[i].first,
+                                        &devices[i])
+                     .ok()) {
+              devices[i].clear();
+            }
+          }
+        });
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (!devices[i].empty()) {
+      members_[pending[i].first].set_possible_devices(std::move(devices[i]));
+    }
+  }
+}
+
+Status ColocationGraph::ComputePossibleDevices(
+    const Node* node, int node_root,
+    std::vector<Device*>* possible_devices) const {
+  const Member& root_member = members_[node_root];
 
   // "devices" will contain the set of feasible placements for the
   // colocated node set containing 'node'.
@@ -1160,10 +1220,7 @@ Status ColocationGraph::GetDevicesForNode(
           DebugInfo(node_root));
     }
   }
-
-  // Cache the result of the possible devices for this node group.
-  root_member.set_possible_devices(std::move(devices));
-  *possible_devices = &root_member.possible_devices();
+  *possible_devices = std::move(devices);
   return Status::OK();
 }
 
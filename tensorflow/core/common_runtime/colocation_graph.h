@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/port.h"
 
@@ -263,6 +264,13 @@ class ColocationGraph {
   Status GetDevicesForNode(Node* node,
                            const std::vector<Device*>** possible_devices);
 
+  // Computes the possible devices of the colocation groups on
+  // 'thread_pool', and caches them as GetDevicesForNode would. Groups with
+  // an assigned node are left out, as they are limited further when it is
+  // placed, and so are groups without possible devices, for which
+  // GetDevicesForNode returns the error. Call it before placing any node.
+  void PrecomputePossibleDevices(thread::ThreadPool* thread_pool);
+
   // Returns debugging info for the node referred to by 'node_root'.
   string DebugInfo(const int node_root) const;
 
@@ -347,7 +355,12 @@ class ColocationGraph {
 
   void GetSoftDeviceCandidates(const Node& node, const Member& root_member,
                                int root_id,
-                               std::vector<Device*>* possible_devices);
+                               std::vector<Device*>* possible_devices) const;
+
+  // Computes the possible devices of the colocation group of 'node', whose
+  // root is 'node_root', from the constraints on the root.
+  Status ComputePossibleDevices(const Node* node, int node_root,
+                                std::vector<Device*>* possible_devices) const;
 
   Status InitializeMembers();
 
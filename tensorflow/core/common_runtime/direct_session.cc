@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/direct_session.h"
 #include "tensorflow/core/common_runtime/custom_thread_pool.h"
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 #include <vector>
@@ -32,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/common_runtime/graph_cache.h"
 #include "tensorflow/core/common_runtime/graph_optimizer.h"
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/memory_types.h"
@@ -50,9 +52,11 @@ limitations under the License.
 #include "tensorflow/core/framework/graph_def_util.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/logging.h"
+#include "tensorflow/core/framework/micro_batch_context.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/run_handler.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/graph.h"
@@ -918,6 +922,8 @@ DirectSession::DirectSession(const SessionOptions& options,
   tensorflow::ReadBoolFromEnvVar("MERGE_COMPUTE_COPY_STREAM",
                                  /*default_val=*/false,
                                  &merge_compute_and_copy_stream_);
+
+  graph_cache_ = PartitionedGraphCache::FromEnv(options_.env);
 }
 
 DirectSession::~DirectSession() {
@@ -981,21 +987,26 @@ Status DirectSession::Extend(GraphDef&& graph) {
 }
 
 Status DirectSession::ExtendLocked(GraphDef graph) {
-  if (!(flib_def_ && execution_state_)) {
+  if (graph_cache_) {
+    graph_fingerprint_ =
+        PartitionedGraphCache::ExtendGraphFingerprint(graph_fingerprint_, graph);
+  }
+  if (!(flib_def_ && (execution_state_ || deferred_graph_))) {
     // If this is the first call, we can initialize the execution state
     // with `graph` and do not need to call `Extend()`.
     // NOTE(mrry): The function library created here will be used for
     // all subsequent extensions of the graph.
     flib_def_.reset(
         new FunctionLibraryDefinition(OpRegistry::Global(), graph.library()));
-    GraphExecutionStateOptions options;
-    options.device_set = &device_set_;
-    options.session_options = &options_;
-    options.session_handle = session_handle_;
-    TF_RETURN_IF_ERROR(GraphExecutionState::MakeForBaseGraph(
-        std::move(graph), options, &execution_state_));
+    deferred_graph_.reset(new GraphDef(std::move(graph)));
+    if (!graph_cache_) {
+      TF_RETURN_IF_ERROR(MaybeCreateExecutionStateLocked());
+    }
+    // With the graph cache enabled, placing the base graph waits for the
+    // first CreateGraphs() that misses the cache.
     graph_created_ = true;
   } else {
+    TF_RETURN_IF_ERROR(MaybeCreateExecutionStateLocked());
     TF_RETURN_IF_ERROR(flib_def_->AddLibrary(graph.library()));
     std::unique_ptr<GraphExecutionState> state;
     // TODO(mrry): Rewrite GraphExecutionState::Extend() to take `graph` by
@@ -1006,6 +1017,21 @@ Status DirectSession::ExtendLocked(GraphDef graph) {
   return Status::OK();
 }
 
+Status DirectSession::MaybeCreateExecutionStateLocked() {
+  if (!deferred_graph_) {
+    return Status::OK();
+  }
+  std::unique_ptr<GraphDef> graph = std::move(deferred_graph_);
+  GraphExecutionStateOptions options;
+  options.device_set = &device_set_;
+  options.session_options = &options_;
+  options.session_handle = session_handle_;
+  // Graph construction and placement prepare the nodes on the inter-op pool.
+  options.thread_pool = thread_pools_[0].first;
+  return GraphExecutionState::MakeForBaseGraph(std::move(*graph), options,
+                                               &execution_state_);
+}
+
 Status DirectSession::Run(const NamedTensorList& inputs,
                           const std::vector<string>& output_names,
                           const std::vector<string>& target_nodes,
@@ -1049,7 +1075,8 @@ Status DirectSession::RunInternal(
     int64 step_id, const RunOptions& run_options,
     CallFrameInterface* call_frame, ExecutorsAndKeys* executors_and_keys,
     RunMetadata* run_metadata,
-    const thread::ThreadPoolOptions& threadpool_options) {
+    const thread::ThreadPoolOptions& threadpool_options,
+    ScopedStepContainer* step_container) {
   const uint64 start_time_usecs = options_.env->NowMicros();
   const int64 executor_step_count = executors_and_keys->step_count.fetch_add(1);
   RunState run_state(step_id, &devices_);
@@ -1141,7 +1168,8 @@ Status DirectSession::RunInternal(
   args.session_state = &session_state_;
   args.session_handle = session_handle_;
   args.tensor_store = &run_state.tensor_store;
-  args.step_container = &run_state.step_container;
+  args.step_container =
+      step_container != nullptr ? step_container : &run_state.step_container;
   args.sync_on_finish = sync_on_finish_;
   args.user_intra_op_threadpool = threadpool_options.intra_op_threadpool;
   if (run_in_caller_thread_) {
@@ -1471,9 +1499,17 @@ Status DirectSession::Run(const RunOptions& run_options,
     thread_pool_options.intra_op_threadpool =
         stage_subgraph_thread_pools_[id].second;
   }
-  TF_RETURN_IF_ERROR(RunInternal(step_id, run_options, &call_frame,
-                                 executors_and_keys, run_metadata,
-                                 thread_pool_options));  
+  const int32 num_micro_batches = NumMicroBatches(run_options);
+  if (num_micro_batches > 1) {
+    TF_RETURN_IF_ERROR(RunMicroBatches(num_micro_batches, step_id, run_options,
+                                       feed_args, &call_frame,
+                                       executors_and_keys, run_metadata,
+                                       thread_pool_options));
+  } else {
+    TF_RETURN_IF_ERROR(RunInternal(step_id, run_options, &call_frame,
+                                   executors_and_keys, run_metadata,
+                                   thread_pool_options));
+  }
 
   // Receive outputs.
   if (outputs) {
@@ -1521,6 +1557,123 @@ Status DirectSession::Run(const RunOptions& run_options,
   return Status::OK();
 }
 
+int32 DirectSession::NumMicroBatches(const RunOptions& run_options) const {
+  const OptimizerOptions& optimizer_options =
+      options_.config.graph_options().optimizer_options();
+  if (!optimizer_options.runtime_micro_batch()) return 1;
+  return run_options.micro_batch_num() > 0
+             ? run_options.micro_batch_num()
+             : optimizer_options.micro_batch_num();
+}
+
+Status DirectSession::RunMicroBatches(
+    int32 num_micro_batches, int64 step_id, const RunOptions& run_options,
+    gtl::ArraySlice<Tensor> feed_args, FunctionCallFrame* call_frame,
+    ExecutorsAndKeys* executors_and_keys, RunMetadata* run_metadata,
+    const thread::ThreadPoolOptions& threadpool_options) {
+  // The feeds named in RunOptions.micro_batch_split_feeds, or by default all
+  // feeds of rank > 0, are the batch and split along the first dimension.
+  // The others, e.g. hyper parameters, are passed to every micro batch.
+  std::vector<string> feed_names(feed_args.size());
+  for (const auto& it : executors_and_keys->input_name_to_index) {
+    feed_names[it.second] = it.first;
+  }
+  std::vector<bool> split(feed_args.size(), false);
+  if (run_options.micro_batch_split_feeds_size() > 0) {
+    for (const string& name : run_options.micro_batch_split_feeds()) {
+      auto it = executors_and_keys->input_name_to_index.find(name);
+      if (it == executors_and_keys->input_name_to_index.end()) {
+        it = executors_and_keys->input_name_to_index.find(
+            strings::StrCat(name, ":0"));
+      }
+      if (it == executors_and_keys->input_name_to_index.end()) {
+        return errors::InvalidArgument(
+            "micro_batch_split_feeds contains ", name,
+            ", which is not fed in this run");
+      }
+      split[it->second] = true;
+    }
+  } else {
+    for (size_t i = 0; i < feed_args.size(); ++i) {
+      split[i] = feed_args[i].dims() > 0;
+    }
+  }
+  int64 batch_size = -1;
+  size_t batch_feed = 0;
+  for (size_t i = 0; i < feed_args.size(); ++i) {
+    if (!split[i]) continue;
+    if (feed_args[i].dims() == 0) {
+      return errors::InvalidArgument(
+          "Cannot split the scalar feed ", feed_names[i],
+          " into micro batches");
+    }
+    if (batch_size < 0) {
+      batch_size = feed_args[i].dim_size(0);
+      batch_feed = i;
+    } else if (feed_args[i].dim_size(0) != batch_size) {
+      return errors::InvalidArgument(
+          "Feeds split into micro batches must have the same first "
+          "dimension, but ", feed_names[batch_feed], " has ", batch_size,
+          " and ", feed_names[i], " has ", feed_args[i].dim_size(0),
+          ". List the batch feeds in RunOptions.micro_batch_split_feeds.");
+    }
+  }
+  if (batch_size > 0 && batch_size % num_micro_batches != 0) {
+    return errors::InvalidArgument(
+        "The batch size ", batch_size, " of feed ", feed_names[batch_feed],
+        " is not divisible by the ", num_micro_batches, " micro batches");
+  }
+  const int64 slice_size = std::max<int64>(batch_size, 0) / num_micro_batches;
+  auto micro_batch_args = [&](int32 index) {
+    std::vector<Tensor> args(feed_args.begin(), feed_args.end());
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!split[i]) continue;
+      Tensor& t = args[i];
+      t = t.Slice(index * slice_size, (index + 1) * slice_size);
+      // Kernels map tensors as aligned Eigen tensors.
+      if (!t.IsAligned()) t = tensor::DeepCopy(t);
+    }
+    return args;
+  };
+
+  // Gradient accumulators live in the step container of the first micro
+  // batch, which is shared by all micro batches of the step.
+  ScopedStepContainer step_container(
+      step_id, [this, step_id](const string& name) {
+        for (auto d : devices_) {
+          if (!d->resource_manager()->Cleanup(name).ok()) {
+            // Do nothing...
+          }
+          ScopedAllocatorMgr* sam = d->GetScopedAllocatorMgr();
+          if (sam) sam->Cleanup(step_id);
+        }
+      });
+  MicroBatchContext* context = new MicroBatchContext(num_micro_batches);
+  core::ScopedUnref unref_context(context);
+  for (auto d : devices_) {
+    context->Ref();
+    TF_RETURN_IF_ERROR(step_container.Create(
+        d->resource_manager(), MicroBatchContext::kResourceName, context));
+  }
+
+  for (int32 i = 0; i < num_micro_batches; ++i) {
+    context->set_index(i);
+    const int64 micro_batch_step_id =
+        i == 0 ? step_id : step_id_counter_.fetch_add(1);
+    const bool is_last = i + 1 == num_micro_batches;
+    // Outputs of earlier micro batches are discarded, only the frame of the
+    // last one is consumed by Run().
+    FunctionCallFrame micro_batch_frame(executors_and_keys->input_types,
+                                        executors_and_keys->output_types);
+    FunctionCallFrame* frame = is_last ? call_frame : &micro_batch_frame;
+    TF_RETURN_IF_ERROR(frame->SetArgs(micro_batch_args(i)));
+    TF_RETURN_IF_ERROR(RunInternal(micro_batch_step_id, run_options, frame,
+                                   executors_and_keys, run_metadata,
+                                   threadpool_options, &step_container));
+  }
+  return Status::OK();
+}
+
 Status DirectSession::PRunSetup(const std::vector<string>& input_names,
                                 const std::vector<string>& output_names,
                                 const std::vector<string>& target_nodes,
@@ -2199,6 +2352,34 @@ Status DirectSession::CreateGraphs(
     RunStateArgs* run_state_args, DataTypeVector* input_types,
     DataTypeVector* output_types, int64* collective_graph_key) {
   mutex_lock l(graph_state_lock_);
+  const uint64 start_time_usecs = options_.env->NowMicros();
+  string cache_key;
+  if (graph_cache_ && !run_state_args->is_partial_run) {
+    cache_key = PartitionedGraphCache::GraphKey(
+        graph_fingerprint_, options_.config, device_set_, subgraph_options);
+    PartitionedGraphCacheEntry entry;
+    Status s = graph_cache_->Lookup(cache_key, &entry);
+    if (s.ok()) {
+      s = CreateGraphsFromCacheLocked(&entry, outputs, flib_def, input_types,
+                                      output_types, collective_graph_key);
+      if (s.ok()) {
+        const uint64 elapsed_usecs =
+            options_.env->NowMicros() - start_time_usecs;
+        metrics::RecordGraphCacheLookup(/*hit=*/true, elapsed_usecs);
+        LOG(INFO) << "Created " << outputs->size()
+                  << " partition graphs from graph cache entry " << cache_key
+                  << " in " << elapsed_usecs / 1000 << " ms";
+        return Status::OK();
+      }
+      outputs->clear();
+    }
+    if (!errors::IsNotFound(s)) {
+      LOG(WARNING) << "Ignoring graph cache entry " << cache_key << ": "
+                   << s.error_message();
+    }
+  }
+  TF_RETURN_IF_ERROR(MaybeCreateExecutionStateLocked());
+
   std::unique_ptr<ClientGraph> client_graph;
 
   std::unique_ptr<GraphExecutionState> temp_exec_state_holder;
@@ -2212,6 +2393,7 @@ Status DirectSession::CreateGraphs(
     prune_options.session_options = &options_;
     prune_options.stateful_placements = stateful_placements_;
     prune_options.session_handle = session_handle_;
+    prune_options.thread_pool = thread_pools_[0].first;
     TF_RETURN_IF_ERROR(GraphExecutionState::MakeForPrunedGraph(
         *execution_state_, prune_options, subgraph_options,
         &temp_exec_state_holder, &client_graph));
@@ -2281,6 +2463,9 @@ Status DirectSession::CreateGraphs(
   };
   popts.flib_def = &client_graph->graph.flib_def();
   popts.control_flow_added = false;
+  // Partitions are built on the inter-op pool, like the nodes of the graph
+  // and the devices of its colocation groups are prepared before.
+  popts.thread_pool = thread_pools_[0].first;
 
   if (use_multi_stream_) {
     // Split graph to multi-stream subgraph,
@@ -2290,7 +2475,11 @@ Status DirectSession::CreateGraphs(
   }
 
   std::unordered_map<string, GraphDef> partitions;
+  const uint64 partition_start_us = options_.env->NowMicros();
   TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, &partitions));
+  VLOG(1) << "Partitioned " << client_graph->graph.num_op_nodes()
+          << " nodes into " << partitions.size() << " partitions in "
+          << options_.env->NowMicros() - partition_start_us << " us";
 
   std::vector<string> device_names;
   for (auto device : devices_) {
@@ -2331,7 +2520,95 @@ Status DirectSession::CreateGraphs(
   TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
       OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
 
-  Status s;
+  if (!cache_key.empty()) {
+    PartitionedGraphCacheEntry entry;
+    for (const auto& partition : *outputs) {
+      GraphDef* partition_def =
+          &(*entry.mutable_partitions())[partition.first];
+      partition.second->ToGraphDef(partition_def);
+      // The library is stored once for all partitions.
+      partition_def->clear_library();
+    }
+    *entry.mutable_library() = client_graph->flib_def->ToProto();
+    for (DataType dtype : client_graph->feed_types) {
+      entry.add_feed_types(dtype);
+    }
+    for (DataType dtype : client_graph->fetch_types) {
+      entry.add_fetch_types(dtype);
+    }
+    entry.set_collective_graph_key(*collective_graph_key);
+    entry.mutable_stateful_placements()->insert(
+        current_stateful_placements.begin(),
+        current_stateful_placements.end());
+    Status s = graph_cache_->Insert(cache_key, &entry);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to write graph cache entry " << cache_key << ": "
+                   << s.error_message();
+    }
+    const uint64 elapsed_usecs = options_.env->NowMicros() - start_time_usecs;
+    metrics::RecordGraphCacheLookup(/*hit=*/false, elapsed_usecs);
+    LOG(INFO) << "Created " << outputs->size()
+              << " partition graphs for graph cache entry " << cache_key
+              << " in " << elapsed_usecs / 1000 << " ms";
+  }
+
+  Status s = RewritePartitionGraphsForDevices(outputs);
+  *flib_def = std::move(client_graph->flib_def);
+  std::swap(*input_types, client_graph->feed_types);
+  std::swap(*output_types, client_graph->fetch_types);
+  return s;
+}
+
+Status DirectSession::CreateGraphsFromCacheLocked(
+    PartitionedGraphCacheEntry* entry,
+    std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+    std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+    DataTypeVector* input_types, DataTypeVector* output_types,
+    int64* collective_graph_key) {
+  for (const auto& placement : entry->stateful_placements()) {
+    auto iter = stateful_placements_.find(placement.first);
+    if (iter != stateful_placements_.end() &&
+        iter->second != placement.second) {
+      return errors::Internal("Stateful placement mismatch. Current assignment "
+                              "of ",
+                              placement.first, " to ", iter->second,
+                              " does not match ", placement.second);
+    }
+  }
+
+  std::unique_ptr<FunctionLibraryDefinition> library(
+      new FunctionLibraryDefinition(OpRegistry::Global(), entry->library()));
+  for (auto& partition : *entry->mutable_partitions()) {
+    Device* d;
+    TF_RETURN_IF_ERROR(device_mgr_->LookupDevice(partition.first, &d));
+    std::unique_ptr<Graph> device_graph(new Graph(library.get()));
+    GraphConstructorOptions device_opts;
+    device_opts.allow_internal_ops = true;
+    device_opts.expect_device_spec = true;
+    TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
+        device_opts, std::move(partition.second), device_graph.get()));
+    outputs->emplace(partition.first, std::move(device_graph));
+  }
+  TF_RETURN_IF_ERROR(RewritePartitionGraphsForDevices(outputs));
+
+  for (const auto& placement : entry->stateful_placements()) {
+    stateful_placements_.emplace(placement.first, placement.second);
+  }
+  *collective_graph_key = entry->collective_graph_key();
+  input_types->clear();
+  for (int dtype : entry->feed_types()) {
+    input_types->push_back(static_cast<DataType>(dtype));
+  }
+  output_types->clear();
+  for (int dtype : entry->fetch_types()) {
+    output_types->push_back(static_cast<DataType>(dtype));
+  }
+  *flib_def = std::move(library);
+  return Status::OK();
+}
+
+Status DirectSession::RewritePartitionGraphsForDevices(
+    std::unordered_map<string, std::unique_ptr<Graph>>* outputs) {
   for (auto& partition : *outputs) {
     const string& partition_name = partition.first;
     std::unique_ptr<Graph>* graph = &partition.second;
@@ -2341,17 +2618,10 @@ Status DirectSession::CreateGraphs(
 
     // Give the device an opportunity to rewrite its subgraph.
     Device* d;
-    s = device_mgr_->LookupDevice(partition_name, &d);
-    if (!s.ok()) break;
-    s = d->MaybeRewriteGraph(graph);
-    if (!s.ok()) {
-      break;
-    }
+    TF_RETURN_IF_ERROR(device_mgr_->LookupDevice(partition_name, &d));
+    TF_RETURN_IF_ERROR(d->MaybeRewriteGraph(graph));
   }
-  *flib_def = std::move(client_graph->flib_def);
-  std::swap(*input_types, client_graph->feed_types);
-  std::swap(*output_types, client_graph->fetch_types);
-  return s;
+  return Status::OK();
 }
 
 ::tensorflow::Status DirectSession::ListDevices(
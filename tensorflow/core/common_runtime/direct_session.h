@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/graph_cache.h"
 #include "tensorflow/core/common_runtime/graph_execution_state.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
@@ -261,10 +262,39 @@ class DirectSession : public Session {
       RunStateArgs* run_state_args, DataTypeVector* input_types,
       DataTypeVector* output_types, int64* collective_graph_key);
 
+  // Creates the graphs of CreateGraphs() from an entry of `graph_cache_`.
+  ::tensorflow::Status CreateGraphsFromCacheLocked(
+      PartitionedGraphCacheEntry* entry,
+      std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+      std::unique_ptr<FunctionLibraryDefinition>* flib_def,
+      DataTypeVector* input_types, DataTypeVector* output_types,
+      int64* collective_graph_key) EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
+  // Gives each device an opportunity to rewrite its partition graph.
+  ::tensorflow::Status RewritePartitionGraphsForDevices(
+      std::unordered_map<string, std::unique_ptr<Graph>>* outputs);
+
+  // Runs the executors once. If `step_container` is set, it's used instead
+  // of a container owned by the run, to share resources between runs.
   ::tensorflow::Status RunInternal(
       int64 step_id, const RunOptions& run_options,
       CallFrameInterface* call_frame, ExecutorsAndKeys* executors_and_keys,
       RunMetadata* run_metadata,
+      const thread::ThreadPoolOptions& threadpool_options,
+      ScopedStepContainer* step_container = nullptr);
+
+  // Returns the number of micro batches the step of a run is executed as,
+  // see OptimizerOptions.runtime_micro_batch.
+  int32 NumMicroBatches(const RunOptions& run_options) const;
+
+  // Runs the step as `num_micro_batches` executor runs that share a step
+  // container. The batch feeds, see RunOptions.micro_batch_split_feeds, are
+  // split along the first dimension, `call_frame` receives the outputs of the
+  // last micro batch.
+  ::tensorflow::Status RunMicroBatches(
+      int32 num_micro_batches, int64 step_id, const RunOptions& run_options,
+      gtl::ArraySlice<Tensor> feed_args, FunctionCallFrame* call_frame,
+      ExecutorsAndKeys* executors_and_keys, RunMetadata* run_metadata,
       const thread::ThreadPoolOptions& threadpool_options);
 
   // Returns whether enable tracking of tensorpool allocator
@@ -278,6 +308,10 @@ class DirectSession : public Session {
   ::tensorflow::Status ExtendLocked(GraphDef graph)
       EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
 
+  // Places `deferred_graph_`, if any, and creates `execution_state_` from it.
+  ::tensorflow::Status MaybeCreateExecutionStateLocked()
+      EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
   ::tensorflow::Status ResourceHandleToInputTensor(
       const Tensor& resource_tensor, Tensor* retrieved_tensor);
 
@@ -405,6 +439,16 @@ class DirectSession : public Session {
   std::unique_ptr<GraphExecutionState> execution_state_
       GUARDED_BY(graph_state_lock_);
 
+  // The session graph, until `execution_state_` is created from it. Creating
+  // the execution state places the whole graph, which is deferred while all
+  // the graphs built so far were found in `graph_cache_`.
+  std::unique_ptr<GraphDef> deferred_graph_ GUARDED_BY(graph_state_lock_);
+
+  // Persistent cache of partition graphs, or nullptr if disabled.
+  std::unique_ptr<PartitionedGraphCache> graph_cache_;
+  // Fingerprint of the graphs passed to Create() and Extend().
+  uint64 graph_fingerprint_ GUARDED_BY(graph_state_lock_) = 0;
+
   // The function library, before any rewrites or optimizations have been
   // performed. In particular, CreateGraphs() may need to modify the function
   // library; it copies and modifies the function library.
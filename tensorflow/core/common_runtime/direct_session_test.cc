@@ -42,7 +42,13 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -690,6 +696,66 @@ TEST_F(DirectSessionMinusAXTest, UseRunHandlerPool) {
   EXPECT_FLOAT_EQ(5.0, mat(0, 0));
 }
 
+// Returns the number of graph cache lookups with `result` ("hit" or "miss").
+int64 GraphCacheLookups(const string& result) {
+  monitoring::CollectionRegistry::CollectMetricsOptions options;
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics(options);
+  auto it = metrics->point_set_map.find("/tensorflow/core/graph_cache_lookups");
+  if (it == metrics->point_set_map.end()) return 0;
+  for (const auto& point : it->second->points) {
+    if (point->labels.size() == 1 && point->labels[0].value == result) {
+      return point->int64_value;
+    }
+  }
+  return 0;
+}
+
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithGraphCache) {
+  Initialize({3, 2, -1, 0});
+  const string cache_dir = io::JoinPath(
+      testing::TmpDir(),
+      strings::StrCat("graph_cache_", strings::FpToString(random::New64())));
+  setenv("TF_GRAPH_CACHE_DIR", cache_dir.c_str(), 1);
+
+  auto run_session = [this, &cache_dir](size_t expected_entries) {
+    auto session = CreateSession();
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(def_));
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {y_ + ":0"}, {y_neg_}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+
+    std::vector<string> entries;
+    TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+    EXPECT_EQ(expected_entries, entries.size());
+  };
+
+  // The first session builds and stores the graphs, the second one reads them
+  // back without placing the session graph.
+  const int64 hits = GraphCacheLookups("hit");
+  const int64 misses = GraphCacheLookups("miss");
+  run_session(1);
+  EXPECT_EQ(hits, GraphCacheLookups("hit"));
+  EXPECT_EQ(misses + 1, GraphCacheLookups("miss"));
+  run_session(1);
+  EXPECT_EQ(hits + 1, GraphCacheLookups("hit"));
+  EXPECT_EQ(misses + 1, GraphCacheLookups("miss"));
+
+  // Environment variables that switch graph rewrites are part of the key.
+  setenv("TF_GRAPH_CACHE_TEST_REWRITE", "1", 1);
+  run_session(2);
+  EXPECT_EQ(hits + 1, GraphCacheLookups("hit"));
+  EXPECT_EQ(misses + 2, GraphCacheLookups("miss"));
+  unsetenv("TF_GRAPH_CACHE_TEST_REWRITE");
+
+  unsetenv("TF_GRAPH_CACHE_DIR");
+  int64 undeleted_files, undeleted_dirs;
+  TF_EXPECT_OK(Env::Default()->DeleteRecursively(cache_dir, &undeleted_files,
+                                                 &undeleted_dirs));
+}
+
 TEST(DirectSessionTest, KeepsStateAcrossRunsOfSession) {
   GraphDef def;
   Graph g(OpRegistry::Global());
@@ -729,6 +795,174 @@ TEST(DirectSessionTest, KeepsStateAcrossRunsOfSession) {
   EXPECT_EQ(20.0, outputs[0].flat<float>()(0));
 }
 
+TEST(DirectSessionTest, RuntimeMicroBatchAccumulatesGradients) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+  Node* var = test::graph::Var(&g, DT_FLOAT, TensorShape({2}));
+  Node* init = test::graph::Assign(
+      &g, var, test::graph::Constant(&g, test::AsTensor<float>({0, 0})));
+
+  // The batch is fed, its column sums are the gradient of the variable.
+  Tensor batch(DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&batch, {1, 2, 3, 4, 5, 6, 7, 8});
+  Node* x = test::graph::Constant(&g, batch);
+  Node* grad =
+      test::graph::Reduce(&g, "Sum", x, test::graph::Constant(&g, Tensor(0)));
+  Node* apply = nullptr;
+  TF_ASSERT_OK(NodeBuilder("apply", "ApplyGradientDescent")
+                   .Input(var)
+                   .Input(test::graph::Constant(&g, Tensor(1.0f)))
+                   .Input(grad)
+                   .Finalize(&g, &apply));
+  g.ToGraphDef(&def);
+
+  SessionOptions options;
+  OptimizerOptions* optimizer_options =
+      options.config.mutable_graph_options()->mutable_optimizer_options();
+  optimizer_options->set_micro_batch_num(2);
+  optimizer_options->set_runtime_micro_batch(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {}, {init->name()}, &outputs));
+
+  Tensor fed(DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&fed, {1, 1, 2, 2, 3, 3, 4, 4});
+  TF_ASSERT_OK(session->Run({{x->name(), fed}}, {grad->name(), var->name()},
+                            {apply->name()}, &outputs));
+  ASSERT_EQ(2, outputs.size());
+  // Fetches are the results of the last micro batch.
+  test::ExpectTensorEqual<float>(outputs[0],
+                                 test::AsTensor<float>({7, 7}, {2}));
+
+  // The variable is updated once with the gradients of both micro batches.
+  TF_ASSERT_OK(session->Run({}, {var->name()}, {}, &outputs));
+  test::ExpectTensorEqual<float>(outputs[0],
+                                 test::AsTensor<float>({-10, -10}, {2}));
+
+  // The number of micro batches can be overridden per run.
+  RunOptions run_options;
+  run_options.set_micro_batch_num(4);
+  RunMetadata run_metadata;
+  TF_ASSERT_OK(session->Run(run_options, {{x->name(), fed}}, {grad->name()},
+                            {apply->name()}, &outputs, &run_metadata));
+  test::ExpectTensorEqual<float>(outputs[0],
+                                 test::AsTensor<float>({4, 4}, {2}));
+  TF_ASSERT_OK(session->Run({}, {var->name()}, {}, &outputs));
+  test::ExpectTensorEqual<float>(outputs[0],
+                                 test::AsTensor<float>({-20, -20}, {2}));
+}
+
+TEST(DirectSessionTest, RuntimeMicroBatchMergesDuplicateSparseIndices) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+  Node* var = test::graph::Var(&g, DT_FLOAT, TensorShape({3, 2}));
+  Node* init = test::graph::Assign(
+      &g, var,
+      test::graph::Constant(&g, test::AsTensor<float>({0, 0, 0, 0, 0, 0},
+                                                      {3, 2})));
+
+  // Row 2 is updated by both micro batches, and twice by the second one.
+  Node* grad = test::graph::Constant(&g, Tensor(DT_FLOAT, TensorShape({4, 2})));
+  Node* indices =
+      test::graph::Constant(&g, Tensor(DT_INT32, TensorShape({4})));
+  Node* apply = nullptr;
+  TF_ASSERT_OK(NodeBuilder("apply", "SparseApplyProximalGradientDescent")
+                   .Input(var)
+                   .Input(test::graph::Constant(&g, Tensor(1.0f)))
+                   .Input(test::graph::Constant(&g, Tensor(1.0f)))
+                   .Input(test::graph::Constant(&g, Tensor(0.0f)))
+                   .Input(grad)
+                   .Input(indices)
+                   .Finalize(&g, &apply));
+  g.ToGraphDef(&def);
+
+  SessionOptions options;
+  OptimizerOptions* optimizer_options =
+      options.config.mutable_graph_options()->mutable_optimizer_options();
+  optimizer_options->set_micro_batch_num(2);
+  optimizer_options->set_runtime_micro_batch(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {}, {init->name()}, &outputs));
+
+  TF_ASSERT_OK(session->Run(
+      {{grad->name(),
+        test::AsTensor<float>({4, 4, 2, 2, 3, 3, 5, 5}, {4, 2})},
+       {indices->name(), test::AsTensor<int32>({0, 2, 2, 2})}},
+      {}, {apply->name()}, &outputs));
+
+  // The rows of duplicate indices are summed over the micro batches before a
+  // single proximal step, which shrinks every updated row once by l1. Applying
+  // the micro batches or duplicates one after the other would give -7 for
+  // row 2.
+  TF_ASSERT_OK(session->Run({}, {var->name()}, {}, &outputs));
+  test::ExpectTensorEqual<float>(
+      outputs[0], test::AsTensor<float>({-3, -3, 0, 0, -9, -9}, {3, 2}));
+}
+
+TEST(DirectSessionTest, RuntimeMicroBatchSplitsNamedFeeds) {
+  GraphDef def;
+  Graph g(OpRegistry::Global());
+  Node* var = test::graph::Var(&g, DT_FLOAT, TensorShape({2}));
+  Node* init = test::graph::Assign(
+      &g, var, test::graph::Constant(&g, test::AsTensor<float>({0, 0})));
+
+  // The batch x and the per-column scale are both fed, the scale happens to
+  // have as many rows as every micro batch.
+  Node* x = test::graph::Constant(&g, Tensor(DT_FLOAT, TensorShape({4, 2})));
+  Node* scale = test::graph::Constant(&g, Tensor(DT_FLOAT, TensorShape({2})));
+  Node* sum =
+      test::graph::Reduce(&g, "Sum", x, test::graph::Constant(&g, Tensor(0)));
+  Node* grad = test::graph::Binary(&g, "Mul", sum, scale);
+  Node* apply = nullptr;
+  TF_ASSERT_OK(NodeBuilder("apply", "ApplyGradientDescent")
+                   .Input(var)
+                   .Input(test::graph::Constant(&g, Tensor(1.0f)))
+                   .Input(grad)
+                   .Finalize(&g, &apply));
+  g.ToGraphDef(&def);
+
+  SessionOptions options;
+  OptimizerOptions* optimizer_options =
+      options.config.mutable_graph_options()->mutable_optimizer_options();
+  optimizer_options->set_micro_batch_num(2);
+  optimizer_options->set_runtime_micro_batch(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {}, {init->name()}, &outputs));
+
+  std::vector<std::pair<string, Tensor>> inputs = {
+      {x->name(), test::AsTensor<float>({1, 1, 2, 2, 3, 3, 4, 4}, {4, 2})},
+      {scale->name(), test::AsTensor<float>({1, 2})}};
+  RunOptions run_options;
+  RunMetadata run_metadata;
+
+  // By default every non-scalar feed is split, so the batch is ambiguous.
+  Status s = session->Run(run_options, inputs, {}, {apply->name()}, &outputs,
+                          &run_metadata);
+  EXPECT_TRUE(errors::IsInvalidArgument(s));
+  EXPECT_TRUE(absl::StrContains(s.error_message(), "micro_batch_split_feeds"))
+      << s;
+
+  run_options.add_micro_batch_split_feeds(x->name());
+  TF_ASSERT_OK(session->Run(run_options, inputs, {}, {apply->name()},
+                            &outputs, &run_metadata));
+  TF_ASSERT_OK(session->Run({}, {var->name()}, {}, &outputs));
+  test::ExpectTensorEqual<float>(outputs[0],
+                                 test::AsTensor<float>({-10, -20}, {2}));
+
+  run_options.add_micro_batch_split_feeds("unknown");
+  s = session->Run(run_options, inputs, {}, {apply->name()}, &outputs,
+                   &run_metadata);
+  EXPECT_TRUE(errors::IsInvalidArgument(s));
+}
+
 TEST(DirectSessionTest, MultipleFeedTest) {
   GraphDef def;
   Graph g(OpRegistry::Global());
@@ -2509,6 +2743,127 @@ void BM_FeedFetchCallable(int iters, int num_feeds) {
 BENCHMARK(BM_FeedFetch)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 BENCHMARK(BM_FeedFetchCallable)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 
+// Time and peak CPU memory to create a session and run the first training
+// step with micro batches built by graph duplication (runtime = 0) or by
+// running the executors once per micro batch (runtime = 1). The step
+// applies Adagrad, for which graph duplication is enabled.
+void BM_MicroBatchFirstStep(int iters, int runtime, int num_layers) {
+  testing::StopTiming();
+  constexpr int kMicroBatches = 4;
+  constexpr int64 kBatchSize = 256;
+  constexpr int64 kDim = 64;
+  Graph g(OpRegistry::Global());
+  Tensor batch(DT_FLOAT, TensorShape({kBatchSize, kDim}));
+  batch.flat<float>().setRandom();
+  Tensor initial_accum(DT_FLOAT, TensorShape({kDim, kDim}));
+  initial_accum.flat<float>().setConstant(0.1f);
+  Node* lr = test::graph::Constant(&g, Tensor(0.01f));
+  Node* h = test::graph::Constant(&g, batch);
+  std::vector<string> init_targets;
+  std::vector<string> train_targets;
+  for (int i = 0; i < num_layers; ++i) {
+    Tensor initial_weights(DT_FLOAT, TensorShape({kDim, kDim}));
+    initial_weights.flat<float>().setRandom();
+    Node* weights = test::graph::Var(&g, DT_FLOAT, TensorShape({kDim, kDim}));
+    Node* accum = test::graph::Var(&g, DT_FLOAT, TensorShape({kDim, kDim}));
+    init_targets.push_back(
+        test::graph::Assign(&g, weights,
+                            test::graph::Constant(&g, initial_weights))
+            ->name());
+    init_targets.push_back(
+        test::graph::Assign(&g, accum,
+                            test::graph::Constant(&g, initial_accum))
+            ->name());
+    Node* out = test::graph::Matmul(&g, h, weights, false, false);
+    Node* grad = test::graph::Matmul(&g, h, out, true, false);
+    Node* apply = nullptr;
+    TF_CHECK_OK(NodeBuilder(g.NewName("apply"), "ApplyAdagrad")
+                    .Input(weights)
+                    .Input(accum)
+                    .Input(lr)
+                    .Input(grad)
+                    .Finalize(&g, &apply));
+    train_targets.push_back(apply->name());
+    h = out;
+  }
+  GraphDef def;
+  g.ToGraphDef(&def);
+
+  SessionOptions options;
+  OptimizerOptions* optimizer_options =
+      options.config.mutable_graph_options()->mutable_optimizer_options();
+  optimizer_options->set_micro_batch_num(kMicroBatches);
+  optimizer_options->set_runtime_micro_batch(runtime != 0);
+  EnableCPUAllocatorStats(true);
+  int64 peak_bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    cpu_allocator()->ClearStats();
+    testing::StartTiming();
+    std::unique_ptr<Session> session(NewSession(options));
+    TF_CHECK_OK(session->Create(def));
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {}, init_targets, &outputs));
+    TF_CHECK_OK(session->Run({}, {}, train_targets, &outputs));
+    testing::StopTiming();
+    absl::optional<AllocatorStats> stats = cpu_allocator()->GetStats();
+    if (stats) peak_bytes = std::max(peak_bytes, stats->peak_bytes_in_use);
+  }
+  EnableCPUAllocatorStats(false);
+  testing::SetLabel(strings::StrCat("peak_bytes=", peak_bytes));
+}
+
+BENCHMARK(BM_MicroBatchFirstStep)
+    ->ArgPair(0, 8)
+    ->ArgPair(1, 8)
+    ->ArgPair(0, 64)
+    ->ArgPair(1, 64);
+
+// Time to create a session and run the first step of a graph of
+// 'num_nodes' scalar additions, which covers graph import, placement and
+// partitioning. The nodes, the devices of the colocation groups and the
+// partitions are prepared on the 'num_threads' inter-op threads.
+void BM_SessionCreation(int iters, int num_nodes, int num_threads) {
+  testing::StopTiming();
+  Graph g(OpRegistry::Global());
+  random::PhiloxRandom philox(17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<Node*> nodes;
+  for (int i = 0; i < num_nodes; ++i) {
+    if (i < 2) {
+      nodes.push_back(test::graph::Constant(&g, Tensor(1.0f)));
+    } else {
+      nodes.push_back(test::graph::Binary(&g, "Add", nodes[i - 1],
+                                          nodes[rnd.Uniform(i)]));
+    }
+  }
+  GraphDef def;
+  g.ToGraphDef(&def);
+  const string target = nodes.back()->name();
+
+  SessionOptions options;
+  options.config.set_inter_op_parallelism_threads(num_threads);
+  // Constant folding would dominate the time.
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  for (int i = 0; i < iters; ++i) {
+    testing::StartTiming();
+    std::unique_ptr<Session> session(NewSession(options));
+    TF_CHECK_OK(session->Create(def));
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {}, {target}, &outputs));
+    testing::StopTiming();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_nodes);
+}
+
+BENCHMARK(BM_SessionCreation)
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 16);
+
 }  // namespace
 
 class DirectSessionCollectiveTest : public ::testing::Test {
@@ -0,0 +1,174 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/graph_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/env_var.h"
+
+extern char** environ;
+
+namespace tensorflow {
+
+namespace {
+
+// Graph rewrite switches read from the environment that lack the TF_ prefix.
+constexpr const char* kRewriteEnvVars[] = {
+    "INFERENCE_MODE", "ENABLE_STAGE_PACK_TRANS", "TARGET_NODES_NAME",
+    "TASK_INDEX"};
+
+// TF_ variables that cannot change the graphs.
+constexpr const char* kIgnoredEnvVars[] = {
+    "TF_GRAPH_CACHE_DIR", "TF_CPP_MIN_LOG_LEVEL", "TF_CPP_MIN_VLOG_LEVEL",
+    "TF_CPP_VMODULE", "TF_DUMP_GRAPH_PREFIX"};
+
+bool IsRewriteEnvVar(StringPiece name) {
+  for (const char* ignored : kIgnoredEnvVars) {
+    if (name == ignored) return false;
+  }
+  if (str_util::StartsWith(name, "TF_")) return true;
+  for (const char* var : kRewriteEnvVars) {
+    if (name == var) return true;
+  }
+  return false;
+}
+
+uint64 FingerprintProto(const protobuf::MessageLite& msg) {
+  string serialized;
+  SerializeToStringDeterministic(msg, &serialized);
+  return Fingerprint64(serialized);
+}
+
+}  // namespace
+
+/* static */ std::unique_ptr<PartitionedGraphCache>
+PartitionedGraphCache::FromEnv(Env* env) {
+  string directory;
+  Status s = ReadStringFromEnvVar("TF_GRAPH_CACHE_DIR", "", &directory);
+  if (!s.ok()) {
+    LOG(WARNING) << "Graph cache is disabled: " << s.error_message();
+    return nullptr;
+  }
+  if (directory.empty()) {
+    return nullptr;
+  }
+  s = env->RecursivelyCreateDir(directory);
+  if (!s.ok() && !errors::IsAlreadyExists(s)) {
+    LOG(WARNING) << "Graph cache is disabled, failed to create " << directory
+                 << ": " << s.error_message();
+    return nullptr;
+  }
+  return std::unique_ptr<PartitionedGraphCache>(
+      new PartitionedGraphCache(env, directory));
+}
+
+PartitionedGraphCache::PartitionedGraphCache(Env* env, const string& directory)
+    : env_(env), directory_(directory) {}
+
+/* static */ uint64 PartitionedGraphCache::FingerprintGraph(
+    const GraphDef& graph) {
+  return FingerprintProto(graph);
+}
+
+/* static */ uint64 PartitionedGraphCache::ExtendGraphFingerprint(
+    uint64 fingerprint, const GraphDef& graph) {
+  return FingerprintCat64(fingerprint, FingerprintGraph(graph));
+}
+
+/* static */ string PartitionedGraphCache::GraphKey(
+    uint64 graph_fingerprint, const ConfigProto& config,
+    const DeviceSet& device_set, const BuildGraphOptions& build_options) {
+  uint64 fp = FingerprintCat64(graph_fingerprint, FingerprintProto(config));
+  for (const Device* d : device_set.devices()) {
+    fp = FingerprintCat64(fp, Fingerprint64(d->name()));
+    fp = FingerprintCat64(fp, Fingerprint64(d->attributes().device_type()));
+    fp = FingerprintCat64(
+        fp, Fingerprint64(d->attributes().physical_device_desc()));
+  }
+  fp = FingerprintCat64(fp, FingerprintProto(build_options.callable_options));
+  fp = FingerprintCat64(
+      fp, Fingerprint64(strings::StrCat(
+              build_options.use_function_convention, ",",
+              build_options.collective_graph_key, ",",
+              static_cast<int>(build_options.collective_order))));
+  fp = FingerprintCat64(fp, Fingerprint64(RewriteEnvironment()));
+  fp = FingerprintCat64(fp, Fingerprint64(RuntimeVersion()));
+  return strings::FpToString(fp);
+}
+
+/* static */ string PartitionedGraphCache::RuntimeVersion() {
+  return strings::StrCat(TF_VERSION_STRING, "/", tf_git_version(), "/",
+                         TF_GRAPH_DEF_VERSION);
+}
+
+/* static */ string PartitionedGraphCache::RewriteEnvironment() {
+  std::vector<string> vars;
+  for (char** env = environ; env != nullptr && *env != nullptr; ++env) {
+    StringPiece var(*env);
+    if (IsRewriteEnvVar(var.substr(0, var.find('=')))) {
+      vars.emplace_back(var);
+    }
+  }
+  std::sort(vars.begin(), vars.end());
+  return absl::StrJoin(vars, "\n");
+}
+
+string PartitionedGraphCache::EntryPath(const string& key) const {
+  return io::JoinPath(directory_, strings::StrCat(key, ".graphs.pb"));
+}
+
+Status PartitionedGraphCache::Lookup(const string& key,
+                                     PartitionedGraphCacheEntry* entry) {
+  const string path = EntryPath(key);
+  if (!env_->FileExists(path).ok()) {
+    return errors::NotFound("No cached graphs at ", path);
+  }
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env_, path, entry));
+  if (entry->version() != RuntimeVersion()) {
+    return errors::NotFound("Cached graphs at ", path, " were built by ",
+                            entry->version(), ", current runtime is ",
+                            RuntimeVersion());
+  }
+  return Status::OK();
+}
+
+Status PartitionedGraphCache::Insert(const string& key,
+                                     PartitionedGraphCacheEntry* entry) {
+  entry->set_version(RuntimeVersion());
+  const string path = EntryPath(key);
+  const string tmp_path =
+      strings::StrCat(path, ".tmp.", strings::FpToString(random::New64()));
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env_, tmp_path, *entry));
+  Status s = env_->RenameFile(tmp_path, path);
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+  }
+  return s;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,87 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_GRAPH_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/common_runtime/build_graph_options.h"
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/graph_cache.pb.h"
+
+namespace tensorflow {
+
+// A directory of optimized, placed and partitioned graphs built by
+// DirectSession, keyed by a fingerprint of everything the graphs depend on:
+// the input graph, the session config, the devices, the feeds, fetches and
+// targets, the environment variables that switch graph rewrites, and the
+// runtime version. Restarted training or serving jobs reuse the graphs instead
+// of running placement, Grappler and partitioning again.
+//
+// The cache is enabled by setting TF_GRAPH_CACHE_DIR to a local directory.
+class PartitionedGraphCache {
+ public:
+  // Returns a cache in the directory named by TF_GRAPH_CACHE_DIR, or nullptr
+  // if the variable is not set.
+  static std::unique_ptr<PartitionedGraphCache> FromEnv(Env* env);
+
+  PartitionedGraphCache(Env* env, const string& directory);
+
+  // Returns the fingerprint of a graph, to be folded into `GraphKey` with
+  // `ExtendGraphFingerprint` as the session graph is created and extended.
+  static uint64 FingerprintGraph(const GraphDef& graph);
+  static uint64 ExtendGraphFingerprint(uint64 fingerprint,
+                                       const GraphDef& graph);
+
+  // Returns the key of the graphs built for `build_options` from a session
+  // graph with fingerprint `graph_fingerprint`.
+  static string GraphKey(uint64 graph_fingerprint, const ConfigProto& config,
+                         const DeviceSet& device_set,
+                         const BuildGraphOptions& build_options);
+
+  // Reads the entry stored under `key`. Returns NotFound if there is none or
+  // if it was written by another runtime version.
+  Status Lookup(const string& key, PartitionedGraphCacheEntry* entry);
+
+  // Stores `entry` under `key`. The file is written under a temporary name and
+  // renamed, so concurrent readers never see a partial entry.
+  Status Insert(const string& key, PartitionedGraphCacheEntry* entry);
+
+  // Returns the version string stored in entries.
+  static string RuntimeVersion();
+
+  // Returns the sorted NAME=value pairs of the environment variables that may
+  // change the graphs: every TF_ variable but the logging ones and the cache
+  // directory, and the few rewrite switches without the TF_ prefix.
+  static string RewriteEnvironment();
+
+  const string& directory() const { return directory_; }
+
+ private:
+  string EntryPath(const string& key) const;
+
+  Env* const env_;
+  const string directory_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_GRAPH_CACHE_H_
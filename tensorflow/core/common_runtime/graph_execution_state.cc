@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/framework/graph.pb_text.h"
 #include "tensorflow/core/framework/graph_def_util.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
@@ -42,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/graph/collective_order.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/subgraph.h"
 #include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/graph/validate.h"
@@ -78,6 +80,7 @@ GraphExecutionState::GraphExecutionState(
       device_set_(options.device_set),
       session_options_(options.session_options),
       session_handle_(options.session_handle),
+      thread_pool_(options.thread_pool),
       flib_def_(std::move(flib_def)),
       graph_(nullptr) {}
 
@@ -98,6 +101,8 @@ GraphExecutionState::~GraphExecutionState() {
 
   TF_RETURN_IF_ERROR(AddDefaultAttrsToGraphDef(&graph_def, *flib_def, 0));
 
+  GraphConstructorOptions opts;
+  opts.thread_pool = options.thread_pool;
   if (options.session_options->config.graph_options().place_pruned_graph() ||
       !options.session_options->config.experimental()
            .optimize_for_static_graph()) {
@@ -110,8 +115,8 @@ GraphExecutionState::~GraphExecutionState() {
     // construct a Graph* in this case.
     if (!options.session_options->config.graph_options().place_pruned_graph()) {
       auto base_graph = absl::make_unique<Graph>(OpRegistry::Global());
-      TF_RETURN_IF_ERROR(ConvertGraphDefToGraph({}, *ret->original_graph_def_,
-                                                base_graph.get()));
+      TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
+          opts, *ret->original_graph_def_, base_graph.get()));
       TF_RETURN_IF_ERROR(ret->InitBaseGraph(std::move(base_graph)));
     }
     *out_state = std::move(ret);
@@ -120,7 +125,7 @@ GraphExecutionState::~GraphExecutionState() {
         new GraphExecutionState(nullptr, std::move(flib_def), options));
     auto base_graph = absl::make_unique<Graph>(OpRegistry::Global());
     TF_RETURN_IF_ERROR(
-        ConvertGraphDefToGraph({}, std::move(graph_def), base_graph.get()));
+        ConvertGraphDefToGraph(opts, std::move(graph_def), base_graph.get()));
     TF_RETURN_IF_ERROR(ret->InitBaseGraph(std::move(base_graph)));
     *out_state = std::move(ret);
   }
@@ -164,8 +169,10 @@ GraphExecutionState::~GraphExecutionState() {
       new GraphExecutionState(nullptr, std::move(flib_def), options));
 
   auto base_graph = absl::make_unique<Graph>(OpRegistry::Global());
+  GraphConstructorOptions opts;
+  opts.thread_pool = options.thread_pool;
   TF_RETURN_IF_ERROR(
-      ConvertGraphDefToGraph({}, std::move(temp), base_graph.get()));
+      ConvertGraphDefToGraph(opts, std::move(temp), base_graph.get()));
 
   // Rewrite the graph before placement.
   ret->rewrite_metadata_.reset(new subgraph::RewriteGraphMetadata);
@@ -261,6 +268,7 @@ Status GraphExecutionState::Extend(
   combined_options.session_options = session_options_;
   combined_options.session_handle = session_handle_;
   combined_options.stateful_placements = stateful_placements_;
+  combined_options.thread_pool = thread_pool_;
 
   TF_RETURN_IF_ERROR(AddDefaultAttrsToGraphDef(&gdef, *flib_def_, 0));
   auto flib_def = absl::make_unique<FunctionLibraryDefinition>(
@@ -271,8 +279,10 @@ Status GraphExecutionState::Extend(
 
   if (!session_options_->config.graph_options().place_pruned_graph()) {
     auto base_graph = absl::make_unique<Graph>(OpRegistry::Global());
+    GraphConstructorOptions opts;
+    opts.thread_pool = thread_pool_;
     TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(
-        {}, *new_execution_state->original_graph_def_, base_graph.get()));
+        opts, *new_execution_state->original_graph_def_, base_graph.get()));
     TF_RETURN_IF_ERROR(
         new_execution_state->InitBaseGraph(std::move(base_graph)));
   }
@@ -652,6 +662,115 @@ Status GraphExecutionState::PipelineGraph(std::unique_ptr<Graph>* g,
   return Status::OK();
 }
 
+namespace {
+// Returns the input index of the single tensor argument `arg` of `n`, or -1.
+int InputArgIndex(const Node* n, const string& arg) {
+  NameRangeMap inputs;
+  if (!NameRangesForNode(*n, n->op_def(), &inputs, nullptr).ok()) {
+    return -1;
+  }
+  auto it = inputs.find(arg);
+  if (it == inputs.end() || it->second.second != it->second.first + 1) {
+    return -1;
+  }
+  return it->second.first;
+}
+
+// Optimizer apply ops update their first input `var` from `grad`, or `delta`
+// for ApplyGradientDescent.
+int GradientInputIndex(const Node* n) {
+  const OpDef& op_def = n->op_def();
+  if (op_def.input_arg_size() == 0 || op_def.input_arg(0).name() != "var") {
+    return -1;
+  }
+  int index = InputArgIndex(n, "grad");
+  return index >= 0 ? index : InputArgIndex(n, "delta");
+}
+
+// Routes output `src_output` of `src` through a Switch on `pred` into input
+// `dst_input` of `dst`, which then only runs in the last micro batch.
+Status SwitchInput(Graph* graph, Node* src, int src_output, Node* pred,
+                   Node* dst, int dst_input) {
+  Node* switch_node = nullptr;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(graph->NewName(strings::StrCat(dst->name(),
+                                                 "/micro_batch_switch")),
+                  "Switch")
+          .Input(src, src_output)
+          .Input(pred, pred->num_outputs() - 1)
+          .Device(dst->assigned_device_name())
+          .Finalize(graph, &switch_node));
+  switch_node->set_assigned_device_name(dst->assigned_device_name());
+  const Edge* edge = nullptr;
+  TF_RETURN_IF_ERROR(dst->input_edge(dst_input, &edge));
+  graph->RemoveEdge(edge);
+  graph->AddEdge(switch_node, 1, dst, dst_input);
+  return Status::OK();
+}
+}  // namespace
+
+Status GraphExecutionState::MicroBatchGraph(Graph* graph) {
+  std::vector<Node*> apply_nodes;
+  for (Node* n : graph->op_nodes()) {
+    if (GradientInputIndex(n) >= 0) apply_nodes.push_back(n);
+  }
+  for (Node* n : apply_nodes) {
+    DeviceNameUtils::ParsedName device;
+    if (!DeviceNameUtils::ParseFullName(n->assigned_device_name(), &device) ||
+        device.type != DEVICE_CPU) {
+      return errors::Unimplemented(
+          "Runtime micro batching only supports apply ops on CPU, ",
+          n->name(), " is placed on ", n->assigned_device_name());
+    }
+    const int grad_index = GradientInputIndex(n);
+    const int indices_index = InputArgIndex(n, "indices");
+    const int counts_index = InputArgIndex(n, "indices_counts");
+    const Edge* grad = nullptr;
+    TF_RETURN_IF_ERROR(n->input_edge(grad_index, &grad));
+    const string name = graph->NewName(
+        strings::StrCat(n->name(), "/micro_batch_accumulate"));
+
+    Node* accumulate = nullptr;
+    if (indices_index < 0) {
+      TF_RETURN_IF_ERROR(
+          NodeBuilder(name, "_MicroBatchAccumulate")
+              .Input(grad->src(), grad->src_output())
+              .Device(n->assigned_device_name())
+              .Finalize(graph, &accumulate));
+    } else {
+      const Edge* indices = nullptr;
+      TF_RETURN_IF_ERROR(n->input_edge(indices_index, &indices));
+      std::vector<NodeBuilder::NodeOut> counts;
+      if (counts_index >= 0) {
+        const Edge* counts_edge = nullptr;
+        TF_RETURN_IF_ERROR(n->input_edge(counts_index, &counts_edge));
+        counts.emplace_back(counts_edge->src(), counts_edge->src_output());
+      }
+      TF_RETURN_IF_ERROR(
+          NodeBuilder(name, "_MicroBatchSparseAccumulate")
+              .Input(grad->src(), grad->src_output())
+              .Input(indices->src(), indices->src_output())
+              .Input(counts)
+              .Device(n->assigned_device_name())
+              .Finalize(graph, &accumulate));
+    }
+    accumulate->set_assigned_device_name(n->assigned_device_name());
+
+    TF_RETURN_IF_ERROR(
+        SwitchInput(graph, accumulate, 0, accumulate, n, grad_index));
+    if (indices_index >= 0) {
+      TF_RETURN_IF_ERROR(
+          SwitchInput(graph, accumulate, 1, accumulate, n, indices_index));
+    }
+    if (counts_index >= 0) {
+      TF_RETURN_IF_ERROR(
+          SwitchInput(graph, accumulate, 2, accumulate, n, counts_index));
+    }
+    VLOG(2) << "Accumulate gradients of " << n->name() << " over micro batches";
+  }
+  return Status::OK();
+}
+
 Status GraphExecutionState::InitBaseGraph(std::unique_ptr<Graph>&& new_graph) {
   // Save stateful placements before placing.
   RestoreStatefulNodes(new_graph.get());
@@ -711,7 +830,8 @@ Status GraphExecutionState::InitBaseGraph(std::unique_ptr<Graph>&& new_graph) {
                 session_options_ == nullptr ||
                     session_options_->config.allow_soft_placement(),
                 session_options_ != nullptr &&
-                    session_options_->config.log_device_placement());
+                    session_options_->config.log_device_placement(),
+                thread_pool_);
   // TODO(mrry): Consider making the Placer cancelable.
   TF_RETURN_IF_ERROR(placer.Run());
 
@@ -724,7 +844,12 @@ Status GraphExecutionState::InitBaseGraph(std::unique_ptr<Graph>&& new_graph) {
   }
 
   int32 micro_batch_num = session_optimizer_options.micro_batch_num();
-  if (micro_batch_num > 1) {
+  if (session_optimizer_options.runtime_micro_batch()) {
+    // The micro batches are executed by the session, the count can change
+    // per run without rebuilding the graph.
+    VLOG(2) << "RUN Graph Optimization: Runtime Micro Batch";
+    TF_RETURN_IF_ERROR(MicroBatchGraph(new_graph.get()));
+  } else if (micro_batch_num > 1) {
     VLOG(2) << "RUN Graph Optimization: Runtime Pipeline";
     PipelineGraph(&new_graph, micro_batch_num);
   }
@@ -860,6 +985,7 @@ Status GraphExecutionState::OptimizeGraph(
 
     GraphConstructorOptions opts;
     opts.allow_internal_ops = true;
+    opts.thread_pool = thread_pool_;
     TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(opts, std::move(new_graph),
                                               optimized_graph->get()));
     // The graph conversion sets the requested device names but not the
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/graph/costmodel.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 
@@ -47,6 +48,9 @@ struct GraphExecutionStateOptions {
   // A map from node name to device name, representing the unchangeable
   // placement of stateful nodes.
   std::unordered_map<string, string> stateful_placements;
+  // If set, graph construction and placement prepare the nodes on this pool.
+  // Not owned.
+  thread::ThreadPool* thread_pool = nullptr;
 };
 
 // A ClientGraph is simply a sub-graph of the full graph as induced by
@@ -181,6 +185,10 @@ class GraphExecutionState {
 
   Status PipelineGraph(std::unique_ptr<Graph>* graph, int32 micro_batch_num);
 
+  // Inserts gradient accumulators in front of the apply ops for runtime
+  // micro batching, see OptimizerOptions.runtime_micro_batch.
+  Status MicroBatchGraph(Graph* graph);
+
   Status OptimizeGraph(
       const BuildGraphOptions& options, std::unique_ptr<Graph>* optimized_graph,
       std::unique_ptr<FunctionLibraryDefinition>* optimized_flib);
@@ -197,6 +205,7 @@ class GraphExecutionState {
   const SessionOptions* session_options_;  // Not owned
   // Unique session identifier. Can be empty.
   string session_handle_;
+  thread::ThreadPool* thread_pool_;  // Not owned
 
   // Map from name to Node for the full graph in placed_.
   NodeNameToCostIdMap node_name_to_cost_id_map_;
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
 
 namespace tensorflow {
@@ -61,6 +62,21 @@ auto* tf_data_elements_counter = monitoring::Counter<1>::New(
 auto* tf_data_optimization_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/optimization", "tf.data optimization", "name");
 
+auto* tf_data_streaming_buffered_bytes_gauge = monitoring::Gauge<int64, 1>::New(
+    "/tensorflow/data/streaming/buffered_bytes",
+    "The number of bytes buffered by a streaming tf.data stage.", "name");
+
+auto* tf_data_streaming_lag_gauge = monitoring::Gauge<int64, 1>::New(
+    "/tensorflow/data/streaming/lag_ms",
+    "The wall-clock minus sample time of the last element produced by a "
+    "streaming tf.data stage, in milliseconds.",
+    "name");
+
+auto* tf_data_streaming_dropped_counter = monitoring::Counter<1>::New(
+    "/tensorflow/data/streaming/dropped_elements",
+    "The number of stale elements dropped by a streaming tf.data stage.",
+    "name");
+
 auto* build_graph_calls = monitoring::Counter<0>::New(
     "/tensorflow/core/graph_build_calls",
     "The number of times TensorFlow has created a new client graph. "
@@ -87,6 +103,19 @@ auto* xla_compilation_time_usecs = monitoring::Counter<0>::New(
     "/tensorflow/core/xla_compilation_time_usecs",
     "The total time spent on compiling XLA graphs in microseconds.");
 
+auto* graph_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/graph_cache_lookups",
+    "The number of times a DirectSession looked up its persistent graph "
+    "cache, by result (hit or miss).",
+    "result");
+
+auto* graph_cache_create_graphs_time_usecs = monitoring::Counter<1>::New(
+    "/tensorflow/core/graph_cache_create_graphs_time_usecs",
+    "The time spent creating the partition graphs of a DirectSession with the "
+    "persistent graph cache enabled, in microseconds, by cache lookup result "
+    "(hit or miss).",
+    "result");
+
 }  // namespace
 
 void RecordTFDataAutotune(const string& name) {
@@ -105,6 +134,18 @@ void RecordTFDataOptimization(const string& name, int64 num_changes) {
   tf_data_optimization_counter->GetCell(name)->IncrementBy(num_changes);
 }
 
+void RecordTFDataStreamingBufferedBytes(const string& name, int64 num_bytes) {
+  tf_data_streaming_buffered_bytes_gauge->GetCell(name)->Set(num_bytes);
+}
+
+void RecordTFDataStreamingLag(const string& name, int64 lag_ms) {
+  tf_data_streaming_lag_gauge->GetCell(name)->Set(lag_ms);
+}
+
+void RecordTFDataStreamingDropped(const string& name, int64 num_elements) {
+  tf_data_streaming_dropped_counter->GetCell(name)->IncrementBy(num_elements);
+}
+
 void RecordGraphInputTensors(const size_t size) {
   graph_run_input_tensor_bytes->GetCell()->Add(size);
 }
@@ -128,6 +169,13 @@ void UpdateGraphBuildTime(const uint64 running_time_usecs) {
   }
 }
 
+void RecordGraphCacheLookup(bool hit, const uint64 running_time_usecs) {
+  const char* result = hit ? "hit" : "miss";
+  graph_cache_lookups->GetCell(result)->IncrementBy(1);
+  graph_cache_create_graphs_time_usecs->GetCell(result)->IncrementBy(
+      running_time_usecs);
+}
+
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs) {
   if (compilation_time_usecs > 0) {
     xla_compilations->GetCell()->IncrementBy(1);
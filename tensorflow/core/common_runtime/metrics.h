@@ -43,6 +43,21 @@ void RecordTFDataElements(const string& name, int64 num_elements);
 // The `name` argument identifies the optimization (e.g. "noop_eliminiation").
 void RecordTFDataOptimization(const string& name, int64 num_changes);
 
+// Records the number of bytes buffered by a streaming tf.data stage.
+//
+// The `name` argument identifies the Dataset node (e.g. the node name of a
+// "StreamingWindowDataset").
+void RecordTFDataStreamingBufferedBytes(const string& name, int64 num_bytes);
+
+// Records the event-time lag in milliseconds of the last element produced by a
+// streaming tf.data stage, i.e. the difference between the wall clock and the
+// element's sample time.
+void RecordTFDataStreamingLag(const string& name, int64 lag_ms);
+
+// Records the number of elements discarded by a streaming tf.data stage
+// because they were too old.
+void RecordTFDataStreamingDropped(const string& name, int64 num_elements);
+
 // Records the size of input/output tensors in bytes.
 void RecordGraphInputTensors(const size_t size);
 void RecordGraphOutputTensors(const size_t size);
@@ -64,6 +79,10 @@ void UpdateGraphExecTime(const uint64 running_time_usecs);
 // TODO(jtkeeling): Should we record building/optimizing tf.functions?
 void UpdateGraphBuildTime(const uint64 running_time_usecs);
 
+// Records a lookup of the persistent graph cache of DirectSession, and the
+// time spent creating the partition graphs, with or without the cache.
+void RecordGraphCacheLookup(bool hit, const uint64 running_time_usecs);
+
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
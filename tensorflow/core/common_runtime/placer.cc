@@ -75,14 +75,16 @@ Status AssignAndLog(int assigned_device, Node* node,
 Placer::Placer(Graph* graph, const string& function_name,
                const FunctionLibraryDefinition* flib_def,
                const DeviceSet* devices, const Device* default_local_device,
-               bool allow_soft_placement, bool log_device_placement)
+               bool allow_soft_placement, bool log_device_placement,
+               thread::ThreadPool* thread_pool)
     : graph_(graph),
       function_name_(function_name),
       flib_def_(flib_def),
       devices_(devices),
       default_local_device_(default_local_device),
       allow_soft_placement_(allow_soft_placement),
-      log_device_placement_(log_device_placement) {}
+      log_device_placement_(log_device_placement),
+      thread_pool_(thread_pool) {}
 
 Placer::Placer(Graph* graph, const string& function_name,
                const DeviceSet* devices, const Device* default_local_device)
@@ -151,6 +153,9 @@ Status Placer::Run() {
                                    log_device_placement_);
 
   TF_RETURN_IF_ERROR(colocation_graph.Initialize());
+  if (thread_pool_ != nullptr) {
+    colocation_graph.PrecomputePossibleDevices(thread_pool_);
+  }
 
   // For each node, assign a device based on the constraints in the disjoint
   // node set.
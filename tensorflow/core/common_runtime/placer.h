@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session_options.h"
@@ -66,12 +67,16 @@ class Placer {
   // would otherwise be higher priority. default_local_device should be on the
   // local host so that its FLR is directly accessible by the current process.
   //
-  // The "graph", "devices", and "default_local_device" pointer arguments are
-  // borrowed by this Placer, and must outlive it.
+  // If non-null, the possible devices of the colocation groups are computed
+  // on thread_pool. The placement doesn't depend on it.
+  //
+  // The "graph", "devices", "default_local_device" and "thread_pool" pointer
+  // arguments are borrowed by this Placer, and must outlive it.
   Placer(Graph* graph, const string& function_name,
          const FunctionLibraryDefinition* flib_def, const DeviceSet* devices,
          const Device* default_local_device, bool allow_soft_placement,
-         bool log_device_placement);
+         bool log_device_placement,
+         thread::ThreadPool* thread_pool = nullptr);
 
   Placer(Graph* graph, const string& function_name, const DeviceSet* devices,
          const Device* default_local_device);
@@ -100,6 +105,7 @@ class Placer {
   const Device* default_local_device_;               // Not owned.
   const bool allow_soft_placement_;
   const bool log_device_placement_;
+  thread::ThreadPool* const thread_pool_;  // Not owned.
 
   TF_DISALLOW_COPY_AND_ASSIGN(Placer);
 };
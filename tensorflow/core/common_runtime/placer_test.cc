@@ -40,8 +40,10 @@ limitations under the License.
 #include "tensorflow/core/lib/core/error_codes.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
@@ -1190,6 +1192,43 @@ TEST_F(PlacerTest, TestMultipleColocationGroups) {
   EXPECT_COLOCATED(g, "in", "foo");
 }
 
+TEST_F(PlacerTest, TestColocationGroupsThreadPool) {
+  auto build = [this](Graph* g) {
+    GraphDefBuilder b(GraphDefBuilder::kFailImmediately);
+    Node* input = ops::SourceOp("TestInput", b.opts().WithName("in"));
+    ops::UnaryOp("TestRelu", input,
+                 b.opts().WithName("colocated_1").WithAttr("_class",
+                                                           {"loc:@in"}));
+    Node* relu = ops::UnaryOp("TestRelu", input, b.opts().WithName("foo"));
+    ops::UnaryOp("TestRelu", relu,
+                 b.opts().WithName("colocated_2").WithAttr("_class",
+                                                           {"loc:@foo"}));
+    ops::BinaryOp("TestAdd", input, relu,
+                  b.opts().WithName("add").WithDevice("/device:FakeCPU:3"));
+    TF_EXPECT_OK(BuildGraph(b, g));
+  };
+  Graph serial(OpRegistry::Global());
+  build(&serial);
+  TF_EXPECT_OK(Place(&serial));
+
+  // Computing the devices of the colocation groups on a thread pool doesn't
+  // change the placement.
+  Graph g(OpRegistry::Global());
+  build(&g);
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  Placer placer(&g, "", &g.flib_def(), &devices_, nullptr, true, false,
+                &pool);
+  TF_EXPECT_OK(placer.Run());
+  for (const string& name :
+       {"in", "colocated_1", "foo", "colocated_2", "add"}) {
+    EXPECT_EQ(GetNodeByName(serial, name)->assigned_device_name(),
+              GetNodeByName(g, name)->assigned_device_name())
+        << name;
+  }
+  EXPECT_COLOCATED(g, "in", "colocated_1");
+  EXPECT_COLOCATED(g, "foo", "colocated_2");
+}
+
 TEST_P(SoftPlacementPlacerTest, TestInvalidMultipleColocationGroups) {
   Graph g(OpRegistry::Global());
   {  // Scope for temporary variables used to construct g.
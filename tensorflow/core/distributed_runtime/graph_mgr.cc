@@ -176,6 +176,7 @@ Status GraphMgr::InitItem(const string& handle, const GraphDef& gdef,
   };
   popts.flib_def = &graph.flib_def();
   popts.control_flow_added = true;
+  popts.thread_pool = worker_env_->compute_pool;
   popts.scheduling_for_recvs = graph_options.enable_recv_scheduling();
   TF_RETURN_IF_ERROR(Partition(popts, &graph, &partitions));
   if (popts.scheduling_for_recvs) {
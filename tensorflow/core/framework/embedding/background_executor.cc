@@ -0,0 +1,303 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/embedding/background_executor.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+namespace {
+
+auto* background_queue_depth = monitoring::Gauge<int64, 1>::New(
+    "/tensorflow/core/embedding/background_queue_depth",
+    "The number of pending EmbeddingVariable background tasks by class.",
+    "class");
+
+auto* background_cpu_usecs = monitoring::Counter<1>::New(
+    "/tensorflow/core/embedding/background_cpu_usecs",
+    "The CPU time of EmbeddingVariable background tasks by class.",
+    "class");
+
+auto* background_tasks = monitoring::Counter<1>::New(
+    "/tensorflow/core/embedding/background_tasks",
+    "The number of EmbeddingVariable background tasks run by class.",
+    "class");
+
+uint64 ThreadCpuMicros() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  }
+#endif
+  return Env::Default()->NowMicros();
+}
+
+}  // namespace
+
+const char* BackgroundTaskClassName(BackgroundTaskClass cls) {
+  switch (cls) {
+    case BackgroundTaskClass::kPrefetch:
+      return "prefetch";
+    case BackgroundTaskClass::kEviction:
+      return "eviction";
+    case BackgroundTaskClass::kCompaction:
+      return "compaction";
+    default:
+      return "stats";
+  }
+}
+
+BackgroundExecutor* BackgroundExecutor::Global() {
+  static BackgroundExecutor* executor = [] {
+    Options options;
+    int64 num_threads = options.num_threads;
+    if (getenv("TF_EV_BACKGROUND_THREADS") == nullptr &&
+        getenv("TF_MULTI_TIER_EV_CACHE_THREADS") != nullptr) {
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_CACHE_THREADS",
+                                      num_threads, &num_threads));
+      LOG(WARNING) << "TF_MULTI_TIER_EV_CACHE_THREADS is deprecated, "
+                   << "use TF_EV_BACKGROUND_THREADS instead.";
+    } else {
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_BACKGROUND_THREADS",
+                                      num_threads, &num_threads));
+    }
+    options.num_threads = num_threads;
+    string quota;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_BACKGROUND_CPU_QUOTA", "",
+                                     &quota));
+    if (!quota.empty() && !strings::safe_strtod(quota, &options.cpu_quota)) {
+      LOG(WARNING) << "Failed to parse TF_EV_BACKGROUND_CPU_QUOTA=" << quota
+                   << ", CPU usage of background tasks isn't limited.";
+      options.cpu_quota = 0;
+    }
+    options.export_metrics = true;
+    return new BackgroundExecutor(options);
+  }();
+  return executor;
+}
+
+BackgroundExecutor::BackgroundExecutor(const Options& options)
+    : options_(options), env_(Env::Default()) {
+  const int num_threads = std::max(options_.num_threads, 1);
+  LOG(INFO) << "EmbeddingVariable background executor, threads: "
+            << num_threads << ", cpu quota: " << options_.cpu_quota;
+  window_start_micros_ = env_->NowMicros();
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(env_->StartThread(
+        ThreadOptions(), "EV_BACKGROUND", [this]() { WorkerLoop(); }));
+  }
+}
+
+BackgroundExecutor::~BackgroundExecutor() {
+  {
+    mutex_lock l(mu_);
+    shutdown_ = true;
+    cv_.notify_all();
+  }
+  // Joins the workers.
+  workers_.clear();
+}
+
+void BackgroundExecutor::Schedule(BackgroundTaskClass cls,
+                                  std::function<void()> fn) {
+  const int c = static_cast<int>(cls);
+  mutex_lock l(mu_);
+  queues_[c].push_back({c, std::move(fn)});
+  UpdateDepthLocked(c);
+  cv_.notify_one();
+}
+
+void BackgroundExecutor::ScheduleAfter(BackgroundTaskClass cls,
+                                       int64 delay_micros,
+                                       std::function<void()> fn) {
+  if (delay_micros <= 0) {
+    Schedule(cls, std::move(fn));
+    return;
+  }
+  const int c = static_cast<int>(cls);
+  mutex_lock l(mu_);
+  delayed_.push({env_->NowMicros() + delay_micros, next_seq_++,
+                 {c, std::move(fn)}});
+  ++num_delayed_[c];
+  UpdateDepthLocked(c);
+  // A waiting worker may have to wake up earlier.
+  cv_.notify_one();
+}
+
+void BackgroundExecutor::Pause() {
+  mutex_lock l(mu_);
+  ++pause_count_;
+}
+
+void BackgroundExecutor::Resume() {
+  mutex_lock l(mu_);
+  DCHECK_GT(pause_count_, 0);
+  if (--pause_count_ == 0) cv_.notify_all();
+}
+
+BackgroundExecutor::ClassStats BackgroundExecutor::GetStats(
+    BackgroundTaskClass cls) const {
+  const int c = static_cast<int>(cls);
+  mutex_lock l(mu_);
+  ClassStats stats = stats_[c];
+  stats.queue_depth = queues_[c].size() + num_delayed_[c];
+  return stats;
+}
+
+void BackgroundExecutor::UpdateDepthLocked(int cls) {
+  if (!options_.export_metrics) return;
+  background_queue_depth
+      ->GetCell(BackgroundTaskClassName(static_cast<BackgroundTaskClass>(cls)))
+      ->Set(queues_[cls].size() + num_delayed_[cls]);
+}
+
+void BackgroundExecutor::MoveDueTasksLocked(uint64 now) {
+  while (!delayed_.empty() && delayed_.top().due_micros <= now) {
+    // priority_queue only gives const access to the top.
+    Task task = std::move(const_cast<DelayedTask&>(delayed_.top()).task);
+    delayed_.pop();
+    --num_delayed_[task.cls];
+    queues_[task.cls].push_back(std::move(task));
+  }
+}
+
+int BackgroundExecutor::NextClassLocked() const {
+  for (int c = 0; c < kNumBackgroundTaskClasses; ++c) {
+    if (pause_count_ > 0 &&
+        c != static_cast<int>(BackgroundTaskClass::kPrefetch)) {
+      break;
+    }
+    if (!queues_[c].empty()) return c;
+  }
+  return -1;
+}
+
+int64 BackgroundExecutor::QuotaWaitLocked(uint64 now) {
+  if (options_.cpu_quota <= 0) return 0;
+  const uint64 window_end =
+      window_start_micros_ + options_.quota_window_micros;
+  if (now >= window_end) {
+    window_start_micros_ = now;
+    window_cpu_micros_ = 0;
+    return 0;
+  }
+  if (window_cpu_micros_ <
+      options_.cpu_quota * options_.quota_window_micros) {
+    return 0;
+  }
+  return window_end - now;
+}
+
+bool BackgroundExecutor::NextTask(Task* task) {
+  mutex_lock l(mu_);
+  while (!shutdown_) {
+    const uint64 now = env_->NowMicros();
+    MoveDueTasksLocked(now);
+    int64 wait_micros = -1;
+    const int c = NextClassLocked();
+    if (c >= 0) {
+      wait_micros = QuotaWaitLocked(now);
+      if (wait_micros == 0) {
+        *task = std::move(queues_[c].front());
+        queues_[c].pop_front();
+        UpdateDepthLocked(c);
+        return true;
+      }
+    }
+    if (!delayed_.empty()) {
+      const int64 due = delayed_.top().due_micros - now;
+      wait_micros = wait_micros < 0 ? due : std::min(wait_micros, due);
+    }
+    if (wait_micros < 0) {
+      cv_.wait(l);
+    } else {
+      cv_.wait_for(l, std::chrono::microseconds(wait_micros));
+    }
+  }
+  return false;
+}
+
+void BackgroundExecutor::WorkerLoop() {
+  Task task;
+  while (NextTask(&task)) {
+    const uint64 start = ThreadCpuMicros();
+    task.fn();
+    task.fn = nullptr;
+    const int64 cpu_micros = ThreadCpuMicros() - start;
+    if (options_.export_metrics) {
+      const char* name =
+          BackgroundTaskClassName(static_cast<BackgroundTaskClass>(task.cls));
+      background_cpu_usecs->GetCell(name)->IncrementBy(cpu_micros);
+      background_tasks->GetCell(name)->IncrementBy(1);
+    }
+    mutex_lock l(mu_);
+    ++stats_[task.cls].tasks_run;
+    stats_[task.cls].cpu_micros += cpu_micros;
+    window_cpu_micros_ += cpu_micros;
+  }
+}
+
+BackgroundStrand::~BackgroundStrand() {
+  mutex_lock l(mu_);
+  tasks_.clear();
+  while (running_) idle_cv_.wait(l);
+}
+
+void BackgroundStrand::Schedule(BackgroundTaskClass cls,
+                                std::function<void()> fn) {
+  mutex_lock l(mu_);
+  tasks_.emplace_back(cls, std::move(fn));
+  if (!running_) ScheduleNextLocked();
+}
+
+void BackgroundStrand::ScheduleNextLocked() {
+  running_ = true;
+  executor_->Schedule(tasks_.front().first, [this]() { RunNext(); });
+}
+
+void BackgroundStrand::RunNext() {
+  std::function<void()> fn;
+  {
+    mutex_lock l(mu_);
+    // The destructor may have dropped the task.
+    if (!tasks_.empty()) {
+      fn = std::move(tasks_.front().second);
+      tasks_.pop_front();
+    }
+  }
+  if (fn) fn();
+  mutex_lock l(mu_);
+  if (tasks_.empty()) {
+    running_ = false;
+    idle_cv_.notify_all();
+  } else {
+    ScheduleNextLocked();
+  }
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
@@ -0,0 +1,202 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BACKGROUND_EXECUTOR_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BACKGROUND_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Classes of background work, from the most to the least urgent.
+enum class BackgroundTaskClass {
+  // Moving ids into the cache ahead of their lookups.
+  kPrefetch = 0,
+  // Moving ids out of the cache to the lower tiers.
+  kEviction = 1,
+  // Rewriting SSD files to drop invalid records.
+  kCompaction = 2,
+  // Updating the frequency statistics of caches.
+  kStats = 3,
+};
+
+constexpr int kNumBackgroundTaskClasses = 4;
+
+const char* BackgroundTaskClassName(BackgroundTaskClass cls);
+
+// Process-wide executor of the maintenance work of EmbeddingVariables, so
+// that hundreds of variables share a fixed number of threads instead of
+// each storage starting its own.
+//
+// A worker runs the oldest pending task of the most urgent class, tasks of
+// the executor may therefore run out of order and concurrently. Work that
+// has to keep its order goes through a BackgroundStrand. The CPU time used
+// by the tasks can be limited to a quota of cores, accounted in windows of
+// 100ms. While paused, e.g. in the latency critical part of a step, only
+// prefetch tasks are started.
+//
+// Configured by environment variables:
+//   TF_EV_BACKGROUND_THREADS: worker threads, default 4.
+//   TF_EV_BACKGROUND_CPU_QUOTA: cores the tasks may use, default 0, no
+//     limit.
+//   TF_MULTI_TIER_EV_CACHE_THREADS: deprecated, used as the number of
+//     worker threads if TF_EV_BACKGROUND_THREADS is unset.
+class BackgroundExecutor {
+ public:
+  struct Options {
+    int num_threads = 4;
+    double cpu_quota = 0;
+    int64 quota_window_micros = 100 * 1000;
+    // Exports the queue depth and CPU usage of each class as metrics.
+    bool export_metrics = false;
+  };
+
+  struct ClassStats {
+    int64 queue_depth = 0;  // Pending tasks, including delayed ones.
+    int64 tasks_run = 0;
+    int64 cpu_micros = 0;
+  };
+
+  // Returns the process-wide executor configured from the environment.
+  static BackgroundExecutor* Global();
+
+  explicit BackgroundExecutor(const Options& options);
+
+  // Waits for the running tasks, pending tasks are dropped.
+  ~BackgroundExecutor();
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BackgroundExecutor);
+
+  void Schedule(BackgroundTaskClass cls, std::function<void()> fn);
+
+  // Schedules `fn` once `delay_micros` have passed, e.g. for periodic work
+  // that reschedules itself.
+  void ScheduleAfter(BackgroundTaskClass cls, int64 delay_micros,
+                     std::function<void()> fn);
+
+  // Stops starting tasks other than prefetch tasks until the matching
+  // Resume(). Calls nest.
+  void Pause();
+  void Resume();
+
+  ClassStats GetStats(BackgroundTaskClass cls) const;
+
+  int num_threads() const { return workers_.size(); }
+
+ private:
+  struct Task {
+    int cls;
+    std::function<void()> fn;
+  };
+
+  struct DelayedTask {
+    uint64 due_micros;
+    uint64 seq;  // Keeps tasks due at the same time in order.
+    Task task;
+    bool operator>(const DelayedTask& other) const {
+      return due_micros != other.due_micros ? due_micros > other.due_micros
+                                            : seq > other.seq;
+    }
+  };
+
+  void WorkerLoop();
+  // Blocks until a task may run. Returns false on shutdown.
+  bool NextTask(Task* task);
+  void MoveDueTasksLocked(uint64 now) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the class to run next, or -1 if none may run now.
+  int NextClassLocked() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the micros until the quota is available again, 0 if it is.
+  int64 QuotaWaitLocked(uint64 now) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void UpdateDepthLocked(int cls) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+  Env* const env_;
+  mutable mutex mu_;
+  condition_variable cv_;
+  bool shutdown_ GUARDED_BY(mu_) = false;
+  int pause_count_ GUARDED_BY(mu_) = 0;
+  uint64 next_seq_ GUARDED_BY(mu_) = 0;
+  std::deque<Task> queues_[kNumBackgroundTaskClasses] GUARDED_BY(mu_);
+  std::priority_queue<DelayedTask, std::vector<DelayedTask>,
+                      std::greater<DelayedTask>> delayed_ GUARDED_BY(mu_);
+  int64 num_delayed_[kNumBackgroundTaskClasses] GUARDED_BY(mu_) = {};
+  ClassStats stats_[kNumBackgroundTaskClasses] GUARDED_BY(mu_);
+  uint64 window_start_micros_ GUARDED_BY(mu_) = 0;
+  int64 window_cpu_micros_ GUARDED_BY(mu_) = 0;
+  std::vector<std::unique_ptr<Thread>> workers_;
+};
+
+// Pauses `executor` for the lifetime of the object.
+class BackgroundPauseScope {
+ public:
+  explicit BackgroundPauseScope(
+      BackgroundExecutor* executor = BackgroundExecutor::Global())
+      : executor_(executor) {
+    executor_->Pause();
+  }
+  ~BackgroundPauseScope() { executor_->Resume(); }
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BackgroundPauseScope);
+
+ private:
+  BackgroundExecutor* executor_;
+};
+
+// Runs tasks one at a time in the order they were scheduled, on the
+// threads of `executor`. Each task is queued on the executor with its own
+// class once the previous one finished, so a strand never holds a thread
+// while it is idle. Used for the cache maintenance of a multi-tier storage,
+// which was done by a single thread before. While the executor is paused,
+// a strand waits at its first task that isn't a prefetch task.
+class BackgroundStrand {
+ public:
+  explicit BackgroundStrand(
+      BackgroundExecutor* executor = BackgroundExecutor::Global())
+      : executor_(executor) {}
+
+  // Drops the pending tasks and waits for the running one.
+  ~BackgroundStrand();
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BackgroundStrand);
+
+  void Schedule(BackgroundTaskClass cls, std::function<void()> fn);
+
+ private:
+  void ScheduleNextLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void RunNext();
+
+  BackgroundExecutor* const executor_;
+  mutex mu_;
+  condition_variable idle_cv_;
+  std::deque<std::pair<BackgroundTaskClass, std::function<void()>>> tasks_
+      GUARDED_BY(mu_);
+  // Whether a task of the strand is queued on or run by the executor.
+  bool running_ GUARDED_BY(mu_) = false;
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_BACKGROUND_EXECUTOR_H_
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/filter_policy.h"
 #include "tensorflow/core/framework/embedding/intra_thread_copy_id_allocator.h"
+#include "tensorflow/core/framework/embedding/memory_governor.h"
 
 namespace tensorflow {
 
@@ -177,13 +178,17 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   void LookupOrCreate(K key, V* val, const V* default_value_ptr,
                       void** value_ptr, int count,
                       const V* default_value_no_permission) override {
+    bool is_filter = false;
     if (GetBloomFreq(key) >= config_.filter_freq) {
-      bool is_filter = true;
+      // The key can still be filtered out under memory pressure.
       TF_CHECK_OK(LookupOrCreateKey(key, value_ptr, &is_filter, count));
+    } else {
+      AddFreq(key, count);
+    }
+    if (is_filter) {
       V* mem_val = feat_desc_->GetEmbedding(*value_ptr, config_.emb_index);
       memcpy(val, mem_val, sizeof(V) * ev_->ValueLen());
     } else {
-      AddFreq(key, count);
       memcpy(val, default_value_no_permission, sizeof(V) * ev_->ValueLen());
     }
   }
@@ -191,7 +196,9 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
   Status LookupOrCreateKey(K key, void** value_ptr,
       bool* is_filter, int64 count) override {
     *value_ptr = nullptr;
-    if ((GetFreq(key, *value_ptr) + count) >= config_.filter_freq) {
+    auto governor = embedding::MemoryGovernor::Get();
+    const int64 freq = GetFreq(key, *value_ptr) + count;
+    if (freq >= governor->AdmissionFreq(config_.filter_freq)) {
       Status s = ev_->LookupKey(key, value_ptr);
       if (!s.ok()) {
         *value_ptr = feat_desc_->Allocate();
@@ -202,6 +209,9 @@ class BloomFilterPolicy : public FilterPolicy<K, V, EV> {
       *is_filter = true;
       feat_desc_->AddFreq(*value_ptr, count);
     } else {
+      if (freq >= config_.filter_freq) {
+        governor->RecordThrottledAdmission();
+      }
       *is_filter = false;
       AddFreq(key, count);
     }
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/embedding/embedding_config.h"
 #include "tensorflow/core/framework/embedding/filter_policy.h"
+#include "tensorflow/core/framework/embedding/memory_governor.h"
 
 namespace tensorflow {
 
@@ -106,21 +107,25 @@ class CounterFilterPolicy : public FilterPolicy<K, V, EV> {
   Status LookupOrCreateKey(K key, void** value_ptr,
       bool* is_filter, int64 count) override {
     *is_filter = false;
+    auto governor = embedding::MemoryGovernor::Get();
+    const int64 admit_freq = governor->AdmissionFreq(config_.filter_freq);
     Status s = ev_->LookupKey(key, value_ptr);
     if (!s.ok()) {
       *value_ptr = feat_desc_->Allocate();
-      if (count >= config_.filter_freq) {
+      if (count >= admit_freq) {
         void* admit_value_ptr = feat_desc_->Admit(*value_ptr);
         feat_desc_->SetDefaultValue(admit_value_ptr, key);
         feat_desc_->Deallocate(*value_ptr);
         *value_ptr = admit_value_ptr;
         *is_filter = true;
+      } else if (count >= config_.filter_freq) {
+        governor->RecordThrottledAdmission();
       }
       ev_->storage()->Insert(key, value_ptr);
       s = Status::OK();
     } else if (!feat_desc_->IsAdmit(*value_ptr)) {
       int64 freq = feat_desc_->GetFreq(*value_ptr);
-      if (freq + count >= config_.filter_freq) {
+      if (freq + count >= admit_freq) {
         void* admit_value_ptr = feat_desc_->Admit(*value_ptr);
         feat_desc_->SetFreq(admit_value_ptr, freq);
         feat_desc_->UpdateVersion(
@@ -129,6 +134,8 @@ class CounterFilterPolicy : public FilterPolicy<K, V, EV> {
         ev_->storage()->UpdateValuePtr(key, admit_value_ptr, *value_ptr);
         *value_ptr = admit_value_ptr;
         *is_filter = true;
+      } else if (freq + count >= config_.filter_freq) {
+        governor->RecordThrottledAdmission();
       }
     } else {
       *is_filter = true;
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_LEVELDB_STORAGE_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_DRAM_LEVELDB_STORAGE_H_
 
+#include "tensorflow/core/framework/embedding/embedding_var_context.h"
 #include "tensorflow/core/framework/embedding/leveldb_kv.h"
 #include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
 #include "tensorflow/core/framework/embedding/multi_tier_storage.h"
@@ -61,6 +62,41 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
     return s;
   }
 
+  // Reads the keys missing in DRAM from LevelDB in sorted key ranges, one
+  // range per worker, instead of one point read per key during the lookup.
+  void Prefetch(const EmbeddingVarContext<CPUDevice>& ctx,
+                const K* keys, int64 num_of_keys) override {
+    std::vector<K> missing;
+    for (int64 i = 0; i < num_of_keys; ++i) {
+      if (!dram_->Contains(keys[i]).ok()) {
+        missing.emplace_back(keys[i]);
+      }
+    }
+    if (missing.empty()) return;
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()),
+                  missing.end());
+
+    std::vector<void*> value_ptrs(missing.size(), nullptr);
+    auto do_work = [this, &missing, &value_ptrs](int64 start, int64 limit) {
+      Status s = leveldb_->BatchGet(missing.data() + start, limit - start,
+                                    value_ptrs.data() + start);
+      if (!s.ok()) {
+        LOG(WARNING) << "Prefetch from LevelDB failed: " << s.ToString();
+      }
+    };
+    auto worker_threads = ctx.worker_threads;
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          missing.size(), 10000 /* a LevelDB read */, do_work);
+
+    for (size_t i = 0; i < missing.size(); ++i) {
+      if (value_ptrs[i] != nullptr &&
+          !dram_->TryInsert(missing[i], value_ptrs[i]).ok()) {
+        leveldb_->DestroyValuePtr(value_ptrs[i]);
+      }
+    }
+  }
+
   void Insert(K key, void** value_ptr) override {
     dram_->Insert(key, value_ptr);
   }
@@ -197,13 +233,13 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
   }
 
   Status Eviction(K* evict_ids, int64 evict_size) override {
-    void* value_ptr;
-    for (int64 i = 0; i < evict_size; ++i) {
-      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(leveldb_->Commit(evict_ids[i], value_ptr));
-        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        dram_->DestroyValuePtr(value_ptr);
-      }
+    std::vector<K> keys;
+    std::vector<void*> value_ptrs;
+    CollectEvicted(evict_ids, evict_size, &keys, &value_ptrs);
+    TF_CHECK_OK(leveldb_->BatchWrite(keys, value_ptrs));
+    for (size_t i = 0; i < keys.size(); ++i) {
+      TF_CHECK_OK(dram_->Remove(keys[i]));
+      dram_->DestroyValuePtr(value_ptrs[i]);
     }
     return Status::OK();
   }
@@ -212,13 +248,13 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
     mutex_lock l(*(dram_->get_mutex()));
     mutex_lock l1(*(leveldb_->get_mutex()));
     MultiTierStorage<K, V>::ReleaseInvalidValuePtr(dram_->feature_descriptor());
-    void* value_ptr = nullptr;
-    for (int64 i = 0; i < evict_size; ++i) {
-      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
-        TF_CHECK_OK(leveldb_->Commit(evict_ids[i], value_ptr));
-        TF_CHECK_OK(dram_->Remove(evict_ids[i]));
-        MultiTierStorage<K, V>::KeepInvalidValuePtr(value_ptr);
-      }
+    std::vector<K> keys;
+    std::vector<void*> value_ptrs;
+    CollectEvicted(evict_ids, evict_size, &keys, &value_ptrs);
+    TF_CHECK_OK(leveldb_->BatchWrite(keys, value_ptrs));
+    for (size_t i = 0; i < keys.size(); ++i) {
+      TF_CHECK_OK(dram_->Remove(keys[i]));
+      MultiTierStorage<K, V>::KeepInvalidValuePtr(value_ptrs[i]);
     }
     return Status::OK();
   }
@@ -234,6 +270,17 @@ class DramLevelDBStore : public MultiTierStorage<K, V> {
   }
 
  private:
+  void CollectEvicted(K* evict_ids, int64 evict_size, std::vector<K>* keys,
+                      std::vector<void*>* value_ptrs) {
+    void* value_ptr = nullptr;
+    for (int64 i = 0; i < evict_size; ++i) {
+      if (dram_->Get(evict_ids[i], &value_ptr).ok()) {
+        keys->emplace_back(evict_ids[i]);
+        value_ptrs->emplace_back(value_ptr);
+      }
+    }
+  }
+
   DramStorage<K, V>* dram_;
   LevelDBStore<K, V>* leveldb_;
   FeatureDescriptor<V>* dram_feat_desc_ = nullptr;
@@ -162,6 +162,18 @@ class   DramSsdHashStorage : public MultiTierStorage<K, V> {
   Status RestoreSSD(int64 emb_index, int64 emb_slot_num, int64 value_len,
                     const std::string& ssd_emb_file_name, EmbeddingVar<K, V>* ev,
                     RestoreSSDBuffer<K>& restore_buff) override {
+    // The records are imported as they are, so they must be encoded like
+    // the records ssd_hash_ writes.
+    if (restore_buff.value_codec !=
+        static_cast<int64>(ssd_hash_->value_codec_type())) {
+      return errors::FailedPrecondition(
+          "Cannot restore SSD records encoded as ",
+          SsdValueCodecTypeName(
+              static_cast<SsdValueCodecType>(restore_buff.value_codec)),
+          " with TF_SSDHASH_VALUE_CODEC=",
+          SsdValueCodecTypeName(ssd_hash_->value_codec_type()),
+          ", set it to the codec of the checkpoint.");
+    }
     std::map<int64, int64> file_id_map;
     for (int64 i = 0; i < restore_buff.num_of_files; i++) {
       file_id_map[restore_buff.file_list_buf[i]] = i;
@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/filter_factory.h"
 #include "tensorflow/core/framework/embedding/gpu_hash_map_kv.h"
 #include "tensorflow/core/framework/embedding/embedding_config.h"
+#include "tensorflow/core/framework/embedding/heavy_hitter_sketch.h"
 #include "tensorflow/core/framework/embedding/storage.h"
 #include "tensorflow/core/framework/typed_allocator.h"
 
@@ -124,6 +125,14 @@ class EmbeddingVar : public ResourceBase {
       storage_->Init();
     }
 
+    const int64 sketch_capacity =
+        embedding::HeavyHitterSketch::DefaultCapacity();
+    if (emb_config_.is_primary() && sketch_capacity > 0 && !heavy_hitters_) {
+      heavy_hitters_.reset(new embedding::HeavyHitterSketch(sketch_capacity));
+      embedding::HeavyHitterRegistry::Global()->Register(
+          name_, heavy_hitters_.get());
+    }
+
     return Status::OK();
   }
 
@@ -202,6 +211,7 @@ class EmbeddingVar : public ResourceBase {
   void GetEmbeddings(const EmbeddingVarContext<CPUDevice>& context,
                      const K* keys, V* output,
                      int64 num_of_keys) {
+    storage_->Prefetch(context, keys, num_of_keys);
     auto do_work = [this, keys, output] (int64 start, int64 limit) {
       for (int64 i = start; i < limit; ++i) {
         V* default_v =
@@ -222,6 +232,7 @@ class EmbeddingVar : public ResourceBase {
   void GetEmbeddings(const EmbeddingVarContext<CPUDevice>& context,
                      const K* keys, V* output,
                      int64 num_of_keys, V* default_value) {
+    storage_->Prefetch(context, keys, num_of_keys);
     auto do_work = [this, keys, output, default_value]
         (int64 start, int64 limit) {
       for (int64 i = start; i < limit; ++i) {
@@ -244,6 +255,7 @@ class EmbeddingVar : public ResourceBase {
                       void** value_ptrs,
                       int64 num_of_keys) {
     const K* keys = (K*)keys_tensor.data();
+    storage_->Prefetch(context, keys, num_of_keys);
     auto do_work = [this, keys, value_ptrs] (int64 start, int64 limit) {
       for (int64 i = start; i < limit; ++i) {
         bool is_filter = false;
@@ -469,11 +481,11 @@ class EmbeddingVar : public ResourceBase {
     return emb_config_.DebugString();
   }
 
-  void Restore(const std::string& name_string,
-               const std::string& file_name_string, int64 partition_id,
-               int64 partition_num, bool is_incr, BundleReader* reader,
-               bool reset_version = false,
-               const Eigen::GpuDevice* device = nullptr) {
+  Status Restore(const std::string& name_string,
+                 const std::string& file_name_string, int64 partition_id,
+                 int64 partition_num, bool is_incr, BundleReader* reader,
+                 bool reset_version = false,
+                 const Eigen::GpuDevice* device = nullptr) {
     return storage_->Restore(name_string, file_name_string, partition_id,
                              partition_num, value_len_, is_incr, reset_version,
                              emb_config_, device, reader, this, filter_);
@@ -682,6 +694,18 @@ class EmbeddingVar : public ResourceBase {
     }
   }
 
+  // Counts the ids of a batched lookup in the heavy-hitter sketch, if it is
+  // enabled. indices_counts is null when every id was looked up once.
+  void UpdateHeavyHitters(const Tensor& indices,
+                          const Tensor* indices_counts = nullptr) {
+    if (heavy_hitters_) {
+      heavy_hitters_->Add(
+          (const K*)indices.data(),
+          indices_counts ? (const int64*)indices_counts->data() : nullptr,
+          indices.NumElements());
+    }
+  }
+
   void UpdateCache(const K* key_buff, int64 key_num,
       const int64* version_buff, const int64* freq_buff) {
     auto cache = Cache();
@@ -733,6 +757,12 @@ class EmbeddingVar : public ResourceBase {
     return filter_;
   }
 
+  // Sketch of the ids looked up, nullptr unless TF_EV_HEAVY_HITTER_CAPACITY
+  // is set.
+  embedding::HeavyHitterSketch* HeavyHitters() const {
+    return heavy_hitters_.get();
+  }
+
  protected:
   ~EmbeddingVar() override {
     // When dynamic dimension embedding is used,
@@ -754,6 +784,10 @@ class EmbeddingVar : public ResourceBase {
     if (filter_) {
       delete filter_;
     }
+    if (heavy_hitters_) {
+      embedding::HeavyHitterRegistry::Global()->Unregister(
+          name_, heavy_hitters_.get());
+    }
   }
 
  private:
@@ -795,6 +829,7 @@ class EmbeddingVar : public ResourceBase {
   EmbeddingConfig emb_config_;
   FilterPolicy<K, V, EmbeddingVar<K, V>>* filter_;
   embedding::FeatureDescriptor<V>* feat_desc_;
+  std::unique_ptr<embedding::HeavyHitterSketch> heavy_hitters_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingVar);
 };
@@ -56,7 +56,7 @@ REGISTER_KERNELS(int64);
 #undef REGISTER_KERNELS
 
 template <typename K, typename V>
-void CheckpointLoader<K, V>::RestoreSSD() {
+Status CheckpointLoader<K, V>::RestoreSSD() {
   std::string name_string_temp(restore_args_.m_name_string);
   std::string new_str = "_";
   int64 pos = name_string_temp.find("/");
@@ -72,13 +72,14 @@ void CheckpointLoader<K, V>::RestoreSSD() {
     BundleReader ssd_record_reader(Env::Default(), ssd_record_file_name);
     RestoreSSDBuffer<K> ssd_buffer(&ssd_record_reader);
     VLOG(1) << "Loading SSD record... " << ssd_record_file_name;
-    storage_->RestoreSSD(ev_->GetEmbeddingIndex(),
-                         ev_->GetEmbeddingSlotNum(), ev_->ValueLen(),
-                         ssd_emb_file_name, ev_, ssd_buffer);
+    TF_RETURN_IF_ERROR(storage_->RestoreSSD(
+        ev_->GetEmbeddingIndex(), ev_->GetEmbeddingSlotNum(), ev_->ValueLen(),
+        ssd_emb_file_name, ev_, ssd_buffer));
   }
+  return Status::OK();
 }
 #define REGISTER_KERNELS(ktype, vtype)                               \
-  template void CheckpointLoader<ktype, vtype>::RestoreSSD();
+  template Status CheckpointLoader<ktype, vtype>::RestoreSSD();
 #define REGISTER_KERNELS_ALL_INDEX(type)                             \
   REGISTER_KERNELS(int32, type)                                      \
   REGISTER_KERNELS(int64, type)
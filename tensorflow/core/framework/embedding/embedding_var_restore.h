@@ -60,6 +60,8 @@ struct RestoreSSDBuffer {
   int64* key_offset_list_buf = nullptr;
   int64 num_of_keys = 0;
   int64 num_of_files = 0;
+  // Records of checkpoints written before the SSD value codecs are raw.
+  int64 value_codec = 0;
 
   explicit RestoreSSDBuffer(BundleReader* ssd_record_reader) {
     num_of_files = ReadRecord(ssd_record_reader, "files", &file_list_buf);
@@ -71,6 +73,12 @@ struct RestoreSSDBuffer {
 
     ReadRecord(ssd_record_reader, "keys_file_id", &key_file_id_list_buf);
     ReadRecord(ssd_record_reader, "keys_offset", &key_offset_list_buf);
+    if (ssd_record_reader->Contains("value_codec")) {
+      int64* value_codec_buf = nullptr;
+      ReadRecord(ssd_record_reader, "value_codec", &value_codec_buf);
+      value_codec = value_codec_buf[0];
+      delete[] value_codec_buf;
+    }
   }
 
   ~RestoreSSDBuffer() {
@@ -128,11 +136,11 @@ class CheckpointLoader {
                                 partition_num, is_incr, reset_version);
   }
 
-  void RestoreCkpt(const EmbeddingConfig& emb_config,
-                   const Eigen::GpuDevice* device) {
+  Status RestoreCkpt(const EmbeddingConfig& emb_config,
+                     const Eigen::GpuDevice* device) {
     /* Step 1: Restore SSD ckpt Data (Optional)
        Step 2; Restore model ckpt */
-    RestoreSSD();
+    TF_RETURN_IF_ERROR(RestoreSSD());
 
     std::vector<std::string> tensor_name_vec;
     InitPartNumAndLoadedParts(tensor_name_vec);
@@ -141,7 +149,7 @@ class CheckpointLoader {
     for (auto& tensor_name : tensor_name_vec) {
       RestoreInternal(tensor_name, emb_config, device, restore_buff);
     }
-
+    return Status::OK();
   }
 
   void RestoreInternal(const std::string& name_string,
@@ -150,7 +158,7 @@ class CheckpointLoader {
                        RestoreBuffer& restore_buff);
 
  private:
-  void RestoreSSD();
+  Status RestoreSSD();
 
   bool IsOldCheckpoint(const std::string& curr_partid_str,
                        const std::string& kPartOffsetTensorSuffsix);
@@ -16,8 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EVICTION_MANAGER_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_EVICTION_MANAGER_H_
 
+#include <map>
+
+#include "tensorflow/core/framework/embedding/background_executor.h"
 #include "tensorflow/core/util/env_var.h"
-#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 
@@ -42,9 +44,9 @@ class EvictionManager {
     num_of_threads_ = 1;
     TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_EVICTION_THREADS", 1,
           &num_of_threads_));
-    thread_pool_.reset(
-        new thread::ThreadPool(Env::Default(), ThreadOptions(),
-          "EVICTION_MANAGER", 3, /*low_latency_hint=*/false));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_MULTI_TIER_EV_EVICTION_INTERVAL_US",
+          1000, &eviction_interval_us_));
+    num_of_active_threads_ = 0;
   }
   
   ~EvictionManager() {}
@@ -52,7 +54,8 @@ class EvictionManager {
   TF_DISALLOW_COPY_AND_ASSIGN(EvictionManager);
 
   void Schedule(std::function<void()> fn) {
-    thread_pool_->Schedule(std::move(fn)); 
+    BackgroundExecutor::Global()->Schedule(BackgroundTaskClass::kEviction,
+                                           std::move(fn));
   }
 
   void AddStorage(MultiTierStorage<K,V>* storage) {
@@ -77,12 +80,14 @@ class EvictionManager {
   }
 
  private:
+  // Starts another chain of eviction passes, up to num_of_threads_ of them
+  // run at the same time.
   void StartThread() {
     while(this->flag_.test_and_set(std::memory_order_acquire));
     if (num_of_active_threads_ < num_of_threads_) {
       __sync_fetch_and_add(&num_of_active_threads_, 1);
-      thread_pool_->Schedule([this]() {
-        EvictionLoop();
+      Schedule([this]() {
+        EvictionPass();
       });
     }
     this->flag_.clear(std::memory_order_release);
@@ -99,8 +104,14 @@ class EvictionManager {
     return false;
   }
 
-  void EvictionLoop() {
-    while (CheckStorages()) {
+  // Evicts from each storage once and reschedules itself after
+  // eviction_interval_us_, instead of occupying a thread.
+  void EvictionPass() {
+    if (!CheckStorages()) {
+      __sync_fetch_and_sub(&num_of_active_threads_, 1);
+      return;
+    }
+    {
       mutex_lock l(mu_);
       for (auto it : storage_table_) {
         auto storage = it.first;
@@ -114,17 +125,18 @@ class EvictionManager {
           storage->BatchEviction();
           *occupy_flag = false;
         }
-        Env::Default()->SleepForMicroseconds(1);
       }
     }
-    __sync_fetch_and_sub(&num_of_active_threads_, 1);
+    BackgroundExecutor::Global()->ScheduleAfter(
+        BackgroundTaskClass::kEviction, eviction_interval_us_,
+        [this]() { EvictionPass(); });
   }
 
   int64 num_of_threads_;
   int64 num_of_active_threads_;
+  int64 eviction_interval_us_;
   std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
   std::map<MultiTierStorage<K,V>*, StorageItem<K, V>*> storage_table_;
-  std::unique_ptr<thread::ThreadPool> thread_pool_;
   mutex mu_;
 };
 
@@ -181,6 +181,12 @@ class FeatureDescriptor {
   int total_dim() const {
     return feat_desc_impl_->total_dim();
   }
+
+  // Aligned dimensions of the embedding and the optimizer slots, in the
+  // order they are laid out in a value.
+  std::vector<int64> slot_dims() const {
+    return feat_desc_impl_->slot_dims();
+  }
   
   bool IsAdmit(void* val) {
     return feat_desc_impl_->IsAdmit(val);
@@ -208,6 +208,14 @@ class FeatureDescriptorImpl {
            + slot_infos_[slot_num - 1].embedding_dim;
   }
 
+  std::vector<int64> slot_dims() const {
+    std::vector<int64> dims;
+    for (const SlotInfo& slot_info : slot_infos_) {
+      dims.push_back(slot_info.embedding_dim);
+    }
+    return dims;
+  }
+
  protected:
   bool SetEmbeddingInfo(int emb_index, int64 embedding_dim,
                     const std::pair<V*, int64>& default_value) {
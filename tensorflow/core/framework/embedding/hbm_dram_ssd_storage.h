@@ -343,20 +343,20 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
     return hbm_feat_desc_->total_dim();
   }
 
-  void Restore(const std::string& name_string,
-               const std::string& file_name_string,
-               int64 partition_id, int64 partition_num,
-               int64 value_len, bool is_incr, bool reset_version,
-               const EmbeddingConfig& emb_config,
-               const Eigen::GpuDevice* device,
-               BundleReader* reader, EmbeddingVar<K, V>* ev,
-               FilterPolicy<K, V, EmbeddingVar<K, V>>* filter) override {
+  Status Restore(const std::string& name_string,
+                 const std::string& file_name_string,
+                 int64 partition_id, int64 partition_num,
+                 int64 value_len, bool is_incr, bool reset_version,
+                 const EmbeddingConfig& emb_config,
+                 const Eigen::GpuDevice* device,
+                 BundleReader* reader, EmbeddingVar<K, V>* ev,
+                 FilterPolicy<K, V, EmbeddingVar<K, V>>* filter) override {
 
     CheckpointLoader<K, V> restorer(reinterpret_cast<Storage<K, V>*>(this), ev,
                                     filter, name_string, file_name_string,
                                     partition_id, partition_num,
                                     is_incr, reset_version, reader);
-    restorer.RestoreCkpt(emb_config, device);  
+    TF_RETURN_IF_ERROR(restorer.RestoreCkpt(emb_config, device));
 
     int64 num_of_hbm_ids =
           std::min(MultiTierStorage<K, V>::cache_capacity_,
@@ -368,7 +368,7 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
       MultiTierStorage<K, V>::cache_->get_cached_ids(hbm_ids, num_of_hbm_ids,
                                                      hbm_versions, hbm_freqs);
       ImportToHbm(hbm_ids, num_of_hbm_ids, value_len, emb_config.emb_index);
-      MultiTierStorage<K, V>::cache_thread_pool_->Schedule(
+      MultiTierStorage<K, V>::Schedule(BackgroundTaskClass::kStats,
           [this, hbm_ids, num_of_hbm_ids, hbm_versions, hbm_freqs]() {
             MultiTierStorage<K, V>::cache_->update(hbm_ids, num_of_hbm_ids,
                                                    hbm_versions, hbm_freqs);
@@ -376,6 +376,7 @@ class HbmDramSsdStorage : public MultiTierStorage<K, V> {
             delete[] hbm_freqs;
           });
     }
+    return Status::OK();
   }
 
   Status RestoreFeatures(int64 key_num, int bucket_num, int64 partition_id,
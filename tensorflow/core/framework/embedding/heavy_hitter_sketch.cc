@@ -0,0 +1,230 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/embedding/heavy_hitter_sketch.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+
+HeavyHitterSketch::HeavyHitterSketch(int64 capacity)
+    : capacity_(std::max(capacity, static_cast<int64>(1))) {
+  heap_.reserve(capacity_);
+}
+
+int64 HeavyHitterSketch::DefaultCapacity() {
+  int64 capacity = 0;
+  TF_CHECK_OK(
+      ReadInt64FromEnvVar("TF_EV_HEAVY_HITTER_CAPACITY", 0, &capacity));
+  return capacity;
+}
+
+void HeavyHitterSketch::AddLocked(int64 id, int64 count) {
+  total_ += count;
+  auto it = positions_.find(id);
+  if (it != positions_.end()) {
+    heap_[it->second].count += count;
+    SiftDown(it->second);
+  } else if (static_cast<int64>(heap_.size()) < capacity_) {
+    positions_[id] = heap_.size();
+    heap_.push_back({id, count, 0});
+    SiftUp(heap_.size() - 1);
+  } else {
+    // Replaces the id with the smallest count, which the new id may have
+    // been counted in.
+    Counter& min = heap_[0];
+    positions_.erase(min.id);
+    min = {id, min.count + count, min.count};
+    positions_[id] = 0;
+    SiftDown(0);
+  }
+}
+
+void HeavyHitterSketch::Swap(int64 a, int64 b) {
+  std::swap(heap_[a], heap_[b]);
+  positions_[heap_[a].id] = a;
+  positions_[heap_[b].id] = b;
+}
+
+void HeavyHitterSketch::SiftUp(int64 pos) {
+  while (pos > 0) {
+    int64 parent = (pos - 1) / 2;
+    if (heap_[parent].count <= heap_[pos].count) break;
+    Swap(parent, pos);
+    pos = parent;
+  }
+}
+
+void HeavyHitterSketch::SiftDown(int64 pos) {
+  const int64 size = heap_.size();
+  while (true) {
+    int64 smallest = pos;
+    for (int64 child = 2 * pos + 1; child <= 2 * pos + 2; ++child) {
+      if (child < size && heap_[child].count < heap_[smallest].count) {
+        smallest = child;
+      }
+    }
+    if (smallest == pos) break;
+    Swap(pos, smallest);
+    pos = smallest;
+  }
+}
+
+int64 HeavyHitterSketch::MinCountLocked() const {
+  return static_cast<int64>(heap_.size()) < capacity_ ? 0 : heap_[0].count;
+}
+
+void HeavyHitterSketch::Merge(const HeavyHitterSketch& other) {
+  if (&other == this) return;
+  std::vector<Counter> counters;
+  int64 other_total = 0;
+  int64 other_min = 0;
+  {
+    tf_shared_lock l(other.mu_);
+    counters = other.heap_;
+    other_total = other.total_;
+    other_min = other.MinCountLocked();
+  }
+  mutex_lock l(mu_);
+  // An id missing from a full sketch may have been seen as often as its
+  // smallest count.
+  const int64 min = MinCountLocked();
+  gtl::FlatMap<int64, int64> other_positions;
+  for (size_t i = 0; i < counters.size(); ++i) {
+    other_positions[counters[i].id] = i;
+    auto it = positions_.find(counters[i].id);
+    if (it == positions_.end()) {
+      counters[i].count += min;
+      counters[i].error += min;
+    } else {
+      counters[i].count += heap_[it->second].count;
+      counters[i].error += heap_[it->second].error;
+    }
+  }
+  for (const Counter& c : heap_) {
+    if (other_positions.find(c.id) == other_positions.end()) {
+      counters.push_back({c.id, c.count + other_min, c.error + other_min});
+    }
+  }
+  if (static_cast<int64>(counters.size()) > capacity_) {
+    std::nth_element(counters.begin(), counters.begin() + capacity_,
+                     counters.end(), [](const Counter& a, const Counter& b) {
+                       return a.count > b.count;
+                     });
+    counters.resize(capacity_);
+  }
+  total_ += other_total;
+  heap_.swap(counters);
+  positions_.clear();
+  for (size_t i = 0; i < heap_.size(); ++i) {
+    positions_[heap_[i].id] = i;
+  }
+  for (int64 i = static_cast<int64>(heap_.size()) / 2 - 1; i >= 0; --i) {
+    SiftDown(i);
+  }
+}
+
+void HeavyHitterSketch::Report(int64 k, const std::vector<float>& coverages,
+                               HeavyHitterReport* report) const {
+  std::vector<Counter> counters;
+  {
+    tf_shared_lock l(mu_);
+    counters = heap_;
+    report->total = total_;
+  }
+  std::sort(counters.begin(), counters.end(),
+            [](const Counter& a, const Counter& b) {
+              return a.count > b.count;
+            });
+  const int64 num_ids = std::min(static_cast<int64>(counters.size()), k);
+  report->ids.resize(num_ids);
+  report->freqs.resize(num_ids);
+  for (int64 i = 0; i < num_ids; ++i) {
+    report->ids[i] = counters[i].id;
+    report->freqs[i] = counters[i].count;
+  }
+
+  // Guaranteed counts are lower bounds, so the working set sizes are
+  // upper bounds.
+  std::vector<int64> covered(counters.size());
+  int64 sum = 0;
+  for (size_t i = 0; i < counters.size(); ++i) {
+    sum += counters[i].count - counters[i].error;
+    covered[i] = sum;
+  }
+  report->working_set_sizes.clear();
+  for (float coverage : coverages) {
+    const double target = static_cast<double>(coverage) * report->total;
+    auto it = std::lower_bound(
+        covered.begin(), covered.end(), target,
+        [](int64 value, double target) { return value < target; });
+    report->working_set_sizes.push_back(
+        it == covered.end() ? -1 : it - covered.begin() + 1);
+  }
+}
+
+void HeavyHitterSketch::Clear() {
+  mutex_lock l(mu_);
+  total_ = 0;
+  heap_.clear();
+  positions_.clear();
+}
+
+HeavyHitterRegistry* HeavyHitterRegistry::Global() {
+  static HeavyHitterRegistry* registry = new HeavyHitterRegistry;
+  return registry;
+}
+
+void HeavyHitterRegistry::Register(const std::string& name,
+                                   HeavyHitterSketch* sketch) {
+  mutex_lock l(mu_);
+  sketches_.emplace(name, sketch);
+}
+
+void HeavyHitterRegistry::Unregister(const std::string& name,
+                                     HeavyHitterSketch* sketch) {
+  mutex_lock l(mu_);
+  auto range = sketches_.equal_range(name);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == sketch) {
+      sketches_.erase(it);
+      return;
+    }
+  }
+}
+
+bool HeavyHitterRegistry::Merge(const std::string& name,
+                                HeavyHitterSketch* merged) {
+  const std::string partition_prefix = name + "/part_";
+  bool found = false;
+  mutex_lock l(mu_);
+  for (auto it = sketches_.lower_bound(name); it != sketches_.end(); ++it) {
+    if (it->first != name &&
+        !str_util::StartsWith(it->first, partition_prefix)) {
+      if (!str_util::StartsWith(it->first, name)) break;
+      continue;
+    }
+    merged->Merge(*it->second);
+    found = true;
+  }
+  return found;
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
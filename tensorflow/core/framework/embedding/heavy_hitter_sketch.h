@@ -0,0 +1,126 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HEAVY_HITTER_SKETCH_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HEAVY_HITTER_SKETCH_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+struct HeavyHitterReport {
+  // The most frequent ids by decreasing estimated frequency. An estimate
+  // exceeds the true frequency by at most the smallest tracked count.
+  std::vector<int64> ids;
+  std::vector<int64> freqs;
+  // The number of ids looked up, with repetitions.
+  int64 total = 0;
+  // For each requested coverage, the estimated number of ids that receive
+  // that fraction of all lookups, or -1 if it takes more ids than the
+  // sketch tracks.
+  std::vector<int64> working_set_sizes;
+};
+
+// SpaceSaving summary of the ids looked up in an EmbeddingVariable.
+//
+// Tracks at most `capacity` ids in a min-heap on their counts. An id that is
+// not tracked replaces the id with the smallest count and inherits that count
+// as its error. Every id occurring more than total / capacity times is
+// guaranteed to be tracked. Updates cost O(log capacity) per unique id of a
+// batch. Sketches with the same capacity are mergeable, e.g. the partitions
+// of a variable.
+class HeavyHitterSketch {
+ public:
+  explicit HeavyHitterSketch(int64 capacity);
+
+  // Capacity of the sketches maintained by EmbeddingVariables, read from
+  // TF_EV_HEAVY_HITTER_CAPACITY when a variable is initialized. 0, the
+  // default, disables them.
+  static int64 DefaultCapacity();
+
+  int64 capacity() const { return capacity_; }
+
+  // Counts `n` ids, each `counts[i]` times or once if `counts` is null.
+  template <typename K>
+  void Add(const K* ids, const int64* counts, int64 n) {
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < n; ++i) {
+      AddLocked(static_cast<int64>(ids[i]), counts ? counts[i] : 1);
+    }
+  }
+
+  // Adds the counts of `other` to this sketch.
+  void Merge(const HeavyHitterSketch& other);
+
+  // Fills `report` with the `k` most frequent ids and the working set sizes
+  // of `coverages`, each in (0, 1].
+  void Report(int64 k, const std::vector<float>& coverages,
+              HeavyHitterReport* report) const;
+
+  void Clear();
+
+ private:
+  struct Counter {
+    int64 id;
+    int64 count;
+    int64 error;  // Upper bound of the overestimation of `count`.
+  };
+
+  void AddLocked(int64 id, int64 count) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void SiftUp(int64 pos) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void SiftDown(int64 pos) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Swap(int64 a, int64 b) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Count an id that isn't tracked may have.
+  int64 MinCountLocked() const SHARED_LOCKS_REQUIRED(mu_);
+
+  const int64 capacity_;
+  mutable mutex mu_;
+  int64 total_ GUARDED_BY(mu_) = 0;
+  std::vector<Counter> heap_ GUARDED_BY(mu_);
+  gtl::FlatMap<int64, int64> positions_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HeavyHitterSketch);
+};
+
+// Sketches of the EmbeddingVariables alive in the process by variable name,
+// for callers without access to the resources, e.g. the C API.
+class HeavyHitterRegistry {
+ public:
+  static HeavyHitterRegistry* Global();
+
+  void Register(const std::string& name, HeavyHitterSketch* sketch);
+
+  void Unregister(const std::string& name, HeavyHitterSketch* sketch);
+
+  // Merges the sketches of variable `name` and of its partitions
+  // `name`/part_<i> into `merged`. Returns false if there are none.
+  bool Merge(const std::string& name, HeavyHitterSketch* merged);
+
+ private:
+  mutex mu_;
+  std::multimap<std::string, HeavyHitterSketch*> sketches_ GUARDED_BY(mu_);
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_HEAVY_HITTER_SKETCH_H_
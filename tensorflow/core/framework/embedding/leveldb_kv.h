@@ -19,11 +19,16 @@ limitations under the License.
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/env_var.h"
 
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/comparator.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/write_batch.h"
 
+#include <algorithm>
+#include <numeric>
 #include <sstream>
 
 using leveldb::DB;
@@ -76,6 +81,24 @@ class LevelDBKV : public KVInterface<K, V> {
     path_ = io::JoinPath(path,
         "level_db_" + std::to_string(Env::Default()->NowMicros()));;
     options_.create_if_missing = true;
+
+    int64 block_cache_mb = 8;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_LEVELDB_BLOCK_CACHE_MB",
+                                    8, &block_cache_mb));
+    block_cache_ = leveldb::NewLRUCache(block_cache_mb << 20);
+    options_.block_cache = block_cache_;
+    int64 bloom_bits = 10;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_LEVELDB_BLOOM_BITS_PER_KEY",
+                                    10, &bloom_bits));
+    if (bloom_bits > 0) {
+      filter_policy_ = leveldb::NewBloomFilterPolicy(bloom_bits);
+      options_.filter_policy = filter_policy_;
+    }
+    int64 write_buffer_mb = 4;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_LEVELDB_WRITE_BUFFER_MB",
+                                    4, &write_buffer_mb));
+    options_.write_buffer_size = write_buffer_mb << 20;
+
     leveldb::Status s = leveldb::DB::Open(options_, path_, &db_);
     CHECK(s.ok());
     counter_ =  new SizeCounter<K>(8);
@@ -83,11 +106,13 @@ class LevelDBKV : public KVInterface<K, V> {
 
   ~LevelDBKV() override {
     delete db_;
+    delete block_cache_;
+    delete filter_policy_;
   }
 
   Status Lookup(K key, void** value_ptr) override {
     std::string val_str;
-    leveldb::Slice db_key((char*)(&key), sizeof(void*));
+    leveldb::Slice db_key = DBKey(key);
     leveldb::ReadOptions options;
     leveldb::Status s = db_->Get(options, db_key, &val_str);
     if (s.IsNotFound()) {
@@ -101,9 +126,37 @@ class LevelDBKV : public KVInterface<K, V> {
     }
   }
 
+  // Looks up `size` keys in the order of the DB, so that neighbouring keys
+  // hit the blocks their predecessors loaded into the block cache, and
+  // missing keys are mostly rejected by the bloom filters. Missing keys get
+  // a null value_ptr.
+  Status BatchLookup(const K* keys, size_t size,
+                     void** value_ptrs) override {
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    const leveldb::Comparator* cmp = options_.comparator;
+    std::sort(order.begin(), order.end(), [keys, cmp](size_t a, size_t b) {
+      return cmp->Compare(DBKey(keys[a]), DBKey(keys[b])) < 0;
+    });
+    leveldb::ReadOptions options;
+    std::string val_str;
+    for (size_t i : order) {
+      value_ptrs[i] = nullptr;
+      leveldb::Status s = db_->Get(options, DBKey(keys[i]), &val_str);
+      if (s.ok()) {
+        void* val = feat_desc_->Allocate();
+        memcpy(val, &val_str[0], val_str.length());
+        value_ptrs[i] = val;
+      } else if (!s.IsNotFound()) {
+        return FromLevelDBStatus(s);
+      }
+    }
+    return Status::OK();
+  }
+
   Status Contains(K key) override {
     std::string val_str;
-    leveldb::Slice db_key((char*)(&key), sizeof(void*));
+    leveldb::Slice db_key = DBKey(key);
     leveldb::ReadOptions options;
     leveldb::Status s = db_->Get(options, db_key, &val_str);
     if (s.IsNotFound()) {
@@ -126,22 +179,31 @@ class LevelDBKV : public KVInterface<K, V> {
 
   Status BatchCommit(const std::vector<K>& keys,
       const std::vector<void*>& value_ptrs) override {
-    WriteBatch batch;
+    Status s = BatchWrite(keys, value_ptrs);
     for (int i = 0; i < keys.size(); i++) {
-      std::string value_res((char*)value_ptrs[i],
-          feat_desc_->data_bytes());
-      leveldb::Slice db_key((char*)(&keys[i]), sizeof(void*));
-      batch.Put(db_key, value_res);
       delete value_ptrs[i];
     }
-    db_->Write(WriteOptions(),&batch);
-    return Status::OK();
+    return s;
+  }
+
+  // Writes the values of `keys` in one WriteBatch, i.e. with one log
+  // write and one memtable lock instead of one per key. The values stay
+  // owned by the caller.
+  Status BatchWrite(const std::vector<K>& keys,
+                    const std::vector<void*>& value_ptrs) {
+    WriteBatch batch;
+    for (int i = 0; i < keys.size(); i++) {
+      batch.Put(DBKey(keys[i]),
+                leveldb::Slice((char*)value_ptrs[i],
+                               feat_desc_->data_bytes()));
+    }
+    return FromLevelDBStatus(db_->Write(WriteOptions(), &batch));
   }
 
   Status Commit(K key, const void* value_ptr) override {
     std::string value_res((char*)value_ptr,
         feat_desc_->data_bytes());
-    leveldb::Slice db_key((char*)(&key), sizeof(void*));
+    leveldb::Slice db_key = DBKey(key);
     leveldb::Status s = db_->Put(WriteOptions(), db_key, value_res);
     if (!s.ok()){
       return errors::AlreadyExists(
@@ -153,7 +215,7 @@ class LevelDBKV : public KVInterface<K, V> {
 
   Status Remove(K key) override {
     counter_->sub(key, 1);
-    leveldb::Slice db_key((char*)(&key), sizeof(void*));
+    leveldb::Slice db_key = DBKey(key);
     leveldb::Status s = db_->Delete(WriteOptions(), db_key);
     if (s.ok()) {
       return Status::OK();
@@ -240,7 +302,19 @@ class LevelDBKV : public KVInterface<K, V> {
   }
 
  private:
+  // The key refers to the memory of `key`, which must outlive it.
+  static leveldb::Slice DBKey(const K& key) {
+    return leveldb::Slice(reinterpret_cast<const char*>(&key), sizeof(K));
+  }
+
+  static Status FromLevelDBStatus(const leveldb::Status& s) {
+    if (s.ok()) return Status::OK();
+    return errors::Internal("LevelDB: ", s.ToString());
+  }
+
   DB* db_;
+  leveldb::Cache* block_cache_ = nullptr;
+  const leveldb::FilterPolicy* filter_policy_ = nullptr;
   SizeCounter<K>* counter_;
   Options options_;
   std::string path_;
@@ -0,0 +1,264 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/embedding/memory_governor.h"
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace embedding {
+namespace {
+
+auto* memory_usage_bytes = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/embedding/memory_usage_bytes",
+    "Memory usage of the cgroup seen by the EmbeddingVariable governor.");
+
+auto* memory_limit_bytes = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/embedding/memory_limit_bytes",
+    "Memory limit of the cgroup seen by the EmbeddingVariable governor.");
+
+auto* memory_pressure = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/embedding/memory_pressure",
+    "Memory pressure level: 0 below the low watermark, 1 between the "
+    "watermarks, 2 above the high watermark.");
+
+auto* throttled_admissions = monitoring::Counter<0>::New(
+    "/tensorflow/core/embedding/memory_throttled_admissions",
+    "The number of keys not admitted because of memory pressure.");
+
+// cgroup v1 reports "no limit" as a page-aligned LONG_MAX.
+constexpr int64 kUnlimited = 1LL << 62;
+
+const char* const kCgroupRoot = "/sys/fs/cgroup";
+
+double ReadDoubleFromEnvVar(StringPiece env_var_name, double default_val) {
+  string str;
+  TF_CHECK_OK(ReadStringFromEnvVar(env_var_name, "", &str));
+  double value = default_val;
+  if (!str.empty() && !strings::safe_strtod(str, &value)) {
+    LOG(WARNING) << "Failed to parse " << env_var_name << "=" << str
+                 << ", using " << default_val;
+    return default_val;
+  }
+  return value;
+}
+
+bool ReadInt64File(const string& fname, int64* value) {
+  string content;
+  if (!ReadFileToString(Env::Default(), fname, &content).ok()) {
+    return false;
+  }
+  // safe_strto64 skips the trailing newline.
+  return strings::safe_strto64(content, value);
+}
+
+// Returns the value of `key` in a memory.stat file, or 0.
+int64 ReadStat(const string& fname, StringPiece key) {
+  string content;
+  if (!ReadFileToString(Env::Default(), fname, &content).ok()) {
+    return 0;
+  }
+  for (StringPiece line : str_util::Split(content, '\n')) {
+    StringPiece value = line;
+    if (str_util::ConsumePrefix(&value, key) &&
+        str_util::ConsumePrefix(&value, " ")) {
+      int64 result = 0;
+      if (strings::safe_strto64(value, &result)) return result;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+MemoryGovernor* MemoryGovernor::Get() {
+  static MemoryGovernor* governor = [] {
+    Options options;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_EV_MEMORY_GOVERNOR", false,
+                                   &options.enable));
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_EV_MEMORY_CGROUP_PATH", "",
+                                     &options.cgroup_path));
+    int64 limit_mb = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_MEMORY_LIMIT_MB", 0, &limit_mb));
+    options.limit_bytes = limit_mb << 20;
+    options.low_watermark = ReadDoubleFromEnvVar(
+        "TF_EV_MEMORY_LOW_WATERMARK", options.low_watermark);
+    options.high_watermark = ReadDoubleFromEnvVar(
+        "TF_EV_MEMORY_HIGH_WATERMARK", options.high_watermark);
+    options.eviction_fraction = ReadDoubleFromEnvVar(
+        "TF_EV_MEMORY_EVICTION_FRACTION", options.eviction_fraction);
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_MEMORY_ADMISSION_FACTOR",
+                                    options.admission_factor,
+                                    &options.admission_factor));
+    int64 interval_ms = 0;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EV_MEMORY_GOVERNOR_INTERVAL_MS",
+                                    options.interval_micros / 1000,
+                                    &interval_ms));
+    options.interval_micros = interval_ms * 1000;
+    return new MemoryGovernor(options);
+  }();
+  return governor;
+}
+
+MemoryGovernor::MemoryGovernor(const Options& options) : options_(options) {
+  if (!options_.enable) return;
+  if (options_.low_watermark <= 0 ||
+      options_.high_watermark <= options_.low_watermark ||
+      options_.high_watermark > 1) {
+    LOG(WARNING) << "Invalid memory watermarks [" << options_.low_watermark
+                 << ", " << options_.high_watermark
+                 << "], EmbeddingVariable memory governor is disabled.";
+    return;
+  }
+  options_.eviction_fraction =
+      std::min(std::max(options_.eviction_fraction, 0.0), 1.0);
+  options_.admission_factor = std::max(options_.admission_factor,
+                                       static_cast<int64>(1));
+  Env* env = Env::Default();
+  if (options_.cgroup_path.empty()) {
+    if (env->FileExists(io::JoinPath(kCgroupRoot, "memory.max")).ok()) {
+      options_.cgroup_path = kCgroupRoot;
+    } else {
+      options_.cgroup_path = io::JoinPath(kCgroupRoot, "memory");
+    }
+  }
+  cgroup_v2_ =
+      env->FileExists(io::JoinPath(options_.cgroup_path, "memory.max")).ok();
+  int64 usage = 0;
+  int64 limit = 0;
+  if (!ReadCgroup(&usage, &limit)) {
+    LOG(WARNING) << "No memory usage or limit found in cgroup "
+                 << options_.cgroup_path
+                 << ", EmbeddingVariable memory governor is disabled.";
+    return;
+  }
+  enabled_ = true;
+  LOG(INFO) << "EmbeddingVariable memory governor enabled, cgroup "
+            << (cgroup_v2_ ? "v2 " : "v1 ") << options_.cgroup_path
+            << ", limit " << limit << " bytes, watermarks ["
+            << options_.low_watermark << ", " << options_.high_watermark
+            << "]";
+  Refresh();
+  if (options_.background_refresh) {
+    refresh_thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "EV_MEMORY_GOVERNOR", [this]() { RefreshLoop(); }));
+  }
+}
+
+bool MemoryGovernor::ReadCgroup(int64* usage, int64* limit) const {
+  const string& dir = options_.cgroup_path;
+  const char* usage_file =
+      cgroup_v2_ ? "memory.current" : "memory.usage_in_bytes";
+  if (!ReadInt64File(io::JoinPath(dir, usage_file), usage)) {
+    return false;
+  }
+  // Clean page cache, e.g. of the SSD tier files, is reclaimed by the
+  // kernel before the OOM killer runs.
+  *usage -= ReadStat(io::JoinPath(dir, "memory.stat"),
+                     cgroup_v2_ ? "inactive_file" : "total_inactive_file");
+  *usage = std::max(*usage, static_cast<int64>(0));
+
+  *limit = options_.limit_bytes;
+  if (*limit <= 0) {
+    // memory.max contains "max" if there is no limit, which fails to parse.
+    const char* limit_file =
+        cgroup_v2_ ? "memory.max" : "memory.limit_in_bytes";
+    if (!ReadInt64File(io::JoinPath(dir, limit_file), limit) ||
+        *limit <= 0 || *limit >= kUnlimited) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MemoryGovernor::~MemoryGovernor() {
+  {
+    mutex_lock l(mu_);
+    shutdown_ = true;
+    shutdown_cv_.notify_all();
+  }
+  // Joins the refresh thread.
+  refresh_thread_.reset();
+}
+
+void MemoryGovernor::RefreshLoop() {
+  mutex_lock l(mu_);
+  while (!shutdown_) {
+    shutdown_cv_.wait_for(
+        l, std::chrono::microseconds(options_.interval_micros));
+    if (!shutdown_) RefreshLocked();
+  }
+}
+
+void MemoryGovernor::Refresh() {
+  if (!enabled_) return;
+  mutex_lock l(mu_);
+  RefreshLocked();
+}
+
+void MemoryGovernor::RefreshLocked() {
+  int64 usage = 0;
+  int64 limit = 0;
+  if (!ReadCgroup(&usage, &limit)) {
+    VLOG(1) << "Failed to read cgroup " << options_.cgroup_path;
+    return;
+  }
+  const double ratio = static_cast<double>(usage) / limit;
+  Pressure level = kNone;
+  if (ratio >= options_.high_watermark) {
+    level = kHigh;
+  } else if (ratio >= options_.low_watermark) {
+    level = kLow;
+  }
+  if (level != pressure()) {
+    LOG(INFO) << "EmbeddingVariable memory pressure changed to " << level
+              << ", usage " << usage << " of " << limit << " bytes";
+  }
+  usage_bytes_.store(usage, std::memory_order_relaxed);
+  limit_bytes_.store(limit, std::memory_order_relaxed);
+  usage_ratio_.store(ratio, std::memory_order_relaxed);
+  pressure_.store(level, std::memory_order_relaxed);
+  epoch_.fetch_add(1, std::memory_order_release);
+
+  memory_usage_bytes->GetCell()->Set(usage);
+  memory_limit_bytes->GetCell()->Set(limit);
+  memory_pressure->GetCell()->Set(level);
+}
+
+int64 MemoryGovernor::ShrinkTarget(int64 capacity, int64 cache_count) const {
+  if (!enabled_) return capacity;
+  const double ratio = usage_ratio_.load(std::memory_order_relaxed);
+  if (ratio < options_.low_watermark) return capacity;
+  const double severity =
+      std::min(1.0, (ratio - options_.low_watermark) /
+                        (options_.high_watermark - options_.low_watermark));
+  const int64 evict_count = static_cast<int64>(
+      cache_count * options_.eviction_fraction * severity);
+  return std::min(capacity, cache_count - evict_count);
+}
+
+void MemoryGovernor::RecordThrottledAdmission() {
+  throttled_admissions->GetCell()->IncrementBy(1);
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
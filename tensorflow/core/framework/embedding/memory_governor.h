@@ -0,0 +1,149 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MEMORY_GOVERNOR_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MEMORY_GOVERNOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Process-wide controller that keeps the DRAM tiers of EmbeddingVariables
+// under the memory limit of the container.
+//
+// Every refresh interval the governor reads the memory usage and limit of
+// the cgroup (v1 or v2) the process runs in. Page cache that can be reclaimed
+// (inactive_file) is not counted as usage. With the usage ratio above the
+// low watermark, multi-tier storages shrink their DRAM cache by a fraction
+// proportional to how close the ratio is to the high watermark, once per
+// refresh interval. Above the high watermark the full fraction is evicted
+// each interval and the admission frequency of feature filters is raised,
+// so bursts of new ids stay on the lower tiers or are filtered out.
+//
+// Configured by environment variables:
+//   TF_EV_MEMORY_GOVERNOR: enables the governor, default false.
+//   TF_EV_MEMORY_CGROUP_PATH: cgroup directory, detected by default.
+//   TF_EV_MEMORY_LIMIT_MB: overrides the cgroup limit.
+//   TF_EV_MEMORY_LOW_WATERMARK: default 0.75.
+//   TF_EV_MEMORY_HIGH_WATERMARK: default 0.9.
+//   TF_EV_MEMORY_EVICTION_FRACTION: fraction of a DRAM cache evicted per
+//     interval above the high watermark, default 0.1.
+//   TF_EV_MEMORY_ADMISSION_FACTOR: multiplier of filter_freq above the
+//     high watermark, default 2.
+//   TF_EV_MEMORY_GOVERNOR_INTERVAL_MS: refresh interval, default 100.
+class MemoryGovernor {
+ public:
+  enum Pressure {
+    kNone = 0,  // Usage below the low watermark.
+    kLow = 1,   // Usage between the low and the high watermark.
+    kHigh = 2,  // Usage above the high watermark.
+  };
+
+  struct Options {
+    bool enable = true;
+    std::string cgroup_path;
+    int64 limit_bytes = 0;
+    double low_watermark = 0.75;
+    double high_watermark = 0.9;
+    double eviction_fraction = 0.1;
+    int64 admission_factor = 2;
+    int64 interval_micros = 100 * 1000;
+    // Refreshes the counters every `interval_micros` on a dedicated thread.
+    bool background_refresh = true;
+  };
+
+  // Returns the process-wide governor configured from the environment.
+  static MemoryGovernor* Get();
+
+  // Creates a governor that is enabled if `options.enable` is set and the
+  // cgroup usage and a limit can be read.
+  explicit MemoryGovernor(const Options& options);
+
+  ~MemoryGovernor();
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemoryGovernor);
+
+  bool enabled() const { return enabled_; }
+
+  // Re-reads the cgroup counters and updates the pressure level.
+  void Refresh();
+
+  // Incremented by every refresh. Storages apply at most one shrink step
+  // per epoch.
+  uint64 epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+  Pressure pressure() const {
+    return static_cast<Pressure>(pressure_.load(std::memory_order_relaxed));
+  }
+
+  int64 usage_bytes() const {
+    return usage_bytes_.load(std::memory_order_relaxed);
+  }
+
+  int64 limit_bytes() const {
+    return limit_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of entries a DRAM cache configured with `capacity`
+  // that currently holds `cache_count` entries should be trimmed to.
+  int64 ShrinkTarget(int64 capacity, int64 cache_count) const;
+
+  // Returns the admission frequency a feature filter should apply instead
+  // of `filter_freq`.
+  int64 AdmissionFreq(int64 filter_freq) const {
+    if (pressure() != kHigh) return filter_freq;
+    return std::max(filter_freq, static_cast<int64>(1)) * options_.admission_factor;
+  }
+
+  // Records a key that was not admitted only because of memory pressure.
+  void RecordThrottledAdmission();
+
+ private:
+  // Fills `usage` and `limit` from the cgroup files, returns false if they
+  // can't be read.
+  bool ReadCgroup(int64* usage, int64* limit) const;
+
+  void RefreshLoop();
+
+  void RefreshLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Options options_;
+  bool enabled_ = false;
+  bool cgroup_v2_ = false;
+
+  mutex mu_;
+  condition_variable shutdown_cv_;
+  bool shutdown_ GUARDED_BY(mu_) = false;
+  std::unique_ptr<Thread> refresh_thread_;
+
+  std::atomic<uint64> epoch_{0};
+  std::atomic<int> pressure_{kNone};
+  std::atomic<int64> usage_bytes_{0};
+  std::atomic<int64> limit_bytes_{0};
+  std::atomic<double> usage_ratio_{0.0};
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MEMORY_GOVERNOR_H_
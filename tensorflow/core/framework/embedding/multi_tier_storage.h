@@ -15,8 +15,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MULTI_TIER_STORAGE_H_
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_MULTI_TIER_STORAGE_H_
 
+#include <limits>
+#include <memory>
+
+#include "tensorflow/core/framework/embedding/background_executor.h"
 #include "tensorflow/core/framework/embedding/cache_factory.h"
-#include "tensorflow/core/framework/embedding/cache_thread_pool_creator.h"
 #include "tensorflow/core/framework/embedding/config.pb.h"
 #include "tensorflow/core/framework/embedding/cpu_hash_map_kv.h"
 #include "tensorflow/core/framework/embedding/embedding_var_context.h"
@@ -25,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/globalstep_shrink_policy.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/framework/embedding/l2weight_shrink_policy.h"
+#include "tensorflow/core/framework/embedding/memory_governor.h"
 #include "tensorflow/core/framework/embedding/storage_config.h"
 #include "tensorflow/core/framework/embedding/storage.h"
 #include "tensorflow/core/framework/embedding/cache_profiler.h"
@@ -48,9 +52,12 @@ template<typename K, typename V>
 class MultiTierStorage : public Storage<K, V>, public TunableCache {
 public:
     MultiTierStorage(const StorageConfig &sc, const std::string &name)
-            : Storage<K, V>(sc), name_(name) {}
+            : Storage<K, V>(sc), name_(name),
+              cache_strand_(new BackgroundStrand()) {}
 
     virtual ~MultiTierStorage() {
+      // The pending cache tasks use cache_.
+      cache_strand_.reset();
       delete cache_;
     }
 
@@ -110,7 +117,6 @@ public:
       }
       eviction_manager_ = EvictionManagerCreator::Create<K, V>();
       eviction_manager_->AddStorage(this);
-      cache_thread_pool_ = CacheThreadPoolCreator::Create();
     }
   }
 
@@ -171,7 +177,7 @@ public:
   }
 
   void Schedule(std::function<void()> fn) override {
-    cache_thread_pool_->Schedule(std::move(fn));
+    Schedule(BackgroundTaskClass::kPrefetch, std::move(fn));
   }
 
   virtual Status Eviction(K* evict_ids, int64 evict_size) override {
@@ -184,25 +190,41 @@ public:
     K evic_ids[EvictionSize];
     if (!ready_eviction_)
       return;
-    int cache_count = cache_->size();
-    if (cache_count > cache_capacity_) {
+    int64 cache_count = cache_->size();
+    int64 capacity = GovernedCapacity(cache_count);
+    if (cache_count > capacity) {
       // eviction
-      int k_size = cache_count - cache_capacity_;
-      k_size = std::min(k_size, EvictionSize);
+      int k_size = std::min(cache_count - capacity,
+                            static_cast<int64>(EvictionSize));
       size_t true_size = cache_->get_evic_ids(evic_ids, k_size);
       EvictionWithDelayedDestroy(evic_ids, true_size);
     }
   }
 
+  // Returns the capacity the DRAM cache is trimmed to. Under memory
+  // pressure the MemoryGovernor lowers it by one step per refresh epoch.
+  int64 GovernedCapacity(int64 cache_count) {
+    MemoryGovernor* governor = MemoryGovernor::Get();
+    if (!governor->enabled()) return cache_capacity_;
+    const uint64 epoch = governor->epoch();
+    mutex_lock l(Storage<K, V>::mu_);
+    if (epoch != governor_epoch_) {
+      governor_epoch_ = epoch;
+      governed_capacity_ =
+          governor->ShrinkTarget(cache_capacity_, cache_count);
+    }
+    return std::min(governed_capacity_, cache_capacity_);
+  }
+
   void UpdateCache(const Tensor& indices,
                    const Tensor& indices_counts) override {
-    Schedule([this, indices, indices_counts]() {
+    Schedule(BackgroundTaskClass::kStats, [this, indices, indices_counts]() {
       cache_->update(indices, indices_counts);
     });
   }
 
   void UpdateCache(const Tensor& indices) override {
-    Schedule([this, indices]() {
+    Schedule(BackgroundTaskClass::kStats, [this, indices]() {
       cache_->update(indices);
     });
   }
@@ -212,13 +234,13 @@ public:
   }
 
   void AddToCachePrefetchList(const Tensor& indices) override {
-    Schedule([this, indices]() {
+    Schedule(BackgroundTaskClass::kPrefetch, [this, indices]() {
       cache_->add_to_prefetch_list(indices);
     });
   }
 
   void AddToCache(const Tensor& indices) override {
-    Schedule([this, indices]() {
+    Schedule(BackgroundTaskClass::kPrefetch, [this, indices]() {
       cache_->add_to_cache(indices);
     });
   }
@@ -288,6 +310,12 @@ public:
     value_ptr_out_of_date_.emplace_back(value_ptr);
   }
 
+  // Runs cache maintenance on the executor shared by all storages. The
+  // tasks of a storage run one at a time in the order they are scheduled.
+  void Schedule(BackgroundTaskClass cls, std::function<void()> fn) {
+    cache_strand_->Schedule(cls, std::move(fn));
+  }
+
 #if GOOGLE_CUDA
   void CopyEmbeddingsFromDramToHbm(const EmbeddingVarContext<GPUDevice>& context,
                                    const K* keys,
@@ -307,7 +335,6 @@ public:
   BatchCache<K>* cache_ = nullptr;
 
   EvictionManager<K, V>* eviction_manager_;
-  thread::ThreadPool* cache_thread_pool_;
 
   condition_variable shutdown_cv_;
   volatile bool shutdown_ = false;
@@ -315,7 +342,12 @@ public:
   int64 cache_capacity_ = -1;
   volatile bool ready_eviction_ = false;
 
+  // Guarded by Storage<K, V>::mu_.
+  uint64 governor_epoch_ = 0;
+  int64 governed_capacity_ = std::numeric_limits<int64>::max();
+
   std::string name_;
+  std::unique_ptr<BackgroundStrand> cache_strand_;
   std::vector<mutex> mu_list_;
 };
 
@@ -568,6 +568,17 @@ class LevelDBStore : public SingleTierStorage<K, V> {
     return SingleTierStorage<K, V>::kv_->Commit(keys, value_ptr);
   }
 
+  Status BatchGet(const K* keys, size_t size, void** value_ptrs) {
+    return SingleTierStorage<K, V>::kv_->BatchLookup(keys, size, value_ptrs);
+  }
+
+  Status BatchWrite(const std::vector<K>& keys,
+                    const std::vector<void*>& value_ptrs) {
+    LevelDBKV<K, V>* leveldb_kv =
+        reinterpret_cast<LevelDBKV<K, V>*>(SingleTierStorage<K, V>::kv_);
+    return leveldb_kv->BatchWrite(keys, value_ptrs);
+  }
+
   embedding::ValueIterator<V>* GetValueIterator(
       const std::vector<K>& key_list,
       int64 emb_index, int64 value_len) {
@@ -646,6 +657,12 @@ class SsdHashStorage : public SingleTierStorage<K, V> {
         reinterpret_cast<SSDHashKV<K, V>*>(SingleTierStorage<K, V>::kv_);
     ssd_kv->SetSsdRecordDescriptor(ssd_rec_desc);
   }
+
+  SsdValueCodecType value_codec_type() {
+    SSDHashKV<K, V>* ssd_kv =
+        reinterpret_cast<SSDHashKV<K, V>*>(SingleTierStorage<K, V>::kv_);
+    return ssd_kv->value_codec_type();
+  }
  public:
   friend class DramSsdHashStorage<K, V>;
 #if GOOGLE_CUDA
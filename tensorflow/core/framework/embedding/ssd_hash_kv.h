@@ -17,12 +17,15 @@ limitations under the License.
 #define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_HASH_KV_H_
 
 #include <map>
+#include <memory>
 #include <vector>
 #include <cstdlib>
 
 #include "sparsehash/dense_hash_map_lockless"
 #include "sparsehash/dense_hash_set_lockless"
+#include "tensorflow/core/framework/embedding/background_executor.h"
 #include "tensorflow/core/framework/embedding/ssd_record_descriptor.h"
+#include "tensorflow/core/framework/embedding/ssd_value_codec.h"
 #include "tensorflow/core/framework/embedding/emb_file_creator.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -160,6 +163,11 @@ class SSDHashKV : public KVInterface<K, V> {
     TF_CHECK_OK(ReadStringFromEnvVar(
         "TF_SSDHASH_IO_SCHEME", "mmap_and_madvise", &io_scheme));
     emb_file_creator_ =  EmbFileCreatorFactory::Create(io_scheme);
+
+    std::string value_codec = "raw";
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_SSDHASH_VALUE_CODEC", "raw", &value_codec));
+    codec_type_ = ParseSsdValueCodecType(value_codec);
     EmbFile* ef = emb_file_creator_->Create(path_, current_version_, BUFFER_SIZE);
     emb_files_.emplace_back(ef);
 
@@ -181,15 +189,22 @@ class SSDHashKV : public KVInterface<K, V> {
           bool is_compaction=false) {
         SaveKVAsync(key, value_ptr, is_compaction);
       };
-      compaction_thread_ = Env::Default()->StartThread(
-          ThreadOptions(), "COMPACTION", [this]() {
-            CompactionThread();
-          });
+      compaction_state_ = std::make_shared<CompactionState>();
+      ScheduleCompaction(compaction_state_, 0);
     }
   }
 
   void Init() {
-    val_len_ = feat_desc_->data_bytes();
+    // Records in files and the write buffer are encoded rows, val_len_ is
+    // the size of a record.
+    codec_ = SsdValueCodec<V>(codec_type_, feat_desc_->slot_dims(),
+                              feat_desc_->data_bytes());
+    val_len_ = codec_.record_bytes();
+    if (!codec_.is_raw()) {
+      LOG(INFO) << "SSDHashKV stores rows of " << codec_.row_bytes()
+                << " bytes as " << SsdValueCodecTypeName(codec_.type())
+                << " records of " << val_len_ << " bytes.";
+    }
     max_app_count_ = BUFFER_SIZE / val_len_;
     write_buffer_ = new char[BUFFER_SIZE];
     unsigned int max_key_count = 1 + int(BUFFER_SIZE / val_len_);
@@ -206,6 +221,7 @@ class SSDHashKV : public KVInterface<K, V> {
       ssd_rec_desc->key_offset_list.emplace_back(ssd_iter.Offset());
     }
     ssd_rec_desc->file_prefix = path_;
+    ssd_rec_desc->value_codec = static_cast<int64>(codec_.type());
 
     for (auto file: emb_files_) {
       if (file->IsDeleted())
@@ -238,6 +254,14 @@ class SSDHashKV : public KVInterface<K, V> {
   }
 
   ~SSDHashKV() override {
+    if (compaction_state_ != nullptr) {
+      // Compaction tasks still queued see the flag and return.
+      mutex_lock l(compaction_state_->mu);
+      compaction_state_->shutdown = true;
+      while (compaction_state_->running) {
+        compaction_state_->cv.wait(l);
+      }
+    }
     if (buffer_cur_ > 0) {
       if (!is_async_compaction_) {
         emb_files_[current_version_]->Write(write_buffer_,
@@ -245,11 +269,6 @@ class SSDHashKV : public KVInterface<K, V> {
       } else {
         emb_files_[evict_version_]->Write(write_buffer_,
             buffer_cur_ * val_len_);
-        mutex_lock l(shutdown_mu_);
-        shutdown_ = true;
-        // Need last compaction or not???
-        // CompactionAsync();
-        delete compaction_thread_;
       }
       buffer_cur_ = 0;
     }
@@ -284,12 +303,13 @@ class SSDHashKV : public KVInterface<K, V> {
     } else {
       void* val = feat_desc_->Allocate();
       EmbPosition* posi = iter.second;
-      if (posi->flushed_) {
-        emb_files_[posi->version_]->Read((char*)val,
-            val_len_, posi->offset_);
+      if (codec_.is_raw()) {
+        ReadFromSsd(posi, (char*)val);
       } else {
-        memcpy((char*)val,
-            write_buffer_ + posi->buffer_offset_, val_len_);
+        static thread_local std::vector<char> record;
+        record.resize(val_len_);
+        ReadFromSsd(posi, record.data());
+        codec_.Decode(record.data(), val);
       }
       *value_ptr = val;
       posi->invalid_ = true;
@@ -417,11 +437,23 @@ class SSDHashKV : public KVInterface<K, V> {
 
   int64 Size() const override { return hash_map_.size_lockless(); }
 
+  SsdValueCodecType value_codec_type() const { return codec_.type(); }
+
   void FreeValuePtr(void* value_ptr) override {
     feat_desc_->Deallocate(value_ptr);
   }
 
  private:
+  void ReadFromSsd(EmbPosition* posi, char* record) {
+    uint64 start = Env::Default()->NowMicros();
+    if (posi->flushed_) {
+      emb_files_[posi->version_]->Read(record, val_len_, posi->offset_);
+    } else {
+      memcpy(record, write_buffer_ + posi->buffer_offset_, val_len_);
+    }
+    RecordSsdRead(val_len_, Env::Default()->NowMicros() - start);
+  }
+
   void WriteFile(size_t version, size_t curr_buffer_offset) {
     emb_files_[version]->Write(write_buffer_, curr_buffer_offset);
     emb_files_[version]->Flush();
@@ -504,11 +536,17 @@ class SSDHashKV : public KVInterface<K, V> {
     }
   }
 
+  // Compaction moves records that are already encoded.
   void AppendToWriteBuffer(size_t curr_buffer_offset, K key,
-                            const void* value_ptr) {
+                            const void* value_ptr, bool is_compaction) {
     current_offset_ += val_len_;
-    memcpy(write_buffer_ + curr_buffer_offset,
-        (char*)value_ptr, val_len_);
+    if (is_compaction) {
+      memcpy(write_buffer_ + curr_buffer_offset,
+          (char*)value_ptr, val_len_);
+    } else {
+      codec_.Encode(value_ptr, write_buffer_ + curr_buffer_offset);
+      RecordSsdWrite(codec_.row_bytes(), val_len_);
+    }
     key_buffer_[buffer_cur_] = key;
     ++buffer_cur_;
   }
@@ -537,7 +575,7 @@ class SSDHashKV : public KVInterface<K, V> {
     size_t curr_buffer_offset = buffer_cur_ * val_len_;
     EmbPosition* ep = new EmbPosition(current_offset_, current_version_,
                                       curr_buffer_offset, false);
-    AppendToWriteBuffer(curr_buffer_offset, key, value_ptr);
+    AppendToWriteBuffer(curr_buffer_offset, key, value_ptr, is_compaction);
 
     auto iter = hash_map_.insert_lockless(std::move(
         std::pair<K, EmbPosition*>(key, const_cast<EmbPosition*>(ep))));
@@ -564,7 +602,7 @@ class SSDHashKV : public KVInterface<K, V> {
     EmbPosition* ep = new EmbPosition(current_offset_, evict_version_,
                                       curr_buffer_offset, false);
 
-    AppendToWriteBuffer(curr_buffer_offset, key, value_ptr);
+    AppendToWriteBuffer(curr_buffer_offset, key, value_ptr, is_compaction);
     auto iter = hash_map_.insert_lockless(std::move(
         std::pair<K, EmbPosition*>(key, const_cast<EmbPosition*>(ep))));
     emb_files_[ep->version_]->AddCount(1);
@@ -716,23 +754,6 @@ class SSDHashKV : public KVInterface<K, V> {
     }
   }
 
-  void CompactionThread() {
-    if (val_len_ == -1) {
-      while (!done_) {
-      }
-    }
-    while (!shutdown_) {
-      if (shutdown_mu_.try_lock()) {
-        if (!shutdown_) {
-          mutex_lock l(compact_save_mu_);
-          CompactionAsync();
-        }
-        shutdown_mu_.unlock();
-      }
-      Env::Default()->SleepForMicroseconds(1000);
-    }
-  }
-
   std::string DebugString() const {
     return strings::StrCat("map info size:", Size(),
                            ", map info bucket_count:",
@@ -747,6 +768,39 @@ class SSDHashKV : public KVInterface<K, V> {
                            ", compaction_version: ", compaction_version_);
   }
  private:
+  // Shared with the scheduled compaction tasks, which may outlive the kv.
+  struct CompactionState {
+    mutex mu;
+    condition_variable cv;
+    bool shutdown = false;
+    bool running = false;
+  };
+
+  // Runs a compaction round on the shared background executor every
+  // millisecond until the kv is destroyed.
+  void ScheduleCompaction(std::shared_ptr<CompactionState> state,
+                          int64 delay_micros) {
+    BackgroundExecutor::Global()->ScheduleAfter(
+        BackgroundTaskClass::kCompaction, delay_micros, [this, state]() {
+          {
+            mutex_lock l(state->mu);
+            if (state->shutdown) return;
+            state->running = true;
+          }
+          // Records can't be compacted before Init() sets their size.
+          if (done_) {
+            mutex_lock l(compact_save_mu_);
+            CompactionAsync();
+          }
+          mutex_lock l(state->mu);
+          state->running = false;
+          state->cv.notify_all();
+          if (!state->shutdown) {
+            ScheduleCompaction(state, 1000);
+          }
+        });
+  }
+
   void DeallocateEmbPositions() {
     std::pair<const K, EmbPosition*> *hash_map_dump;
     int64 bucket_count;
@@ -771,6 +825,8 @@ class SSDHashKV : public KVInterface<K, V> {
   volatile size_t buffer_cur_ = 0;
   size_t total_app_count_ = 0;
   size_t max_app_count_;
+  SsdValueCodecType codec_type_ = SsdValueCodecType::kRaw;
+  SsdValueCodec<V> codec_;
 
   char* write_buffer_ = nullptr;
   K* key_buffer_ = nullptr;
@@ -783,7 +839,6 @@ class SSDHashKV : public KVInterface<K, V> {
   typedef google::dense_hash_map_lockless<K, EmbPosition*> LockLessHashMap;
   LockLessHashMap hash_map_;
   mutex mu_;
-  mutex shutdown_mu_;
   mutex compact_save_mu_;
 
   static const int EMPTY_KEY;
@@ -799,8 +854,7 @@ class SSDHashKV : public KVInterface<K, V> {
   LocklessHashSet evict_file_set_;
   std::map<int64, std::vector<std::pair<K, EmbPosition*>>> evict_file_map_;
 
-  Thread* compaction_thread_ = nullptr;
-  volatile bool shutdown_ = false;
+  std::shared_ptr<CompactionState> compaction_state_;
   volatile bool done_ = false;
   // std::atomic_flag flag_ = ATOMIC_FLAG_INIT; unused
 
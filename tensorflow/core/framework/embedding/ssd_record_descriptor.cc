@@ -75,6 +75,8 @@ void SsdRecordDescriptor<K>::DumpSsdMeta(
               &ssd_record_writer, dump_buffer);
   DumpSection(record_count_list, "record_count",
               &ssd_record_writer, dump_buffer);
+  DumpSection(std::vector<int64>({value_codec}), "value_codec",
+              &ssd_record_writer, dump_buffer);
 
   ssd_record_writer.Finish();
 }
@@ -46,6 +46,8 @@ class SsdRecordDescriptor {
   std::vector<int64> invalid_record_count_list;
   //number of records in the file
   std::vector<int64> record_count_list;
+  //SsdValueCodecType of the records
+  int64 value_codec = 0;
 
   void GenerateCheckpoint(const std::string& prefix,
                           const std::string& var_name) {
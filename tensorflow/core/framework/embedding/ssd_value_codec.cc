@@ -0,0 +1,76 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#include "tensorflow/core/framework/embedding/ssd_value_codec.h"
+
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+
+namespace tensorflow {
+namespace embedding {
+namespace {
+
+auto* ssd_row_bytes_written = monitoring::Counter<0>::New(
+    "/tensorflow/core/embedding/ssd_row_bytes_written",
+    "The size of the rows written to the SSD tier before encoding.");
+
+auto* ssd_record_bytes_written = monitoring::Counter<0>::New(
+    "/tensorflow/core/embedding/ssd_record_bytes_written",
+    "The size of the encoded records written to the SSD tier.");
+
+auto* ssd_record_bytes_read = monitoring::Counter<0>::New(
+    "/tensorflow/core/embedding/ssd_record_bytes_read",
+    "The size of the encoded records read from the SSD tier.");
+
+auto* ssd_read_latency_usecs = monitoring::Sampler<0>::New(
+    {"/tensorflow/core/embedding/ssd_read_latency_usecs",
+     "The time spent reading and decoding a record of the SSD tier in "
+     "microseconds."},
+    // Power of 2 with bucket count 20 (> 1 second)
+    {monitoring::Buckets::Exponential(1, 2, 20)});
+
+}  // namespace
+
+SsdValueCodecType ParseSsdValueCodecType(const std::string& name) {
+  if (name.empty() || name == "raw") return SsdValueCodecType::kRaw;
+  if (name == "fp16") return SsdValueCodecType::kFp16;
+  if (name == "int8") return SsdValueCodecType::kInt8;
+  LOG(WARNING) << "Unknown SSD value codec " << name << ", use raw.";
+  return SsdValueCodecType::kRaw;
+}
+
+const char* SsdValueCodecTypeName(SsdValueCodecType type) {
+  switch (type) {
+    case SsdValueCodecType::kFp16:
+      return "fp16";
+    case SsdValueCodecType::kInt8:
+      return "int8";
+    default:
+      return "raw";
+  }
+}
+
+void RecordSsdWrite(int64 row_bytes, int64 record_bytes) {
+  ssd_row_bytes_written->GetCell()->IncrementBy(row_bytes);
+  ssd_record_bytes_written->GetCell()->IncrementBy(record_bytes);
+}
+
+void RecordSsdRead(int64 record_bytes, uint64 micros) {
+  ssd_record_bytes_read->GetCell()->IncrementBy(record_bytes);
+  ssd_read_latency_usecs->GetCell()->Add(micros);
+}
+
+}  // namespace embedding
+}  // namespace tensorflow
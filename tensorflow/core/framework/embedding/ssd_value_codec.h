@@ -0,0 +1,197 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+======================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_VALUE_CODEC_H_
+#define TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_VALUE_CODEC_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding {
+
+// Encoding of the rows written to the SSD tier.
+enum class SsdValueCodecType {
+  kRaw = 0,
+  // Embedding values stored as IEEE half precision floats, clamped to its
+  // finite range. Optimizer slots, e.g. accumulators that can exceed that
+  // range, are stored as floats.
+  kFp16 = 1,
+  // Values of each group of at most kInt8GroupSize values of one slot
+  // stored as uint8 with the float minimum and scale of the group.
+  kInt8 = 2,
+};
+
+// Parses TF_SSDHASH_VALUE_CODEC: "raw" (default), "fp16" or "int8".
+SsdValueCodecType ParseSsdValueCodecType(const std::string& name);
+
+const char* SsdValueCodecTypeName(SsdValueCodecType type);
+
+// Updates the SSD tier monitoring counters.
+void RecordSsdWrite(int64 row_bytes, int64 record_bytes);
+void RecordSsdRead(int64 record_bytes, uint64 micros);
+
+// Converts a row as laid out by the feature descriptor, the values of the
+// embedding and the optimizer slots with dimensions `slot_dims` followed by
+// the frequency and version, to the fixed size record stored in SSD files
+// and back. Lossy codecs only apply to float values, the trailing bytes are
+// kept as is.
+template <class V>
+class SsdValueCodec {
+ public:
+  static constexpr int64 kInt8GroupSize = 64;
+
+  SsdValueCodec() = default;
+
+  SsdValueCodec(SsdValueCodecType type, const std::vector<int64>& slot_dims,
+                int64 row_bytes)
+      : type_(type), row_bytes_(row_bytes) {
+    for (int64 dim : slot_dims) {
+      // Quantization groups never span two slots, whose values can have
+      // very different ranges.
+      for (int64 begin = 0; begin < dim; begin += kInt8GroupSize) {
+        groups_.emplace_back(value_dim_ + begin,
+                             value_dim_ + std::min(begin + kInt8GroupSize,
+                                                   dim));
+      }
+      value_dim_ += dim;
+    }
+    embedding_dim_ = slot_dims.empty() ? 0 : slot_dims[0];
+    const int64 value_bytes = value_dim_ * sizeof(V);
+    if (type_ != SsdValueCodecType::kRaw &&
+        (!std::is_same<V, float>::value || value_bytes > row_bytes_)) {
+      LOG(WARNING) << "SSD value codec " << SsdValueCodecTypeName(type_)
+                   << " only supports float rows, rows are stored raw.";
+      type_ = SsdValueCodecType::kRaw;
+    }
+    tail_bytes_ = row_bytes_ - value_bytes;
+    switch (type_) {
+      case SsdValueCodecType::kRaw:
+        record_bytes_ = row_bytes_;
+        break;
+      case SsdValueCodecType::kFp16:
+        record_bytes_ = embedding_dim_ * sizeof(Eigen::half) +
+                        (value_dim_ - embedding_dim_) * sizeof(float) +
+                        tail_bytes_;
+        break;
+      case SsdValueCodecType::kInt8:
+        record_bytes_ = groups_.size() * 2 * sizeof(float) + value_dim_ +
+                        tail_bytes_;
+        break;
+    }
+  }
+
+  SsdValueCodecType type() const { return type_; }
+
+  bool is_raw() const { return type_ == SsdValueCodecType::kRaw; }
+
+  int64 record_bytes() const { return record_bytes_; }
+
+  int64 row_bytes() const { return row_bytes_; }
+
+  void Encode(const void* row, char* record) const {
+    if (is_raw()) {
+      memcpy(record, row, row_bytes_);
+      return;
+    }
+    const float* values = reinterpret_cast<const float*>(row);
+    char* tail = record + record_bytes_ - tail_bytes_;
+    if (type_ == SsdValueCodecType::kFp16) {
+      const float highest =
+          static_cast<float>(Eigen::NumTraits<Eigen::half>::highest());
+      Eigen::half* out = reinterpret_cast<Eigen::half*>(record);
+      for (int64 i = 0; i < embedding_dim_; ++i) {
+        out[i] = Eigen::half(std::max(-highest, std::min(values[i], highest)));
+      }
+      memcpy(out + embedding_dim_, values + embedding_dim_,
+             (value_dim_ - embedding_dim_) * sizeof(float));
+    } else {
+      float* params = reinterpret_cast<float*>(record);
+      uint8* out = reinterpret_cast<uint8*>(params + 2 * groups_.size());
+      for (size_t g = 0; g < groups_.size(); ++g) {
+        const int64 begin = groups_[g].first;
+        const int64 end = groups_[g].second;
+        float min = values[begin];
+        float max = values[begin];
+        for (int64 i = begin + 1; i < end; ++i) {
+          min = std::min(min, values[i]);
+          max = std::max(max, values[i]);
+        }
+        const float scale = (max - min) / 255.0f;
+        const float inv_scale = scale > 0 ? 1.0f / scale : 0.0f;
+        params[2 * g] = min;
+        params[2 * g + 1] = scale;
+        for (int64 i = begin; i < end; ++i) {
+          out[i] = static_cast<uint8>(
+              std::lround((values[i] - min) * inv_scale));
+        }
+      }
+    }
+    memcpy(tail, reinterpret_cast<const char*>(row) + row_bytes_ -
+                     tail_bytes_, tail_bytes_);
+  }
+
+  void Decode(const char* record, void* row) const {
+    if (is_raw()) {
+      memcpy(row, record, row_bytes_);
+      return;
+    }
+    float* values = reinterpret_cast<float*>(row);
+    if (type_ == SsdValueCodecType::kFp16) {
+      const Eigen::half* in = reinterpret_cast<const Eigen::half*>(record);
+      for (int64 i = 0; i < embedding_dim_; ++i) {
+        values[i] = static_cast<float>(in[i]);
+      }
+      memcpy(values + embedding_dim_, in + embedding_dim_,
+             (value_dim_ - embedding_dim_) * sizeof(float));
+    } else {
+      const float* params = reinterpret_cast<const float*>(record);
+      const uint8* in =
+          reinterpret_cast<const uint8*>(params + 2 * groups_.size());
+      for (size_t g = 0; g < groups_.size(); ++g) {
+        for (int64 i = groups_[g].first; i < groups_[g].second; ++i) {
+          values[i] = params[2 * g] + in[i] * params[2 * g + 1];
+        }
+      }
+    }
+    memcpy(reinterpret_cast<char*>(row) + row_bytes_ - tail_bytes_,
+           record + record_bytes_ - tail_bytes_, tail_bytes_);
+  }
+
+ private:
+  SsdValueCodecType type_ = SsdValueCodecType::kRaw;
+  int64 value_dim_ = 0;
+  // Dimension of the embedding values, the first slot.
+  int64 embedding_dim_ = 0;
+  int64 row_bytes_ = 0;
+  int64 tail_bytes_ = 0;
+  int64 record_bytes_ = 0;
+  // Value ranges [first, second) quantized together by kInt8.
+  std::vector<std::pair<int64, int64>> groups_;
+};
+
+}  // namespace embedding
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_EMBEDDING_SSD_VALUE_CODEC_H_
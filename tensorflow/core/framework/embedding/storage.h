@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/embedding/filter_policy.h"
 #include "tensorflow/core/framework/embedding/kv_interface.h"
 #include "tensorflow/core/framework/embedding/shrink_policy.h"
+#include "tensorflow/core/framework/embedding/ssd_value_codec.h"
 #include "tensorflow/core/framework/embedding/storage_config.h"
 #include "tensorflow/core/lib/core/status.h"
 
@@ -89,6 +90,10 @@ class Storage {
   virtual void Init() {}
   virtual void SetValueLen(int64 value_len) {}
   virtual Status GetOrCreate(K key, void** value_ptr) = 0;
+  // Moves the values of `keys` that are in slower tiers to the fastest tier
+  // ahead of looking them up one by one.
+  virtual void Prefetch(const EmbeddingVarContext<CPUDevice>& ctx,
+                        const K* keys, int64 num_of_keys) {}
   virtual int LookupTier(K key) const = 0;
   virtual Status Remove(K key) = 0;
   virtual int64 Size() const = 0;
@@ -180,18 +185,19 @@ class Storage {
 
   virtual void AddToCache(const Tensor& indices) {}
   
-  virtual void Restore(const std::string& name_string,
-                       const std::string& file_name_string, int64 partition_id,
-                       int64 partition_num, int64 value_len, bool is_incr,
-                       bool reset_version, const EmbeddingConfig& emb_config,
-                       const Eigen::GpuDevice* device, BundleReader* reader,
-                       EmbeddingVar<K, V>* ev,
-                       FilterPolicy<K, V, EmbeddingVar<K, V>>* filter) {
+  virtual Status Restore(const std::string& name_string,
+                         const std::string& file_name_string,
+                         int64 partition_id, int64 partition_num,
+                         int64 value_len, bool is_incr, bool reset_version,
+                         const EmbeddingConfig& emb_config,
+                         const Eigen::GpuDevice* device, BundleReader* reader,
+                         EmbeddingVar<K, V>* ev,
+                         FilterPolicy<K, V, EmbeddingVar<K, V>>* filter) {
     CheckpointLoader<K, V> restorer(reinterpret_cast<Storage<K, V>*>(this), ev,
                                     filter, name_string, file_name_string,
                                     partition_id, partition_num, is_incr,
                                     reset_version, reader);
-    restorer.RestoreCkpt(emb_config, device);
+    return restorer.RestoreCkpt(emb_config, device);
   };
   
   virtual void UpdateValuePtr(K key, void* new_value_ptr,
@@ -230,14 +236,16 @@ class Storage {
           ev_allocator(), StorageType::DRAM, true,
           true, {false, 0});
       void* value_ptr = normal_feat_desc.Allocate();
+      SsdValueCodec<V> codec(
+          static_cast<SsdValueCodecType>(restore_buff.value_codec),
+          normal_feat_desc.slot_dims(), normal_feat_desc.data_bytes());
       char* file_addr = (char*)mmap(nullptr,
-                                    normal_feat_desc.data_bytes() +
+                                    codec.record_bytes() +
                                     key_offset,
                                     PROT_READ, MAP_PRIVATE, fd, 0);
-      memcpy(value_ptr, file_addr + key_offset,
-             normal_feat_desc.data_bytes());
+      codec.Decode(file_addr + key_offset, value_ptr);
       munmap(file_addr,
-             normal_feat_desc.data_bytes() +
+             codec.record_bytes() +
              key_offset);
       close(fd);
       // Copy Data to ValuePtr, data of slots are set by primary here.
@@ -0,0 +1,60 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_MICRO_BATCH_CONTEXT_H_
+#define TENSORFLOW_CORE_FRAMEWORK_MICRO_BATCH_CONTEXT_H_
+
+#include <atomic>
+
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+
+// Position of the current executor run within a step executed as several
+// micro batches (OptimizerOptions.runtime_micro_batch). The session creates
+// it in the step container shared by all micro batches of the step; the
+// gradient accumulation kernels look it up there. Without it a step is a
+// single micro batch.
+class MicroBatchContext : public ResourceBase {
+ public:
+  static constexpr const char* kResourceName = "_micro_batch_context";
+
+  explicit MicroBatchContext(int32 num_micro_batches)
+      : num_micro_batches_(num_micro_batches) {}
+
+  int32 num_micro_batches() const { return num_micro_batches_; }
+
+  int32 index() const { return index_.load(std::memory_order_acquire); }
+
+  void set_index(int32 index) {
+    index_.store(index, std::memory_order_release);
+  }
+
+  bool is_last() const { return index() + 1 >= num_micro_batches_; }
+
+  string DebugString() const override {
+    return strings::StrCat("MicroBatchContext(", index(), "/",
+                           num_micro_batches_, ")");
+  }
+
+ private:
+  const int32 num_micro_batches_;
+  std::atomic<int32> index_{0};
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_MICRO_BATCH_CONTEXT_H_
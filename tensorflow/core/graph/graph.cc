@@ -431,22 +431,25 @@ const VersionDef& Graph::versions() const { return *versions_; }
 void Graph::set_versions(const VersionDef& versions) { *versions_ = versions; }
 
 Node* Graph::AddNode(NodeDef node_def, Status* status) {
-  const OpDef* op_def;
-  status->Update(ops_.LookUpOpDef(node_def.op(), &op_def));
+  PreparedNode prepared;
+  status->Update(PrepareNode(node_def, &prepared));
   if (!status->ok()) return nullptr;
+  return AddNode(std::move(node_def), std::move(prepared));
+}
 
-  DataTypeVector inputs;
-  DataTypeVector outputs;
-  status->Update(InOutTypesForNode(node_def, *op_def, &inputs, &outputs));
-  if (!status->ok()) {
-    *status = AttachDef(*status, node_def);
-    return nullptr;
-  }
+Status Graph::PrepareNode(const NodeDef& node_def, PreparedNode* node) const {
+  TF_RETURN_IF_ERROR(ops_.LookUpOpDef(node_def.op(), &node->op_def));
+  Status status = InOutTypesForNode(node_def, *node->op_def,
+                                    &node->input_types, &node->output_types);
+  if (!status.ok()) return AttachDef(status, node_def);
+  return Status::OK();
+}
 
-  Node* node = AllocateNode(std::make_shared<NodeProperties>(
-                                op_def, std::move(node_def), inputs, outputs),
-                            nullptr);
-  return node;
+Node* Graph::AddNode(NodeDef node_def, PreparedNode node) {
+  return AllocateNode(
+      std::make_shared<NodeProperties>(node.op_def, std::move(node_def),
+                                       node.input_types, node.output_types),
+      nullptr);
 }
 
 Node* Graph::CopyNode(const Node* node) {
@@ -556,6 +556,14 @@ class GraphEdgesIterable {
   const_iterator end() { return const_iterator(edges_.end(), edges_.end()); }
 };
 
+// The op and the input and output types of a node to add to a Graph, looked
+// up by Graph::PrepareNode.
+struct PreparedNode {
+  const OpDef* op_def = nullptr;
+  DataTypeVector input_types;
+  DataTypeVector output_types;
+};
+
 // Thread compatible but not thread safe.
 class Graph {
  public:
@@ -589,6 +597,14 @@ class Graph {
   // Returns nullptr and sets *status on error.
   Node* AddNode(NodeDef node_def, Status* status);
 
+  // Infers the Op and input/output types of a node of 'node_def' for the
+  // AddNode below. It doesn't modify the graph, so it may run in parallel
+  // for many nodes, which are then added in a deterministic order.
+  Status PrepareNode(const NodeDef& node_def, PreparedNode* node) const;
+
+  // Adds a new node of 'node_def' prepared by PrepareNode, and returns it.
+  Node* AddNode(NodeDef node_def, PreparedNode node);
+
   // Copies *node, which may belong to another graph, to a new node,
   // which is returned.  Does not copy any edges.  *this owns the
   // returned instance.
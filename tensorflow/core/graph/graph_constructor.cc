@@ -49,6 +49,7 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -85,7 +86,8 @@ class GraphConstructor {
         : allow_internal_ops(in.allow_internal_ops),
           expect_device_spec(in.expect_device_spec),
           importing(false),
-          validate_colocation_constraints(false) {}
+          validate_colocation_constraints(false),
+          thread_pool(in.thread_pool) {}
     Options(const ImportGraphDefOptions& in)  // NOLINT(runtime/explicit)
         : allow_internal_ops(false),
           expect_device_spec(false),
@@ -129,6 +131,8 @@ class GraphConstructor {
     bool validate_shape = true;
 
     string default_device;
+
+    thread::ThreadPool* thread_pool = nullptr;
   };
 
   typedef gtl::ArraySlice<const NodeDef*> NodeDefSlice;
@@ -168,6 +172,7 @@ class GraphConstructor {
     TF_RETURN_IF_ERROR(ValidateInputMapAndControlDependencies());
     TF_RETURN_IF_ERROR(BuildNodeIndex());
     TF_RETURN_IF_ERROR(InitFromEdges());
+    PrepareNodes();
 
     // NOTE: Convert() invokes `consume_node_def()` on each node in the input
     // graph, so `get_node_def()` is no longer usable once it is called.
@@ -188,6 +193,13 @@ class GraphConstructor {
   Status ValidateInputMapAndControlDependencies();
   Status BuildNodeIndex();
   Status InitFromEdges();
+  // Looks up the ops and input/output types of all nodes on
+  // opts_.thread_pool, and copies the NodeDefs that consume_node_def() would
+  // copy. Convert() adds the nodes in its own order and returns the errors
+  // of their preparation where it adds them, so the graph and the errors
+  // don't depend on the sharding. Not done when importing, which adds
+  // default attrs to the NodeDefs first.
+  void PrepareNodes();
   Status Convert();
   Status AddBackEdges();
   Status UpdateVersionDef();
@@ -205,7 +217,8 @@ class GraphConstructor {
            absl::flat_hash_set<int>* unvisited);
   Status IsNodeFullyMapped(const NodeDef& node_def, bool* is_node_mapped);
   Status ValidateColocationConstraints(const NodeDef& node_def);
-  Status MakeNode(NodeDef&& node_def, Node** node);
+  // Adds the node of the i-th NodeDef.
+  Status MakeNode(int i, NodeDef&& node_def, Node** node);
   Status MakeEdge(Node* src, int output_index, Node* dst, int input_index);
   Status ValidateShape(Node* node);
   Status ModifyNodeDefForImport(NodeDef* node_def);
@@ -262,6 +275,8 @@ class GraphConstructor {
   // possible. After calling this method, the result of get_node_def(i) is
   // undefined.
   virtual NodeDef consume_node_def(int i) = 0;
+  // Returns true if consume_node_def() copies the NodeDef.
+  virtual bool consume_copies_node_def() const = 0;
   // Returns the version information for the graph, or nullptr if none is
   // available.
   virtual const VersionDef* versions() const = 0;
@@ -369,6 +384,12 @@ class GraphConstructor {
   };
   std::vector<EdgeInfo> back_edges_;
 
+  // The nodes prepared by PrepareNodes(), by index within node_defs_, and
+  // the NodeDefs it copied. Empty if it didn't run.
+  std::vector<PreparedNode> prepared_nodes_;
+  std::vector<Status> prepared_status_;
+  std::vector<NodeDef> prepared_node_defs_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(GraphConstructor);
 };
 
@@ -395,6 +416,7 @@ class NodeDefCopyingGraphConstructor : public GraphConstructor {
   size_t node_def_count() const override { return node_defs_.size(); }
   const NodeDef& get_node_def(int i) const override { return *node_defs_[i]; }
   NodeDef consume_node_def(int i) override { return *node_defs_[i]; }
+  bool consume_copies_node_def() const override { return true; }
   const VersionDef* versions() const override { return versions_; }
   const FunctionDefLibrary* library() const override { return library_; }
 
@@ -429,6 +451,7 @@ class NodeDefMovingGraphConstructor : public GraphConstructor {
     is_consumed_[i] = true;
     return std::move(*graph_def_.mutable_node(i));
   }
+  bool consume_copies_node_def() const override { return false; }
   const VersionDef* versions() const override { return &graph_def_.versions(); }
   const FunctionDefLibrary* library() const override {
     return &graph_def_.library();
@@ -717,11 +740,38 @@ Status GraphConstructor::ValidateColocationConstraints(
   return Status::OK();
 }
 
-Status GraphConstructor::MakeNode(NodeDef&& node_def, Node** node) {
+void GraphConstructor::PrepareNodes() {
+  if (opts_.thread_pool == nullptr || opts_.importing) return;
+  const int64 num_nodes = node_def_count();
+  prepared_nodes_.resize(num_nodes);
+  prepared_status_.resize(num_nodes);
+  const bool copy_node_defs = consume_copies_node_def();
+  if (copy_node_defs) {
+    prepared_node_defs_.resize(num_nodes);
+  }
+  Shard(opts_.thread_pool->NumThreads(), opts_.thread_pool, num_nodes,
+        /*cost_per_unit=*/2000, [&](int64 begin, int64 end) {
+          for (int64 i = begin; i < end; ++i) {
+            const NodeDef& node_def = get_node_def(i);
+            prepared_status_[i] =
+                g_->PrepareNode(node_def, &prepared_nodes_[i]);
+            if (copy_node_defs) {
+              prepared_node_defs_[i] = node_def;
+            }
+          }
+        });
+}
+
+Status GraphConstructor::MakeNode(int i, NodeDef&& node_def, Node** node) {
   // Add the node to the graph.
-  Status status;
-  *node = g_->AddNode(std::move(node_def), &status);
-  if (!status.ok()) return status;
+  if (prepared_nodes_.empty()) {
+    Status status;
+    *node = g_->AddNode(std::move(node_def), &status);
+    if (!status.ok()) return status;
+  } else {
+    TF_RETURN_IF_ERROR(prepared_status_[i]);
+    *node = g_->AddNode(std::move(node_def), std::move(prepared_nodes_[i]));
+  }
   if (opts_.expect_device_spec) {
     (*node)->set_assigned_device_name((*node)->def().device());
   }
@@ -1121,7 +1171,9 @@ Status GraphConstructor::Convert() {
     inputs.clear();
     bool has_data_back_edge = false;
 
-    NodeDef node_def = consume_node_def(o);
+    NodeDef node_def = prepared_node_defs_.empty()
+                           ? consume_node_def(o)
+                           : std::move(prepared_node_defs_[o]);
 
     // input_already_exists[i] is true iff the i-th input of the node we're
     // importing refers to a preexisting node in g_ (i.e. input[i] existed prior
@@ -1220,7 +1272,7 @@ Status GraphConstructor::Convert() {
       }
       TF_RETURN_IF_ERROR(ModifyNodeDefForImport(&node_def));
     }
-    TF_RETURN_IF_ERROR(MakeNode(std::move(node_def), &node));
+    TF_RETURN_IF_ERROR(MakeNode(o, std::move(node_def), &node));
 
     if (opts_.importing) {
       // Use interned original node name so StringPiece remains valid.
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 class ShapeRefiner;
@@ -42,6 +43,11 @@ struct GraphConstructorOptions {
   //
   // TODO(zhifengc): if possible, consider removing this option.
   bool expect_device_spec = false;
+
+  // If set, the ops and input/output types of the nodes are looked up, and
+  // the NodeDefs copied, on this pool. The nodes are still added to the
+  // graph in order, so the graph doesn't depend on it.
+  thread::ThreadPool* thread_pool = nullptr;
 };
 extern Status ConvertGraphDefToGraph(const GraphConstructorOptions& opts,
                                      const GraphDef& gdef, Graph* g);
@@ -27,8 +27,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
@@ -884,6 +886,47 @@ TEST_F(GraphConstructorTest, SimpleModelWithControlEdges) {
   EXPECT_TRUE(HasControlEdge("t1", "t2"));
 }
 
+TEST_F(GraphConstructorTest, ThreadPool) {
+  const string gdef_ascii =
+      "node { name: 'W1' op: 'TestParams' }"
+      "node { name: 'input' op: 'TestInput' input: [ '^W1' ] }"
+      "node { name: 't1' op: 'TestMul' input: [ 'W1', 'input:1' ] }"
+      "node { name: 't2' op: 'TestMul' input: [ 'W1', 'input:1', '^t1' ] }"
+      "node { name: 't3' op: 'TestOneInputOneOutput' input: [ 't2' ] "
+      "       attr { key: 'T' value { type: DT_FLOAT } } }"
+      "node { name: 'd' op: 'TestDefaultAttr' input: [ '^t3' ] }";
+  ExpectOK(gdef_ascii);
+
+  // Nodes prepared on a thread pool make the same graph as serial ones.
+  GraphDef def;
+  ASSERT_TRUE(protobuf::TextFormat::ParseFromString(gdef_ascii, &def));
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  GraphConstructorOptions opts;
+  opts.thread_pool = &pool;
+  Graph graph(OpRegistry::Global());
+  TF_EXPECT_OK(ConvertGraphDefToGraph(opts, def, &graph));
+  EXPECT_EQ(GraphDebugString(), graph.ToGraphDefDebug().DebugString());
+}
+
+TEST_F(GraphConstructorTest, ThreadPool_Error) {
+  GraphDef def;
+  ASSERT_TRUE(protobuf::TextFormat::ParseFromString(
+      "node { name: 'W1' op: 'TestParams' }"
+      "node { name: 'input' op: 'TestInput' }"
+      "node { name: 't1' op: 'Unknown' input: [ 'W1', 'input:1' ] }"
+      "node { name: 't2' op: 'TestMul' input: [ 'W1' ] }",
+      &def));
+  GraphConstructorOptions opts;
+  Status serial = ConvertGraphDefToGraph(opts, def, &graph_);
+  EXPECT_FALSE(serial.ok());
+
+  // Preparation errors are reported for the same node as without a pool.
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  opts.thread_pool = &pool;
+  Graph graph(OpRegistry::Global());
+  EXPECT_EQ(serial, ConvertGraphDefToGraph(opts, def, &graph));
+}
+
 TEST_F(GraphConstructorTest, Error_ControlEdgeBeforeRealInput) {
   ExpectError(
       "node { name: 'W1' op: 'TestParams' }"
@@ -41,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/dump_graph.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -1399,6 +1400,68 @@ void SetIncarnation(const PartitionOptions& opts, GraphDef* gdef) {
   }
 }
 
+namespace {
+
+// Runs work(begin, end) over [0, total), sharded on opts.thread_pool if
+// set.
+void ShardPartitionWork(const PartitionOptions& opts, int64 total,
+                        int64 cost_per_unit,
+                        const std::function<void(int64, int64)>& work) {
+  if (opts.thread_pool == nullptr) {
+    work(0, total);
+    return;
+  }
+  Shard(opts.thread_pool->NumThreads(), opts.thread_pool, total,
+        cost_per_unit, work);
+}
+
+// Sets versions, function library and send/recv incarnation of every
+// partition. The library is pruned to the functions the partition uses
+// if 'prune_library'.
+void CompletePartitions(const PartitionOptions& opts, const Graph& g,
+                        bool prune_library,
+                        std::unordered_map<string, GraphDef>* partitions) {
+  const FunctionLibraryDefinition* flib_def = opts.flib_def;
+  if (flib_def == nullptr) {
+    flib_def = &g.flib_def();
+  }
+
+  std::vector<GraphDef*> gdefs;
+  gdefs.reserve(partitions->size());
+  for (auto& it : *partitions) {
+    gdefs.push_back(&it.second);
+  }
+  // Each partition is traversed a few times, costing about a
+  // microsecond per node.
+  int64 num_nodes = 0;
+  for (GraphDef* gdef : gdefs) {
+    num_nodes += gdef->node_size();
+  }
+  const int64 cost_per_partition =
+      1000 * std::max<int64>(1, num_nodes / std::max<size_t>(1, gdefs.size()));
+  ShardPartitionWork(
+      opts, gdefs.size(), cost_per_partition, [&](int64 begin, int64 end) {
+        for (int64 i = begin; i < end; ++i) {
+          GraphDef* gdef = gdefs[i];
+          *gdef->mutable_versions() = g.versions();
+          if (prune_library) {
+            // Prune unreachable functions from `flib_def` before adding
+            // them to `gdef`.
+            *gdef->mutable_library() =
+                flib_def->ReachableDefinitions(*gdef).ToProto();
+          } else {
+            *gdef->mutable_library() = flib_def->ToProto();
+          }
+
+          // Traverse the graph to fill every send/recv op's incarnation
+          // information.
+          SetIncarnation(opts, gdef);
+        }
+      });
+}
+
+}  // namespace
+
 Status Partition(const PartitionOptions& opts, Graph* g,
                  std::unordered_map<string, GraphDef>* partitions) {
   Status status;
@@ -1420,7 +1483,6 @@ Status Partition(const PartitionOptions& opts, Graph* g,
   status = BuildMemoryDeviceInfo(*g, &g_info);
   if (!status.ok()) return status;
 
-  string dstp;
   std::vector<const Edge*> inputs;
   DupRecvTable dup_recv(3);
   // For a node dst, 'ref_recvs' remembers the recvs introduced by a ref
@@ -1430,16 +1492,41 @@ Status Partition(const PartitionOptions& opts, Graph* g,
   std::vector<NodeDef*> ref_recvs;
   std::vector<string> ref_control_inputs;
 
+  // Copy the NodeDefs of all op nodes and look up their locations first,
+  // possibly in parallel. They are added to the partitions in node order
+  // below, so the partitions don't depend on the sharding.
+  std::vector<const Node*> op_nodes;
+  op_nodes.reserve(g->num_op_nodes());
+  for (const Node* n : g->op_nodes()) {
+    op_nodes.push_back(n);
+  }
+  std::vector<NodeDef> op_node_defs(op_nodes.size());
+  std::vector<string> locs(g->num_node_ids());
+  ShardPartitionWork(
+      opts, op_nodes.size(), 2000, [&](int64 begin, int64 end) {
+        for (int64 i = begin; i < end; ++i) {
+          const Node* n = op_nodes[i];
+          locs[n->id()] = opts.node_to_loc(n);
+          NodeDef* ndef = &op_node_defs[i];
+          *ndef = n->def();
+          MergeDebugInfo(NodeDebugInfo(n->def()), ndef);
+          ndef->set_device(n->assigned_device_name());
+          ndef->clear_input();  // Inputs are filled below
+        }
+      });
+  // Elements of an unordered_map keep their addresses.
+  std::vector<GraphDef*> node_graphs(g->num_node_ids(), nullptr);
+  for (const Node* n : op_nodes) {
+    node_graphs[n->id()] = &(*partitions)[locs[n->id()]];
+  }
+
   int32 num_data = 0;
   int32 num_control = 0;
-  for (const Node* dst : g->op_nodes()) {
-    dstp = opts.node_to_loc(dst);
-    GraphDef* dst_graph = &(*partitions)[dstp];
+  for (size_t dst_idx = 0; dst_idx < op_nodes.size(); ++dst_idx) {
+    const Node* dst = op_nodes[dst_idx];
+    GraphDef* dst_graph = node_graphs[dst->id()];
     NodeDef* dst_def = dst_graph->add_node();
-    *dst_def = dst->def();
-    MergeDebugInfo(NodeDebugInfo(dst->def()), dst_def);
-    dst_def->set_device(dst->assigned_device_name());
-    dst_def->clear_input();  // Inputs are filled below
+    dst_def->Swap(&op_node_defs[dst_idx]);
     if (opts.need_to_record_start_times) {
       int64 start_time;
       status = GetNodeAttr(*dst_def, "_start_time", &start_time);
@@ -1491,7 +1578,7 @@ Status Partition(const PartitionOptions& opts, Graph* g,
       const Node* src = edge->src();
       if (!src->IsOp()) continue;  // Skip Sink/Source nodes.
 
-      GraphDef* src_graph = &(*partitions)[opts.node_to_loc(src)];
+      GraphDef* src_graph = node_graphs[src->id()];
       if (src_graph == dst_graph && !NeedSameDeviceSendRecv(edge, g_info)) {
         // Same partition and compatible memory types:
         AddInput(dst_def, src->name(), edge->src_output());
@@ -1634,22 +1721,7 @@ Status Partition(const PartitionOptions& opts, Graph* g,
     }
   }
 
-  const FunctionLibraryDefinition* flib_def = opts.flib_def;
-  if (flib_def == nullptr) {
-    flib_def = &g->flib_def();
-  }
-
-  // Set versions, function library and send/recv incarnation.
-  for (auto& it : *partitions) {
-    GraphDef* gdef = &it.second;
-    *gdef->mutable_versions() = g->versions();
-    // Prune unreachable functions from `flib_def` before adding them to `gdef`.
-    *gdef->mutable_library() = flib_def->ReachableDefinitions(*gdef).ToProto();
-
-    // Traverse the graph to fill every send/recv op's incarnation
-    // information.
-    SetIncarnation(opts, gdef);
-  }
+  CompletePartitions(opts, *g, /*prune_library=*/true, partitions);
 
   // Set the start times for recvs at the very end.
   if (opts.scheduling_for_recvs) {
@@ -2111,21 +2183,7 @@ Status PartitionWithTensorFuse(const PartitionOptions& opts, Graph* g,
     }
   }
 
-  const FunctionLibraryDefinition* flib_def = opts.flib_def;
-  if (flib_def == nullptr) {
-    flib_def = &g->flib_def();
-  }
-
-  // Set versions, function library and send/recv incarnation.
-  for (auto& it : *partitions) {
-    GraphDef* gdef = &it.second;
-    *gdef->mutable_versions() = g->versions();
-    *gdef->mutable_library() = flib_def->ToProto();
-
-    // Traverse the graph to fill every send/recv op's incarnation
-    // information.
-    SetIncarnation(opts, gdef);
-  }
+  CompletePartitions(opts, *g, /*prune_library=*/false, partitions);
 
   // Set the start times for recvs at the very end.
   if (opts.scheduling_for_recvs) {
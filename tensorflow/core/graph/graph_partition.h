@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/graph/control_flow.h"
 #include "tensorflow/core/graph/costmodel.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 
@@ -81,6 +82,11 @@ struct PartitionOptions {
 
   // Fuse recv ops or not
   bool tensor_fuse = false;
+
+  // If set, the NodeDefs of the partitions are built and the partitions
+  // are completed on this pool. The partitions don't depend on it.
+  // node_to_loc and get_incarnation must be thread safe then.
+  thread::ThreadPool* thread_pool = nullptr;
 };
 
 // A map used to store memory types for the inputs/outputs of every node.
@@ -35,10 +35,12 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_def_builder.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/version.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/equal_graph_def.h"
@@ -84,7 +86,8 @@ string DeviceName(const Node* node) {
 }
 
 void Partition(const GraphDef& graph_def,
-               std::unordered_map<string, GraphDef>* partitions) {
+               std::unordered_map<string, GraphDef>* partitions,
+               thread::ThreadPool* thread_pool = nullptr) {
   Graph g(OpRegistry::Global());
   GraphConstructorOptions opts;
   TF_CHECK_OK(ConvertGraphDefToGraph(opts, graph_def, &g));
@@ -104,6 +107,7 @@ void Partition(const GraphDef& graph_def,
   popts.get_incarnation = [](const string& name) {
     return (name[0] - 'A') + 100;
   };
+  popts.thread_pool = thread_pool;
   Status s = Partition(popts, &g, partitions);
   CHECK(s.ok()) << s;
 
@@ -796,6 +800,49 @@ TEST_F(GraphPartitionTest, SetIncarnation) {
   }
 }
 
+// Builds a graph of 'num_nodes' nodes on 'num_devices' CPUs, in which each
+// node combines two earlier nodes, mostly of other devices.
+GraphDef LargeGraphDef(int num_nodes, int num_devices) {
+  Scope root = Scope::NewRootScope().ExitOnError();
+  random::PhiloxRandom philox(17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<Output> outputs;
+  for (int i = 0; i < num_nodes; ++i) {
+    // The first letter of the name selects the device.
+    const string name =
+        strings::StrCat(string(1, 'A' + i % num_devices), "/n", i);
+    if (i < num_devices) {
+      outputs.push_back(FloatInput(root.WithOpName(name)));
+    } else {
+      outputs.push_back(Combine(root.WithOpName(name), outputs[i - 1],
+                                outputs[rnd.Uniform(i)]));
+    }
+  }
+  GraphDef graph_def;
+  TF_CHECK_OK(root.ToGraphDef(&graph_def));
+  return graph_def;
+}
+
+TEST_F(GraphPartitionTest, ParallelPartitionIsDeterministic) {
+  const GraphDef graph_def = LargeGraphDef(2000, 4);
+  std::unordered_map<string, GraphDef> serial;
+  Partition(graph_def, &serial);
+  thread::ThreadPool pool(Env::Default(), "partition", 4);
+  std::unordered_map<string, GraphDef> parallel;
+  Partition(graph_def, &parallel, &pool);
+
+  ASSERT_EQ(4, serial.size());
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (const auto& kv : serial) {
+    const GraphDef& expected = kv.second;
+    const GraphDef& actual = parallel[kv.first];
+    ASSERT_EQ(expected.node_size(), actual.node_size()) << kv.first;
+    for (int i = 0; i < expected.node_size(); ++i) {
+      EXPECT_EQ(expected.node(i).DebugString(), actual.node(i).DebugString());
+    }
+  }
+}
+
 TEST(TopologicalSortNodesWithTimePriorityTest, NoDependencies) {
   // Create placeholders, shuffle them so the order in the graph is not strictly
   // increasing.
@@ -981,5 +1028,34 @@ TEST(TopologicalSortNodesWithTimePriority, WhileLoop) {
   }
 }
 
+static void BM_PartitionLargeGraph(int iters, int num_threads) {
+  testing::StopTiming();
+  const GraphDef graph_def = LargeGraphDef(100000, 8);
+  std::unique_ptr<thread::ThreadPool> pool;
+  if (num_threads > 0) {
+    pool.reset(new thread::ThreadPool(Env::Default(), "partition",
+                                      num_threads));
+  }
+  for (int i = 0; i < iters; ++i) {
+    Graph g(OpRegistry::Global());
+    TF_CHECK_OK(ConvertGraphDefToGraph(GraphConstructorOptions(), graph_def,
+                                       &g));
+    for (Node* node : g.op_nodes()) {
+      node->set_assigned_device_name(DeviceName(node));
+    }
+    PartitionOptions popts;
+    popts.node_to_loc = SplitByDevice;
+    popts.new_name = [&g](const string& prefix) { return g.NewName(prefix); };
+    popts.get_incarnation = [](const string&) { return 1; };
+    popts.thread_pool = pool.get();
+    std::unordered_map<string, GraphDef> partitions;
+    testing::StartTiming();
+    TF_CHECK_OK(Partition(popts, &g, &partitions));
+    testing::StopTiming();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * graph_def.node_size());
+}
+BENCHMARK(BM_PartitionLargeGraph)->Arg(0)->Arg(4)->Arg(16);
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,308 @@
+#include "tensorflow/core/grappler/optimizers/concat_matmul_fusion.h"
+
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace concatmatmulfusion {
+
+struct ConcatMatMulPattern {
+  int matmul_id = -1;
+  int concat_id = -1;
+  // The axis of the concat, removed with it if nothing else uses it.
+  int axis_id = -1;
+  std::vector<string> inputs;
+  string kernel;
+  string bias;
+  bool relu = false;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+// Returns whether the node is a constant 1 or -1, the columns of a matrix.
+bool IsColumnAxis(const NodeDef& node) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor) || tensor.NumElements() != 1) {
+    return false;
+  }
+  int64 axis;
+  if (tensor.dtype() == DT_INT32) {
+    axis = tensor.flat<int32>()(0);
+  } else if (tensor.dtype() == DT_INT64) {
+    axis = tensor.flat<int64>()(0);
+  } else {
+    return false;
+  }
+  return axis == 1 || axis == -1;
+}
+
+// Ops whose outputs are embeddings: the combiners of embedding_lookup_sparse,
+// the lookups of embedding_lookup and their partitioned stitching, and the
+// fused and grouped embedding lookups of DeepRec.
+bool IsEmbeddingLookup(const NodeDef& node) {
+  static const std::unordered_set<string>* kEmbeddingOps =
+      new std::unordered_set<string>({
+          "KvResourceGather",
+          "KvResourceGatherV1",
+          "FusedEmbeddingSparsePostLookUp",
+          "FusedEmbeddingLocalSparseLookUp",
+          "FusedSafeEmbeddingLookupSparseLocal",
+          "GroupEmbeddingVarLookup",
+          "GroupEmbeddingVarLookupDense",
+          "GroupVariableLookup",
+          "GroupVariableLookupDense",
+          "DynamicStitch",
+          "ParallelDynamicStitch",
+      });
+  return IsAnySparseSegmentReduction(node) || IsGather(node) ||
+         kEmbeddingOps->count(node.op()) > 0;
+}
+
+class ConcatMatMulMatcher {
+ public:
+  explicit ConcatMatMulMatcher(const utils::MutableGraphView& graph_view)
+      : graph_view_(graph_view) {}
+
+  bool Match(int node_index, ConcatMatMulPattern* matched) {
+    ConcatMatMulPattern pattern;
+    const NodeDef* matmul = Node(node_index);
+    if (!NodeIsOnCpu(matmul) || !IsFloat(*matmul) ||
+        GetBoolAttr(*matmul, "transpose_a") ||
+        GetBoolAttr(*matmul, "transpose_b")) {
+      return false;
+    }
+    if (IsFusedMatMulWithBias(*matmul, &pattern.relu)) {
+      pattern.bias = matmul->input(2);
+    } else if (!IsMatMul(*matmul)) {
+      return false;
+    }
+    pattern.matmul_id = node_index;
+    pattern.kernel = matmul->input(1);
+
+    // ConcatV2(inputs..., axis), used by the MatMul only.
+    const int concat = Fanin(node_index, 0);
+    if (concat < 0 || Fanin(node_index, 1) == concat) return false;
+    const NodeDef* concat_node = Node(concat);
+    if (concat_node->op() != "ConcatV2" || !NodeIsOnCpu(concat_node) ||
+        !IsFloat(*concat_node) || !OnlyFeeds(concat, node_index)) {
+      return false;
+    }
+    const auto* concat_view = graph_view_.GetNode(concat);
+    const int num_inputs = concat_view->NumRegularFanins() - 1;
+    if (num_inputs < 1) return false;
+    const int axis = Fanin(concat, num_inputs);
+    if (axis < 0 || !IsColumnAxis(*Node(axis))) return false;
+    for (int i = 0; i < num_inputs; ++i) {
+      if (!IsEmbeddingOutput(concat_node->input(i))) return false;
+      pattern.inputs.push_back(concat_node->input(i));
+    }
+    pattern.concat_id = concat;
+    if (OnlyFeeds(axis, concat)) pattern.axis_id = axis;
+
+    *matched = std::move(pattern);
+    return true;
+  }
+
+ private:
+  static bool IsFloat(const NodeDef& node) {
+    auto it = node.attr().find("T");
+    return it != node.attr().end() && it->second.type() == DT_FLOAT;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  // A _FusedMatMul with BiasAdd, and Relu if `relu` is set.
+  static bool IsFusedMatMulWithBias(const NodeDef& node, bool* relu) {
+    if (node.op() != "_FusedMatMul" || node.input_size() < 3) return false;
+    auto it = node.attr().find("fused_ops");
+    if (it == node.attr().end()) return false;
+    const auto& fused_ops = it->second.list();
+    if (fused_ops.s_size() < 1 || fused_ops.s_size() > 2 ||
+        fused_ops.s(0) != "BiasAdd") {
+      return false;
+    }
+    *relu = fused_ops.s_size() == 2;
+    return !*relu || fused_ops.s(1) == "Relu";
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    return fanin.index() == 0 ? fanin.node_index() : -1;
+  }
+
+  // Returns whether the only consumer of the node is `consumer`, through
+  // regular inputs.
+  bool OnlyFeeds(int node_index, int consumer) const {
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (node_view->NumControlledFanouts() > 0) return false;
+    for (const auto& fanouts : node_view->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        if (fanout.node_index() != consumer) return false;
+      }
+    }
+    return true;
+  }
+
+  // Whether the tensor is an embedding, possibly through the Reshape and
+  // Identity of the input layer, and the Select of
+  // safe_embedding_lookup_sparse, which zeroes the rows without ids.
+  bool IsEmbeddingOutput(const string& tensor) const {
+    const auto* node_view =
+        graph_view_.GetNode(ParseTensorName(tensor).node());
+    while (node_view != nullptr) {
+      const NodeDef* node = node_view->node();
+      int input;
+      if (IsEmbeddingLookup(*node)) {
+        return true;
+      } else if (IsReshape(*node) || IsIdentity(*node)) {
+        input = 0;
+      } else if (IsSelect(*node) || node->op() == "SelectV2") {
+        input = 2;
+      } else {
+        return false;
+      }
+      if (input >= node_view->NumRegularFanins()) return false;
+      node_view = node_view->GetRegularFanin(input).node_view();
+    }
+    return false;
+  }
+
+  const utils::MutableGraphView& graph_view_;
+};
+
+// Returns the columns of the concatenation, or -1 if unknown.
+int64 ConcatColumns(const GraphProperties& properties, const NodeDef& concat) {
+  if (!properties.HasOutputProperties(concat.name())) return -1;
+  const auto& outputs = properties.GetOutputProperties(concat.name());
+  if (outputs.empty() || outputs[0].shape().unknown_rank() ||
+      outputs[0].shape().dim_size() != 2) {
+    return -1;
+  }
+  return outputs[0].shape().dim(1).size();
+}
+
+}  // namespace concatmatmulfusion
+
+Status ConcatMatMulFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                    GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = item.graph.node_size();
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  const GraphDef* graph = graph_view.graph();
+
+  VLOG(3) << "Before concat matmul fusion rewrites: " << graph->DebugString();
+
+  concatmatmulfusion::ConcatMatMulMatcher matcher(graph_view);
+  std::vector<concatmatmulfusion::ConcatMatMulPattern> patterns;
+  for (int i = 0; i < num_nodes; ++i) {
+    concatmatmulfusion::ConcatMatMulPattern pattern;
+    if (!matcher.Match(i, &pattern)) continue;
+    const auto* concat_view = graph_view.GetNode(pattern.concat_id);
+    if (nodes_to_preserve.count(concat_view->GetName()) > 0 ||
+        concat_view->NumControllingFanins() > 0) {
+      continue;
+    }
+    if (pattern.axis_id >= 0 &&
+        nodes_to_preserve.count(graph->node(pattern.axis_id).name()) > 0) {
+      pattern.axis_id = -1;
+    }
+    patterns.push_back(std::move(pattern));
+  }
+  if (patterns.empty()) return Status::OK();
+
+  // The shapes are only used to report the memory traffic saved.
+  GraphProperties properties(item);
+  const bool has_properties =
+      VLOG_IS_ON(1) &&
+      properties.InferStatically(/*assume_valid_feeds=*/false).ok();
+
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  int64 saved_bytes_per_example = 0;
+  for (const auto& pattern : patterns) {
+    const NodeDef& matmul = graph->node(pattern.matmul_id);
+    const NodeDef& concat = graph->node(pattern.concat_id);
+    VLOG(2) << "Optimizing fused concat matmul node "
+            << SummarizeNodeDef(matmul);
+    nodes_to_delete[pattern.matmul_id] = true;
+    nodes_to_delete[pattern.concat_id] = true;
+    if (pattern.axis_id >= 0) nodes_to_delete[pattern.axis_id] = true;
+    const int64 columns =
+        has_properties ? concatmatmulfusion::ConcatColumns(properties, concat)
+                       : -1;
+    if (columns > 0) {
+      // The concatenation is written once and read back by the MatMul.
+      saved_bytes_per_example += 2 * columns * sizeof(float);
+    }
+
+    NodeDef fused_op;
+    fused_op.set_name(matmul.name());
+    fused_op.set_op("ConcatMatMul");
+    fused_op.set_device(matmul.device());
+    for (const string& input : pattern.inputs) fused_op.add_input(input);
+    fused_op.add_input(pattern.kernel);
+    if (!pattern.bias.empty()) fused_op.add_input(pattern.bias);
+    for (const string& input : matmul.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["N"].set_i(pattern.inputs.size());
+    (*attr)["num_bias"].set_i(pattern.bias.empty() ? 0 : 1);
+    (*attr)["activation"].set_s(pattern.relu ? "Relu" : "None");
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  VLOG(1) << "Fused " << fused_nodes.size()
+          << " concatenations into ConcatMatMul, saving "
+          << saved_bytes_per_example
+          << " bytes of memory traffic per example";
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  VLOG(3) << "After concat matmul fusion rewrites: " << output->DebugString();
+
+  return Status::OK();
+}
+
+void ConcatMatMulFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                  const GraphDef& optimize_output,
+                                  double result) {
+  // Nothing to do for ConcatMatMulFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,48 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CONCAT_MATMUL_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CONCAT_MATMUL_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Rewrites the first dense layer of an input layer of embeddings into a
+// ConcatMatMul op:
+//
+//   concat = ConcatV2(embedding_0, ..., embedding_N-1, axis)  // axis 1 or -1
+//   output = MatMul(concat, kernel)
+//
+// or the _FusedMatMul with BiasAdd, and optionally Relu, that the remapper
+// rewrites BiasAdd(MatMul) to on CPU. Each concatenated tensor must be the
+// output of an embedding lookup, possibly reshaped, as tf.feature_column
+// input layers build them. The concatenation is not materialized anymore,
+// which saves writing and reading back B * K floats per step for a
+// [B, K] concatenation.
+//
+// As for DinAttentionFusion, the concatenation must not be used elsewhere,
+// so training graphs, whose MatMul gradient reads it, are left unchanged.
+// They can call tf.nn.concat_matmul directly.
+class ConcatMatMulFusion : public GraphOptimizer {
+ public:
+  ConcatMatMulFusion() = default;
+  explicit ConcatMatMulFusion(RewriterConfig::Toggle opt_level) {}
+  ~ConcatMatMulFusion() override {}
+
+  string name() const override { return "concat_matmul_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CONCAT_MATMUL_FUSION_H_
@@ -0,0 +1,161 @@
+#include "tensorflow/core/grappler/optimizers/concat_matmul_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class ConcatMatMulFusionTest : public GrapplerTest {
+ protected:
+  static NodeDef RandomConst(const string& name, const TensorShape& shape) {
+    Tensor value(DT_FLOAT, shape);
+    value.flat<float>().setRandom();
+    return test::function::NDef(name, "Const", {},
+                                {{"dtype", DT_FLOAT}, {"value", value}});
+  }
+
+  // The first dense layer of an input layer of batch 2, with the [2, 3]
+  // embedding of a gather and the [2, 4] embedding of a sparse segment mean,
+  // reshaped. With `dense`, the second input is a constant instead.
+  void BuildGraph(GraphDef* graph, bool dense = false) {
+    using test::function::NDef;
+    const Tensor ids = test::AsTensor<int32>({4, 1});
+    const Tensor indices = test::AsTensor<int32>({0, 1, 2});
+    const Tensor segment_ids = test::AsTensor<int32>({0, 0, 1});
+    const Tensor shape = test::AsTensor<int32>({2, 4});
+    const Tensor gather_axis = test::AsScalar<int32>(0);
+    const Tensor axis = test::AsScalar<int32>(-1);
+
+    *graph = test::function::GDef({
+        RandomConst("params_a", {5, 3}),
+        RandomConst("params_b", {6, 4}),
+        RandomConst("kernel", {7, 5}),
+        NDef("ids", "Const", {}, {{"dtype", DT_INT32}, {"value", ids}}),
+        NDef("gather_axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", gather_axis}}),
+        NDef("embedding_a", "GatherV2", {"params_a", "ids", "gather_axis"},
+             {{"Tparams", DT_FLOAT},
+              {"Tindices", DT_INT32},
+              {"Taxis", DT_INT32},
+              {"batch_dims", 0}}),
+        NDef("indices", "Const", {}, {{"dtype", DT_INT32}, {"value", indices}}),
+        NDef("segment_ids", "Const", {},
+             {{"dtype", DT_INT32}, {"value", segment_ids}}),
+        NDef("mean", "SparseSegmentMean",
+             {"params_b", "indices", "segment_ids"},
+             {{"T", DT_FLOAT}, {"Tidx", DT_INT32}}),
+        NDef("shape", "Const", {}, {{"dtype", DT_INT32}, {"value", shape}}),
+        NDef("embedding_b", "Reshape", {"mean", "shape"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+        NDef("axis", "Const", {}, {{"dtype", DT_INT32}, {"value", axis}}),
+        NDef("concat", "ConcatV2",
+             {"embedding_a", dense ? "dense" : "embedding_b", "axis"},
+             {{"T", DT_FLOAT}, {"N", 2}, {"Tidx", DT_INT32}}),
+        NDef("output", "MatMul", {"concat", "kernel"},
+             {{"T", DT_FLOAT}, {"transpose_a", false}, {"transpose_b", false}}),
+    });
+    if (dense) *graph->add_node() = RandomConst("dense", {2, 4});
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+
+  static const NodeDef* FindNode(const GraphDef& graph, const string& name) {
+    for (const NodeDef& node : graph.node()) {
+      if (node.name() == name) return &node;
+    }
+    return nullptr;
+  }
+};
+
+TEST_F(ConcatMatMulFusionTest, FusesMatMul) {
+  GrapplerItem item;
+  BuildGraph(&item.graph);
+  item.fetch = {"output"};
+
+  ConcatMatMulFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(nullptr, FindNode(output, "concat"));
+  EXPECT_EQ(nullptr, FindNode(output, "axis"));
+  const NodeDef* fused = FindNode(output, "output");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("ConcatMatMul", fused->op());
+  ASSERT_EQ(3, fused->input_size());
+  EXPECT_EQ("embedding_a", fused->input(0));
+  EXPECT_EQ("embedding_b", fused->input(1));
+  EXPECT_EQ("kernel", fused->input(2));
+  EXPECT_EQ(2, fused->attr().at("N").i());
+  EXPECT_EQ(0, fused->attr().at("num_bias").i());
+  EXPECT_EQ("None", fused->attr().at("activation").s());
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+// The remapper rewrites Relu(BiasAdd(MatMul)) to _FusedMatMul on CPU before
+// the fusion runs.
+TEST_F(ConcatMatMulFusionTest, FusesFusedMatMulWithBiasAndRelu) {
+  using test::function::NDef;
+  GrapplerItem item;
+  BuildGraph(&item.graph);
+  *item.graph.add_node() = RandomConst("bias", {5});
+  NodeDef* matmul = item.graph.mutable_node(item.graph.node_size() - 2);
+  ASSERT_EQ("output", matmul->name());
+  *matmul = NDef("output", "_FusedMatMul", {"concat", "kernel", "bias"},
+                 {{"T", DT_FLOAT},
+                  {"transpose_a", false},
+                  {"transpose_b", false},
+                  {"num_args", 1},
+                  {"fused_ops", gtl::ArraySlice<string>({"BiasAdd", "Relu"})},
+                  {"epsilon", 0.0001f}},
+                 "/device:CPU:0");
+  item.fetch = {"output"};
+
+  ConcatMatMulFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(nullptr, FindNode(output, "concat"));
+  const NodeDef* fused = FindNode(output, "output");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("ConcatMatMul", fused->op());
+  ASSERT_EQ(4, fused->input_size());
+  EXPECT_EQ("bias", fused->input(3));
+  EXPECT_EQ(1, fused->attr().at("num_bias").i());
+  EXPECT_EQ("Relu", fused->attr().at("activation").s());
+}
+
+TEST_F(ConcatMatMulFusionTest, KeepsUsedConcat) {
+  GrapplerItem item;
+  BuildGraph(&item.graph);
+  // E.g. used by the kernel gradient of a training graph.
+  item.fetch = {"output", "concat"};
+
+  ConcatMatMulFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(ConcatMatMulFusionTest, KeepsConcatOfDenseInputs) {
+  GrapplerItem item;
+  BuildGraph(&item.graph, /*dense=*/true);
+  item.fetch = {"output"};
+
+  ConcatMatMulFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
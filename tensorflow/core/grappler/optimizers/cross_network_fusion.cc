@@ -0,0 +1,519 @@
+#include "tensorflow/core/grappler/optimizers/cross_network_fusion.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace crossnetworkfusion {
+
+struct CrossLayer {
+  string x;
+  string kernel;
+  string bias;
+  string projection_kernel;
+  string projection_bias;
+  // The tensor added to the layer output, x or x0.
+  string residual;
+};
+
+struct CrossNetworkPattern {
+  int output_id = -1;
+  // Nodes replaced by the fused op.
+  std::vector<int> nodes;
+  bool v2 = false;
+  bool low_rank = false;
+  bool input_residual = false;
+  string x0;
+  // From the first layer to the last.
+  std::vector<CrossLayer> layers;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+bool GetIntValues(const NodeDef& node, std::vector<int64>* values) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor)) return false;
+  values->clear();
+  if (tensor.dtype() == DT_INT32) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int32>()(i));
+    }
+  } else if (tensor.dtype() == DT_INT64) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int64>()(i));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool SameTensor(const string& a, const string& b) {
+  return ParseTensorName(a) == ParseTensorName(b);
+}
+
+class CrossNetworkMatcher {
+ public:
+  explicit CrossNetworkMatcher(const utils::MutableGraphView& graph_view)
+      : graph_view_(graph_view) {}
+
+  bool Match(int node_index, CrossNetworkPattern* matched) {
+    for (const bool v2 : {false, true}) {
+      for (const bool low_rank : {true, false}) {
+        if (low_rank && !v2) continue;
+        CrossNetworkPattern pattern;
+        pattern.output_id = node_index;
+        pattern.v2 = v2;
+        pattern.low_rank = low_rank;
+        if (MatchLayers(node_index, &pattern)) {
+          *matched = std::move(pattern);
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+ private:
+  static bool IsFloat(const NodeDef& node) {
+    auto it = node.attr().find("T");
+    return it != node.attr().end() && it->second.type() == DT_FLOAT;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  static bool IsFusedMatMulWithBias(const NodeDef& node) {
+    if (node.op() != "_FusedMatMul" || node.input_size() < 3) return false;
+    auto it = node.attr().find("fused_ops");
+    return it != node.attr().end() && it->second.list().s_size() == 1 &&
+           it->second.list().s(0) == "BiasAdd";
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    return fanin.index() == 0 ? fanin.node_index() : -1;
+  }
+
+  // Returns the node of the tensor, or -1 if it is not the first output of
+  // a node.
+  int TensorNode(const string& tensor) const {
+    const TensorId id = ParseTensorName(tensor);
+    const auto* node_view = graph_view_.GetNode(id.node());
+    return node_view != nullptr && id.index() == 0 ? node_view->node_index()
+                                                   : -1;
+  }
+
+  // Adds the node to the pattern if `func` matches it.
+  bool IsOp(int node_index, bool (*func)(const NodeDef& node),
+            CrossNetworkPattern* pattern) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    if (!func(*node) || !IsFloat(*node) || !NodeIsOnCpu(node)) return false;
+    pattern->nodes.push_back(node_index);
+    return true;
+  }
+
+  // Returns whether constant input `i` is a scalar or vector of one value
+  // in `values`.
+  bool IsAxis(int node_index, int i,
+              std::initializer_list<int64> values) const {
+    const int input = Fanin(node_index, i);
+    std::vector<int64> axis;
+    if (input < 0 || !GetIntValues(*Node(input), &axis) || axis.size() != 1) {
+      return false;
+    }
+    return std::find(values.begin(), values.end(), axis[0]) != values.end();
+  }
+
+  bool SetX0(const string& x0, CrossNetworkPattern* pattern) const {
+    if (pattern->x0.empty()) pattern->x0 = x0;
+    return SameTensor(pattern->x0, x0);
+  }
+
+  // Matches the layers from the last one, `node_index`, back to x0.
+  bool MatchLayers(int node_index, CrossNetworkPattern* pattern) const {
+    int output = node_index;
+    while (true) {
+      CrossLayer layer;
+      if (!(pattern->v2 ? MatchV2Layer(output, pattern, &layer)
+                        : MatchLayer(output, pattern, &layer))) {
+        return false;
+      }
+      pattern->layers.insert(pattern->layers.begin(), layer);
+      if (SameTensor(layer.x, pattern->x0)) break;
+      output = TensorNode(layer.x);
+      if (output < 0) return false;
+    }
+    // The fused node replaces the last layer.
+    pattern->nodes.erase(pattern->nodes.begin());
+
+    // Layers after the first add either their input or x0.
+    bool layer_residual = false;
+    for (const CrossLayer& layer : pattern->layers) {
+      if (SameTensor(layer.x, pattern->x0)) continue;
+      if (SameTensor(layer.residual, layer.x)) {
+        layer_residual = true;
+      } else if (pattern->v2 && SameTensor(layer.residual, pattern->x0)) {
+        pattern->input_residual = true;
+      } else {
+        return false;
+      }
+    }
+    return !(layer_residual && pattern->input_residual) &&
+           SameTensor(pattern->layers[0].residual, pattern->x0);
+  }
+
+  // Add(Add(Mul(x0, Sum(Mul(x, kernel), 1, keep_dims=true)), bias), x)
+  bool MatchLayer(int node_index, CrossNetworkPattern* pattern,
+                  CrossLayer* layer) const {
+    if (!IsOp(node_index, IsAdd, pattern)) return false;
+    const int add = Fanin(node_index, 0);
+    if (!IsOp(add, IsAdd, pattern)) return false;
+    const int mul = Fanin(add, 0);
+    if (!IsOp(mul, IsMul, pattern)) return false;
+    const int sum = Fanin(mul, 1);
+    if (!IsOp(sum, IsSum, pattern) || !GetBoolAttr(*Node(sum), "keep_dims") ||
+        !IsAxis(sum, 1, {1, -1})) {
+      return false;
+    }
+    const int product = Fanin(sum, 0);
+    if (!IsOp(product, IsMul, pattern)) return false;
+    layer->x = Node(node_index)->input(1);
+    layer->residual = layer->x;
+    layer->kernel = Node(product)->input(1);
+    layer->bias = Node(add)->input(1);
+    return SameTensor(Node(product)->input(0), layer->x) &&
+           SetX0(Node(mul)->input(0), pattern);
+  }
+
+  // Add(Mul(x0, BiasAdd(MatMul(input, kernel), bias)), residual), where
+  // input is x or, for low rank layers, BiasAdd(MatMul(x, projection_kernel),
+  // projection_bias).
+  bool MatchV2Layer(int node_index, CrossNetworkPattern* pattern,
+                    CrossLayer* layer) const {
+    if (!IsOp(node_index, IsAdd, pattern)) return false;
+    const int mul = Fanin(node_index, 0);
+    if (!IsOp(mul, IsMul, pattern)) return false;
+    int matmul = -1;
+    if (!MatchDense(Fanin(mul, 1), pattern, &layer->kernel, &layer->bias,
+                    &matmul)) {
+      return false;
+    }
+    layer->x = Node(matmul)->input(0);
+    if (pattern->low_rank) {
+      if (!MatchDense(Fanin(matmul, 0), pattern, &layer->projection_kernel,
+                      &layer->projection_bias, &matmul)) {
+        return false;
+      }
+      layer->x = Node(matmul)->input(0);
+    }
+    layer->residual = Node(node_index)->input(1);
+    return SetX0(Node(mul)->input(0), pattern);
+  }
+
+  // BiasAdd(MatMul(input, kernel), bias), as tf.layers.dense without
+  // activation, or the _FusedMatMul the remapper rewrites it to on CPU. Sets
+  // `matmul` to the MatMul node.
+  bool MatchDense(int node_index, CrossNetworkPattern* pattern,
+                  string* kernel, string* bias, int* matmul) const {
+    if (IsOp(node_index, IsFusedMatMulWithBias, pattern)) {
+      *matmul = node_index;
+      *bias = Node(node_index)->input(2);
+    } else if (IsOp(node_index, IsBiasAdd, pattern)) {
+      *matmul = Fanin(node_index, 0);
+      *bias = Node(node_index)->input(1);
+      if (!IsOp(*matmul, IsMatMul, pattern)) return false;
+    } else {
+      return false;
+    }
+    const NodeDef* matmul_node = Node(*matmul);
+    if (GetBoolAttr(*matmul_node, "transpose_a") ||
+        GetBoolAttr(*matmul_node, "transpose_b")) {
+      return false;
+    }
+    *kernel = matmul_node->input(1);
+    return true;
+  }
+
+  const utils::MutableGraphView& graph_view_;
+};
+
+// Adds to the pattern the nodes that only compute values for it, e.g. the
+// axes of the sums, and returns false if another node uses one of its
+// intermediate tensors.
+bool CollectRemovableNodes(const utils::MutableGraphView& graph_view,
+                           const std::unordered_set<string>& nodes_to_preserve,
+                           CrossNetworkPattern* pattern) {
+  std::unordered_set<int> removed(pattern->nodes.begin(), pattern->nodes.end());
+  std::unordered_set<string> kept;
+  kept.insert(string(ParseTensorName(pattern->x0).node()));
+  for (const CrossLayer& layer : pattern->layers) {
+    for (const string* input :
+         {&layer.kernel, &layer.bias, &layer.projection_kernel,
+          &layer.projection_bias}) {
+      if (!input->empty()) kept.insert(string(ParseTensorName(*input).node()));
+    }
+  }
+
+  auto can_remove = [&](int index) {
+    const auto* node_view = graph_view.GetNode(index);
+    const NodeDef* node = node_view->node();
+    return index != pattern->output_id &&
+           nodes_to_preserve.count(node->name()) == 0 &&
+           kept.count(node->name()) == 0 && IsFreeOfSideEffect(*node) &&
+           node_view->NumControllingFanins() == 0 &&
+           node_view->NumControlledFanouts() == 0;
+  };
+  for (int index : removed) {
+    if (!can_remove(index)) return false;
+  }
+
+  // Consumers of the intermediate tensors, which may only feed the pattern.
+  std::function<bool(int, std::unordered_set<int>*)> only_feeds_pattern =
+      [&](int index, std::unordered_set<int>* visited) {
+        if (removed.count(index) > 0) return true;
+        if (!visited->insert(index).second || !can_remove(index)) {
+          return false;
+        }
+        for (const auto& fanouts :
+             graph_view.GetNode(index)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            if (!only_feeds_pattern(fanout.node_index(), visited)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      };
+  std::vector<int> pending(removed.begin(), removed.end());
+  for (int index : pending) {
+    for (const auto& fanouts : graph_view.GetNode(index)->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        const int consumer = fanout.node_index();
+        if (consumer == pattern->output_id) continue;
+        std::unordered_set<int> visited;
+        if (!only_feeds_pattern(consumer, &visited)) return false;
+        removed.insert(visited.begin(), visited.end());
+      }
+    }
+  }
+
+  // Producers that are only used by removed nodes, e.g. Const.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    pending.assign(removed.begin(), removed.end());
+    for (int index : pending) {
+      for (const auto& fanin : graph_view.GetNode(index)->GetRegularFanins()) {
+        const int producer = fanin.node_index();
+        if (removed.count(producer) > 0 || !can_remove(producer)) continue;
+        bool used = false;
+        for (const auto& fanouts :
+             graph_view.GetNode(producer)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            used |= removed.count(fanout.node_index()) == 0;
+          }
+        }
+        if (!used) {
+          removed.insert(producer);
+          changed = true;
+        }
+      }
+    }
+  }
+  pattern->nodes.assign(removed.begin(), removed.end());
+  return true;
+}
+
+// Returns the static shape of the tensor, with -1 for unknown dimensions.
+bool GetShape(const GraphProperties& properties, const string& tensor,
+              std::vector<int64>* dims) {
+  const TensorId id = ParseTensorName(tensor);
+  const string node(id.node());
+  if (!properties.HasOutputProperties(node) || id.index() < 0) return false;
+  const auto& outputs = properties.GetOutputProperties(node);
+  if (id.index() >= outputs.size()) return false;
+  const TensorShapeProto& shape = outputs[id.index()].shape();
+  if (shape.unknown_rank()) return false;
+  dims->clear();
+  for (const auto& dim : shape.dim()) dims->push_back(dim.size());
+  return true;
+}
+
+bool HasShape(const GraphProperties& properties, const string& tensor,
+              const std::vector<int64>& expected) {
+  std::vector<int64> dims;
+  return GetShape(properties, tensor, &dims) && dims == expected;
+}
+
+// The unfused layers broadcast their operands, while the fused op requires
+// the exact shapes of _cross_net.
+bool HasValidShapes(const GraphProperties& properties,
+                    const CrossNetworkPattern& pattern) {
+  std::vector<int64> x0;
+  if (!GetShape(properties, pattern.x0, &x0) || x0.size() != 2 || x0[1] < 0) {
+    return false;
+  }
+  const int64 d = x0[1];
+  int64 rank = -1;
+  for (const CrossLayer& layer : pattern.layers) {
+    if (!HasShape(properties, layer.bias, {d})) return false;
+    if (!pattern.v2) {
+      if (!HasShape(properties, layer.kernel, {d})) return false;
+      continue;
+    }
+    if (pattern.low_rank) {
+      std::vector<int64> projection;
+      if (!GetShape(properties, layer.projection_kernel, &projection) ||
+          projection.size() != 2 || projection[0] != d || projection[1] < 0 ||
+          (rank >= 0 && projection[1] != rank)) {
+        return false;
+      }
+      rank = projection[1];
+      if (!HasShape(properties, layer.projection_bias, {rank}) ||
+          !HasShape(properties, layer.kernel, {rank, d})) {
+        return false;
+      }
+    } else if (!HasShape(properties, layer.kernel, {d, d})) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace crossnetworkfusion
+
+Status CrossNetworkFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                    GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = item.graph.node_size();
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  const GraphDef* graph = graph_view.graph();
+
+  VLOG(3) << "Before cross network fusion rewrites: " << graph->DebugString();
+
+  crossnetworkfusion::CrossNetworkMatcher matcher(graph_view);
+  std::vector<crossnetworkfusion::CrossNetworkPattern> patterns;
+  for (int i = 0; i < num_nodes; ++i) {
+    crossnetworkfusion::CrossNetworkPattern pattern;
+    if (matcher.Match(i, &pattern) &&
+        crossnetworkfusion::CollectRemovableNodes(graph_view,
+                                                  nodes_to_preserve,
+                                                  &pattern)) {
+      patterns.push_back(std::move(pattern));
+    }
+  }
+  if (patterns.empty()) return Status::OK();
+
+  GraphProperties properties(item);
+  status = properties.InferStatically(/*assume_valid_feeds=*/false);
+  if (!status.ok()) {
+    VLOG(1) << "Skipping cross network fusion: " << status;
+    return Status::OK();
+  }
+
+  // Networks of more layers first, so that the layers of a network are
+  // fused as a whole rather than from one of the intermediate layers.
+  std::stable_sort(
+      patterns.begin(), patterns.end(),
+      [](const crossnetworkfusion::CrossNetworkPattern& a,
+         const crossnetworkfusion::CrossNetworkPattern& b) {
+        return a.layers.size() > b.layers.size();
+      });
+  // Nodes of a fused pattern, which can't be part of another one.
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  for (const auto& pattern : patterns) {
+    bool overlaps = nodes_to_delete[pattern.output_id];
+    for (int id : pattern.nodes) overlaps |= nodes_to_delete[id];
+    if (overlaps ||
+        !crossnetworkfusion::HasValidShapes(properties, pattern)) {
+      continue;
+    }
+
+    const NodeDef& last_layer = graph->node(pattern.output_id);
+    VLOG(2) << "Optimizing fused cross network node "
+            << SummarizeNodeDef(last_layer);
+    for (int id : pattern.nodes) nodes_to_delete[id] = true;
+
+    NodeDef fused_op;
+    fused_op.set_name(last_layer.name());
+    fused_op.set_op(pattern.v2 ? "CrossNetworkV2" : "CrossNetwork");
+    fused_op.set_device(last_layer.device());
+    fused_op.add_input(pattern.x0);
+    for (const auto& layer : pattern.layers) fused_op.add_input(layer.kernel);
+    for (const auto& layer : pattern.layers) fused_op.add_input(layer.bias);
+    if (pattern.low_rank) {
+      for (const auto& layer : pattern.layers) {
+        fused_op.add_input(layer.projection_kernel);
+      }
+      for (const auto& layer : pattern.layers) {
+        fused_op.add_input(layer.projection_bias);
+      }
+    }
+    for (const string& input : last_layer.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["num_layers"].set_i(pattern.layers.size());
+    if (pattern.v2) {
+      (*attr)["num_projections"].set_i(
+          pattern.low_rank ? pattern.layers.size() : 0);
+      (*attr)["input_residual"].set_b(pattern.input_residual);
+    }
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  if (fused_nodes.empty()) return Status::OK();
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  VLOG(3) << "After cross network fusion rewrites: " << output->DebugString();
+
+  return Status::OK();
+}
+
+void CrossNetworkFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                  const GraphDef& optimize_output,
+                                  double result) {
+  // Nothing to do for CrossNetworkFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,47 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_NETWORK_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_NETWORK_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Rewrites the cross layers of modelzoo/dcn and modelzoo/dcnv2 _cross_net,
+// from x[0] = x0 to the last layer, into a CrossNetwork op:
+//
+//   xw       = Sum(Mul(x[l], kernel), 1, keep_dims=true)
+//   x[l + 1] = Add(Add(Mul(x0, xw), bias), x[l])
+//
+// or a CrossNetworkV2 op:
+//
+//   input    = x[l]  // or BiasAdd(MatMul(x[l], projection_kernel), ...)
+//   h        = BiasAdd(MatMul(input, kernel), bias)
+//   x[l + 1] = Add(Mul(x0, h), x[l])  // or Add(Mul(x0, h), x0)
+//
+// The fused op replaces the last layer. As for DinAttentionFusion, the
+// intermediate tensors must not be used elsewhere, so training graphs are
+// left unchanged. They can call tf.nn.cross_network directly.
+class CrossNetworkFusion : public GraphOptimizer {
+ public:
+  CrossNetworkFusion() = default;
+  explicit CrossNetworkFusion(RewriterConfig::Toggle opt_level) {}
+  ~CrossNetworkFusion() override {}
+
+  string name() const override { return "cross_network_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_CROSS_NETWORK_FUSION_H_
@@ -0,0 +1,206 @@
+#include "tensorflow/core/grappler/optimizers/cross_network_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/remapper.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class CrossNetworkFusionTest : public GrapplerTest {
+ protected:
+  static NodeDef RandomConst(const string& name, const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return test::function::NDef(name, "Const", {},
+                                {{"dtype", DT_FLOAT}, {"value", t}});
+  }
+
+  // The graph of modelzoo/dcn _cross_net with 2 layers over a [4, 3] input,
+  // and the inputs of the fused op. The biases have shape `bias_shape`.
+  void BuildGraph(const TensorShape& bias_shape, GraphDef* graph,
+                  std::vector<NodeDef>* inputs) {
+    using test::function::NDef;
+    *inputs = {RandomConst("x0", {4, 3}), RandomConst("w0", {3}),
+               RandomConst("w1", {3}), RandomConst("b0", bias_shape),
+               RandomConst("b1", bias_shape)};
+    *graph = test::function::GDef({
+        NDef("axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", test::AsScalar<int32>(1)}}),
+    });
+    string x = "x0";
+    for (int l = 0; l < 2; ++l) {
+      const string layer = strings::StrCat("layer_", l);
+      for (const NodeDef& node : {
+               NDef(layer + "/xw", "Mul", {x, strings::StrCat("w", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/sum", "Sum", {layer + "/xw", "axis"},
+                    {{"T", DT_FLOAT}, {"Tidx", DT_INT32}, {"keep_dims", true}}),
+               NDef(layer + "/mul", "Mul", {"x0", layer + "/sum"},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/add", "Add", {layer + "/mul",
+                                            strings::StrCat("b", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/output", "Add", {layer + "/add", x},
+                    {{"T", DT_FLOAT}}),
+           }) {
+        *graph->add_node() = node;
+      }
+      x = layer + "/output";
+    }
+    for (const NodeDef& input : *inputs) *graph->add_node() = input;
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+
+  // The graph of modelzoo/dcnv2 _cross_net with --projection_dim 2, which
+  // adds x0 to the output of each layer.
+  void BuildV2Graph(GraphDef* graph, std::vector<NodeDef>* inputs) {
+    using test::function::NDef;
+    *inputs = {RandomConst("x0", {4, 3}),     RandomConst("u0", {2, 3}),
+               RandomConst("u1", {2, 3}),     RandomConst("b0", {3}),
+               RandomConst("b1", {3}),        RandomConst("v0", {3, 2}),
+               RandomConst("v1", {3, 2}),     RandomConst("c0", {2}),
+               RandomConst("c1", {2})};
+    string x = "x0";
+    for (int l = 0; l < 2; ++l) {
+      const string layer = strings::StrCat("layer_", l);
+      for (const NodeDef& node : {
+               NDef(layer + "/p", "MatMul", {x, strings::StrCat("v", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/p_bias", "BiasAdd",
+                    {layer + "/p", strings::StrCat("c", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/h", "MatMul",
+                    {layer + "/p_bias", strings::StrCat("u", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/h_bias", "BiasAdd",
+                    {layer + "/h", strings::StrCat("b", l)},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/mul", "Mul", {"x0", layer + "/h_bias"},
+                    {{"T", DT_FLOAT}}),
+               NDef(layer + "/output", "Add", {layer + "/mul", "x0"},
+                    {{"T", DT_FLOAT}}),
+           }) {
+        *graph->add_node() = node;
+      }
+      x = layer + "/output";
+    }
+    for (const NodeDef& input : *inputs) *graph->add_node() = input;
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+
+  void ExpectFused(const GrapplerItem& item, const std::vector<NodeDef>& inputs,
+                   const NodeDef& fused_op) {
+    CrossNetworkFusion optimizer;
+    GraphDef output;
+    TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+    GraphDef expected;
+    for (NodeDef input : inputs) {
+      input.set_device("/device:CPU:0");
+      *expected.add_node() = input;
+    }
+    *expected.add_node() = fused_op;
+    CompareGraphs(expected, output);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+    auto tensors = EvaluateNodes(output, item.fetch);
+    ASSERT_EQ(1, tensors_expected.size());
+    ASSERT_EQ(1, tensors.size());
+    test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+  }
+};
+
+TEST_F(CrossNetworkFusionTest, FusesCrossNetwork) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph({3}, &item.graph, &inputs);
+  item.fetch = {"layer_1/output"};
+
+  ExpectFused(item, inputs,
+              test::function::NDef("layer_1/output", "CrossNetwork",
+                                   {"x0", "w0", "w1", "b0", "b1"},
+                                   {{"T", DT_FLOAT}, {"num_layers", 2}},
+                                   "/device:CPU:0"));
+}
+
+TEST_F(CrossNetworkFusionTest, FusesLowRankCrossNetworkV2) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildV2Graph(&item.graph, &inputs);
+  item.fetch = {"layer_1/output"};
+
+  ExpectFused(item, inputs,
+              test::function::NDef(
+                  "layer_1/output", "CrossNetworkV2",
+                  {"x0", "u0", "u1", "b0", "b1", "v0", "v1", "c0", "c1"},
+                  {{"T", DT_FLOAT},
+                   {"num_layers", 2},
+                   {"num_projections", 2},
+                   {"input_residual", true}},
+                  "/device:CPU:0"));
+}
+
+TEST_F(CrossNetworkFusionTest, FusesRemappedCrossNetworkV2) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildV2Graph(&item.graph, &inputs);
+  item.fetch = {"layer_1/output"};
+
+  // The meta optimizer runs the remapper first, which rewrites the dense
+  // layers to _FusedMatMul ops on CPU.
+  GrapplerItem remapped = item;
+  Remapper remapper(RewriterConfig::ON);
+  TF_EXPECT_OK(remapper.Optimize(/*cluster=*/nullptr, item, &remapped.graph));
+  int fused_matmuls = 0;
+  for (const NodeDef& node : remapped.graph.node()) {
+    fused_matmuls += node.op() == "_FusedMatMul";
+  }
+  EXPECT_EQ(4, fused_matmuls);
+
+  ExpectFused(remapped, inputs,
+              test::function::NDef(
+                  "layer_1/output", "CrossNetworkV2",
+                  {"x0", "u0", "u1", "b0", "b1", "v0", "v1", "c0", "c1"},
+                  {{"T", DT_FLOAT},
+                   {"num_layers", 2},
+                   {"num_projections", 2},
+                   {"input_residual", true}},
+                  "/device:CPU:0"));
+}
+
+TEST_F(CrossNetworkFusionTest, KeepsUsedIntermediates) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph({3}, &item.graph, &inputs);
+  // E.g. used by the gradients of a training graph.
+  item.fetch = {"layer_1/output", "layer_0/sum"};
+
+  CrossNetworkFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(CrossNetworkFusionTest, KeepsBroadcastBiases) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  // Broadcast by the unfused layers, but not accepted by CrossNetwork.
+  BuildGraph({1, 3}, &item.graph, &inputs);
+  item.fetch = {"layer_1/output"};
+
+  CrossNetworkFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,414 @@
+#include "tensorflow/core/grappler/optimizers/din_attention_fusion.h"
+
+#include <functional>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace dinattentionfusion {
+
+struct DinAttentionPattern {
+  int batch_matmul_id = -1;
+  // Nodes replaced by the fused op.
+  std::vector<int> nodes;
+  string query;
+  string facts;
+  string mask;
+  string weights[6];  // w1, b1, w2, b2, w3, b3
+  float padding_value = 0;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+bool GetIntValues(const NodeDef& node, std::vector<int64>* values) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor)) return false;
+  values->clear();
+  if (tensor.dtype() == DT_INT32) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int32>()(i));
+    }
+  } else if (tensor.dtype() == DT_INT64) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int64>()(i));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool IsSameTensor(const string& a, const string& b) {
+  return ParseTensorName(a) == ParseTensorName(b);
+}
+
+class DinAttentionMatcher {
+ public:
+  explicit DinAttentionMatcher(const utils::MutableGraphView& graph_view)
+      : graph_view_(graph_view) {}
+
+  bool Match(int node_index, DinAttentionPattern* matched) {
+    DinAttentionPattern pattern;
+    const NodeDef* batch_matmul = Node(node_index);
+    if (batch_matmul->op() != "BatchMatMul" &&
+        batch_matmul->op() != "BatchMatMulV2") {
+      return false;
+    }
+    if (!NodeIsOnCpu(batch_matmul) || !IsFloat(*batch_matmul) ||
+        GetBoolAttr(*batch_matmul, "adj_x") ||
+        GetBoolAttr(*batch_matmul, "adj_y") ||
+        batch_matmul->input_size() < 2) {
+      return false;
+    }
+    pattern.batch_matmul_id = node_index;
+    pattern.facts = batch_matmul->input(1);
+
+    // Softmax(Select(mask, scores, paddings))
+    const int softmax = Fanin(node_index, 0);
+    if (!IsOp(softmax, IsSoftmax, &pattern)) return false;
+    const int select = Fanin(softmax, 0);
+    if (!IsOp(select, IsAnySelect, &pattern)) return false;
+    pattern.mask = Node(select)->input(0);
+    const int scores = Fanin(select, 1);
+    if (!MatchPaddings(Fanin(select, 2), scores, &pattern)) return false;
+    if (!IsOp(scores, IsReshape, &pattern)) return false;
+
+    // The three dense layers.
+    int input = -1;
+    if (!MatchDense(SkipPassThrough(Fanin(scores, 0), &pattern), &pattern,
+                    &pattern.weights[4], &pattern.weights[5], &input)) {
+      return false;
+    }
+    for (int layer = 1; layer >= 0; --layer) {
+      if (!IsOp(input, IsSigmoid, &pattern)) return false;
+      const int bias_add = SkipPassThrough(Fanin(input, 0), &pattern);
+      if (!MatchDense(bias_add, &pattern, &pattern.weights[2 * layer],
+                      &pattern.weights[2 * layer + 1], &input)) {
+        return false;
+      }
+    }
+    if (!MatchFeatures(input, &pattern)) return false;
+
+    *matched = std::move(pattern);
+    return true;
+  }
+
+ private:
+  static bool IsAnySelect(const NodeDef& node) {
+    return IsSelect(node) || node.op() == "SelectV2";
+  }
+
+  static bool IsSigmoid(const NodeDef& node) { return node.op() == "Sigmoid"; }
+
+  static bool IsFloat(const NodeDef& node) {
+    auto it = node.attr().find("T");
+    return it != node.attr().end() && it->second.type() == DT_FLOAT;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    return fanin.index() == 0 ? fanin.node_index() : -1;
+  }
+
+  // Adds the node to the pattern if `func` matches it.
+  bool IsOp(int node_index, bool (*func)(const NodeDef& node),
+            DinAttentionPattern* pattern) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    if (!func(*node) || !NodeIsOnCpu(node)) return false;
+    pattern->nodes.push_back(node_index);
+    return true;
+  }
+
+  // Returns the values of constant input `i`.
+  bool GetIntInput(int node_index, int i, std::vector<int64>* values) const {
+    const int input = Fanin(node_index, i);
+    return input >= 0 && GetIntValues(*Node(input), values);
+  }
+
+  bool IsPassThrough(int node_index) const {
+    const NodeDef* node = Node(node_index);
+    if (IsReshape(*node) || IsIdentity(*node)) return true;
+    if (!IsTranspose(*node)) return false;
+    std::vector<int64> perm;
+    if (!GetIntInput(node_index, 1, &perm)) return false;
+    for (int i = 0; i < perm.size(); ++i) {
+      if (perm[i] != i) return false;
+    }
+    return true;
+  }
+
+  int SkipPassThrough(int node_index, DinAttentionPattern* pattern) const {
+    while (node_index >= 0 && IsPassThrough(node_index)) {
+      pattern->nodes.push_back(node_index);
+      node_index = Fanin(node_index, 0);
+    }
+    return node_index;
+  }
+
+  // OnesLike(scores) * padding_value
+  bool MatchPaddings(int node_index, int scores,
+                     DinAttentionPattern* pattern) const {
+    if (!IsOp(node_index, IsMul, pattern)) return false;
+    const NodeDef* mul = Node(node_index);
+    for (int i = 0; i < 2; ++i) {
+      const int ones_like = Fanin(node_index, i);
+      const int value = Fanin(node_index, 1 - i);
+      Tensor padding;
+      if (ones_like < 0 || value < 0 ||
+          Node(ones_like)->op() != "OnesLike" ||
+          Fanin(ones_like, 0) != scores ||
+          !GetConstTensor(*Node(value), &padding) ||
+          padding.dtype() != DT_FLOAT || padding.NumElements() != 1) {
+        continue;
+      }
+      pattern->padding_value = padding.flat<float>()(0);
+      pattern->nodes.push_back(ones_like);
+      return mul->input_size() == 2;
+    }
+    return false;
+  }
+
+  // BiasAdd(MatMul(input, w), b)
+  bool MatchDense(int node_index, DinAttentionPattern* pattern, string* w,
+                  string* b, int* input) const {
+    if (!IsOp(node_index, IsBiasAdd, pattern)) return false;
+    *b = Node(node_index)->input(1);
+    const int matmul = SkipPassThrough(Fanin(node_index, 0), pattern);
+    if (!IsOp(matmul, IsMatMul, pattern)) return false;
+    const NodeDef* matmul_node = Node(matmul);
+    if (GetBoolAttr(*matmul_node, "transpose_a") ||
+        GetBoolAttr(*matmul_node, "transpose_b")) {
+      return false;
+    }
+    *w = matmul_node->input(1);
+    *input = SkipPassThrough(Fanin(matmul, 0), pattern);
+    return true;
+  }
+
+  // ConcatV2(queries, facts, queries - facts, queries * facts, -1) with
+  // queries = Reshape(Tile(query, multiples), shape).
+  bool MatchFeatures(int node_index, DinAttentionPattern* pattern) const {
+    if (!IsOp(node_index, IsConcat, pattern)) return false;
+    const NodeDef* concat = Node(node_index);
+    std::vector<int64> axis;
+    if (concat->op() != "ConcatV2" || concat->input_size() != 5 ||
+        !GetIntInput(node_index, 4, &axis) ||
+        axis.size() != 1 || (axis[0] != -1 && axis[0] != 2)) {
+      return false;
+    }
+    const string& queries = concat->input(0);
+    if (!IsSameTensor(concat->input(1), pattern->facts)) return false;
+
+    const int sub = Fanin(node_index, 2);
+    if (!IsOp(sub, IsSub, pattern) ||
+        !IsSameTensor(Node(sub)->input(0), queries) ||
+        !IsSameTensor(Node(sub)->input(1), pattern->facts)) {
+      return false;
+    }
+    const int mul = Fanin(node_index, 3);
+    if (!IsOp(mul, IsMul, pattern)) return false;
+    const NodeDef* mul_node = Node(mul);
+    if (!(IsSameTensor(mul_node->input(0), queries) &&
+          IsSameTensor(mul_node->input(1), pattern->facts)) &&
+        !(IsSameTensor(mul_node->input(1), queries) &&
+          IsSameTensor(mul_node->input(0), pattern->facts))) {
+      return false;
+    }
+
+    const int reshape = Fanin(node_index, 0);
+    if (!IsOp(reshape, IsReshape, pattern)) return false;
+    const int tile = Fanin(reshape, 0);
+    if (!IsOp(tile, IsTile, pattern)) return false;
+    pattern->query = Node(tile)->input(0);
+    return true;
+  }
+
+  const utils::MutableGraphView& graph_view_;
+};
+
+// Adds to the pattern the nodes that only compute values for it, e.g. the
+// shapes of the reshapes, and returns false if another node uses one of its
+// intermediate tensors.
+bool CollectRemovableNodes(const utils::MutableGraphView& graph_view,
+                           const std::unordered_set<string>& nodes_to_preserve,
+                           DinAttentionPattern* pattern) {
+  std::unordered_set<int> removed(pattern->nodes.begin(), pattern->nodes.end());
+  std::unordered_set<string> kept;
+  for (const string& input : {pattern->query, pattern->facts, pattern->mask}) {
+    kept.insert(string(ParseTensorName(input).node()));
+  }
+  for (const string& input : pattern->weights) {
+    kept.insert(string(ParseTensorName(input).node()));
+  }
+
+  auto can_remove = [&](int index) {
+    const auto* node_view = graph_view.GetNode(index);
+    const NodeDef* node = node_view->node();
+    return index != pattern->batch_matmul_id &&
+           nodes_to_preserve.count(node->name()) == 0 &&
+           kept.count(node->name()) == 0 && IsFreeOfSideEffect(*node) &&
+           node_view->NumControllingFanins() == 0 &&
+           node_view->NumControlledFanouts() == 0;
+  };
+  for (int index : removed) {
+    if (!can_remove(index)) return false;
+  }
+
+  // Consumers of the intermediate tensors, which may only feed the pattern.
+  std::function<bool(int, std::unordered_set<int>*)> only_feeds_pattern =
+      [&](int index, std::unordered_set<int>* visited) {
+        if (removed.count(index) > 0) return true;
+        if (!visited->insert(index).second || !can_remove(index)) {
+          return false;
+        }
+        for (const auto& fanouts :
+             graph_view.GetNode(index)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            if (!only_feeds_pattern(fanout.node_index(), visited)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      };
+  std::vector<int> pending(removed.begin(), removed.end());
+  for (int index : pending) {
+    for (const auto& fanouts : graph_view.GetNode(index)->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        const int consumer = fanout.node_index();
+        if (consumer == pattern->batch_matmul_id) continue;
+        std::unordered_set<int> visited;
+        if (!only_feeds_pattern(consumer, &visited)) return false;
+        removed.insert(visited.begin(), visited.end());
+      }
+    }
+  }
+
+  // Producers that are only used by removed nodes, e.g. Shape and Const.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    pending.assign(removed.begin(), removed.end());
+    for (int index : pending) {
+      for (const auto& fanin : graph_view.GetNode(index)->GetRegularFanins()) {
+        const int producer = fanin.node_index();
+        if (removed.count(producer) > 0 || !can_remove(producer)) continue;
+        bool used = false;
+        for (const auto& fanouts :
+             graph_view.GetNode(producer)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            used |= removed.count(fanout.node_index()) == 0;
+          }
+        }
+        if (!used) {
+          removed.insert(producer);
+          changed = true;
+        }
+      }
+    }
+  }
+  pattern->nodes.assign(removed.begin(), removed.end());
+  return true;
+}
+
+}  // namespace dinattentionfusion
+
+Status DinAttentionFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                   GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = item.graph.node_size();
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  // Nodes of a fused pattern, which can't be part of another one.
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  const GraphDef* graph = graph_view.graph();
+
+  VLOG(3) << "Before DIN attention fusion rewrites: " << graph->DebugString();
+
+  dinattentionfusion::DinAttentionMatcher matcher(graph_view);
+  for (int i = 0; i < num_nodes; ++i) {
+    dinattentionfusion::DinAttentionPattern pattern;
+    if (nodes_to_delete[i] || !matcher.Match(i, &pattern) ||
+        !dinattentionfusion::CollectRemovableNodes(
+            graph_view, nodes_to_preserve, &pattern)) {
+      continue;
+    }
+    bool overlaps = false;
+    for (int id : pattern.nodes) overlaps |= nodes_to_delete[id];
+    if (overlaps) continue;
+
+    const NodeDef& batch_matmul = graph->node(i);
+    VLOG(2) << "Optimizing fused DIN attention node "
+            << SummarizeNodeDef(batch_matmul);
+    for (int id : pattern.nodes) nodes_to_delete[id] = true;
+
+    NodeDef fused_op;
+    fused_op.set_name(batch_matmul.name());
+    fused_op.set_op("DinAttention");
+    fused_op.set_device(batch_matmul.device());
+    fused_op.add_input(pattern.query);
+    fused_op.add_input(pattern.facts);
+    fused_op.add_input(pattern.mask);
+    for (const string& input : pattern.weights) fused_op.add_input(input);
+    for (const string& input : batch_matmul.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["padding_value"].set_f(pattern.padding_value);
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  if (fused_nodes.empty()) return Status::OK();
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  VLOG(3) << "After DIN attention fusion rewrites: " << output->DebugString();
+
+  return Status::OK();
+}
+
+void DinAttentionFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                  const GraphDef& optimize_output,
+                                  double result) {
+  // Nothing to do for DinAttentionFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,47 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DIN_ATTENTION_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DIN_ATTENTION_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Rewrites the DIN local activation unit, as built by `_attention` of
+// modelzoo/din and modelzoo/dien, into a DinAttention op:
+//
+//   queries = Reshape(Tile(query, [1, T]), Shape(facts))
+//   din_all = ConcatV2(queries, facts, queries - facts, queries * facts, -1)
+//   layer_1 = Sigmoid(BiasAdd(MatMul(din_all, w1), b1))
+//   layer_2 = Sigmoid(BiasAdd(MatMul(layer_1, w2), b2))
+//   scores  = Reshape(BiasAdd(MatMul(layer_2, w3), b3), [B, 1, T])
+//   scores  = Select(mask, scores, OnesLike(scores) * padding_value)
+//   output  = BatchMatMul(Softmax(scores), facts)
+//
+// Reshapes, identities and identity transposes between the layers, e.g. of
+// tf.layers.dense on 3-D inputs, are skipped. The intermediate tensors must
+// not be used elsewhere, so training graphs, which use them for gradients,
+// are left unchanged. They can call tf.nn.din_attention directly.
+class DinAttentionFusion : public GraphOptimizer {
+ public:
+  DinAttentionFusion() = default;
+  explicit DinAttentionFusion(RewriterConfig::Toggle opt_level) {}
+  ~DinAttentionFusion() override {}
+
+  string name() const override { return "din_attention_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DIN_ATTENTION_FUSION_H_
@@ -0,0 +1,135 @@
+#include "tensorflow/core/grappler/optimizers/din_attention_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class DinAttentionFusionTest : public GrapplerTest {
+ protected:
+  static Tensor Random(const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return t;
+  }
+
+  // The graph of modelzoo/din _attention with batch 2, sequence length 4
+  // and dimension 3, and the inputs of the fused op.
+  void BuildGraph(GraphDef* graph, std::vector<NodeDef>* inputs) {
+    using test::function::NDef;
+    const Tensor mask = test::AsTensor<bool>(
+        {true, true, true, false, true, false, false, false}, {2, 1, 4});
+    *inputs = {
+        NDef("query", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 3})}}),
+        NDef("facts", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 4, 3})}}),
+        NDef("mask", "Const", {}, {{"dtype", DT_BOOL}, {"value", mask}}),
+        NDef("w1", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({12, 5})}}),
+        NDef("b1", "Const", {}, {{"dtype", DT_FLOAT}, {"value", Random({5})}}),
+        NDef("w2", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({5, 2})}}),
+        NDef("b2", "Const", {}, {{"dtype", DT_FLOAT}, {"value", Random({2})}}),
+        NDef("w3", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 1})}}),
+        NDef("b3", "Const", {}, {{"dtype", DT_FLOAT}, {"value", Random({1})}}),
+    };
+    const Tensor multiples = test::AsTensor<int32>({1, 4});
+    const Tensor axis = test::AsScalar<int32>(-1);
+    const Tensor shape_2d = test::AsTensor<int32>({-1, 12});
+    const Tensor scores_shape = test::AsTensor<int32>({-1, 1, 4});
+    const Tensor padding = test::AsScalar<float>(-4294967295.0f);
+
+    *graph = test::function::GDef({
+        NDef("multiples", "Const", {},
+             {{"dtype", DT_INT32}, {"value", multiples}}),
+        NDef("facts_shape", "Shape", {"facts"},
+             {{"T", DT_FLOAT}, {"out_type", DT_INT32}}),
+        NDef("tile", "Tile", {"query", "multiples"},
+             {{"T", DT_FLOAT}, {"Tmultiples", DT_INT32}}),
+        NDef("queries", "Reshape", {"tile", "facts_shape"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+        NDef("sub", "Sub", {"queries", "facts"}, {{"T", DT_FLOAT}}),
+        NDef("mul", "Mul", {"queries", "facts"}, {{"T", DT_FLOAT}}),
+        NDef("axis", "Const", {}, {{"dtype", DT_INT32}, {"value", axis}}),
+        NDef("din_all", "ConcatV2", {"queries", "facts", "sub", "mul", "axis"},
+             {{"T", DT_FLOAT}, {"N", 4}, {"Tidx", DT_INT32}}),
+        NDef("shape_2d", "Const", {},
+             {{"dtype", DT_INT32}, {"value", shape_2d}}),
+        NDef("din_all_2d", "Reshape", {"din_all", "shape_2d"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+        NDef("matmul_1", "MatMul", {"din_all_2d", "w1"}, {{"T", DT_FLOAT}}),
+        NDef("bias_1", "BiasAdd", {"matmul_1", "b1"}, {{"T", DT_FLOAT}}),
+        NDef("layer_1", "Sigmoid", {"bias_1"}, {{"T", DT_FLOAT}}),
+        NDef("matmul_2", "MatMul", {"layer_1", "w2"}, {{"T", DT_FLOAT}}),
+        NDef("bias_2", "BiasAdd", {"matmul_2", "b2"}, {{"T", DT_FLOAT}}),
+        NDef("layer_2", "Sigmoid", {"bias_2"}, {{"T", DT_FLOAT}}),
+        NDef("matmul_3", "MatMul", {"layer_2", "w3"}, {{"T", DT_FLOAT}}),
+        NDef("bias_3", "BiasAdd", {"matmul_3", "b3"}, {{"T", DT_FLOAT}}),
+        NDef("scores_shape", "Const", {},
+             {{"dtype", DT_INT32}, {"value", scores_shape}}),
+        NDef("scores", "Reshape", {"bias_3", "scores_shape"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+        NDef("ones", "OnesLike", {"scores"}, {{"T", DT_FLOAT}}),
+        NDef("padding", "Const", {}, {{"dtype", DT_FLOAT}, {"value", padding}}),
+        NDef("paddings", "Mul", {"ones", "padding"}, {{"T", DT_FLOAT}}),
+        NDef("masked", "Select", {"mask", "scores", "paddings"},
+             {{"T", DT_FLOAT}}),
+        NDef("softmax", "Softmax", {"masked"}, {{"T", DT_FLOAT}}),
+        NDef("output", "BatchMatMul", {"softmax", "facts"}, {{"T", DT_FLOAT}}),
+    });
+    for (const NodeDef& input : *inputs) *graph->add_node() = input;
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+};
+
+TEST_F(DinAttentionFusionTest, FusesAttention) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph(&item.graph, &inputs);
+  item.fetch = {"output"};
+
+  DinAttentionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  GraphDef expected;
+  for (NodeDef input : inputs) {
+    input.set_device("/device:CPU:0");
+    *expected.add_node() = input;
+  }
+  *expected.add_node() = test::function::NDef(
+      "output", "DinAttention",
+      {"query", "facts", "mask", "w1", "b1", "w2", "b2", "w3", "b3"},
+      {{"T", DT_FLOAT}, {"padding_value", -4294967295.0f}}, "/device:CPU:0");
+  CompareGraphs(expected, output);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(DinAttentionFusionTest, KeepsUsedIntermediates) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph(&item.graph, &inputs);
+  // E.g. used by the gradients of a training graph.
+  item.fetch = {"output", "layer_2"};
+
+  DinAttentionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
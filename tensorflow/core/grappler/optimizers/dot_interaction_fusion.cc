@@ -0,0 +1,382 @@
+#include "tensorflow/core/grappler/optimizers/dot_interaction_fusion.h"
+
+#include <functional>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace dotinteractionfusion {
+
+struct DotInteractionPattern {
+  int gather_id = -1;
+  // Nodes replaced by the fused op.
+  std::vector<int> nodes;
+  string features;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+bool GetIntValues(const NodeDef& node, std::vector<int64>* values) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor)) return false;
+  values->clear();
+  if (tensor.dtype() == DT_INT32) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int32>()(i));
+    }
+  } else if (tensor.dtype() == DT_INT64) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int64>()(i));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Returns whether the node is a float constant of ones.
+bool IsOnes(const NodeDef& node) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor) || tensor.dtype() != DT_FLOAT) {
+    return false;
+  }
+  for (int64 i = 0; i < tensor.NumElements(); ++i) {
+    if (tensor.flat<float>()(i) != 1.0f) return false;
+  }
+  return true;
+}
+
+class DotInteractionMatcher {
+ public:
+  explicit DotInteractionMatcher(const utils::MutableGraphView& graph_view)
+      : graph_view_(graph_view) {}
+
+  bool Match(int node_index, DotInteractionPattern* matched) {
+    DotInteractionPattern pattern;
+    const NodeDef* gather = Node(node_index);
+    std::vector<int64> axis;
+    if (!IsGather(*gather) || gather->op() != "GatherV2" ||
+        !NodeIsOnCpu(gather) || !IsType(*gather, "Tparams", DT_FLOAT) ||
+        !GetIntInput(node_index, 2, &axis) || axis.size() != 1 ||
+        axis[0] != 0 || !OnlyReshaped(node_index)) {
+      return false;
+    }
+    pattern.gather_id = node_index;
+
+    // GatherV2(Reshape(products), indices, 0)
+    const int params = Fanin(node_index, 0);
+    if (!IsOp(params, IsReshape, &pattern)) return false;
+    const int products = Fanin(params, 0);
+    if (!IsOp(products, IsAnyBatchMatMul, &pattern)) return false;
+    const NodeDef* products_node = Node(products);
+    if (!IsType(*products_node, "T", DT_FLOAT) ||
+        GetBoolAttr(*products_node, "adj_x") ||
+        !GetBoolAttr(*products_node, "adj_y") ||
+        products_node->input_size() < 2 ||
+        ParseTensorName(products_node->input(0)) !=
+            ParseTensorName(products_node->input(1))) {
+      return false;
+    }
+    pattern.features = products_node->input(0);
+
+    // Squeeze(Where(Reshape(Cast(ones - MatrixBandPart(ones, 0, -1)))), [1])
+    const int squeeze = Fanin(node_index, 1);
+    if (!IsOp(squeeze, IsSqueeze, &pattern)) return false;
+    auto it = Node(squeeze)->attr().find("squeeze_dims");
+    if (it == Node(squeeze)->attr().end() || it->second.list().i_size() != 1 ||
+        it->second.list().i(0) != 1) {
+      return false;
+    }
+    const int where = Fanin(squeeze, 0);
+    if (!IsOp(where, IsWhere, &pattern)) return false;
+    const int flat_mask = Fanin(where, 0);
+    std::vector<int64> shape;
+    if (!IsOp(flat_mask, IsReshape, &pattern) ||
+        !GetIntInput(flat_mask, 1, &shape) || shape.size() != 1 ||
+        shape[0] != -1) {
+      return false;
+    }
+    const int cast = Fanin(flat_mask, 0);
+    if (!IsOp(cast, IsCast, &pattern) ||
+        !IsType(*Node(cast), "DstT", DT_BOOL)) {
+      return false;
+    }
+    const int sub = Fanin(cast, 0);
+    if (!IsOp(sub, IsSub, &pattern)) return false;
+    const int ones = Fanin(sub, 0);
+    const int band_part = Fanin(sub, 1);
+    std::vector<int64> num_lower;
+    std::vector<int64> num_upper;
+    if (!IsOp(band_part, IsMatrixBandPart, &pattern) ||
+        Fanin(band_part, 0) != ones || !GetIntInput(band_part, 1, &num_lower) ||
+        !GetIntInput(band_part, 2, &num_upper) || num_lower.size() != 1 ||
+        num_upper.size() != 1 || num_lower[0] != 0 || num_upper[0] != -1) {
+      return false;
+    }
+    if (!MatchOnesLike(ones, products, &pattern)) return false;
+
+    *matched = std::move(pattern);
+    return true;
+  }
+
+ private:
+  static bool IsAnyBatchMatMul(const NodeDef& node) {
+    return node.op() == "BatchMatMul" || node.op() == "BatchMatMulV2";
+  }
+
+  static bool IsWhere(const NodeDef& node) { return node.op() == "Where"; }
+
+  static bool IsMatrixBandPart(const NodeDef& node) {
+    return node.op() == "MatrixBandPart";
+  }
+
+  static bool IsType(const NodeDef& node, const string& attr, DataType type) {
+    auto it = node.attr().find(attr);
+    return it != node.attr().end() && it->second.type() == type;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    return fanin.index() == 0 ? fanin.node_index() : -1;
+  }
+
+  // Adds the node to the pattern if `func` matches it.
+  bool IsOp(int node_index, bool (*func)(const NodeDef& node),
+            DotInteractionPattern* pattern) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    if (!func(*node) || !NodeIsOnCpu(node)) return false;
+    pattern->nodes.push_back(node_index);
+    return true;
+  }
+
+  // Returns the values of constant input `i`.
+  bool GetIntInput(int node_index, int i, std::vector<int64>* values) const {
+    const int input = Fanin(node_index, i);
+    return input >= 0 && GetIntValues(*Node(input), values);
+  }
+
+  // The fused op outputs [B, F * (F - 1) / 2] instead of the flat pairs, so
+  // the gather may only be reshaped.
+  bool OnlyReshaped(int node_index) const {
+    for (const auto& fanouts :
+         graph_view_.GetNode(node_index)->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        if (!IsReshape(*fanout.node_view()->node()) || fanout.index() != 0) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // OnesLike(products), Fill(Shape(products), 1) or, once folded, a
+  // constant of ones.
+  bool MatchOnesLike(int node_index, int products,
+                     DotInteractionPattern* pattern) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    if (node->op() == "OnesLike") {
+      return Fanin(node_index, 0) == products &&
+             IsOp(node_index, IsOnesLike, pattern);
+    }
+    if (IsFill(*node)) {
+      const int shape = Fanin(node_index, 0);
+      const int value = Fanin(node_index, 1);
+      return shape >= 0 && IsShape(*Node(shape)) &&
+             Fanin(shape, 0) == products && value >= 0 &&
+             IsOnes(*Node(value)) && IsOp(node_index, IsFill, pattern) &&
+             IsOp(shape, IsShape, pattern);
+    }
+    return IsOnes(*node) && IsOp(node_index, IsConstant, pattern);
+  }
+
+  static bool IsOnesLike(const NodeDef& node) {
+    return node.op() == "OnesLike";
+  }
+
+  const utils::MutableGraphView& graph_view_;
+};
+
+// Adds to the pattern the nodes that only compute values for it, e.g. the
+// shapes of the reshapes, and returns false if another node uses one of its
+// intermediate tensors.
+bool CollectRemovableNodes(const utils::MutableGraphView& graph_view,
+                           const std::unordered_set<string>& nodes_to_preserve,
+                           DotInteractionPattern* pattern) {
+  // The gather output changes shape, so it must only feed the reshape.
+  const NodeDef* gather = graph_view.GetNode(pattern->gather_id)->node();
+  if (nodes_to_preserve.count(gather->name()) > 0) return false;
+  std::unordered_set<int> removed(pattern->nodes.begin(), pattern->nodes.end());
+  const string features(ParseTensorName(pattern->features).node());
+
+  auto can_remove = [&](int index) {
+    const auto* node_view = graph_view.GetNode(index);
+    const NodeDef* node = node_view->node();
+    return index != pattern->gather_id &&
+           nodes_to_preserve.count(node->name()) == 0 &&
+           node->name() != features && IsFreeOfSideEffect(*node) &&
+           node_view->NumControllingFanins() == 0 &&
+           node_view->NumControlledFanouts() == 0;
+  };
+  for (int index : removed) {
+    if (!can_remove(index)) return false;
+  }
+
+  // Consumers of the intermediate tensors, which may only feed the pattern,
+  // e.g. the Shape of the products computing the shape of the reshape.
+  std::function<bool(int, std::unordered_set<int>*)> only_feeds_pattern =
+      [&](int index, std::unordered_set<int>* visited) {
+        if (removed.count(index) > 0) return true;
+        if (!visited->insert(index).second || !can_remove(index)) {
+          return false;
+        }
+        for (const auto& fanouts :
+             graph_view.GetNode(index)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            if (!only_feeds_pattern(fanout.node_index(), visited)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      };
+  std::vector<int> pending(removed.begin(), removed.end());
+  for (int index : pending) {
+    for (const auto& fanouts : graph_view.GetNode(index)->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        const int consumer = fanout.node_index();
+        if (consumer == pattern->gather_id) continue;
+        std::unordered_set<int> visited;
+        if (!only_feeds_pattern(consumer, &visited)) return false;
+        removed.insert(visited.begin(), visited.end());
+      }
+    }
+  }
+
+  // Producers that are only used by removed nodes, e.g. Const.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    pending.assign(removed.begin(), removed.end());
+    for (int index : pending) {
+      for (const auto& fanin : graph_view.GetNode(index)->GetRegularFanins()) {
+        const int producer = fanin.node_index();
+        if (removed.count(producer) > 0 || !can_remove(producer)) continue;
+        bool used = false;
+        for (const auto& fanouts :
+             graph_view.GetNode(producer)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            used |= removed.count(fanout.node_index()) == 0;
+          }
+        }
+        if (!used) {
+          removed.insert(producer);
+          changed = true;
+        }
+      }
+    }
+  }
+  pattern->nodes.assign(removed.begin(), removed.end());
+  return true;
+}
+
+}  // namespace dotinteractionfusion
+
+Status DotInteractionFusion::Optimize(Cluster* cluster,
+                                      const GrapplerItem& item,
+                                      GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = item.graph.node_size();
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  // Nodes of a fused pattern, which can't be part of another one.
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  const GraphDef* graph = graph_view.graph();
+
+  VLOG(3) << "Before dot interaction fusion rewrites: "
+          << graph->DebugString();
+
+  dotinteractionfusion::DotInteractionMatcher matcher(graph_view);
+  for (int i = 0; i < num_nodes; ++i) {
+    dotinteractionfusion::DotInteractionPattern pattern;
+    if (nodes_to_delete[i] || !matcher.Match(i, &pattern) ||
+        !dotinteractionfusion::CollectRemovableNodes(
+            graph_view, nodes_to_preserve, &pattern)) {
+      continue;
+    }
+    bool overlaps = false;
+    for (int id : pattern.nodes) overlaps |= nodes_to_delete[id];
+    if (overlaps) continue;
+
+    const NodeDef& gather = graph->node(i);
+    VLOG(2) << "Optimizing fused dot interaction node "
+            << SummarizeNodeDef(gather);
+    for (int id : pattern.nodes) nodes_to_delete[id] = true;
+
+    NodeDef fused_op;
+    fused_op.set_name(gather.name());
+    fused_op.set_op("DotInteraction");
+    fused_op.set_device(gather.device());
+    fused_op.add_input(pattern.features);
+    for (const string& input : gather.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["num_dense"].set_i(0);
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  if (fused_nodes.empty()) return Status::OK();
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  VLOG(3) << "After dot interaction fusion rewrites: " << output->DebugString();
+
+  return Status::OK();
+}
+
+void DotInteractionFusion::Feedback(Cluster* cluster, const GrapplerItem& item,
+                                    const GraphDef& optimize_output,
+                                    double result) {
+  // Nothing to do for DotInteractionFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,45 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DOT_INTERACTION_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DOT_INTERACTION_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Rewrites the DLRM dot interaction, as built by _dot_op of modelzoo/dlrm,
+// into a DotInteraction op:
+//
+//   products = BatchMatMul(features, features, adj_y=true)
+//   ones     = OnesLike(products)  // or Fill(Shape(products), 1)
+//   lower    = Cast(ones - MatrixBandPart(ones, 0, -1), bool)
+//   indices  = Squeeze(Where(Reshape(lower, [-1])), [1])
+//   pairs    = GatherV2(Reshape(products, ...), indices, 0)
+//
+// The fused op replaces the gather, whose [B * F * (F - 1) / 2] output is
+// reshaped by the following nodes as before. As for DinAttentionFusion,
+// the intermediate tensors must not be used elsewhere, so training graphs
+// are left unchanged. They can call tf.nn.dot_interaction directly.
+class DotInteractionFusion : public GraphOptimizer {
+ public:
+  DotInteractionFusion() = default;
+  explicit DotInteractionFusion(RewriterConfig::Toggle opt_level) {}
+  ~DotInteractionFusion() override {}
+
+  string name() const override { return "dot_interaction_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DOT_INTERACTION_FUSION_H_
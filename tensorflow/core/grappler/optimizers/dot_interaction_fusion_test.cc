@@ -0,0 +1,124 @@
+#include "tensorflow/core/grappler/optimizers/dot_interaction_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class DotInteractionFusionTest : public GrapplerTest {
+ protected:
+  // The graph of modelzoo/dlrm _dot_op with batch 2, 4 features of
+  // dimension 3, and the features.
+  void BuildGraph(GraphDef* graph, NodeDef* features) {
+    using test::function::NDef;
+    Tensor value(DT_FLOAT, {2, 4, 3});
+    value.flat<float>().setRandom();
+    *features = NDef("features", "Const", {},
+                     {{"dtype", DT_FLOAT}, {"value", value}});
+    const Tensor flat_shape = test::AsTensor<int32>({-1});
+    const Tensor axis = test::AsScalar<int32>(0);
+    const Tensor output_shape = test::AsTensor<int32>({2, 6});
+
+    *graph = test::function::GDef({
+        NDef("products", "BatchMatMul", {"features", "features"},
+             {{"T", DT_FLOAT}, {"adj_x", false}, {"adj_y", true}}),
+        NDef("ones", "OnesLike", {"products"}, {{"T", DT_FLOAT}}),
+        NDef("num_lower", "Const", {},
+             {{"dtype", DT_INT64}, {"value", test::AsScalar<int64>(0)}}),
+        NDef("num_upper", "Const", {},
+             {{"dtype", DT_INT64}, {"value", test::AsScalar<int64>(-1)}}),
+        NDef("upper", "MatrixBandPart", {"ones", "num_lower", "num_upper"},
+             {{"T", DT_FLOAT}, {"Tindex", DT_INT64}}),
+        NDef("lower", "Sub", {"ones", "upper"}, {{"T", DT_FLOAT}}),
+        NDef("mask", "Cast", {"lower"},
+             {{"SrcT", DT_FLOAT}, {"DstT", DT_BOOL}}),
+        NDef("flat_shape", "Const", {},
+             {{"dtype", DT_INT32}, {"value", flat_shape}}),
+        NDef("flat_mask", "Reshape", {"mask", "flat_shape"},
+             {{"T", DT_BOOL}, {"Tshape", DT_INT32}}),
+        NDef("where", "Where", {"flat_mask"}, {{"T", DT_BOOL}}),
+        NDef("indices", "Squeeze", {"where"},
+             {{"T", DT_INT64}, {"squeeze_dims", gtl::ArraySlice<int>({1})}}),
+        NDef("flat_products", "Reshape", {"products", "flat_shape"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+        NDef("axis", "Const", {}, {{"dtype", DT_INT32}, {"value", axis}}),
+        NDef("pairs", "GatherV2", {"flat_products", "indices", "axis"},
+             {{"Tparams", DT_FLOAT},
+              {"Tindices", DT_INT64},
+              {"Taxis", DT_INT32},
+              {"batch_dims", 0}}),
+        NDef("output_shape", "Const", {},
+             {{"dtype", DT_INT32}, {"value", output_shape}}),
+        NDef("output", "Reshape", {"pairs", "output_shape"},
+             {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}),
+    });
+    *graph->add_node() = *features;
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+};
+
+TEST_F(DotInteractionFusionTest, FusesInteraction) {
+  GrapplerItem item;
+  NodeDef features;
+  BuildGraph(&item.graph, &features);
+  item.fetch = {"output"};
+
+  DotInteractionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  using test::function::NDef;
+  features.set_device("/device:CPU:0");
+  GraphDef expected = test::function::GDef({
+      NDef("output_shape", "Const", {},
+           {{"dtype", DT_INT32}, {"value", test::AsTensor<int32>({2, 6})}},
+           "/device:CPU:0"),
+      NDef("output", "Reshape", {"pairs", "output_shape"},
+           {{"T", DT_FLOAT}, {"Tshape", DT_INT32}}, "/device:CPU:0"),
+      features,
+      NDef("pairs", "DotInteraction", {"features"},
+           {{"T", DT_FLOAT}, {"num_dense", 0}}, "/device:CPU:0"),
+  });
+  CompareGraphs(expected, output);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(DotInteractionFusionTest, KeepsUsedIntermediates) {
+  GrapplerItem item;
+  NodeDef features;
+  BuildGraph(&item.graph, &features);
+  // E.g. used by the gradients of a training graph.
+  item.fetch = {"output", "products"};
+
+  DotInteractionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(DotInteractionFusionTest, KeepsFetchedPairs) {
+  GrapplerItem item;
+  NodeDef features;
+  BuildGraph(&item.graph, &features);
+  // The fused op outputs [B, F * (F - 1) / 2] rather than the flat pairs.
+  item.fetch = {"pairs"};
+
+  DotInteractionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -42,6 +42,12 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/concat_cast_fusing.h"
 #include "tensorflow/core/grappler/optimizers/multi_stream_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/dice_fusion.h"
+#include "tensorflow/core/grappler/optimizers/din_attention_fusion.h"
+#include "tensorflow/core/grappler/optimizers/multi_head_attention_fusion.h"
+#include "tensorflow/core/grappler/optimizers/dot_interaction_fusion.h"
+#include "tensorflow/core/grappler/optimizers/cross_network_fusion.h"
+#include "tensorflow/core/grappler/optimizers/mixture_of_experts_fusion.h"
+#include "tensorflow/core/grappler/optimizers/concat_matmul_fusion.h"
 #include "tensorflow/core/grappler/optimizers/scoped_allocator_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/shape_optimizer.h"
 #include "tensorflow/core/grappler/utils/canonicalizer.h"
@@ -179,11 +185,13 @@ bool MemoryOptimizerEnabled(
   return mem_opt_type != RewriterConfig::NO_MEM_OPT;
 }
 
-// A helper function to decide whether to enable the dice fusion optimizer.
-bool DiceFusionEnabled() {
+// A helper function to decide whether to enable a fusion optimizer that is
+// switched by `env_var`, default on. Like the dice fusion, they only run
+// with INFERENCE_MODE, which the serving processor sets.
+bool InferenceFusionEnabled(const char* env_var) {
   bool is_enabled = true;
   bool is_inference = false;
-  TF_CHECK_OK(ReadBoolFromEnvVar("TF_DICE_FUSION", true, &is_enabled));
+  TF_CHECK_OK(ReadBoolFromEnvVar(env_var, true, &is_enabled));
   TF_CHECK_OK(ReadBoolFromEnvVar("INFERENCE_MODE", false, &is_inference));
   return is_enabled && is_inference;
 }
@@ -224,6 +232,12 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
   MK_OPT("pin_to_host",
          new PinToHostOptimizer(cfg_.pin_to_host_optimization()));
   MK_OPT("dice_fusion", new DiceFusion());
+  MK_OPT("din_attention_fusion", new DinAttentionFusion());
+  MK_OPT("multi_head_attention_fusion", new MultiHeadAttentionFusion());
+  MK_OPT("dot_interaction_fusion", new DotInteractionFusion());
+  MK_OPT("cross_network_fusion", new CrossNetworkFusion());
+  MK_OPT("mixture_of_experts_fusion", new MixtureOfExpertsFusion());
+  MK_OPT("concat_matmul_fusion", new ConcatMatMulFusion());
   MK_OPT("concat_cast_fusing", new ConcatCastFusing());
   MK_OPT("use_multi_stream",
          new MultiStreamOptimizer(cfg_.multi_stream_opts()));
@@ -322,9 +336,27 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->push_back(MakeUnique<ScopedAllocatorOptimizer>(
         cfg_.scoped_allocator_optimization(), cfg_.scoped_allocator_opts()));
   }
-  if (DiceFusionEnabled()) {
+  if (InferenceFusionEnabled("TF_DICE_FUSION")) {
     optimizers->push_back(MakeUnique<DiceFusion>());
   }
+  if (InferenceFusionEnabled("TF_DIN_ATTENTION_FUSION")) {
+    optimizers->push_back(MakeUnique<DinAttentionFusion>());
+  }
+  if (InferenceFusionEnabled("TF_MULTI_HEAD_ATTENTION_FUSION")) {
+    optimizers->push_back(MakeUnique<MultiHeadAttentionFusion>());
+  }
+  if (InferenceFusionEnabled("TF_DOT_INTERACTION_FUSION")) {
+    optimizers->push_back(MakeUnique<DotInteractionFusion>());
+  }
+  if (InferenceFusionEnabled("TF_CROSS_NETWORK_FUSION")) {
+    optimizers->push_back(MakeUnique<CrossNetworkFusion>());
+  }
+  if (InferenceFusionEnabled("TF_MIXTURE_OF_EXPERTS_FUSION")) {
+    optimizers->push_back(MakeUnique<MixtureOfExpertsFusion>());
+  }
+  if (InferenceFusionEnabled("TF_CONCAT_MATMUL_FUSION")) {
+    optimizers->push_back(MakeUnique<ConcatMatMulFusion>());
+  }
   optimizers->push_back(MakeUnique<ConcatCastFusing>());
   return InitializeCustomGraphOptimizers(std::set<string>(), optimizers);
 }
@@ -0,0 +1,727 @@
+#include "tensorflow/core/grappler/optimizers/mixture_of_experts_fusion.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/frame.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace mixtureofexpertsfusion {
+
+struct CombinePattern {
+  int output_id = -1;
+  // Nodes replaced by the fused op. The Pack of the experts is removed
+  // separately, as it is usually shared by the towers.
+  std::vector<int> nodes;
+  int pack = -1;
+  bool softmax = false;
+  string gate;
+};
+
+struct DensePattern {
+  int output_id = -1;
+  // Nodes replaced by the fused op, including the output.
+  std::vector<int> nodes;
+  bool relu = false;
+  string x;
+  string kernel;
+  string bias;
+  // The rows of x, the shape of the kernel, and the number of dense layers
+  // on the longest path from the graph inputs to the output.
+  int64 batch = -1;
+  int64 rows = -1;
+  int64 units = -1;
+  int64 depth = 0;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+bool GetIntValues(const NodeDef& node, std::vector<int64>* values) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor)) return false;
+  values->clear();
+  if (tensor.dtype() == DT_INT32) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int32>()(i));
+    }
+  } else if (tensor.dtype() == DT_INT64) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int64>()(i));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool IsExpandDims(const NodeDef& node) { return node.op() == "ExpandDims"; }
+
+class MixtureOfExpertsMatcher {
+ public:
+  MixtureOfExpertsMatcher(const utils::MutableGraphView& graph_view,
+                          const std::unordered_set<string>& nodes_to_preserve)
+      : graph_view_(graph_view), nodes_to_preserve_(nodes_to_preserve) {}
+
+  // Sum(Mul(Pack(experts, axis=1), ExpandDims(gate, -1)), 1), where gate is
+  // Softmax(logits) with `softmax`.
+  bool MatchCombine(int node_index, bool softmax,
+                    CombinePattern* pattern) const {
+    if (!IsOp(node_index, IsSum) ||
+        GetBoolAttr(*Node(node_index), "keep_dims") ||
+        !IsAxis(node_index, 1, {1, -2})) {
+      return false;
+    }
+    const int mul = Fanin(node_index, 0);
+    if (!IsOp(mul, IsMul)) return false;
+    for (int i = 0; i < 2; ++i) {
+      const int pack = Fanin(mul, i);
+      const int expand_dims = Fanin(mul, 1 - i);
+      if (!IsOp(pack, IsPack) || !IsOp(expand_dims, IsExpandDims) ||
+          !IsAxis(expand_dims, 1, {-1, 2})) {
+        continue;
+      }
+      const auto& axis = Node(pack)->attr().find("axis");
+      if (axis == Node(pack)->attr().end() ||
+          (axis->second.i() != 1 && axis->second.i() != -2)) {
+        return false;
+      }
+      pattern->output_id = node_index;
+      pattern->pack = pack;
+      pattern->softmax = softmax;
+      pattern->nodes = {mul, expand_dims};
+      pattern->gate = Node(expand_dims)->input(0);
+      if (softmax) {
+        const int gate = Fanin(expand_dims, 0);
+        if (!IsOp(gate, IsSoftmax)) return false;
+        pattern->nodes.push_back(gate);
+        pattern->gate = Node(gate)->input(0);
+      }
+      std::vector<string> kept = {pattern->gate};
+      for (const string& input : Node(pack)->input()) kept.push_back(input);
+      return CollectRemovableNodes(node_index, kept, &pattern->nodes);
+    }
+    return false;
+  }
+
+  // [Relu](BiasAdd(MatMul(x, kernel), bias)), as tf.layers.dense, or the
+  // _FusedMatMul the remapper rewrites it to on CPU.
+  bool MatchDense(int node_index, DensePattern* pattern) const {
+    int bias_add = node_index;
+    if (IsOp(node_index, IsRelu)) {
+      pattern->relu = true;
+      bias_add = Fanin(node_index, 0);
+    } else if (FeedsRelu(node_index)) {
+      // Matched with the Relu.
+      return false;
+    }
+    pattern->nodes = {};
+    if (pattern->relu) pattern->nodes.push_back(node_index);
+    int matmul = -1;
+    std::vector<string> fused_ops;
+    if (IsOp(bias_add, IsFusedMatMul) &&
+        GetFusedOps(*Node(bias_add), &fused_ops) && !fused_ops.empty() &&
+        fused_ops.size() <= (pattern->relu ? 1 : 2) &&
+        fused_ops[0] == "BiasAdd" &&
+        (fused_ops.size() == 1 || fused_ops[1] == "Relu")) {
+      pattern->relu |= fused_ops.size() == 2;
+      matmul = bias_add;
+      pattern->bias = Node(bias_add)->input(2);
+    } else if (IsOp(bias_add, IsBiasAdd)) {
+      const auto& data_format = Node(bias_add)->attr().find("data_format");
+      if (data_format != Node(bias_add)->attr().end() &&
+          data_format->second.s() != "NHWC") {
+        return false;
+      }
+      matmul = Fanin(bias_add, 0);
+      if (!IsOp(matmul, IsMatMul)) return false;
+      pattern->bias = Node(bias_add)->input(1);
+      pattern->nodes.push_back(matmul);
+    } else {
+      return false;
+    }
+    if (GetBoolAttr(*Node(matmul), "transpose_a") ||
+        GetBoolAttr(*Node(matmul), "transpose_b")) {
+      return false;
+    }
+    pattern->output_id = node_index;
+    pattern->x = Node(matmul)->input(0);
+    pattern->kernel = Node(matmul)->input(1);
+    pattern->nodes.push_back(bias_add);
+
+    // The output is replaced too, its consumers are moved to the fused op.
+    return CanRemove(node_index, /*output=*/true) &&
+           CollectRemovableNodes(node_index,
+                                 {pattern->x, pattern->kernel, pattern->bias},
+                                 &pattern->nodes);
+  }
+
+ private:
+  static bool IsFloat(const NodeDef& node) {
+    auto it = node.attr().find("T");
+    return it != node.attr().end() && it->second.type() == DT_FLOAT;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  static bool IsFusedMatMul(const NodeDef& node) {
+    return node.op() == "_FusedMatMul";
+  }
+
+  static bool GetFusedOps(const NodeDef& node, std::vector<string>* ops) {
+    auto it = node.attr().find("fused_ops");
+    if (it == node.attr().end()) return false;
+    ops->assign(it->second.list().s().begin(), it->second.list().s().end());
+    return true;
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    return fanin.index() == 0 ? fanin.node_index() : -1;
+  }
+
+  bool IsOp(int node_index, bool (*func)(const NodeDef& node)) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    return func(*node) && IsFloat(*node) && NodeIsOnCpu(node);
+  }
+
+  // Returns whether constant input `i` is a scalar or vector of one value
+  // in `values`.
+  bool IsAxis(int node_index, int i,
+              std::initializer_list<int64> values) const {
+    const int input = Fanin(node_index, i);
+    std::vector<int64> axis;
+    if (input < 0 || !GetIntValues(*Node(input), &axis) || axis.size() != 1) {
+      return false;
+    }
+    return std::find(values.begin(), values.end(), axis[0]) != values.end();
+  }
+
+  bool FeedsRelu(int node_index) const {
+    const auto& fanouts = graph_view_.GetNode(node_index)->GetRegularFanout(0);
+    return fanouts.size() == 1 && IsOp(fanouts[0].node_index(), IsRelu);
+  }
+
+  // Whether the node can be removed, which for the `output` of a pattern
+  // does not depend on its control inputs.
+  bool CanRemove(int node_index, bool output = false) const {
+    const auto* node_view = graph_view_.GetNode(node_index);
+    const NodeDef* node = node_view->node();
+    return nodes_to_preserve_.count(node->name()) == 0 &&
+           IsFreeOfSideEffect(*node) &&
+           (output || node_view->NumControllingFanins() == 0) &&
+           node_view->NumControlledFanouts() == 0;
+  }
+
+  // Returns false if the nodes of the pattern other than its output are
+  // used by other nodes, and adds the constants only used by the pattern,
+  // e.g. the axes, other than the `kept` inputs of the fused op.
+  bool CollectRemovableNodes(int output_id, const std::vector<string>& kept,
+                             std::vector<int>* nodes) const {
+    std::unordered_set<int> removed(nodes->begin(), nodes->end());
+    removed.insert(output_id);
+    std::unordered_set<string> kept_nodes;
+    for (const string& input : kept) {
+      kept_nodes.insert(string(ParseTensorName(input).node()));
+    }
+    for (int index : *nodes) {
+      if (index == output_id) continue;
+      if (!CanRemove(index)) return false;
+      for (const auto& fanouts :
+           graph_view_.GetNode(index)->GetRegularFanouts()) {
+        for (const auto& fanout : fanouts) {
+          if (removed.count(fanout.node_index()) == 0) return false;
+        }
+      }
+    }
+    for (int index : std::vector<int>(removed.begin(), removed.end())) {
+      for (const auto& fanin :
+           graph_view_.GetNode(index)->GetRegularFanins()) {
+        const int producer = fanin.node_index();
+        if (removed.count(producer) > 0 ||
+            kept_nodes.count(Node(producer)->name()) > 0 ||
+            !IsConstant(*Node(producer)) || !CanRemove(producer)) {
+          continue;
+        }
+        bool used = false;
+        for (const auto& fanouts :
+             graph_view_.GetNode(producer)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            used |= removed.count(fanout.node_index()) == 0;
+          }
+        }
+        if (!used) {
+          removed.insert(producer);
+          nodes->push_back(producer);
+        }
+      }
+    }
+    return true;
+  }
+
+  const utils::MutableGraphView& graph_view_;
+  const std::unordered_set<string>& nodes_to_preserve_;
+};
+
+// Returns the static shape of the tensor, with -1 for unknown dimensions
+// and the same negative value for dimensions known to be equal.
+bool GetShape(const GraphProperties& properties, const string& tensor,
+              std::vector<int64>* dims) {
+  const TensorId id = ParseTensorName(tensor);
+  const string node(id.node());
+  if (!properties.HasOutputProperties(node) || id.index() < 0) return false;
+  const auto& outputs = properties.GetOutputProperties(node);
+  if (id.index() >= outputs.size()) return false;
+  const TensorShapeProto& shape = outputs[id.index()].shape();
+  if (shape.unknown_rank()) return false;
+  dims->clear();
+  for (const auto& dim : shape.dim()) dims->push_back(dim.size());
+  return true;
+}
+
+bool SameDim(int64 a, int64 b) { return a == b && a != -1; }
+
+// The unfused combine broadcasts the gate, while GatedExpertCombine
+// requires a [B, N] gate for N [B, D] experts.
+bool HasValidShapes(const GraphProperties& properties,
+                    const std::vector<string>& experts, const string& gate) {
+  std::vector<int64> expert;
+  std::vector<int64> gate_shape;
+  if (!GetShape(properties, experts[0], &expert) || expert.size() != 2 ||
+      expert[1] < 0 || !GetShape(properties, gate, &gate_shape) ||
+      gate_shape.size() != 2 || gate_shape[1] != experts.size() ||
+      !SameDim(gate_shape[0], expert[0])) {
+    return false;
+  }
+  for (const string& tensor : experts) {
+    std::vector<int64> dims;
+    if (!GetShape(properties, tensor, &dims) || dims.size() != 2 ||
+        !SameDim(dims[0], expert[0]) || dims[1] != expert[1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sets the batch and kernel shape of the dense layer if x, the kernel and
+// the bias have the shapes of a dense layer.
+bool HasValidShapes(const GraphProperties& properties,
+                    DensePattern* pattern) {
+  std::vector<int64> x;
+  std::vector<int64> kernel;
+  std::vector<int64> bias;
+  if (!GetShape(properties, pattern->x, &x) || x.size() != 2 ||
+      !GetShape(properties, pattern->kernel, &kernel) || kernel.size() != 2 ||
+      kernel[0] < 0 || kernel[1] < 0 || x[1] != kernel[0] ||
+      !GetShape(properties, pattern->bias, &bias) ||
+      bias != std::vector<int64>({kernel[1]})) {
+    return false;
+  }
+  pattern->batch = x[0];
+  pattern->rows = kernel[0];
+  pattern->units = kernel[1];
+  return true;
+}
+
+// The number of dense layers on the longest path from the graph inputs to
+// each node. Layers of the same depth do not depend on each other. Nodes
+// that depend on a Switch or Merge, i.e. run in a cond or a while loop, are
+// marked as `conditional`.
+bool ComputeDepths(const utils::MutableGraphView& graph_view,
+                   const std::vector<bool>& is_dense,
+                   std::vector<int64>* depths,
+                   std::vector<bool>* conditional) {
+  std::vector<const NodeDef*> order;
+  if (!ComputeTopologicalOrder(*graph_view.graph(), &order).ok()) return false;
+  depths->assign(graph_view.NumNodes(), 0);
+  conditional->assign(graph_view.NumNodes(), false);
+  for (const NodeDef* node : order) {
+    const auto* node_view = graph_view.GetNode(node->name());
+    int64 depth = 0;
+    bool in_cond = IsSwitch(*node) || IsMerge(*node);
+    for (const auto& fanin : node_view->GetRegularFanins()) {
+      depth = std::max(depth, (*depths)[fanin.node_index()]);
+      in_cond |= (*conditional)[fanin.node_index()];
+    }
+    for (const auto& fanin : node_view->GetControllingFanins()) {
+      depth = std::max(depth, (*depths)[fanin.node_index()]);
+      in_cond |= (*conditional)[fanin.node_index()];
+    }
+    (*depths)[node_view->node_index()] =
+        depth + (is_dense[node_view->node_index()] ? 1 : 0);
+    (*conditional)[node_view->node_index()] = in_cond;
+  }
+  return true;
+}
+
+// Fuses the gated combines of the experts, see MatchCombine.
+Status FuseCombines(const std::unordered_set<string>& nodes_to_preserve,
+                    const std::function<const GraphProperties*()>& properties,
+                    GraphDef* output) {
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = output->node_size();
+  const GraphDef* graph = graph_view.graph();
+
+  MixtureOfExpertsMatcher matcher(graph_view, nodes_to_preserve);
+  std::vector<CombinePattern> patterns;
+  for (int i = 0; i < num_nodes; ++i) {
+    for (const bool softmax : {true, false}) {
+      CombinePattern pattern;
+      if (matcher.MatchCombine(i, softmax, &pattern)) {
+        patterns.push_back(std::move(pattern));
+        break;
+      }
+    }
+  }
+  if (patterns.empty() || properties() == nullptr) return Status::OK();
+
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<bool> fused(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  for (const auto& pattern : patterns) {
+    bool overlaps = nodes_to_delete[pattern.output_id];
+    for (int id : pattern.nodes) overlaps |= nodes_to_delete[id];
+    const NodeDef& pack = graph->node(pattern.pack);
+    std::vector<string> experts;
+    for (const string& input : pack.input()) {
+      if (!IsControlInput(input)) experts.push_back(input);
+    }
+    if (overlaps || !HasValidShapes(*properties(), experts, pattern.gate)) {
+      continue;
+    }
+
+    const NodeDef& sum = graph->node(pattern.output_id);
+    VLOG(2) << "Optimizing fused gated expert combine node "
+            << SummarizeNodeDef(sum);
+    for (int id : pattern.nodes) nodes_to_delete[id] = true;
+    fused[pattern.output_id] = true;
+
+    NodeDef fused_op;
+    fused_op.set_name(sum.name());
+    fused_op.set_op("GatedExpertCombine");
+    fused_op.set_device(sum.device());
+    for (const string& expert : experts) fused_op.add_input(expert);
+    fused_op.add_input(pattern.gate);
+    for (const string& input : sum.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["N"].set_i(experts.size());
+    (*attr)["softmax"].set_b(pattern.softmax);
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  if (fused_nodes.empty()) return Status::OK();
+
+  // The Packs of the experts, once all their consumers are fused.
+  for (const auto& pattern : patterns) {
+    const auto* pack = graph_view.GetNode(pattern.pack);
+    if (nodes_to_delete[pattern.pack] ||
+        nodes_to_preserve.count(pack->GetName()) > 0 ||
+        pack->NumControllingFanins() > 0 || pack->NumControlledFanouts() > 0) {
+      continue;
+    }
+    bool used = false;
+    for (const auto& fanout : pack->GetRegularFanout(0)) {
+      used |= !nodes_to_delete[fanout.node_index()] &&
+              !fused[fanout.node_index()];
+    }
+    if (!used) nodes_to_delete[pattern.pack] = true;
+  }
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+  return Status::OK();
+}
+
+// Groups the sibling dense layers, see MatchDense.
+Status FuseDenseLayers(
+    const std::unordered_set<string>& nodes_to_preserve,
+    const std::function<const GraphProperties*()>& properties,
+    GraphDef* output) {
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = output->node_size();
+  const GraphDef* graph = graph_view.graph();
+
+  MixtureOfExpertsMatcher matcher(graph_view, nodes_to_preserve);
+  std::vector<DensePattern> patterns;
+  std::vector<bool> is_dense(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    DensePattern pattern;
+    if (matcher.MatchDense(i, &pattern)) {
+      is_dense[i] = true;
+      patterns.push_back(std::move(pattern));
+    }
+  }
+  std::vector<int64> depths;
+  std::vector<bool> conditional;
+  FrameView frames;
+  if (patterns.size() < 2 || properties() == nullptr ||
+      !ComputeDepths(graph_view, is_dense, &depths, &conditional) ||
+      !frames.InferFromGraphView(graph_view).ok()) {
+    return Status::OK();
+  }
+
+  // Layers of a group are at the same depth, on the same device and in the
+  // same frame, with the same activation and shapes. Layers in a cond or a
+  // while loop are left alone, as the branches may not run.
+  typedef std::tuple<int64, string, int, bool, int64, int64, int64, string>
+      GroupKey;
+  auto group_key = [&](const DensePattern& pattern, const string& parent) {
+    const NodeDef& node = graph->node(pattern.output_id);
+    const std::vector<int>& node_frames = frames.Frames(node);
+    return GroupKey(pattern.depth, node.device(),
+                    node_frames.empty() ? -1 : node_frames.back(),
+                    pattern.relu, pattern.rows, pattern.units, pattern.batch,
+                    parent);
+  };
+  // Siblings sharing x first, as the first layer of the experts and the
+  // gates.
+  std::map<GroupKey, std::vector<int>> shared;
+  for (int i = 0; i < patterns.size(); ++i) {
+    DensePattern& pattern = patterns[i];
+    if (conditional[pattern.output_id] ||
+        !HasValidShapes(*properties(), &pattern)) {
+      continue;
+    }
+    pattern.depth = depths[pattern.output_id];
+    shared[group_key(pattern, strings::StrCat("x:", pattern.x))].push_back(i);
+  }
+  std::vector<std::vector<int>> groups;
+  // The group of each grouped layer, by output node.
+  std::vector<int> group_of(num_nodes, -1);
+  auto add_group = [&](std::vector<int> group) {
+    for (int i : group) group_of[patterns[i].output_id] = groups.size();
+    groups.push_back(std::move(group));
+  };
+  std::vector<int> remaining;
+  for (auto& group : shared) {
+    if (group.second.size() > 1) {
+      add_group(std::move(group.second));
+    } else if (patterns[group.second[0]].batch != -1) {
+      remaining.push_back(group.second[0]);
+    }
+  }
+
+  // Then the layers of parallel towers of one structure: their x are the
+  // outputs of one group of layers, or gated combines of the same groups
+  // of experts. Returns an empty string for other layers.
+  auto tower_of = [&](const DensePattern& pattern) -> string {
+    const TensorId id = ParseTensorName(pattern.x);
+    const auto* x = graph_view.GetNode(id.node());
+    if (x == nullptr || id.index() != 0) return "";
+    if (group_of[x->node_index()] >= 0) {
+      return strings::StrCat("group:", group_of[x->node_index()]);
+    }
+    if (x->node()->op() != "GatedExpertCombine") return "";
+    std::set<int> expert_groups;
+    // The last input is the gate.
+    for (int i = 0; i + 1 < x->NumRegularFanins(); ++i) {
+      const auto& expert = x->GetRegularFanin(i);
+      const int group = expert.index() == 0
+                            ? group_of[expert.node_index()]
+                            : -1;
+      if (group < 0) return "";
+      expert_groups.insert(group);
+    }
+    string tower = "combine:";
+    for (int group : expert_groups) strings::StrAppend(&tower, group, ",");
+    return tower;
+  };
+  // By depth, so that the towers see the groups of the previous layers.
+  std::stable_sort(remaining.begin(), remaining.end(), [&](int a, int b) {
+    return patterns[a].depth < patterns[b].depth;
+  });
+  for (int begin = 0; begin < remaining.size();) {
+    const int64 depth = patterns[remaining[begin]].depth;
+    std::map<GroupKey, std::vector<int>> parallel;
+    int end = begin;
+    for (; end < remaining.size() && patterns[remaining[end]].depth == depth;
+         ++end) {
+      const DensePattern& pattern = patterns[remaining[end]];
+      const string tower = tower_of(pattern);
+      if (!tower.empty()) {
+        parallel[group_key(pattern, tower)].push_back(remaining[end]);
+      }
+    }
+    for (auto& group : parallel) {
+      if (group.second.size() > 1) add_group(std::move(group.second));
+    }
+    begin = end;
+  }
+  if (groups.empty()) return Status::OK();
+  std::stable_sort(groups.begin(), groups.end(),
+                   [&](const std::vector<int>& a, const std::vector<int>& b) {
+                     return patterns[a[0]].depth < patterns[b[0]].depth;
+                   });
+
+  // The outputs of the grouped layers, by node name, as fused op outputs.
+  std::unordered_map<string, string> renamed;
+  auto rename = [&renamed](const string& input) {
+    const TensorId id = ParseTensorName(input);
+    auto it = renamed.find(string(id.node()));
+    return id.index() == 0 && it != renamed.end() ? it->second : input;
+  };
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  for (const auto& group : groups) {
+    const DensePattern& first = patterns[group[0]];
+    const NodeDef& first_output = graph->node(first.output_id);
+    bool shared_x = true;
+    for (int i : group) shared_x &= patterns[i].x == first.x;
+
+    NodeDef fused_op;
+    string name = strings::StrCat(first_output.name(), "/GroupedDense");
+    while (graph_view.GetNode(name) != nullptr) {
+      name = strings::StrCat(name, "_");
+    }
+    fused_op.set_name(name);
+    fused_op.set_op("GroupedDense");
+    fused_op.set_device(first_output.device());
+    VLOG(2) << "Optimizing grouped dense node " << name << " of "
+            << group.size() << " layers";
+    if (shared_x) {
+      fused_op.add_input(rename(first.x));
+    } else {
+      for (int i : group) fused_op.add_input(rename(patterns[i].x));
+    }
+    for (int i : group) fused_op.add_input(rename(patterns[i].kernel));
+    for (int i : group) fused_op.add_input(rename(patterns[i].bias));
+    std::set<string> control_inputs;
+    for (int i = 0; i < group.size(); ++i) {
+      const DensePattern& pattern = patterns[group[i]];
+      for (int id : pattern.nodes) {
+        nodes_to_delete[id] = true;
+        for (const string& input : graph->node(id).input()) {
+          if (IsControlInput(input)) control_inputs.insert(input);
+        }
+      }
+      renamed[graph->node(pattern.output_id).name()] =
+          strings::StrCat(name, ":", i);
+    }
+    for (const string& input : control_inputs) fused_op.add_input(input);
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["N"].set_i(group.size());
+    (*attr)["num_inputs"].set_i(shared_x ? 1 : group.size());
+    (*attr)["activation"].set_s(first.relu ? "Relu" : "None");
+    fused_nodes.push_back(std::move(fused_op));
+  }
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  // Consumers of the grouped layers, other than the fused ops.
+  for (const auto& layer : renamed) {
+    const auto* node_view = graph_view.GetNode(layer.first);
+    const TensorId fused_output = ParseTensorName(layer.second);
+    for (const auto& fanout : node_view->GetRegularFanout(0)) {
+      if (nodes_to_delete[fanout.node_index()]) continue;
+      mutation->AddOrUpdateRegularFanin(
+          graph_view.GetNode(fanout.node_index()), fanout.index(),
+          fused_output);
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+  return Status::OK();
+}
+
+}  // namespace mixtureofexpertsfusion
+
+Status MixtureOfExpertsFusion::Optimize(Cluster* cluster,
+                                        const GrapplerItem& item,
+                                        GraphDef* output) {
+  *output = item.graph;
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  VLOG(3) << "Before mixture of experts fusion rewrites: "
+          << output->DebugString();
+
+  // Inferred on the input graph, once there is something to fuse. The fused
+  // gated combines keep the names of the Sums they replace, so the shapes of
+  // their outputs remain valid for the dense layers.
+  std::unique_ptr<GraphProperties> properties;
+  bool inferred = false;
+  auto get_properties = [&]() -> const GraphProperties* {
+    if (!inferred) {
+      inferred = true;
+      properties.reset(new GraphProperties(item));
+      const Status status =
+          properties->InferStatically(/*assume_valid_feeds=*/false);
+      if (!status.ok()) {
+        VLOG(1) << "Skipping mixture of experts fusion: " << status;
+        properties.reset();
+      }
+    }
+    return properties.get();
+  };
+
+  TF_RETURN_IF_ERROR(mixtureofexpertsfusion::FuseCombines(
+      nodes_to_preserve, get_properties, output));
+  TF_RETURN_IF_ERROR(mixtureofexpertsfusion::FuseDenseLayers(
+      nodes_to_preserve, get_properties, output));
+
+  VLOG(3) << "After mixture of experts fusion rewrites: "
+          << output->DebugString();
+
+  return Status::OK();
+}
+
+void MixtureOfExpertsFusion::Feedback(Cluster* cluster,
+                                      const GrapplerItem& item,
+                                      const GraphDef& optimize_output,
+                                      double result) {
+  // Nothing to do for MixtureOfExpertsFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
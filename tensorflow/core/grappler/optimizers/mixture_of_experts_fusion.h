@@ -0,0 +1,55 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MIXTURE_OF_EXPERTS_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MIXTURE_OF_EXPERTS_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Fuses the parallel layers of the multi-task models of modelzoo, as MMoE,
+// PLE, ESMM and DBMTL.
+//
+// The gated combine of the experts of an MMoE or PLE tower
+//
+//   Sum(Mul(Pack(experts, axis=1), ExpandDims(Softmax(gate), -1)), 1)
+//
+// becomes a GatedExpertCombine op, with or without the softmax.
+//
+// Then sibling dense layers, BiasAdd(MatMul(x, kernel), bias) and an
+// optional Relu, become a GroupedDense op when they have the same kernel
+// shape and activation, and either share x, as the first layer of the
+// experts and the gates, or are at the same depth of parallel towers of one
+// structure, as the following expert and tower layers. The x of the towers
+// are the outputs of one GroupedDense, or GatedExpertCombines of the same
+// experts. The depth, the number of dense layers on the longest path from
+// the graph inputs, keeps the grouped layers independent of each other.
+// Layers in different frames, or that depend on a Switch or Merge, are
+// never grouped.
+//
+// The MatMul and BiasAdd outputs are not used by the gradients, so the
+// dense layers of training graphs could be grouped too, but the meta
+// optimizer only runs the pass with INFERENCE_MODE.
+class MixtureOfExpertsFusion : public GraphOptimizer {
+ public:
+  MixtureOfExpertsFusion() = default;
+  explicit MixtureOfExpertsFusion(RewriterConfig::Toggle opt_level) {}
+  ~MixtureOfExpertsFusion() override {}
+
+  string name() const override { return "mixture_of_experts_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MIXTURE_OF_EXPERTS_FUSION_H_
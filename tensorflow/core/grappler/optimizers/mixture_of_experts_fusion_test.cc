@@ -0,0 +1,341 @@
+#include "tensorflow/core/grappler/optimizers/mixture_of_experts_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/remapper.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class MixtureOfExpertsFusionTest : public GrapplerTest {
+ protected:
+  static NodeDef RandomConst(const string& name, const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return test::function::NDef(name, "Const", {},
+                                {{"dtype", DT_FLOAT}, {"value", t}});
+  }
+
+  static NodeDef IntConst(const string& name, int value) {
+    return test::function::NDef(
+        name, "Const", {},
+        {{"dtype", DT_INT32}, {"value", test::AsScalar<int32>(value)}});
+  }
+
+  // A tf.layers.dense of `units` units on the [4, depth] x, with the
+  // variables entered into `frame` if set.
+  static void AddDense(const string& name, const string& x, int depth,
+                       int units, bool relu, GraphDef* graph,
+                       const string& frame = "") {
+    using test::function::NDef;
+    string kernel = name + "/kernel";
+    string bias = name + "/bias";
+    *graph->add_node() = RandomConst(kernel, {depth, units});
+    *graph->add_node() = RandomConst(bias, {units});
+    if (!frame.empty()) {
+      for (string* input : {&kernel, &bias}) {
+        *graph->add_node() =
+            NDef(*input + "/Enter", "Enter", {*input},
+                 {{"T", DT_FLOAT}, {"frame_name", frame},
+                  {"is_constant", true}});
+        *input += "/Enter";
+      }
+    }
+    *graph->add_node() =
+        NDef(name + "/MatMul", "MatMul", {x, kernel}, {{"T", DT_FLOAT}});
+    *graph->add_node() =
+        NDef(name + "/BiasAdd", "BiasAdd", {name + "/MatMul", bias},
+             {{"T", DT_FLOAT}});
+    if (relu) {
+      *graph->add_node() =
+          NDef(name + "/Relu", "Relu", {name + "/BiasAdd"}, {{"T", DT_FLOAT}});
+    }
+  }
+
+  // The experts and towers of modelzoo/mmoe: 3 experts of 2 units on x and
+  // the gated combines of 2 towers.
+  static GraphDef MMoEGraph() {
+    using test::function::NDef;
+    GraphDef graph;
+    *graph.add_node() = RandomConst("x", {4, 3});
+    *graph.add_node() = IntConst("axis", 1);
+    *graph.add_node() = IntConst("dim", -1);
+    std::vector<string> experts;
+    for (int i = 0; i < 3; ++i) {
+      const string expert = strings::StrCat("expert_", i);
+      AddDense(expert, "x", 3, 2, true, &graph);
+      experts.push_back(expert + "/Relu");
+    }
+    *graph.add_node() =
+        NDef("experts", "Pack", experts,
+             {{"T", DT_FLOAT}, {"N", 3}, {"axis", 1}});
+    for (int i = 0; i < 2; ++i) {
+      const string tower = strings::StrCat("tower_", i);
+      AddDense(tower + "/gate", "x", 3, 3, false, &graph);
+      for (const NodeDef& node : {
+               NDef(tower + "/softmax", "Softmax", {tower + "/gate/BiasAdd"},
+                    {{"T", DT_FLOAT}}),
+               NDef(tower + "/expand_dims", "ExpandDims",
+                    {tower + "/softmax", "dim"},
+                    {{"T", DT_FLOAT}, {"Tdim", DT_INT32}}),
+               NDef(tower + "/mul", "Mul", {"experts", tower + "/expand_dims"},
+                    {{"T", DT_FLOAT}}),
+               NDef(tower + "/sum", "Sum", {tower + "/mul", "axis"},
+                    {{"T", DT_FLOAT}, {"Tidx", DT_INT32}, {"keep_dims", false}}),
+           }) {
+        *graph.add_node() = node;
+      }
+    }
+    for (int i = 0; i < graph.node_size(); ++i) {
+      graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+    return graph;
+  }
+
+  static int CountOps(const GraphDef& graph, const string& op) {
+    int count = 0;
+    for (const NodeDef& node : graph.node()) count += node.op() == op;
+    return count;
+  }
+
+  static const NodeDef* FindOp(const GraphDef& graph, const string& op,
+                               const string& input) {
+    for (const NodeDef& node : graph.node()) {
+      if (node.op() == op && node.input(0) == input) return &node;
+    }
+    return nullptr;
+  }
+
+  void ExpectSameOutputs(const GrapplerItem& item, const GraphDef& output) {
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+    auto tensors = EvaluateNodes(output, item.fetch);
+    ASSERT_EQ(item.fetch.size(), tensors_expected.size());
+    ASSERT_EQ(item.fetch.size(), tensors.size());
+    for (int i = 0; i < item.fetch.size(); ++i) {
+      test::ExpectTensorNear<float>(tensors_expected[i], tensors[i], 1e-5);
+    }
+  }
+};
+
+TEST_F(MixtureOfExpertsFusionTest, FusesMMoE) {
+  GrapplerItem item;
+  item.graph = MMoEGraph();
+  item.fetch = {"tower_0/sum", "tower_1/sum"};
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(2, CountOps(output, "GatedExpertCombine"));
+  EXPECT_EQ(2, CountOps(output, "GroupedDense"));
+  for (const string& op :
+       {"Pack", "Softmax", "ExpandDims", "Mul", "MatMul", "BiasAdd", "Relu"}) {
+    EXPECT_EQ(0, CountOps(output, op)) << op;
+  }
+  string experts;
+  for (const NodeDef& node : output.node()) {
+    if (node.op() != "GroupedDense") continue;
+    const bool is_experts = node.attr().at("activation").s() == "Relu";
+    if (is_experts) experts = node.name();
+    EXPECT_EQ(is_experts ? 3 : 2, node.attr().at("N").i());
+    EXPECT_EQ(1, node.attr().at("num_inputs").i());
+    EXPECT_EQ("x", node.input(0));
+  }
+  for (const NodeDef& node : output.node()) {
+    if (node.op() != "GatedExpertCombine") continue;
+    EXPECT_TRUE(node.attr().at("softmax").b());
+    ASSERT_EQ(4, node.input_size());
+    EXPECT_EQ(experts, ParseTensorName(node.input(0)).node());
+  }
+
+  ExpectSameOutputs(item, output);
+}
+
+TEST_F(MixtureOfExpertsFusionTest, FusesRemappedMMoE) {
+  GrapplerItem item;
+  item.graph = MMoEGraph();
+  item.fetch = {"tower_0/sum", "tower_1/sum"};
+
+  // The meta optimizer runs the remapper first, which rewrites the dense
+  // layers to _FusedMatMul ops on CPU.
+  GrapplerItem remapped = item;
+  Remapper remapper(RewriterConfig::ON);
+  TF_EXPECT_OK(remapper.Optimize(/*cluster=*/nullptr, item, &remapped.graph));
+  EXPECT_EQ(5, CountOps(remapped.graph, "_FusedMatMul"));
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, remapped, &output));
+
+  EXPECT_EQ(2, CountOps(output, "GatedExpertCombine"));
+  EXPECT_EQ(2, CountOps(output, "GroupedDense"));
+  EXPECT_EQ(0, CountOps(output, "_FusedMatMul"));
+
+  ExpectSameOutputs(item, output);
+}
+
+TEST_F(MixtureOfExpertsFusionTest, GroupsParallelLayersByDepth) {
+  GrapplerItem item;
+  item.graph = MMoEGraph();
+  // Two towers of two layers of the same shape on the gated combines.
+  for (int i = 0; i < 2; ++i) {
+    const string tower = strings::StrCat("tower_", i);
+    AddDense(tower + "/layer_0", tower + "/sum", 2, 3, true, &item.graph);
+    AddDense(tower + "/layer_1", tower + "/layer_0/Relu", 3, 3, true,
+             &item.graph);
+    item.fetch.push_back(tower + "/layer_1/Relu");
+  }
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  // The experts, the gates and the two layers of the towers.
+  EXPECT_EQ(4, CountOps(output, "GroupedDense"));
+  EXPECT_EQ(0, CountOps(output, "MatMul"));
+  const NodeDef* first = FindOp(output, "GroupedDense", "tower_0/sum");
+  ASSERT_NE(nullptr, first);
+  EXPECT_EQ(2, first->attr().at("num_inputs").i());
+  EXPECT_EQ("tower_1/sum", first->input(1));
+  const NodeDef* second =
+      FindOp(output, "GroupedDense", strings::StrCat(first->name(), ":0"));
+  ASSERT_NE(nullptr, second);
+  EXPECT_EQ(strings::StrCat(first->name(), ":1"), second->input(1));
+
+  ExpectSameOutputs(item, output);
+}
+
+TEST_F(MixtureOfExpertsFusionTest, KeepsUnrelatedLayers) {
+  GrapplerItem item;
+  // Layers of different shapes on the same x, and layers of the same shape
+  // on unrelated inputs.
+  *item.graph.add_node() = RandomConst("x", {4, 3});
+  AddDense("narrow", "x", 3, 2, true, &item.graph);
+  AddDense("wide", "x", 3, 3, true, &item.graph);
+  for (int i = 0; i < 2; ++i) {
+    const string tower = strings::StrCat("tower_", i);
+    *item.graph.add_node() = RandomConst(tower + "/x", {4, 3});
+    AddDense(tower + "/layer", tower + "/x", 3, 3, true, &item.graph);
+    item.fetch.push_back(tower + "/layer/Relu");
+  }
+  item.fetch.push_back("narrow/Relu");
+  item.fetch.push_back("wide/Relu");
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(0, CountOps(output, "GroupedDense"));
+  EXPECT_EQ(4, CountOps(output, "MatMul"));
+}
+
+TEST_F(MixtureOfExpertsFusionTest, KeepsLayersInCond) {
+  using test::function::NDef;
+  GrapplerItem item;
+  // Two layers on x in the true branch of a tf.cond.
+  *item.graph.add_node() = RandomConst("x", {4, 3});
+  *item.graph.add_node() =
+      NDef("pred", "Const", {},
+           {{"dtype", DT_BOOL}, {"value", test::AsScalar<bool>(true)}});
+  *item.graph.add_node() =
+      NDef("cond/switch", "Switch", {"x", "pred"}, {{"T", DT_FLOAT}});
+  AddDense("cond/layer_0", "cond/switch:1", 3, 3, true, &item.graph);
+  AddDense("cond/layer_1", "cond/switch:1", 3, 3, true, &item.graph);
+  *item.graph.add_node() =
+      NDef("cond/add", "Add", {"cond/layer_0/Relu", "cond/layer_1/Relu"},
+           {{"T", DT_FLOAT}});
+  *item.graph.add_node() =
+      NDef("cond/merge", "Merge", {"cond/add", "cond/switch"},
+           {{"T", DT_FLOAT}, {"N", 2}});
+  item.fetch = {"cond/merge"};
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(0, CountOps(output, "GroupedDense"));
+  EXPECT_EQ(2, CountOps(output, "MatMul"));
+}
+
+TEST_F(MixtureOfExpertsFusionTest, KeepsLayersInWhileLoop) {
+  using test::function::NDef;
+  GrapplerItem item;
+  // Two layers on the loop variable in the body of a tf.while_loop.
+  const string frame = "loop";
+  *item.graph.add_node() = RandomConst("x", {4, 3});
+  *item.graph.add_node() =
+      NDef("pred", "Const", {},
+           {{"dtype", DT_BOOL}, {"value", test::AsScalar<bool>(false)}});
+  for (const NodeDef& node : {
+           NDef("loop/enter", "Enter", {"x"},
+                {{"T", DT_FLOAT}, {"frame_name", frame}}),
+           NDef("loop/pred", "Enter", {"pred"},
+                {{"T", DT_BOOL}, {"frame_name", frame},
+                 {"is_constant", true}}),
+           NDef("loop/merge", "Merge", {"loop/enter", "loop/next_iteration"},
+                {{"T", DT_FLOAT}, {"N", 2}}),
+           NDef("loop/cond", "LoopCond", {"loop/pred"}, {}),
+           NDef("loop/switch", "Switch", {"loop/merge", "loop/cond"},
+                {{"T", DT_FLOAT}}),
+           NDef("loop/identity", "Identity", {"loop/switch:1"},
+                {{"T", DT_FLOAT}}),
+           NDef("loop/exit", "Exit", {"loop/switch"}, {{"T", DT_FLOAT}}),
+       }) {
+    *item.graph.add_node() = node;
+  }
+  AddDense("loop/layer_0", "loop/identity", 3, 3, true, &item.graph, frame);
+  AddDense("loop/layer_1", "loop/identity", 3, 3, true, &item.graph, frame);
+  *item.graph.add_node() =
+      NDef("loop/add", "Add", {"loop/layer_0/Relu", "loop/layer_1/Relu"},
+           {{"T", DT_FLOAT}});
+  *item.graph.add_node() = NDef("loop/next_iteration", "NextIteration",
+                                {"loop/add"}, {{"T", DT_FLOAT}});
+  item.fetch = {"loop/exit"};
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(0, CountOps(output, "GroupedDense"));
+  EXPECT_EQ(2, CountOps(output, "MatMul"));
+  ExpectSameOutputs(item, output);
+}
+
+TEST_F(MixtureOfExpertsFusionTest, KeepsUsedIntermediates) {
+  GrapplerItem item;
+  item.graph = MMoEGraph();
+  // The stacked experts and a gate used elsewhere, e.g. by the gradients of
+  // a training graph.
+  item.fetch = {"tower_0/sum", "tower_1/sum", "experts",
+                "tower_1/expand_dims"};
+
+  MixtureOfExpertsFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  EXPECT_EQ(1, CountOps(output, "GatedExpertCombine"));
+  EXPECT_EQ(1, CountOps(output, "Pack"));
+  EXPECT_EQ(1, CountOps(output, "Mul"));
+  // The dense layers are grouped anyway.
+  EXPECT_EQ(2, CountOps(output, "GroupedDense"));
+
+  ExpectSameOutputs(item, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,444 @@
+#include "tensorflow/core/grappler/optimizers/multi_head_attention_fusion.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils/graph_view.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace multiheadattentionfusion {
+
+// Masked keys only get exactly zero weight in the unfused softmax if their
+// scores are shifted far enough below the others.
+const float kMinPadding = 1e9f;
+
+struct MultiHeadAttentionPattern {
+  int concat_id = -1;
+  // Nodes replaced by the fused op.
+  std::vector<int> nodes;
+  string query;
+  string key;
+  string value;
+  string key_mask;
+  int head_count = 0;
+  float scale = 1.0f;
+};
+
+bool GetConstTensor(const NodeDef& node, Tensor* tensor) {
+  if (!IsConstant(node) || node.attr().count("value") == 0) return false;
+  return tensor->FromProto(node.attr().at("value").tensor());
+}
+
+bool GetIntValues(const NodeDef& node, std::vector<int64>* values) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor)) return false;
+  values->clear();
+  if (tensor.dtype() == DT_INT32) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int32>()(i));
+    }
+  } else if (tensor.dtype() == DT_INT64) {
+    for (int64 i = 0; i < tensor.NumElements(); ++i) {
+      values->push_back(tensor.flat<int64>()(i));
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool GetFloatScalar(const NodeDef& node, float* value) {
+  Tensor tensor;
+  if (!GetConstTensor(node, &tensor) || tensor.dtype() != DT_FLOAT ||
+      tensor.NumElements() != 1) {
+    return false;
+  }
+  *value = tensor.flat<float>()(0);
+  return true;
+}
+
+class MultiHeadAttentionMatcher {
+ public:
+  explicit MultiHeadAttentionMatcher(const utils::MutableGraphView& graph_view)
+      : graph_view_(graph_view) {}
+
+  bool Match(int node_index, MultiHeadAttentionPattern* matched) {
+    MultiHeadAttentionPattern pattern;
+    pattern.concat_id = node_index;
+    // ConcatV2(Split(0, output, num_split=H), axis=2)
+    int output = -1;
+    if (!MatchHeads(node_index, /*concat_axis=*/{2, -1}, /*split_axis=*/{0},
+                    &pattern, &output) ||
+        !IsFloat(*Node(node_index))) {
+      return false;
+    }
+    // The fused node replaces the concat.
+    pattern.nodes.erase(pattern.nodes.begin());
+
+    // BatchMatMul(Softmax(scores - paddings), heads(value))
+    if (!IsOp(output, IsAnyBatchMatMul, &pattern) ||
+        !NoAdjoint(*Node(output), false)) {
+      return false;
+    }
+    int value = -1;
+    if (!MatchHeads(Fanin(output, 1), {0}, {-1, 2}, &pattern, &value)) {
+      return false;
+    }
+    pattern.value = Node(value)->input(1);
+    const int softmax = Fanin(output, 0);
+    if (!IsOp(softmax, IsSoftmax, &pattern)) return false;
+    const int sub = Fanin(softmax, 0);
+    if (!IsOp(sub, IsSub, &pattern) ||
+        !MatchPaddings(Fanin(sub, 1), &pattern)) {
+      return false;
+    }
+
+    // BatchMatMul(heads(query), heads(key), adj_y=true) * scale
+    int scores = Fanin(sub, 0);
+    if (scores >= 0 && IsMul(*Node(scores))) {
+      if (!IsOp(scores, IsMul, &pattern)) return false;
+      int input = -1;
+      for (int i = 0; i < 2; ++i) {
+        const int scale = Fanin(scores, 1 - i);
+        if (scale >= 0 && GetFloatScalar(*Node(scale), &pattern.scale)) {
+          input = Fanin(scores, i);
+          break;
+        }
+      }
+      scores = input;
+    }
+    if (!IsOp(scores, IsAnyBatchMatMul, &pattern) ||
+        !NoAdjoint(*Node(scores), true)) {
+      return false;
+    }
+    int query = -1;
+    int key = -1;
+    if (!MatchHeads(Fanin(scores, 0), {0}, {-1, 2}, &pattern, &query) ||
+        !MatchHeads(Fanin(scores, 1), {0}, {-1, 2}, &pattern, &key)) {
+      return false;
+    }
+    pattern.query = Node(query)->input(1);
+    pattern.key = Node(key)->input(1);
+
+    *matched = std::move(pattern);
+    return true;
+  }
+
+ private:
+  static bool IsAnyBatchMatMul(const NodeDef& node) {
+    return node.op() == "BatchMatMul" || node.op() == "BatchMatMulV2";
+  }
+
+  static bool IsLogicalNot(const NodeDef& node) {
+    return node.op() == "LogicalNot";
+  }
+
+  static bool IsFloat(const NodeDef& node) {
+    auto it = node.attr().find("T");
+    return it != node.attr().end() && it->second.type() == DT_FLOAT;
+  }
+
+  static bool GetBoolAttr(const NodeDef& node, const string& name) {
+    auto it = node.attr().find(name);
+    return it != node.attr().end() && it->second.b();
+  }
+
+  static bool NoAdjoint(const NodeDef& node, bool adj_y) {
+    return IsFloat(node) && !GetBoolAttr(node, "adj_x") &&
+           GetBoolAttr(node, "adj_y") == adj_y;
+  }
+
+  const NodeDef* Node(int node_index) const {
+    return graph_view_.GetNode(node_index)->node();
+  }
+
+  // Returns the node of regular input `i` and sets `port` to its output, or
+  // returns -1 if there is no such input.
+  int Fanin(int node_index, int i, int* port) const {
+    if (node_index < 0) return -1;
+    const auto* node_view = graph_view_.GetNode(node_index);
+    if (i >= node_view->NumRegularFanins()) return -1;
+    const auto& fanin = node_view->GetRegularFanin(i);
+    *port = fanin.index();
+    return fanin.node_index();
+  }
+
+  // Returns the node of regular input `i`, or -1 if it is not the first
+  // output of a node.
+  int Fanin(int node_index, int i) const {
+    int port = -1;
+    const int fanin = Fanin(node_index, i, &port);
+    return port == 0 ? fanin : -1;
+  }
+
+  // Adds the node to the pattern if `func` matches it.
+  bool IsOp(int node_index, bool (*func)(const NodeDef& node),
+            MultiHeadAttentionPattern* pattern) const {
+    if (node_index < 0) return false;
+    const NodeDef* node = Node(node_index);
+    if (!func(*node) || !NodeIsOnCpu(node)) return false;
+    pattern->nodes.push_back(node_index);
+    return true;
+  }
+
+  // Returns whether constant input `i` is a scalar in `values`.
+  bool IsAxis(int node_index, int i,
+              std::initializer_list<int64> values) const {
+    const int input = Fanin(node_index, i);
+    std::vector<int64> axis;
+    if (input < 0 || !GetIntValues(*Node(input), &axis) || axis.size() != 1) {
+      return false;
+    }
+    return std::find(values.begin(), values.end(), axis[0]) != values.end();
+  }
+
+  // Returns the values of constant input `i`.
+  bool GetIntInput(int node_index, int i, std::vector<int64>* values) const {
+    const int input = Fanin(node_index, i);
+    return input >= 0 && GetIntValues(*Node(input), values);
+  }
+
+  // ConcatV2(Split(split_axis, x, num_split=H), concat_axis) with the
+  // outputs of the split in order, which moves the H slices of x along
+  // split_axis to concat_axis. Sets `split` to the Split node.
+  bool MatchHeads(int node_index, std::initializer_list<int64> concat_axis,
+                  std::initializer_list<int64> split_axis,
+                  MultiHeadAttentionPattern* pattern, int* split) const {
+    if (!IsOp(node_index, IsConcat, pattern)) return false;
+    const NodeDef* concat = Node(node_index);
+    const int num_inputs =
+        graph_view_.GetNode(node_index)->NumRegularFanins() - 1;
+    if (concat->op() != "ConcatV2" || num_inputs < 1 ||
+        !IsAxis(node_index, num_inputs, concat_axis)) {
+      return false;
+    }
+    for (int i = 0; i < num_inputs; ++i) {
+      int port = -1;
+      const int input = Fanin(node_index, i, &port);
+      if (input < 0 || port != i || (i > 0 && input != *split)) return false;
+      *split = input;
+    }
+    if (!IsOp(*split, IsSplit, pattern)) return false;
+    const NodeDef* split_node = Node(*split);
+    auto it = split_node->attr().find("num_split");
+    if (it == split_node->attr().end() || it->second.i() != num_inputs ||
+        !IsAxis(*split, 0, split_axis)) {
+      return false;
+    }
+    if (pattern->head_count == 0) pattern->head_count = num_inputs;
+    return pattern->head_count == num_inputs;
+  }
+
+  // Mul(padding, Cast(LogicalNot(Reshape(Tile(key_mask, [H, Tq]),
+  // [-1, Tq, Tk])))) with a large padding.
+  bool MatchPaddings(int node_index,
+                     MultiHeadAttentionPattern* pattern) const {
+    if (!IsOp(node_index, IsMul, pattern)) return false;
+    int cast = -1;
+    for (int i = 0; i < 2; ++i) {
+      const int input = Fanin(node_index, i);
+      const int padding = Fanin(node_index, 1 - i);
+      float value = 0;
+      if (input >= 0 && padding >= 0 && IsCast(*Node(input)) &&
+          GetFloatScalar(*Node(padding), &value) && value >= kMinPadding) {
+        cast = input;
+      }
+    }
+    if (!IsOp(cast, IsCast, pattern)) return false;
+    auto it = Node(cast)->attr().find("DstT");
+    if (it == Node(cast)->attr().end() || it->second.type() != DT_FLOAT) {
+      return false;
+    }
+    const int logical_not = Fanin(cast, 0);
+    if (!IsOp(logical_not, IsLogicalNot, pattern)) return false;
+    const int reshape = Fanin(logical_not, 0);
+    if (!IsOp(reshape, IsReshape, pattern)) return false;
+    const int tile = Fanin(reshape, 0);
+    if (!IsOp(tile, IsTile, pattern)) return false;
+    // Row h * B + b of the masks is key_mask[b], repeated for each query.
+    std::vector<int64> multiples;
+    std::vector<int64> shape;
+    if (!GetIntInput(tile, 1, &multiples) || multiples.size() != 2 ||
+        multiples[0] != pattern->head_count ||
+        !GetIntInput(reshape, 1, &shape) || shape.size() != 3 ||
+        shape[0] != -1 || shape[1] != multiples[1] || shape[2] <= 1) {
+      return false;
+    }
+    pattern->key_mask = Node(tile)->input(0);
+    return true;
+  }
+
+  const utils::MutableGraphView& graph_view_;
+};
+
+// Adds to the pattern the nodes that only compute values for it, e.g. the
+// axes of the splits, and returns false if another node uses one of its
+// intermediate tensors.
+bool CollectRemovableNodes(const utils::MutableGraphView& graph_view,
+                           const std::unordered_set<string>& nodes_to_preserve,
+                           MultiHeadAttentionPattern* pattern) {
+  std::unordered_set<int> removed(pattern->nodes.begin(), pattern->nodes.end());
+  std::unordered_set<string> kept;
+  for (const string& input :
+       {pattern->query, pattern->key, pattern->value, pattern->key_mask}) {
+    kept.insert(string(ParseTensorName(input).node()));
+  }
+
+  auto can_remove = [&](int index) {
+    const auto* node_view = graph_view.GetNode(index);
+    const NodeDef* node = node_view->node();
+    return index != pattern->concat_id &&
+           nodes_to_preserve.count(node->name()) == 0 &&
+           kept.count(node->name()) == 0 && IsFreeOfSideEffect(*node) &&
+           node_view->NumControllingFanins() == 0 &&
+           node_view->NumControlledFanouts() == 0;
+  };
+  for (int index : removed) {
+    if (!can_remove(index)) return false;
+  }
+
+  // Consumers of the intermediate tensors, which may only feed the pattern.
+  std::function<bool(int, std::unordered_set<int>*)> only_feeds_pattern =
+      [&](int index, std::unordered_set<int>* visited) {
+        if (removed.count(index) > 0) return true;
+        if (!visited->insert(index).second || !can_remove(index)) {
+          return false;
+        }
+        for (const auto& fanouts :
+             graph_view.GetNode(index)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            if (!only_feeds_pattern(fanout.node_index(), visited)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      };
+  std::vector<int> pending(removed.begin(), removed.end());
+  for (int index : pending) {
+    for (const auto& fanouts : graph_view.GetNode(index)->GetRegularFanouts()) {
+      for (const auto& fanout : fanouts) {
+        const int consumer = fanout.node_index();
+        if (consumer == pattern->concat_id) continue;
+        std::unordered_set<int> visited;
+        if (!only_feeds_pattern(consumer, &visited)) return false;
+        removed.insert(visited.begin(), visited.end());
+      }
+    }
+  }
+
+  // Producers that are only used by removed nodes, e.g. Const.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    pending.assign(removed.begin(), removed.end());
+    for (int index : pending) {
+      for (const auto& fanin : graph_view.GetNode(index)->GetRegularFanins()) {
+        const int producer = fanin.node_index();
+        if (removed.count(producer) > 0 || !can_remove(producer)) continue;
+        bool used = false;
+        for (const auto& fanouts :
+             graph_view.GetNode(producer)->GetRegularFanouts()) {
+          for (const auto& fanout : fanouts) {
+            used |= removed.count(fanout.node_index()) == 0;
+          }
+        }
+        if (!used) {
+          removed.insert(producer);
+          changed = true;
+        }
+      }
+    }
+  }
+  pattern->nodes.assign(removed.begin(), removed.end());
+  return true;
+}
+
+}  // namespace multiheadattentionfusion
+
+Status MultiHeadAttentionFusion::Optimize(Cluster* cluster,
+                                          const GrapplerItem& item,
+                                          GraphDef* output) {
+  *output = item.graph;
+  Status status;
+  utils::MutableGraphView graph_view(output, &status);
+  TF_RETURN_IF_ERROR(status);
+  const int num_nodes = item.graph.node_size();
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  // Nodes of a fused pattern, which can't be part of another one.
+  std::vector<bool> nodes_to_delete(num_nodes);
+  std::vector<NodeDef> fused_nodes;
+  const GraphDef* graph = graph_view.graph();
+
+  VLOG(3) << "Before multi-head attention fusion rewrites: "
+          << graph->DebugString();
+
+  multiheadattentionfusion::MultiHeadAttentionMatcher matcher(graph_view);
+  for (int i = 0; i < num_nodes; ++i) {
+    multiheadattentionfusion::MultiHeadAttentionPattern pattern;
+    if (nodes_to_delete[i] || !matcher.Match(i, &pattern) ||
+        !multiheadattentionfusion::CollectRemovableNodes(
+            graph_view, nodes_to_preserve, &pattern)) {
+      continue;
+    }
+    bool overlaps = false;
+    for (int id : pattern.nodes) overlaps |= nodes_to_delete[id];
+    if (overlaps) continue;
+
+    const NodeDef& concat = graph->node(i);
+    VLOG(2) << "Optimizing fused multi-head attention node "
+            << SummarizeNodeDef(concat);
+    for (int id : pattern.nodes) nodes_to_delete[id] = true;
+
+    NodeDef fused_op;
+    fused_op.set_name(concat.name());
+    fused_op.set_op("MultiHeadAttention");
+    fused_op.set_device(concat.device());
+    fused_op.add_input(pattern.query);
+    fused_op.add_input(pattern.key);
+    fused_op.add_input(pattern.value);
+    fused_op.add_input(pattern.key_mask);
+    for (const string& input : concat.input()) {
+      if (IsControlInput(input)) fused_op.add_input(input);
+    }
+    auto* attr = fused_op.mutable_attr();
+    (*attr)["T"].set_type(DT_FLOAT);
+    (*attr)["head_count"].set_i(pattern.head_count);
+    (*attr)["scale"].set_f(pattern.scale);
+    fused_nodes.push_back(std::move(fused_op));
+  }
+  if (fused_nodes.empty()) return Status::OK();
+
+  utils::Mutation* mutation = graph_view.GetMutationBuilder();
+  for (NodeDef& fused_op : fused_nodes) {
+    mutation->AddNode(std::move(fused_op), &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_to_delete[i]) {
+      mutation->RemoveNode(graph_view.GetNode(i));
+    }
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  *output = *graph_view.graph();
+
+  VLOG(3) << "After multi-head attention fusion rewrites: "
+          << output->DebugString();
+
+  return Status::OK();
+}
+
+void MultiHeadAttentionFusion::Feedback(Cluster* cluster,
+                                        const GrapplerItem& item,
+                                        const GraphDef& optimize_output,
+                                        double result) {
+  // Nothing to do for MultiHeadAttentionFusion.
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,45 @@
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_HEAD_ATTENTION_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_HEAD_ATTENTION_FUSION_H_
+
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Rewrites the multi-head self-attention of modelzoo/bst
+// _multihead_attention into a MultiHeadAttention op:
+//
+//   heads(x) = ConcatV2(Split(-1, x, num_split=H), axis=0)
+//   scores   = BatchMatMul(heads(query), heads(key), adj_y=true) [* scale]
+//   masks    = Reshape(Tile(key_mask, [H, Tq]), [-1, Tq, Tk])
+//   scores   = scores - 1e9 * Cast(LogicalNot(masks))
+//   output   = BatchMatMul(Softmax(scores), heads(value))
+//   output   = ConcatV2(Split(0, output, num_split=H), axis=2)
+//
+// As for DinAttentionFusion, the intermediate tensors must not be used
+// elsewhere, so training graphs are left unchanged. They can call
+// tf.nn.multi_head_attention directly.
+class MultiHeadAttentionFusion : public GraphOptimizer {
+ public:
+  MultiHeadAttentionFusion() = default;
+  explicit MultiHeadAttentionFusion(RewriterConfig::Toggle opt_level) {}
+  ~MultiHeadAttentionFusion() override {}
+
+  string name() const override { return "multi_head_attention_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* output) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_MULTI_HEAD_ATTENTION_FUSION_H_
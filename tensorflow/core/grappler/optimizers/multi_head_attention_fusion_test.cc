@@ -0,0 +1,130 @@
+#include "tensorflow/core/grappler/optimizers/multi_head_attention_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class MultiHeadAttentionFusionTest : public GrapplerTest {
+ protected:
+  static Tensor Random(const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return t;
+  }
+
+  // The graph of modelzoo/bst _multihead_attention with batch 2, sequence
+  // length 4, dimension 4 and 2 heads, and the inputs of the fused op.
+  void BuildGraph(GraphDef* graph, std::vector<NodeDef>* inputs) {
+    using test::function::NDef;
+    const Tensor mask = test::AsTensor<bool>(
+        {true, true, true, false, true, false, false, false}, {2, 4});
+    *inputs = {
+        NDef("query", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 4, 4})}}),
+        NDef("key", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 4, 4})}}),
+        NDef("value", "Const", {},
+             {{"dtype", DT_FLOAT}, {"value", Random({2, 4, 4})}}),
+        NDef("mask", "Const", {}, {{"dtype", DT_BOOL}, {"value", mask}}),
+    };
+    const Tensor last_axis = test::AsScalar<int32>(-1);
+    const Tensor first_axis = test::AsScalar<int32>(0);
+    const Tensor merge_axis = test::AsScalar<int32>(2);
+    const Tensor multiples = test::AsTensor<int32>({2, 4});
+    const Tensor masks_shape = test::AsTensor<int32>({-1, 4, 4});
+    const Tensor padding = test::AsScalar<float>(1e9f);
+
+    std::vector<NodeDef> nodes = {
+        NDef("last_axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", last_axis}}),
+        NDef("first_axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", first_axis}}),
+        NDef("merge_axis", "Const", {},
+             {{"dtype", DT_INT32}, {"value", merge_axis}}),
+        NDef("scores", "BatchMatMul", {"query_heads", "key_heads"},
+             {{"T", DT_FLOAT}, {"adj_x", false}, {"adj_y", true}}),
+        NDef("multiples", "Const", {},
+             {{"dtype", DT_INT32}, {"value", multiples}}),
+        NDef("tile", "Tile", {"mask", "multiples"},
+             {{"T", DT_BOOL}, {"Tmultiples", DT_INT32}}),
+        NDef("masks_shape", "Const", {},
+             {{"dtype", DT_INT32}, {"value", masks_shape}}),
+        NDef("masks", "Reshape", {"tile", "masks_shape"},
+             {{"T", DT_BOOL}, {"Tshape", DT_INT32}}),
+        NDef("padding_mask", "LogicalNot", {"masks"}, {}),
+        NDef("cast", "Cast", {"padding_mask"},
+             {{"SrcT", DT_BOOL}, {"DstT", DT_FLOAT}}),
+        NDef("padding", "Const", {}, {{"dtype", DT_FLOAT}, {"value", padding}}),
+        NDef("paddings", "Mul", {"padding", "cast"}, {{"T", DT_FLOAT}}),
+        NDef("masked", "Sub", {"scores", "paddings"}, {{"T", DT_FLOAT}}),
+        NDef("softmax", "Softmax", {"masked"}, {{"T", DT_FLOAT}}),
+        NDef("attention", "BatchMatMul", {"softmax", "value_heads"},
+             {{"T", DT_FLOAT}, {"adj_x", false}, {"adj_y", false}}),
+        NDef("split", "Split", {"first_axis", "attention"},
+             {{"T", DT_FLOAT}, {"num_split", 2}}),
+        NDef("output", "ConcatV2", {"split", "split:1", "merge_axis"},
+             {{"T", DT_FLOAT}, {"N", 2}, {"Tidx", DT_INT32}}),
+    };
+    for (const string& name : {"query", "key", "value"}) {
+      nodes.push_back(NDef(name + "_split", "Split", {"last_axis", name},
+                           {{"T", DT_FLOAT}, {"num_split", 2}}));
+      nodes.push_back(NDef(name + "_heads", "ConcatV2",
+                           {name + "_split", name + "_split:1", "first_axis"},
+                           {{"T", DT_FLOAT}, {"N", 2}, {"Tidx", DT_INT32}}));
+    }
+    *graph = test::function::GDef(nodes);
+    for (const NodeDef& input : *inputs) *graph->add_node() = input;
+    for (int i = 0; i < graph->node_size(); ++i) {
+      graph->mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+};
+
+TEST_F(MultiHeadAttentionFusionTest, FusesAttention) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph(&item.graph, &inputs);
+  item.fetch = {"output"};
+
+  MultiHeadAttentionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  GraphDef expected;
+  for (NodeDef input : inputs) {
+    input.set_device("/device:CPU:0");
+    *expected.add_node() = input;
+  }
+  *expected.add_node() = test::function::NDef(
+      "output", "MultiHeadAttention", {"query", "key", "value", "mask"},
+      {{"T", DT_FLOAT}, {"head_count", 2}, {"scale", 1.0f}},
+      "/device:CPU:0");
+  CompareGraphs(expected, output);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(MultiHeadAttentionFusionTest, KeepsUsedIntermediates) {
+  GrapplerItem item;
+  std::vector<NodeDef> inputs;
+  BuildGraph(&item.graph, &inputs);
+  // E.g. used by the gradients of a training graph.
+  item.fetch = {"output", "softmax"};
+
+  MultiHeadAttentionFusion optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,653 @@
+#include "tensorflow/core/kernels/ann/ann_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace ann {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<const Eigen::VectorXf> ConstVectorMap;
+typedef Eigen::Map<Eigen::VectorXf> VectorMap;
+
+typedef std::pair<float, int32> Candidate;
+
+// Lloyd iterations of the k-means of the quantizers.
+constexpr int kKMeansIterations = 10;
+// The k-means are trained on at most this many vectors per centroid.
+constexpr int64 kTrainingVectorsPerCentroid = 64;
+// Rows of the assignment step of the k-means, to bound the size of the
+// [rows, k] scores.
+constexpr int64 kKMeansBlock = 4096;
+// The codes of a product quantizer are 8 bits.
+constexpr int kMaxCodes = 256;
+// The approximate scores of IVF-PQ keep this many candidates per neighbor
+// for the exact re-ranking.
+constexpr int kRerankFactor = 16;
+
+// Lloyd's k-means of the rows of `points` into k clusters, from k distinct
+// random rows. Clusters that become empty keep their previous centroid.
+void KMeans(const Matrix& points, int64 k, std::mt19937_64* random,
+            Matrix* centroids) {
+  const int64 n = points.rows();
+  std::vector<int64> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  centroids->resize(k, points.cols());
+  for (int64 i = 0; i < k; ++i) {
+    std::uniform_int_distribution<int64> pick(i, n - 1);
+    std::swap(order[i], order[pick(*random)]);
+    centroids->row(i) = points.row(order[i]);
+  }
+
+  std::vector<Eigen::Index> assignments(n);
+  std::vector<int64> counts(k);
+  Matrix sums(k, points.cols());
+  for (int iteration = 0; iteration < kKMeansIterations; ++iteration) {
+    // The closest centroid c maximizes x.c - |c|^2 / 2.
+    const Eigen::RowVectorXf half_norms =
+        0.5f * centroids->rowwise().squaredNorm().transpose();
+    for (int64 begin = 0; begin < n; begin += kKMeansBlock) {
+      const int64 rows = std::min(kKMeansBlock, n - begin);
+      Matrix scores = points.middleRows(begin, rows) * centroids->transpose();
+      scores.rowwise() -= half_norms;
+      for (int64 i = 0; i < rows; ++i) {
+        scores.row(i).maxCoeff(&assignments[begin + i]);
+      }
+    }
+    sums.setZero();
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int64 i = 0; i < n; ++i) {
+      sums.row(assignments[i]) += points.row(i);
+      ++counts[assignments[i]];
+    }
+    for (int64 c = 0; c < k; ++c) {
+      if (counts[c] > 0) centroids->row(c) = sums.row(c) / counts[c];
+    }
+  }
+}
+
+// Pushes a candidate to the min-heap of the best `size` candidates.
+void PushCandidate(float score, int32 node, size_t size,
+                   std::vector<Candidate>* heap) {
+  if (heap->size() < size) {
+    heap->emplace_back(score, node);
+    std::push_heap(heap->begin(), heap->end(), std::greater<Candidate>());
+  } else if (score > heap->front().first) {
+    std::pop_heap(heap->begin(), heap->end(), std::greater<Candidate>());
+    heap->back() = Candidate(score, node);
+    std::push_heap(heap->begin(), heap->end(), std::greater<Candidate>());
+  }
+}
+
+}  // namespace
+
+Status ParseMetric(const string& name, Metric* metric) {
+  if (name == "inner_product") {
+    *metric = Metric::kInnerProduct;
+  } else if (name == "l2") {
+    *metric = Metric::kL2;
+  } else {
+    return errors::InvalidArgument("Unknown metric ", name,
+                                   ", expected inner_product or l2");
+  }
+  return Status::OK();
+}
+
+float Score(Metric metric, const float* a, const float* b, int64 dim) {
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+  __m512 sum = _mm512_setzero_ps();
+  int64 i = 0;
+  if (metric == Metric::kInnerProduct) {
+    for (; i + 16 <= dim; i += 16) {
+      sum = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i),
+                            sum);
+    }
+    if (i < dim) {
+      const __mmask16 mask = (1 << (dim - i)) - 1;
+      sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                            _mm512_maskz_loadu_ps(mask, b + i), sum);
+    }
+    return _mm512_reduce_add_ps(sum);
+  }
+  for (; i + 16 <= dim; i += 16) {
+    const __m512 diff =
+        _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    sum = _mm512_fmadd_ps(diff, diff, sum);
+  }
+  if (i < dim) {
+    const __mmask16 mask = (1 << (dim - i)) - 1;
+    const __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                                      _mm512_maskz_loadu_ps(mask, b + i));
+    sum = _mm512_fmadd_ps(diff, diff, sum);
+  }
+  return -_mm512_reduce_add_ps(sum);
+#else
+  ConstVectorMap x(a, dim);
+  ConstVectorMap y(b, dim);
+  if (metric == Metric::kInnerProduct) return x.dot(y);
+  return -(x - y).squaredNorm();
+#endif
+}
+
+Status AnnIndex::Update(const int64* ids, const float* vectors, int64 n,
+                        int64* num_updated) {
+  mutex_lock l(mu_);
+  if (ids_.size() + n > std::numeric_limits<int32>::max()) {
+    return errors::InvalidArgument("The index of ", ids_.size(),
+                                   " vectors cannot grow by ", n);
+  }
+  const int32 num_indexed = num_nodes();
+  std::vector<int32> inserted;
+  std::vector<int32> replaced;
+  std::vector<int32> reinserted;
+  std::unordered_set<int32> changed;
+  for (int64 i = 0; i < n; ++i) {
+    const float* v = vectors + i * dim_;
+    auto it = nodes_.find(ids[i]);
+    if (it == nodes_.end()) {
+      const int32 node = num_nodes();
+      nodes_.emplace(ids[i], node);
+      ids_.push_back(ids[i]);
+      vectors_.insert(vectors_.end(), v, v + dim_);
+      removed_.push_back(false);
+      inserted.push_back(node);
+      continue;
+    }
+    // The last vector of an id wins, and new nodes are indexed with it.
+    const int32 node = it->second;
+    float* indexed = &vectors_[node * dim_];
+    if (removed_[node]) {
+      removed_[node] = false;
+      --num_removed_;
+      std::copy(v, v + dim_, indexed);
+      changed.insert(node);
+      reinserted.push_back(node);
+      continue;
+    }
+    if (std::equal(v, v + dim_, indexed)) continue;
+    std::copy(v, v + dim_, indexed);
+    if (node < num_indexed && changed.insert(node).second) {
+      replaced.push_back(node);
+    }
+  }
+  if (!inserted.empty()) Prepare(inserted);
+  for (int32 node : inserted) Insert(node);
+  for (int32 node : replaced) Replace(node);
+  for (int32 node : reinserted) Reinsert(node);
+  *num_updated = inserted.size() + replaced.size() + reinserted.size();
+  return Status::OK();
+}
+
+int64 AnnIndex::Remove(const int64* ids, int64 n) {
+  mutex_lock l(mu_);
+  int64 num_removed = 0;
+  for (int64 i = 0; i < n; ++i) {
+    auto it = nodes_.find(ids[i]);
+    if (it == nodes_.end() || removed_[it->second]) continue;
+    removed_[it->second] = true;
+    Erase(it->second);
+    ++num_removed;
+  }
+  num_removed_ += num_removed;
+  return num_removed;
+}
+
+void AnnIndex::Search(const float* query, int k, int probe,
+                      Neighbors* neighbors) const {
+  neighbors->clear();
+  std::unique_ptr<SearchScratch> scratch = AcquireScratch();
+  std::vector<Candidate> nodes;
+  {
+    tf_shared_lock l(mu_);
+    if (ids_.size() > num_removed_) {
+      SearchNodes(query, k, probe, scratch.get(), &nodes);
+    }
+    for (const Candidate& node : nodes) {
+      neighbors->emplace_back(node.first, ids_[node.second]);
+    }
+  }
+  ReleaseScratch(std::move(scratch));
+}
+
+std::unique_ptr<SearchScratch> AnnIndex::AcquireScratch() const {
+  mutex_lock l(scratch_mu_);
+  if (scratches_.empty()) {
+    return std::unique_ptr<SearchScratch>(new SearchScratch);
+  }
+  std::unique_ptr<SearchScratch> scratch = std::move(scratches_.back());
+  scratches_.pop_back();
+  return scratch;
+}
+
+void AnnIndex::ReleaseScratch(std::unique_ptr<SearchScratch> scratch) const {
+  mutex_lock l(scratch_mu_);
+  scratches_.push_back(std::move(scratch));
+}
+
+HnswIndex::HnswIndex(int64 dim, Metric metric, int max_neighbors,
+                     int ef_construction, int64 seed)
+    : AnnIndex(dim, metric),
+      max_neighbors_(max_neighbors),
+      ef_construction_(ef_construction),
+      level_mult_(1.0 / std::log(std::max(max_neighbors, 2))),
+      random_(seed) {}
+
+string HnswIndex::DebugString() const {
+  tf_shared_lock l(mu_);
+  return strings::StrCat("HnswIndex of ", ids_.size() - num_removed_,
+                         " vectors of dim ", dim_, " on ", max_level_ + 1,
+                         " levels");
+}
+
+HnswIndex::Links HnswIndex::GetLinks(int32 node, int level) const {
+  if (level == 0) {
+    const int32* links = &level0_[node * (2 * max_neighbors_ + 1)];
+    return {links + 1, links[0]};
+  }
+  const std::vector<int32>& links = upper_[node][level - 1];
+  return {links.data(), static_cast<int>(links.size())};
+}
+
+void HnswIndex::SetLinks(int32 node, int level,
+                         const std::vector<int32>& links) {
+  if (level == 0) {
+    int32* level0 = &level0_[node * (2 * max_neighbors_ + 1)];
+    level0[0] = links.size();
+    std::copy(links.begin(), links.end(), level0 + 1);
+  } else {
+    upper_[node][level - 1] = links;
+  }
+}
+
+int32 HnswIndex::SearchGreedy(const float* query, int32 entry,
+                              int level) const {
+  float best = Score(metric_, query, vector(entry), dim_);
+  for (bool moved = true; moved;) {
+    moved = false;
+    const Links links = GetLinks(entry, level);
+    for (int i = 0; i < links.size; ++i) {
+      const float score = Score(metric_, query, vector(links.data[i]), dim_);
+      if (score > best) {
+        best = score;
+        entry = links.data[i];
+        moved = true;
+      }
+    }
+  }
+  return entry;
+}
+
+void HnswIndex::SearchLevel(const float* query, int32 entry, int level,
+                            int ef, bool skip_removed,
+                            SearchScratch* scratch,
+                            std::vector<Candidate>* nodes) const {
+  std::vector<uint32>& visited = scratch->visited;
+  if (visited.size() < num_nodes()) visited.resize(num_nodes(), 0);
+  if (++scratch->epoch == 0) {
+    std::fill(visited.begin(), visited.end(), 0);
+    scratch->epoch = 1;
+  }
+  const uint32 epoch = scratch->epoch;
+
+  // A max-heap of the candidates to expand, and the min-heap `nodes` of the
+  // best ef nodes.
+  std::vector<Candidate>& candidates = scratch->candidates;
+  candidates.clear();
+  nodes->clear();
+  const float score = Score(metric_, query, vector(entry), dim_);
+  visited[entry] = epoch;
+  candidates.emplace_back(score, entry);
+  if (!skip_removed || !removed_[entry]) nodes->emplace_back(score, entry);
+  while (!candidates.empty()) {
+    const Candidate candidate = candidates.front();
+    if (nodes->size() >= ef && candidate.first < nodes->front().first) break;
+    std::pop_heap(candidates.begin(), candidates.end());
+    candidates.pop_back();
+    const Links links = GetLinks(candidate.second, level);
+    for (int i = 0; i < links.size; ++i) {
+      const int32 node = links.data[i];
+      if (visited[node] == epoch) continue;
+      visited[node] = epoch;
+      const float score = Score(metric_, query, vector(node), dim_);
+      if (nodes->size() < ef || score > nodes->front().first) {
+        candidates.emplace_back(score, node);
+        std::push_heap(candidates.begin(), candidates.end());
+        if (!skip_removed || !removed_[node]) {
+          PushCandidate(score, node, ef, nodes);
+        }
+      }
+    }
+  }
+  std::sort(nodes->begin(), nodes->end(), std::greater<Candidate>());
+}
+
+void HnswIndex::SelectNeighbors(const std::vector<Candidate>& candidates,
+                                int m, std::vector<int32>* neighbors) const {
+  neighbors->clear();
+  std::vector<int32> pruned;
+  for (const Candidate& candidate : candidates) {
+    if (neighbors->size() >= m) break;
+    const float* v = vector(candidate.second);
+    bool diverse = true;
+    for (int32 neighbor : *neighbors) {
+      if (Score(metric_, v, vector(neighbor), dim_) > candidate.first) {
+        diverse = false;
+        break;
+      }
+    }
+    if (diverse) {
+      neighbors->push_back(candidate.second);
+    } else {
+      pruned.push_back(candidate.second);
+    }
+  }
+  // The closest pruned candidates fill the free links, which keeps the
+  // graph connected in clustered data.
+  for (int i = 0; i < pruned.size() && neighbors->size() < m; ++i) {
+    neighbors->push_back(pruned[i]);
+  }
+}
+
+void HnswIndex::AddLink(int32 neighbor, int32 node, int level) {
+  const Links links = GetLinks(neighbor, level);
+  if (std::find(links.data, links.data + links.size, node) !=
+      links.data + links.size) {
+    return;
+  }
+  std::vector<int32> updated(links.data, links.data + links.size);
+  if (links.size < MaxLinks(level)) {
+    updated.push_back(node);
+  } else {
+    const float* v = vector(neighbor);
+    std::vector<Candidate> candidates;
+    candidates.emplace_back(Score(metric_, v, vector(node), dim_), node);
+    for (int32 link : updated) {
+      candidates.emplace_back(Score(metric_, v, vector(link), dim_), link);
+    }
+    std::sort(candidates.begin(), candidates.end(), std::greater<Candidate>());
+    SelectNeighbors(candidates, MaxLinks(level), &updated);
+  }
+  SetLinks(neighbor, level, updated);
+}
+
+void HnswIndex::Link(int32 node, bool replace) {
+  const float* query = vector(node);
+  const int level = upper_[node].size();
+  if (entry_point_ < 0) {
+    entry_point_ = node;
+    max_level_ = level;
+    return;
+  }
+  // A node only reaches itself on its own levels, below these.
+  int32 entry = entry_point_;
+  for (int l = max_level_; l > level; --l) {
+    entry = SearchGreedy(query, entry, l);
+  }
+  std::vector<Candidate> candidates;
+  std::vector<int32> neighbors;
+  for (int l = std::min(level, max_level_); l >= 0; --l) {
+    SearchLevel(query, entry, l, ef_construction_, /*skip_removed=*/false,
+                &scratch_, &candidates);
+    if (replace) {
+      candidates.erase(
+          std::remove_if(candidates.begin(), candidates.end(),
+                         [node](const Candidate& c) {
+                           return c.second == node;
+                         }),
+          candidates.end());
+    }
+    if (candidates.empty()) continue;
+    SelectNeighbors(candidates, max_neighbors_, &neighbors);
+    SetLinks(node, l, neighbors);
+    for (int32 neighbor : neighbors) AddLink(neighbor, node, l);
+    entry = candidates[0].second;
+  }
+  if (level > max_level_) {
+    entry_point_ = node;
+    max_level_ = level;
+  }
+}
+
+void HnswIndex::Insert(int32 node) {
+  // Levels are exponentially distributed, each with 1 / max_neighbors of
+  // the nodes of the level below.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const int level =
+      static_cast<int>(-std::log(1.0 - uniform(random_)) * level_mult_);
+  level0_.resize((node + 1) * (2 * max_neighbors_ + 1), 0);
+  upper_.emplace_back(level);
+  Link(node, /*replace=*/false);
+}
+
+void HnswIndex::Replace(int32 node) {
+  // Links to the node from its old neighborhood stay, so that it remains
+  // reachable; its own links move to its new neighborhood.
+  Link(node, /*replace=*/true);
+}
+
+void HnswIndex::Reinsert(int32 node) {
+  // The removed node stayed in the graph with its old vector.
+  Link(node, /*replace=*/true);
+}
+
+void HnswIndex::SearchNodes(const float* query, int k, int probe,
+                            SearchScratch* scratch,
+                            std::vector<Candidate>* nodes) const {
+  int32 entry = entry_point_;
+  for (int l = max_level_; l > 0; --l) {
+    entry = SearchGreedy(query, entry, l);
+  }
+  SearchLevel(query, entry, 0, std::max(probe, k), /*skip_removed=*/true,
+              scratch, nodes);
+  if (nodes->size() > k) nodes->resize(k);
+}
+
+IvfPqIndex::IvfPqIndex(int64 dim, Metric metric, int num_lists,
+                       int num_subquantizers, int64 seed)
+    : AnnIndex(dim, metric),
+      num_lists_(num_lists),
+      num_subquantizers_(num_subquantizers),
+      sub_dim_(dim / num_subquantizers),
+      random_(seed) {}
+
+string IvfPqIndex::DebugString() const {
+  tf_shared_lock l(mu_);
+  return strings::StrCat("IvfPqIndex of ", ids_.size() - num_removed_,
+                         " vectors of dim ", dim_, " in ", list_nodes_.size(),
+                         " lists of ", num_subquantizers_, " codes");
+}
+
+void IvfPqIndex::Prepare(const std::vector<int32>& nodes) {
+  if (trained_) return;
+  // Fewer vectors than lists or codes only train as many centroids.
+  const int64 num_lists = std::min<int64>(num_lists_, nodes.size());
+  const int64 num_samples = std::min<int64>(
+      nodes.size(),
+      kTrainingVectorsPerCentroid * std::max<int64>(num_lists, kMaxCodes));
+  std::vector<int32> samples(nodes);
+  Matrix points(num_samples, dim_);
+  for (int64 i = 0; i < num_samples; ++i) {
+    std::uniform_int_distribution<int64> pick(i, samples.size() - 1);
+    std::swap(samples[i], samples[pick(random_)]);
+    points.row(i) = ConstVectorMap(vector(samples[i]), dim_).transpose();
+  }
+  KMeans(points, num_lists, &random_, &centroids_);
+  half_norms_ = 0.5f * centroids_.rowwise().squaredNorm();
+
+  for (int64 i = 0; i < num_samples; ++i) {
+    points.row(i) -= centroids_.row(AssignList(vector(samples[i])));
+  }
+  num_codes_ = std::min<int64>(kMaxCodes, num_samples);
+  codebooks_.resize(num_subquantizers_ * num_codes_, sub_dim_);
+  for (int m = 0; m < num_subquantizers_; ++m) {
+    Matrix residuals = points.middleCols(m * sub_dim_, sub_dim_);
+    Matrix codebook;
+    KMeans(residuals, num_codes_, &random_, &codebook);
+    codebooks_.middleRows(m * num_codes_, num_codes_) = codebook;
+  }
+  if (metric_ == Metric::kL2) {
+    list_tables_.resize(num_lists, num_subquantizers_ * num_codes_);
+    for (int m = 0; m < num_subquantizers_; ++m) {
+      const auto codebook = codebooks_.middleRows(m * num_codes_, num_codes_);
+      list_tables_.middleCols(m * num_codes_, num_codes_) =
+          (2.0f * centroids_.middleCols(m * sub_dim_, sub_dim_) *
+           codebook.transpose())
+              .rowwise() +
+          codebook.rowwise().squaredNorm().transpose();
+    }
+  }
+  list_nodes_.resize(num_lists);
+  list_codes_.resize(num_lists);
+  trained_ = true;
+}
+
+int32 IvfPqIndex::AssignList(const float* vector) const {
+  const Eigen::VectorXf scores =
+      centroids_ * ConstVectorMap(vector, dim_) - half_norms_;
+  Eigen::Index list;
+  scores.maxCoeff(&list);
+  return list;
+}
+
+void IvfPqIndex::AddToList(int32 node) {
+  const float* v = vector(node);
+  const int32 list = AssignList(v);
+  const Eigen::VectorXf residual =
+      ConstVectorMap(v, dim_) - centroids_.row(list).transpose();
+  std::vector<uint8>& codes = list_codes_[list];
+  for (int m = 0; m < num_subquantizers_; ++m) {
+    const float* sub_residual = residual.data() + m * sub_dim_;
+    int best_code = 0;
+    float best = -std::numeric_limits<float>::infinity();
+    for (int code = 0; code < num_codes_; ++code) {
+      const float score =
+          Score(Metric::kL2, sub_residual,
+                codebooks_.row(m * num_codes_ + code).data(), sub_dim_);
+      if (score > best) {
+        best = score;
+        best_code = code;
+      }
+    }
+    codes.push_back(best_code);
+  }
+  node_lists_[node] = list;
+  node_positions_[node] = list_nodes_[list].size();
+  list_nodes_[list].push_back(node);
+}
+
+void IvfPqIndex::Insert(int32 node) {
+  node_lists_.resize(node + 1);
+  node_positions_.resize(node + 1);
+  AddToList(node);
+}
+
+void IvfPqIndex::Replace(int32 node) {
+  RemoveFromList(node);
+  AddToList(node);
+}
+
+void IvfPqIndex::Erase(int32 node) { RemoveFromList(node); }
+
+void IvfPqIndex::Reinsert(int32 node) { AddToList(node); }
+
+void IvfPqIndex::RemoveFromList(int32 node) {
+  const int32 list = node_lists_[node];
+  const int32 position = node_positions_[node];
+  std::vector<int32>& nodes = list_nodes_[list];
+  std::vector<uint8>& codes = list_codes_[list];
+  const int32 last = nodes.back();
+  nodes[position] = last;
+  node_positions_[last] = position;
+  std::copy(codes.end() - num_subquantizers_, codes.end(),
+            codes.begin() + position * num_subquantizers_);
+  nodes.pop_back();
+  codes.resize(codes.size() - num_subquantizers_);
+}
+
+void IvfPqIndex::SearchNodes(const float* query, int k, int probe,
+                             SearchScratch* scratch,
+                             std::vector<Candidate>* nodes) const {
+  const int64 num_lists = list_nodes_.size();
+  const ConstVectorMap q(query, dim_);
+  // The lists of the closest centroids, by the score of the metric up to a
+  // constant of the query.
+  Eigen::VectorXf coarse = centroids_ * q;
+  if (metric_ == Metric::kL2) coarse -= half_norms_;
+  std::vector<int32> lists(num_lists);
+  std::iota(lists.begin(), lists.end(), 0);
+  const int64 num_probes = std::min<int64>(probe, num_lists);
+  std::partial_sort(lists.begin(), lists.begin() + num_probes, lists.end(),
+                    [&coarse](int32 a, int32 b) {
+                      return coarse[a] > coarse[b];
+                    });
+
+  // The inner product of the query with x = centroid + residual is
+  // q.centroid + sum_m q_m.code_m, and the L2 score -|q - x|^2 is
+  // -|q - centroid|^2 - sum_m (|code_m|^2 + 2 centroid_m.code_m
+  // - 2 q_m.code_m), or 2 coarse - |q|^2 - sum_m list_tables[code_m]
+  // + sum_m 2 q_m.code_m. The constant |q|^2 is left out of the
+  // approximate scores, which only rank the candidates.
+  const int64 table_size = num_subquantizers_ * num_codes_;
+  Eigen::VectorXf products(table_size);
+  for (int m = 0; m < num_subquantizers_; ++m) {
+    for (int code = 0; code < num_codes_; ++code) {
+      products[m * num_codes_ + code] = Score(
+          Metric::kInnerProduct, query + m * sub_dim_,
+          codebooks_.row(m * num_codes_ + code).data(), sub_dim_);
+    }
+  }
+  std::vector<float>& tables = scratch->tables;
+  tables.resize(table_size);
+  VectorMap table(tables.data(), table_size);
+  if (metric_ == Metric::kInnerProduct) table = products;
+
+  std::vector<Candidate>& candidates = scratch->candidates;
+  candidates.clear();
+  const size_t num_candidates = static_cast<size_t>(kRerankFactor) * k;
+  for (int64 i = 0; i < num_probes; ++i) {
+    const int32 list = lists[i];
+    float base = coarse[list];
+    if (metric_ == Metric::kL2) {
+      base *= 2.0f;
+      table = 2.0f * products - list_tables_.row(list).transpose();
+    }
+    const std::vector<int32>& list_nodes = list_nodes_[list];
+    const uint8* codes = list_codes_[list].data();
+    for (int64 j = 0; j < list_nodes.size(); ++j) {
+      float score = base;
+      for (int m = 0; m < num_subquantizers_; ++m) {
+        score += tables[m * num_codes_ + *codes++];
+      }
+      PushCandidate(score, list_nodes[j], num_candidates, &candidates);
+    }
+  }
+
+  // Re-ranks the candidates with the exact scores.
+  nodes->clear();
+  for (const Candidate& candidate : candidates) {
+    nodes->emplace_back(
+        Score(metric_, query, vector(candidate.second), dim_),
+        candidate.second);
+  }
+  const int64 size = std::min<int64>(k, nodes->size());
+  std::partial_sort(nodes->begin(), nodes->begin() + size, nodes->end(),
+                    std::greater<Candidate>());
+  nodes->resize(size);
+}
+
+}  // namespace ann
+}  // namespace tensorflow
@@ -0,0 +1,260 @@
+#ifndef TENSORFLOW_CORE_KERNELS_ANN_ANN_INDEX_H_
+#define TENSORFLOW_CORE_KERNELS_ANN_ANN_INDEX_H_
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace ann {
+
+// The similarity of the index vectors to the queries.
+enum class Metric { kInnerProduct, kL2 };
+
+// Parses the `metric` attr, "inner_product" or "l2".
+Status ParseMetric(const string& name, Metric* metric);
+
+// The score of the `dim`-dimensional vectors a and b, higher is closer: the
+// inner product, or the negated squared L2 distance.
+float Score(Metric metric, const float* a, const float* b, int64 dim);
+
+// Scores and ids of the nearest neighbors of a query, best first.
+typedef std::vector<std::pair<float, int64>> Neighbors;
+
+// Buffers of the searches, reused across the queries of a thread.
+struct SearchScratch {
+  // The nodes visited by a graph search are marked with `epoch`.
+  std::vector<uint32> visited;
+  uint32 epoch = 0;
+  // The lookup tables of product quantized distances.
+  std::vector<float> tables;
+  std::vector<std::pair<float, int32>> candidates;
+};
+
+// An approximate nearest neighbor index of (id, vector) pairs, e.g. of the
+// item embeddings of a two-tower model, shared by the serving sessions.
+// Searches run concurrently with each other and wait for the updates.
+//
+// Removed ids are only marked, their nodes keep linking the graph of an
+// HNSW index and their vectors are kept for a later update of the id.
+class AnnIndex : public ResourceBase {
+ public:
+  AnnIndex(int64 dim, Metric metric) : dim_(dim), metric_(metric) {}
+
+  int64 dim() const { return dim_; }
+  Metric metric() const { return metric_; }
+
+  // The number of ids, excluding the removed ones.
+  int64 size() const {
+    tf_shared_lock l(mu_);
+    return ids_.size() - num_removed_;
+  }
+
+  // Inserts the vectors of new or removed ids and replaces the vectors of
+  // known ids. Vectors equal to the indexed ones are skipped, so that
+  // re-running the update after a delta model load only re-indexes the
+  // changed items. `num_updated` is the number of inserted or replaced
+  // vectors.
+  Status Update(const int64* ids, const float* vectors, int64 n,
+                int64* num_updated);
+
+  // Removes the ids from the search results, e.g. of retired items. Returns
+  // the number of ids that were in the index.
+  int64 Remove(const int64* ids, int64 n);
+
+  // The k nearest neighbors of the query, or fewer if the index is smaller.
+  // `probe` trades speed for recall: the size of the candidate list of a
+  // graph search, or the number of inverted lists scanned.
+  void Search(const float* query, int k, int probe,
+              Neighbors* neighbors) const;
+
+ protected:
+  const float* vector(int32 node) const { return &vectors_[node * dim_]; }
+  int32 num_nodes() const { return ids_.size(); }
+
+  // Called with the new nodes of an update before they are inserted, e.g.
+  // to train the quantizers on the first one.
+  virtual void Prepare(const std::vector<int32>& nodes)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {}
+  // Adds a node whose vector was appended to the index.
+  virtual void Insert(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_) = 0;
+  // Re-indexes a node whose vector changed.
+  virtual void Replace(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_) = 0;
+  // Called when a node is removed, and when the removed node is updated
+  // again with its new vector.
+  virtual void Erase(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_) {}
+  virtual void Reinsert(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_) = 0;
+  // The k nearest nodes of the query, best first.
+  virtual void SearchNodes(const float* query, int k, int probe,
+                           SearchScratch* scratch,
+                           std::vector<std::pair<float, int32>>* nodes) const
+      SHARED_LOCKS_REQUIRED(mu_) = 0;
+
+  const int64 dim_;
+  const Metric metric_;
+
+  mutable mutex mu_;
+  // The vectors of the nodes, in insertion order.
+  std::vector<float> vectors_ GUARDED_BY(mu_);
+  std::vector<int64> ids_ GUARDED_BY(mu_);
+  std::unordered_map<int64, int32> nodes_ GUARDED_BY(mu_);
+  std::vector<bool> removed_ GUARDED_BY(mu_);
+  int64 num_removed_ GUARDED_BY(mu_) = 0;
+
+ private:
+  // The buffers of the searches are pooled, as the visited marks of a graph
+  // search are as large as the index.
+  std::unique_ptr<SearchScratch> AcquireScratch() const;
+  void ReleaseScratch(std::unique_ptr<SearchScratch> scratch) const;
+
+  mutable mutex scratch_mu_;
+  mutable std::vector<std::unique_ptr<SearchScratch>> scratches_
+      GUARDED_BY(scratch_mu_);
+};
+
+// A hierarchical navigable small world graph. Each node is linked to at
+// most `max_neighbors` close nodes on each of its levels, and to twice as
+// many on level 0. Nodes are inserted by a search of `ef_construction`
+// candidates and searched from the top level down with `probe` candidates.
+class HnswIndex : public AnnIndex {
+ public:
+  HnswIndex(int64 dim, Metric metric, int max_neighbors, int ef_construction,
+            int64 seed);
+
+  string DebugString() const override;
+
+ protected:
+  void Insert(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Replace(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Reinsert(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void SearchNodes(const float* query, int k, int probe,
+                   SearchScratch* scratch,
+                   std::vector<std::pair<float, int32>>* nodes) const override
+      SHARED_LOCKS_REQUIRED(mu_);
+
+ private:
+  // The links of a node on a level.
+  struct Links {
+    const int32* data;
+    int size;
+  };
+  Links GetLinks(int32 node, int level) const SHARED_LOCKS_REQUIRED(mu_);
+  void SetLinks(int32 node, int level, const std::vector<int32>& links)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  int MaxLinks(int level) const {
+    return level == 0 ? 2 * max_neighbors_ : max_neighbors_;
+  }
+
+  // Moves from `entry` to the closest node to the query on a level.
+  int32 SearchGreedy(const float* query, int32 entry, int level) const
+      SHARED_LOCKS_REQUIRED(mu_);
+  // The best `ef` nodes of a best-first search of a level from `entry`,
+  // best first. Removed nodes are passed through but not returned if
+  // `skip_removed`.
+  void SearchLevel(const float* query, int32 entry, int level, int ef,
+                   bool skip_removed, SearchScratch* scratch,
+                   std::vector<std::pair<float, int32>>* nodes) const
+      SHARED_LOCKS_REQUIRED(mu_);
+  // Keeps at most `m` of the candidates, best first, skipping those closer
+  // to a kept one than to the query so that the links span all directions.
+  void SelectNeighbors(const std::vector<std::pair<float, int32>>& candidates,
+                       int m, std::vector<int32>* neighbors) const
+      SHARED_LOCKS_REQUIRED(mu_);
+  // Links `node` to `neighbor` on a level, pruning the links of `neighbor`
+  // if there are too many.
+  void AddLink(int32 neighbor, int32 node, int level)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Links `node` to its neighbors on its levels, and back.
+  void Link(int32 node, bool replace) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int max_neighbors_;
+  const int ef_construction_;
+  const double level_mult_;
+  std::mt19937_64 random_ GUARDED_BY(mu_);
+  SearchScratch scratch_ GUARDED_BY(mu_);
+
+  // The level 0 links of node n are level0_[n * (2 * max_neighbors_ + 1)],
+  // their count followed by the nodes.
+  std::vector<int32> level0_ GUARDED_BY(mu_);
+  // The links of node n on level l > 0 are upper_[n][l - 1].
+  std::vector<std::vector<std::vector<int32>>> upper_ GUARDED_BY(mu_);
+  int32 entry_point_ GUARDED_BY(mu_) = -1;
+  int max_level_ GUARDED_BY(mu_) = -1;
+};
+
+// An inverted file index of product quantized residuals. The vectors are
+// assigned to the closest of `num_lists` k-means centroids, and the
+// residuals to the centroids encoded by `num_subquantizers` codes of 8 bits.
+// A search scans the `probe` lists of the closest centroids with lookup
+// tables, and re-ranks the best candidates with the exact scores. The
+// quantizers are trained on the first update and kept for the next ones.
+// Removed nodes are taken out of their lists.
+class IvfPqIndex : public AnnIndex {
+ public:
+  IvfPqIndex(int64 dim, Metric metric, int num_lists, int num_subquantizers,
+             int64 seed);
+
+  string DebugString() const override;
+
+ protected:
+  void Prepare(const std::vector<int32>& nodes) override
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Insert(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Replace(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Erase(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Reinsert(int32 node) override EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void SearchNodes(const float* query, int k, int probe,
+                   SearchScratch* scratch,
+                   std::vector<std::pair<float, int32>>* nodes) const override
+      SHARED_LOCKS_REQUIRED(mu_);
+
+ private:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                        Eigen::RowMajor>
+      Matrix;
+
+  // The list of the closest centroid to a vector.
+  int32 AssignList(const float* vector) const SHARED_LOCKS_REQUIRED(mu_);
+  // Appends the node to its list with the codes of its residual.
+  void AddToList(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Moves the last node of the list of the node to its position.
+  void RemoveFromList(int32 node) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int num_lists_;
+  const int num_subquantizers_;
+  const int64 sub_dim_;
+  std::mt19937_64 random_ GUARDED_BY(mu_);
+
+  bool trained_ GUARDED_BY(mu_) = false;
+  // [num_lists, dim] coarse centroids, and half their squared norms.
+  Matrix centroids_ GUARDED_BY(mu_);
+  Eigen::VectorXf half_norms_ GUARDED_BY(mu_);
+  // [num_subquantizers * num_codes, sub_dim] codebooks of the residuals.
+  Matrix codebooks_ GUARDED_BY(mu_);
+  int num_codes_ GUARDED_BY(mu_) = 0;
+  // For the L2 metric, the [num_lists, num_subquantizers * num_codes] terms
+  // |code|^2 + 2 centroid.code of the distances that do not depend on the
+  // query.
+  Matrix list_tables_ GUARDED_BY(mu_);
+
+  // The nodes of each list, and their codes.
+  std::vector<std::vector<int32>> list_nodes_ GUARDED_BY(mu_);
+  std::vector<std::vector<uint8>> list_codes_ GUARDED_BY(mu_);
+  // The list of each node and its position in the list.
+  std::vector<int32> node_lists_ GUARDED_BY(mu_);
+  std::vector<int32> node_positions_ GUARDED_BY(mu_);
+};
+
+}  // namespace ann
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_ANN_ANN_INDEX_H_
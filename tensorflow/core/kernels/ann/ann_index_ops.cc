@@ -0,0 +1,266 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/ann/ann_index.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+// Creates the index on the first run and outputs its handle.
+class AnnIndexOp : public OpKernel {
+ public:
+  explicit AnnIndexOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("dim", &dim_));
+    string metric;
+    OP_REQUIRES_OK(context, context->GetAttr("metric", &metric));
+    OP_REQUIRES_OK(context, ann::ParseMetric(metric, &metric_));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    mutex_lock l(mu_);
+    if (!initialized_) {
+      OP_REQUIRES_OK(context, cinfo_.Init(context->resource_manager(), def(),
+                                          /*use_node_name_as_default=*/true));
+      initialized_ = true;
+    }
+    ann::AnnIndex* index = nullptr;
+    OP_REQUIRES_OK(context,
+                   cinfo_.resource_manager()->LookupOrCreate<ann::AnnIndex>(
+                       cinfo_.container(), cinfo_.name(), &index,
+                       [this](ann::AnnIndex** ret) {
+                         *ret = CreateIndex();
+                         return Status::OK();
+                       }));
+    core::ScopedUnref unref(index);
+    OP_REQUIRES(context,
+                index->dim() == dim_ && index->metric() == metric_,
+                errors::InvalidArgument("The index ", cinfo_.name(),
+                                        " exists with another dim or metric: ",
+                                        index->DebugString()));
+
+    Tensor* handle = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &handle));
+    handle->scalar<ResourceHandle>()() = MakeResourceHandle<ann::AnnIndex>(
+        context, cinfo_.container(), cinfo_.name());
+  }
+
+ protected:
+  virtual ann::AnnIndex* CreateIndex() const = 0;
+
+  int64 dim_;
+  ann::Metric metric_;
+  int64 seed_;
+
+ private:
+  mutex mu_;
+  ContainerInfo cinfo_ GUARDED_BY(mu_);
+  bool initialized_ GUARDED_BY(mu_) = false;
+};
+
+class HnswIndexOp : public AnnIndexOp {
+ public:
+  explicit HnswIndexOp(OpKernelConstruction* context) : AnnIndexOp(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("max_neighbors", &max_neighbors_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("ef_construction", &ef_construction_));
+  }
+
+ protected:
+  ann::AnnIndex* CreateIndex() const override {
+    return new ann::HnswIndex(dim_, metric_, max_neighbors_, ef_construction_,
+                              seed_);
+  }
+
+ private:
+  int max_neighbors_;
+  int ef_construction_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("HnswIndex").Device(DEVICE_CPU), HnswIndexOp);
+
+class IvfPqIndexOp : public AnnIndexOp {
+ public:
+  explicit IvfPqIndexOp(OpKernelConstruction* context) : AnnIndexOp(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_lists", &num_lists_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("num_subquantizers", &num_subquantizers_));
+    OP_REQUIRES(context, dim_ % num_subquantizers_ == 0,
+                errors::InvalidArgument("dim ", dim_,
+                                        " is not a multiple of the ",
+                                        num_subquantizers_,
+                                        " subquantizers"));
+  }
+
+ protected:
+  ann::AnnIndex* CreateIndex() const override {
+    return new ann::IvfPqIndex(dim_, metric_, num_lists_, num_subquantizers_,
+                               seed_);
+  }
+
+ private:
+  int num_lists_;
+  int num_subquantizers_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("IvfPqIndex").Device(DEVICE_CPU), IvfPqIndexOp);
+
+class AnnIndexUpdateOp : public OpKernel {
+ public:
+  explicit AnnIndexUpdateOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    ann::AnnIndex* index = nullptr;
+    OP_REQUIRES_OK(
+        context, LookupResource(context, HandleFromInput(context, 0), &index));
+    core::ScopedUnref unref(index);
+    const Tensor& ids = context->input(1);
+    const Tensor& vectors = context->input(2);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids must be a vector, got ",
+                                        ids.shape().DebugString()));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsMatrix(vectors.shape()) &&
+                    vectors.dim_size(0) == ids.dim_size(0) &&
+                    vectors.dim_size(1) == index->dim(),
+                errors::InvalidArgument(
+                    "vectors must be of shape [", ids.dim_size(0), ", ",
+                    index->dim(), "], got ", vectors.shape().DebugString()));
+
+    int64 num_updated = 0;
+    OP_REQUIRES_OK(context, index->Update(ids.flat<int64>().data(),
+                                          vectors.flat<float>().data(),
+                                          ids.NumElements(), &num_updated));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &output));
+    output->scalar<int64>()() = num_updated;
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexUpdate").Device(DEVICE_CPU),
+                        AnnIndexUpdateOp);
+
+class AnnIndexRemoveOp : public OpKernel {
+ public:
+  explicit AnnIndexRemoveOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    ann::AnnIndex* index = nullptr;
+    OP_REQUIRES_OK(
+        context, LookupResource(context, HandleFromInput(context, 0), &index));
+    core::ScopedUnref unref(index);
+    const Tensor& ids = context->input(1);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids must be a vector, got ",
+                                        ids.shape().DebugString()));
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &output));
+    output->scalar<int64>()() =
+        index->Remove(ids.flat<int64>().data(), ids.NumElements());
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexRemove").Device(DEVICE_CPU),
+                        AnnIndexRemoveOp);
+
+// Searches the queries in parallel, sharing the index with its updates.
+class AnnIndexSearchOp : public OpKernel {
+ public:
+  explicit AnnIndexSearchOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    ann::AnnIndex* index = nullptr;
+    OP_REQUIRES_OK(
+        context, LookupResource(context, HandleFromInput(context, 0), &index));
+    core::ScopedUnref unref(index);
+    const Tensor& queries = context->input(1);
+    const Tensor& k_tensor = context->input(2);
+    const Tensor& probe_tensor = context->input(3);
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsMatrix(queries.shape()) &&
+                    queries.dim_size(1) == index->dim(),
+                errors::InvalidArgument(
+                    "queries must be of shape [batch, ", index->dim(),
+                    "], got ", queries.shape().DebugString()));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsScalar(k_tensor.shape()) &&
+                    TensorShapeUtils::IsScalar(probe_tensor.shape()),
+                errors::InvalidArgument("k and probe must be scalars"));
+    const int k = k_tensor.scalar<int32>()();
+    const int probe = probe_tensor.scalar<int32>()();
+    OP_REQUIRES(context, k > 0 && probe > 0,
+                errors::InvalidArgument("k and probe must be positive, got ",
+                                        k, " and ", probe));
+
+    const int64 batch = queries.dim_size(0);
+    Tensor* scores = nullptr;
+    Tensor* ids = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({batch, k}), &scores));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({batch, k}), &ids));
+    const float* query = queries.flat<float>().data();
+    float* score = scores->flat<float>().data();
+    int64* id = ids->flat<int64>().data();
+    const int64 dim = index->dim();
+
+    // A query scores about `probe` candidates, or a few lists of vectors.
+    const int64 cost = 20 * std::max(k, probe) * dim;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        batch, cost, [&](int64 begin, int64 end) {
+          ann::Neighbors neighbors;
+          for (int64 b = begin; b < end; ++b) {
+            index->Search(query + b * dim, k, probe, &neighbors);
+            for (int j = 0; j < k; ++j) {
+              if (j < neighbors.size()) {
+                score[b * k + j] = neighbors[j].first;
+                id[b * k + j] = neighbors[j].second;
+              } else {
+                score[b * k + j] = -std::numeric_limits<float>::infinity();
+                id[b * k + j] = -1;
+              }
+            }
+          }
+        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexSearch").Device(DEVICE_CPU),
+                        AnnIndexSearchOp);
+
+class AnnIndexSizeOp : public OpKernel {
+ public:
+  explicit AnnIndexSizeOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    ann::AnnIndex* index = nullptr;
+    OP_REQUIRES_OK(
+        context, LookupResource(context, HandleFromInput(context, 0), &index));
+    core::ScopedUnref unref(index);
+    Tensor* size = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &size));
+    size->scalar<int64>()() = index->size();
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("AnnIndexSize").Device(DEVICE_CPU),
+                        AnnIndexSizeOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ann/ann_index.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+// n unit vectors around 100 random centers, like the l2-normalized item and
+// user embeddings of modelzoo/dssm. The centers do not depend on the seed.
+std::vector<float> ClusteredVectors(int n, int dim, int seed) {
+  std::mt19937 random(0);
+  std::normal_distribution<float> normal;
+  std::vector<float> centers(100 * dim);
+  for (float& c : centers) c = normal(random);
+  random.seed(seed + 1);
+  std::vector<float> vectors(n * dim);
+  for (int i = 0; i < n; ++i) {
+    const float* center = &centers[(random() % 100) * dim];
+    float* v = &vectors[i * dim];
+    double norm = 0;
+    for (int j = 0; j < dim; ++j) {
+      v[j] = center[j] + 0.7f * normal(random);
+      norm += v[j] * v[j];
+    }
+    for (int j = 0; j < dim; ++j) v[j] /= std::sqrt(norm);
+  }
+  return vectors;
+}
+
+std::vector<int64> ItemIds(int n) {
+  std::vector<int64> ids(n);
+  for (int i = 0; i < n; ++i) ids[i] = 1000 + 7 * i;
+  return ids;
+}
+
+// The ids of the k nearest items of each query by brute force.
+std::vector<std::vector<int64>> ExactNeighbors(
+    const std::vector<float>& items, const std::vector<int64>& ids,
+    const std::vector<float>& queries, int dim, int k, ann::Metric metric) {
+  const int n = ids.size();
+  std::vector<std::vector<int64>> neighbors;
+  for (int q = 0; q < queries.size() / dim; ++q) {
+    std::vector<std::pair<double, int64>> scores(n);
+    for (int i = 0; i < n; ++i) {
+      double score = 0;
+      for (int j = 0; j < dim; ++j) {
+        const double a = queries[q * dim + j];
+        const double b = items[i * dim + j];
+        score += metric == ann::Metric::kInnerProduct ? a * b
+                                                      : -(a - b) * (a - b);
+      }
+      scores[i] = {score, ids[i]};
+    }
+    std::partial_sort(scores.begin(), scores.begin() + k, scores.end(),
+                      std::greater<std::pair<double, int64>>());
+    neighbors.emplace_back();
+    for (int j = 0; j < k; ++j) neighbors.back().push_back(scores[j].second);
+  }
+  return neighbors;
+}
+
+// The fraction of the exact neighbors in the [B, k] ids.
+double Recall(const std::vector<std::vector<int64>>& exact, const int64* ids) {
+  int hits = 0;
+  int total = 0;
+  for (int q = 0; q < exact.size(); ++q) {
+    const int k = exact[q].size();
+    std::unordered_set<int64> found(ids + q * k, ids + (q + 1) * k);
+    for (int64 id : exact[q]) hits += found.count(id);
+    total += k;
+  }
+  return static_cast<double>(hits) / total;
+}
+
+class AnnIndexOpsTest : public OpsTestBase {
+ protected:
+  static constexpr int kDim = 16;
+
+  ann::AnnIndex* NewHnswIndex(ann::Metric metric) {
+    return new ann::HnswIndex(kDim, metric, /*max_neighbors=*/8,
+                              /*ef_construction=*/100, /*seed=*/0);
+  }
+
+  ann::AnnIndex* NewIvfPqIndex(ann::Metric metric) {
+    return new ann::IvfPqIndex(kDim, metric, /*num_lists=*/16,
+                               /*num_subquantizers=*/4, /*seed=*/0);
+  }
+
+  // Runs AnnIndexUpdate on the index and returns num_updated.
+  int64 Update(ann::AnnIndex* index, const std::vector<int64>& ids,
+               const std::vector<float>& vectors) {
+    TF_CHECK_OK(NodeDefBuilder("update", "AnnIndexUpdate")
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Input(FakeInput(DT_INT64))
+                    .Input(FakeInput(DT_FLOAT))
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    inputs_.clear();
+    index->Ref();
+    AddResourceInput<ann::AnnIndex>("", strings::StrCat("index_", ++runs_),
+                                    index);
+    AddInputFromArray<int64>(TensorShape({static_cast<int64>(ids.size())}),
+                             ids);
+    AddInputFromArray<float>(
+        TensorShape({static_cast<int64>(ids.size()), kDim}), vectors);
+    TF_CHECK_OK(RunOpKernel());
+    return GetOutput(0)->scalar<int64>()();
+  }
+
+  // Runs AnnIndexRemove on the index and returns num_removed.
+  int64 Remove(ann::AnnIndex* index, const std::vector<int64>& ids) {
+    TF_CHECK_OK(NodeDefBuilder("remove", "AnnIndexRemove")
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Input(FakeInput(DT_INT64))
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    inputs_.clear();
+    index->Ref();
+    AddResourceInput<ann::AnnIndex>("", strings::StrCat("index_", ++runs_),
+                                    index);
+    AddInputFromArray<int64>(TensorShape({static_cast<int64>(ids.size())}),
+                             ids);
+    TF_CHECK_OK(RunOpKernel());
+    return GetOutput(0)->scalar<int64>()();
+  }
+
+  // Runs AnnIndexSearch on the index.
+  Status Search(ann::AnnIndex* index, const std::vector<float>& queries,
+                int k, int probe) {
+    TF_CHECK_OK(NodeDefBuilder("search", "AnnIndexSearch")
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Input(FakeInput(DT_FLOAT))
+                    .Input(FakeInput(DT_INT32))
+                    .Input(FakeInput(DT_INT32))
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    inputs_.clear();
+    index->Ref();
+    AddResourceInput<ann::AnnIndex>("", strings::StrCat("index_", ++runs_),
+                                    index);
+    AddInputFromArray<float>(
+        TensorShape({static_cast<int64>(queries.size() / kDim), kDim}),
+        queries);
+    AddInputFromArray<int32>(TensorShape({}), {k});
+    AddInputFromArray<int32>(TensorShape({}), {probe});
+    return RunOpKernel();
+  }
+
+  // Checks the recall of the index and that its scores are exact.
+  void ExpectRecall(ann::AnnIndex* index, ann::Metric metric, int probe,
+                    double min_recall) {
+    const int n = 2000;
+    const std::vector<float> items = ClusteredVectors(n, kDim, 0);
+    const std::vector<int64> ids = ItemIds(n);
+    EXPECT_EQ(n, Update(index, ids, items));
+    EXPECT_EQ(n, index->size());
+
+    const std::vector<float> queries = ClusteredVectors(50, kDim, 1);
+    TF_ASSERT_OK(Search(index, queries, 10, probe));
+    const int64* found = GetOutput(1)->flat<int64>().data();
+    const float* scores = GetOutput(0)->flat<float>().data();
+    EXPECT_GE(Recall(ExactNeighbors(items, ids, queries, kDim, 10, metric),
+                     found),
+              min_recall);
+    for (int q = 0; q < 50; ++q) {
+      for (int j = 0; j < 10; ++j) {
+        const int64 i = (found[q * 10 + j] - 1000) / 7;
+        ASSERT_GE(i, 0);
+        ASSERT_LT(i, n);
+        EXPECT_NEAR(ann::Score(metric, &queries[q * kDim], &items[i * kDim],
+                               kDim),
+                    scores[q * 10 + j], 1e-5);
+        if (j > 0) EXPECT_LE(scores[q * 10 + j], scores[q * 10 + j - 1]);
+      }
+    }
+  }
+
+  int runs_ = 0;
+};
+
+TEST_F(AnnIndexOpsTest, ScoreMatchesMetrics) {
+  // 37 dimensions cover full and partial SIMD blocks.
+  std::vector<float> a(37);
+  std::vector<float> b(37);
+  double dot = 0;
+  double distance = 0;
+  for (int i = 0; i < 37; ++i) {
+    a[i] = std::sin(0.3f * i);
+    b[i] = std::cos(0.7f * i);
+    dot += a[i] * b[i];
+    distance += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  EXPECT_NEAR(dot, ann::Score(ann::Metric::kInnerProduct, a.data(), b.data(),
+                              37),
+              1e-5);
+  EXPECT_NEAR(-distance, ann::Score(ann::Metric::kL2, a.data(), b.data(), 37),
+              1e-5);
+}
+
+TEST_F(AnnIndexOpsTest, HnswInnerProduct) {
+  ann::AnnIndex* index = NewHnswIndex(ann::Metric::kInnerProduct);
+  core::ScopedUnref unref(index);
+  ExpectRecall(index, ann::Metric::kInnerProduct, 64, 0.95);
+}
+
+TEST_F(AnnIndexOpsTest, HnswL2) {
+  ann::AnnIndex* index = NewHnswIndex(ann::Metric::kL2);
+  core::ScopedUnref unref(index);
+  ExpectRecall(index, ann::Metric::kL2, 64, 0.95);
+}
+
+TEST_F(AnnIndexOpsTest, IvfPqInnerProduct) {
+  ann::AnnIndex* index = NewIvfPqIndex(ann::Metric::kInnerProduct);
+  core::ScopedUnref unref(index);
+  ExpectRecall(index, ann::Metric::kInnerProduct, 8, 0.9);
+}
+
+TEST_F(AnnIndexOpsTest, IvfPqL2) {
+  ann::AnnIndex* index = NewIvfPqIndex(ann::Metric::kL2);
+  core::ScopedUnref unref(index);
+  ExpectRecall(index, ann::Metric::kL2, 8, 0.9);
+}
+
+TEST_F(AnnIndexOpsTest, UpdatesOnlyChangedVectors) {
+  for (bool hnsw : {true, false}) {
+    ann::AnnIndex* index = hnsw ? NewHnswIndex(ann::Metric::kL2)
+                                : NewIvfPqIndex(ann::Metric::kL2);
+    core::ScopedUnref unref(index);
+    const int n = 1000;
+    std::vector<float> items = ClusteredVectors(n, kDim, 0);
+    const std::vector<int64> ids = ItemIds(n);
+    EXPECT_EQ(n, Update(index, ids, items));
+    // The restored embeddings of a delta model load, with 3 changed items.
+    EXPECT_EQ(0, Update(index, ids, items));
+    const std::vector<float> queries = ClusteredVectors(3, kDim, 2);
+    std::copy(queries.begin(), queries.end(), items.begin() + 10 * kDim);
+    EXPECT_EQ(3, Update(index, ids, items));
+    EXPECT_EQ(n, index->size());
+    // New items are inserted.
+    const std::vector<float> added = ClusteredVectors(5, kDim, 3);
+    EXPECT_EQ(5, Update(index, {1, 2, 3, 4, 5}, added));
+    EXPECT_EQ(n + 5, index->size());
+
+    // The changed items are found at their new vectors.
+    TF_ASSERT_OK(Search(index, queries, 1, 16));
+    test::ExpectTensorEqual<int64>(
+        test::AsTensor<int64>({ids[10], ids[11], ids[12]}, {3, 1}),
+        *GetOutput(1));
+    test::ExpectTensorNear<float>(test::AsTensor<float>({0, 0, 0}, {3, 1}),
+                                  *GetOutput(0), 1e-6);
+  }
+}
+
+TEST_F(AnnIndexOpsTest, RemovesItems) {
+  for (bool hnsw : {true, false}) {
+    ann::AnnIndex* index = hnsw ? NewHnswIndex(ann::Metric::kL2)
+                                : NewIvfPqIndex(ann::Metric::kL2);
+    core::ScopedUnref unref(index);
+    const int n = 1000;
+    const std::vector<float> items = ClusteredVectors(n, kDim, 0);
+    const std::vector<int64> ids = ItemIds(n);
+    EXPECT_EQ(n, Update(index, ids, items));
+    // Retires 100 items, and an unknown id.
+    std::vector<int64> retired(ids.begin() + 10, ids.begin() + 110);
+    retired.push_back(1);
+    EXPECT_EQ(100, Remove(index, retired));
+    EXPECT_EQ(0, Remove(index, retired));
+    EXPECT_EQ(n - 100, index->size());
+
+    // Searches at the retired items find the remaining ones.
+    const std::vector<float> queries(items.begin() + 10 * kDim,
+                                     items.begin() + 13 * kDim);
+    TF_ASSERT_OK(Search(index, queries, 10, 32));
+    const std::unordered_set<int64> removed(retired.begin(), retired.end());
+    for (int i = 0; i < 30; ++i) {
+      const int64 id = GetOutput(1)->flat<int64>()(i);
+      EXPECT_NE(-1, id);
+      EXPECT_EQ(0, removed.count(id)) << id;
+    }
+
+    // An update of a removed item inserts it again, with the same vector.
+    const std::vector<float> item(queries.begin(), queries.begin() + kDim);
+    EXPECT_EQ(1, Update(index, {ids[10]}, item));
+    EXPECT_EQ(n - 99, index->size());
+    TF_ASSERT_OK(Search(index, item, 1, 32));
+    EXPECT_EQ(ids[10], GetOutput(1)->flat<int64>()(0));
+    EXPECT_NEAR(0, GetOutput(0)->flat<float>()(0), 1e-6);
+  }
+}
+
+TEST_F(AnnIndexOpsTest, PadsMissingNeighbors) {
+  ann::AnnIndex* index = NewHnswIndex(ann::Metric::kInnerProduct);
+  core::ScopedUnref unref(index);
+  TF_ASSERT_OK(Search(index, ClusteredVectors(1, kDim, 0), 2, 8));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({-1, -1}, {1, 2}),
+                                 *GetOutput(1));
+
+  EXPECT_EQ(1, Update(index, {42}, ClusteredVectors(1, kDim, 0)));
+  TF_ASSERT_OK(Search(index, ClusteredVectors(1, kDim, 1), 3, 8));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({42, -1, -1}, {1, 3}),
+                                 *GetOutput(1));
+  EXPECT_EQ(-std::numeric_limits<float>::infinity(),
+            GetOutput(0)->flat<float>()(2));
+}
+
+TEST_F(AnnIndexOpsTest, InvalidQueries) {
+  ann::AnnIndex* index = NewHnswIndex(ann::Metric::kInnerProduct);
+  core::ScopedUnref unref(index);
+  Status s = Search(index, std::vector<float>(kDim), 0, 8);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  inputs_.clear();
+  TF_CHECK_OK(NodeDefBuilder("search", "AnnIndexSearch")
+                  .Input(FakeInput(DT_RESOURCE))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_INT32))
+                  .Input(FakeInput(DT_INT32))
+                  .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  index->Ref();
+  AddResourceInput<ann::AnnIndex>("", "invalid", index);
+  AddInputFromArray<float>(TensorShape({2, kDim - 1}),
+                           std::vector<float>(2 * (kDim - 1)));
+  AddInputFromArray<int32>(TensorShape({}), {1});
+  AddInputFromArray<int32>(TensorShape({}), {8});
+  s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(AnnIndexOpsTest, IndexOpSharesIndex) {
+  TF_ASSERT_OK(NodeDefBuilder("index", "IvfPqIndex")
+                   .Attr("dim", kDim)
+                   .Attr("metric", "l2")
+                   .Attr("num_subquantizers", 4)
+                   .Attr("shared_name", "items")
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  TF_ASSERT_OK(RunOpKernel());
+  const ResourceHandle& handle = GetOutput(0)->scalar<ResourceHandle>()();
+  EXPECT_EQ("items", handle.name());
+  ann::AnnIndex* index = nullptr;
+  TF_ASSERT_OK(device_->resource_manager()->Lookup<ann::AnnIndex>(
+      handle.container(), "items", &index));
+  core::ScopedUnref unref(index);
+  EXPECT_EQ(kDim, index->dim());
+  EXPECT_EQ(ann::Metric::kL2, index->metric());
+
+  // Another op of the same shared_name and another dim.
+  TF_ASSERT_OK(NodeDefBuilder("other", "HnswIndex")
+                   .Attr("dim", 2 * kDim)
+                   .Attr("shared_name", "items")
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+
+  TF_ASSERT_OK(NodeDefBuilder("invalid", "IvfPqIndex")
+                   .Attr("dim", kDim)
+                   .Attr("num_subquantizers", 3)
+                   .Finalize(node_def()));
+  s = InitOp();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+// Top 10 retrieval of a batch of 64 user embeddings among the 64-d
+// embeddings of `n` items, with the QPS of the search op and the recall@10
+// against brute force in the label.
+constexpr int kBenchmarkDim = 64;
+constexpr int kBenchmarkBatch = 64;
+constexpr int kBenchmarkK = 10;
+
+static Output VectorsConst(const Scope& s, const std::vector<float>& vectors) {
+  Tensor t(DT_FLOAT, TensorShape({static_cast<int64>(vectors.size()) /
+                                      kBenchmarkDim,
+                                  kBenchmarkDim}));
+  std::copy(vectors.begin(), vectors.end(), t.flat<float>().data());
+  return ops::Const(s, Input::Initializer(t));
+}
+
+static Graph* BruteForceSearch(int n) {
+  Scope s = Scope::NewRootScope();
+  Output items = VectorsConst(s, ClusteredVectors(n, kBenchmarkDim, 0));
+  Output queries =
+      VectorsConst(s, ClusteredVectors(kBenchmarkBatch, kBenchmarkDim, 1));
+  auto scores = ops::MatMul(s, queries, items, ops::MatMul::TransposeB(true));
+  ops::TopK(s, scores, kBenchmarkK);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+static Node* IndexNode(const string& op, Graph* g) {
+  Node* index = nullptr;
+  NodeBuilder builder(g->NewName("index"), op);
+  builder.Attr("dim", kBenchmarkDim).Attr("shared_name", "items");
+  if (op == "IvfPqIndex") builder.Attr("num_lists", 256);
+  TF_CHECK_OK(builder.Finalize(g, &index));
+  return index;
+}
+
+static Graph* IndexUpdate(const string& op, int n) {
+  Scope s = Scope::NewRootScope();
+  Output items = VectorsConst(s, ClusteredVectors(n, kBenchmarkDim, 0));
+  const std::vector<int64> item_ids = ItemIds(n);
+  Tensor ids_tensor(DT_INT64, TensorShape({n}));
+  std::copy(item_ids.begin(), item_ids.end(), ids_tensor.flat<int64>().data());
+  Output ids = ops::Const(s, Input::Initializer(ids_tensor));
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("update"), "AnnIndexUpdate")
+                  .Input(IndexNode(op, g))
+                  .Input(nodes[ids.node()->name()])
+                  .Input(nodes[items.node()->name()])
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+static Graph* IndexSearch(const string& op, int probe) {
+  Scope s = Scope::NewRootScope();
+  Output queries =
+      VectorsConst(s, ClusteredVectors(kBenchmarkBatch, kBenchmarkDim, 1));
+  Output k = ops::Const(s, kBenchmarkK);
+  Output probes = ops::Const(s, probe);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("search"), "AnnIndexSearch")
+                  .Input(IndexNode(op, g))
+                  .Input(nodes[queries.node()->name()])
+                  .Input(nodes[k.node()->name()])
+                  .Input(nodes[probes.node()->name()])
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// The recall@10 of the index with `probe`. The indexes are built once per
+// size.
+static double IndexRecall(const string& op, int n, int probe) {
+  static auto* indexes = new std::map<std::pair<string, int>, ann::AnnIndex*>;
+  ann::AnnIndex*& index = (*indexes)[{op, n}];
+  const std::vector<int64> ids = ItemIds(n);
+  const std::vector<float> items = ClusteredVectors(n, kBenchmarkDim, 0);
+  if (index == nullptr) {
+    if (op == "HnswIndex") {
+      index = new ann::HnswIndex(kBenchmarkDim, ann::Metric::kInnerProduct,
+                                 16, 200, 0);
+    } else {
+      index = new ann::IvfPqIndex(kBenchmarkDim, ann::Metric::kInnerProduct,
+                                  256, 8, 0);
+    }
+    int64 num_updated;
+    TF_CHECK_OK(index->Update(ids.data(), items.data(), n, &num_updated));
+  }
+  const std::vector<float> queries =
+      ClusteredVectors(kBenchmarkBatch, kBenchmarkDim, 1);
+  std::vector<int64> found;
+  ann::Neighbors neighbors;
+  for (int q = 0; q < kBenchmarkBatch; ++q) {
+    index->Search(&queries[q * kBenchmarkDim], kBenchmarkK, probe,
+                  &neighbors);
+    for (int j = 0; j < kBenchmarkK; ++j) {
+      found.push_back(j < neighbors.size() ? neighbors[j].second : -1);
+    }
+  }
+  return Recall(ExactNeighbors(items, ids, queries, kBenchmarkDim,
+                               kBenchmarkK, ann::Metric::kInnerProduct),
+                found.data());
+}
+
+static Graph* HnswIndexInit(int n) { return IndexUpdate("HnswIndex", n); }
+static Graph* IvfPqIndexInit(int n) { return IndexUpdate("IvfPqIndex", n); }
+static Graph* HnswIndexSearch(int n, int probe) {
+  return IndexSearch("HnswIndex", probe);
+}
+static Graph* IvfPqIndexSearch(int n, int probe) {
+  return IndexSearch("IvfPqIndex", probe);
+}
+
+#define BM_ANN_SEARCH(KIND, N, PROBE, NTH)                                    \
+  static void BM_##KIND##Search_##N##_##PROBE##_##NTH##_CPU(int iters) {      \
+    testing::StopTiming();                                                    \
+    testing::SetLabel(strings::StrCat(                                        \
+        "recall@10 ", IndexRecall(#KIND, N, PROBE)));                         \
+    testing::UseRealTime();                                                   \
+    testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);     \
+    SessionOptions opts;                                                      \
+    opts.config.set_intra_op_parallelism_threads(NTH);                        \
+    test::Benchmark("cpu", KIND##Search(N, PROBE), &opts, KIND##Init(N))      \
+        .Run(iters);                                                          \
+  }                                                                           \
+  BENCHMARK(BM_##KIND##Search_##N##_##PROBE##_##NTH##_CPU);
+
+#define BM_BRUTE_FORCE_SEARCH(N, NTH)                                        \
+  static void BM_BruteForceSearch_##N##_##NTH##_CPU(int iters) {             \
+    testing::SetLabel("recall@10 1");                                        \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);    \
+    SessionOptions opts;                                                     \
+    opts.config.set_intra_op_parallelism_threads(NTH);                       \
+    test::Benchmark("cpu", BruteForceSearch(N), &opts).Run(iters);        \
+  }                                                                          \
+  BENCHMARK(BM_BruteForceSearch_##N##_##NTH##_CPU);
+
+// Recall versus QPS curves of 50k items. The indexes are built again for
+// each run of a benchmark.
+#define BM_ANN_SEARCH_NTH(N)               \
+  BM_BRUTE_FORCE_SEARCH(N, 1);             \
+  BM_BRUTE_FORCE_SEARCH(N, 8);             \
+  BM_ANN_SEARCH(HnswIndex, N, 16, 1);      \
+  BM_ANN_SEARCH(HnswIndex, N, 64, 1);      \
+  BM_ANN_SEARCH(HnswIndex, N, 256, 1);     \
+  BM_ANN_SEARCH(HnswIndex, N, 64, 8);      \
+  BM_ANN_SEARCH(IvfPqIndex, N, 4, 1);      \
+  BM_ANN_SEARCH(IvfPqIndex, N, 16, 1);     \
+  BM_ANN_SEARCH(IvfPqIndex, N, 64, 1);     \
+  BM_ANN_SEARCH(IvfPqIndex, N, 16, 8);
+
+BM_ANN_SEARCH_NTH(50000);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,335 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+// The concatenated input is only ever built kBatchBlock rows and
+// kPanelColumns columns at a time, in a panel that stays in cache for the
+// GEMM with the matching kernel rows. The products of the panels are
+// accumulated into the output rows of the block.
+constexpr int64 kBatchBlock = 64;
+constexpr int64 kPanelColumns = 256;
+
+// The N [B, D_i] inputs as the columns of their [B, K] concatenation.
+struct ConcatLayout {
+  int64 batch = 0;
+  int64 depth = 0;
+  int64 units = 0;
+  std::vector<const float*> inputs;
+  // The first column of each input, and K.
+  std::vector<int64> offsets;
+
+  int num_inputs() const { return inputs.size(); }
+  int64 Cols(int i) const { return offsets[i + 1] - offsets[i]; }
+
+  // The first input with columns in [begin, ...).
+  int First(int64 begin) const {
+    return std::upper_bound(offsets.begin(), offsets.end(), begin) -
+           offsets.begin() - 1;
+  }
+
+  // Copies the columns [begin, end) of the rows [row, row + rows) of the
+  // concatenation into `panel`.
+  void Pack(int64 row, int64 rows, int64 begin, int64 end,
+            Matrix* panel) const {
+    panel->resize(rows, end - begin);
+    for (int i = First(begin); i < num_inputs() && offsets[i] < end; ++i) {
+      const int64 cols = Cols(i);
+      const int64 lo = std::max(begin, offsets[i]);
+      const int64 n = std::min(end, offsets[i + 1]) - lo;
+      const float* src = inputs[i] + row * cols + (lo - offsets[i]);
+      for (int64 r = 0; r < rows; ++r) {
+        std::copy_n(src + r * cols, n, panel->data() + r * panel->cols() +
+                                           (lo - begin));
+      }
+    }
+  }
+
+  // The inverse of Pack, into the [B, D_i] `outputs`.
+  void Unpack(const Matrix& panel, int64 row, int64 begin,
+              const std::vector<float*>& outputs) const {
+    const int64 end = begin + panel.cols();
+    for (int i = First(begin); i < num_inputs() && offsets[i] < end; ++i) {
+      const int64 cols = Cols(i);
+      const int64 lo = std::max(begin, offsets[i]);
+      const int64 n = std::min(end, offsets[i + 1]) - lo;
+      float* dst = outputs[i] + row * cols + (lo - offsets[i]);
+      for (int64 r = 0; r < panel.rows(); ++r) {
+        std::copy_n(panel.data() + r * panel.cols() + (lo - begin), n,
+                    dst + r * cols);
+      }
+    }
+  }
+};
+
+Status GetConcatLayout(const OpInputList& inputs, const Tensor& kernel,
+                       ConcatLayout* layout) {
+  layout->offsets.push_back(0);
+  for (int i = 0; i < inputs.size(); ++i) {
+    if (inputs[i].dims() != 2 ||
+        (i > 0 && inputs[i].dim_size(0) != layout->batch)) {
+      return errors::InvalidArgument("inputs[", i, "] must be [",
+                                     i > 0 ? layout->batch : -1, ", D], got ",
+                                     inputs[i].shape().DebugString());
+    }
+    layout->batch = inputs[i].dim_size(0);
+    layout->inputs.push_back(inputs[i].flat<float>().data());
+    layout->depth += inputs[i].dim_size(1);
+    layout->offsets.push_back(layout->depth);
+  }
+  if (kernel.dims() != 2 || kernel.dim_size(0) != layout->depth) {
+    return errors::InvalidArgument("kernel must be [", layout->depth,
+                                   ", O], got ",
+                                   kernel.shape().DebugString());
+  }
+  layout->units = kernel.dim_size(1);
+  return Status::OK();
+}
+
+Status CheckShape(const Tensor& tensor, const TensorShape& shape,
+                  const char* name) {
+  if (tensor.shape() != shape) {
+    return errors::InvalidArgument(name, " must be ", shape.DebugString(),
+                                   ", got ", tensor.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+// Returns the number of kernel rows of a backward panel, so that the kernel
+// gradient, which is split by panels, runs on all the threads.
+int64 KernelGradPanelColumns(int64 depth, int num_threads) {
+  const int64 cols = (depth + num_threads - 1) / num_threads;
+  return std::max<int64>(16, std::min(kPanelColumns, (cols + 15) / 16 * 16));
+}
+
+}  // namespace
+
+// The dense layer of concatenated inputs, see the ConcatMatMul op. Each
+// block of rows multiplies the column panels of the concatenation by the
+// matching kernel rows, followed by the bias and activation while the
+// output rows are in cache.
+template <typename T>
+class ConcatMatMulOp : public OpKernel {
+ public:
+  explicit ConcatMatMulOp(OpKernelConstruction* context) : OpKernel(context) {
+    string activation;
+    OP_REQUIRES_OK(context, context->GetAttr("activation", &activation));
+    relu_ = activation == "Relu";
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OpInputList inputs;
+    OpInputList bias;
+    OP_REQUIRES_OK(context, context->input_list("inputs", &inputs));
+    OP_REQUIRES_OK(context, context->input_list("bias", &bias));
+    const Tensor& kernel = context->input(inputs.size());
+    ConcatLayout layout;
+    OP_REQUIRES_OK(context, GetConcatLayout(inputs, kernel, &layout));
+    const int64 b = layout.batch;
+    const int64 k = layout.depth;
+    const int64 o = layout.units;
+    OP_REQUIRES(context, bias.size() <= 1,
+                errors::InvalidArgument("Expected at most one bias, got ",
+                                        bias.size()));
+    if (bias.size() == 1) {
+      OP_REQUIRES_OK(context, CheckShape(bias[0], TensorShape({o}), "bias"));
+    }
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({b, o}), &output_tensor));
+    if (output_tensor->NumElements() == 0) return;
+    T* output = output_tensor->flat<T>().data();
+    const ConstMatrixMap weights(kernel.flat<T>().data(), k, o);
+
+    const int64 num_blocks = (b + kBatchBlock - 1) / kBatchBlock;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        num_blocks, kBatchBlock * (2 * k * o + 3 * o),
+        [&](int64 begin, int64 end) {
+          Matrix panel;
+          for (int64 block = begin; block < end; ++block) {
+            const int64 row = block * kBatchBlock;
+            const int64 rows = std::min(kBatchBlock, b - row);
+            MatrixMap out(output + row * o, rows, o);
+            if (k == 0) out.setZero();
+            for (int64 col = 0; col < k; col += kPanelColumns) {
+              const int64 cols = std::min(kPanelColumns, k - col);
+              layout.Pack(row, rows, col, col + cols, &panel);
+              if (col == 0) {
+                out.noalias() = panel * weights.middleRows(col, cols);
+              } else {
+                out.noalias() += panel * weights.middleRows(col, cols);
+              }
+            }
+            if (bias.size() == 1) {
+              out.rowwise() += ConstRowVectorMap(bias[0].flat<T>().data(), o);
+            }
+            if (relu_) out = out.cwiseMax(0.0f);
+          }
+        });
+  }
+
+ private:
+  bool relu_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("ConcatMatMul").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ConcatMatMulOp<float>);
+
+// The gradients of ConcatMatMul. The input gradients are computed by blocks
+// of rows, panel by panel, and unpacked into the inputs they belong to. The
+// kernel gradient is split by panels of kernel rows, each accumulated over
+// all the blocks in order, so the results do not depend on the scheduling.
+template <typename T>
+class ConcatMatMulGradOp : public OpKernel {
+ public:
+  explicit ConcatMatMulGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string activation;
+    OP_REQUIRES_OK(context, context->GetAttr("activation", &activation));
+    relu_ = activation == "Relu";
+    OP_REQUIRES_OK(context, context->GetAttr("num_bias", &num_bias_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OpInputList inputs;
+    OP_REQUIRES_OK(context, context->input_list("inputs", &inputs));
+    const int n = inputs.size();
+    const Tensor& kernel = context->input(n);
+    const Tensor& output = context->input(n + 1);
+    const Tensor& output_grad_tensor = context->input(n + 2);
+    ConcatLayout layout;
+    OP_REQUIRES_OK(context, GetConcatLayout(inputs, kernel, &layout));
+    const int64 b = layout.batch;
+    const int64 k = layout.depth;
+    const int64 o = layout.units;
+    const TensorShape output_shape({b, o});
+    OP_REQUIRES_OK(context, CheckShape(output, output_shape, "output"));
+    OP_REQUIRES_OK(context, CheckShape(output_grad_tensor, output_shape,
+                                       "output_grad"));
+
+    OpOutputList inputs_grad;
+    OP_REQUIRES_OK(context, context->output_list("inputs_grad",
+                                                 &inputs_grad));
+    std::vector<float*> inputs_grad_data;
+    for (int i = 0; i < n; ++i) {
+      Tensor* input_grad = nullptr;
+      OP_REQUIRES_OK(context,
+                     inputs_grad.allocate(i, inputs[i].shape(), &input_grad));
+      inputs_grad_data.push_back(input_grad->flat<T>().data());
+    }
+    Tensor* kernel_grad = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(n, kernel.shape(), &kernel_grad));
+    Tensor* bias_grad = nullptr;
+    if (num_bias_ == 1) {
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  n + 1, TensorShape({o}), &bias_grad));
+    }
+    if (b == 0 || o == 0) {
+      kernel_grad->flat<T>().setZero();
+      if (bias_grad != nullptr) bias_grad->flat<T>().setZero();
+      for (int i = 0; i < n; ++i) inputs_grad[i]->flat<T>().setZero();
+      return;
+    }
+
+    // The gradient of the product, masked by the relu.
+    const T* output_grad = output_grad_tensor.flat<T>().data();
+    Tensor masked_grad;
+    if (relu_) {
+      OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::v(),
+                                                     output_shape,
+                                                     &masked_grad));
+    }
+    const T* grad = relu_ ? masked_grad.flat<T>().data() : output_grad;
+    const ConstMatrixMap weights(kernel.flat<T>().data(), k, o);
+
+    const int64 num_blocks = (b + kBatchBlock - 1) / kBatchBlock;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        num_blocks, kBatchBlock * (2 * k * o + 2 * o),
+        [&](int64 begin, int64 end) {
+          Matrix panel;
+          for (int64 block = begin; block < end; ++block) {
+            const int64 row = block * kBatchBlock;
+            const int64 rows = std::min(kBatchBlock, b - row);
+            if (relu_) {
+              MatrixMap(masked_grad.flat<T>().data() + row * o, rows, o) =
+                  (ConstMatrixMap(output.flat<T>().data() + row * o, rows, o)
+                       .array() > 0.0f)
+                      .select(ConstMatrixMap(output_grad + row * o, rows, o),
+                              0.0f);
+            }
+            const ConstMatrixMap g(grad + row * o, rows, o);
+            for (int64 col = 0; col < k; col += kPanelColumns) {
+              const int64 cols = std::min(kPanelColumns, k - col);
+              panel.noalias() =
+                  g * weights.middleRows(col, cols).transpose();
+              layout.Unpack(panel, row, col, inputs_grad_data);
+            }
+          }
+        });
+
+    // Panels of the kernel gradient, then the bias gradient if any.
+    const int64 panel_cols =
+        KernelGradPanelColumns(k, worker_threads.num_threads);
+    const int64 num_panels = (k + panel_cols - 1) / panel_cols;
+    T* kernel_grad_data = kernel_grad->flat<T>().data();
+    worker_threads.workers->ParallelFor(
+        num_panels + num_bias_, b * 2 * panel_cols * o,
+        [&](int64 begin, int64 end) {
+          Matrix panel;
+          for (int64 task = begin; task < end; ++task) {
+            if (task == num_panels) {
+              RowVectorMap bias(bias_grad->flat<T>().data(), o);
+              bias = ConstMatrixMap(grad, b, o).colwise().sum();
+              continue;
+            }
+            const int64 col = task * panel_cols;
+            const int64 cols = std::min(panel_cols, k - col);
+            MatrixMap kernel_panel(kernel_grad_data + col * o, cols, o);
+            for (int64 row = 0; row < b; row += kBatchBlock) {
+              const int64 rows = std::min(kBatchBlock, b - row);
+              layout.Pack(row, rows, col, col + cols, &panel);
+              const ConstMatrixMap g(grad + row * o, rows, o);
+              if (row == 0) {
+                kernel_panel.noalias() = panel.transpose() * g;
+              } else {
+                kernel_panel.noalias() += panel.transpose() * g;
+              }
+            }
+          }
+        });
+  }
+
+ private:
+  bool relu_;
+  int num_bias_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("ConcatMatMulGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ConcatMatMulGradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,299 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+struct ConcatMatMulInputs {
+  ConcatMatMulInputs(int batch, const std::vector<int>& dims, int units,
+                     bool with_bias, bool relu)
+      : batch(batch), dims(dims), units(units), with_bias(with_bias),
+        relu(relu) {
+    inputs.resize(dims.size());
+    for (int i = 0; i < dims.size(); ++i) {
+      Fill(&inputs[i], batch * dims[i], i);
+      depth += dims[i];
+    }
+    Fill(&kernel, depth * units, 101);
+    Fill(&bias, with_bias ? units : 0, 103);
+    Fill(&output_grad, batch * units, 107);
+  }
+
+  void Fill(std::vector<float>* v, int n, int seed) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = std::sin(0.37f * i + 0.11f * n + 0.7f * seed);
+    }
+  }
+
+  // Column j of the concatenation, in row b.
+  float Concat(int b, int j) const {
+    int i = 0;
+    while (j >= dims[i]) j -= dims[i++];
+    return inputs[i][b * dims[i] + j];
+  }
+
+  // The unfused computation.
+  std::vector<double> Output() const {
+    std::vector<double> output(batch * units);
+    for (int b = 0; b < batch; ++b) {
+      for (int u = 0; u < units; ++u) {
+        double sum = with_bias ? bias[u] : 0;
+        for (int j = 0; j < depth; ++j) {
+          sum += Concat(b, j) * kernel[j * units + u];
+        }
+        output[b * units + u] = relu ? std::max(sum, 0.0) : sum;
+      }
+    }
+    return output;
+  }
+
+  // The unfused gradients of the concatenation, the kernel and the bias.
+  void Grads(std::vector<double>* concat_grad, std::vector<double>* kernel_grad,
+             std::vector<double>* bias_grad) const {
+    std::vector<double> output = Output();
+    concat_grad->assign(batch * depth, 0);
+    kernel_grad->assign(depth * units, 0);
+    bias_grad->assign(units, 0);
+    for (int b = 0; b < batch; ++b) {
+      for (int u = 0; u < units; ++u) {
+        if (relu && output[b * units + u] <= 0) continue;
+        const double g = output_grad[b * units + u];
+        (*bias_grad)[u] += g;
+        for (int j = 0; j < depth; ++j) {
+          (*concat_grad)[b * depth + j] += g * kernel[j * units + u];
+          (*kernel_grad)[j * units + u] += g * Concat(b, j);
+        }
+      }
+    }
+  }
+
+  int batch;
+  std::vector<int> dims;
+  int units;
+  bool with_bias, relu;
+  int depth = 0;
+  std::vector<std::vector<float>> inputs;
+  std::vector<float> kernel, bias, output_grad;
+};
+
+class ConcatMatMulOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const ConcatMatMulInputs& in) {
+    const int n = in.dims.size();
+    const int num_bias = in.with_bias ? 1 : 0;
+    NodeDefBuilder builder("concat_matmul", op);
+    builder.Input(FakeInput(n, DT_FLOAT)).Input(FakeInput(DT_FLOAT));
+    if (op == "ConcatMatMulGrad") {
+      builder.Input(FakeInput(DT_FLOAT)).Input(FakeInput(DT_FLOAT));
+    } else {
+      builder.Input(FakeInput(num_bias, DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Attr("T", DT_FLOAT)
+                     .Attr("N", n)
+                     .Attr("num_bias", num_bias)
+                     .Attr("activation", in.relu ? "Relu" : "None")
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const ConcatMatMulInputs& in) {
+    for (int i = 0; i < in.dims.size(); ++i) {
+      AddInputFromArray<float>(TensorShape({in.batch, in.dims[i]}),
+                               in.inputs[i]);
+    }
+    AddInputFromArray<float>(TensorShape({in.depth, in.units}), in.kernel);
+  }
+
+  static Tensor ToTensor(const std::vector<double>& values,
+                         const TensorShape& shape) {
+    Tensor tensor(DT_FLOAT, shape);
+    for (int i = 0; i < values.size(); ++i) tensor.flat<float>()(i) = values[i];
+    return tensor;
+  }
+
+  void ExpectMatchesUnfused(const ConcatMatMulInputs& in) {
+    MakeOp("ConcatMatMul", in);
+    AddInputs(in);
+    if (in.with_bias) {
+      AddInputFromArray<float>(TensorShape({in.units}), in.bias);
+    }
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorNear<float>(
+        ToTensor(in.Output(), TensorShape({in.batch, in.units})),
+        *GetOutput(0), 1e-4);
+  }
+
+  void ExpectGradMatchesUnfused(const ConcatMatMulInputs& in) {
+    std::vector<double> output = in.Output();
+    std::vector<float> output_float(output.begin(), output.end());
+    MakeOp("ConcatMatMulGrad", in);
+    AddInputs(in);
+    AddInputFromArray<float>(TensorShape({in.batch, in.units}), output_float);
+    AddInputFromArray<float>(TensorShape({in.batch, in.units}),
+                             in.output_grad);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<double> concat_grad, kernel_grad, bias_grad;
+    in.Grads(&concat_grad, &kernel_grad, &bias_grad);
+    const int n = in.dims.size();
+    int offset = 0;
+    for (int i = 0; i < n; ++i) {
+      std::vector<double> input_grad;
+      for (int b = 0; b < in.batch; ++b) {
+        for (int j = 0; j < in.dims[i]; ++j) {
+          input_grad.push_back(concat_grad[b * in.depth + offset + j]);
+        }
+      }
+      offset += in.dims[i];
+      test::ExpectTensorNear<float>(
+          ToTensor(input_grad, TensorShape({in.batch, in.dims[i]})),
+          *GetOutput(i), 1e-4);
+    }
+    test::ExpectTensorNear<float>(
+        ToTensor(kernel_grad, TensorShape({in.depth, in.units})),
+        *GetOutput(n), 1e-4);
+    if (in.with_bias) {
+      test::ExpectTensorNear<float>(
+          ToTensor(bias_grad, TensorShape({in.units})), *GetOutput(n + 1),
+          1e-4);
+    }
+  }
+};
+
+TEST_F(ConcatMatMulOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(ConcatMatMulInputs(5, {4, 1, 6}, 7, false, false));
+}
+
+TEST_F(ConcatMatMulOpTest, MatchesUnfusedWithBiasAndRelu) {
+  ExpectMatchesUnfused(ConcatMatMulInputs(5, {4, 1, 6}, 7, true, true));
+}
+
+// More rows than a block and inputs across column panels.
+TEST_F(ConcatMatMulOpTest, MatchesUnfusedAcrossPanels) {
+  ExpectMatchesUnfused(
+      ConcatMatMulInputs(70, {200, 0, 3, 150, 16}, 5, true, true));
+}
+
+TEST_F(ConcatMatMulOpTest, GradMatchesUnfused) {
+  ExpectGradMatchesUnfused(ConcatMatMulInputs(5, {4, 1, 6}, 7, false, false));
+}
+
+TEST_F(ConcatMatMulOpTest, GradMatchesUnfusedWithBiasAndRelu) {
+  ExpectGradMatchesUnfused(ConcatMatMulInputs(5, {4, 1, 6}, 7, true, true));
+}
+
+TEST_F(ConcatMatMulOpTest, GradMatchesUnfusedAcrossPanels) {
+  ExpectGradMatchesUnfused(
+      ConcatMatMulInputs(70, {200, 0, 3, 150, 16}, 5, true, true));
+}
+
+TEST_F(ConcatMatMulOpTest, InvalidKernelShape) {
+  ConcatMatMulInputs in(5, {4, 6}, 7, false, false);
+  MakeOp("ConcatMatMul", in);
+  for (int i = 0; i < in.dims.size(); ++i) {
+    AddInputFromArray<float>(TensorShape({in.batch, in.dims[i]}),
+                             in.inputs[i]);
+  }
+  AddInputFromArray<float>(TensorShape({in.depth - 1, in.units}),
+                           std::vector<float>((in.depth - 1) * in.units));
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+// The first dense layer, with relu, of `num_features` pooled embeddings.
+static Graph* ConcatMatMul(bool fused, int batch, int num_features, int dim,
+                           int units) {
+  Scope s = Scope::NewRootScope();
+  std::vector<Output> inputs;
+  for (int i = 0; i < num_features; ++i) {
+    inputs.push_back(RandomConst(s, {batch, dim}));
+  }
+  Output kernel = RandomConst(s, {num_features * dim, units});
+  Output bias = RandomConst(s, {units});
+  if (!fused) {
+    ops::Relu(s, ops::BiasAdd(s, ops::MatMul(s, ops::Concat(s, inputs, 1),
+                                             kernel),
+                              bias));
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  if (fused) {
+    std::unordered_map<string, Node*> nodes;
+    for (Node* node : g->nodes()) nodes[node->name()] = node;
+    std::vector<NodeBuilder::NodeOut> input_nodes;
+    for (const Output& input : inputs) {
+      input_nodes.emplace_back(nodes[input.node()->name()]);
+    }
+    TF_CHECK_OK(NodeBuilder(g->NewName("concat_matmul"), "ConcatMatMul")
+                    .Input(input_nodes)
+                    .Input(nodes[kernel.node()->name()])
+                    .Input(std::vector<NodeBuilder::NodeOut>{
+                        NodeBuilder::NodeOut(nodes[bias.node()->name()])})
+                    .Attr("num_bias", 1)
+                    .Attr("activation", "Relu")
+                    .Finalize(g, nullptr));
+  }
+  return g;
+}
+
+static Graph* FusedConcatMatMul(int batch, int num_features, int dim,
+                                int units) {
+  return ConcatMatMul(true, batch, num_features, dim, units);
+}
+
+static Graph* UnfusedConcatMatMul(int batch, int num_features, int dim,
+                                  int units) {
+  return ConcatMatMul(false, batch, num_features, dim, units);
+}
+
+#define BM_CONCAT_MATMUL(KIND, B, F, D, U, NTH)                               \
+  static void BM_##KIND##ConcatMatMul_##B##_##F##_##D##_##U##_##NTH##_CPU(    \
+      int iters) {                                                            \
+    testing::UseRealTime();                                                   \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                   \
+    SessionOptions opts;                                                      \
+    opts.config.set_intra_op_parallelism_threads(NTH);                        \
+    test::Benchmark("cpu", KIND##ConcatMatMul(B, F, D, U), &opts).Run(iters); \
+  }                                                                           \
+  BENCHMARK(BM_##KIND##ConcatMatMul_##B##_##F##_##D##_##U##_##NTH##_CPU);
+
+#define BM_CONCAT_MATMUL_NTH(B, F, D, U)    \
+  BM_CONCAT_MATMUL(Fused, B, F, D, U, 1);   \
+  BM_CONCAT_MATMUL(Fused, B, F, D, U, 8);   \
+  BM_CONCAT_MATMUL(Unfused, B, F, D, U, 1); \
+  BM_CONCAT_MATMUL(Unfused, B, F, D, U, 8);
+
+// modelzoo/wide_and_deep and deepfm: 26 embeddings of size 16.
+BM_CONCAT_MATMUL_NTH(2048, 26, 16, 1024);
+BM_CONCAT_MATMUL_NTH(2048, 26, 16, 64);
+// Hundreds of features.
+BM_CONCAT_MATMUL_NTH(2048, 200, 16, 256);
+BM_CONCAT_MATMUL_NTH(4096, 300, 8, 64);
+
+}  // namespace
+}  // namespace tensorflow
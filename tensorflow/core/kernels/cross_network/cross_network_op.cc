@@ -0,0 +1,535 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+// Rows of x0 run through all the DCNv2 layers at once. The rows of x0 and
+// of the layer activations then stay in cache across the layers, while the
+// kernels are shared by all the rows of the block.
+constexpr int64 kRowBlock = 32;
+
+struct CrossNetworkShape {
+  int64 batch = 0;
+  int64 dim = 0;
+  int64 num_layers = 0;
+  // Whether the DCNv2 layers are low rank, of rank `rank`.
+  bool low_rank = false;
+  int64 rank = 0;
+
+  // Rows of the DCNv2 kernels.
+  int64 kernel_rows() const { return low_rank ? rank : dim; }
+
+  // Flops of a DCNv2 layer for one row.
+  int64 LayerCost() const {
+    return 2 * kernel_rows() * dim + (low_rank ? 2 * dim * rank : 0) +
+           4 * dim;
+  }
+};
+
+struct CrossNetworkWeights {
+  std::vector<const float*> kernels;
+  std::vector<const float*> biases;
+  std::vector<const float*> projection_kernels;
+  std::vector<const float*> projection_biases;
+};
+
+Status CheckShape(const Tensor& tensor, const TensorShape& expected,
+                  const char* name, int64 layer) {
+  if (tensor.shape() != expected) {
+    return errors::InvalidArgument(name, "[", layer, "] must be ",
+                                   expected.DebugString(), ", got ",
+                                   tensor.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+// Checks x0 and the weights, which start at input `first`. The kernels are
+// vectors for CrossNetwork and matrices for CrossNetworkV2 (`v2`).
+Status GetCrossNetworkShape(OpKernelContext* context, int first, bool v2,
+                            CrossNetworkShape* shape,
+                            CrossNetworkWeights* weights) {
+  const Tensor& x0 = context->input(first);
+  if (x0.dims() != 2) {
+    return errors::InvalidArgument("x0 must be 2-D, got ",
+                                   x0.shape().DebugString());
+  }
+  shape->batch = x0.dim_size(0);
+  shape->dim = x0.dim_size(1);
+  OpInputList kernels;
+  OpInputList biases;
+  TF_RETURN_IF_ERROR(context->input_list("kernels", &kernels));
+  TF_RETURN_IF_ERROR(context->input_list("biases", &biases));
+  shape->num_layers = kernels.size();
+  const int64 d = shape->dim;
+  if (v2) {
+    OpInputList projection_kernels;
+    OpInputList projection_biases;
+    TF_RETURN_IF_ERROR(
+        context->input_list("projection_kernels", &projection_kernels));
+    TF_RETURN_IF_ERROR(
+        context->input_list("projection_biases", &projection_biases));
+    shape->low_rank = projection_kernels.size() > 0;
+    if (shape->low_rank) {
+      if (projection_kernels[0].dims() != 2) {
+        return errors::InvalidArgument(
+            "projection_kernels must be 2-D, got ",
+            projection_kernels[0].shape().DebugString());
+      }
+      shape->rank = projection_kernels[0].dim_size(1);
+    }
+    const int64 r = shape->rank;
+    for (int64 l = 0; l < shape->num_layers; ++l) {
+      if (shape->low_rank) {
+        TF_RETURN_IF_ERROR(CheckShape(projection_kernels[l],
+                                      TensorShape({d, r}),
+                                      "projection_kernels", l));
+        TF_RETURN_IF_ERROR(CheckShape(projection_biases[l], TensorShape({r}),
+                                      "projection_biases", l));
+        weights->projection_kernels.push_back(
+            projection_kernels[l].flat<float>().data());
+        weights->projection_biases.push_back(
+            projection_biases[l].flat<float>().data());
+      }
+      TF_RETURN_IF_ERROR(CheckShape(
+          kernels[l], TensorShape({shape->kernel_rows(), d}), "kernels", l));
+    }
+  } else {
+    for (int64 l = 0; l < shape->num_layers; ++l) {
+      TF_RETURN_IF_ERROR(
+          CheckShape(kernels[l], TensorShape({d}), "kernels", l));
+    }
+  }
+  for (int64 l = 0; l < shape->num_layers; ++l) {
+    TF_RETURN_IF_ERROR(CheckShape(biases[l], TensorShape({d}), "biases", l));
+    weights->kernels.push_back(kernels[l].flat<float>().data());
+    weights->biases.push_back(biases[l].flat<float>().data());
+  }
+  return Status::OK();
+}
+
+// Allocates the gradients of the inputs after output_grad, zero filled.
+Status AllocateGradients(OpKernelContext* context, std::vector<float*>* grads) {
+  for (int i = 0; i < context->num_outputs(); ++i) {
+    Tensor* grad = nullptr;
+    TF_RETURN_IF_ERROR(
+        context->allocate_output(i, context->input(i + 1).shape(), &grad));
+    grad->flat<float>().setZero();
+    grads->push_back(grad->flat<float>().data());
+  }
+  return Status::OK();
+}
+
+// Per-thread buffers of the DCNv2 layers of a block of rows: the input x,
+// the kernel output h and the projection p of each layer.
+class CrossLayerBuffers {
+ public:
+  CrossLayerBuffers(const CrossNetworkShape& shape, int64 num_layers)
+      : dim_(shape.dim),
+        layer_size_(kRowBlock * (2 * shape.dim + shape.rank)),
+        buffer_(num_layers * layer_size_) {}
+
+  float* x(int64 l) { return buffer_.data() + l * layer_size_; }
+  float* h(int64 l) { return x(l) + kRowBlock * dim_; }
+  float* p(int64 l) { return h(l) + kRowBlock * dim_; }
+
+ private:
+  const int64 dim_;
+  const int64 layer_size_;
+  std::vector<float> buffer_;
+};
+
+// Runs DCNv2 cross layer l on the n rows of x0 and x. p and h receive the
+// projection and x kernels + biases, and `next`, which may be x, the layer
+// output. `next` is not computed if null.
+void CrossLayerV2(const CrossNetworkShape& shape,
+                  const CrossNetworkWeights& weights, bool input_residual,
+                  int64 l, int64 n, const float* x0, const float* x, float* p,
+                  float* h, float* next) {
+  const int64 d = shape.dim;
+  const int64 r = shape.rank;
+  MatrixMap h_mat(h, n, d);
+  if (shape.low_rank) {
+    MatrixMap p_mat(p, n, r);
+    p_mat.noalias() =
+        ConstMatrixMap(x, n, d) * ConstMatrixMap(weights.projection_kernels[l],
+                                                 d, r);
+    p_mat.rowwise() += ConstRowVectorMap(weights.projection_biases[l], r);
+    h_mat.noalias() = p_mat * ConstMatrixMap(weights.kernels[l], r, d);
+  } else {
+    h_mat.noalias() =
+        ConstMatrixMap(x, n, d) * ConstMatrixMap(weights.kernels[l], d, d);
+  }
+  h_mat.rowwise() += ConstRowVectorMap(weights.biases[l], d);
+  if (next == nullptr) return;
+  ConstMatrixMap x0_mat(x0, n, d);
+  MatrixMap next_mat(next, n, d);
+  if (input_residual) {
+    next_mat = x0_mat.cwiseProduct(h_mat) + x0_mat;
+  } else {
+    next_mat = x0_mat.cwiseProduct(h_mat) + ConstMatrixMap(x, n, d);
+  }
+}
+
+}  // namespace
+
+// Fused DCN cross network, see the CrossNetwork op. Each row of x0 goes
+// through all the layers while it is in cache, instead of writing the
+// [B, D] temporaries of the unfused layers to memory.
+template <typename T>
+class CrossNetworkOp : public OpKernel {
+ public:
+  explicit CrossNetworkOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    CrossNetworkShape shape;
+    CrossNetworkWeights weights;
+    OP_REQUIRES_OK(context,
+                   GetCrossNetworkShape(context, 0, false, &shape, &weights));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, context->input(0).shape(), &output_tensor));
+    if (output_tensor->NumElements() == 0) return;
+    const T* x0 = context->input(0).flat<T>().data();
+    T* output = output_tensor->flat<T>().data();
+
+    const int64 d = shape.dim;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost = shape.num_layers * 6 * d;
+    worker_threads.workers->ParallelFor(
+        shape.batch, cost, [&](int64 begin, int64 end) {
+          for (int64 b = begin; b < end; ++b) {
+            ConstRowVectorMap x0_row(x0 + b * d, d);
+            RowVectorMap x(output + b * d, d);
+            x = x0_row;
+            for (int64 l = 0; l < shape.num_layers; ++l) {
+              const float s = x.dot(ConstRowVectorMap(weights.kernels[l], d));
+              x += s * x0_row + ConstRowVectorMap(weights.biases[l], d);
+            }
+          }
+        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("CrossNetwork").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    CrossNetworkOp<float>);
+
+// Gradients of CrossNetwork. The layers are recomputed per row, and the
+// weight gradients are summed per block of rows and then over the blocks in
+// order, so the result does not depend on scheduling.
+template <typename T>
+class CrossNetworkGradOp : public OpKernel {
+ public:
+  explicit CrossNetworkGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    CrossNetworkShape shape;
+    CrossNetworkWeights weights;
+    OP_REQUIRES_OK(context,
+                   GetCrossNetworkShape(context, 1, false, &shape, &weights));
+    const Tensor& output_grad = context->input(0);
+    OP_REQUIRES(context, output_grad.shape() == context->input(1).shape(),
+                errors::InvalidArgument("output_grad must be ",
+                                        context->input(1).shape().DebugString(),
+                                        ", got ",
+                                        output_grad.shape().DebugString()));
+    std::vector<float*> grads;
+    OP_REQUIRES_OK(context, AllocateGradients(context, &grads));
+    if (shape.batch == 0) return;
+
+    // Gradients of the kernels then of the biases in a block accumulator.
+    const int64 d = shape.dim;
+    const int64 num_layers = shape.num_layers;
+    const int64 size = 2 * num_layers * d;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 num_blocks =
+        std::min<int64>(shape.batch, std::max(1, worker_threads.num_threads));
+    const int64 rows_per_block = (shape.batch + num_blocks - 1) / num_blocks;
+    std::vector<float> accumulators(num_blocks * size, 0.0f);
+
+    const T* dout = output_grad.flat<T>().data();
+    const T* x0 = context->input(1).flat<T>().data();
+    const int64 cost = rows_per_block * num_layers * 14 * d;
+    worker_threads.workers->ParallelFor(
+        num_blocks, cost, [&](int64 begin, int64 end) {
+          // The layer inputs, their dot products with the kernels and the
+          // gradient of the current layer output.
+          std::vector<float> buffer(num_layers * d + num_layers + d);
+          float* xs = buffer.data();
+          float* s = xs + num_layers * d;
+          RowVectorMap g(s + num_layers, d);
+          for (int64 block = begin; block < end; ++block) {
+            float* acc = accumulators.data() + block * size;
+            const int64 row_end =
+                std::min(shape.batch, (block + 1) * rows_per_block);
+            for (int64 b = block * rows_per_block; b < row_end; ++b) {
+              ConstRowVectorMap x0_row(x0 + b * d, d);
+              for (int64 l = 0; l < num_layers; ++l) {
+                RowVectorMap x(xs + l * d, d);
+                if (l == 0) {
+                  x = x0_row;
+                } else {
+                  x = ConstRowVectorMap(xs + (l - 1) * d, d) +
+                      s[l - 1] * x0_row +
+                      ConstRowVectorMap(weights.biases[l - 1], d);
+                }
+                s[l] = x.dot(ConstRowVectorMap(weights.kernels[l], d));
+              }
+
+              RowVectorMap dx0(grads[0] + b * d, d);
+              g = ConstRowVectorMap(dout + b * d, d);
+              for (int64 l = num_layers - 1; l >= 0; --l) {
+                dx0 += s[l] * g;
+                const float ds = g.dot(x0_row);
+                RowVectorMap(acc + l * d, d) +=
+                    ds * ConstRowVectorMap(xs + l * d, d);
+                RowVectorMap(acc + (num_layers + l) * d, d) += g;
+                g += ds * ConstRowVectorMap(weights.kernels[l], d);
+              }
+              dx0 += g;
+            }
+          }
+        });
+
+    for (int64 i = 0; i < 2 * num_layers; ++i) {
+      float* grad = grads[i + 1];
+      for (int64 block = 0; block < num_blocks; ++block) {
+        const float* acc = accumulators.data() + block * size + i * d;
+        for (int64 j = 0; j < d; ++j) grad[j] += acc[j];
+      }
+    }
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("CrossNetworkGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    CrossNetworkGradOp<float>);
+
+// Fused DCNv2 cross network, see the CrossNetworkV2 op. Blocks of kRowBlock
+// rows go through all the layers, so the layer temporaries of a block stay
+// in cache and only the output is written to memory.
+template <typename T>
+class CrossNetworkV2Op : public OpKernel {
+ public:
+  explicit CrossNetworkV2Op(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("input_residual", &input_residual_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    CrossNetworkShape shape;
+    CrossNetworkWeights weights;
+    OP_REQUIRES_OK(context,
+                   GetCrossNetworkShape(context, 0, true, &shape, &weights));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, context->input(0).shape(), &output_tensor));
+    if (output_tensor->NumElements() == 0) return;
+    const T* x0 = context->input(0).flat<T>().data();
+    T* output = output_tensor->flat<T>().data();
+
+    const int64 d = shape.dim;
+    const int64 num_row_blocks = (shape.batch + kRowBlock - 1) / kRowBlock;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost = kRowBlock * shape.num_layers * shape.LayerCost();
+    worker_threads.workers->ParallelFor(
+        num_row_blocks, cost, [&](int64 begin, int64 end) {
+          CrossLayerBuffers buffers(shape, 1);
+          for (int64 block = begin; block < end; ++block) {
+            const int64 row = block * kRowBlock;
+            const int64 n = std::min(kRowBlock, shape.batch - row);
+            std::copy_n(x0 + row * d, n * d, output + row * d);
+            for (int64 l = 0; l < shape.num_layers; ++l) {
+              CrossLayerV2(shape, weights, input_residual_, l, n,
+                           x0 + row * d, output + row * d, buffers.p(0),
+                           buffers.h(0), output + row * d);
+            }
+          }
+        });
+  }
+
+ private:
+  bool input_residual_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("CrossNetworkV2").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    CrossNetworkV2Op<float>);
+
+// Gradients of CrossNetworkV2. The layers are recomputed per kRowBlock rows
+// and the weight gradients are summed as for CrossNetworkGrad.
+template <typename T>
+class CrossNetworkV2GradOp : public OpKernel {
+ public:
+  explicit CrossNetworkV2GradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("input_residual", &input_residual_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    CrossNetworkShape shape;
+    CrossNetworkWeights weights;
+    OP_REQUIRES_OK(context,
+                   GetCrossNetworkShape(context, 1, true, &shape, &weights));
+    const Tensor& output_grad = context->input(0);
+    OP_REQUIRES(context, output_grad.shape() == context->input(1).shape(),
+                errors::InvalidArgument("output_grad must be ",
+                                        context->input(1).shape().DebugString(),
+                                        ", got ",
+                                        output_grad.shape().DebugString()));
+    std::vector<float*> grads;
+    OP_REQUIRES_OK(context, AllocateGradients(context, &grads));
+    if (shape.batch == 0) return;
+
+    // Offsets of the gradients of the kernels, biases, projection kernels
+    // and projection biases of each layer in a block accumulator, in the
+    // order of the outputs.
+    const int64 d = shape.dim;
+    const int64 r = shape.rank;
+    const int64 kr = shape.kernel_rows();
+    const int64 num_layers = shape.num_layers;
+    std::vector<int64> sizes(num_layers, kr * d);
+    sizes.resize(2 * num_layers, d);
+    if (shape.low_rank) {
+      sizes.resize(3 * num_layers, d * r);
+      sizes.resize(4 * num_layers, r);
+    }
+    std::vector<int64> offsets(sizes.size() + 1, 0);
+    for (int i = 0; i < sizes.size(); ++i) {
+      offsets[i + 1] = offsets[i] + sizes[i];
+    }
+    const int64 size = offsets.back();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 num_blocks =
+        std::min<int64>(shape.batch, std::max(1, worker_threads.num_threads));
+    const int64 rows_per_block = (shape.batch + num_blocks - 1) / num_blocks;
+    std::vector<float> accumulators(num_blocks * size, 0.0f);
+
+    const T* dout = output_grad.flat<T>().data();
+    const T* x0 = context->input(1).flat<T>().data();
+    const int64 cost = rows_per_block * num_layers * 3 * shape.LayerCost();
+    worker_threads.workers->ParallelFor(
+        num_blocks, cost, [&](int64 begin, int64 end) {
+          CrossLayerBuffers layers(shape, num_layers);
+          // The gradients of a layer output and of its h and p.
+          CrossLayerBuffers grad_buffers(shape, 1);
+          for (int64 block = begin; block < end; ++block) {
+            float* acc = accumulators.data() + block * size;
+            const int64 row_end =
+                std::min(shape.batch, (block + 1) * rows_per_block);
+            for (int64 row = block * rows_per_block; row < row_end;
+                 row += kRowBlock) {
+              const int64 n = std::min(kRowBlock, row_end - row);
+              std::copy_n(x0 + row * d, n * d, layers.x(0));
+              for (int64 l = 0; l < num_layers; ++l) {
+                CrossLayerV2(shape, weights, input_residual_, l, n,
+                             x0 + row * d, layers.x(l), layers.p(l),
+                             layers.h(l),
+                             l + 1 < num_layers ? layers.x(l + 1) : nullptr);
+              }
+              BackwardRows(shape, weights, n, x0 + row * d, dout + row * d,
+                           offsets, &layers, &grad_buffers, acc,
+                           grads[0] + row * d);
+            }
+          }
+        });
+
+    for (int i = 0; i < sizes.size(); ++i) {
+      float* grad = grads[i + 1];
+      for (int64 block = 0; block < num_blocks; ++block) {
+        const float* acc =
+            accumulators.data() + block * size + offsets[i];
+        for (int64 j = 0; j < sizes[i]; ++j) grad[j] += acc[j];
+      }
+    }
+  }
+
+ private:
+  // Backpropagates output_grad of n rows through the layers kept in
+  // `layers`, accumulating the weight gradients into acc.
+  void BackwardRows(const CrossNetworkShape& shape,
+                    const CrossNetworkWeights& weights, int64 n,
+                    const float* x0, const float* dout,
+                    const std::vector<int64>& offsets,
+                    CrossLayerBuffers* layers, CrossLayerBuffers* grad_buffers,
+                    float* acc, float* dx0) {
+    const int64 d = shape.dim;
+    const int64 r = shape.rank;
+    const int64 kr = shape.kernel_rows();
+    const int64 num_layers = shape.num_layers;
+    ConstMatrixMap x0_mat(x0, n, d);
+    MatrixMap dx0_mat(dx0, n, d);
+    MatrixMap g(grad_buffers->x(0), n, d);
+    MatrixMap dh(grad_buffers->h(0), n, d);
+    MatrixMap dp(grad_buffers->p(0), n, r);
+    g = ConstMatrixMap(dout, n, d);
+    for (int64 l = num_layers - 1; l >= 0; --l) {
+      ConstMatrixMap x(layers->x(l), n, d);
+      dh = g.cwiseProduct(x0_mat);
+      dx0_mat += g.cwiseProduct(ConstMatrixMap(layers->h(l), n, d));
+      if (input_residual_) dx0_mat += g;
+      const ConstMatrixMap kernel_input(
+          shape.low_rank ? layers->p(l) : layers->x(l), n, kr);
+      MatrixMap(acc + offsets[l], kr, d).noalias() +=
+          kernel_input.transpose() * dh;
+      RowVectorMap(acc + offsets[num_layers + l], d) += dh.colwise().sum();
+      if (shape.low_rank) {
+        dp.noalias() =
+            dh * ConstMatrixMap(weights.kernels[l], r, d).transpose();
+        MatrixMap(acc + offsets[2 * num_layers + l], d, r).noalias() +=
+            x.transpose() * dp;
+        RowVectorMap(acc + offsets[3 * num_layers + l], r) +=
+            dp.colwise().sum();
+      }
+      // The kernel applied to x, and the gradient of its output.
+      const ConstMatrixMap input_kernel(
+          shape.low_rank ? weights.projection_kernels[l] : weights.kernels[l],
+          d, kr);
+      const ConstMatrixMap dinput_kernel(
+          shape.low_rank ? grad_buffers->p(0) : grad_buffers->h(0), n, kr);
+      if (input_residual_) {
+        g.noalias() = dinput_kernel * input_kernel.transpose();
+      } else {
+        g.noalias() += dinput_kernel * input_kernel.transpose();
+      }
+    }
+    // x[0] is x0.
+    dx0_mat += g;
+  }
+
+  bool input_residual_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("CrossNetworkV2Grad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    CrossNetworkV2GradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,347 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+// The inputs of CrossNetwork (v2 = false) or CrossNetworkV2, low rank if
+// rank > 0.
+struct CrossNetworkInputs {
+  CrossNetworkInputs(bool v2, int batch, int dim, int num_layers, int rank,
+                     bool input_residual)
+      : v2(v2), batch(batch), dim(dim), num_layers(num_layers), rank(rank),
+        input_residual(input_residual), kernels(num_layers),
+        biases(num_layers), projection_kernels(rank > 0 ? num_layers : 0),
+        projection_biases(rank > 0 ? num_layers : 0) {
+    Fill(&x0, batch * dim, 0);
+    for (int l = 0; l < num_layers; ++l) {
+      Fill(&kernels[l], kernel_shape().num_elements(), l + 1);
+      Fill(&biases[l], dim, l + 1);
+    }
+    for (int l = 0; l < projection_kernels.size(); ++l) {
+      Fill(&projection_kernels[l], dim * rank, l + 1);
+      Fill(&projection_biases[l], rank, l + 1);
+    }
+  }
+
+  void Fill(std::vector<float>* v, int n, int seed) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = 0.5f * std::sin(0.37f * i + 0.11f * n + seed);
+    }
+  }
+
+  TensorShape kernel_shape() const {
+    if (!v2) return TensorShape({dim});
+    return TensorShape({rank > 0 ? rank : dim, dim});
+  }
+
+  // The unfused layers.
+  std::vector<double> Output() const {
+    std::vector<double> output;
+    for (int b = 0; b < batch; ++b) {
+      const float* x0_row = &x0[b * dim];
+      std::vector<double> x(x0_row, x0_row + dim);
+      for (int l = 0; l < num_layers; ++l) {
+        std::vector<double> next(dim);
+        if (!v2) {
+          double s = 0;
+          for (int j = 0; j < dim; ++j) s += x[j] * kernels[l][j];
+          for (int j = 0; j < dim; ++j) {
+            next[j] = x0_row[j] * s + biases[l][j] + x[j];
+          }
+        } else {
+          std::vector<double> input = x;
+          if (rank > 0) {
+            input.assign(rank, 0);
+            for (int k = 0; k < rank; ++k) {
+              input[k] = projection_biases[l][k];
+              for (int j = 0; j < dim; ++j) {
+                input[k] += x[j] * projection_kernels[l][j * rank + k];
+              }
+            }
+          }
+          for (int j = 0; j < dim; ++j) {
+            double h = biases[l][j];
+            for (int k = 0; k < input.size(); ++k) {
+              h += input[k] * kernels[l][k * dim + j];
+            }
+            next[j] = x0_row[j] * h + (input_residual ? x0_row[j] : x[j]);
+          }
+        }
+        x = next;
+      }
+      output.insert(output.end(), x.begin(), x.end());
+    }
+    return output;
+  }
+
+  // sum(output * output_grad).
+  double Loss(const std::vector<float>& output_grad) const {
+    std::vector<double> output = Output();
+    double loss = 0;
+    for (int i = 0; i < output.size(); ++i) loss += output[i] * output_grad[i];
+    return loss;
+  }
+
+  // The inputs in the order of the gradients.
+  std::vector<std::vector<float>*> Params() {
+    std::vector<std::vector<float>*> params = {&x0};
+    for (auto& kernel : kernels) params.push_back(&kernel);
+    for (auto& bias : biases) params.push_back(&bias);
+    for (auto& kernel : projection_kernels) params.push_back(&kernel);
+    for (auto& bias : projection_biases) params.push_back(&bias);
+    return params;
+  }
+
+  bool v2;
+  int batch, dim, num_layers, rank;
+  bool input_residual;
+  std::vector<float> x0;
+  std::vector<std::vector<float>> kernels, biases;
+  std::vector<std::vector<float>> projection_kernels, projection_biases;
+};
+
+class CrossNetworkOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool grad, const CrossNetworkInputs& in) {
+    string op = in.v2 ? "CrossNetworkV2" : "CrossNetwork";
+    if (grad) op += "Grad";
+    NodeDefBuilder builder("cross_network", op);
+    if (grad) builder.Input(FakeInput(DT_FLOAT));
+    builder.Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(in.num_layers, DT_FLOAT))
+        .Input(FakeInput(in.num_layers, DT_FLOAT))
+        .Attr("T", DT_FLOAT)
+        .Attr("num_layers", in.num_layers);
+    if (in.v2) {
+      const int num_projections = in.projection_kernels.size();
+      builder.Input(FakeInput(num_projections, DT_FLOAT))
+          .Input(FakeInput(num_projections, DT_FLOAT))
+          .Attr("num_projections", num_projections)
+          .Attr("input_residual", in.input_residual);
+    }
+    TF_EXPECT_OK(builder.Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const CrossNetworkInputs& in) {
+    AddInputFromArray<float>(TensorShape({in.batch, in.dim}), in.x0);
+    for (const auto& kernel : in.kernels) {
+      AddInputFromArray<float>(in.kernel_shape(), kernel);
+    }
+    for (const auto& bias : in.biases) {
+      AddInputFromArray<float>(TensorShape({in.dim}), bias);
+    }
+    for (const auto& kernel : in.projection_kernels) {
+      AddInputFromArray<float>(TensorShape({in.dim, in.rank}), kernel);
+    }
+    for (const auto& bias : in.projection_biases) {
+      AddInputFromArray<float>(TensorShape({in.rank}), bias);
+    }
+  }
+
+  void ExpectMatchesUnfused(const CrossNetworkInputs& in) {
+    MakeOp(false, in);
+    AddInputs(in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({in.batch, in.dim}));
+    std::vector<double> output = in.Output();
+    for (int i = 0; i < output.size(); ++i) {
+      expected.flat<float>()(i) = output[i];
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  }
+
+  void ExpectGradMatchesFiniteDifferences(CrossNetworkInputs in) {
+    std::vector<float> output_grad(in.batch * in.dim);
+    in.Fill(&output_grad, output_grad.size(), 0);
+    MakeOp(true, in);
+    AddInputFromArray<float>(TensorShape({in.batch, in.dim}), output_grad);
+    AddInputs(in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<std::vector<float>*> params = in.Params();
+    for (int p = 0; p < params.size(); ++p) {
+      std::vector<float>& param = *params[p];
+      auto grad = GetOutput(p)->flat<float>();
+      ASSERT_EQ(param.size(), grad.size());
+      for (int i = 0; i < param.size(); ++i) {
+        const float value = param[i];
+        const float delta = 1e-3;
+        param[i] = value + delta;
+        const double loss_plus = in.Loss(output_grad);
+        param[i] = value - delta;
+        const double loss_minus = in.Loss(output_grad);
+        param[i] = value;
+        EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 1e-3)
+            << "input " << p << " element " << i;
+      }
+    }
+  }
+};
+
+TEST_F(CrossNetworkOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(CrossNetworkInputs(false, 5, 7, 3, 0, false));
+}
+
+// 37 rows span two row blocks of the DCNv2 kernels.
+TEST_F(CrossNetworkOpTest, V2MatchesUnfused) {
+  ExpectMatchesUnfused(CrossNetworkInputs(true, 37, 7, 3, 0, false));
+}
+
+TEST_F(CrossNetworkOpTest, V2LowRankMatchesUnfused) {
+  ExpectMatchesUnfused(CrossNetworkInputs(true, 37, 7, 3, 2, false));
+}
+
+TEST_F(CrossNetworkOpTest, V2InputResidualMatchesUnfused) {
+  ExpectMatchesUnfused(CrossNetworkInputs(true, 37, 7, 3, 2, true));
+}
+
+TEST_F(CrossNetworkOpTest, GradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(
+      CrossNetworkInputs(false, 5, 6, 3, 0, false));
+}
+
+TEST_F(CrossNetworkOpTest, V2GradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(
+      CrossNetworkInputs(true, 37, 5, 2, 0, false));
+}
+
+TEST_F(CrossNetworkOpTest, V2LowRankGradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(
+      CrossNetworkInputs(true, 37, 5, 2, 2, false));
+}
+
+TEST_F(CrossNetworkOpTest, V2InputResidualGradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(
+      CrossNetworkInputs(true, 37, 5, 2, 2, true));
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+static Graph* FusedCrossNetwork(bool v2, int batch, int dim, int num_layers,
+                                int rank) {
+  Scope s = Scope::NewRootScope();
+  Output x0 = RandomConst(s, {batch, dim});
+  std::vector<Output> weights[4];
+  for (int l = 0; l < num_layers; ++l) {
+    if (!v2) {
+      weights[0].push_back(RandomConst(s, {dim}));
+    } else {
+      weights[0].push_back(RandomConst(s, {rank > 0 ? rank : dim, dim}));
+    }
+    weights[1].push_back(RandomConst(s, {dim}));
+    if (rank > 0) {
+      weights[2].push_back(RandomConst(s, {dim, rank}));
+      weights[3].push_back(RandomConst(s, {rank}));
+    }
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  auto node_outs = [&](const std::vector<Output>& outputs) {
+    std::vector<NodeBuilder::NodeOut> node_outs;
+    for (const Output& output : outputs) {
+      node_outs.emplace_back(nodes[output.node()->name()]);
+    }
+    return node_outs;
+  };
+  NodeBuilder builder(g->NewName("cross_network"),
+                      v2 ? "CrossNetworkV2" : "CrossNetwork");
+  builder.Input(nodes[x0.node()->name()])
+      .Input(node_outs(weights[0]))
+      .Input(node_outs(weights[1]))
+      .Attr("num_layers", num_layers);
+  if (v2) {
+    builder.Input(node_outs(weights[2]))
+        .Input(node_outs(weights[3]))
+        .Attr("num_projections", static_cast<int>(weights[2].size()));
+  }
+  TF_CHECK_OK(builder.Finalize(g, nullptr));
+  return g;
+}
+
+// _cross_net of modelzoo/dcn (v2 = false) and modelzoo/dcnv2.
+static Graph* UnfusedCrossNetwork(bool v2, int batch, int dim,
+                                  int num_layers, int rank) {
+  Scope s = Scope::NewRootScope();
+  Output x0 = RandomConst(s, {batch, dim});
+  Output x = x0;
+  for (int l = 0; l < num_layers; ++l) {
+    Output bias = RandomConst(s, {dim});
+    if (!v2) {
+      auto xw = ops::Sum(s, ops::Mul(s, x, RandomConst(s, {dim})), 1,
+                         ops::Sum::KeepDims(true));
+      x = ops::Add(s, ops::Add(s, ops::Mul(s, x0, xw), bias), x);
+      continue;
+    }
+    Output input = x;
+    if (rank > 0) {
+      input = ops::BiasAdd(
+          s, ops::MatMul(s, x, RandomConst(s, {dim, rank})),
+          RandomConst(s, {rank}));
+    }
+    auto h = ops::BiasAdd(
+        s, ops::MatMul(s, input, RandomConst(s, {rank > 0 ? rank : dim, dim})),
+        bias);
+    x = ops::Add(s, ops::Mul(s, x0, h), x);
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+#define BM_CROSS_NETWORK(KIND, OP, V2, B, D, L, R, NTH)                   \
+  static void BM_##KIND##OP##_##B##_##D##_##L##_##R##_##NTH##_CPU(          \
+      int iters) {                                                          \
+    testing::UseRealTime();                                                 \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                 \
+    SessionOptions opts;                                                    \
+    opts.config.set_intra_op_parallelism_threads(NTH);                      \
+    test::Benchmark("cpu", KIND##CrossNetwork(V2, B, D, L, R), &opts)       \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_##KIND##OP##_##B##_##D##_##L##_##R##_##NTH##_CPU);
+
+#define BM_CROSS_NETWORK_NTH(OP, V2, B, D, L, R)    \
+  BM_CROSS_NETWORK(Fused, OP, V2, B, D, L, R, 1);   \
+  BM_CROSS_NETWORK(Fused, OP, V2, B, D, L, R, 8);   \
+  BM_CROSS_NETWORK(Unfused, OP, V2, B, D, L, R, 1); \
+  BM_CROSS_NETWORK(Unfused, OP, V2, B, D, L, R, 8);
+
+// The modelzoo models: 2 layers over the 26 embeddings of 64 or 128
+// dimensions and the 13 dense features.
+BM_CROSS_NETWORK_NTH(CrossNetwork, false, 512, 2125, 2, 0);
+BM_CROSS_NETWORK_NTH(CrossNetwork, false, 4096, 2125, 2, 0);
+BM_CROSS_NETWORK_NTH(CrossNetworkV2, true, 512, 2125, 2, 0);
+// Low rank, as with --projection_dim of modelzoo/dcnv2.
+BM_CROSS_NETWORK_NTH(CrossNetworkV2, true, 512, 2125, 2, 256);
+BM_CROSS_NETWORK_NTH(CrossNetworkV2, true, 4096, 2125, 2, 256);
+
+}  // namespace
+}  // namespace tensorflow
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/arrow_util.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <memory>
 #include <numeric>
@@ -26,6 +27,7 @@ limitations under the License.
 #include "arrow/util/thread_pool.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/kernels/data/eigen.h"
+#include "tensorflow/core/platform/cpu_info.h"
 
 namespace tensorflow {
 namespace data {
@@ -309,6 +311,19 @@ int GetArrowFileBufferSizeFromEnv() {
   return buffer_size;
 }
 
+int64 GetParquetColumnCacheBytesFromEnv() {
+  static int64 cache_bytes =
+      static_cast<int64>(EnvGetInt("PARQUET_DATASET_CACHE_MB", 0)) << 20;
+  return cache_bytes;
+}
+
+int GetParquetPrefetchThreadsFromEnv() {
+  static int prefetch_threads = std::max(
+      1, EnvGetInt("PARQUET_DATASET_PREFETCH_THREADS",
+                   port::NumSchedulableCPUs()));
+  return prefetch_threads;
+}
+
 ::arrow::Status OpenArrowFile(
     std::shared_ptr<::arrow::io::RandomAccessFile>* file,
     const std::string& filename) {
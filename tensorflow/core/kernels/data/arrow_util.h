@@ -53,6 +53,13 @@ int UpdateArrowCpuThreadPoolCapacityFromEnv();
 
 int GetArrowFileBufferSizeFromEnv();
 
+// Capacity of the decoded column cache shared by ParquetDatasets, 0 disables
+// it.
+int64 GetParquetColumnCacheBytesFromEnv();
+
+// Size of the pool decoding row groups ahead of all ParquetDatasets.
+int GetParquetPrefetchThreadsFromEnv();
+
 ::arrow::Status OpenArrowFile(
     std::shared_ptr<::arrow::io::RandomAccessFile>* file,
     const std::string& filename);
@@ -0,0 +1,484 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/batch_util.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// See documentation in ../../ops/experimental_dataset_ops.cc for a high-level
+// description of the following op.
+//
+// The length of an element is dimension 0 of its `length_index` component.
+// Elements are kept in one pending batch per bucket, and a batch is produced
+// as soon as its bucket holds `bucket_batch_sizes[i]` elements. Every
+// component is padded to the largest element in the batch (or, with
+// `pad_to_bucket_boundary`, the sequence dimension of the sequence features to
+// the bucket boundary), so
+// the padding of a batch is bounded by the width of its bucket instead of by
+// the longest sequence in the data. Two components are appended to each batch:
+// a bool mask of shape [batch, max_length] that is true on valid positions,
+// and the int32 lengths of shape [batch].
+
+constexpr char kDatasetType[] = "BucketBySequenceLength";
+constexpr char kLengthIndex[] = "length_index";
+constexpr char kPadToBucketBoundary[] = "pad_to_bucket_boundary";
+constexpr char kToutputTypes[] = "Toutput_types";
+constexpr char kOutputTypes[] = "output_types";
+constexpr char kOutputShapes[] = "output_shapes";
+
+constexpr char kInputExhausted[] = "input_exhausted";
+constexpr char kBucketSize[] = "bucket_size";
+constexpr char kElement[] = "element";
+
+class BucketBySequenceLengthDatasetOp : public UnaryDatasetOpKernel {
+ public:
+  explicit BucketBySequenceLengthDatasetOp(OpKernelConstruction* ctx)
+      : UnaryDatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kLengthIndex, &length_index_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr(kPadToBucketBoundary, &pad_to_bucket_boundary_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputTypes, &output_types_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputShapes, &output_shapes_));
+  }
+
+ protected:
+  void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
+                   DatasetBase** output) override {
+    const int num_components = input->output_dtypes().size();
+    OP_REQUIRES(ctx, length_index_ >= 0 && length_index_ < num_components,
+                errors::InvalidArgument("length_index ", length_index_,
+                                        " is out of range for ",
+                                        num_components, " components."));
+    OP_REQUIRES(
+        ctx, output_types_.size() == num_components + 2,
+        errors::InvalidArgument("Expected ", num_components + 2,
+                                " output types, got ", output_types_.size()));
+
+    const Tensor* boundaries_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("bucket_boundaries", &boundaries_tensor));
+    OP_REQUIRES(
+        ctx, boundaries_tensor->dims() == 1,
+        errors::InvalidArgument("`bucket_boundaries` must be a vector."));
+    std::vector<int64> bucket_boundaries;
+    for (int64 i = 0; i < boundaries_tensor->NumElements(); ++i) {
+      bucket_boundaries.push_back(boundaries_tensor->vec<int64>()(i));
+      OP_REQUIRES(ctx,
+                  bucket_boundaries.back() > 0 &&
+                      (i == 0 || bucket_boundaries[i - 1] < bucket_boundaries[i]),
+                  errors::InvalidArgument("bucket_boundaries must be positive "
+                                          "and strictly increasing."));
+    }
+
+    const Tensor* batch_sizes_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("bucket_batch_sizes", &batch_sizes_tensor));
+    OP_REQUIRES(
+        ctx, batch_sizes_tensor->dims() == 1,
+        errors::InvalidArgument("`bucket_batch_sizes` must be a vector."));
+    OP_REQUIRES(ctx,
+                batch_sizes_tensor->NumElements() ==
+                    bucket_boundaries.size() + 1,
+                errors::InvalidArgument(
+                    "len(bucket_batch_sizes) must equal "
+                    "len(bucket_boundaries) + 1"));
+    std::vector<int64> bucket_batch_sizes;
+    for (int64 i = 0; i < batch_sizes_tensor->NumElements(); ++i) {
+      bucket_batch_sizes.push_back(batch_sizes_tensor->vec<int64>()(i));
+      OP_REQUIRES(ctx, bucket_batch_sizes.back() > 0,
+                  errors::InvalidArgument(
+                      "bucket_batch_sizes must be greater than zero."));
+    }
+
+    OpInputList padding_values_list;
+    OP_REQUIRES_OK(ctx,
+                   ctx->input_list("padding_values", &padding_values_list));
+    OP_REQUIRES(ctx, padding_values_list.size() == num_components,
+                errors::InvalidArgument("Expected ", num_components,
+                                        " padding values, got ",
+                                        padding_values_list.size()));
+    std::vector<Tensor> padding_values;
+    for (int i = 0; i < padding_values_list.size(); ++i) {
+      OP_REQUIRES(ctx,
+                  TensorShapeUtils::IsScalar(padding_values_list[i].shape()),
+                  errors::InvalidArgument(
+                      "All padding values must be scalars; but at index ", i,
+                      " saw shape ",
+                      padding_values_list[i].shape().DebugString()));
+      padding_values.push_back(tensor::DeepCopy(padding_values_list[i]));
+    }
+
+    bool drop_remainder;
+    OP_REQUIRES_OK(
+        ctx, ParseScalarArgument<bool>(ctx, "drop_remainder", &drop_remainder));
+
+    *output = new Dataset(ctx, input, length_index_, pad_to_bucket_boundary_,
+                          std::move(bucket_boundaries),
+                          std::move(bucket_batch_sizes),
+                          std::move(padding_values), drop_remainder,
+                          output_types_, output_shapes_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, const DatasetBase* input, int length_index,
+            bool pad_to_bucket_boundary, std::vector<int64> bucket_boundaries,
+            std::vector<int64> bucket_batch_sizes,
+            std::vector<Tensor> padding_values, bool drop_remainder,
+            const DataTypeVector& output_types,
+            const std::vector<PartialTensorShape>& output_shapes)
+        : DatasetBase(DatasetContext(ctx)),
+          input_(input),
+          length_index_(length_index),
+          pad_to_bucket_boundary_(pad_to_bucket_boundary),
+          bucket_boundaries_(std::move(bucket_boundaries)),
+          bucket_batch_sizes_(std::move(bucket_batch_sizes)),
+          padding_values_(std::move(padding_values)),
+          drop_remainder_(drop_remainder),
+          output_types_(output_types),
+          output_shapes_(output_shapes) {
+      input_->Ref();
+    }
+
+    ~Dataset() override { input_->Unref(); }
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(Iterator::Params{
+          this, strings::StrCat(prefix, "::", kDatasetType)});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return output_types_;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return "BucketBySequenceLengthDatasetOp::Dataset";
+    }
+
+    Status CheckExternalState() const override {
+      return input_->CheckExternalState();
+    }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* input_graph_node = nullptr;
+      TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+      Node* bucket_boundaries = nullptr;
+      TF_RETURN_IF_ERROR(b->AddVector(bucket_boundaries_, &bucket_boundaries));
+      Node* bucket_batch_sizes = nullptr;
+      TF_RETURN_IF_ERROR(
+          b->AddVector(bucket_batch_sizes_, &bucket_batch_sizes));
+      std::vector<Node*> padding_values;
+      padding_values.reserve(padding_values_.size());
+      for (const Tensor& t : padding_values_) {
+        Node* node;
+        TF_RETURN_IF_ERROR(b->AddTensor(t, &node));
+        padding_values.emplace_back(node);
+      }
+      Node* drop_remainder = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(drop_remainder_, &drop_remainder));
+
+      AttrValue length_index;
+      b->BuildAttrValue(length_index_, &length_index);
+      AttrValue pad_to_bucket_boundary;
+      b->BuildAttrValue(pad_to_bucket_boundary_, &pad_to_bucket_boundary);
+      AttrValue padding_types;
+      b->BuildAttrValue(input_->output_dtypes(), &padding_types);
+
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this,
+          {{0, input_graph_node},
+           {1, bucket_boundaries},
+           {2, bucket_batch_sizes},
+           {4, drop_remainder}},
+          {{3, padding_values}},
+          {{kLengthIndex, length_index},
+           {kPadToBucketBoundary, pad_to_bucket_boundary},
+           {kToutputTypes, padding_types}},
+          output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params),
+            buckets_(params.dataset->bucket_batch_sizes_.size()) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        while (!input_exhausted_) {
+          std::vector<Tensor> element;
+          bool end_of_input = false;
+          TF_RETURN_IF_ERROR(
+              input_impl_->GetNext(ctx, &element, &end_of_input));
+          if (end_of_input) {
+            input_exhausted_ = true;
+            break;
+          }
+          const Tensor& sequence = element[dataset()->length_index_];
+          if (sequence.dims() < 1) {
+            return errors::InvalidArgument(
+                "The sequence component must have rank >= 1, got shape ",
+                sequence.shape().DebugString());
+          }
+          const size_t bucket = BucketOf(sequence.dim_size(0));
+          buckets_[bucket].push_back(std::move(element));
+          if (buckets_[bucket].size() ==
+              dataset()->bucket_batch_sizes_[bucket]) {
+            return EmitBucketLocked(ctx, bucket, out_tensors, end_of_sequence);
+          }
+        }
+        // Flush the partial batches once the input is exhausted.
+        for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+          if (buckets_[bucket].empty()) continue;
+          if (dataset()->drop_remainder_) {
+            buckets_[bucket].clear();
+            continue;
+          }
+          return EmitBucketLocked(ctx, bucket, out_tensors, end_of_sequence);
+        }
+        *end_of_sequence = true;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeUnknownRatioNode(std::move(args));
+      }
+
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(SaveInput(writer, input_impl_));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(kInputExhausted), static_cast<int64>(input_exhausted_)));
+        for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+          const auto& elements = buckets_[bucket];
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name(strings::StrCat(kBucketSize, "[", bucket, "]")),
+              static_cast<int64>(elements.size())));
+          for (size_t i = 0; i < elements.size(); ++i) {
+            for (size_t j = 0; j < elements[i].size(); ++j) {
+              TF_RETURN_IF_ERROR(writer->WriteTensor(
+                  full_name(strings::StrCat(kElement, "[", bucket, "][", i,
+                                            "][", j, "]")),
+                  elements[i][j]));
+            }
+          }
+        }
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(RestoreInput(ctx, reader, input_impl_));
+        int64 input_exhausted;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kInputExhausted), &input_exhausted));
+        input_exhausted_ = static_cast<bool>(input_exhausted);
+        const size_t num_components = dataset()->input_->output_dtypes().size();
+        for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+          int64 size;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name(strings::StrCat(kBucketSize, "[", bucket, "]")),
+              &size));
+          buckets_[bucket].clear();
+          buckets_[bucket].resize(size);
+          for (int64 i = 0; i < size; ++i) {
+            buckets_[bucket][i].resize(num_components);
+            for (size_t j = 0; j < num_components; ++j) {
+              TF_RETURN_IF_ERROR(reader->ReadTensor(
+                  full_name(strings::StrCat(kElement, "[", bucket, "][", i,
+                                            "][", j, "]")),
+                  &buckets_[bucket][i][j]));
+            }
+          }
+        }
+        return Status::OK();
+      }
+
+     private:
+      size_t BucketOf(int64 length) const {
+        const auto& boundaries = dataset()->bucket_boundaries_;
+        return std::upper_bound(boundaries.begin(), boundaries.end(), length) -
+               boundaries.begin();
+      }
+
+      // Pads and batches the elements of `bucket`, then appends the mask and
+      // the lengths of the sequence component.
+      Status EmitBucketLocked(IteratorContext* ctx, size_t bucket,
+                              std::vector<Tensor>* out_tensors,
+                              bool* end_of_sequence)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        std::vector<std::vector<Tensor>> elements;
+        elements.swap(buckets_[bucket]);
+        const int64 batch_size = elements.size();
+        const size_t num_components = elements[0].size();
+        const int length_index = dataset()->length_index_;
+        const bool pad_to_boundary =
+            dataset()->pad_to_bucket_boundary_ &&
+            bucket < dataset()->bucket_boundaries_.size();
+        const auto& input_shapes = dataset()->input_->output_shapes();
+        // Read the lengths first, the elements are moved into the batch.
+        std::vector<int64> lengths(batch_size);
+        for (int64 i = 0; i < batch_size; ++i) {
+          lengths[i] = elements[i][length_index].dim_size(0);
+        }
+        // The sequence features are the variable length components whose
+        // dimension 0 is the sequence length in every element, e.g. the ids
+        // and the categories of one behavior sequence. Only those are padded
+        // to the bucket boundary, so that they stay aligned with the mask.
+        auto is_sequence_feature = [&](size_t c) {
+          if (input_shapes[c].dims() >= 1 &&
+              input_shapes[c].dim_size(0) != -1) {
+            return false;
+          }
+          for (int64 i = 0; i < batch_size; ++i) {
+            if (elements[i][c].dims() < 1 ||
+                elements[i][c].dim_size(0) != lengths[i]) {
+              return false;
+            }
+          }
+          return true;
+        };
+
+        out_tensors->reserve(num_components + 2);
+        for (size_t c = 0; c < num_components; ++c) {
+          const int rank = elements[0][c].dims();
+          const bool pad_component_to_boundary =
+              pad_to_boundary && rank >= 1 && is_sequence_feature(c);
+          TensorShape batch_shape({batch_size});
+          for (int d = 0; d < rank; ++d) {
+            int64 size = 0;
+            for (const auto& element : elements) {
+              if (element[c].dims() != rank) {
+                return errors::InvalidArgument(
+                    "All elements in a batch must have the same rank for "
+                    "component ",
+                    c, ": expected rank ", rank, " but got element with rank ",
+                    element[c].dims());
+              }
+              size = std::max(size, element[c].dim_size(d));
+            }
+            // Pad the sequence dimension of the sequence features to the
+            // longest length of the bucket.
+            if (d == 0 && pad_component_to_boundary) {
+              const int64 boundary =
+                  dataset()->bucket_boundaries_[bucket] - 1;
+              if (size > boundary) {
+                return errors::DataLoss(
+                    "Attempted to pad to a smaller size than the input "
+                    "element.");
+              }
+              size = boundary;
+            }
+            batch_shape.AddDim(size);
+          }
+          out_tensors->emplace_back(ctx->allocator({}),
+                                    elements[0][c].dtype(), batch_shape);
+          Tensor& batch = out_tensors->back();
+          TF_RETURN_IF_ERROR(
+              batch_util::SetElementZero(&batch, dataset()->padding_values_[c]));
+          TensorShape element_shape = batch_shape;
+          element_shape.RemoveDim(0);
+          for (int64 i = 0; i < batch_size; ++i) {
+            if (elements[i][c].shape() == element_shape) {
+              TF_RETURN_IF_ERROR(batch_util::CopyElementToSlice(
+                  std::move(elements[i][c]), &batch, i));
+            } else {
+              TF_RETURN_IF_ERROR(
+                  batch_util::CopyElementToLargerSlice(elements[i][c], &batch,
+                                                       i));
+            }
+          }
+        }
+
+        const int64 max_length = (*out_tensors)[length_index].dim_size(1);
+        Tensor mask(ctx->allocator({}), DT_BOOL,
+                    TensorShape({batch_size, max_length}));
+        Tensor lengths_tensor(ctx->allocator({}), DT_INT32,
+                              TensorShape({batch_size}));
+        auto mask_matrix = mask.matrix<bool>();
+        auto lengths_vec = lengths_tensor.vec<int32>();
+        for (int64 i = 0; i < batch_size; ++i) {
+          lengths_vec(i) = static_cast<int32>(lengths[i]);
+          for (int64 j = 0; j < max_length; ++j) {
+            mask_matrix(i, j) = j < lengths[i];
+          }
+        }
+        out_tensors->push_back(std::move(mask));
+        out_tensors->push_back(std::move(lengths_tensor));
+        *end_of_sequence = false;
+        return Status::OK();
+      }
+
+      mutex mu_;
+      std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
+      bool input_exhausted_ GUARDED_BY(mu_) = false;
+      // The pending batch of each bucket.
+      std::vector<std::vector<std::vector<Tensor>>> buckets_ GUARDED_BY(mu_);
+    };  // class Iterator
+
+    const DatasetBase* const input_;
+    const int length_index_;
+    const bool pad_to_bucket_boundary_;
+    const std::vector<int64> bucket_boundaries_;
+    const std::vector<int64> bucket_batch_sizes_;
+    const std::vector<Tensor> padding_values_;
+    const bool drop_remainder_;
+    const DataTypeVector output_types_;
+    const std::vector<PartialTensorShape> output_shapes_;
+  };  // class Dataset
+
+  int length_index_;
+  bool pad_to_bucket_boundary_;
+  DataTypeVector output_types_;
+  std::vector<PartialTensorShape> output_shapes_;
+};  // class BucketBySequenceLengthDatasetOp
+
+REGISTER_KERNEL_BUILDER(
+    Name("BucketBySequenceLengthDataset").Device(DEVICE_CPU),
+    BucketBySequenceLengthDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
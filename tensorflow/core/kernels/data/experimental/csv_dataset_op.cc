@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/kernels/data/experimental/csv_scanner.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
@@ -444,7 +445,8 @@ class CSVDatasetOp : public DatasetOpKernel {
         pos_++;  // Starting quotation mark
 
         Status parse_result;
-        while (true) {  // Each iter reads 1 char, filling buffer if necessary
+        while (true) {  // Each iter scans to the next quote, filling buffer if
+                        // necessary
           if (pos_ >= buffer_.size()) {
             Status s = SaveAndFillBuffer(&earlier_pieces, &start, include);
             if (errors::IsOutOfRange(s)) {
@@ -456,6 +458,12 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
           }
 
+          // Jump to the next quotation mark, everything before it is part of
+          // the field.
+          pos_ += csv::FindQuote(buffer_.data() + pos_,
+                                 buffer_.data() + buffer_.size());
+          if (pos_ >= buffer_.size()) continue;
+
           char ch = buffer_[pos_];
           if (ch == '"') {
             // When we encounter a quote, we look ahead to the next character to
@@ -576,7 +584,8 @@ class CSVDatasetOp : public DatasetOpKernel {
         size_t start = pos_;
         Status parse_result;
 
-        while (true) {  // Each iter reads 1 char, filling buffer if necessary
+        while (true) {  // Each iter scans to the next special char, filling
+                        // buffer if necessary
           if (pos_ >= buffer_.size()) {
             Status s = SaveAndFillBuffer(&earlier_pieces, &start, include);
             // Handle errors
@@ -592,6 +601,12 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
           }
 
+          // Jump to the next delimiter, line break or quote in bulk.
+          pos_ += csv::FindFieldEnd(buffer_.data() + pos_,
+                                    buffer_.data() + buffer_.size(),
+                                    dataset()->delim_);
+          if (pos_ >= buffer_.size()) continue;
+
           char ch = buffer_[pos_];
 
           if (ch == dataset()->delim_) {
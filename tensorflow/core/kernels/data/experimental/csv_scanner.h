@@ -0,0 +1,134 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_CSV_SCANNER_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_CSV_SCANNER_H_
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace csv {
+
+// Vectorized scanning primitives shared by the CSV readers. Each function
+// returns the offset of the first byte in [begin, end) matching one of the
+// given characters, or `end - begin` if there is none. 32 (AVX2) or 16 (SSE2)
+// bytes are compared per step, the tail is handled byte by byte.
+
+namespace internal {
+
+#if defined(__AVX2__)
+constexpr size_t kStride = 32;
+
+inline uint32 MatchMask(const char* p, __m256i a, __m256i b, __m256i c,
+                        __m256i d) {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i m = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, b)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, c), _mm256_cmpeq_epi8(v, d)));
+  return static_cast<uint32>(_mm256_movemask_epi8(m));
+}
+
+#define CSV_SCANNER_SPLAT(ch) _mm256_set1_epi8(ch)
+#elif defined(__SSE2__)
+constexpr size_t kStride = 16;
+
+inline uint32 MatchMask(const char* p, __m128i a, __m128i b, __m128i c,
+                        __m128i d) {
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  const __m128i m =
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, b)),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, c), _mm_cmpeq_epi8(v, d)));
+  return static_cast<uint32>(_mm_movemask_epi8(m));
+}
+
+#define CSV_SCANNER_SPLAT(ch) _mm_set1_epi8(ch)
+#endif
+
+}  // namespace internal
+
+// Returns the offset of the first of up to four characters `a`, `b`, `c` and
+// `d`. Pass the same character several times to search for fewer.
+inline size_t FindAnyOf4(const char* begin, const char* end, char a, char b,
+                         char c, char d) {
+  const char* p = begin;
+#if defined(CSV_SCANNER_SPLAT)
+  const auto va = CSV_SCANNER_SPLAT(a);
+  const auto vb = CSV_SCANNER_SPLAT(b);
+  const auto vc = CSV_SCANNER_SPLAT(c);
+  const auto vd = CSV_SCANNER_SPLAT(d);
+  while (p + internal::kStride <= end) {
+    const uint32 mask = internal::MatchMask(p, va, vb, vc, vd);
+    if (mask != 0) {
+      return (p - begin) + __builtin_ctz(mask);
+    }
+    p += internal::kStride;
+  }
+#endif
+  for (; p < end; ++p) {
+    const char ch = *p;
+    if (ch == a || ch == b || ch == c || ch == d) break;
+  }
+  return p - begin;
+}
+
+// Returns the offset of the end of the current unquoted field, i.e. the first
+// field delimiter, line break or quote.
+inline size_t FindFieldEnd(const char* begin, const char* end, char delim) {
+  return FindAnyOf4(begin, end, delim, '\n', '\r', '"');
+}
+
+// Returns the offset of the next quote.
+inline size_t FindQuote(const char* begin, const char* end) {
+  const void* p = memchr(begin, '"', end - begin);
+  return p == nullptr ? end - begin : static_cast<const char*>(p) - begin;
+}
+
+// Returns the offset of the next '\n'.
+inline size_t FindNewline(const char* begin, const char* end) {
+  const void* p = memchr(begin, '\n', end - begin);
+  return p == nullptr ? end - begin : static_cast<const char*>(p) - begin;
+}
+
+// Returns the number of non-empty lines in [begin, end). A line is terminated
+// by '\n', an optional '\r' before it is ignored, and a trailing line without
+// terminator is counted.
+inline int64 CountLines(const char* begin, const char* end) {
+  int64 count = 0;
+  const char* line = begin;
+  while (line < end) {
+    const char* eol = line + FindNewline(line, end);
+    const char* content_end = eol;
+    if (content_end > line && content_end[-1] == '\r') --content_end;
+    if (content_end > line) ++count;
+    line = eol + 1;
+  }
+  return count;
+}
+
+}  // namespace csv
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
+
+#undef CSV_SCANNER_SPLAT
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_CSV_SCANNER_H_
@@ -0,0 +1,477 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/data/random_seed_ops.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/file_system.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// See documentation in ../../ops/experimental_dataset_ops.cc for a high-level
+// description of the following op.
+//
+// Unlike `ShuffleDataset`, which buffers `buffer_size` decoded elements, this
+// dataset only keeps an index of (file, offset, length) per record. The index
+// is shuffled as a whole, so every epoch is a uniform permutation of all
+// records, and the record payloads are fetched lazily one window at a time.
+// Inside a window the reads are issued in (file, offset) order, which turns
+// random I/O into mostly forward scans, while the records are still emitted in
+// the shuffled order.
+
+constexpr char kDatasetType[] = "IndexedShuffleTFRecord";
+constexpr char kNextIndex[] = "next_index";
+constexpr char kIndexBuilt[] = "index_built";
+constexpr char kSeed[] = "seed";
+constexpr char kSeed2[] = "seed2";
+constexpr char kTFData[] = "tf_data";
+constexpr char kRandomSeedGenerator[] = "RandomSeedGenerator";
+constexpr char kDSNumRandomSamples[] = "ds_num_random_samples";
+constexpr char kReshuffleEachIteration[] = "reshuffle_each_iteration";
+
+constexpr size_t kHeaderSize = io::RecordReader::kHeaderSize;
+constexpr size_t kFooterSize = io::RecordReader::kFooterSize;
+
+struct RecordIndexEntry {
+  uint32 file_index;
+  uint32 length;
+  uint64 offset;  // Offset of the record payload, i.e. past the header.
+};
+
+// Provides random access to the payload of a single record file, either
+// through a read-only memory mapping or through positional reads.
+class RecordFileSource {
+ public:
+  static Status Open(Env* env, const string& filename, bool use_mmap,
+                     std::unique_ptr<RecordFileSource>* out) {
+    std::unique_ptr<RecordFileSource> source(new RecordFileSource);
+    source->filename_ = filename;
+    TF_RETURN_IF_ERROR(env->GetFileSize(filename, &source->file_size_));
+    if (use_mmap) {
+      Status s = env->NewReadOnlyMemoryRegionFromFile(filename,
+                                                      &source->region_);
+      if (!s.ok()) {
+        // Not every file system supports memory mapping, fall back to pread.
+        VLOG(1) << "Memory mapping " << filename
+                << " failed, falling back to positional reads: " << s;
+        source->region_.reset();
+      }
+    }
+    if (source->region_ == nullptr) {
+      TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &source->file_));
+    }
+    *out = std::move(source);
+    return Status::OK();
+  }
+
+  uint64 file_size() const { return file_size_; }
+
+  // Reads `n` bytes at `offset`. `scratch` must hold at least `n` bytes and
+  // is only used when the file is not memory mapped.
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const {
+    if (offset + n > file_size_) {
+      return errors::DataLoss("truncated record at ", offset, " in ",
+                              filename_);
+    }
+    if (region_ != nullptr) {
+      *result = StringPiece(
+          static_cast<const char*>(region_->data()) + offset, n);
+      return Status::OK();
+    }
+    Status s = file_->Read(offset, n, result, scratch);
+    if (result->size() != n) {
+      return errors::DataLoss("truncated record at ", offset, " in ",
+                              filename_);
+    }
+    if (errors::IsOutOfRange(s)) return Status::OK();
+    return s;
+  }
+
+ private:
+  RecordFileSource() = default;
+
+  string filename_;
+  uint64 file_size_ = 0;
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  std::unique_ptr<RandomAccessFile> file_;
+};
+
+class IndexedShuffleTFRecordDatasetOp : public DatasetOpKernel {
+ public:
+  explicit IndexedShuffleTFRecordDatasetOp(OpKernelConstruction* ctx)
+      : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_mmap", &use_mmap_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kReshuffleEachIteration,
+                                     &reshuffle_each_iteration_));
+  }
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
+    const Tensor* filenames_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("filenames", &filenames_tensor));
+    OP_REQUIRES(
+        ctx, filenames_tensor->dims() <= 1,
+        errors::InvalidArgument("`filenames` must be a scalar or a vector."));
+
+    std::vector<string> filenames;
+    filenames.reserve(filenames_tensor->NumElements());
+    for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
+      filenames.push_back(filenames_tensor->flat<tstring>()(i));
+    }
+
+    int64 window_size = 0;
+    OP_REQUIRES_OK(
+        ctx, ParseScalarArgument<int64>(ctx, "window_size", &window_size));
+    OP_REQUIRES(ctx, window_size > 0,
+                errors::InvalidArgument("window_size must be greater than 0."));
+
+    int64 seed;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "seed", &seed));
+    int64 seed2;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "seed2", &seed2));
+    // By TensorFlow convention, passing 0 for both seeds indicates that the
+    // shuffling should be seeded non-deterministically.
+    if (seed == 0 && seed2 == 0) {
+      seed = random::New64();
+      seed2 = random::New64();
+    }
+
+    *output = new Dataset(ctx, std::move(filenames), window_size, seed, seed2,
+                          use_mmap_, reshuffle_each_iteration_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, std::vector<string> filenames,
+            int64 window_size, int64 seed, int64 seed2, bool use_mmap,
+            bool reshuffle_each_iteration)
+        : DatasetBase(DatasetContext(ctx)),
+          filenames_(std::move(filenames)),
+          window_size_(window_size),
+          seed_(seed),
+          seed2_(seed2),
+          use_mmap_(use_mmap),
+          reshuffle_each_iteration_(reshuffle_each_iteration) {}
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(Iterator::Params{
+          this, strings::StrCat(prefix, "::", kDatasetType)});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      static DataTypeVector* dtypes = new DataTypeVector({DT_STRING});
+      return *dtypes;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      static std::vector<PartialTensorShape>* shapes =
+          new std::vector<PartialTensorShape>({{}});
+      return *shapes;
+    }
+
+    string DebugString() const override {
+      return "IndexedShuffleTFRecordDatasetOp::Dataset";
+    }
+
+    Status CheckExternalState() const override { return Status::OK(); }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* filenames = nullptr;
+      TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
+      Node* window_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(window_size_, &window_size));
+      Node* seed = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(seed_, &seed));
+      Node* seed2 = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(seed2_, &seed2));
+      AttrValue use_mmap;
+      b->BuildAttrValue(use_mmap_, &use_mmap);
+      AttrValue reshuffle_each_iteration;
+      b->BuildAttrValue(reshuffle_each_iteration_, &reshuffle_each_iteration);
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this, {filenames, window_size, seed, seed2},
+          {std::make_pair("use_mmap", use_mmap),
+           std::make_pair(kReshuffleEachIteration, reshuffle_each_iteration)},
+          output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params),
+            seed_(params.dataset->seed_),
+            seed2_(params.dataset->seed2_) {}
+
+      ~Iterator() override {
+        if (seed_generator_ != nullptr) seed_generator_->Unref();
+      }
+
+      // Like `ShuffleDataset`, every iterator created from the same iterator
+      // resource, e.g. one per epoch under `repeat()`, draws its seeds from a
+      // shared `RandomSeedGenerator`, so each epoch is a new permutation.
+      Status Initialize(IteratorContext* ctx) override {
+        if (!dataset()->reshuffle_each_iteration_) return Status::OK();
+        const string name = strings::StrCat(prefix(), "::", kDatasetType,
+                                            "::", kRandomSeedGenerator);
+        const int64 dataset_seed = dataset()->seed_;
+        const int64 dataset_seed2 = dataset()->seed2_;
+        TF_RETURN_IF_ERROR(
+            ctx->resource_mgr()->LookupOrCreate<RandomSeedGenerator>(
+                kTFData, name, &seed_generator_,
+                [dataset_seed,
+                 dataset_seed2](RandomSeedGenerator** seed_generator) {
+                  *seed_generator =
+                      new RandomSeedGenerator(dataset_seed, dataset_seed2);
+                  return Status::OK();
+                }));
+        mutex_lock l(mu_);
+        seed_generator_->GenerateRandomSeeds(&seed_, &seed2_);
+        return Status::OK();
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (!index_built_) {
+          TF_RETURN_IF_ERROR(BuildIndexLocked(ctx->env()));
+        }
+        if (next_index_ >= index_.size()) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        if (window_pos_ >= window_.size()) {
+          TF_RETURN_IF_ERROR(FillWindowLocked());
+        }
+        out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                  TensorShape({}));
+        out_tensors->back().scalar<tstring>()() =
+            std::move(window_[window_pos_]);
+        ++window_pos_;
+        ++next_index_;
+        *end_of_sequence = false;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeSourceNode(std::move(args));
+      }
+
+      // The index is a pure function of the files and the seeds, so only the
+      // seeds and the position in the permutation need to be checkpointed.
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        if (seed_generator_ != nullptr) {
+          TF_RETURN_IF_ERROR(
+              writer->WriteScalar(full_name(kDSNumRandomSamples),
+                                  seed_generator_->num_random_samples()));
+        }
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kSeed), seed_));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kSeed2), seed2_));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kIndexBuilt), index_built_));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(kNextIndex), static_cast<int64>(next_index_)));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        if (seed_generator_ != nullptr) {
+          int64 num_random_samples;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name(kDSNumRandomSamples), &num_random_samples));
+          seed_generator_->set_num_random_samples(num_random_samples);
+          seed_generator_->Reset();
+        }
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kSeed), &seed_));
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kSeed2), &seed2_));
+        int64 index_built;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kIndexBuilt), &index_built));
+        int64 next_index;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kNextIndex), &next_index));
+        index_built_ = false;
+        index_.clear();
+        sources_.clear();
+        window_.clear();
+        window_pos_ = 0;
+        next_index_ = 0;
+        if (index_built) {
+          TF_RETURN_IF_ERROR(BuildIndexLocked(ctx->env()));
+          if (next_index < 0 ||
+              next_index > static_cast<int64>(index_.size())) {
+            return errors::DataLoss("Restored position ", next_index,
+                                    " is out of range for ", index_.size(),
+                                    " indexed records.");
+          }
+          next_index_ = next_index;
+        }
+        return Status::OK();
+      }
+
+     private:
+      // Scans the record headers of every file, skipping over the payloads,
+      // then shuffles the resulting index.
+      Status BuildIndexLocked(Env* env) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const std::vector<string>& filenames = dataset()->filenames_;
+        sources_.resize(filenames.size());
+        char header[kHeaderSize];
+        for (size_t i = 0; i < filenames.size(); ++i) {
+          TF_RETURN_IF_ERROR(RecordFileSource::Open(
+              env, filenames[i], dataset()->use_mmap_, &sources_[i]));
+          const RecordFileSource* source = sources_[i].get();
+          uint64 offset = 0;
+          while (offset < source->file_size()) {
+            StringPiece data;
+            TF_RETURN_IF_ERROR(
+                source->Read(offset, kHeaderSize, &data, header));
+            const uint64 length = core::DecodeFixed64(data.data());
+            const uint32 masked_crc =
+                core::DecodeFixed32(data.data() + sizeof(uint64));
+            if (crc32c::Unmask(masked_crc) !=
+                crc32c::Value(data.data(), sizeof(uint64))) {
+              return errors::DataLoss("corrupted record header at ", offset,
+                                      " in ", filenames[i]);
+            }
+            if (length > kuint32max) {
+              return errors::DataLoss("record at ", offset, " in ",
+                                      filenames[i], " is too large");
+            }
+            RecordIndexEntry entry;
+            entry.file_index = static_cast<uint32>(i);
+            entry.length = static_cast<uint32>(length);
+            entry.offset = offset + kHeaderSize;
+            index_.push_back(entry);
+            offset += kHeaderSize + length + kFooterSize;
+          }
+        }
+        VLOG(1) << "Indexed " << index_.size() << " records from "
+                << filenames.size() << " files.";
+
+        random::PhiloxRandom parent_generator(seed_, seed2_);
+        random::SingleSampleAdapter<random::PhiloxRandom> generator(
+            &parent_generator);
+        // Fisher-Yates over the index only, the payloads are never touched.
+        for (int64 i = static_cast<int64>(index_.size()) - 1; i > 0; --i) {
+          const uint64 r = (static_cast<uint64>(generator()) << 32) |
+                           static_cast<uint64>(generator());
+          std::swap(index_[i], index_[r % (i + 1)]);
+        }
+        index_built_ = true;
+        return Status::OK();
+      }
+
+      // Reads the next `window_size` records of the permutation. The reads
+      // are sorted by (file, offset) for locality, the results are kept in
+      // permutation order.
+      Status FillWindowLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const size_t begin = next_index_;
+        const size_t end = std::min(
+            index_.size(), begin + static_cast<size_t>(dataset()->window_size_));
+        window_.clear();
+        window_.resize(end - begin);
+        window_pos_ = 0;
+
+        std::vector<size_t> order(end - begin);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this, begin](size_t a,
+                                                            size_t b) {
+          const RecordIndexEntry& ea = index_[begin + a];
+          const RecordIndexEntry& eb = index_[begin + b];
+          return ea.file_index != eb.file_index ? ea.file_index < eb.file_index
+                                                : ea.offset < eb.offset;
+        });
+
+        std::vector<char> scratch;
+        for (size_t pos : order) {
+          const RecordIndexEntry& entry = index_[begin + pos];
+          const size_t n = entry.length + kFooterSize;
+          if (scratch.size() < n) scratch.resize(n);
+          StringPiece data;
+          TF_RETURN_IF_ERROR(sources_[entry.file_index]->Read(
+              entry.offset, n, &data, scratch.data()));
+          const uint32 masked_crc =
+              core::DecodeFixed32(data.data() + entry.length);
+          if (crc32c::Unmask(masked_crc) !=
+              crc32c::Value(data.data(), entry.length)) {
+            return errors::DataLoss("corrupted record at ",
+                                    entry.offset - kHeaderSize, " in ",
+                                    dataset()->filenames_[entry.file_index]);
+          }
+          window_[pos].assign(data.data(), entry.length);
+        }
+        return Status::OK();
+      }
+
+      mutex mu_;
+      int64 seed_ GUARDED_BY(mu_);
+      int64 seed2_ GUARDED_BY(mu_);
+      // Only set when `reshuffle_each_iteration` is true.
+      RandomSeedGenerator* seed_generator_ = nullptr;
+      bool index_built_ GUARDED_BY(mu_) = false;
+      std::vector<RecordIndexEntry> index_ GUARDED_BY(mu_);
+      std::vector<std::unique_ptr<RecordFileSource>> sources_ GUARDED_BY(mu_);
+      size_t next_index_ GUARDED_BY(mu_) = 0;
+      std::vector<tstring> window_ GUARDED_BY(mu_);
+      size_t window_pos_ GUARDED_BY(mu_) = 0;
+    };
+
+    const std::vector<string> filenames_;
+    const int64 window_size_;
+    const int64 seed_;
+    const int64 seed2_;
+    const bool use_mmap_;
+    const bool reshuffle_each_iteration_;
+  };
+
+  bool use_mmap_;
+  bool reshuffle_each_iteration_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("IndexedShuffleTFRecordDataset").Device(DEVICE_CPU),
+    IndexedShuffleTFRecordDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
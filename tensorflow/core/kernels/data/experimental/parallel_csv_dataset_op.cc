@@ -0,0 +1,740 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/kernels/data/experimental/csv_scanner.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/file_system.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// See documentation in ../../ops/experimental_dataset_ops.cc for a high-level
+// description of the following op.
+//
+// The reader works on chunks of `num_parallel_reads * block_size` bytes. A
+// chunk is cut at line boundaries into `num_parallel_reads` blocks, which are
+// parsed concurrently in two passes: the first pass counts the rows of every
+// block, so that one column tensor per output can be allocated for the whole
+// chunk, and the second pass splits the fields with the vectorized scanner
+// and converts them straight into their rows of the column tensors. Batches
+// are then sliced out of the column tensors.
+//
+// Since blocks are resynchronized on '\n', quoted fields may not contain line
+// breaks, and lines must be terminated by "\n" or "\r\n".
+
+constexpr char kDatasetType[] = "ParallelCSV";
+constexpr char kCurrentFileIndex[] = "current_file_index";
+constexpr char kFileOffset[] = "file_offset";
+constexpr char kCarry[] = "carry";
+constexpr char kHeaderSkipped[] = "header_skipped";
+constexpr char kNumRows[] = "num_rows";
+constexpr char kColumn[] = "column";
+
+class ParallelCSVDatasetOp : public DatasetOpKernel {
+ public:
+  explicit ParallelCSVDatasetOp(OpKernelConstruction* ctx)
+      : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("output_types", &output_types_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("output_shapes", &output_shapes_));
+  }
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
+    const Tensor* filenames_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("filenames", &filenames_tensor));
+    OP_REQUIRES(
+        ctx, filenames_tensor->dims() <= 1,
+        errors::InvalidArgument("`filenames` must be a scalar or a vector."));
+
+    int64 batch_size;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64>(ctx, "batch_size", &batch_size));
+    OP_REQUIRES(ctx, batch_size > 0,
+                errors::InvalidArgument("batch_size should be positive"));
+    int64 num_parallel_reads;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "num_parallel_reads",
+                                                   &num_parallel_reads));
+    OP_REQUIRES(
+        ctx, num_parallel_reads > 0,
+        errors::InvalidArgument("num_parallel_reads should be positive"));
+    int64 block_size;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64>(ctx, "block_size", &block_size));
+    OP_REQUIRES(ctx, block_size > 0,
+                errors::InvalidArgument("block_size should be positive"));
+
+    bool header;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<bool>(ctx, "header", &header));
+    string delim;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<string>(ctx, "field_delim", &delim));
+    OP_REQUIRES(ctx, delim.size() == 1,
+                errors::InvalidArgument("field_delim should be only 1 char"));
+    OP_REQUIRES(ctx, delim[0] != '\n' && delim[0] != '\r' && delim[0] != '"',
+                errors::InvalidArgument(
+                    "field_delim cannot be a line break or a quote"));
+    bool use_quote_delim;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<bool>(ctx, "use_quote_delim",
+                                                  &use_quote_delim));
+    string na_value;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<string>(ctx, "na_value", &na_value));
+
+    OpInputList record_defaults_list;
+    OP_REQUIRES_OK(ctx,
+                   ctx->input_list("record_defaults", &record_defaults_list));
+    std::vector<Tensor> record_defaults;
+    record_defaults.reserve(record_defaults_list.size());
+    for (int i = 0; i < record_defaults_list.size(); ++i) {
+      OP_REQUIRES(ctx, record_defaults_list[i].dims() <= 1,
+                  errors::InvalidArgument(
+                      "Each record default should be at most rank 1"));
+      OP_REQUIRES(ctx, record_defaults_list[i].NumElements() < 2,
+                  errors::InvalidArgument(
+                      "There should only be 1 default per field but field ", i,
+                      " has ", record_defaults_list[i].NumElements()));
+      OP_REQUIRES(
+          ctx, record_defaults_list[i].dtype() == output_types_[i],
+          errors::InvalidArgument("Record default of field ", i,
+                                  " does not match its output type"));
+      record_defaults.push_back(record_defaults_list[i]);
+    }
+
+    const Tensor* select_cols_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("select_cols", &select_cols_tensor));
+    OP_REQUIRES(ctx, select_cols_tensor->dims() == 1,
+                errors::InvalidArgument("`select_cols` must be a vector."));
+    std::vector<int64> select_cols;
+    select_cols.reserve(select_cols_tensor->NumElements());
+    for (int i = 0; i < select_cols_tensor->NumElements(); ++i) {
+      select_cols.push_back(select_cols_tensor->flat<int64>()(i));
+    }
+    OP_REQUIRES(
+        ctx, output_types_.size() == select_cols.size() || select_cols.empty(),
+        errors::InvalidArgument("select_cols should match output size"));
+    for (int i = 1; i < select_cols.size(); i++) {
+      OP_REQUIRES(ctx, select_cols[i - 1] < select_cols[i],
+                  errors::InvalidArgument(
+                      "select_cols should be strictly increasing indices"));
+    }
+    OP_REQUIRES(
+        ctx, select_cols.empty() || select_cols.front() >= 0,
+        errors::InvalidArgument("select_cols should be non-negative indices"));
+
+    std::vector<string> filenames;
+    filenames.reserve(filenames_tensor->NumElements());
+    for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
+      filenames.push_back(filenames_tensor->flat<tstring>()(i));
+    }
+
+    *output = new Dataset(ctx, std::move(filenames), batch_size,
+                          num_parallel_reads, block_size, header, delim[0],
+                          use_quote_delim, std::move(na_value),
+                          std::move(select_cols), std::move(record_defaults),
+                          output_types_, output_shapes_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, std::vector<string> filenames,
+            int64 batch_size, int64 num_parallel_reads, int64 block_size,
+            bool header, char delim, bool use_quote_delim, string na_value,
+            std::vector<int64> select_cols,
+            std::vector<Tensor> record_defaults,
+            const DataTypeVector& output_types,
+            const std::vector<PartialTensorShape>& output_shapes)
+        : DatasetBase(DatasetContext(ctx)),
+          filenames_(std::move(filenames)),
+          batch_size_(batch_size),
+          num_parallel_reads_(num_parallel_reads),
+          block_size_(block_size),
+          header_(header),
+          delim_(delim),
+          use_quote_delim_(use_quote_delim),
+          na_value_(std::move(na_value)),
+          select_cols_(std::move(select_cols)),
+          record_defaults_(std::move(record_defaults)),
+          out_type_(output_types),
+          output_shapes_(output_shapes) {}
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(Iterator::Params{
+          this, strings::StrCat(prefix, "::", kDatasetType)});
+    }
+
+    const DataTypeVector& output_dtypes() const override { return out_type_; }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return "ParallelCSVDatasetOp::Dataset";
+    }
+
+    Status CheckExternalState() const override { return Status::OK(); }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* filenames = nullptr;
+      Node* batch_size = nullptr;
+      Node* num_parallel_reads = nullptr;
+      Node* block_size = nullptr;
+      Node* header = nullptr;
+      Node* delim = nullptr;
+      Node* use_quote_delim = nullptr;
+      Node* na_value = nullptr;
+      Node* select_cols = nullptr;
+
+      std::vector<Node*> record_defaults;
+      record_defaults.reserve(record_defaults_.size());
+      for (const Tensor& t : record_defaults_) {
+        Node* node;
+        TF_RETURN_IF_ERROR(b->AddTensor(t, &node));
+        record_defaults.emplace_back(node);
+      }
+
+      TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
+      TF_RETURN_IF_ERROR(b->AddScalar(batch_size_, &batch_size));
+      TF_RETURN_IF_ERROR(
+          b->AddScalar(num_parallel_reads_, &num_parallel_reads));
+      TF_RETURN_IF_ERROR(b->AddScalar(block_size_, &block_size));
+      TF_RETURN_IF_ERROR(b->AddScalar(header_, &header));
+      string delim_string(1, delim_);
+      TF_RETURN_IF_ERROR(b->AddScalar(delim_string, &delim));
+      TF_RETURN_IF_ERROR(b->AddScalar(use_quote_delim_, &use_quote_delim));
+      TF_RETURN_IF_ERROR(b->AddScalar(na_value_, &na_value));
+      TF_RETURN_IF_ERROR(b->AddVector(select_cols_, &select_cols));
+
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this,
+          {std::make_pair(0, filenames), std::make_pair(1, batch_size),
+           std::make_pair(2, num_parallel_reads),
+           std::make_pair(3, block_size), std::make_pair(4, header),
+           std::make_pair(5, delim), std::make_pair(6, use_quote_delim),
+           std::make_pair(7, na_value),
+           std::make_pair(8, select_cols)},      // Single tensor inputs
+          {std::make_pair(9, record_defaults)},  // Tensor list inputs
+          {}, output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        // Parse until a full batch is buffered or the input is exhausted.
+        while (num_rows_ - row_pos_ < dataset()->batch_size_) {
+          bool end_of_input = false;
+          TF_RETURN_IF_ERROR(ReadChunkLocked(ctx, &end_of_input));
+          if (end_of_input) break;
+        }
+        const int64 remaining = num_rows_ - row_pos_;
+        if (remaining == 0) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        const int64 n = std::min(remaining, dataset()->batch_size_);
+        out_tensors->reserve(columns_.size());
+        for (const Tensor& column : columns_) {
+          Tensor slice = column.Slice(row_pos_, row_pos_ + n);
+          if (slice.IsAligned()) {
+            out_tensors->push_back(std::move(slice));
+          } else {
+            out_tensors->push_back(tensor::DeepCopy(slice));
+          }
+        }
+        row_pos_ += n;
+        *end_of_sequence = false;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeSourceNode(std::move(args));
+      }
+
+      // Saves the position in the input together with the parsed rows that
+      // have not been produced yet.
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kCurrentFileIndex),
+                                               current_file_index_));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kFileOffset), file_offset_));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kCarry), tstring(carry_)));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(kHeaderSkipped), static_cast<int64>(header_skipped_)));
+        const int64 remaining = num_rows_ - row_pos_;
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kNumRows), remaining));
+        if (remaining > 0) {
+          for (size_t i = 0; i < columns_.size(); ++i) {
+            TF_RETURN_IF_ERROR(writer->WriteTensor(
+                full_name(strings::StrCat(kColumn, "[", i, "]")),
+                columns_[i].Slice(row_pos_, num_rows_)));
+          }
+        }
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        file_.reset();
+        int64 current_file_index;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kCurrentFileIndex),
+                                              &current_file_index));
+        current_file_index_ = current_file_index;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kFileOffset), &file_offset_));
+        tstring carry;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kCarry), &carry));
+        carry_ = carry;
+        int64 header_skipped;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kHeaderSkipped), &header_skipped));
+        header_skipped_ = static_cast<bool>(header_skipped);
+        int64 remaining;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kNumRows), &remaining));
+        columns_.clear();
+        num_rows_ = remaining;
+        row_pos_ = 0;
+        if (remaining > 0) {
+          columns_.resize(dataset()->out_type_.size());
+          for (size_t i = 0; i < columns_.size(); ++i) {
+            TF_RETURN_IF_ERROR(reader->ReadTensor(
+                full_name(strings::StrCat(kColumn, "[", i, "]")),
+                &columns_[i]));
+          }
+        }
+        if (current_file_index_ < dataset()->filenames_.size()) {
+          TF_RETURN_IF_ERROR(OpenFileLocked(ctx->env()));
+        }
+        return Status::OK();
+      }
+
+     private:
+      Status OpenFileLocked(Env* env) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const string& filename = dataset()->filenames_[current_file_index_];
+        TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size_));
+        return env->NewRandomAccessFile(filename, &file_);
+      }
+
+      // Reads the next chunk of complete lines, moving to the next file when
+      // the current one is exhausted, and appends its rows to `columns_`.
+      Status ReadChunkLocked(IteratorContext* ctx, bool* end_of_input)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        string data;
+        while (true) {
+          if (current_file_index_ >= dataset()->filenames_.size()) {
+            *end_of_input = true;
+            return Status::OK();
+          }
+          if (file_ == nullptr) {
+            TF_RETURN_IF_ERROR(OpenFileLocked(ctx->env()));
+          }
+          bool eof = false;
+          TF_RETURN_IF_ERROR(ReadLinesLocked(&data, &eof));
+          if (!header_skipped_ && dataset()->header_) {
+            const size_t eol = csv::FindNewline(data.data(),
+                                                data.data() + data.size());
+            data.erase(0, std::min(eol + 1, data.size()));
+          }
+          header_skipped_ = true;
+          if (eof) {
+            file_.reset();
+            ++current_file_index_;
+            file_offset_ = 0;
+            carry_.clear();
+            header_skipped_ = false;
+          }
+          if (!data.empty()) break;
+        }
+        return ParseChunkLocked(ctx, data);
+      }
+
+      // Reads about `num_parallel_reads * block_size` bytes of the current
+      // file into `data`, ending on a line boundary. Any partial last line is
+      // kept in `carry_` for the next chunk.
+      Status ReadLinesLocked(string* data, bool* eof)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        data->swap(carry_);
+        carry_.clear();
+        const size_t chunk_size =
+            dataset()->num_parallel_reads_ * dataset()->block_size_;
+        size_t search_from = 0;
+        while (true) {
+          const uint64 to_read = std::min<uint64>(
+              chunk_size, file_size_ - static_cast<uint64>(file_offset_));
+          const size_t old_size = data->size();
+          data->resize(old_size + to_read);
+          StringPiece result;
+          Status s = file_->Read(file_offset_, to_read, &result,
+                                 &(*data)[old_size]);
+          if (!s.ok() && !errors::IsOutOfRange(s)) return s;
+          if (result.data() != data->data() + old_size) {
+            memmove(&(*data)[old_size], result.data(), result.size());
+          }
+          data->resize(old_size + result.size());
+          file_offset_ += result.size();
+          *eof = static_cast<uint64>(file_offset_) >= file_size_ ||
+                 result.empty();
+          if (*eof) return Status::OK();
+          // Cut after the last line break, a line longer than the chunk
+          // keeps extending the read.
+          size_t last_newline = data->rfind('\n');
+          if (last_newline != string::npos && last_newline >= search_from) {
+            carry_.assign(*data, last_newline + 1, string::npos);
+            data->resize(last_newline + 1);
+            return Status::OK();
+          }
+          search_from = data->size();
+        }
+      }
+
+      // Splits `data` into blocks on line boundaries and parses them in
+      // parallel into newly allocated column tensors, after the rows that
+      // have not been produced yet.
+      Status ParseChunkLocked(IteratorContext* ctx, const string& data)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const char* const begin = data.data();
+        const char* const end = begin + data.size();
+        const int64 num_blocks = std::max<int64>(
+            1, std::min<int64>(dataset()->num_parallel_reads_,
+                               data.size() / dataset()->block_size_ + 1));
+        std::vector<const char*> cuts;
+        cuts.push_back(begin);
+        for (int64 i = 1; i < num_blocks; ++i) {
+          const char* nominal = begin + data.size() * i / num_blocks;
+          nominal = std::max(nominal, cuts.back());
+          const char* cut = nominal + csv::FindNewline(nominal, end);
+          cuts.push_back(cut < end ? cut + 1 : end);
+        }
+        cuts.push_back(end);
+
+        std::vector<int64> block_rows(num_blocks, 0);
+        RunParallelLocked(num_blocks, [&](int64 i) {
+          block_rows[i] = csv::CountLines(cuts[i], cuts[i + 1]);
+        });
+        std::vector<int64> block_offsets(num_blocks, 0);
+        const int64 carried_rows = num_rows_ - row_pos_;
+        int64 total_rows = carried_rows;
+        for (int64 i = 0; i < num_blocks; ++i) {
+          block_offsets[i] = total_rows;
+          total_rows += block_rows[i];
+        }
+
+        std::vector<Tensor> columns;
+        columns.reserve(dataset()->out_type_.size());
+        for (size_t c = 0; c < dataset()->out_type_.size(); ++c) {
+          columns.emplace_back(ctx->allocator({}), dataset()->out_type_[c],
+                               TensorShape({total_rows}));
+          if (carried_rows > 0) {
+            TF_RETURN_IF_ERROR(CopyRows(columns_[c], row_pos_, carried_rows,
+                                        &columns.back()));
+          }
+        }
+
+        std::vector<Status> block_status(num_blocks);
+        RunParallelLocked(num_blocks, [&](int64 i) {
+          block_status[i] =
+              ParseBlock(cuts[i], cuts[i + 1], block_offsets[i], &columns);
+        });
+        for (const Status& s : block_status) {
+          TF_RETURN_IF_ERROR(s);
+        }
+        columns_ = std::move(columns);
+        num_rows_ = total_rows;
+        row_pos_ = 0;
+        return Status::OK();
+      }
+
+      void RunParallelLocked(int64 n, const std::function<void(int64)>& fn)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (n == 1) {
+          fn(0);
+          return;
+        }
+        if (thread_pool_ == nullptr) {
+          thread_pool_ = absl::make_unique<thread::ThreadPool>(
+              Env::Default(), ThreadOptions(), "parallel_csv",
+              dataset()->num_parallel_reads_, /*low_latency_hint=*/false);
+        }
+        BlockingCounter counter(n - 1);
+        for (int64 i = 1; i < n; ++i) {
+          thread_pool_->Schedule([&fn, &counter, i]() {
+            fn(i);
+            counter.DecrementCount();
+          });
+        }
+        fn(0);
+        counter.Wait();
+      }
+
+      static Status CopyRows(const Tensor& from, int64 start, int64 n,
+                             Tensor* to) {
+        switch (from.dtype()) {
+#define HANDLE_TYPE(T)                                                 \
+  case DataTypeToEnum<T>::value: {                                     \
+    auto src = from.flat<T>();                                         \
+    auto dst = to->flat<T>();                                          \
+    for (int64 r = 0; r < n; ++r) dst(r) = src(start + r);             \
+    return Status::OK();                                               \
+  }
+          HANDLE_TYPE(int32);
+          HANDLE_TYPE(int64);
+          HANDLE_TYPE(float);
+          HANDLE_TYPE(double);
+          HANDLE_TYPE(tstring);
+#undef HANDLE_TYPE
+          default:
+            return errors::InvalidArgument("Unsupported data type ",
+                                           DataTypeString(from.dtype()));
+        }
+      }
+
+      // Parses all lines in [begin, end) into rows `first_row` onwards.
+      Status ParseBlock(const char* begin, const char* end, int64 first_row,
+                        std::vector<Tensor>* columns) const {
+        int64 row = first_row;
+        const char* line = begin;
+        string unescaped;
+        while (line < end) {
+          const char* eol = line + csv::FindNewline(line, end);
+          const char* line_end = eol;
+          if (line_end > line && line_end[-1] == '\r') --line_end;
+          if (line_end > line) {
+            TF_RETURN_IF_ERROR(
+                ParseLine(line, line_end, row, columns, &unescaped));
+            ++row;
+          }
+          line = eol + 1;
+        }
+        return Status::OK();
+      }
+
+      Status ParseLine(const char* p, const char* line_end, int64 row,
+                       std::vector<Tensor>* columns, string* unescaped) const {
+        const bool select_all = dataset()->select_cols_.empty();
+        const std::vector<int64>& selected = dataset()->select_cols_;
+        const char delim = dataset()->delim_;
+        const char quote = dataset()->use_quote_delim_ ? '"' : delim;
+        size_t num_outputs = 0;
+        int64 field_index = 0;
+        while (true) {
+          const bool include =
+              select_all || (num_outputs < selected.size() &&
+                             selected[num_outputs] == field_index);
+          StringPiece field;
+          if (dataset()->use_quote_delim_ && p < line_end && *p == '"') {
+            // Quoted field, "" is an escaped quote.
+            const char* q = p + 1;
+            bool escaped = false;
+            while (true) {
+              q += csv::FindQuote(q, line_end);
+              if (q >= line_end) {
+                return errors::InvalidArgument(
+                    "Reached end of line without closing quoted field in "
+                    "record");
+              }
+              if (q + 1 < line_end && q[1] == '"') {
+                escaped = true;
+                q += 2;
+                continue;
+              }
+              break;
+            }
+            field = StringPiece(p + 1, q - p - 1);
+            p = q + 1;
+            if (p < line_end && *p != delim) {
+              return errors::InvalidArgument(
+                  "Quote inside a string has to be escaped by another quote");
+            }
+            if (escaped && include) {
+              unescaped->clear();
+              for (size_t i = 0; i < field.size(); ++i) {
+                unescaped->push_back(field[i]);
+                if (field[i] == '"') ++i;
+              }
+              field = StringPiece(*unescaped);
+            }
+          } else {
+            const size_t n = csv::FindAnyOf4(p, line_end, delim, delim, quote,
+                                             quote);
+            if (p + n < line_end && p[n] == '"' && quote == '"') {
+              return errors::InvalidArgument(
+                  "Unquoted fields cannot have quotes inside");
+            }
+            field = StringPiece(p, n);
+            p += n;
+          }
+          if (include) {
+            if (num_outputs >= columns->size()) {
+              return errors::InvalidArgument(
+                  "Expect ", columns->size(), " fields but have more in record");
+            }
+            TF_RETURN_IF_ERROR(
+                FieldToOutput(field, num_outputs, row, &(*columns)[num_outputs]));
+            ++num_outputs;
+          }
+          ++field_index;
+          if (p >= line_end) break;
+          ++p;  // Skip the delimiter.
+        }
+        if (num_outputs != columns->size()) {
+          return errors::InvalidArgument("Expect ", columns->size(),
+                                         " fields but have ", num_outputs,
+                                         " in record");
+        }
+        return Status::OK();
+      }
+
+      // Converts a field into row `row` of `column`.
+      Status FieldToOutput(StringPiece field, size_t output_idx, int64 row,
+                           Tensor* column) const {
+        const Tensor& record_default =
+            dataset()->record_defaults_[output_idx];
+        const bool missing = field.empty() || field == dataset()->na_value_;
+        if (missing && record_default.NumElements() != 1) {
+          return errors::InvalidArgument("Field ", output_idx,
+                                         " is required but missing in record!");
+        }
+        switch (column->dtype()) {
+          case DT_INT32: {
+            int32 value;
+            if (missing) {
+              value = record_default.flat<int32>()(0);
+            } else if (!strings::safe_strto32(field, &value)) {
+              return errors::InvalidArgument("Field ", output_idx,
+                                             " in record is not a valid int32: ",
+                                             field);
+            }
+            column->flat<int32>()(row) = value;
+            break;
+          }
+          case DT_INT64: {
+            int64 value;
+            if (missing) {
+              value = record_default.flat<int64>()(0);
+            } else if (!strings::safe_strto64(field, &value)) {
+              return errors::InvalidArgument("Field ", output_idx,
+                                             " in record is not a valid int64: ",
+                                             field);
+            }
+            column->flat<int64>()(row) = value;
+            break;
+          }
+          case DT_FLOAT: {
+            float value;
+            if (missing) {
+              value = record_default.flat<float>()(0);
+            } else if (!strings::safe_strtof(field, &value)) {
+              return errors::InvalidArgument("Field ", output_idx,
+                                             " in record is not a valid float: ",
+                                             field);
+            }
+            column->flat<float>()(row) = value;
+            break;
+          }
+          case DT_DOUBLE: {
+            double value;
+            if (missing) {
+              value = record_default.flat<double>()(0);
+            } else if (!strings::safe_strtod(field, &value)) {
+              return errors::InvalidArgument(
+                  "Field ", output_idx, " in record is not a valid double: ",
+                  field);
+            }
+            column->flat<double>()(row) = value;
+            break;
+          }
+          case DT_STRING: {
+            if (missing) {
+              column->flat<tstring>()(row) = record_default.flat<tstring>()(0);
+            } else {
+              column->flat<tstring>()(row).assign(field.data(), field.size());
+            }
+            break;
+          }
+          default:
+            return errors::InvalidArgument("csv: data type ", column->dtype(),
+                                           " not supported in field ",
+                                           output_idx);
+        }
+        return Status::OK();
+      }
+
+      mutex mu_;
+      std::unique_ptr<thread::ThreadPool> thread_pool_ GUARDED_BY(mu_);
+      size_t current_file_index_ GUARDED_BY(mu_) = 0;
+      std::unique_ptr<RandomAccessFile> file_ GUARDED_BY(mu_);
+      uint64 file_size_ GUARDED_BY(mu_) = 0;
+      int64 file_offset_ GUARDED_BY(mu_) = 0;
+      // The partial line at the end of the last chunk.
+      string carry_ GUARDED_BY(mu_);
+      bool header_skipped_ GUARDED_BY(mu_) = false;
+      // Parsed rows, the rows before `row_pos_` have been produced.
+      std::vector<Tensor> columns_ GUARDED_BY(mu_);
+      int64 num_rows_ GUARDED_BY(mu_) = 0;
+      int64 row_pos_ GUARDED_BY(mu_) = 0;
+    };  // class Iterator
+
+    const std::vector<string> filenames_;
+    const int64 batch_size_;
+    const int64 num_parallel_reads_;
+    const int64 block_size_;
+    const bool header_;
+    const char delim_;
+    const bool use_quote_delim_;
+    const string na_value_;
+    const std::vector<int64> select_cols_;
+    const std::vector<Tensor> record_defaults_;
+    const DataTypeVector out_type_;
+    const std::vector<PartialTensorShape> output_shapes_;
+  };  // class Dataset
+
+  DataTypeVector output_types_;
+  std::vector<PartialTensorShape> output_shapes_;
+};  // class ParallelCSVDatasetOp
+
+REGISTER_KERNEL_BUILDER(Name("ParallelCSVDataset").Device(DEVICE_CPU),
+                        ParallelCSVDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -27,7 +27,9 @@ namespace data {
 
 class KafkaDatasetOp : public DatasetOpKernel {
  public:
-  using DatasetOpKernel::DatasetOpKernel;
+  explicit KafkaDatasetOp(OpKernelConstruction* ctx) : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("message_timestamp", &message_timestamp_));
+  }
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
     const Tensor* topics_tensor;
@@ -78,7 +80,7 @@ class KafkaDatasetOp : public DatasetOpKernel {
 
     *output = new Dataset(ctx, std::move(topics), servers, group, eof, timeout,
                           std::move(config_global), std::move(config_topic),
-                          message_key);
+                          message_key, message_timestamp_);
   }
 
  private:
@@ -87,7 +89,8 @@ class KafkaDatasetOp : public DatasetOpKernel {
     Dataset(OpKernelContext* ctx, std::vector<string> topics,
             const string& servers, const string& group, const bool eof,
             const int64 timeout, std::vector<string> config_global,
-            std::vector<string> config_topic, const bool message_key)
+            std::vector<string> config_topic, const bool message_key,
+            const bool message_timestamp)
         : DatasetBase(DatasetContext(ctx)),
           topics_(std::move(topics)),
           servers_(servers),
@@ -96,7 +99,15 @@ class KafkaDatasetOp : public DatasetOpKernel {
           timeout_(timeout),
           config_global_(std::move(config_global)),
           config_topic_(std::move(config_topic)),
-          message_key_(message_key) {}
+          message_key_(message_key),
+          message_timestamp_(message_timestamp) {
+      output_dtypes_.push_back(DT_STRING);
+      if (message_key_) output_dtypes_.push_back(DT_STRING);
+      // The message timestamp, in milliseconds since the epoch, is emitted as
+      // the last component so that it can drive event-time windowing.
+      if (message_timestamp_) output_dtypes_.push_back(DT_INT64);
+      output_shapes_.resize(output_dtypes_.size(), PartialTensorShape({}));
+    }
 
     std::unique_ptr<IteratorBase> MakeIteratorInternal(
         const string& prefix) const override {
@@ -105,24 +116,11 @@ class KafkaDatasetOp : public DatasetOpKernel {
     }
 
     const DataTypeVector& output_dtypes() const override {
-      if (message_key_) {
-        static DataTypeVector* dtypes =
-            new DataTypeVector({DT_STRING, DT_STRING});
-        return *dtypes;
-      }
-      static DataTypeVector* dtypes = new DataTypeVector({DT_STRING});
-      return *dtypes;
+      return output_dtypes_;
     }
 
     const std::vector<PartialTensorShape>& output_shapes() const override {
-      if (message_key_) {
-        static std::vector<PartialTensorShape>* shapes =
-            new std::vector<PartialTensorShape>({{}, {}});
-        return *shapes;
-      }
-      static std::vector<PartialTensorShape>* shapes =
-          new std::vector<PartialTensorShape>({{}});
-      return *shapes;
+      return output_shapes_;
     }
 
     string DebugString() const override { return "KafkaDatasetOp::Dataset"; }
@@ -147,10 +145,13 @@ class KafkaDatasetOp : public DatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddVector(config_topic_, &config_topic));
       Node* message_key = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(message_key_, &message_key));
+      AttrValue message_timestamp;
+      b->BuildAttrValue(message_timestamp_, &message_timestamp);
       TF_RETURN_IF_ERROR(
           b->AddDataset(this,
                         {topics, servers, group, eof, timeout, config_global,
                          config_topic, message_key},
+                        {std::make_pair("message_timestamp", message_timestamp)},
                         output));
       return Status::OK();
     }
@@ -285,6 +286,12 @@ class KafkaDatasetOp : public DatasetOpKernel {
                 }
                 out_tensors->emplace_back(std::move(key_tensor));
               }
+              if (dataset()->message_timestamp_) {
+                Tensor timestamp_tensor(cpu_allocator(), DT_INT64, {});
+                timestamp_tensor.scalar<int64>()() =
+                    message->timestamp().timestamp;
+                out_tensors->emplace_back(std::move(timestamp_tensor));
+              }
               *end_of_sequence = false;
               // Sync offset
               consumer_infos_[index].offset_ = message->offset();
@@ -495,7 +502,12 @@ class KafkaDatasetOp : public DatasetOpKernel {
     const std::vector<string> config_global_;
     const std::vector<string> config_topic_;
     const bool message_key_;
+    const bool message_timestamp_;
+    DataTypeVector output_dtypes_;
+    std::vector<PartialTensorShape> output_shapes_;
   };
+
+  bool message_timestamp_;
 };
 
 class WriteKafkaOp : public OpKernel {
@@ -14,17 +14,38 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/parquet_batch_reader.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
 
 #include "absl/strings/match.h"
+#include "arrow/array/concatenate.h"
+#include "arrow/table.h"
 #include "tensorflow/core/kernels/data/arrow_util.h"
+#include "tensorflow/core/kernels/data/parquet_column_cache.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 namespace data {
 
+namespace {
+
+// Row groups of all the readers in the process are decoded on one bounded
+// pool, rather than on a new thread per row group.
+thread::ThreadPool* PrefetchThreadPool() {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), ThreadOptions(), "parquet_prefetch",
+      ArrowUtil::GetParquetPrefetchThreadsFromEnv(),
+      /*low_latency_hint=*/false);
+  return pool;
+}
+
+}  // namespace
+
 class ParquetBatchReader::Impl {
  public:
   Impl(const string& filename, const int64 batch_size,
@@ -42,8 +63,15 @@ class ParquetBatchReader::Impl {
         partition_index_(partition_index),
         drop_remainder_(drop_remainder) {}
 
+  ~Impl() {
+    // Wait for the row group being prefetched, which uses `reader_`.
+    if (prefetch_) {
+      prefetch_->done.WaitForNotification();
+    }
+  }
+
   Status Open() {
-    if (TF_PREDICT_TRUE(batch_reader_)) {
+    if (TF_PREDICT_TRUE(reader_)) {
       return Status::OK();
     }
     if (TF_PREDICT_FALSE(partition_index_ >= partition_count_)) {
@@ -58,6 +86,7 @@ class ParquetBatchReader::Impl {
 
     std::shared_ptr<::arrow::io::RandomAccessFile> file;
     TF_RETURN_IF_ARROW_ERROR(ArrowUtil::OpenArrowFile(&file, filename_));
+    TF_CHECKED_ARROW_ASSIGN(file_size_, file->GetSize());
     TF_RETURN_IF_ARROW_ERROR(ArrowUtil::OpenParquetReader(&reader_, file));
 
     int num_row_groups = reader_->num_row_groups();
@@ -78,6 +107,7 @@ class ParquetBatchReader::Impl {
                                 filename_);
       }
       column_indices_.push_back(column_index);
+      fields_.push_back(schema->field(column_index));
       const auto& expected_dtype = field_dtypes_[i];
       const auto& expected_ragged_rank = field_ragged_ranks_[i];
       DataType actual_dtype;
@@ -97,36 +127,116 @@ class ParquetBatchReader::Impl {
             actual_ragged_rank, ", which should be ", expected_ragged_rank);
       }
     }
-    reader_->set_batch_size(batch_size_);
-
-    TF_RETURN_IF_ARROW_ERROR(reader_->GetRecordBatchReader(
-        row_group_indices_, column_indices_, &batch_reader_));
+    StartPrefetch();
     return Status::OK();
   }
 
   Status Read(std::vector<Tensor>* output_tensors) {
-    // Read next batch from parquet file.
-    std::shared_ptr<::arrow::RecordBatch> batch;
-    TF_RETURN_IF_ARROW_ERROR(batch_reader_->ReadNext(&batch));
-    if (TF_PREDICT_FALSE(!batch)) {
+    // Read next batch from parquet file. A batch takes the rows left in the
+    // current row group and continues into the next ones, so only the last
+    // batch of the partition may be smaller than `batch_size_`.
+    std::vector<::arrow::ArrayVector> pieces(column_indices_.size());
+    int64 num_rows = 0;
+    while (num_rows < batch_size_) {
+      if (!table_ || table_offset_ >= table_->num_rows()) {
+        if (!prefetch_) break;
+        TF_RETURN_IF_ERROR(NextRowGroup());
+        continue;
+      }
+      const int64 n = std::min(batch_size_ - num_rows,
+                               table_->num_rows() - table_offset_);
+      for (size_t i = 0; i < pieces.size(); ++i) {
+        std::shared_ptr<::arrow::ChunkedArray> slice =
+            table_->column(i)->Slice(table_offset_, n);
+        pieces[i].insert(pieces[i].end(), slice->chunks().begin(),
+                         slice->chunks().end());
+      }
+      table_offset_ += n;
+      num_rows += n;
+    }
+    if (TF_PREDICT_FALSE(num_rows == 0)) {
       return errors::OutOfRange("Reached end of parquet file ", filename_);
     }
-    if (TF_PREDICT_FALSE(drop_remainder_ && batch->num_rows() < batch_size_)) {
+    if (TF_PREDICT_FALSE(drop_remainder_ && num_rows < batch_size_)) {
       return errors::OutOfRange("Reached end of parquet file ", filename_,
                                 " after dropping reminder batch");
     }
 
-    // Populate tensors from record batch.
-    auto arrays = batch->columns();
-    for (size_t i = 0; i < arrays.size(); ++i) {
+    // Populate tensors from the pieces of each column.
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      std::shared_ptr<::arrow::Array> array;
+      if (pieces[i].size() == 1 && pieces[i][0]->offset() == 0) {
+        array = std::move(pieces[i][0]);
+      } else {
+        // Slices past the start of a chunk have an offset, which tensors
+        // cannot be made from, so the pieces are copied into one array.
+        TF_CHECKED_ARROW_ASSIGN(array, ::arrow::Concatenate(pieces[i]));
+      }
       TF_RETURN_IF_ERROR(ArrowUtil::MakeTensorsFromArrowArray(
-          field_dtypes_[i], field_ragged_ranks_[i], arrays[i], output_tensors));
+          field_dtypes_[i], field_ragged_ranks_[i], array, output_tensors));
     }
 
     return Status::OK();
   }
 
  private:
+  // A row group decoded in the background.
+  struct Prefetch {
+    Notification done;
+    Status status;
+    std::shared_ptr<::arrow::Table> table;
+  };
+
+  // Makes the prefetched row group the current one, and starts decoding the
+  // next row group while it is consumed.
+  Status NextRowGroup() {
+    prefetch_->done.WaitForNotification();
+    std::unique_ptr<Prefetch> prefetch = std::move(prefetch_);
+    TF_RETURN_IF_ERROR(prefetch->status);
+    table_ = std::move(prefetch->table);
+    table_offset_ = 0;
+    StartPrefetch();
+    return Status::OK();
+  }
+
+  // Starts decoding the next row group of the partition, if any.
+  void StartPrefetch() {
+    if (next_row_group_ >= row_group_indices_.size()) {
+      return;
+    }
+    const int row_group = row_group_indices_[next_row_group_++];
+    prefetch_.reset(new Prefetch);
+    Prefetch* prefetch = prefetch_.get();
+    PrefetchThreadPool()->Schedule([this, prefetch, row_group]() {
+      prefetch->status = DecodeRowGroup(row_group, &prefetch->table);
+      prefetch->done.Notify();
+    });
+  }
+
+  // Decodes the selected columns of a row group, through the column cache
+  // shared with the other readers of the same file.
+  Status DecodeRowGroup(int row_group, std::shared_ptr<::arrow::Table>* table) {
+    ParquetColumnCache* cache = ParquetColumnCache::Global();
+    std::vector<std::shared_ptr<::arrow::ChunkedArray>> columns;
+    columns.reserve(column_indices_.size());
+    for (int column_index : column_indices_) {
+      std::shared_ptr<::arrow::ChunkedArray> column;
+      TF_RETURN_IF_ERROR(cache->Lookup(
+          ParquetColumnCache::MakeKey(filename_, file_size_, row_group,
+                                      column_index),
+          [this, row_group,
+           column_index](std::shared_ptr<::arrow::ChunkedArray>* out) {
+            TF_RETURN_IF_ARROW_ERROR(
+                reader_->RowGroup(row_group)->Column(column_index)->Read(out));
+            return Status::OK();
+          },
+          &column));
+      columns.push_back(std::move(column));
+    }
+    *table = ::arrow::Table::Make(::arrow::schema(fields_), std::move(columns));
+    return Status::OK();
+  }
+
   const string filename_;
   const int64 batch_size_;
   std::vector<string> field_names_;
@@ -135,10 +245,17 @@ class ParquetBatchReader::Impl {
   int64 partition_count_;
   int64 partition_index_;
   bool drop_remainder_;
+  int64 file_size_ = 0;
   std::unique_ptr<::parquet::arrow::FileReader> reader_;
-  std::unique_ptr<::arrow::RecordBatchReader> batch_reader_;
   std::vector<int> row_group_indices_;
   std::vector<int> column_indices_;
+  std::vector<std::shared_ptr<::arrow::Field>> fields_;
+  // Position in `row_group_indices_` of the next row group to decode.
+  size_t next_row_group_ = 0;
+  std::unique_ptr<Prefetch> prefetch_;
+  // The row group being read, and the first of its rows not read yet.
+  std::shared_ptr<::arrow::Table> table_;
+  int64 table_offset_ = 0;
 };
 
 ParquetBatchReader::ParquetBatchReader(
@@ -0,0 +1,112 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/parquet_column_cache.h"
+
+#include "arrow/array.h"
+#include "tensorflow/core/kernels/data/arrow_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace data {
+
+namespace {
+
+int64 ArrayDataBytes(const ::arrow::ArrayData& data) {
+  int64 bytes = 0;
+  for (const auto& buffer : data.buffers) {
+    if (buffer) bytes += buffer->size();
+  }
+  for (const auto& child : data.child_data) {
+    if (child) bytes += ArrayDataBytes(*child);
+  }
+  if (data.dictionary) bytes += ArrayDataBytes(*data.dictionary);
+  return bytes;
+}
+
+int64 ColumnBytes(const ::arrow::ChunkedArray& column) {
+  int64 bytes = 0;
+  for (const auto& chunk : column.chunks()) {
+    bytes += ArrayDataBytes(*chunk->data());
+  }
+  return bytes;
+}
+
+}  // namespace
+
+ParquetColumnCache* ParquetColumnCache::Global() {
+  static ParquetColumnCache* cache =
+      new ParquetColumnCache(ArrowUtil::GetParquetColumnCacheBytesFromEnv());
+  return cache;
+}
+
+ParquetColumnCache::ParquetColumnCache(int64 capacity_bytes)
+    : capacity_bytes_(capacity_bytes) {}
+
+string ParquetColumnCache::MakeKey(const string& filename, int64 file_size,
+                                   int row_group, int column) {
+  return strings::StrCat(filename, "@", file_size, ":", row_group, ":",
+                         column);
+}
+
+Status ParquetColumnCache::Lookup(
+    const string& key, const DecodeFn& decode,
+    std::shared_ptr<::arrow::ChunkedArray>* column) {
+  if (capacity_bytes_ <= 0) {
+    return decode(column);
+  }
+  {
+    mutex_lock l(mu_);
+    while (true) {
+      auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+        *column = it->second.column;
+        return Status::OK();
+      }
+      if (pending_.insert(key).second) break;
+      // Another reader is decoding this column, wait for it.
+      pending_cv_.wait(l);
+    }
+  }
+
+  Status s = decode(column);
+  mutex_lock l(mu_);
+  pending_.erase(key);
+  pending_cv_.notify_all();
+  if (!s.ok()) return s;
+  const int64 bytes = ColumnBytes(**column);
+  if (bytes > capacity_bytes_) {
+    VLOG(2) << "Not caching " << key << " of " << bytes << " bytes";
+    return Status::OK();
+  }
+  lru_.push_front(key);
+  entries_[key] = Entry{*column, bytes, lru_.begin()};
+  size_bytes_ += bytes;
+  EvictLocked();
+  return Status::OK();
+}
+
+void ParquetColumnCache::EvictLocked() {
+  while (size_bytes_ > capacity_bytes_ && !lru_.empty()) {
+    auto it = entries_.find(lru_.back());
+    size_bytes_ -= it->second.bytes;
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace data
+}  // namespace tensorflow
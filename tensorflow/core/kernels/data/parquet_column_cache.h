@@ -0,0 +1,92 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_PARQUET_COLUMN_CACHE_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_PARQUET_COLUMN_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "arrow/chunked_array.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// A process-wide cache of decoded Parquet columns, keyed by file, row group
+// and column, and bounded by the total size of the cached buffers. Readers of
+// the same files, e.g. training and evaluation datasets or several feature
+// views, share the decoded columns instead of reading and decoding them again.
+class ParquetColumnCache {
+ public:
+  using DecodeFn =
+      std::function<Status(std::shared_ptr<::arrow::ChunkedArray>*)>;
+
+  // Returns the cache shared by all ParquetDatasets. Its capacity is set by
+  // the PARQUET_DATASET_CACHE_MB environment variable, and caching is disabled
+  // when it is 0 (the default).
+  static ParquetColumnCache* Global();
+
+  explicit ParquetColumnCache(int64 capacity_bytes);
+
+  // Returns the column cached under `key`, or decodes it with `decode` and
+  // caches the result. Concurrent lookups of a key that is being decoded wait
+  // for the first decode instead of repeating it.
+  Status Lookup(const string& key, const DecodeFn& decode,
+                std::shared_ptr<::arrow::ChunkedArray>* column);
+
+  // Returns the cache key of a column chunk. `file_size` tells apart files
+  // that were rewritten under the same name.
+  static string MakeKey(const string& filename, int64 file_size,
+                        int row_group, int column);
+
+  int64 capacity_bytes() const { return capacity_bytes_; }
+
+  int64 size_bytes() {
+    mutex_lock l(mu_);
+    return size_bytes_;
+  }
+
+ private:
+  struct Entry {
+    std::shared_ptr<::arrow::ChunkedArray> column;
+    int64 bytes;
+    std::list<string>::iterator lru_position;
+  };
+
+  // Evicts the least recently used entries until `size_bytes_` fits.
+  void EvictLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64 capacity_bytes_;
+  mutex mu_;
+  condition_variable pending_cv_;
+  std::unordered_map<string, Entry> entries_ GUARDED_BY(mu_);
+  // Keys from most to least recently used.
+  std::list<string> lru_ GUARDED_BY(mu_);
+  // Keys that are being decoded.
+  std::unordered_set<string> pending_ GUARDED_BY(mu_);
+  int64 size_bytes_ GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_PARQUET_COLUMN_CACHE_H_
@@ -0,0 +1,593 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+#include "tensorflow/core/common_runtime/metrics.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/stats_aggregator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/data/name_utils.h"
+#include "tensorflow/core/kernels/data/stats_utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env_time.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// See documentation in ../../ops/dataset_ops.cc for a high-level
+// description of the following op.
+//
+// The stage is pull based: the input is only consumed while the buffered bytes
+// stay under `max_buffered_bytes`, so a slow trainer stops the upstream
+// consumer instead of growing buffers. Elements are grouped into tumbling
+// event-time windows of `window_size_ms`, and a window is released once the
+// watermark, i.e. the largest sample time seen minus
+// `max_out_of_orderness_ms`, passes its end. Elements of a released window are
+// produced ordered by sample time.
+//
+// An element is stale when it is older than `max_staleness_ms` with respect to
+// the wall clock, or when its window has already been released. Stale elements
+// are handled by `stale_policy`:
+//   "drop":    stale elements are discarded.
+//   "compact": only the newest stale element per key (component `key_index`)
+//              is kept and produced ahead of the next released window.
+//   "keep":    stale elements are produced ahead of the next released window.
+
+constexpr char kDatasetType[] = "StreamingWindow";
+constexpr char kTimestampIndex[] = "timestamp_index";
+constexpr char kKeyIndex[] = "key_index";
+constexpr char kStalePolicy[] = "stale_policy";
+constexpr char kOutputTypes[] = "output_types";
+constexpr char kOutputShapes[] = "output_shapes";
+
+constexpr char kDropPolicy[] = "drop";
+constexpr char kCompactPolicy[] = "compact";
+constexpr char kKeepPolicy[] = "keep";
+
+constexpr char kInputExhausted[] = "input_exhausted";
+constexpr char kMaxEventTime[] = "max_event_time";
+constexpr char kClosedUntil[] = "closed_until";
+constexpr char kNumElements[] = "num_elements";
+constexpr char kElement[] = "element";
+constexpr char kGroupSuffix[] = ".group";
+constexpr char kSizeSuffix[] = ".size";
+
+enum class StalePolicy { kDrop, kCompact, kKeep };
+
+class StreamingWindowDatasetOp : public UnaryDatasetOpKernel {
+ public:
+  explicit StreamingWindowDatasetOp(OpKernelConstruction* ctx)
+      : UnaryDatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kTimestampIndex, &timestamp_index_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kKeyIndex, &key_index_));
+    string stale_policy;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kStalePolicy, &stale_policy));
+    if (stale_policy == kDropPolicy) {
+      stale_policy_ = StalePolicy::kDrop;
+    } else if (stale_policy == kCompactPolicy) {
+      stale_policy_ = StalePolicy::kCompact;
+    } else if (stale_policy == kKeepPolicy) {
+      stale_policy_ = StalePolicy::kKeep;
+    } else {
+      OP_REQUIRES(ctx, false,
+                  errors::InvalidArgument("stale_policy must be one of "
+                                          "'drop', 'compact' or 'keep', got ",
+                                          stale_policy));
+    }
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputTypes, &output_types_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputShapes, &output_shapes_));
+  }
+
+ protected:
+  void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
+                   DatasetBase** output) override {
+    const int num_components = input->output_dtypes().size();
+    OP_REQUIRES(
+        ctx, timestamp_index_ >= 0 && timestamp_index_ < num_components,
+        errors::InvalidArgument("timestamp_index ", timestamp_index_,
+                                " is out of range for ", num_components,
+                                " components."));
+    OP_REQUIRES(
+        ctx, input->output_dtypes()[timestamp_index_] == DT_INT64,
+        errors::InvalidArgument("The timestamp component must be int64."));
+    OP_REQUIRES(ctx, key_index_ < num_components,
+                errors::InvalidArgument("key_index ", key_index_,
+                                        " is out of range for ",
+                                        num_components, " components."));
+    OP_REQUIRES(ctx,
+                stale_policy_ != StalePolicy::kCompact || key_index_ >= 0,
+                errors::InvalidArgument(
+                    "The 'compact' stale_policy requires a key_index."));
+
+    int64 max_buffered_bytes;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "max_buffered_bytes",
+                                                   &max_buffered_bytes));
+    OP_REQUIRES(
+        ctx, max_buffered_bytes > 0,
+        errors::InvalidArgument("max_buffered_bytes must be greater than 0."));
+    int64 window_size_ms;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "window_size_ms",
+                                                   &window_size_ms));
+    OP_REQUIRES(
+        ctx, window_size_ms > 0,
+        errors::InvalidArgument("window_size_ms must be greater than 0."));
+    int64 max_out_of_orderness_ms;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx,
+                                                   "max_out_of_orderness_ms",
+                                                   &max_out_of_orderness_ms));
+    OP_REQUIRES(ctx, max_out_of_orderness_ms >= 0,
+                errors::InvalidArgument(
+                    "max_out_of_orderness_ms must not be negative."));
+    int64 max_staleness_ms;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "max_staleness_ms",
+                                                   &max_staleness_ms));
+
+    *output = new Dataset(ctx, input, max_buffered_bytes, window_size_ms,
+                          max_out_of_orderness_ms, max_staleness_ms,
+                          timestamp_index_, key_index_, stale_policy_,
+                          output_types_, output_shapes_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, const DatasetBase* input,
+            int64 max_buffered_bytes, int64 window_size_ms,
+            int64 max_out_of_orderness_ms, int64 max_staleness_ms,
+            int64 timestamp_index, int64 key_index, StalePolicy stale_policy,
+            const DataTypeVector& output_types,
+            const std::vector<PartialTensorShape>& output_shapes)
+        : DatasetBase(DatasetContext(ctx)),
+          input_(input),
+          max_buffered_bytes_(max_buffered_bytes),
+          window_size_ms_(window_size_ms),
+          max_out_of_orderness_ms_(max_out_of_orderness_ms),
+          max_staleness_ms_(max_staleness_ms),
+          timestamp_index_(timestamp_index),
+          key_index_(key_index),
+          stale_policy_(stale_policy),
+          output_types_(output_types),
+          output_shapes_(output_shapes) {
+      input_->Ref();
+    }
+
+    ~Dataset() override { input_->Unref(); }
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(Iterator::Params{
+          this, name_utils::IteratorPrefix(kDatasetType, prefix)});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return output_types_;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return name_utils::DatasetDebugString(kDatasetType);
+    }
+
+    Status CheckExternalState() const override {
+      return input_->CheckExternalState();
+    }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* input_graph_node = nullptr;
+      TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+      Node* max_buffered_bytes = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(max_buffered_bytes_, &max_buffered_bytes));
+      Node* window_size_ms = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(window_size_ms_, &window_size_ms));
+      Node* max_out_of_orderness_ms = nullptr;
+      TF_RETURN_IF_ERROR(
+          b->AddScalar(max_out_of_orderness_ms_, &max_out_of_orderness_ms));
+      Node* max_staleness_ms = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(max_staleness_ms_, &max_staleness_ms));
+      AttrValue timestamp_index;
+      b->BuildAttrValue(timestamp_index_, &timestamp_index);
+      AttrValue key_index;
+      b->BuildAttrValue(key_index_, &key_index);
+      AttrValue stale_policy;
+      b->BuildAttrValue(
+          string(stale_policy_ == StalePolicy::kDrop
+                     ? kDropPolicy
+                     : (stale_policy_ == StalePolicy::kCompact ? kCompactPolicy
+                                                               : kKeepPolicy)),
+          &stale_policy);
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this,
+          {input_graph_node, max_buffered_bytes, window_size_ms,
+           max_out_of_orderness_ms, max_staleness_ms},
+          {std::make_pair(kTimestampIndex, timestamp_index),
+           std::make_pair(kKeyIndex, key_index),
+           std::make_pair(kStalePolicy, stale_policy)},
+          output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        while (ready_.empty()) {
+          if (input_exhausted_) {
+            // Flush the remaining windows in event-time order.
+            if (!ReleaseOldestWindowLocked()) {
+              *end_of_sequence = true;
+              RecordBufferedBytesLocked(ctx);
+              return Status::OK();
+            }
+            continue;
+          }
+          if (!windows_.empty() &&
+              windows_.begin()->first + dataset()->window_size_ms_ <=
+                  WatermarkLocked()) {
+            ReleaseOldestWindowLocked();
+            continue;
+          }
+          if (buffered_bytes_ >= dataset()->max_buffered_bytes_) {
+            // Backpressure: stop pulling from the input and release the
+            // oldest window before the watermark catches up with it.
+            if (ReleaseOldestWindowLocked()) continue;
+          }
+          TF_RETURN_IF_ERROR(PullLocked(ctx));
+        }
+
+        Element element = std::move(ready_.front());
+        ready_.pop_front();
+        buffered_bytes_ -= element.bytes;
+        const int64 lag_ms = EnvTime::Default()->NowMicros() / 1000 -
+                             element.timestamp;
+        *out_tensors = std::move(element.value);
+        *end_of_sequence = false;
+
+        metrics::RecordTFDataStreamingLag(dataset()->node_name(), lag_ms);
+        RecordBufferedBytesLocked(ctx);
+        const auto& stats_aggregator = ctx->stats_aggregator();
+        if (stats_aggregator) {
+          stats_aggregator->AddScalar(
+              strings::StrCat(dataset()->node_name(), "::lag_ms"),
+              static_cast<float>(lag_ms), num_elements());
+        }
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args), /*ratio=*/1);
+      }
+
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(SaveInput(writer, input_impl_));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(kInputExhausted), static_cast<int64>(input_exhausted_)));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kMaxEventTime), max_event_time_));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kClosedUntil), closed_until_));
+        int64 index = 0;
+        for (const Element& element : ready_) {
+          TF_RETURN_IF_ERROR(
+              WriteElement(writer, index++, kReadyGroup, element));
+        }
+        for (const auto& it : compacted_) {
+          TF_RETURN_IF_ERROR(
+              WriteElement(writer, index++, kCompactedGroup, it.second));
+        }
+        for (const auto& window : windows_) {
+          for (const Element& element : window.second) {
+            TF_RETURN_IF_ERROR(
+                WriteElement(writer, index++, kWindowGroup, element));
+          }
+        }
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kNumElements), index));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        ready_.clear();
+        compacted_.clear();
+        windows_.clear();
+        buffered_bytes_ = 0;
+        TF_RETURN_IF_ERROR(RestoreInput(ctx, reader, input_impl_));
+        int64 input_exhausted;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kInputExhausted), &input_exhausted));
+        input_exhausted_ = static_cast<bool>(input_exhausted);
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kMaxEventTime), &max_event_time_));
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kClosedUntil), &closed_until_));
+        int64 num_elements;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kNumElements), &num_elements));
+        for (int64 i = 0; i < num_elements; ++i) {
+          int64 group;
+          Element element;
+          TF_RETURN_IF_ERROR(ReadElement(reader, i, &group, &element));
+          buffered_bytes_ += element.bytes;
+          if (group == kReadyGroup) {
+            ready_.push_back(std::move(element));
+          } else if (group == kCompactedGroup) {
+            string key = KeyOf(element);
+            compacted_[key] = std::move(element);
+          } else {
+            const int64 start = WindowStart(element.timestamp);
+            windows_[start].push_back(std::move(element));
+          }
+        }
+        return Status::OK();
+      }
+
+     private:
+      static constexpr int64 kReadyGroup = 0;
+      static constexpr int64 kCompactedGroup = 1;
+      static constexpr int64 kWindowGroup = 2;
+
+      struct Element {
+        std::vector<Tensor> value;
+        int64 timestamp = 0;
+        int64 bytes = 0;
+      };
+
+      int64 WindowStart(int64 timestamp) const {
+        const int64 size = dataset()->window_size_ms_;
+        // Floor division, so that negative timestamps land in the right window.
+        int64 start = (timestamp / size) * size;
+        if (start > timestamp) start -= size;
+        return start;
+      }
+
+      int64 WatermarkLocked() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return max_event_time_ - dataset()->max_out_of_orderness_ms_;
+      }
+
+      string KeyOf(const Element& element) const {
+        return element.value[dataset()->key_index_].SummarizeValue(
+            /*max_entries=*/-1);
+      }
+
+      // Reads one element from the input and files it into its window, or
+      // applies the stale policy to it.
+      Status PullLocked(IteratorContext* ctx) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        Element element;
+        bool end_of_input = false;
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, &element.value, &end_of_input));
+        if (end_of_input) {
+          input_exhausted_ = true;
+          return Status::OK();
+        }
+        const Tensor& timestamp = element.value[dataset()->timestamp_index_];
+        if (timestamp.NumElements() != 1) {
+          return errors::InvalidArgument(
+              "The timestamp component must have exactly one element, got ",
+              timestamp.shape().DebugString());
+        }
+        element.timestamp = timestamp.flat<int64>()(0);
+        for (const Tensor& t : element.value) {
+          element.bytes += t.TotalBytes();
+        }
+
+        const int64 now_ms = EnvTime::Default()->NowMicros() / 1000;
+        const int64 start = WindowStart(element.timestamp);
+        const bool too_old = dataset()->max_staleness_ms_ > 0 &&
+                             now_ms - element.timestamp >
+                                 dataset()->max_staleness_ms_;
+        const bool late = start < closed_until_;
+        if (!too_old && !late) {
+          max_event_time_ = std::max(max_event_time_, element.timestamp);
+          buffered_bytes_ += element.bytes;
+          windows_[start].push_back(std::move(element));
+          return Status::OK();
+        }
+
+        switch (dataset()->stale_policy_) {
+          case StalePolicy::kDrop:
+            RecordDroppedLocked(ctx, 1);
+            break;
+          case StalePolicy::kCompact: {
+            buffered_bytes_ += element.bytes;
+            auto result = compacted_.emplace(KeyOf(element), Element());
+            Element& slot = result.first->second;
+            if (!result.second) {
+              if (slot.timestamp > element.timestamp) {
+                // The buffered element for this key is newer, keep it.
+                buffered_bytes_ -= element.bytes;
+                RecordDroppedLocked(ctx, 1);
+                break;
+              }
+              buffered_bytes_ -= slot.bytes;
+              RecordDroppedLocked(ctx, 1);
+            }
+            slot = std::move(element);
+            break;
+          }
+          case StalePolicy::kKeep:
+            buffered_bytes_ += element.bytes;
+            ready_.push_back(std::move(element));
+            break;
+        }
+        return Status::OK();
+      }
+
+      // Moves the compacted stale elements and the oldest window, sorted by
+      // sample time, to the output queue. Returns false if nothing is
+      // buffered.
+      bool ReleaseOldestWindowLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (!compacted_.empty()) {
+          std::vector<Element> compacted;
+          compacted.reserve(compacted_.size());
+          for (auto& it : compacted_) {
+            compacted.push_back(std::move(it.second));
+          }
+          compacted_.clear();
+          std::stable_sort(compacted.begin(), compacted.end(),
+                           [](const Element& a, const Element& b) {
+                             return a.timestamp < b.timestamp;
+                           });
+          for (Element& element : compacted) {
+            ready_.push_back(std::move(element));
+          }
+          if (windows_.empty()) return true;
+        }
+        if (windows_.empty()) return false;
+        auto oldest = windows_.begin();
+        std::vector<Element>& elements = oldest->second;
+        std::stable_sort(elements.begin(), elements.end(),
+                         [](const Element& a, const Element& b) {
+                           return a.timestamp < b.timestamp;
+                         });
+        for (Element& element : elements) {
+          ready_.push_back(std::move(element));
+        }
+        closed_until_ =
+            std::max(closed_until_, oldest->first + dataset()->window_size_ms_);
+        windows_.erase(oldest);
+        return true;
+      }
+
+      void RecordBufferedBytesLocked(IteratorContext* ctx)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        metrics::RecordTFDataStreamingBufferedBytes(dataset()->node_name(),
+                                                    buffered_bytes_);
+        const auto& stats_aggregator = ctx->stats_aggregator();
+        if (stats_aggregator) {
+          stats_aggregator->AddScalar(
+              stats_utils::BufferSizeScalarName(dataset()->node_name()),
+              static_cast<float>(buffered_bytes_), num_elements());
+          stats_aggregator->AddScalar(
+              stats_utils::BufferCapacityScalarName(dataset()->node_name()),
+              static_cast<float>(dataset()->max_buffered_bytes_),
+              num_elements());
+        }
+      }
+
+      void RecordDroppedLocked(IteratorContext* ctx, int64 num)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        num_dropped_ += num;
+        metrics::RecordTFDataStreamingDropped(dataset()->node_name(), num);
+        const auto& stats_aggregator = ctx->stats_aggregator();
+        if (stats_aggregator) {
+          stats_aggregator->AddScalar(
+              stats_utils::DroppedElementsScalarName(dataset()->node_name()),
+              static_cast<float>(num_dropped_), num_elements());
+        }
+      }
+
+      Status WriteElement(IteratorStateWriter* writer, int64 index,
+                          int64 group, const Element& element)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const string prefix = strings::StrCat(kElement, "[", index, "]");
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(strings::StrCat(prefix, kGroupSuffix)), group));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(strings::StrCat(prefix, kSizeSuffix)),
+            static_cast<int64>(element.value.size())));
+        for (size_t j = 0; j < element.value.size(); ++j) {
+          TF_RETURN_IF_ERROR(writer->WriteTensor(
+              full_name(strings::StrCat(prefix, "[", j, "]")),
+              element.value[j]));
+        }
+        return Status::OK();
+      }
+
+      Status ReadElement(IteratorStateReader* reader, int64 index,
+                         int64* group, Element* element)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const string prefix = strings::StrCat(kElement, "[", index, "]");
+        TF_RETURN_IF_ERROR(reader->ReadScalar(
+            full_name(strings::StrCat(prefix, kGroupSuffix)), group));
+        int64 size;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(
+            full_name(strings::StrCat(prefix, kSizeSuffix)), &size));
+        element->value.resize(size);
+        for (int64 j = 0; j < size; ++j) {
+          TF_RETURN_IF_ERROR(reader->ReadTensor(
+              full_name(strings::StrCat(prefix, "[", j, "]")),
+              &element->value[j]));
+          element->bytes += element->value[j].TotalBytes();
+        }
+        element->timestamp =
+            element->value[dataset()->timestamp_index_].flat<int64>()(0);
+        return Status::OK();
+      }
+
+      mutex mu_;
+      std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
+      bool input_exhausted_ GUARDED_BY(mu_) = false;
+      // Largest sample time seen among the in-order elements.
+      int64 max_event_time_ GUARDED_BY(mu_) = kint64min / 2;
+      // All windows starting before this time have been released.
+      int64 closed_until_ GUARDED_BY(mu_) = kint64min / 2;
+      int64 buffered_bytes_ GUARDED_BY(mu_) = 0;
+      int64 num_dropped_ GUARDED_BY(mu_) = 0;
+      std::map<int64, std::vector<Element>> windows_ GUARDED_BY(mu_);
+      std::unordered_map<string, Element> compacted_ GUARDED_BY(mu_);
+      std::deque<Element> ready_ GUARDED_BY(mu_);
+    };
+
+    const DatasetBase* const input_;
+    const int64 max_buffered_bytes_;
+    const int64 window_size_ms_;
+    const int64 max_out_of_orderness_ms_;
+    const int64 max_staleness_ms_;
+    const int64 timestamp_index_;
+    const int64 key_index_;
+    const StalePolicy stale_policy_;
+    const DataTypeVector output_types_;
+    const std::vector<PartialTensorShape> output_shapes_;
+  };
+
+  int64 timestamp_index_;
+  int64 key_index_;
+  StalePolicy stale_policy_;
+  DataTypeVector output_types_;
+  std::vector<PartialTensorShape> output_shapes_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("StreamingWindowDataset").Device(DEVICE_CPU),
+                        StreamingWindowDatasetOp);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
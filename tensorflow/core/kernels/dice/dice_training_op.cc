@@ -0,0 +1,492 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
+
+// The AVX512 kernels are compiled for AVX512 whatever the flags of the build,
+// and only run on the CPUs that support it.
+#if defined(__GNUC__) && (__GNUC__ > 6) && defined(__x86_64__)
+#include <immintrin.h>
+#define DICE_TRAINING_AVX512
+#endif
+
+namespace tensorflow {
+
+namespace {
+
+// Rows are reduced kRowBlock at a time into partial sums per block, which are
+// then added up in order, so that the statistics and the gradients do not
+// depend on the number of threads.
+constexpr int64 kRowBlock = 128;
+
+struct DiceShape {
+  int64 rows = 0;
+  int64 cols = 0;
+
+  int64 NumBlocks() const { return (rows + kRowBlock - 1) / kRowBlock; }
+  int64 BlockEnd(int64 block) const {
+    return std::min(rows, (block + 1) * kRowBlock);
+  }
+};
+
+// The portable kernels, over the rows [begin, end). The partial sums of a
+// block start at 0.
+//
+// Dice(x) = x * [gamma + (1 - gamma) * p]
+// p = sigmoid[(x - mean) * rvar]
+
+inline float Sigmoid(float t) { return 1.0f / (1.0f + std::exp(-t)); }
+
+// Sums x - shift and its square, the rows of the block shifted by the first
+// row of the batch, which keeps the variance accurate for large means.
+void Moments(const float* x, const float* shift, int64 cols, int64 begin,
+             int64 end, float* sum, float* square_sum) {
+  for (int64 row = begin; row < end; ++row) {
+    const float* x_row = x + row * cols;
+    for (int64 j = 0; j < cols; ++j) {
+      const float d = x_row[j] - shift[j];
+      sum[j] += d;
+      square_sum[j] += d * d;
+    }
+  }
+}
+
+void Forward(const float* x, const float* mean, const float* rvar,
+             const float* gamma, int64 cols, int64 begin, int64 end,
+             float* y) {
+  for (int64 row = begin; row < end; ++row) {
+    const float* x_row = x + row * cols;
+    float* y_row = y + row * cols;
+    for (int64 j = 0; j < cols; ++j) {
+      const float p = Sigmoid((x_row[j] - mean[j]) * rvar[j]);
+      y_row[j] = x_row[j] * (gamma[j] + (1.0f - gamma[j]) * p);
+    }
+  }
+}
+
+// With t = (x - mean) * rvar, sums dt, dt * (x - mean) and the gradient of
+// gamma, x * (1 - p) * dy.
+void GradSums(const float* y_grad, const float* x, const float* mean,
+              const float* rvar, const float* gamma, int64 cols, int64 begin,
+              int64 end, float* t_grad_sum, float* t_grad_centered_sum,
+              float* gamma_grad) {
+  for (int64 row = begin; row < end; ++row) {
+    const float* dy = y_grad + row * cols;
+    const float* x_row = x + row * cols;
+    for (int64 j = 0; j < cols; ++j) {
+      const float centered = x_row[j] - mean[j];
+      const float p = Sigmoid(centered * rvar[j]);
+      const float dx_p = dy[j] * x_row[j] * (1.0f - p);
+      const float dt = dx_p * (1.0f - gamma[j]) * p;
+      t_grad_sum[j] += dt;
+      t_grad_centered_sum[j] += dt * centered;
+      gamma_grad[j] += dx_p;
+    }
+  }
+}
+
+// x_grad = dy * [gamma + (1 - gamma) * p] + dt * rvar - offset
+//          + scale * (x - mean),
+// where offset and scale are the gradients through the mean and the variance.
+void GradInput(const float* y_grad, const float* x, const float* mean,
+               const float* rvar, const float* gamma, const float* offset,
+               const float* scale, int64 cols, int64 begin, int64 end,
+               float* x_grad) {
+  for (int64 row = begin; row < end; ++row) {
+    const float* dy = y_grad + row * cols;
+    const float* x_row = x + row * cols;
+    float* dx = x_grad + row * cols;
+    for (int64 j = 0; j < cols; ++j) {
+      const float centered = x_row[j] - mean[j];
+      const float p = Sigmoid(centered * rvar[j]);
+      const float gate = gamma[j] + (1.0f - gamma[j]) * p;
+      const float dt = dy[j] * x_row[j] * (1.0f - gamma[j]) * p * (1.0f - p);
+      dx[j] = dy[j] * gate + dt * rvar[j] - offset[j] + scale[j] * centered;
+    }
+  }
+}
+
+#ifdef DICE_TRAINING_AVX512
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+// The same kernels, 16 columns at a time.
+
+inline __mmask16 TailMask(int64 cols, int64 j) {
+  return static_cast<__mmask16>((1u << (cols - j)) - 1);
+}
+
+// exp(x) for |x| <= 88.38, the Cephes polynomial of Eigen.
+inline __m512 Exp512(__m512 x) {
+  x = _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(88.3762626647950f)),
+                    _mm512_set1_ps(-88.3762626647949f));
+  const __m512 m = _mm512_floor_ps(_mm512_fmadd_ps(
+      x, _mm512_set1_ps(1.44269504088896341f), _mm512_set1_ps(0.5f)));
+  const __m512 r =
+      _mm512_fmadd_ps(m, _mm512_set1_ps(-0.6931471805599453f), x);
+  __m512 y = _mm512_set1_ps(1.9875691500E-4f);
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(1.3981999507E-3f));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(8.3334519073E-3f));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(4.1665795894E-2f));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(1.6666665459E-1f));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(5.0000001201E-1f));
+  y = _mm512_fmadd_ps(y, _mm512_mul_ps(r, r), r);
+  y = _mm512_add_ps(y, _mm512_set1_ps(1.0f));
+  const __m512i exponent = _mm512_slli_epi32(
+      _mm512_cvttps_epi32(_mm512_add_ps(m, _mm512_set1_ps(127.0f))), 23);
+  return _mm512_mul_ps(y, _mm512_castsi512_ps(exponent));
+}
+
+inline __m512 Sigmoid512(__m512 t) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  return _mm512_div_ps(
+      one, _mm512_add_ps(one, Exp512(_mm512_sub_ps(_mm512_setzero_ps(), t))));
+}
+
+// Columns outside of the tail mask are loaded as 0 and never stored.
+void MomentsAvx512(const float* x, const float* shift, int64 cols, int64 begin,
+                   int64 end, float* sum, float* square_sum) {
+  for (int64 j = 0; j < cols; j += 16) {
+    const __mmask16 mask = j + 16 <= cols ? 0xFFFF : TailMask(cols, j);
+    const __m512 shift_j = _mm512_maskz_loadu_ps(mask, shift + j);
+    __m512 s = _mm512_setzero_ps();
+    __m512 q = _mm512_setzero_ps();
+    for (int64 row = begin; row < end; ++row) {
+      const __m512 d = _mm512_sub_ps(
+          _mm512_maskz_loadu_ps(mask, x + row * cols + j), shift_j);
+      s = _mm512_add_ps(s, d);
+      q = _mm512_fmadd_ps(d, d, q);
+    }
+    _mm512_mask_storeu_ps(sum + j, mask, s);
+    _mm512_mask_storeu_ps(square_sum + j, mask, q);
+  }
+}
+
+void ForwardAvx512(const float* x, const float* mean, const float* rvar,
+                   const float* gamma, int64 cols, int64 begin, int64 end,
+                   float* y) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  for (int64 row = begin; row < end; ++row) {
+    const float* x_row = x + row * cols;
+    float* y_row = y + row * cols;
+    for (int64 j = 0; j < cols; j += 16) {
+      const __mmask16 mask = j + 16 <= cols ? 0xFFFF : TailMask(cols, j);
+      const __m512 x_j = _mm512_maskz_loadu_ps(mask, x_row + j);
+      const __m512 gamma_j = _mm512_maskz_loadu_ps(mask, gamma + j);
+      const __m512 centered =
+          _mm512_sub_ps(x_j, _mm512_maskz_loadu_ps(mask, mean + j));
+      const __m512 p = Sigmoid512(
+          _mm512_mul_ps(centered, _mm512_maskz_loadu_ps(mask, rvar + j)));
+      const __m512 gate =
+          _mm512_fmadd_ps(_mm512_sub_ps(one, gamma_j), p, gamma_j);
+      _mm512_mask_storeu_ps(y_row + j, mask, _mm512_mul_ps(x_j, gate));
+    }
+  }
+}
+
+void GradSumsAvx512(const float* y_grad, const float* x, const float* mean,
+                    const float* rvar, const float* gamma, int64 cols,
+                    int64 begin, int64 end, float* t_grad_sum,
+                    float* t_grad_centered_sum, float* gamma_grad) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  for (int64 j = 0; j < cols; j += 16) {
+    const __mmask16 mask = j + 16 <= cols ? 0xFFFF : TailMask(cols, j);
+    const __m512 mean_j = _mm512_maskz_loadu_ps(mask, mean + j);
+    const __m512 rvar_j = _mm512_maskz_loadu_ps(mask, rvar + j);
+    const __m512 one_minus_gamma =
+        _mm512_sub_ps(one, _mm512_maskz_loadu_ps(mask, gamma + j));
+    __m512 dt_sum = _mm512_setzero_ps();
+    __m512 dt_centered_sum = _mm512_setzero_ps();
+    __m512 gamma_grad_sum = _mm512_setzero_ps();
+    for (int64 row = begin; row < end; ++row) {
+      const __m512 x_j = _mm512_maskz_loadu_ps(mask, x + row * cols + j);
+      const __m512 dy = _mm512_maskz_loadu_ps(mask, y_grad + row * cols + j);
+      const __m512 centered = _mm512_sub_ps(x_j, mean_j);
+      const __m512 p = Sigmoid512(_mm512_mul_ps(centered, rvar_j));
+      const __m512 dx_p =
+          _mm512_mul_ps(_mm512_mul_ps(dy, x_j), _mm512_sub_ps(one, p));
+      const __m512 dt = _mm512_mul_ps(_mm512_mul_ps(dx_p, one_minus_gamma), p);
+      dt_sum = _mm512_add_ps(dt_sum, dt);
+      dt_centered_sum = _mm512_fmadd_ps(dt, centered, dt_centered_sum);
+      gamma_grad_sum = _mm512_add_ps(gamma_grad_sum, dx_p);
+    }
+    _mm512_mask_storeu_ps(t_grad_sum + j, mask, dt_sum);
+    _mm512_mask_storeu_ps(t_grad_centered_sum + j, mask, dt_centered_sum);
+    _mm512_mask_storeu_ps(gamma_grad + j, mask, gamma_grad_sum);
+  }
+}
+
+void GradInputAvx512(const float* y_grad, const float* x, const float* mean,
+                     const float* rvar, const float* gamma, const float* offset,
+                     const float* scale, int64 cols, int64 begin, int64 end,
+                     float* x_grad) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  for (int64 row = begin; row < end; ++row) {
+    const float* dy_row = y_grad + row * cols;
+    const float* x_row = x + row * cols;
+    float* dx_row = x_grad + row * cols;
+    for (int64 j = 0; j < cols; j += 16) {
+      const __mmask16 mask = j + 16 <= cols ? 0xFFFF : TailMask(cols, j);
+      const __m512 x_j = _mm512_maskz_loadu_ps(mask, x_row + j);
+      const __m512 dy = _mm512_maskz_loadu_ps(mask, dy_row + j);
+      const __m512 gamma_j = _mm512_maskz_loadu_ps(mask, gamma + j);
+      const __m512 rvar_j = _mm512_maskz_loadu_ps(mask, rvar + j);
+      const __m512 one_minus_gamma = _mm512_sub_ps(one, gamma_j);
+      const __m512 centered =
+          _mm512_sub_ps(x_j, _mm512_maskz_loadu_ps(mask, mean + j));
+      const __m512 p = Sigmoid512(_mm512_mul_ps(centered, rvar_j));
+      const __m512 gate = _mm512_fmadd_ps(one_minus_gamma, p, gamma_j);
+      const __m512 dt = _mm512_mul_ps(
+          _mm512_mul_ps(_mm512_mul_ps(dy, x_j), one_minus_gamma),
+          _mm512_mul_ps(p, _mm512_sub_ps(one, p)));
+      __m512 dx = _mm512_mul_ps(dy, gate);
+      dx = _mm512_fmadd_ps(dt, rvar_j, dx);
+      dx = _mm512_sub_ps(dx, _mm512_maskz_loadu_ps(mask, offset + j));
+      dx = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, scale + j), centered,
+                           dx);
+      _mm512_mask_storeu_ps(dx_row + j, mask, dx);
+    }
+  }
+}
+
+#pragma GCC pop_options
+#endif  // DICE_TRAINING_AVX512
+
+bool UseAvx512() {
+#ifdef DICE_TRAINING_AVX512
+  return port::TestCPUFeature(port::CPUFeature::AVX512F);
+#else
+  return false;
+#endif
+}
+
+#ifdef DICE_TRAINING_AVX512
+#define DICE_DISPATCH(use_avx512, kernel, ...) \
+  ((use_avx512) ? kernel##Avx512(__VA_ARGS__) : kernel(__VA_ARGS__))
+#else
+#define DICE_DISPATCH(use_avx512, kernel, ...) kernel(__VA_ARGS__)
+#endif
+
+// Checks that the vector input `index` has one element per channel.
+Status CheckChannels(OpKernelContext* context, int index, int64 cols) {
+  const Tensor& tensor = context->input(index);
+  if (tensor.dims() != 1 || tensor.dim_size(0) != cols) {
+    return errors::InvalidArgument(
+        "Input ", index, " must be a vector of size ", cols,
+        ", the last dimension of x, but got shape ",
+        tensor.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+Status GetDiceShape(const Tensor& x, DiceShape* shape) {
+  if (x.dims() < 1) {
+    return errors::InvalidArgument("x must be at least 1-D, but got shape ",
+                                   x.shape().DebugString());
+  }
+  shape->cols = x.dim_size(x.dims() - 1);
+  shape->rows = shape->cols == 0 ? 0 : x.NumElements() / shape->cols;
+  return Status::OK();
+}
+
+}  // namespace
+
+// Dice fusion op for training, in two passes over x: the first one computes
+// the mean and the variance of each channel, and the second one the output.
+template <typename T>
+class DiceTrainingOp : public OpKernel {
+ public:
+  explicit DiceTrainingOp(OpKernelConstruction* context)
+      : OpKernel(context), use_avx512_(UseAvx512()) {
+    OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x_tensor = context->input(0);
+    DiceShape shape;
+    OP_REQUIRES_OK(context, GetDiceShape(x_tensor, &shape));
+    OP_REQUIRES_OK(context, CheckChannels(context, 1, shape.cols));
+
+    Tensor* y_tensor = nullptr;
+    Tensor* mean_tensor = nullptr;
+    Tensor* rvar_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, x_tensor.shape(), &y_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({shape.cols}), &mean_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({shape.cols}), &rvar_tensor));
+
+    const float* x = x_tensor.flat<T>().data();
+    const float* gamma = context->input(1).flat<T>().data();
+    float* y = y_tensor->flat<T>().data();
+    float* mean = mean_tensor->flat<T>().data();
+    float* rvar = rvar_tensor->flat<T>().data();
+    const int64 rows = shape.rows;
+    const int64 cols = shape.cols;
+    const int64 num_blocks = shape.NumBlocks();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const bool use_avx512 = use_avx512_;
+
+    // An empty batch has a mean of 0 and a variance of 0.
+    std::vector<float> shift(cols, 0.0f);
+    if (rows > 0) std::copy(x, x + cols, shift.begin());
+    std::vector<float> sums(num_blocks * cols, 0.0f);
+    std::vector<float> square_sums(num_blocks * cols, 0.0f);
+    worker_threads.workers->ParallelFor(
+        num_blocks, kRowBlock * cols * 3, [&](int64 begin, int64 end) {
+          for (int64 block = begin; block < end; ++block) {
+            DICE_DISPATCH(use_avx512, Moments, x, shift.data(), cols,
+                          block * kRowBlock, shape.BlockEnd(block),
+                          sums.data() + block * cols,
+                          square_sums.data() + block * cols);
+          }
+        });
+    for (int64 j = 0; j < cols; ++j) {
+      double sum = 0;
+      double square_sum = 0;
+      for (int64 block = 0; block < num_blocks; ++block) {
+        sum += sums[block * cols + j];
+        square_sum += square_sums[block * cols + j];
+      }
+      const double shifted_mean = rows > 0 ? sum / rows : 0.0;
+      const double variance = std::max(
+          rows > 0 ? square_sum / rows - shifted_mean * shifted_mean : 0.0,
+          0.0);
+      mean[j] = static_cast<float>(shift[j] + shifted_mean);
+      rvar[j] = static_cast<float>(
+          1.0 / (std::sqrt(variance + epsilon_) + epsilon_));
+    }
+
+    worker_threads.workers->ParallelFor(
+        num_blocks, kRowBlock * cols * 50, [&](int64 begin, int64 end) {
+          DICE_DISPATCH(use_avx512, Forward, x, mean, rvar, gamma, cols,
+                        begin * kRowBlock, shape.BlockEnd(end - 1), y);
+        });
+  }
+
+ private:
+  float epsilon_;
+  const bool use_avx512_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DiceTraining").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DiceTrainingOp<float>);
+
+// The gradient of DiceTraining, also in two passes over x and the gradient of
+// y. With t = (x - mean) * rvar and the standard deviation
+// std = 1 / rvar - epsilon, the first pass sums dt and dt * (x - mean) for the
+// gradients of the mean and the variance:
+//
+//   offset = rvar * sum(dt) / N
+//   scale = -rvar^2 * sum(dt * (x - mean)) / (std * N)
+//
+// and the second pass computes the gradient of x.
+template <typename T>
+class DiceTrainingGradOp : public OpKernel {
+ public:
+  explicit DiceTrainingGradOp(OpKernelConstruction* context)
+      : OpKernel(context), use_avx512_(UseAvx512()) {
+    OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& y_grad_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+    DiceShape shape;
+    OP_REQUIRES_OK(context, GetDiceShape(x_tensor, &shape));
+    OP_REQUIRES(context, y_grad_tensor.shape() == x_tensor.shape(),
+                errors::InvalidArgument(
+                    "y_grad and x must have the same shape, but got ",
+                    y_grad_tensor.shape().DebugString(), " and ",
+                    x_tensor.shape().DebugString()));
+    for (int index = 2; index < 5; ++index) {
+      OP_REQUIRES_OK(context, CheckChannels(context, index, shape.cols));
+    }
+
+    Tensor* x_grad_tensor = nullptr;
+    Tensor* gamma_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, x_tensor.shape(),
+                                                     &x_grad_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({shape.cols}),
+                                            &gamma_grad_tensor));
+
+    const float* y_grad = y_grad_tensor.flat<T>().data();
+    const float* x = x_tensor.flat<T>().data();
+    const float* gamma = context->input(2).flat<T>().data();
+    const float* mean = context->input(3).flat<T>().data();
+    const float* rvar = context->input(4).flat<T>().data();
+    float* x_grad = x_grad_tensor->flat<T>().data();
+    float* gamma_grad = gamma_grad_tensor->flat<T>().data();
+    const int64 rows = shape.rows;
+    const int64 cols = shape.cols;
+    const int64 num_blocks = shape.NumBlocks();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const bool use_avx512 = use_avx512_;
+
+    std::vector<float> t_grad_sums(num_blocks * cols, 0.0f);
+    std::vector<float> t_grad_centered_sums(num_blocks * cols, 0.0f);
+    std::vector<float> gamma_grads(num_blocks * cols, 0.0f);
+    worker_threads.workers->ParallelFor(
+        num_blocks, kRowBlock * cols * 60, [&](int64 begin, int64 end) {
+          for (int64 block = begin; block < end; ++block) {
+            DICE_DISPATCH(use_avx512, GradSums, y_grad, x, mean, rvar, gamma,
+                          cols, block * kRowBlock, shape.BlockEnd(block),
+                          t_grad_sums.data() + block * cols,
+                          t_grad_centered_sums.data() + block * cols,
+                          gamma_grads.data() + block * cols);
+          }
+        });
+    std::vector<float> offset(cols, 0.0f);
+    std::vector<float> scale(cols, 0.0f);
+    for (int64 j = 0; j < cols; ++j) {
+      double t_grad_sum = 0;
+      double t_grad_centered_sum = 0;
+      double gamma_grad_sum = 0;
+      for (int64 block = 0; block < num_blocks; ++block) {
+        t_grad_sum += t_grad_sums[block * cols + j];
+        t_grad_centered_sum += t_grad_centered_sums[block * cols + j];
+        gamma_grad_sum += gamma_grads[block * cols + j];
+      }
+      gamma_grad[j] = static_cast<float>(gamma_grad_sum);
+      if (rows == 0) continue;
+      const double r = rvar[j];
+      const double stddev = 1.0 / r - epsilon_;
+      offset[j] = static_cast<float>(r * t_grad_sum / rows);
+      scale[j] = static_cast<float>(-r * r * t_grad_centered_sum /
+                                    (stddev * rows));
+    }
+
+    worker_threads.workers->ParallelFor(
+        num_blocks, kRowBlock * cols * 60, [&](int64 begin, int64 end) {
+          DICE_DISPATCH(use_avx512, GradInput, y_grad, x, mean, rvar, gamma,
+                        offset.data(), scale.data(), cols, begin * kRowBlock,
+                        shape.BlockEnd(end - 1), x_grad);
+        });
+  }
+
+ private:
+  float epsilon_;
+  const bool use_avx512_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DiceTrainingGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DiceTrainingGradOp<float>);
+
+#undef DICE_DISPATCH
+
+}  // namespace tensorflow
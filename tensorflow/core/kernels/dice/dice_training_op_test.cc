@@ -0,0 +1,291 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr float kEpsilon = 1e-9;
+
+struct DiceInputs {
+  explicit DiceInputs(const TensorShape& shape) : shape(shape) {
+    cols = shape.dim_size(shape.dims() - 1);
+    rows = shape.num_elements() / cols;
+    x.resize(rows * cols);
+    y_grad.resize(rows * cols);
+    gamma.resize(cols);
+    // Far from 0 on average, to exercise the variance of large means.
+    for (int i = 0; i < rows * cols; ++i) {
+      x[i] = 3.0f + 2.0f * std::sin(0.37f * i + 0.11f);
+      y_grad[i] = std::cos(0.53f * i + 0.7f);
+    }
+    for (int j = 0; j < cols; ++j) gamma[j] = 0.4f * std::sin(1.3f * j);
+  }
+
+  float X(int i, int j) const { return x[i * cols + j]; }
+
+  // The unfused dice of modelzoo, with the statistics of the batch.
+  void Forward(std::vector<double>* y, std::vector<double>* mean,
+               std::vector<double>* rvar) const {
+    y->assign(rows * cols, 0);
+    mean->assign(cols, 0);
+    rvar->assign(cols, 0);
+    for (int j = 0; j < cols; ++j) {
+      double m = 0;
+      for (int i = 0; i < rows; ++i) m += X(i, j);
+      m /= rows;
+      double v = 0;
+      for (int i = 0; i < rows; ++i) {
+        v += (X(i, j) - m) * (X(i, j) - m) + kEpsilon;
+      }
+      const double stddev = std::sqrt(v / rows);
+      (*mean)[j] = m;
+      (*rvar)[j] = 1.0 / (stddev + kEpsilon);
+      for (int i = 0; i < rows; ++i) {
+        const double p = 1.0 / (1.0 + std::exp(-(X(i, j) - m) * (*rvar)[j]));
+        (*y)[i * cols + j] = gamma[j] * (1.0 - p) * X(i, j) + p * X(i, j);
+      }
+    }
+  }
+
+  // The gradients of the unfused dice, op by op in reverse.
+  void Grads(std::vector<double>* x_grad,
+             std::vector<double>* gamma_grad) const {
+    x_grad->assign(rows * cols, 0);
+    gamma_grad->assign(cols, 0);
+    for (int j = 0; j < cols; ++j) {
+      double m = 0;
+      for (int i = 0; i < rows; ++i) m += X(i, j);
+      m /= rows;
+      double v = 0;
+      for (int i = 0; i < rows; ++i) {
+        v += (X(i, j) - m) * (X(i, j) - m) + kEpsilon;
+      }
+      const double stddev = std::sqrt(v / rows);
+      const double denominator = stddev + kEpsilon;
+      std::vector<double> centered_grad(rows);
+      double denominator_grad = 0;
+      for (int i = 0; i < rows; ++i) {
+        const double centered = X(i, j) - m;
+        const double p = 1.0 / (1.0 + std::exp(-centered / denominator));
+        const double dy = y_grad[i * cols + j];
+        (*gamma_grad)[j] += dy * (1.0 - p) * X(i, j);
+        (*x_grad)[i * cols + j] = dy * (gamma[j] * (1.0 - p) + p);
+        const double normed_grad =
+            dy * X(i, j) * (1.0 - gamma[j]) * p * (1.0 - p);
+        centered_grad[i] = normed_grad / denominator;
+        denominator_grad -=
+            normed_grad * centered / (denominator * denominator);
+      }
+      const double variance_grad = denominator_grad / (2.0 * stddev);
+      double mean_grad = 0;
+      for (int i = 0; i < rows; ++i) {
+        centered_grad[i] += variance_grad * 2.0 * (X(i, j) - m) / rows;
+        mean_grad -= centered_grad[i];
+      }
+      for (int i = 0; i < rows; ++i) {
+        (*x_grad)[i * cols + j] += centered_grad[i] + mean_grad / rows;
+      }
+    }
+  }
+
+  TensorShape shape;
+  int rows, cols;
+  std::vector<float> x, gamma, y_grad;
+};
+
+class DiceTrainingOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op) {
+    NodeDefBuilder builder("dice", op);
+    const int num_inputs = op == "DiceTrainingGrad" ? 5 : 2;
+    for (int i = 0; i < num_inputs; ++i) builder.Input(FakeInput(DT_FLOAT));
+    TF_EXPECT_OK(builder.Attr("T", DT_FLOAT)
+                     .Attr("epsilon", kEpsilon)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  static Tensor ToTensor(const std::vector<double>& values,
+                         const TensorShape& shape) {
+    Tensor tensor(DT_FLOAT, shape);
+    for (int i = 0; i < values.size(); ++i) tensor.flat<float>()(i) = values[i];
+    return tensor;
+  }
+
+  void ExpectMatchesUnfused(const DiceInputs& in) {
+    MakeOp("DiceTraining");
+    AddInputFromArray<float>(in.shape, in.x);
+    AddInputFromArray<float>(TensorShape({in.cols}), in.gamma);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<double> y, mean, rvar;
+    in.Forward(&y, &mean, &rvar);
+    test::ExpectTensorNear<float>(ToTensor(y, in.shape), *GetOutput(0), 1e-4);
+    test::ExpectTensorNear<float>(ToTensor(mean, TensorShape({in.cols})),
+                                  *GetOutput(1), 1e-4);
+    test::ExpectClose(ToTensor(rvar, TensorShape({in.cols})), *GetOutput(2),
+                      /*atol=*/1e-4, /*rtol=*/1e-4);
+  }
+
+  void ExpectGradMatchesUnfused(const DiceInputs& in) {
+    std::vector<double> y, mean, rvar;
+    in.Forward(&y, &mean, &rvar);
+    MakeOp("DiceTrainingGrad");
+    AddInputFromArray<float>(in.shape, in.y_grad);
+    AddInputFromArray<float>(in.shape, in.x);
+    AddInputFromArray<float>(TensorShape({in.cols}), in.gamma);
+    AddInputFromArray<float>(TensorShape({in.cols}),
+                             std::vector<float>(mean.begin(), mean.end()));
+    AddInputFromArray<float>(TensorShape({in.cols}),
+                             std::vector<float>(rvar.begin(), rvar.end()));
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<double> x_grad, gamma_grad;
+    in.Grads(&x_grad, &gamma_grad);
+    test::ExpectTensorNear<float>(ToTensor(x_grad, in.shape), *GetOutput(0),
+                                  1e-4);
+    test::ExpectClose(ToTensor(gamma_grad, TensorShape({in.cols})),
+                      *GetOutput(1), /*atol=*/1e-4, /*rtol=*/1e-4);
+  }
+};
+
+TEST_F(DiceTrainingOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(DiceInputs(TensorShape({12, 7})));
+}
+
+// The statistics are over all the dimensions but the last.
+TEST_F(DiceTrainingOpTest, MatchesUnfused3D) {
+  ExpectMatchesUnfused(DiceInputs(TensorShape({3, 4, 7})));
+}
+
+// More rows than a block, and channels that are not a multiple of 16.
+TEST_F(DiceTrainingOpTest, MatchesUnfusedAcrossBlocks) {
+  ExpectMatchesUnfused(DiceInputs(TensorShape({300, 37})));
+}
+
+TEST_F(DiceTrainingOpTest, GradMatchesUnfused) {
+  ExpectGradMatchesUnfused(DiceInputs(TensorShape({12, 7})));
+}
+
+TEST_F(DiceTrainingOpTest, GradMatchesUnfused3D) {
+  ExpectGradMatchesUnfused(DiceInputs(TensorShape({3, 4, 7})));
+}
+
+TEST_F(DiceTrainingOpTest, GradMatchesUnfusedAcrossBlocks) {
+  ExpectGradMatchesUnfused(DiceInputs(TensorShape({300, 37})));
+}
+
+TEST_F(DiceTrainingOpTest, InvalidGammaShape) {
+  DiceInputs in(TensorShape({12, 7}));
+  MakeOp("DiceTraining");
+  AddInputFromArray<float>(in.shape, in.x);
+  AddInputFromArray<float>(TensorShape({in.cols - 1}),
+                           std::vector<float>(in.cols - 1));
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+// The forward pass of the dice of modelzoo, or of DiceTraining.
+static Graph* DiceTraining(bool fused, int rows, int cols) {
+  Scope s = Scope::NewRootScope();
+  Output x = RandomConst(s, {rows, cols});
+  Output gamma = RandomConst(s, {cols});
+  if (!fused) {
+    auto keep_dims = ops::Mean::KeepDims(true);
+    Output mean = ops::Mean(s, x, {0}, keep_dims);
+    Output centered = ops::Sub(s, x, mean);
+    Output variance = ops::Mean(
+        s, ops::Add(s, ops::Square(s, centered), kEpsilon), {0}, keep_dims);
+    Output normed = ops::RealDiv(
+        s, centered, ops::Add(s, ops::Sqrt(s, variance), kEpsilon));
+    Output p = ops::Sigmoid(s, normed);
+    ops::Add(s, ops::Mul(s, ops::Mul(s, gamma, ops::Sub(s, 1.0f, p)), x),
+             ops::Mul(s, p, x));
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  if (fused) {
+    std::unordered_map<string, Node*> nodes;
+    for (Node* node : g->nodes()) nodes[node->name()] = node;
+    TF_CHECK_OK(NodeBuilder(g->NewName("dice"), "DiceTraining")
+                    .Input(nodes[x.node()->name()])
+                    .Input(nodes[gamma.node()->name()])
+                    .Attr("epsilon", kEpsilon)
+                    .Finalize(g, nullptr));
+  }
+  return g;
+}
+
+static Graph* FusedDiceTraining(int rows, int cols) {
+  return DiceTraining(true, rows, cols);
+}
+
+static Graph* UnfusedDiceTraining(int rows, int cols) {
+  return DiceTraining(false, rows, cols);
+}
+
+static Graph* DiceTrainingGrad(int rows, int cols) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<Node*> inputs;
+  for (const TensorShape& shape :
+       {TensorShape({rows, cols}), TensorShape({rows, cols}),
+        TensorShape({cols}), TensorShape({cols}), TensorShape({cols})}) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    inputs.push_back(test::graph::Constant(g, t));
+  }
+  NodeBuilder builder(g->NewName("dice_grad"), "DiceTrainingGrad");
+  for (Node* input : inputs) builder.Input(input);
+  TF_CHECK_OK(builder.Attr("epsilon", kEpsilon).Finalize(g, nullptr));
+  return g;
+}
+
+#define BM_DICE_TRAINING(KIND, ROWS, COLS, NTH)                            \
+  static void BM_##KIND##_##ROWS##_##COLS##_##NTH##_CPU(int iters) {       \
+    testing::UseRealTime();                                                \
+    testing::ItemsProcessed(static_cast<int64>(iters) * ROWS * COLS);      \
+    SessionOptions opts;                                                   \
+    opts.config.set_intra_op_parallelism_threads(NTH);                     \
+    test::Benchmark("cpu", KIND(ROWS, COLS), &opts).Run(iters);            \
+  }                                                                        \
+  BENCHMARK(BM_##KIND##_##ROWS##_##COLS##_##NTH##_CPU);
+
+#define BM_DICE_TRAINING_NTH(ROWS, COLS)                \
+  BM_DICE_TRAINING(FusedDiceTraining, ROWS, COLS, 1);   \
+  BM_DICE_TRAINING(FusedDiceTraining, ROWS, COLS, 8);   \
+  BM_DICE_TRAINING(UnfusedDiceTraining, ROWS, COLS, 1); \
+  BM_DICE_TRAINING(UnfusedDiceTraining, ROWS, COLS, 8); \
+  BM_DICE_TRAINING(DiceTrainingGrad, ROWS, COLS, 1);    \
+  BM_DICE_TRAINING(DiceTrainingGrad, ROWS, COLS, 8);
+
+// The top MLP of DIN and DIEN, of 200 and 80 units.
+BM_DICE_TRAINING_NTH(1024, 200);
+BM_DICE_TRAINING_NTH(1024, 80);
+BM_DICE_TRAINING_NTH(4096, 200);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,438 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+struct DinAttentionShape {
+  int64 batch = 0;
+  int64 seq_len = 0;
+  int64 dim = 0;
+  int64 hidden_1 = 0;
+  int64 hidden_2 = 0;
+
+  // Flops of the attention MLP for one fact.
+  int64 MlpCost() const {
+    return 2 * (4 * dim * hidden_1 + hidden_1 * hidden_2 + hidden_2);
+  }
+};
+
+// Checks the inputs shared by the forward and backward ops, which start at
+// input `first`.
+Status GetDinAttentionShape(OpKernelContext* context, int first,
+                            DinAttentionShape* shape) {
+  const Tensor& query = context->input(first);
+  const Tensor& facts = context->input(first + 1);
+  const Tensor& mask = context->input(first + 2);
+  const Tensor& w1 = context->input(first + 3);
+  const Tensor& b1 = context->input(first + 4);
+  const Tensor& w2 = context->input(first + 5);
+  const Tensor& b2 = context->input(first + 6);
+  const Tensor& w3 = context->input(first + 7);
+  const Tensor& b3 = context->input(first + 8);
+  if (facts.dims() != 3) {
+    return errors::InvalidArgument("facts must be 3-D, got ",
+                                   facts.shape().DebugString());
+  }
+  shape->batch = facts.dim_size(0);
+  shape->seq_len = facts.dim_size(1);
+  shape->dim = facts.dim_size(2);
+  if (query.dims() != 2 || query.dim_size(0) != shape->batch ||
+      query.dim_size(1) != shape->dim) {
+    return errors::InvalidArgument("query must be [", shape->batch, ", ",
+                                   shape->dim, "], got ",
+                                   query.shape().DebugString());
+  }
+  if (mask.NumElements() != shape->batch * shape->seq_len) {
+    return errors::InvalidArgument("mask must have ",
+                                   shape->batch * shape->seq_len,
+                                   " elements, got ",
+                                   mask.shape().DebugString());
+  }
+  if (w1.dims() != 2 || w1.dim_size(0) != 4 * shape->dim) {
+    return errors::InvalidArgument("w1 must be [", 4 * shape->dim,
+                                   ", hidden_1], got ",
+                                   w1.shape().DebugString());
+  }
+  shape->hidden_1 = w1.dim_size(1);
+  if (w2.dims() != 2 || w2.dim_size(0) != shape->hidden_1) {
+    return errors::InvalidArgument("w2 must be [", shape->hidden_1,
+                                   ", hidden_2], got ",
+                                   w2.shape().DebugString());
+  }
+  shape->hidden_2 = w2.dim_size(1);
+  if (w3.NumElements() != shape->hidden_2 || b3.NumElements() != 1) {
+    return errors::InvalidArgument("w3 must be [", shape->hidden_2,
+                                   ", 1] and b3 [1], got ",
+                                   w3.shape().DebugString(), " and ",
+                                   b3.shape().DebugString());
+  }
+  if (b1.NumElements() != shape->hidden_1 ||
+      b2.NumElements() != shape->hidden_2) {
+    return errors::InvalidArgument("b1 and b2 must be [", shape->hidden_1,
+                                   "] and [", shape->hidden_2, "], got ",
+                                   b1.shape().DebugString(), " and ",
+                                   b2.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+// Runs the attention MLP of one batch row. The intermediate activations of
+// the unmasked facts, packed in order, are kept in the buffers for the
+// backward pass.
+class DinAttentionUnit {
+ public:
+  DinAttentionUnit(OpKernelContext* context, int first,
+                   const DinAttentionShape& shape, float padding_value)
+      : shape_(shape),
+        padding_value_(padding_value),
+        query_(context->input(first).flat<float>().data()),
+        facts_(context->input(first + 1).flat<float>().data()),
+        mask_(context->input(first + 2).flat<bool>().data()),
+        w1_(context->input(first + 3).flat<float>().data(), 4 * shape.dim,
+            shape.hidden_1),
+        b1_(context->input(first + 4).flat<float>().data(), shape.hidden_1),
+        w2_(context->input(first + 5).flat<float>().data(), shape.hidden_1,
+            shape.hidden_2),
+        b2_(context->input(first + 6).flat<float>().data(), shape.hidden_2),
+        w3_(context->input(first + 7).flat<float>().data(), shape.hidden_2,
+            1),
+        b3_(context->input(first + 8).flat<float>()(0)) {
+    const int64 t = shape_.seq_len;
+    valid_.reserve(t);
+    x_.resize(t * 4 * shape_.dim);
+    h1_.resize(t * shape_.hidden_1);
+    h2_.resize(t * shape_.hidden_2);
+    scores_.resize(t);
+  }
+
+  const float* query(int64 b) const { return query_ + b * shape_.dim; }
+
+  const float* facts(int64 b) const {
+    return facts_ + b * shape_.seq_len * shape_.dim;
+  }
+
+  // Fills `alphas` with the attention weights of the facts of row `b`.
+  void Forward(int64 b, float* alphas) {
+    const int64 t = shape_.seq_len;
+    const int64 d = shape_.dim;
+    const bool* mask = mask_ + b * t;
+    valid_.clear();
+    for (int64 i = 0; i < t; ++i) {
+      if (mask[i]) valid_.push_back(i);
+    }
+    const int64 n = valid_.size();
+    if (n == 0) {
+      // All scores are padding_value, the softmax is uniform.
+      std::fill(alphas, alphas + t, 1.0f / t);
+      return;
+    }
+
+    // Only the unmasked facts go through the MLP.
+    const float* q = query(b);
+    const float* f = facts(b);
+    for (int64 i = 0; i < n; ++i) {
+      const float* fi = f + valid_[i] * d;
+      float* xi = x_.data() + i * 4 * d;
+      for (int64 j = 0; j < d; ++j) {
+        xi[j] = q[j];
+        xi[d + j] = fi[j];
+        xi[2 * d + j] = q[j] - fi[j];
+        xi[3 * d + j] = q[j] * fi[j];
+      }
+    }
+    ConstMatrixMap x(x_.data(), n, 4 * d);
+    MatrixMap h1(h1_.data(), n, shape_.hidden_1);
+    MatrixMap h2(h2_.data(), n, shape_.hidden_2);
+    h1.noalias() = x * w1_;
+    h1.rowwise() += b1_;
+    h1 = (1.0f + (-h1.array()).exp()).inverse().matrix();
+    h2.noalias() = h1 * w2_;
+    h2.rowwise() += b2_;
+    h2 = (1.0f + (-h2.array()).exp()).inverse().matrix();
+    MatrixMap scores(scores_.data(), n, 1);
+    scores.noalias() = h2 * w3_;
+
+    float max_score = n < t ? padding_value_ : scores_[0] + b3_;
+    for (int64 i = 0; i < n; ++i) {
+      scores_[i] += b3_;
+      max_score = std::max(max_score, scores_[i]);
+    }
+    const float padding_exp = std::exp(padding_value_ - max_score);
+    std::fill(alphas, alphas + t, padding_exp);
+    float sum = padding_exp * (t - n);
+    for (int64 i = 0; i < n; ++i) {
+      alphas[valid_[i]] = std::exp(scores_[i] - max_score);
+      sum += alphas[valid_[i]];
+    }
+    const float inv_sum = 1.0f / sum;
+    for (int64 i = 0; i < t; ++i) {
+      alphas[i] *= inv_sum;
+    }
+  }
+
+  int64 num_valid() const { return valid_.size(); }
+  int64 valid(int64 i) const { return valid_[i]; }
+  float* x() { return x_.data(); }
+  float* h1() { return h1_.data(); }
+  float* h2() { return h2_.data(); }
+  const Eigen::Map<const Matrix>& w1() const { return w1_; }
+  const Eigen::Map<const Matrix>& w2() const { return w2_; }
+  const Eigen::Map<const Matrix>& w3() const { return w3_; }
+
+ private:
+  const DinAttentionShape& shape_;
+  const float padding_value_;
+  const float* query_;
+  const float* facts_;
+  const bool* mask_;
+  ConstMatrixMap w1_;
+  ConstRowVectorMap b1_;
+  ConstMatrixMap w2_;
+  ConstRowVectorMap b2_;
+  ConstMatrixMap w3_;
+  const float b3_;
+
+  std::vector<int64> valid_;
+  std::vector<float> x_;
+  std::vector<float> h1_;
+  std::vector<float> h2_;
+  std::vector<float> scores_;
+};
+
+}  // namespace
+
+// Fused DIN attention, see the DinAttention op. Each batch row is computed
+// by one thread with the [q, k, q-k, q*k] features and the MLP activations
+// of its unmasked facts in cache.
+template <typename T>
+class DinAttentionOp : public OpKernel {
+ public:
+  explicit DinAttentionOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("padding_value", &padding_value_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    DinAttentionShape shape;
+    OP_REQUIRES_OK(context, GetDinAttentionShape(context, 0, &shape));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({shape.batch, 1, shape.dim}),
+                                &output_tensor));
+    Tensor* alphas_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       1, TensorShape({shape.batch, 1, shape.seq_len}),
+                       &alphas_tensor));
+    if (shape.batch == 0 || shape.seq_len == 0) {
+      output_tensor->flat<T>().setZero();
+      return;
+    }
+    T* output = output_tensor->flat<T>().data();
+    T* alphas = alphas_tensor->flat<T>().data();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost =
+        shape.seq_len * (shape.MlpCost() + 2 * shape.dim + 20);
+    worker_threads.workers->ParallelFor(
+        shape.batch, cost, [&](int64 begin, int64 end) {
+          DinAttentionUnit unit(context, 0, shape, padding_value_);
+          for (int64 b = begin; b < end; ++b) {
+            float* alpha = alphas + b * shape.seq_len;
+            unit.Forward(b, alpha);
+            ConstMatrixMap facts(unit.facts(b), shape.seq_len, shape.dim);
+            RowVectorMap out(output + b * shape.dim, shape.dim);
+            out.noalias() =
+                ConstRowVectorMap(alpha, shape.seq_len) * facts;
+          }
+        });
+  }
+
+ private:
+  float padding_value_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DinAttention").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DinAttentionOp<float>);
+
+// Gradients of DinAttention. The MLP is recomputed per batch row instead of
+// keeping its activations for all rows, and masked facts skip it entirely.
+// The weight gradients are summed per block of rows and then over the
+// blocks in order, so the result does not depend on scheduling.
+template <typename T>
+class DinAttentionGradOp : public OpKernel {
+ public:
+  explicit DinAttentionGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("padding_value", &padding_value_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    DinAttentionShape shape;
+    OP_REQUIRES_OK(context, GetDinAttentionShape(context, 2, &shape));
+    const Tensor& output_grad = context->input(0);
+    const Tensor& alphas_grad = context->input(1);
+    OP_REQUIRES(context,
+                output_grad.NumElements() == shape.batch * shape.dim,
+                errors::InvalidArgument("output_grad must be [", shape.batch,
+                                        ", 1, ", shape.dim, "], got ",
+                                        output_grad.shape().DebugString()));
+    OP_REQUIRES(context,
+                alphas_grad.NumElements() == shape.batch * shape.seq_len,
+                errors::InvalidArgument("alphas_grad must be [", shape.batch,
+                                        ", 1, ", shape.seq_len, "], got ",
+                                        alphas_grad.shape().DebugString()));
+
+    Tensor* grads[8];
+    for (int i = 0; i < 8; ++i) {
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  i, context->input(i < 2 ? i + 2 : i + 3)
+                                         .shape(),
+                                  &grads[i]));
+      grads[i]->flat<T>().setZero();
+    }
+    if (shape.batch == 0 || shape.seq_len == 0) return;
+
+    // Offsets of the weight gradients in a block accumulator.
+    const int64 h1 = shape.hidden_1;
+    const int64 h2 = shape.hidden_2;
+    const int64 sizes[6] = {4 * shape.dim * h1, h1, h1 * h2, h2, h2, 1};
+    int64 offsets[7] = {0};
+    for (int i = 0; i < 6; ++i) offsets[i + 1] = offsets[i] + sizes[i];
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 num_blocks =
+        std::min<int64>(shape.batch, std::max(1, worker_threads.num_threads));
+    const int64 rows_per_block = (shape.batch + num_blocks - 1) / num_blocks;
+    std::vector<float> accumulators(num_blocks * offsets[6], 0.0f);
+
+    const float* dout = output_grad.flat<T>().data();
+    const float* dalphas = alphas_grad.flat<T>().data();
+    float* dquery = grads[0]->flat<T>().data();
+    float* dfacts = grads[1]->flat<T>().data();
+    const int64 cost = rows_per_block * shape.seq_len *
+                       (3 * shape.MlpCost() + 6 * shape.dim + 20);
+    worker_threads.workers->ParallelFor(
+        num_blocks, cost, [&](int64 begin, int64 end) {
+          DinAttentionUnit unit(context, 2, shape, padding_value_);
+          std::vector<float> buffer(shape.seq_len * 2 +
+                                    shape.seq_len * (h1 + h2));
+          for (int64 block = begin; block < end; ++block) {
+            float* acc = accumulators.data() + block * offsets[6];
+            const int64 row_end =
+                std::min(shape.batch, (block + 1) * rows_per_block);
+            for (int64 b = block * rows_per_block; b < row_end; ++b) {
+              BackwardRow(shape, b, dout + b * shape.dim,
+                          dalphas + b * shape.seq_len, offsets,
+                          buffer.data(), acc, &unit,
+                          dquery + b * shape.dim,
+                          dfacts + b * shape.seq_len * shape.dim);
+            }
+          }
+        });
+
+    for (int i = 0; i < 6; ++i) {
+      float* grad = grads[i + 2]->flat<T>().data();
+      for (int64 block = 0; block < num_blocks; ++block) {
+        const float* acc = accumulators.data() + block * offsets[6] +
+                           offsets[i];
+        for (int64 j = 0; j < sizes[i]; ++j) grad[j] += acc[j];
+      }
+    }
+  }
+
+ private:
+  void BackwardRow(const DinAttentionShape& shape, int64 b, const float* dout,
+                   const float* dalphas, const int64* offsets, float* buffer,
+                   float* acc, DinAttentionUnit* unit, float* dquery,
+                   float* dfacts) {
+    const int64 t = shape.seq_len;
+    const int64 d = shape.dim;
+    float* alphas = buffer;
+    float* dscores = buffer + t;
+    unit->Forward(b, alphas);
+
+    ConstMatrixMap facts(unit->facts(b), t, d);
+    ConstRowVectorMap dout_vec(dout, d);
+    // d(output) / d(facts) and d(output) / d(alphas).
+    MatrixMap(dfacts, t, d).noalias() =
+        ConstMatrixMap(alphas, t, 1) * dout_vec;
+    Eigen::Map<Eigen::VectorXf> dalpha(dscores, t);
+    dalpha.noalias() = facts * dout_vec.transpose();
+    dalpha += Eigen::Map<const Eigen::VectorXf>(dalphas, t);
+
+    const int64 n = unit->num_valid();
+    // Masked scores are constants and get no gradient.
+    if (n == 0) return;
+    float dot = 0;
+    for (int64 i = 0; i < t; ++i) dot += alphas[i] * dscores[i];
+    for (int64 i = 0; i < n; ++i) {
+      const int64 k = unit->valid(i);
+      dscores[i] = alphas[k] * (dscores[k] - dot);
+    }
+
+    const int64 h1_size = shape.hidden_1;
+    const int64 h2_size = shape.hidden_2;
+    ConstMatrixMap ds(dscores, n, 1);
+    MatrixMap x(unit->x(), n, 4 * d);
+    MatrixMap h1(unit->h1(), n, h1_size);
+    MatrixMap h2(unit->h2(), n, h2_size);
+    MatrixMap dz2(buffer + 2 * t, n, h2_size);
+    MatrixMap dz1(buffer + 2 * t + t * h2_size, n, h1_size);
+
+    MatrixMap(acc + offsets[4], h2_size, 1).noalias() += h2.transpose() * ds;
+    acc[offsets[5]] += ds.sum();
+    dz2.noalias() = ds * unit->w3().transpose();
+    dz2.array() *= h2.array() * (1.0f - h2.array());
+    MatrixMap(acc + offsets[2], h1_size, h2_size).noalias() +=
+        h1.transpose() * dz2;
+    RowVectorMap(acc + offsets[3], h2_size) += dz2.colwise().sum();
+    dz1.noalias() = dz2 * unit->w2().transpose();
+    dz1.array() *= h1.array() * (1.0f - h1.array());
+    MatrixMap(acc + offsets[0], 4 * d, h1_size).noalias() +=
+        x.transpose() * dz1;
+    RowVectorMap(acc + offsets[1], h1_size) += dz1.colwise().sum();
+    // The features are no longer needed, reuse them for their gradients.
+    x.noalias() = dz1 * unit->w1().transpose();
+
+    const float* q = unit->query(b);
+    for (int64 i = 0; i < n; ++i) {
+      const float* dx = x.data() + i * 4 * d;
+      const float* fi = unit->facts(b) + unit->valid(i) * d;
+      float* dfi = dfacts + unit->valid(i) * d;
+      for (int64 j = 0; j < d; ++j) {
+        dquery[j] += dx[j] + dx[2 * d + j] + dx[3 * d + j] * fi[j];
+        dfi[j] += dx[d + j] - dx[2 * d + j] + dx[3 * d + j] * q[j];
+      }
+    }
+  }
+
+  float padding_value_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DinAttentionGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DinAttentionGradOp<float>);
+
+}  // namespace tensorflow
@@ -0,0 +1,319 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+const float kPadding = -4294967295.0f;
+
+// Inputs of a DIN attention layer, the first batch row partly masked and
+// the last one fully masked.
+struct DinAttentionInputs {
+  DinAttentionInputs(int batch, int seq_len, int dim, int hidden_1,
+                     int hidden_2)
+      : batch(batch), seq_len(seq_len), dim(dim), hidden_1(hidden_1),
+        hidden_2(hidden_2) {
+    Fill(&query, batch * dim);
+    Fill(&facts, batch * seq_len * dim);
+    Fill(&w1, 4 * dim * hidden_1);
+    Fill(&b1, hidden_1);
+    Fill(&w2, hidden_1 * hidden_2);
+    Fill(&b2, hidden_2);
+    Fill(&w3, hidden_2);
+    Fill(&b3, 1);
+    mask.assign(batch * seq_len, true);
+    mask[seq_len - 1] = false;
+    mask[seq_len - 2] = false;
+    for (int t = 0; t < seq_len; ++t) mask[(batch - 1) * seq_len + t] = false;
+  }
+
+  void Fill(std::vector<float>* v, int n) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = std::sin(0.37f * i + 0.11f * n);
+    }
+  }
+
+  // The unfused computation of the attention weights of row `b`.
+  std::vector<double> Alphas(int b) const {
+    std::vector<double> scores(seq_len);
+    for (int t = 0; t < seq_len; ++t) {
+      if (!mask[b * seq_len + t]) {
+        scores[t] = kPadding;
+        continue;
+      }
+      std::vector<double> x(4 * dim);
+      for (int j = 0; j < dim; ++j) {
+        const double q = query[b * dim + j];
+        const double f = facts[(b * seq_len + t) * dim + j];
+        x[j] = q;
+        x[dim + j] = f;
+        x[2 * dim + j] = q - f;
+        x[3 * dim + j] = q * f;
+      }
+      std::vector<double> h1(hidden_1);
+      for (int k = 0; k < hidden_1; ++k) {
+        double z = b1[k];
+        for (int i = 0; i < 4 * dim; ++i) z += x[i] * w1[i * hidden_1 + k];
+        h1[k] = 1.0 / (1.0 + std::exp(-z));
+      }
+      double score = b3[0];
+      for (int k = 0; k < hidden_2; ++k) {
+        double z = b2[k];
+        for (int i = 0; i < hidden_1; ++i) z += h1[i] * w2[i * hidden_2 + k];
+        score += w3[k] / (1.0 + std::exp(-z));
+      }
+      scores[t] = score;
+    }
+    double max_score = scores[0];
+    for (double s : scores) max_score = std::max(max_score, s);
+    double sum = 0;
+    for (double& s : scores) {
+      s = std::exp(s - max_score);
+      sum += s;
+    }
+    for (double& s : scores) s /= sum;
+    return scores;
+  }
+
+  // sum(output * output_grad) + sum(alphas * alphas_grad).
+  double Loss(const std::vector<float>& output_grad,
+              const std::vector<float>& alphas_grad) const {
+    double loss = 0;
+    for (int b = 0; b < batch; ++b) {
+      std::vector<double> alphas = Alphas(b);
+      for (int t = 0; t < seq_len; ++t) {
+        loss += alphas[t] * alphas_grad[b * seq_len + t];
+        for (int j = 0; j < dim; ++j) {
+          loss += alphas[t] * facts[(b * seq_len + t) * dim + j] *
+                  output_grad[b * dim + j];
+        }
+      }
+    }
+    return loss;
+  }
+
+  std::vector<std::vector<float>*> Params() {
+    return {&query, &facts, &w1, &b1, &w2, &b2, &w3, &b3};
+  }
+
+  int batch, seq_len, dim, hidden_1, hidden_2;
+  std::vector<float> query, facts, w1, b1, w2, b2, w3, b3;
+  std::vector<bool> mask;
+};
+
+class DinAttentionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op) {
+    NodeDefBuilder builder("din_attention", op);
+    if (op == "DinAttentionGrad") {
+      builder.Input(FakeInput(DT_FLOAT)).Input(FakeInput(DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_BOOL))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const DinAttentionInputs& in) {
+    const int b = in.batch, t = in.seq_len, d = in.dim;
+    AddInputFromArray<float>(TensorShape({b, d}), in.query);
+    AddInputFromArray<float>(TensorShape({b, t, d}), in.facts);
+    AddInput<bool>(TensorShape({b, t}),
+                   [&in](int i) -> bool { return in.mask[i]; });
+    AddInputFromArray<float>(TensorShape({4 * d, in.hidden_1}), in.w1);
+    AddInputFromArray<float>(TensorShape({in.hidden_1}), in.b1);
+    AddInputFromArray<float>(TensorShape({in.hidden_1, in.hidden_2}), in.w2);
+    AddInputFromArray<float>(TensorShape({in.hidden_2}), in.b2);
+    AddInputFromArray<float>(TensorShape({in.hidden_2, 1}), in.w3);
+    AddInputFromArray<float>(TensorShape({1}), in.b3);
+  }
+};
+
+TEST_F(DinAttentionOpTest, MatchesUnfused) {
+  DinAttentionInputs in(4, 7, 5, 8, 3);
+  MakeOp("DinAttention");
+  AddInputs(in);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_output(DT_FLOAT, TensorShape({in.batch, 1, in.dim}));
+  Tensor expected_alphas(DT_FLOAT, TensorShape({in.batch, 1, in.seq_len}));
+  auto output = expected_output.flat<float>();
+  auto alphas = expected_alphas.flat<float>();
+  output.setZero();
+  for (int b = 0; b < in.batch; ++b) {
+    std::vector<double> a = in.Alphas(b);
+    for (int t = 0; t < in.seq_len; ++t) {
+      alphas(b * in.seq_len + t) = a[t];
+      for (int j = 0; j < in.dim; ++j) {
+        output(b * in.dim + j) +=
+            a[t] * in.facts[(b * in.seq_len + t) * in.dim + j];
+      }
+    }
+  }
+  test::ExpectTensorNear<float>(expected_output, *GetOutput(0), 1e-5);
+  test::ExpectTensorNear<float>(expected_alphas, *GetOutput(1), 1e-5);
+}
+
+TEST_F(DinAttentionOpTest, GradMatchesFiniteDifferences) {
+  DinAttentionInputs in(3, 6, 4, 6, 3);
+  std::vector<float> output_grad(in.batch * in.dim);
+  std::vector<float> alphas_grad(in.batch * in.seq_len);
+  in.Fill(&output_grad, output_grad.size());
+  in.Fill(&alphas_grad, alphas_grad.size());
+
+  MakeOp("DinAttentionGrad");
+  AddInputFromArray<float>(TensorShape({in.batch, 1, in.dim}), output_grad);
+  AddInputFromArray<float>(TensorShape({in.batch, 1, in.seq_len}),
+                           alphas_grad);
+  AddInputs(in);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<std::vector<float>*> params = in.Params();
+  for (int p = 0; p < params.size(); ++p) {
+    std::vector<float>& param = *params[p];
+    auto grad = GetOutput(p)->flat<float>();
+    ASSERT_EQ(param.size(), grad.size());
+    for (int i = 0; i < param.size(); ++i) {
+      const float value = param[i];
+      const float delta = 1e-3;
+      param[i] = value + delta;
+      const double loss_plus = in.Loss(output_grad, alphas_grad);
+      param[i] = value - delta;
+      const double loss_minus = in.Loss(output_grad, alphas_grad);
+      param[i] = value;
+      EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 1e-4)
+          << "input " << p << " element " << i;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+struct DinAttentionGraphInputs {
+  DinAttentionGraphInputs(const Scope& s, int batch, int seq_len, int dim,
+                          int hidden_1, int hidden_2) {
+    auto random = [&s](const TensorShape& shape) {
+      Tensor t(DT_FLOAT, shape);
+      t.flat<float>().setRandom();
+      return ops::Const(s, Input::Initializer(t));
+    };
+    query = random({batch, dim});
+    facts = random({batch, seq_len, dim});
+    // Sequences of 3/4 of the maximum length on average.
+    Tensor sequence_mask(DT_BOOL, TensorShape({batch, seq_len}));
+    for (int b = 0; b < batch; ++b) {
+      const int length = seq_len / 2 + b % (seq_len / 2 + 1);
+      for (int t = 0; t < seq_len; ++t) {
+        sequence_mask.matrix<bool>()(b, t) = t < length;
+      }
+    }
+    mask = ops::Const(s, Input::Initializer(sequence_mask));
+    w1 = random({4 * dim, hidden_1});
+    b1 = random({hidden_1});
+    w2 = random({hidden_1, hidden_2});
+    b2 = random({hidden_2});
+    w3 = random({hidden_2, 1});
+    b3 = random({1});
+  }
+
+  Output query, facts, mask, w1, b1, w2, b2, w3, b3;
+};
+
+static Graph* FusedDinAttention(int batch, int seq_len, int dim,
+                                int hidden_1, int hidden_2) {
+  Scope s = Scope::NewRootScope();
+  DinAttentionGraphInputs in(s, batch, seq_len, dim, hidden_1, hidden_2);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  NodeBuilder builder(g->NewName("din_attention"), "DinAttention");
+  for (const Output& input : {in.query, in.facts, in.mask, in.w1, in.b1,
+                              in.w2, in.b2, in.w3, in.b3}) {
+    builder.Input(nodes[input.node()->name()]);
+  }
+  TF_CHECK_OK(builder.Finalize(g, nullptr));
+  return g;
+}
+
+// The subgraph of modelzoo/din _attention that DinAttentionFusion rewrites.
+static Graph* UnfusedDinAttention(int batch, int seq_len, int dim,
+                                  int hidden_1, int hidden_2) {
+  Scope s = Scope::NewRootScope();
+  DinAttentionGraphInputs in(s, batch, seq_len, dim, hidden_1, hidden_2);
+  auto queries = ops::Reshape(
+      s, ops::Tile(s, in.query, ops::Const(s, {1, seq_len})),
+      ops::Shape(s, in.facts));
+  auto din_all = ops::Concat(
+      s,
+      {Output(queries), in.facts, ops::Sub(s, queries, in.facts),
+       ops::Mul(s, queries, in.facts)},
+      -1);
+  auto dense = [&s](Output x, Output w, Output b) {
+    return ops::BiasAdd(s, ops::MatMul(s, x, w), b).output;
+  };
+  auto layer_1 = ops::Sigmoid(
+      s, dense(ops::Reshape(s, din_all, ops::Const(s, {-1, 4 * dim})), in.w1,
+               in.b1));
+  auto layer_2 = ops::Sigmoid(s, dense(layer_1, in.w2, in.b2));
+  auto scores = ops::Reshape(s, dense(layer_2, in.w3, in.b3),
+                             ops::Const(s, {-1, 1, seq_len}));
+  auto paddings =
+      ops::Mul(s, ops::OnesLike(s, scores), ops::Const(s, kPadding));
+  auto masked = ops::Where3(s, ops::ExpandDims(s, in.mask, 1), scores,
+                            paddings);
+  ops::BatchMatMul(s, ops::Softmax(s, masked), in.facts);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+#define BM_DIN_ATTENTION(KIND, B, T, D, NTH)                                  \
+  static void BM_##KIND##DinAttention_##B##_##T##_##D##_##NTH##_CPU(          \
+      int iters) {                                                            \
+    testing::UseRealTime();                                                   \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                   \
+    SessionOptions opts;                                                      \
+    opts.config.set_intra_op_parallelism_threads(NTH);                        \
+    test::Benchmark("cpu", KIND##DinAttention(B, T, D, 80, 40), &opts)        \
+        .Run(iters);                                                          \
+  }                                                                           \
+  BENCHMARK(BM_##KIND##DinAttention_##B##_##T##_##D##_##NTH##_CPU);
+
+#define BM_DIN_ATTENTION_NTH(B, T, D)       \
+  BM_DIN_ATTENTION(Fused, B, T, D, 1);      \
+  BM_DIN_ATTENTION(Fused, B, T, D, 8);      \
+  BM_DIN_ATTENTION(Unfused, B, T, D, 1);    \
+  BM_DIN_ATTENTION(Unfused, B, T, D, 8);
+
+// Serving (small batches) and training batches of modelzoo/din.
+BM_DIN_ATTENTION_NTH(32, 100, 36);
+BM_DIN_ATTENTION_NTH(512, 100, 36);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,183 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+
+struct DotInteractionShape {
+  int64 batch = 0;
+  int64 num_features = 0;
+  int64 dim = 0;
+  int64 dense_dim = 0;
+
+  int64 num_pairs() const { return num_features * (num_features - 1) / 2; }
+  int64 output_dim() const { return dense_dim + num_pairs(); }
+};
+
+// Checks the features and the optional dense input, which start at input
+// `first`.
+Status GetDotInteractionShape(OpKernelContext* context, int first,
+                              DotInteractionShape* shape) {
+  const Tensor& features = context->input(first);
+  if (features.dims() != 3) {
+    return errors::InvalidArgument("features must be 3-D, got ",
+                                   features.shape().DebugString());
+  }
+  shape->batch = features.dim_size(0);
+  shape->num_features = features.dim_size(1);
+  shape->dim = features.dim_size(2);
+  OpInputList dense;
+  TF_RETURN_IF_ERROR(context->input_list("dense", &dense));
+  if (dense.size() > 1) {
+    return errors::InvalidArgument("At most one dense input, got ",
+                                   dense.size());
+  }
+  shape->dense_dim = 0;
+  if (dense.size() == 1) {
+    if (dense[0].dims() != 2 || dense[0].dim_size(0) != shape->batch) {
+      return errors::InvalidArgument("dense must be [", shape->batch,
+                                     ", Dd], got ",
+                                     dense[0].shape().DebugString());
+    }
+    shape->dense_dim = dense[0].dim_size(1);
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// Fused DLRM dot interaction, see the DotInteraction op. Only the strictly
+// lower triangle of features[b] features[b]^T is computed, one row at a
+// time straight into the packed output, so neither the [B, F, F] products
+// nor the mask and gather of the unfused graph are materialized.
+template <typename T>
+class DotInteractionOp : public OpKernel {
+ public:
+  explicit DotInteractionOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    DotInteractionShape shape;
+    OP_REQUIRES_OK(context, GetDotInteractionShape(context, 0, &shape));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({shape.batch,
+                                                shape.output_dim()}),
+                                &output_tensor));
+    if (output_tensor->NumElements() == 0) return;
+    const T* features = context->input(0).flat<T>().data();
+    const T* dense = shape.dense_dim > 0
+                         ? context->input(1).flat<T>().data()
+                         : nullptr;
+    T* output = output_tensor->flat<T>().data();
+
+    const int64 f = shape.num_features;
+    const int64 d = shape.dim;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost = shape.num_pairs() * (2 * d + 1) + shape.dense_dim;
+    worker_threads.workers->ParallelFor(
+        shape.batch, cost, [&](int64 begin, int64 end) {
+          for (int64 b = begin; b < end; ++b) {
+            T* out = output + b * shape.output_dim();
+            std::copy_n(dense + b * shape.dense_dim, shape.dense_dim, out);
+            out += shape.dense_dim;
+            ConstMatrixMap x(features + b * f * d, f, d);
+            for (int64 i = 1; i < f; ++i) {
+              Eigen::Map<Eigen::VectorXf>(out + i * (i - 1) / 2, i)
+                  .noalias() = x.topRows(i) * x.row(i).transpose();
+            }
+          }
+        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DotInteraction").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DotInteractionOp<float>);
+
+// Gradients of DotInteraction. The packed gradient of the pairs is unpacked
+// into the lower triangle of a symmetric [F, F] matrix G with a zero
+// diagonal, and features_grad[b] = G features[b].
+template <typename T>
+class DotInteractionGradOp : public OpKernel {
+ public:
+  explicit DotInteractionGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    DotInteractionShape shape;
+    OP_REQUIRES_OK(context, GetDotInteractionShape(context, 1, &shape));
+    const Tensor& output_grad = context->input(0);
+    OP_REQUIRES(context,
+                output_grad.dims() == 2 &&
+                    output_grad.dim_size(0) == shape.batch &&
+                    output_grad.dim_size(1) == shape.output_dim(),
+                errors::InvalidArgument("output_grad must be [", shape.batch,
+                                        ", ", shape.output_dim(), "], got ",
+                                        output_grad.shape().DebugString()));
+
+    Tensor* features_grad_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, context->input(1).shape(),
+                                            &features_grad_tensor));
+    OpOutputList dense_grad_list;
+    OP_REQUIRES_OK(context,
+                   context->output_list("dense_grad", &dense_grad_list));
+    T* dense_grad = nullptr;
+    if (dense_grad_list.size() == 1) {
+      Tensor* dense_grad_tensor = nullptr;
+      OP_REQUIRES_OK(context,
+                     dense_grad_list.allocate(0, context->input(2).shape(),
+                                              &dense_grad_tensor));
+      dense_grad = dense_grad_tensor->flat<T>().data();
+    }
+    if (shape.batch == 0) return;
+    const T* grad = output_grad.flat<T>().data();
+    const T* features = context->input(1).flat<T>().data();
+    T* features_grad = features_grad_tensor->flat<T>().data();
+
+    const int64 f = shape.num_features;
+    const int64 d = shape.dim;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost = f * f * (2 * d + 1) + shape.dense_dim;
+    worker_threads.workers->ParallelFor(
+        shape.batch, cost, [&](int64 begin, int64 end) {
+          // Only the lower triangle of G is read.
+          Matrix g = Matrix::Zero(f, f);
+          for (int64 b = begin; b < end; ++b) {
+            const T* grad_row = grad + b * shape.output_dim();
+            std::copy_n(grad_row, shape.dense_dim,
+                        dense_grad + b * shape.dense_dim);
+            grad_row += shape.dense_dim;
+            for (int64 i = 1; i < f; ++i) {
+              std::copy_n(grad_row + i * (i - 1) / 2, i, g.row(i).data());
+            }
+            MatrixMap(features_grad + b * f * d, f, d).noalias() =
+                g.selfadjointView<Eigen::Lower>() *
+                ConstMatrixMap(features + b * f * d, f, d);
+          }
+        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("DotInteractionGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    DotInteractionGradOp<float>);
+
+}  // namespace tensorflow
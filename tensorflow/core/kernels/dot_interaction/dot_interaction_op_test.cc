@@ -0,0 +1,230 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+struct DotInteractionInputs {
+  DotInteractionInputs(int batch, int num_features, int dim, int dense_dim)
+      : batch(batch), num_features(num_features), dim(dim),
+        dense_dim(dense_dim) {
+    Fill(&features, batch * num_features * dim);
+    Fill(&dense, batch * dense_dim);
+  }
+
+  void Fill(std::vector<float>* v, int n) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = std::sin(0.37f * i + 0.11f * n);
+    }
+  }
+
+  int output_dim() const {
+    return dense_dim + num_features * (num_features - 1) / 2;
+  }
+
+  // The unfused computation: the dense features, then the lower triangle
+  // of the products in row major order.
+  std::vector<double> Output() const {
+    std::vector<double> output;
+    for (int b = 0; b < batch; ++b) {
+      for (int j = 0; j < dense_dim; ++j) {
+        output.push_back(dense[b * dense_dim + j]);
+      }
+      const float* x = &features[b * num_features * dim];
+      for (int i = 0; i < num_features; ++i) {
+        for (int j = 0; j < i; ++j) {
+          double dot = 0;
+          for (int k = 0; k < dim; ++k) dot += x[i * dim + k] * x[j * dim + k];
+          output.push_back(dot);
+        }
+      }
+    }
+    return output;
+  }
+
+  // sum(output * output_grad).
+  double Loss(const std::vector<float>& output_grad) const {
+    std::vector<double> output = Output();
+    double loss = 0;
+    for (int i = 0; i < output.size(); ++i) loss += output[i] * output_grad[i];
+    return loss;
+  }
+
+  int batch, num_features, dim, dense_dim;
+  std::vector<float> features, dense;
+};
+
+class DotInteractionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const DotInteractionInputs& in) {
+    const int num_dense = in.dense_dim > 0 ? 1 : 0;
+    NodeDefBuilder builder("dot_interaction", op);
+    if (op == "DotInteractionGrad") builder.Input(FakeInput(DT_FLOAT));
+    TF_EXPECT_OK(builder.Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(num_dense, DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("num_dense", num_dense)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const DotInteractionInputs& in) {
+    AddInputFromArray<float>(
+        TensorShape({in.batch, in.num_features, in.dim}), in.features);
+    if (in.dense_dim > 0) {
+      AddInputFromArray<float>(TensorShape({in.batch, in.dense_dim}),
+                               in.dense);
+    }
+  }
+
+  void ExpectMatchesUnfused(const DotInteractionInputs& in) {
+    MakeOp("DotInteraction", in);
+    AddInputs(in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({in.batch, in.output_dim()}));
+    std::vector<double> output = in.Output();
+    for (int i = 0; i < output.size(); ++i) {
+      expected.flat<float>()(i) = output[i];
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  }
+
+  void ExpectGradMatchesFiniteDifferences(DotInteractionInputs in) {
+    std::vector<float> output_grad(in.batch * in.output_dim());
+    in.Fill(&output_grad, output_grad.size());
+    MakeOp("DotInteractionGrad", in);
+    AddInputFromArray<float>(TensorShape({in.batch, in.output_dim()}),
+                             output_grad);
+    AddInputs(in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<std::vector<float>*> params = {&in.features};
+    if (in.dense_dim > 0) params.push_back(&in.dense);
+    for (int p = 0; p < params.size(); ++p) {
+      std::vector<float>& param = *params[p];
+      auto grad = GetOutput(p)->flat<float>();
+      ASSERT_EQ(param.size(), grad.size());
+      for (int i = 0; i < param.size(); ++i) {
+        const float value = param[i];
+        const float delta = 1e-3;
+        param[i] = value + delta;
+        const double loss_plus = in.Loss(output_grad);
+        param[i] = value - delta;
+        const double loss_minus = in.Loss(output_grad);
+        param[i] = value;
+        EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 1e-3)
+            << "input " << p << " element " << i;
+      }
+    }
+  }
+};
+
+TEST_F(DotInteractionOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(DotInteractionInputs(3, 7, 5, 0));
+}
+
+TEST_F(DotInteractionOpTest, MatchesUnfusedWithDense) {
+  ExpectMatchesUnfused(DotInteractionInputs(3, 7, 5, 5));
+}
+
+TEST_F(DotInteractionOpTest, GradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(DotInteractionInputs(2, 5, 4, 0));
+}
+
+TEST_F(DotInteractionOpTest, GradMatchesFiniteDifferencesWithDense) {
+  ExpectGradMatchesFiniteDifferences(DotInteractionInputs(2, 5, 4, 4));
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+static Graph* FusedDotInteraction(int batch, int num_features, int dim) {
+  Scope s = Scope::NewRootScope();
+  Output features = RandomConst(s, {batch, num_features, dim});
+  Output dense = RandomConst(s, {batch, dim});
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("dot_interaction"), "DotInteraction")
+          .Input(nodes[features.node()->name()])
+          .Input(std::vector<NodeBuilder::NodeOut>{
+              NodeBuilder::NodeOut(nodes[dense.node()->name()])})
+          .Attr("num_dense", 1)
+          .Finalize(g, nullptr));
+  return g;
+}
+
+// _dot_op of modelzoo/dlrm and the concat with the dense features.
+static Graph* UnfusedDotInteraction(int batch, int num_features, int dim) {
+  Scope s = Scope::NewRootScope();
+  Output features = RandomConst(s, {batch, num_features, dim});
+  Output dense = RandomConst(s, {batch, dim});
+  auto products = ops::BatchMatMul(s, features, features,
+                                   ops::BatchMatMul::AdjY(true));
+  auto ones = ops::OnesLike(s, products);
+  auto lower = ops::Cast(
+      s, ops::Sub(s, ones, ops::MatrixBandPart(s, ones, 0, -1)), DT_BOOL);
+  auto indices = ops::Squeeze(
+      s, ops::Where(s, ops::Reshape(s, lower, {-1})),
+      ops::Squeeze::Axis({1}));
+  auto pairs = ops::GatherV2(s, ops::Reshape(s, products, {-1}), indices, 0);
+  ops::Concat(
+      s,
+      {dense, ops::Reshape(s, pairs,
+                           {batch, num_features * (num_features - 1) / 2})},
+      1);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+#define BM_DOT_INTERACTION(KIND, B, F, D, NTH)                               \
+  static void BM_##KIND##DotInteraction_##B##_##F##_##D##_##NTH##_CPU(       \
+      int iters) {                                                           \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                  \
+    SessionOptions opts;                                                     \
+    opts.config.set_intra_op_parallelism_threads(NTH);                       \
+    test::Benchmark("cpu", KIND##DotInteraction(B, F, D), &opts).Run(iters); \
+  }                                                                          \
+  BENCHMARK(BM_##KIND##DotInteraction_##B##_##F##_##D##_##NTH##_CPU);
+
+#define BM_DOT_INTERACTION_NTH(B, F, D)       \
+  BM_DOT_INTERACTION(Fused, B, F, D, 1);      \
+  BM_DOT_INTERACTION(Fused, B, F, D, 8);      \
+  BM_DOT_INTERACTION(Unfused, B, F, D, 1);    \
+  BM_DOT_INTERACTION(Unfused, B, F, D, 8);
+
+// modelzoo/dlrm: 26 sparse features and the bottom MLP output of size 16.
+BM_DOT_INTERACTION_NTH(512, 27, 16);
+BM_DOT_INTERACTION_NTH(4096, 27, 16);
+// Larger embeddings.
+BM_DOT_INTERACTION_NTH(4096, 27, 128);
+
+}  // namespace
+}  // namespace tensorflow
@@ -24,6 +24,8 @@
 #include "tensorflow/core/kernels/embedding_variable_test.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -37,7 +39,11 @@
 #include <time.h>
 #include <sys/resource.h>
 #include "tensorflow/core/framework/embedding/kv_interface.h"
+#include "tensorflow/core/framework/embedding/background_executor.h"
 #include "tensorflow/core/framework/embedding/cache.h"
+#include "tensorflow/core/framework/embedding/heavy_hitter_sketch.h"
+#include "tensorflow/core/framework/embedding/memory_governor.h"
+#include "tensorflow/core/framework/embedding/ssd_value_codec.h"
 #include "tensorflow/core/kernels/kv_variable_ops.h"
 #ifdef TENSORFLOW_USE_JEMALLOC
 #include "jemalloc/jemalloc.h"
@@ -1236,6 +1242,46 @@ void TestCompaction() {
   delete hashmap;
 }
 
+TEST(KVInterfaceTest, TestLevelDBBatchLookup) {
+  auto feat_desc = new embedding::FeatureDescriptor<float>(
+      1, 1, ev_allocator(), embedding::StorageType::DRAM_LEVELDB,
+      true, true, {false, 0});
+  feat_desc->InitSlotInfo(0, 4, {nullptr, 1});
+  auto leveldb_kv = new LevelDBKV<int64, float>(testing::TmpDir(), feat_desc);
+  std::vector<int64> keys = {300, 2, 1 << 20, 7};
+  std::vector<void*> value_ptrs;
+  for (int64 key : keys) {
+    void* value_ptr = feat_desc->Allocate();
+    float* v = feat_desc->GetEmbedding(value_ptr, 0);
+    for (int j = 0; j < 4; j++) {
+      v[j] = key + j;
+    }
+    value_ptrs.emplace_back(value_ptr);
+  }
+  TF_ASSERT_OK(leveldb_kv->BatchWrite(keys, value_ptrs));
+  for (auto value_ptr : value_ptrs) {
+    feat_desc->Deallocate(value_ptr);
+  }
+
+  std::vector<int64> lookup_keys = {7, 5, 1 << 20, 2, 300};
+  std::vector<void*> lookup_ptrs(lookup_keys.size());
+  TF_ASSERT_OK(leveldb_kv->BatchLookup(lookup_keys.data(), lookup_keys.size(),
+                                       lookup_ptrs.data()));
+  for (int i = 0; i < lookup_keys.size(); i++) {
+    if (lookup_keys[i] == 5) {
+      ASSERT_EQ(lookup_ptrs[i], nullptr);
+      continue;
+    }
+    float* v = feat_desc->GetEmbedding(lookup_ptrs[i], 0);
+    for (int j = 0; j < 4; j++) {
+      ASSERT_EQ(v[j], lookup_keys[i] + j);
+    }
+    feat_desc->Deallocate(lookup_ptrs[i]);
+  }
+  delete leveldb_kv;
+  delete feat_desc;
+}
+
 TEST(KVInterfaceTest, TestSSDKVAsyncCompaction) {
   setenv("TF_SSDHASH_ASYNC_COMPACTION", "true", 1);
   TestCompaction();
@@ -1292,6 +1338,286 @@ TEST(KVInterfaceTest, TestDirectIoFile) {
 }
 
 
+void WriteCgroupFile(const string& dir, const string& name,
+                     const string& content) {
+  TF_CHECK_OK(WriteStringToFile(Env::Default(),
+                                io::JoinPath(dir, name), content));
+}
+
+TEST(EmbeddingVariableTest, TestMemoryGovernorCgroupV2) {
+  std::string dir = io::JoinPath(testing::TmpDir(), "cgroup_v2");
+  TF_CHECK_OK(Env::Default()->RecursivelyCreateDir(dir));
+  WriteCgroupFile(dir, "memory.max", "1000\n");
+  WriteCgroupFile(dir, "memory.current", "900\n");
+  WriteCgroupFile(dir, "memory.stat", "anon 700\ninactive_file 200\n");
+
+  MemoryGovernor::Options options;
+  options.cgroup_path = dir;
+  options.low_watermark = 0.6;
+  options.high_watermark = 0.8;
+  options.eviction_fraction = 0.5;
+  options.background_refresh = false;
+  MemoryGovernor governor(options);
+  ASSERT_TRUE(governor.enabled());
+  // Inactive page cache isn't counted, 700 / 1000 is between watermarks.
+  ASSERT_EQ(governor.usage_bytes(), 700);
+  ASSERT_EQ(governor.limit_bytes(), 1000);
+  ASSERT_EQ(governor.pressure(), MemoryGovernor::kLow);
+  ASSERT_EQ(governor.ShrinkTarget(1000, 100), 75);
+  ASSERT_EQ(governor.ShrinkTarget(50, 100), 50);
+  ASSERT_EQ(governor.AdmissionFreq(3), 3);
+
+  uint64 epoch = governor.epoch();
+  WriteCgroupFile(dir, "memory.stat", "anon 900\ninactive_file 0\n");
+  governor.Refresh();
+  ASSERT_GT(governor.epoch(), epoch);
+  ASSERT_EQ(governor.pressure(), MemoryGovernor::kHigh);
+  ASSERT_EQ(governor.ShrinkTarget(1000, 100), 50);
+  ASSERT_EQ(governor.AdmissionFreq(3), 6);
+
+  WriteCgroupFile(dir, "memory.current", "100\n");
+  governor.Refresh();
+  ASSERT_EQ(governor.pressure(), MemoryGovernor::kNone);
+  ASSERT_EQ(governor.ShrinkTarget(1000, 100), 1000);
+  ASSERT_EQ(governor.AdmissionFreq(3), 3);
+}
+
+TEST(EmbeddingVariableTest, TestMemoryGovernorCgroupV1) {
+  std::string dir = io::JoinPath(testing::TmpDir(), "cgroup_v1");
+  TF_CHECK_OK(Env::Default()->RecursivelyCreateDir(dir));
+  WriteCgroupFile(dir, "memory.limit_in_bytes", "9223372036854771712\n");
+  WriteCgroupFile(dir, "memory.usage_in_bytes", "500\n");
+
+  MemoryGovernor::Options options;
+  options.cgroup_path = dir;
+  options.background_refresh = false;
+  // Without a limit the governor stays disabled.
+  ASSERT_FALSE(MemoryGovernor(options).enabled());
+
+  options.limit_bytes = 1000;
+  MemoryGovernor governor(options);
+  ASSERT_TRUE(governor.enabled());
+  ASSERT_EQ(governor.usage_bytes(), 500);
+  ASSERT_EQ(governor.pressure(), MemoryGovernor::kNone);
+
+  options.enable = false;
+  ASSERT_FALSE(MemoryGovernor(options).enabled());
+}
+
+TEST(EmbeddingVariableTest, TestBackgroundExecutorPriority) {
+  BackgroundExecutor::Options options;
+  options.num_threads = 1;
+  BackgroundExecutor executor(options);
+  mutex mu;
+  std::vector<string> order;
+  auto record = [&mu, &order](const string& name) {
+    mutex_lock l(mu);
+    order.push_back(name);
+  };
+
+  executor.Pause();
+  executor.Schedule(BackgroundTaskClass::kStats,
+                    [&record]() { record("stats"); });
+  executor.Schedule(BackgroundTaskClass::kCompaction,
+                    [&record]() { record("compaction"); });
+  executor.Schedule(BackgroundTaskClass::kEviction,
+                    [&record]() { record("eviction"); });
+  // Prefetch tasks still run while paused.
+  Notification prefetched;
+  executor.Schedule(BackgroundTaskClass::kPrefetch, [&]() {
+    record("prefetch");
+    prefetched.Notify();
+  });
+  prefetched.WaitForNotification();
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kStats).queue_depth, 1);
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kPrefetch).tasks_run, 1);
+
+  BlockingCounter done(4);
+  executor.ScheduleAfter(BackgroundTaskClass::kStats, 20 * 1000,
+                         [&]() { record("delayed"); done.DecrementCount(); });
+  for (auto cls : {BackgroundTaskClass::kStats,
+                   BackgroundTaskClass::kCompaction,
+                   BackgroundTaskClass::kEviction}) {
+    executor.Schedule(cls, [&done]() { done.DecrementCount(); });
+  }
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kStats).queue_depth, 3);
+  executor.Resume();
+  done.Wait();
+  std::vector<string> expected = {"prefetch", "eviction", "compaction",
+                                  "stats", "delayed"};
+  ASSERT_EQ(order, expected);
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kEviction).tasks_run, 2);
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kStats).queue_depth, 0);
+}
+
+TEST(EmbeddingVariableTest, TestBackgroundStrandPause) {
+  BackgroundExecutor::Options options;
+  options.num_threads = 1;
+  BackgroundExecutor executor(options);
+  BackgroundStrand strand(&executor);
+  std::vector<string> order;
+  BlockingCounter done(3);
+  Notification prefetched;
+  {
+    BackgroundPauseScope pause(&executor);
+    strand.Schedule(BackgroundTaskClass::kPrefetch, [&]() {
+      order.push_back("prefetch");
+      prefetched.Notify();
+      done.DecrementCount();
+    });
+    prefetched.WaitForNotification();
+    // The strand waits at its stats task, the prefetch task behind it
+    // keeps its place.
+    strand.Schedule(BackgroundTaskClass::kStats, [&]() {
+      order.push_back("stats");
+      done.DecrementCount();
+    });
+    strand.Schedule(BackgroundTaskClass::kPrefetch, [&]() {
+      order.push_back("prefetch");
+      done.DecrementCount();
+    });
+    while (executor.GetStats(BackgroundTaskClass::kStats).queue_depth == 0) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    Env::Default()->SleepForMicroseconds(20 * 1000);
+    ASSERT_EQ(order.size(), 1);
+  }
+  done.Wait();
+  std::vector<string> expected = {"prefetch", "stats", "prefetch"};
+  ASSERT_EQ(order, expected);
+  ASSERT_EQ(executor.GetStats(BackgroundTaskClass::kStats).tasks_run, 1);
+}
+
+TEST(EmbeddingVariableTest, TestBackgroundStrandOrder) {
+  BackgroundExecutor::Options options;
+  options.num_threads = 4;
+  BackgroundExecutor executor(options);
+  const BackgroundTaskClass classes[] = {BackgroundTaskClass::kStats,
+                                         BackgroundTaskClass::kPrefetch};
+  constexpr int kNumTasks = 1000;
+  std::vector<int> order;
+  BlockingCounter done(kNumTasks);
+  {
+    BackgroundStrand strand(&executor);
+    for (int i = 0; i < kNumTasks; ++i) {
+      // No lock, tasks of a strand never run concurrently.
+      strand.Schedule(classes[i % 2], [&order, &done, i]() {
+        order.push_back(i);
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  ASSERT_EQ(order.size(), kNumTasks);
+  for (int i = 0; i < kNumTasks; ++i) {
+    ASSERT_EQ(order[i], i);
+  }
+}
+
+TEST(EmbeddingVariableTest, TestHeavyHitterSketch) {
+  HeavyHitterSketch sketch(3);
+  std::vector<int64> ids = {1, 2, 3};
+  std::vector<int64> counts = {5, 3, 1};
+  sketch.Add(ids.data(), counts.data(), ids.size());
+  // Replaces id 3, the new id inherits its count as error.
+  int32 new_id = 4;
+  sketch.Add(&new_id, nullptr, 1);
+
+  HeavyHitterReport report;
+  sketch.Report(2, {0.5, 0.8, 1.0}, &report);
+  ASSERT_EQ(report.total, 10);
+  ASSERT_EQ(report.ids, std::vector<int64>({1, 2}));
+  ASSERT_EQ(report.freqs, std::vector<int64>({5, 3}));
+  // Guaranteed counts 5, 3 and 1 cover only 9 of 10 lookups.
+  ASSERT_EQ(report.working_set_sizes, std::vector<int64>({1, 2, -1}));
+
+  HeavyHitterSketch other(3);
+  int64 id = 2;
+  int64 count = 4;
+  other.Add(&id, &count, 1);
+  HeavyHitterSketch unrelated(3);
+  unrelated.Add(&id, &count, 1);
+
+  HeavyHitterRegistry* registry = HeavyHitterRegistry::Global();
+  registry->Register("emb/part_0", &sketch);
+  registry->Register("emb/part_1", &other);
+  registry->Register("emb_other", &unrelated);
+  HeavyHitterSketch merged(3);
+  ASSERT_TRUE(registry->Merge("emb", &merged));
+  merged.Report(3, {1.0}, &report);
+  ASSERT_EQ(report.total, 14);
+  ASSERT_EQ(report.ids, std::vector<int64>({2, 1, 4}));
+  ASSERT_EQ(report.freqs, std::vector<int64>({7, 5, 2}));
+  ASSERT_EQ(report.working_set_sizes, std::vector<int64>({-1}));
+
+  registry->Unregister("emb/part_0", &sketch);
+  registry->Unregister("emb/part_1", &other);
+  registry->Unregister("emb_other", &unrelated);
+  ASSERT_FALSE(registry->Merge("emb", &merged));
+}
+
+TEST(EmbeddingVariableTest, TestSsdValueCodec) {
+  // An embedding of 100 values and an accumulator slot of 20 values,
+  // followed by the frequency and version.
+  const std::vector<int64> slot_dims = {100, 20};
+  const int64 value_dim = 120;
+  const int64 row_bytes = value_dim * sizeof(float) + 2 * sizeof(int64);
+  std::vector<char> row(row_bytes);
+  float* values = reinterpret_cast<float*>(row.data());
+  for (int64 i = 0; i < 100; ++i) {
+    values[i] = (i - 50) * 0.01f;
+  }
+  // Accumulators can be far out of the range of the embedding values.
+  for (int64 i = 100; i < value_dim; ++i) {
+    values[i] = 1e5f + i;
+  }
+  int64* tail = reinterpret_cast<int64*>(values + value_dim);
+  tail[0] = 7;
+  tail[1] = 123456789;
+
+  SsdValueCodec<float> raw(SsdValueCodecType::kRaw, slot_dims, row_bytes);
+  SsdValueCodec<float> fp16(SsdValueCodecType::kFp16, slot_dims, row_bytes);
+  SsdValueCodec<float> int8(SsdValueCodecType::kInt8, slot_dims, row_bytes);
+  ASSERT_EQ(raw.record_bytes(), row_bytes);
+  // The accumulators are kept as floats.
+  ASSERT_EQ(fp16.record_bytes(), 100 * 2 + 20 * 4 + 16);
+  // Two groups of the embedding and one of the accumulator, with a float
+  // minimum and scale each.
+  ASSERT_EQ(int8.record_bytes(), 3 * 8 + value_dim + 16);
+
+  for (auto codec : {raw, fp16, int8}) {
+    std::vector<char> record(codec.record_bytes());
+    std::vector<char> decoded(row_bytes);
+    codec.Encode(row.data(), record.data());
+    codec.Decode(record.data(), decoded.data());
+    const float* decoded_values = reinterpret_cast<float*>(decoded.data());
+    for (int64 i = 0; i < 100; ++i) {
+      ASSERT_NEAR(decoded_values[i], values[i], 5e-3);
+    }
+    // Quantizing the accumulator separately keeps its precision.
+    for (int64 i = 100; i < value_dim; ++i) {
+      ASSERT_NEAR(decoded_values[i], values[i], 0.1);
+    }
+    const int64* decoded_tail =
+        reinterpret_cast<const int64*>(decoded_values + value_dim);
+    ASSERT_EQ(decoded_tail[0], 7);
+    ASSERT_EQ(decoded_tail[1], 123456789);
+  }
+
+  // fp16 clamps embedding values to its finite range.
+  values[0] = 1e6f;
+  std::vector<char> record(fp16.record_bytes());
+  fp16.Encode(row.data(), record.data());
+  fp16.Decode(record.data(), row.data());
+  ASSERT_EQ(values[0], 65504.0f);
+
+  // Lossy codecs only apply to float values.
+  SsdValueCodec<double> fallback(SsdValueCodecType::kInt8, {value_dim},
+                                 value_dim * sizeof(double));
+  ASSERT_TRUE(fallback.is_raw());
+  ASSERT_EQ(fallback.record_bytes(), value_dim * sizeof(double));
+}
+
 void InsertKey(EmbeddingVar<int64, float>* variable, int value_size) {
   float *val = (float *)malloc((value_size+1)*sizeof(float));
   for (int64 i = 0; i < 100000000; i++) {
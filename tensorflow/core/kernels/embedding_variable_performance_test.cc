@@ -473,5 +473,89 @@ TEST(EmbeddingVariablePerformaceTest, TestCounterFilterLookupOrCreate) {
     }
   }
 }
+
+double PerfLevelDBLookup(LevelDBKV<int64, float>* leveldb_kv,
+                         const std::vector<int64>& input_batch,
+                         int num_thread, bool use_batch_lookup) {
+  std::vector<void*> value_ptrs(input_batch.size(), nullptr);
+  std::vector<int64> sorted_batch(input_batch);
+  std::sort(sorted_batch.begin(), sorted_batch.end());
+  std::vector<std::thread> worker_threads(num_thread);
+  timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < num_thread; i++) {
+    int st = input_batch.size() / num_thread * i;
+    int ed = (i == num_thread - 1) ?
+        input_batch.size() : input_batch.size() / num_thread * (i + 1);
+    worker_threads[i] = std::thread([&, st, ed]() {
+      if (use_batch_lookup) {
+        leveldb_kv->BatchLookup(sorted_batch.data() + st, ed - st,
+                                value_ptrs.data() + st);
+      } else {
+        for (int j = st; j < ed; j++) {
+          leveldb_kv->Lookup(input_batch[j], &value_ptrs[j]);
+        }
+      }
+    });
+  }
+  for (int i = 0; i < num_thread; i++) {
+    worker_threads[i].join();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  for (auto value_ptr: value_ptrs) {
+    if (value_ptr == nullptr) {
+      LOG(INFO)<<"Value Error: missing value in LevelDB.";
+      return -1.0;
+    }
+    leveldb_kv->FreeValuePtr(value_ptr);
+  }
+  return (double)(end.tv_sec - start.tv_sec) *
+         1000000000 + end.tv_nsec - start.tv_nsec;
+}
+
+TEST(EmbeddingVariablePerformanceTest, TestLevelDBLookup) {
+  int num_of_ids = 1000000;
+  int batch_size = 1024 * 128;
+  int value_size = 32;
+  auto feat_desc = new embedding::FeatureDescriptor<float>(
+      1, 1, ev_allocator(), embedding::StorageType::DRAM_LEVELDB,
+      true, true, {false, 0});
+  feat_desc->InitSlotInfo(0, value_size, {nullptr, 1});
+  auto leveldb_kv = new LevelDBKV<int64, float>(testing::TmpDir(), feat_desc);
+
+  LOG(INFO)<<"[TestLevelDBLookup] Start initializing LevelDB.";
+  std::vector<int64> ids;
+  std::vector<void*> value_ptrs;
+  for (int64 i = 0; i < num_of_ids; i++) {
+    ids.emplace_back(i);
+    value_ptrs.emplace_back(feat_desc->Allocate());
+    if (ids.size() == batch_size || i == num_of_ids - 1) {
+      TF_CHECK_OK(leveldb_kv->BatchWrite(ids, value_ptrs));
+      for (auto value_ptr: value_ptrs) {
+        feat_desc->Deallocate(value_ptr);
+      }
+      ids.clear();
+      value_ptrs.clear();
+    }
+  }
+
+  std::vector<int64> input_batch(batch_size);
+  srand((unsigned)time(NULL));
+  for (int i = 0; i < batch_size; i++) {
+    input_batch[i] = rand() % num_of_ids;
+  }
+  std::vector<int> num_thread_vec({1, 2, 4, 8, 16});
+  for (auto num_thread: num_thread_vec) {
+    double lookup_time =
+        PerfLevelDBLookup(leveldb_kv, input_batch, num_thread, false);
+    double batch_lookup_time =
+        PerfLevelDBLookup(leveldb_kv, input_batch, num_thread, true);
+    LOG(INFO)<<"[TestLevelDBLookup] Performance of Lookup With "
+             <<num_thread<<" threads: "<<lookup_time/1000000<<" ms"
+             <<", BatchLookup: "<<batch_lookup_time/1000000<<" ms";
+  }
+  delete leveldb_kv;
+  delete feat_desc;
+}
 } //namespace embedding
 } //namespace tensorflow
@@ -0,0 +1,499 @@
+#ifndef TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_FUSED_LAYER_NORM_H_
+#define TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_FUSED_LAYER_NORM_H_
+
+#include <cmath>
+
+#include "tensorflow/core/kernels/fused_layer_norm/compile_util.h"
+
+// The row kernels of FusedLayerNorm and FusedLayerNormGrad, shared with the
+// fused ops that end with a layer normalization, e.g. MaskBlock.
+
+// Compute the rows locate in the range of [begin_row, end_row) of the
+// [rows, cols] input:
+//   output = gamma * (input - mean) * rvariance + beta
+// with rvariance = 1 / sqrt(variance + epsilon). mean and rvariance must be
+// zeros, as they are accumulated.
+inline void layer_norm_forward(const float* input, const float* gamma,
+                               const float* beta, float* output, float* mean,
+                               float* rvariance, int64 cols, int64 begin_row,
+                               int64 end_row, float epsilon) {
+  const float one_over_cols = 1.0f / cols;
+  for (int64 i = begin_row; i < end_row; i++){
+    // Sum
+    int64 j = 0;
+    for (; j + 7 < cols; j += 8) {
+      float data_0 = input[i * cols + j];
+      float data_1 = input[i * cols + j + 1];
+      float data_2 = input[i * cols + j + 2];
+      float data_3 = input[i * cols + j + 3];
+      float data_4 = input[i * cols + j + 4];
+      float data_5 = input[i * cols + j + 5];
+      float data_6 = input[i * cols + j + 6];
+      float data_7 = input[i * cols + j + 7];
+      mean[i] += data_0 + data_1 + data_2 + data_3 +
+                 data_4 + data_5 + data_6 + data_7;
+    }
+    for (; j < cols; j++) {
+      mean[i] += input[i * cols + j];
+    }
+    // Mean
+    mean[i] *= one_over_cols;
+
+    // variance
+    for (j = 0; j + 7 < cols; j += 8) {
+      float data_0 = input[i * cols + j] - mean[i];
+      float data_1 = input[i * cols + j + 1] - mean[i];
+      float data_2 = input[i * cols + j + 2] - mean[i];
+      float data_3 = input[i * cols + j + 3] - mean[i];
+      float data_4 = input[i * cols + j + 4] - mean[i];
+      float data_5 = input[i * cols + j + 5] - mean[i];
+      float data_6 = input[i * cols + j + 6] - mean[i];
+      float data_7 = input[i * cols + j + 7] - mean[i];
+      rvariance[i] += data_0 * data_0 + data_1 * data_1 + data_2 * data_2 +
+                 data_3 * data_3 + data_4 * data_4 + data_5 * data_5 +
+                 data_6 * data_6 + data_7 * data_7;
+    }
+    for (; j < cols; j++) {
+      float data = input[i * cols + j] - mean[i];
+      rvariance[i] += data * data;
+    }
+    rvariance[i] *= one_over_cols;
+    rvariance[i] += epsilon;
+    rvariance[i] = 1.0f / sqrtf(rvariance[i]);
+
+    for (j = 0; j + 7 < cols; j += 8) {
+      float data_0 = (input[i * cols + j] - mean[i]) * rvariance[i];
+      float data_1 = (input[i * cols + j + 1] - mean[i]) * rvariance[i];
+      float data_2 = (input[i * cols + j + 2] - mean[i]) * rvariance[i];
+      float data_3 = (input[i * cols + j + 3] - mean[i]) * rvariance[i];
+      float data_4 = (input[i * cols + j + 4] - mean[i]) * rvariance[i];
+      float data_5 = (input[i * cols + j + 5] - mean[i]) * rvariance[i];
+      float data_6 = (input[i * cols + j + 6] - mean[i]) * rvariance[i];
+      float data_7 = (input[i * cols + j + 7] - mean[i]) * rvariance[i];
+      output[i * cols + j] = gamma[j] * data_0 + beta[j];
+      output[i * cols + j + 1] =  gamma[j + 1] * data_1 + beta[j + 1];
+      output[i * cols + j + 2] =  gamma[j + 2] * data_2 + beta[j + 2];
+      output[i * cols + j + 3] =  gamma[j + 3] * data_3 + beta[j + 3];
+      output[i * cols + j + 4] =  gamma[j + 4] * data_4 + beta[j + 4];
+      output[i * cols + j + 5] =  gamma[j + 5] * data_5 + beta[j + 5];
+      output[i * cols + j + 6] =  gamma[j + 6] * data_6 + beta[j + 6];
+      output[i * cols + j + 7] =  gamma[j + 7] * data_7 + beta[j + 7];
+    }
+    for (; j < cols; j ++) {
+      float data = (input[i * cols + j] - mean[i]) * rvariance[i];
+      output[i * cols + j] = gamma[j] * data + beta[j];
+    }
+  }
+}
+
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+// AVX512 block size = 8; pack 8 * 16 = 128;
+inline void layer_norm_forward_avx512(const float* input, const float* gamma,
+                                      const float* beta, float* output,
+                                      float* mean, float* rvariance,
+                                      int64 cols, int64 begin_row,
+                                      int64 end_row, float epsilon) {
+  const int64 block_num = cols >> 7;
+  const int64 remainder_128 = cols & 0x7F;
+  const int64 remainder_16 = remainder_128 & 0x0F;
+  const int64 remainder_block_num = remainder_128 >> 4;
+  const int64 remainder_block_num_total = remainder_block_num + !!remainder_16;
+  const float one_over_cols = 1.0f / cols;
+  for (int64 i = begin_row; i < end_row; ++i) {
+    // Sum
+    for (int64 j = 0; j < block_num; ++j) {
+    __m512 inputs[8];
+    auto load = [&](auto idx) {
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+      };
+    compile_time_for<8>::op(load);
+    __m512 block_sum = reduce_sum_block<8>(inputs);
+    mean[i] += _mm512_reduce_add_ps(block_sum);
+    }
+    if (remainder_block_num_total) { // remainder sum
+      __m512 inputs[remainder_block_num_total];
+      for (int64 idx = 0; idx < remainder_block_num; idx++){
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+      }
+      if (remainder_16) {
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
+            mask, input + cols * i + cols - remainder_16);
+      }
+      __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
+      mean[i] += _mm512_reduce_add_ps(block_sum);
+    }
+
+    // Mean
+    mean[i] *= one_over_cols;
+    __m512 means = _mm512_set1_ps(mean[i]);
+
+    // Variance
+    for (int64 j = 0; j < block_num; ++j) {
+      __m512 inputs[8];
+      auto load_var = [&](auto idx) {
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
+      };
+      compile_time_for<8>::op(load_var);
+      __m512 block_sum = reduce_sum_block<8>(inputs);
+      rvariance[i] += _mm512_reduce_add_ps(block_sum);
+    }
+    if (remainder_block_num_total) { // remainder var
+      __m512 inputs[remainder_block_num_total];
+      for (int64 idx = 0; idx < remainder_block_num; idx++){
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], inputs[idx]);
+      }
+      if (remainder_16) {
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_loadu_ps(
+            mask, input + cols * i + cols - remainder_16);
+        inputs[remainder_block_num] = _mm512_maskz_sub_ps(mask, inputs[remainder_block_num], means);
+        inputs[remainder_block_num] = _mm512_maskz_mul_ps(mask, inputs[remainder_block_num], inputs[remainder_block_num]);
+      }
+      __m512 block_sum = reduce_sum_block_ps(inputs, remainder_block_num_total);
+      rvariance[i] += _mm512_reduce_add_ps(block_sum);
+    }
+
+    rvariance[i] *= one_over_cols;
+    rvariance[i] += epsilon;
+    rvariance[i] = 1.0f / sqrtf(rvariance[i]);
+    __m512 rvariances = _mm512_set1_ps(rvariance[i]);
+    // Normalize and store
+    for (int64 j = 0; j < block_num; ++j) {
+      __m512 inputs[8];
+      __m512 nums[8]; // used to load gammas and betas
+      auto load_normalize = [&](auto idx) {
+        // (x - mean) / sqrt(var + eps)
+        inputs[idx] = _mm512_loadu_ps(input + cols * i + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_sub_ps(inputs[idx], means);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], rvariances);
+        // Mul gamma
+        nums[idx] = _mm512_loadu_ps(gamma + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_mul_ps(inputs[idx], nums[idx]);
+        // Add beta
+        nums[idx] = _mm512_loadu_ps(beta + 128 * j + 16 * idx);
+        inputs[idx] = _mm512_add_ps(inputs[idx], nums[idx]);
+
+        // Store
+        _mm512_storeu_ps(output + cols * i + 128 * j + 16 * idx, inputs[idx]);
+      };
+      compile_time_for<8>::op(load_normalize);
+    }
+    if (remainder_block_num_total) { // remainder normalize and store
+      __m512 inputs;
+      __m512 nums; // used to load gammas and betas
+      for (int64 idx = 0; idx < remainder_block_num; idx++){ // remainder of 128
+        // (x - mean) / sqrt(var + eps)
+        inputs = _mm512_loadu_ps(input + cols * i + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_sub_ps(inputs, means);
+        inputs = _mm512_mul_ps(inputs, rvariances);
+        // Mul gamma
+        nums = _mm512_loadu_ps(gamma + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_mul_ps(inputs, nums);
+        // Add beta
+        nums = _mm512_loadu_ps(beta + cols - remainder_128 + 16 * idx);
+        inputs = _mm512_add_ps(inputs, nums);
+
+        // Store
+        _mm512_storeu_ps(output + cols * i + cols - remainder_128 + 16 * idx, inputs);
+      }
+      if (remainder_16) { // remainder of 16
+        __mmask16 mask = 0xFFFF >> (16 - remainder_16);
+        // (x - mean) / sqrt(var + eps)
+        inputs = _mm512_maskz_loadu_ps(mask, input + cols * i + cols - remainder_16);
+        inputs = _mm512_maskz_sub_ps(mask, inputs, means);
+        inputs = _mm512_maskz_mul_ps(mask, inputs, rvariances);
+        // Mul gamma
+        nums = _mm512_maskz_loadu_ps(mask, gamma + cols - remainder_16);
+        inputs = _mm512_maskz_mul_ps(mask, inputs, nums);
+        // Add beta
+        nums = _mm512_maskz_loadu_ps(mask, beta + cols - remainder_16);
+        inputs = _mm512_maskz_add_ps(mask, inputs, nums);
+
+        // Store
+        _mm512_mask_storeu_ps(output + cols * i + cols - remainder_16, mask, inputs);
+      }
+    }
+  }
+}
+#endif // forward layer norm avx512 impl
+
+// For gradient of x, it comes from 3 parts: x-mean, mean, and rvariance
+//   grad from (x - mean): y_grad * gamma * [rvariance]
+//   grad from mean: - sum_row(y_grad * gamma * [rvariance]) / #cols
+//   grad from rvariance: sum_row(y_grad * gamma * (x - mean)) * (- [rvariance]^3) * (x - mean) / #cols
+// For gradient of gamma, grad = y_grad * (x - mean) * rvariance
+// For gradient of beta, grad = y_grad
+// gamma_grad and beta_grad are accumulated.
+inline void layer_norm_backward(const float* y_grad, const float* x,
+                                const float* mean, const float* rvariance,
+                                const float* gamma, float* x_grad,
+                                float* gamma_grad, float* beta_grad,
+                                int64 begin_row, int64 end_row, int64 cols) {
+  const float one_over_cols = 1.0f / cols;
+  for (int64 i = begin_row; i < end_row; ++i) {
+    int64 j = 0;
+    float sum_m = 0;
+    float sum_r = 0;
+    // sum_m: sum_row(y_grad * gamma)
+    // sum_r: sum_row(y_grad * gamma * (x - mean))
+    for (; j + 7 < cols; j += 8) {
+      float data_0 = y_grad[i * cols + j] * gamma[j];
+      float data_1 = y_grad[i * cols + j + 1] * gamma[j + 1];
+      float data_2 = y_grad[i * cols + j + 2] * gamma[j + 2];
+      float data_3 = y_grad[i * cols + j + 3] * gamma[j + 3];
+      float data_4 = y_grad[i * cols + j + 4] * gamma[j + 4];
+      float data_5 = y_grad[i * cols + j + 5] * gamma[j + 5];
+      float data_6 = y_grad[i * cols + j + 6] * gamma[j + 6];
+      float data_7 = y_grad[i * cols + j + 7] * gamma[j + 7];
+      sum_m += data_0 + data_1 + data_2 + data_3 +
+                  data_4 + data_5 + data_6 + data_7;
+
+      data_0 = data_0 * (x[i * cols + j] - mean[i]);
+      data_1 = data_1 * (x[i * cols + j + 1] - mean[i]);
+      data_2 = data_2 * (x[i * cols + j + 2] - mean[i]);
+      data_3 = data_3 * (x[i * cols + j + 3] - mean[i]);
+      data_4 = data_4 * (x[i * cols + j + 4] - mean[i]);
+      data_5 = data_5 * (x[i * cols + j + 5] - mean[i]);
+      data_6 = data_6 * (x[i * cols + j + 6] - mean[i]);
+      data_7 = data_7 * (x[i * cols + j + 7] - mean[i]);
+      sum_r += data_0 + data_1 + data_2 + data_3 +
+                  data_4 + data_5 + data_6 + data_7;
+    }
+    for (; j < cols; ++j) { // remainder
+      sum_m += y_grad[i * cols + j] * gamma[j];
+      sum_r += y_grad[i * cols + j] * gamma[j] * (x[i * cols + j] - mean[i]);
+    }
+    sum_m *= one_over_cols;
+    sum_r *= rvariance[i] * rvariance[i];
+    sum_r *= one_over_cols;
+
+    for (j = 0; j + 7 < cols; j += 8) {
+      x_grad[i * cols + j] = y_grad[i * cols + j] * gamma[j];
+      x_grad[i * cols + j + 1] = y_grad[i * cols + j + 1] * gamma[j + 1];
+      x_grad[i * cols + j + 2] = y_grad[i * cols + j + 2] * gamma[j + 2];
+      x_grad[i * cols + j + 3] = y_grad[i * cols + j + 3] * gamma[j + 3];
+      x_grad[i * cols + j + 4] = y_grad[i * cols + j + 4] * gamma[j + 4];
+      x_grad[i * cols + j + 5] = y_grad[i * cols + j + 5] * gamma[j + 5];
+      x_grad[i * cols + j + 6] = y_grad[i * cols + j + 6] * gamma[j + 6];
+      x_grad[i * cols + j + 7] = y_grad[i * cols + j + 7] * gamma[j + 7];
+
+      x_grad[i * cols + j] -= sum_m + sum_r * (x[i * cols + j] - mean[i]);
+      x_grad[i * cols + j + 1] -= sum_m + sum_r * (x[i * cols + j + 1] - mean[i]);
+      x_grad[i * cols + j + 2] -= sum_m + sum_r * (x[i * cols + j + 2] - mean[i]);
+      x_grad[i * cols + j + 3] -= sum_m + sum_r * (x[i * cols + j + 3] - mean[i]);
+      x_grad[i * cols + j + 4] -= sum_m + sum_r * (x[i * cols + j + 4] - mean[i]);
+      x_grad[i * cols + j + 5] -= sum_m + sum_r * (x[i * cols + j + 5] - mean[i]);
+      x_grad[i * cols + j + 6] -= sum_m + sum_r * (x[i * cols + j + 6] - mean[i]);
+      x_grad[i * cols + j + 7] -= sum_m + sum_r * (x[i * cols + j + 7] - mean[i]);
+
+      x_grad[i * cols + j] *= rvariance[i];
+      x_grad[i * cols + j + 1] *= rvariance[i];
+      x_grad[i * cols + j + 2] *= rvariance[i];
+      x_grad[i * cols + j + 3] *= rvariance[i];
+      x_grad[i * cols + j + 4] *= rvariance[i];
+      x_grad[i * cols + j + 5] *= rvariance[i];
+      x_grad[i * cols + j + 6] *= rvariance[i];
+      x_grad[i * cols + j + 7] *= rvariance[i];
+    }
+    for (; j < cols; ++j) { // remainder
+      x_grad[i * cols + j] = y_grad[i * cols + j] * gamma[j];
+      x_grad[i * cols + j] -= sum_m + sum_r * (x[i * cols + j] - mean[i]);
+      x_grad[i * cols + j] *= rvariance[i];
+    }
+
+    // grad of gamma
+    for (j = 0; j + 7 < cols; j += 8) {
+      gamma_grad[j] += y_grad[i * cols + j] * (x[i * cols + j] - mean[i]) * rvariance[i];
+      gamma_grad[j + 1] += y_grad[i * cols + j + 1] * (x[i * cols + j + 1] - mean[i]) * rvariance[i];
+      gamma_grad[j + 2] += y_grad[i * cols + j + 2] * (x[i * cols + j + 2] - mean[i]) * rvariance[i];
+      gamma_grad[j + 3] += y_grad[i * cols + j + 3] * (x[i * cols + j + 3] - mean[i]) * rvariance[i];
+      gamma_grad[j + 4] += y_grad[i * cols + j + 4] * (x[i * cols + j + 4] - mean[i]) * rvariance[i];
+      gamma_grad[j + 5] += y_grad[i * cols + j + 5] * (x[i * cols + j + 5] - mean[i]) * rvariance[i];
+      gamma_grad[j + 6] += y_grad[i * cols + j + 6] * (x[i * cols + j + 6] - mean[i]) * rvariance[i];
+      gamma_grad[j + 7] += y_grad[i * cols + j + 7] * (x[i * cols + j + 7] - mean[i]) * rvariance[i];
+    }
+    for (; j < cols; ++j) { // remainder
+      gamma_grad[j] += y_grad[i * cols + j] * (x[i * cols + j] - mean[i]) * rvariance[i];
+    }
+
+    // grad of beta
+    for (j = 0; j + 7 < cols; j += 8) {
+      beta_grad[j] += y_grad[i * cols + j];
+      beta_grad[j + 1] += y_grad[i * cols + j + 1];
+      beta_grad[j + 2] += y_grad[i * cols + j + 2];
+      beta_grad[j + 3] += y_grad[i * cols + j + 3];
+      beta_grad[j + 4] += y_grad[i * cols + j + 4];
+      beta_grad[j + 5] += y_grad[i * cols + j + 5];
+      beta_grad[j + 6] += y_grad[i * cols + j + 6];
+      beta_grad[j + 7] += y_grad[i * cols + j + 7];
+    }
+    for (; j < cols; ++j) { // remainder
+      beta_grad[j] += y_grad[i * cols + j];
+    }
+  }
+}
+
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+template <int ROWS>
+inline void layer_norm_backward_avx512(const float* y_grad, const float* x,
+                                       const float* mean,
+                                       const float* rvariance,
+                                       const float* gamma, float* x_grad,
+                                       float* gamma_grad, float* beta_grad,
+                                       int64 cols, int64 start_row) {
+  float sum_m[ROWS], sum_r[ROWS];
+  __m512 vsum_m[ROWS], vsum_r[ROWS], vmean[ROWS], vrvariance[ROWS];
+
+  // Init
+  auto setzero = [&](auto idx) {
+    vsum_m[idx] = _mm512_setzero_ps();
+    vsum_r[idx] = _mm512_setzero_ps();
+    vmean[idx] = _mm512_set1_ps(mean[start_row + idx]);
+    vrvariance[idx] = _mm512_set1_ps(rvariance[start_row + idx]);
+  };
+  compile_time_for<ROWS>::op(setzero);
+
+  // Compute sum for y_grad * gamma and y_grad * gamma * (x - mean)
+  int64 j = 0;
+  for (; j + 15 < cols; j += 16) {
+    auto compute_sum = [&](auto idx) {
+      __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+      __m512 vgamma = _mm512_loadu_ps(gamma + j);
+
+      __m512 mul = _mm512_mul_ps(vy_grad, vgamma);
+      vsum_m[idx] = _mm512_add_ps(mul, vsum_m[idx]);
+
+      __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+      __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
+      vsum_r[idx] = _mm512_fmadd_ps(mul, x_minus_mean, vsum_r[idx]);
+    };
+
+    compile_time_for<ROWS>::op(compute_sum);
+  }
+
+  auto reduce_sum = [&](auto idx) {
+    sum_m[idx] = horizontal_add(vsum_m[idx]);
+    sum_r[idx] = horizontal_add(vsum_r[idx]);
+
+    for (int64 c = j; c < cols; ++c) {
+      const auto offset = (start_row + idx) * cols + c;
+      sum_m[idx] += y_grad[offset] * gamma[c];
+      sum_r[idx] +=
+          y_grad[offset] * gamma[c] * (x[offset] - mean[start_row + idx]);
+    }
+
+    sum_m[idx] /= cols;
+    sum_r[idx] *= rvariance[start_row + idx] * rvariance[start_row + idx];
+    sum_r[idx] /= cols;
+
+    vsum_m[idx] = _mm512_set1_ps(sum_m[idx]);
+    vsum_r[idx] = _mm512_set1_ps(sum_r[idx]);
+  };
+
+  compile_time_for<ROWS>::op(reduce_sum);
+
+  // Compute gradient for x, gamma, beta
+  for (j = 0; j + 15 < cols; j += 16) {
+    __m512 vgamma_grad = _mm512_loadu_ps(gamma_grad + j);
+    __m512 vbeta_grad = _mm512_loadu_ps(beta_grad + j);
+
+    auto compute_grad = [&](auto idx) {
+      __m512 vy_grad = _mm512_loadu_ps(y_grad + (start_row + idx) * cols + j);
+      __m512 vgamma = _mm512_loadu_ps(gamma + j);
+
+      __m512 vx_grad = _mm512_mul_ps(vy_grad, vgamma);
+
+      __m512 vx = _mm512_loadu_ps(x + (start_row + idx) * cols + j);
+      __m512 x_minus_mean = _mm512_sub_ps(vx, vmean[idx]);
+
+      vx_grad = _mm512_sub_ps(
+          vx_grad, _mm512_fmadd_ps(vsum_r[idx], x_minus_mean, vsum_m[idx]));
+      vx_grad = _mm512_mul_ps(vx_grad, vrvariance[idx]);
+
+      // save gradient of x
+      _mm512_storeu_ps(x_grad + (start_row + idx) * cols + j, vx_grad);
+
+      // gradient for gamma and beta
+      vgamma_grad = _mm512_fmadd_ps(_mm512_mul_ps(vy_grad, x_minus_mean),
+                                    vrvariance[idx], vgamma_grad);
+      vbeta_grad = _mm512_add_ps(vy_grad, vbeta_grad);
+    };
+
+    compile_time_for<ROWS>::op(compute_grad);
+
+    // save gradient of gamma, beta
+    _mm512_storeu_ps(gamma_grad + j, vgamma_grad);
+    _mm512_storeu_ps(beta_grad + j, vbeta_grad);
+  }
+
+  // Deal with the remain data
+  if (cols % 16 != 0) {
+    auto remain_grad = [&](auto idx) {
+      for (int64 c = j; c < cols; ++c) {
+        const auto offset = (start_row + idx) * cols + c;
+        float vx_grad = y_grad[offset] * gamma[c];
+        float x_minus_mean = x[offset] - mean[start_row + idx];
+        vx_grad -= sum_m[idx] + sum_r[idx] * x_minus_mean;
+        vx_grad *= rvariance[start_row + idx];
+
+        // save gradient of x
+        x_grad[offset] = vx_grad;
+
+        // gradient for gamma and beta
+        gamma_grad[c] +=
+            y_grad[offset] * x_minus_mean * rvariance[start_row + idx];
+        beta_grad[c] += y_grad[offset];
+      }
+    };
+
+    compile_time_for<ROWS>::op(remain_grad);
+  }
+}
+#endif // backward layer norm avx512 impl
+
+// Normalizes the rows [begin_row, end_row), with the AVX512 kernel if
+// available.
+inline void layer_norm_forward_rows(const float* input, const float* gamma,
+                                    const float* beta, float* output,
+                                    float* mean, float* rvariance, int64 cols,
+                                    int64 begin_row, int64 end_row,
+                                    float epsilon) {
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+  layer_norm_forward_avx512(input, gamma, beta, output, mean, rvariance, cols,
+                            begin_row, end_row, epsilon);
+#else
+  layer_norm_forward(input, gamma, beta, output, mean, rvariance, cols,
+                     begin_row, end_row, epsilon);
+#endif  //AVX512F
+}
+
+// Backpropagates through the rows [begin_row, end_row), with the AVX512
+// kernel if available. gamma_grad and beta_grad are accumulated.
+inline void layer_norm_backward_rows(const float* y_grad, const float* x,
+                                     const float* mean, const float* rvariance,
+                                     const float* gamma, float* x_grad,
+                                     float* gamma_grad, float* beta_grad,
+                                     int64 cols, int64 begin_row,
+                                     int64 end_row) {
+#if defined(__GNUC__) && (__GNUC__ > 6) && (__AVX512F__)
+  int64 i = begin_row;
+  for (; i + 3 < end_row; i += 4) {
+    layer_norm_backward_avx512<4>(y_grad, x, mean, rvariance, gamma, x_grad,
+                                  gamma_grad, beta_grad, cols, i);
+  }
+  for (; i < end_row; ++i) {
+    layer_norm_backward_avx512<1>(y_grad, x, mean, rvariance, gamma, x_grad,
+                                  gamma_grad, beta_grad, cols, i);
+  }
+#else
+  layer_norm_backward(y_grad, x, mean, rvariance, gamma, x_grad, gamma_grad,
+                      beta_grad, begin_row, end_row, cols);
+#endif  //AVX512F
+}
+
+#endif  // TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_FUSED_LAYER_NORM_H_
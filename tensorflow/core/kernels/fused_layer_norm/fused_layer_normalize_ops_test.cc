@@ -86,6 +86,44 @@ TEST_F(FusedLayerNormalizeOpTest, 2Dims_Float) {
   }
 }
 
+// Every column has its own gamma and beta, so each of the eight unrolled
+// columns of the scalar path must pick its own scale and offset.
+TEST_F(FusedLayerNormalizeOpTest, 2Dims_Float_PerColumnGammaBeta) {
+  const int rows = 3;
+  const int cols = 21;
+
+  MakeOpAndSetDevice(Device::CPU, DT_FLOAT, 0, 1e-12);
+
+  auto x = [](int i) -> float { return 0.25f * ((i * 7) % 11) - 1.0f; };
+  auto gamma = [](int j) -> float { return 0.5f + 0.1f * j; };
+  auto beta = [](int j) -> float { return 0.2f * j - 1.0f; };
+  AddInput<float>(TensorShape({rows, cols}), x);
+  AddInput<float>(TensorShape({cols}), gamma);
+  AddInput<float>(TensorShape({cols}), beta);
+
+  TF_ASSERT_OK(RunOpKernel());
+  TF_EXPECT_OK(device_->Sync());
+
+  Tensor expected_output(allocator(), DT_FLOAT, TensorShape({rows, cols}));
+  auto expected = expected_output.matrix<float>();
+  for (int i = 0; i < rows; i++) {
+    double mean = 0.0;
+    for (int j = 0; j < cols; j++) mean += x(i * cols + j);
+    mean /= cols;
+    double variance = 0.0;
+    for (int j = 0; j < cols; j++) {
+      double d = x(i * cols + j) - mean;
+      variance += d * d;
+    }
+    double rvariance = 1.0 / std::sqrt(variance / cols + 1e-12);
+    for (int j = 0; j < cols; j++) {
+      expected(i, j) = gamma(j) * (x(i * cols + j) - mean) * rvariance +
+                       beta(j);
+    }
+  }
+  test::ExpectTensorNear<float>(expected_output, *GetOutput(0), 1e-5);
+}
+
 class FusedLayerNormalizeGradOpTest : public OpsTestBase {
  protected:
   void MakeOpAndSetDevice(Device device, DataType dtype, int axis, float epsilon) {
@@ -81,6 +81,7 @@ class GroupEmbeddingVariableLookupDenseCpuOp
         embedding_var->GetEmbeddings(ev_ctx, dense_values, gather_embedding, nnz);
         embedding_var->UpdateCache(dense_values_tensor, true);
       }
+      embedding_var->UpdateHeavyHitters(dense_values_tensor);
 
     }
   }
@@ -128,6 +128,7 @@ class GroupEmbeddingVariableLookupCpuOp
         embedding_var->GetEmbeddings(ev_ctx, unique, unique_embedding_data, unique_nnz);
         embedding_var->UpdateCache(unique_tensor, unique_counter, true/*called_by_gather*/);
       }
+      embedding_var->UpdateHeavyHitters(sp_values_tensor);
 
       std::vector<TValue> default_weights(nnz, 1.0);
       TValue *sp_weights = default_weights.data();
@@ -0,0 +1,598 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+// Examples run through all their steps at once, kBatchBlock at a time, so
+// that the states of the block stay in cache across the steps. The examples
+// are sorted by decreasing length, so the examples of a block still running
+// at a step are the first ones of the block, and the steps past the length
+// of an example are never computed.
+constexpr int64 kBatchBlock = 64;
+
+struct GRUSequenceShape {
+  int64 batch = 0;
+  int64 time = 0;
+  int64 input = 0;
+  int64 units = 0;
+
+  // Flops of a step of an example, forward.
+  int64 StepCost() const { return 6 * (input + units) * units + 12 * units; }
+};
+
+// The examples of a block, by decreasing length, and the first row of each
+// step in the time-major buffers of the block: step t of the i-th example
+// is row offsets[t] + i, for i < active(t).
+struct GRUSequenceBlock {
+  std::vector<int64> examples;
+  std::vector<int64> offsets;
+
+  int64 steps() const { return offsets.size() - 1; }
+  int64 rows() const { return offsets.back(); }
+  int64 active(int64 t) const { return offsets[t + 1] - offsets[t]; }
+};
+
+// The weights split into the rows applied to the inputs, for all the steps
+// of a block at once, and the rows applied to the state at each step.
+struct GRUSequenceWeights {
+  GRUSequenceWeights(const GRUSequenceShape& shape, const Tensor& gate_kernel,
+                     const Tensor& candidate_kernel)
+      : input_kernel(shape.input, 3 * shape.units),
+        gate_state_kernel(gate_kernel.flat<float>().data() +
+                              shape.input * 2 * shape.units,
+                          shape.units, 2 * shape.units),
+        candidate_state_kernel(candidate_kernel.flat<float>().data() +
+                                   shape.input * shape.units,
+                               shape.units, shape.units) {
+    input_kernel.leftCols(2 * shape.units) = ConstMatrixMap(
+        gate_kernel.flat<float>().data(), shape.input, 2 * shape.units);
+    input_kernel.rightCols(shape.units) = ConstMatrixMap(
+        candidate_kernel.flat<float>().data(), shape.input, shape.units);
+  }
+
+  // [I, 3H], the gate then the candidate kernel.
+  Matrix input_kernel;
+  // [H, 2H] and [H, H].
+  ConstMatrixMap gate_state_kernel;
+  ConstMatrixMap candidate_state_kernel;
+};
+
+// The weight gradients of a block, summed over the blocks in order, so that
+// the results do not depend on the scheduling.
+struct GRUSequenceGradAccumulator {
+  explicit GRUSequenceGradAccumulator(const GRUSequenceShape& shape)
+      : input_kernel(Matrix::Zero(shape.input, 3 * shape.units)),
+        gate_state_kernel(Matrix::Zero(shape.units, 2 * shape.units)),
+        candidate_state_kernel(Matrix::Zero(shape.units, shape.units)),
+        bias(Eigen::RowVectorXf::Zero(3 * shape.units)) {}
+
+  Matrix input_kernel;
+  Matrix gate_state_kernel;
+  Matrix candidate_state_kernel;
+  Eigen::RowVectorXf bias;
+};
+
+Status CheckShape(const Tensor& tensor, const TensorShape& expected,
+                  const char* name) {
+  if (tensor.shape() != expected) {
+    return errors::InvalidArgument(name, " must be ", expected.DebugString(),
+                                   ", got ", tensor.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+// Checks the inputs shared by the ops and their gradients.
+Status GetGRUSequenceShape(const Tensor& x, const Tensor* att_scores,
+                           const Tensor& sequence_length,
+                           const Tensor& initial_state,
+                           const Tensor& gate_kernel,
+                           const Tensor& candidate_kernel,
+                           GRUSequenceShape* shape) {
+  if (x.dims() != 3) {
+    return errors::InvalidArgument("x must be 3-D, got ",
+                                   x.shape().DebugString());
+  }
+  if (initial_state.dims() != 2) {
+    return errors::InvalidArgument("initial_state must be 2-D, got ",
+                                   initial_state.shape().DebugString());
+  }
+  shape->batch = x.dim_size(0);
+  shape->time = x.dim_size(1);
+  shape->input = x.dim_size(2);
+  shape->units = initial_state.dim_size(1);
+  const int64 b = shape->batch;
+  const int64 h = shape->units;
+  if (att_scores != nullptr) {
+    TF_RETURN_IF_ERROR(CheckShape(*att_scores, TensorShape({b, shape->time}),
+                                  "att_scores"));
+  }
+  TF_RETURN_IF_ERROR(
+      CheckShape(sequence_length, TensorShape({b}), "sequence_length"));
+  TF_RETURN_IF_ERROR(
+      CheckShape(initial_state, TensorShape({b, h}), "initial_state"));
+  TF_RETURN_IF_ERROR(CheckShape(
+      gate_kernel, TensorShape({shape->input + h, 2 * h}), "gate_kernel"));
+  TF_RETURN_IF_ERROR(CheckShape(candidate_kernel,
+                                TensorShape({shape->input + h, h}),
+                                "candidate_kernel"));
+  return Status::OK();
+}
+
+// Splits the examples into blocks, by decreasing length. The lengths are
+// clamped to the number of steps, as tf.nn.dynamic_rnn does.
+Status MakeBlocks(const Tensor& sequence_length, int64 time,
+                  std::vector<int64>* lengths,
+                  std::vector<GRUSequenceBlock>* blocks) {
+  auto sequence_length_flat = sequence_length.flat<int32>();
+  const int64 batch = sequence_length_flat.size();
+  lengths->resize(batch);
+  for (int64 b = 0; b < batch; ++b) {
+    if (sequence_length_flat(b) < 0) {
+      return errors::InvalidArgument("sequence_length[", b,
+                                     "] must be >= 0, got ",
+                                     sequence_length_flat(b));
+    }
+    (*lengths)[b] = std::min<int64>(sequence_length_flat(b), time);
+  }
+  std::vector<int64> order(batch);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int64 a, int64 b) {
+    return (*lengths)[a] > (*lengths)[b];
+  });
+
+  blocks->clear();
+  for (int64 start = 0; start < batch; start += kBatchBlock) {
+    GRUSequenceBlock block;
+    block.examples.assign(order.begin() + start,
+                          order.begin() + std::min(start + kBatchBlock, batch));
+    const int64 steps = (*lengths)[block.examples[0]];
+    block.offsets.assign(steps + 1, 0);
+    int64 active = block.examples.size();
+    for (int64 t = 0; t < steps; ++t) {
+      while ((*lengths)[block.examples[active - 1]] <= t) --active;
+      block.offsets[t + 1] = block.offsets[t] + active;
+    }
+    blocks->push_back(std::move(block));
+  }
+  return Status::OK();
+}
+
+// Gathers the rows [b, t] of the [B, T, depth] `data` of the steps of the
+// block, in the time-major order of the block.
+void GatherSteps(const GRUSequenceBlock& block, const float* data, int64 time,
+                 int64 depth, Matrix* rows) {
+  rows->resize(block.rows(), depth);
+  for (int64 t = 0; t < block.steps(); ++t) {
+    for (int64 i = 0; i < block.active(t); ++i) {
+      rows->row(block.offsets[t] + i) = ConstRowVectorMap(
+          data + (block.examples[i] * time + t) * depth, depth);
+    }
+  }
+}
+
+// Zeros the rows [b, t] of the [B, T, depth] `data` past the length of the
+// examples of the block.
+void ZeroPadding(const GRUSequenceBlock& block,
+                 const std::vector<int64>& lengths, int64 time, int64 depth,
+                 float* data) {
+  for (int64 example : block.examples) {
+    std::fill(data + (example * time + lengths[example]) * depth,
+              data + (example + 1) * time * depth, 0.0f);
+  }
+}
+
+// Scales the rows of `rows` by 1 - att_scores of the examples at step t.
+template <typename Rows>
+void ScaleByAttention(const GRUSequenceBlock& block, const float* att_scores,
+                      int64 time, int64 t, Rows rows) {
+  for (int64 i = 0; i < rows.rows(); ++i) {
+    rows.row(i) *= 1.0f - att_scores[block.examples[i] * time + t];
+  }
+}
+
+// Runs the GRU over the examples of the block.
+template <bool kAttention>
+void ForwardBlock(const GRUSequenceShape& shape,
+                  const GRUSequenceWeights& weights,
+                  const Eigen::RowVectorXf& input_bias,
+                  const GRUSequenceBlock& block,
+                  const std::vector<int64>& lengths, const float* x,
+                  const float* att_scores, const float* initial_state,
+                  float* outputs, float* final_state, float* gates,
+                  float* candidates) {
+  const int64 n = block.examples.size();
+  const int64 time = shape.time;
+  const int64 units = shape.units;
+
+  // The gate and candidate projections of the inputs of all the steps.
+  Matrix inputs;
+  GatherSteps(block, x, time, shape.input, &inputs);
+  Matrix z(block.rows(), 3 * units);
+  z.noalias() = inputs * weights.input_kernel;
+  z.rowwise() += input_bias;
+
+  Matrix state(n, units);
+  for (int64 i = 0; i < n; ++i) {
+    state.row(i) =
+        ConstRowVectorMap(initial_state + block.examples[i] * units, units);
+  }
+  Matrix reset_state(n, units);
+  Matrix update(n, units);
+  for (int64 t = 0; t < block.steps(); ++t) {
+    const int64 active = block.active(t);
+    auto step = z.middleRows(block.offsets[t], active);
+    auto h = state.topRows(active);
+    auto g = step.leftCols(2 * units);
+    g.noalias() += h * weights.gate_state_kernel;
+    g = (1.0f + (-g.array()).exp()).inverse().matrix();
+    auto r = step.leftCols(units);
+    auto u = update.topRows(active);
+    u = step.middleCols(units, units);
+    if (kAttention) ScaleByAttention(block, att_scores, time, t, u);
+    auto rh = reset_state.topRows(active);
+    rh = r.cwiseProduct(h);
+    auto c = step.rightCols(units);
+    c.noalias() += rh * weights.candidate_state_kernel;
+    c = c.array().tanh().matrix();
+    h = (c.array() + u.array() * (h.array() - c.array())).matrix();
+
+    for (int64 i = 0; i < active; ++i) {
+      const int64 row = block.examples[i] * time + t;
+      RowVectorMap(outputs + row * units, units) = h.row(i);
+      RowVectorMap(gates + row * 2 * units, 2 * units) = g.row(i);
+      RowVectorMap(candidates + row * units, units) = c.row(i);
+    }
+  }
+  for (int64 i = 0; i < n; ++i) {
+    RowVectorMap(final_state + block.examples[i] * units, units) =
+        state.row(i);
+  }
+  ZeroPadding(block, lengths, time, units, outputs);
+  ZeroPadding(block, lengths, time, 2 * units, gates);
+  ZeroPadding(block, lengths, time, units, candidates);
+}
+
+// Backpropagates through the steps of the examples of the block, then
+// computes the gradients of the inputs and accumulates the gradients of the
+// weights for all the steps at once.
+template <bool kAttention>
+void BackwardBlock(const GRUSequenceShape& shape,
+                   const GRUSequenceWeights& weights,
+                   const GRUSequenceBlock& block,
+                   const std::vector<int64>& lengths, const float* x,
+                   const float* att_scores, const float* initial_state,
+                   const float* outputs, const float* gates,
+                   const float* candidates, const float* outputs_grad,
+                   const float* final_state_grad, float* x_grad,
+                   float* att_scores_grad, float* initial_state_grad,
+                   GRUSequenceGradAccumulator* acc) {
+  const int64 n = block.examples.size();
+  const int64 time = shape.time;
+  const int64 units = shape.units;
+
+  Matrix g;
+  Matrix c;
+  GatherSteps(block, gates, time, 2 * units, &g);
+  GatherSteps(block, candidates, time, units, &c);
+  // The states before each step.
+  Matrix prev(block.rows(), units);
+  for (int64 t = 0; t < block.steps(); ++t) {
+    for (int64 i = 0; i < block.active(t); ++i) {
+      const int64 example = block.examples[i];
+      prev.row(block.offsets[t] + i) = ConstRowVectorMap(
+          t == 0 ? initial_state + example * units
+                 : outputs + (example * time + t - 1) * units,
+          units);
+    }
+  }
+
+  // The gradients of the gate and candidate projections of the steps.
+  Matrix dz(block.rows(), 3 * units);
+  Matrix state_grad(n, units);
+  for (int64 i = 0; i < n; ++i) {
+    state_grad.row(i) =
+        ConstRowVectorMap(final_state_grad + block.examples[i] * units, units);
+  }
+  Matrix update(n, units);
+  Matrix update_grad(n, units);
+  Matrix reset_state_grad(n, units);
+  for (int64 t = block.steps() - 1; t >= 0; --t) {
+    const int64 active = block.active(t);
+    const int64 offset = block.offsets[t];
+    auto dh = state_grad.topRows(active);
+    for (int64 i = 0; i < active; ++i) {
+      dh.row(i) += ConstRowVectorMap(
+          outputs_grad + (block.examples[i] * time + t) * units, units);
+    }
+    auto r = g.middleRows(offset, active).leftCols(units);
+    auto u = g.middleRows(offset, active).rightCols(units);
+    auto cs = c.middleRows(offset, active);
+    auto h = prev.middleRows(offset, active);
+    auto step_grad = dz.middleRows(offset, active);
+
+    // The update gate applied to the state, scaled for the AUGRU.
+    auto ue = update.topRows(active);
+    ue = u;
+    if (kAttention) ScaleByAttention(block, att_scores, time, t, ue);
+    step_grad.rightCols(units) = (dh.array() * (1.0f - ue.array()) *
+                                  (1.0f - cs.array().square()))
+                                     .matrix();
+    auto du = update_grad.topRows(active);
+    du = (dh.array() * (h.array() - cs.array())).matrix();
+    if (kAttention) {
+      for (int64 i = 0; i < active; ++i) {
+        att_scores_grad[block.examples[i] * time + t] =
+            -du.row(i).dot(u.row(i));
+      }
+      ScaleByAttention(block, att_scores, time, t, du);
+    }
+    step_grad.middleCols(units, units) =
+        (du.array() * u.array() * (1.0f - u.array())).matrix();
+    auto drh = reset_state_grad.topRows(active);
+    drh.noalias() =
+        step_grad.rightCols(units) * weights.candidate_state_kernel.transpose();
+    step_grad.leftCols(units) =
+        (drh.array() * h.array() * r.array() * (1.0f - r.array())).matrix();
+    dh = (dh.array() * ue.array() + drh.array() * r.array()).matrix();
+    dh.noalias() +=
+        step_grad.leftCols(2 * units) * weights.gate_state_kernel.transpose();
+  }
+  for (int64 i = 0; i < n; ++i) {
+    RowVectorMap(initial_state_grad + block.examples[i] * units, units) =
+        state_grad.row(i);
+  }
+
+  Matrix inputs;
+  GatherSteps(block, x, time, shape.input, &inputs);
+  Matrix inputs_grad(block.rows(), shape.input);
+  inputs_grad.noalias() = dz * weights.input_kernel.transpose();
+  for (int64 t = 0; t < block.steps(); ++t) {
+    for (int64 i = 0; i < block.active(t); ++i) {
+      RowVectorMap(x_grad + (block.examples[i] * time + t) * shape.input,
+                   shape.input) = inputs_grad.row(block.offsets[t] + i);
+    }
+  }
+  ZeroPadding(block, lengths, time, shape.input, x_grad);
+  if (kAttention) ZeroPadding(block, lengths, time, 1, att_scores_grad);
+
+  acc->input_kernel.noalias() += inputs.transpose() * dz;
+  acc->gate_state_kernel.noalias() +=
+      prev.transpose() * dz.leftCols(2 * units);
+  const Matrix reset_state = g.leftCols(units).cwiseProduct(prev);
+  acc->candidate_state_kernel.noalias() +=
+      reset_state.transpose() * dz.rightCols(units);
+  acc->bias += dz.colwise().sum();
+}
+
+}  // namespace
+
+// GRUSequence, or AUGRUSequence with kAttention. Each task runs a block of
+// examples through all their steps, after the input projections of all the
+// steps of the block as one GEMM.
+template <bool kAttention>
+class GRUSequenceOp : public OpKernel {
+ public:
+  explicit GRUSequenceOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    int input = 0;
+    const Tensor& x = context->input(input++);
+    const Tensor* att_scores = kAttention ? &context->input(input++) : nullptr;
+    const Tensor& sequence_length = context->input(input++);
+    const Tensor& initial_state = context->input(input++);
+    const Tensor& gate_kernel = context->input(input++);
+    const Tensor& gate_bias = context->input(input++);
+    const Tensor& candidate_kernel = context->input(input++);
+    const Tensor& candidate_bias = context->input(input++);
+    GRUSequenceShape shape;
+    OP_REQUIRES_OK(context, GetGRUSequenceShape(
+                                x, att_scores, sequence_length, initial_state,
+                                gate_kernel, candidate_kernel, &shape));
+    const int64 b = shape.batch;
+    const int64 t = shape.time;
+    const int64 h = shape.units;
+    OP_REQUIRES_OK(context,
+                   CheckShape(gate_bias, TensorShape({2 * h}), "gate_bias"));
+    OP_REQUIRES_OK(context, CheckShape(candidate_bias, TensorShape({h}),
+                                       "candidate_bias"));
+    std::vector<int64> lengths;
+    std::vector<GRUSequenceBlock> blocks;
+    OP_REQUIRES_OK(context,
+                   MakeBlocks(sequence_length, t, &lengths, &blocks));
+
+    Tensor* outputs = nullptr;
+    Tensor* final_state = nullptr;
+    Tensor* gates = nullptr;
+    Tensor* candidates = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({b, t, h}), &outputs));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({b, h}), &final_state));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({b, t, 2 * h}), &gates));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                3, TensorShape({b, t, h}), &candidates));
+    if (blocks.empty()) return;
+
+    const GRUSequenceWeights weights(shape, gate_kernel, candidate_kernel);
+    Eigen::RowVectorXf input_bias(3 * h);
+    input_bias << ConstRowVectorMap(gate_bias.flat<float>().data(), 2 * h),
+        ConstRowVectorMap(candidate_bias.flat<float>().data(), h);
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        blocks.size(), kBatchBlock * t * shape.StepCost(),
+        [&](int64 begin, int64 end) {
+          for (int64 block = begin; block < end; ++block) {
+            ForwardBlock<kAttention>(
+                shape, weights, input_bias, blocks[block], lengths,
+                x.flat<float>().data(),
+                kAttention ? att_scores->flat<float>().data() : nullptr,
+                initial_state.flat<float>().data(),
+                outputs->flat<float>().data(),
+                final_state->flat<float>().data(),
+                gates->flat<float>().data(),
+                candidates->flat<float>().data());
+          }
+        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("GRUSequence").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GRUSequenceOp<false>);
+REGISTER_KERNEL_BUILDER(
+    Name("AUGRUSequence").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GRUSequenceOp<true>);
+
+// The gradients of GRUSequence, or AUGRUSequence with kAttention, from the
+// saved outputs, gates and candidates. Each task backpropagates through
+// the steps of a block of examples, then computes the gradients of its
+// inputs and weights as GEMMs over all the steps of the block.
+template <bool kAttention>
+class GRUSequenceGradOp : public OpKernel {
+ public:
+  explicit GRUSequenceGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    int input = 0;
+    const Tensor& x = context->input(input++);
+    const Tensor* att_scores = kAttention ? &context->input(input++) : nullptr;
+    const Tensor& sequence_length = context->input(input++);
+    const Tensor& initial_state = context->input(input++);
+    const Tensor& gate_kernel = context->input(input++);
+    const Tensor& candidate_kernel = context->input(input++);
+    const Tensor& outputs = context->input(input++);
+    const Tensor& gates = context->input(input++);
+    const Tensor& candidates = context->input(input++);
+    const Tensor& outputs_grad = context->input(input++);
+    const Tensor& final_state_grad = context->input(input++);
+    GRUSequenceShape shape;
+    OP_REQUIRES_OK(context, GetGRUSequenceShape(
+                                x, att_scores, sequence_length, initial_state,
+                                gate_kernel, candidate_kernel, &shape));
+    const int64 b = shape.batch;
+    const int64 t = shape.time;
+    const int64 h = shape.units;
+    OP_REQUIRES_OK(context,
+                   CheckShape(outputs, TensorShape({b, t, h}), "outputs"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(gates, TensorShape({b, t, 2 * h}), "gates"));
+    OP_REQUIRES_OK(context, CheckShape(candidates, TensorShape({b, t, h}),
+                                       "candidates"));
+    OP_REQUIRES_OK(context, CheckShape(outputs_grad, TensorShape({b, t, h}),
+                                       "outputs_grad"));
+    OP_REQUIRES_OK(context, CheckShape(final_state_grad, TensorShape({b, h}),
+                                       "final_state_grad"));
+    std::vector<int64> lengths;
+    std::vector<GRUSequenceBlock> blocks;
+    OP_REQUIRES_OK(context,
+                   MakeBlocks(sequence_length, t, &lengths, &blocks));
+
+    int output = 0;
+    Tensor* x_grad = nullptr;
+    Tensor* att_scores_grad = nullptr;
+    Tensor* initial_state_grad = nullptr;
+    Tensor* gate_kernel_grad = nullptr;
+    Tensor* gate_bias_grad = nullptr;
+    Tensor* candidate_kernel_grad = nullptr;
+    Tensor* candidate_bias_grad = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(output++, x.shape(), &x_grad));
+    if (kAttention) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_output(output++, att_scores->shape(),
+                                              &att_scores_grad));
+    }
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(output++, initial_state.shape(),
+                                            &initial_state_grad));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(output++, gate_kernel.shape(),
+                                            &gate_kernel_grad));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                output++, TensorShape({2 * h}),
+                                &gate_bias_grad));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(output++, candidate_kernel.shape(),
+                                            &candidate_kernel_grad));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                output++, TensorShape({h}),
+                                &candidate_bias_grad));
+
+    const GRUSequenceWeights weights(shape, gate_kernel, candidate_kernel);
+    std::vector<GRUSequenceGradAccumulator> accumulators(
+        blocks.size(), GRUSequenceGradAccumulator(shape));
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        blocks.size(), 2 * kBatchBlock * t * shape.StepCost(),
+        [&](int64 begin, int64 end) {
+          for (int64 block = begin; block < end; ++block) {
+            BackwardBlock<kAttention>(
+                shape, weights, blocks[block], lengths,
+                x.flat<float>().data(),
+                kAttention ? att_scores->flat<float>().data() : nullptr,
+                initial_state.flat<float>().data(),
+                outputs.flat<float>().data(), gates.flat<float>().data(),
+                candidates.flat<float>().data(),
+                outputs_grad.flat<float>().data(),
+                final_state_grad.flat<float>().data(),
+                x_grad->flat<float>().data(),
+                kAttention ? att_scores_grad->flat<float>().data() : nullptr,
+                initial_state_grad->flat<float>().data(),
+                &accumulators[block]);
+          }
+        });
+
+    GRUSequenceGradAccumulator sum(shape);
+    for (const auto& acc : accumulators) {
+      sum.input_kernel += acc.input_kernel;
+      sum.gate_state_kernel += acc.gate_state_kernel;
+      sum.candidate_state_kernel += acc.candidate_state_kernel;
+      sum.bias += acc.bias;
+    }
+    const int64 i = shape.input;
+    MatrixMap gate_kernel_grad_map(gate_kernel_grad->flat<float>().data(),
+                                   i + h, 2 * h);
+    gate_kernel_grad_map.topRows(i) = sum.input_kernel.leftCols(2 * h);
+    gate_kernel_grad_map.bottomRows(h) = sum.gate_state_kernel;
+    MatrixMap candidate_kernel_grad_map(
+        candidate_kernel_grad->flat<float>().data(), i + h, h);
+    candidate_kernel_grad_map.topRows(i) = sum.input_kernel.rightCols(h);
+    candidate_kernel_grad_map.bottomRows(h) = sum.candidate_state_kernel;
+    RowVectorMap(gate_bias_grad->flat<float>().data(), 2 * h) =
+        sum.bias.head(2 * h);
+    RowVectorMap(candidate_bias_grad->flat<float>().data(), h) =
+        sum.bias.tail(h);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("GRUSequenceGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GRUSequenceGradOp<false>);
+REGISTER_KERNEL_BUILDER(
+    Name("AUGRUSequenceGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GRUSequenceGradOp<true>);
+
+}  // namespace tensorflow
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+// The inputs of GRUSequence, or AUGRUSequence with attention.
+struct GRUSequenceInputs {
+  GRUSequenceInputs(bool attention, int batch, int time, int input, int units)
+      : attention(attention), batch(batch), time(time), input(input),
+        units(units), sequence_length(batch) {
+    Fill(&x, batch * time * input, 0);
+    Fill(&att_scores, batch * time, 1);
+    for (float& a : att_scores) a = std::abs(a);
+    Fill(&initial_state, batch * units, 2);
+    Fill(&gate_kernel, (input + units) * 2 * units, 3);
+    Fill(&gate_bias, 2 * units, 4);
+    Fill(&candidate_kernel, (input + units) * units, 5);
+    Fill(&candidate_bias, units, 6);
+    // Empty, partial, full and longer than time sequences.
+    for (int b = 0; b < batch; ++b) sequence_length[b] = (b * 7) % (time + 2);
+  }
+
+  void Fill(std::vector<float>* v, int n, int seed) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = 0.5f * std::sin(0.37f * i + 0.11f * n + seed);
+    }
+  }
+
+  // The unfused GRU cell over the valid steps, outputs then final states.
+  std::vector<double> Output() const {
+    std::vector<double> outputs(batch * time * units, 0);
+    std::vector<double> final_state;
+    for (int b = 0; b < batch; ++b) {
+      std::vector<double> h(&initial_state[b * units],
+                            &initial_state[(b + 1) * units]);
+      const int length = std::min(sequence_length[b], time);
+      for (int t = 0; t < length; ++t) {
+        const float* xt = &x[(b * time + t) * input];
+        std::vector<double> g(2 * units);
+        for (int k = 0; k < 2 * units; ++k) {
+          double z = gate_bias[k];
+          for (int i = 0; i < input; ++i) {
+            z += xt[i] * gate_kernel[i * 2 * units + k];
+          }
+          for (int j = 0; j < units; ++j) {
+            z += h[j] * gate_kernel[(input + j) * 2 * units + k];
+          }
+          g[k] = 1 / (1 + std::exp(-z));
+        }
+        std::vector<double> c(units);
+        for (int k = 0; k < units; ++k) {
+          double z = candidate_bias[k];
+          for (int i = 0; i < input; ++i) {
+            z += xt[i] * candidate_kernel[i * units + k];
+          }
+          for (int j = 0; j < units; ++j) {
+            z += g[j] * h[j] * candidate_kernel[(input + j) * units + k];
+          }
+          c[k] = std::tanh(z);
+        }
+        for (int k = 0; k < units; ++k) {
+          double u = g[units + k];
+          if (attention) u *= 1 - att_scores[b * time + t];
+          h[k] = u * h[k] + (1 - u) * c[k];
+          outputs[(b * time + t) * units + k] = h[k];
+        }
+      }
+      final_state.insert(final_state.end(), h.begin(), h.end());
+    }
+    outputs.insert(outputs.end(), final_state.begin(), final_state.end());
+    return outputs;
+  }
+
+  // sum(outputs * outputs_grad) + sum(final_state * final_state_grad).
+  double Loss(const std::vector<float>& output_grad) const {
+    std::vector<double> output = Output();
+    double loss = 0;
+    for (int i = 0; i < output.size(); ++i) loss += output[i] * output_grad[i];
+    return loss;
+  }
+
+  // The inputs in the order of the gradients.
+  std::vector<std::vector<float>*> Params() {
+    std::vector<std::vector<float>*> params = {&x};
+    if (attention) params.push_back(&att_scores);
+    for (auto* param : {&initial_state, &gate_kernel, &gate_bias,
+                        &candidate_kernel, &candidate_bias}) {
+      params.push_back(param);
+    }
+    return params;
+  }
+
+  bool attention;
+  int batch, time, input, units;
+  std::vector<int32> sequence_length;
+  std::vector<float> x, att_scores, initial_state;
+  std::vector<float> gate_kernel, gate_bias, candidate_kernel, candidate_bias;
+};
+
+class GRUSequenceOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool grad, const GRUSequenceInputs& in) {
+    string op = in.attention ? "AUGRUSequence" : "GRUSequence";
+    if (grad) op += "Grad";
+    NodeDefBuilder builder("gru_sequence", op);
+    builder.Input(FakeInput(DT_FLOAT));
+    if (in.attention) builder.Input(FakeInput(DT_FLOAT));
+    builder.Input(FakeInput(DT_INT32))
+        .Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_FLOAT));
+    if (!grad) builder.Input(FakeInput(DT_FLOAT));
+    builder.Input(FakeInput(DT_FLOAT));
+    if (!grad) builder.Input(FakeInput(DT_FLOAT));
+    if (grad) {
+      for (int i = 0; i < 5; ++i) builder.Input(FakeInput(DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Attr("T", DT_FLOAT).Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  // The inputs up to the weights, without the biases for the gradient.
+  void AddInputs(bool grad, const GRUSequenceInputs& in) {
+    const int b = in.batch;
+    const int h = in.units;
+    AddInputFromArray<float>(TensorShape({b, in.time, in.input}), in.x);
+    if (in.attention) {
+      AddInputFromArray<float>(TensorShape({b, in.time}), in.att_scores);
+    }
+    AddInputFromArray<int32>(TensorShape({b}), in.sequence_length);
+    AddInputFromArray<float>(TensorShape({b, h}), in.initial_state);
+    AddInputFromArray<float>(TensorShape({in.input + h, 2 * h}),
+                             in.gate_kernel);
+    if (!grad) AddInputFromArray<float>(TensorShape({2 * h}), in.gate_bias);
+    AddInputFromArray<float>(TensorShape({in.input + h, h}),
+                             in.candidate_kernel);
+    if (!grad) AddInputFromArray<float>(TensorShape({h}), in.candidate_bias);
+  }
+
+  void ExpectMatchesUnfused(const GRUSequenceInputs& in) {
+    MakeOp(false, in);
+    AddInputs(false, in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    const int b = in.batch;
+    const int h = in.units;
+    Tensor outputs(DT_FLOAT, TensorShape({b, in.time, h}));
+    Tensor final_state(DT_FLOAT, TensorShape({b, h}));
+    std::vector<double> output = in.Output();
+    const int num_outputs = outputs.NumElements();
+    for (int i = 0; i < output.size(); ++i) {
+      if (i < num_outputs) {
+        outputs.flat<float>()(i) = output[i];
+      } else {
+        final_state.flat<float>()(i - num_outputs) = output[i];
+      }
+    }
+    test::ExpectTensorNear<float>(outputs, *GetOutput(0), 1e-5);
+    test::ExpectTensorNear<float>(final_state, *GetOutput(1), 1e-5);
+  }
+
+  void ExpectGradMatchesFiniteDifferences(GRUSequenceInputs in) {
+    MakeOp(false, in);
+    AddInputs(false, in);
+    TF_ASSERT_OK(RunOpKernel());
+    std::vector<Tensor> saved;
+    for (int i : {0, 2, 3}) saved.push_back(*GetOutput(i));
+    inputs_.clear();
+
+    const int b = in.batch;
+    const int h = in.units;
+    std::vector<float> output_grad;
+    in.Fill(&output_grad, b * (in.time + 1) * h, 0);
+    MakeOp(true, in);
+    AddInputs(true, in);
+    for (const Tensor& t : saved) {
+      AddInputFromArray<float>(
+          t.shape(),
+          gtl::ArraySlice<float>(t.flat<float>().data(), t.NumElements()));
+    }
+    AddInputFromArray<float>(
+        TensorShape({b, in.time, h}),
+        gtl::ArraySlice<float>(output_grad.data(), b * in.time * h));
+    AddInputFromArray<float>(
+        TensorShape({b, h}),
+        gtl::ArraySlice<float>(output_grad.data() + b * in.time * h, b * h));
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<std::vector<float>*> params = in.Params();
+    for (int p = 0; p < params.size(); ++p) {
+      std::vector<float>& param = *params[p];
+      auto grad = GetOutput(p)->flat<float>();
+      ASSERT_EQ(param.size(), grad.size());
+      for (int i = 0; i < param.size(); ++i) {
+        const float value = param[i];
+        const float delta = 1e-3;
+        param[i] = value + delta;
+        const double loss_plus = in.Loss(output_grad);
+        param[i] = value - delta;
+        const double loss_minus = in.Loss(output_grad);
+        param[i] = value;
+        EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 1e-3)
+            << "input " << p << " element " << i;
+      }
+    }
+  }
+};
+
+TEST_F(GRUSequenceOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(GRUSequenceInputs(false, 5, 4, 3, 2));
+}
+
+// 70 examples span two blocks of examples.
+TEST_F(GRUSequenceOpTest, MatchesUnfusedAcrossBlocks) {
+  ExpectMatchesUnfused(GRUSequenceInputs(false, 70, 6, 5, 4));
+}
+
+TEST_F(GRUSequenceOpTest, AUGRUMatchesUnfused) {
+  ExpectMatchesUnfused(GRUSequenceInputs(true, 70, 6, 5, 4));
+}
+
+TEST_F(GRUSequenceOpTest, GradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(GRUSequenceInputs(false, 5, 4, 3, 2));
+}
+
+TEST_F(GRUSequenceOpTest, GradMatchesFiniteDifferencesAcrossBlocks) {
+  ExpectGradMatchesFiniteDifferences(GRUSequenceInputs(false, 70, 4, 3, 2));
+}
+
+TEST_F(GRUSequenceOpTest, AUGRUGradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(GRUSequenceInputs(true, 70, 4, 3, 2));
+}
+
+TEST_F(GRUSequenceOpTest, NegativeSequenceLength) {
+  GRUSequenceInputs in(false, 2, 3, 2, 2);
+  in.sequence_length[1] = -1;
+  MakeOp(false, in);
+  AddInputs(false, in);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+static Graph* FusedGRUSequence(bool attention, int batch, int time, int units) {
+  Scope s = Scope::NewRootScope();
+  std::vector<Output> inputs = {RandomConst(s, {batch, time, units})};
+  if (attention) inputs.push_back(RandomConst(s, {batch, time}));
+  Tensor sequence_length(DT_INT32, TensorShape({batch}));
+  sequence_length.flat<int32>().setConstant(time);
+  inputs.push_back(ops::Const(s, Input::Initializer(sequence_length)));
+  inputs.push_back(RandomConst(s, {batch, units}));
+  inputs.push_back(RandomConst(s, {2 * units, 2 * units}));
+  inputs.push_back(RandomConst(s, {2 * units}));
+  inputs.push_back(RandomConst(s, {2 * units, units}));
+  inputs.push_back(RandomConst(s, {units}));
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  NodeBuilder builder(g->NewName("gru_sequence"),
+                      attention ? "AUGRUSequence" : "GRUSequence");
+  for (const Output& input : inputs) {
+    builder.Input(nodes[input.node()->name()]);
+  }
+  TF_CHECK_OK(builder.Finalize(g, nullptr));
+  return g;
+}
+
+// The GRUCell, or VecAttGRUCell of modelzoo/dien with attention, unrolled
+// over the steps.
+static Graph* UnfusedGRUSequence(bool attention, int batch, int time,
+                                 int units) {
+  Scope s = Scope::NewRootScope();
+  Output gate_kernel = RandomConst(s, {2 * units, 2 * units});
+  Output gate_bias = RandomConst(s, {2 * units});
+  Output candidate_kernel = RandomConst(s, {2 * units, units});
+  Output candidate_bias = RandomConst(s, {units});
+  Output h = RandomConst(s, {batch, units});
+  for (int t = 0; t < time; ++t) {
+    Output x = RandomConst(s, {batch, units});
+    auto g = ops::Sigmoid(
+        s, ops::BiasAdd(s,
+                        ops::MatMul(s, ops::Concat(s, {x, h}, 1), gate_kernel),
+                        gate_bias));
+    auto ru = ops::Split(s, 1, g, 2);
+    Output u = ru.output[1];
+    auto c = ops::Tanh(
+        s, ops::BiasAdd(
+               s,
+               ops::MatMul(s, ops::Concat(s, {x, ops::Mul(s, ru.output[0], h)},
+                                          1),
+                           candidate_kernel),
+               candidate_bias));
+    if (attention) {
+      u = ops::Mul(s, ops::Sub(s, 1.0f, RandomConst(s, {batch, 1})), u);
+    }
+    h = ops::Add(s, ops::Mul(s, u, h),
+                 ops::Mul(s, ops::Sub(s, 1.0f, u), c));
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+#define BM_GRU_SEQUENCE(KIND, OP, ATT, B, T, H, NTH)                         \
+  static void BM_##KIND##OP##_##B##_##T##_##H##_##NTH##_CPU(int iters) {     \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                  \
+    SessionOptions opts;                                                     \
+    opts.config.set_intra_op_parallelism_threads(NTH);                       \
+    test::Benchmark("cpu", KIND##GRUSequence(ATT, B, T, H), &opts).Run(iters); \
+  }                                                                          \
+  BENCHMARK(BM_##KIND##OP##_##B##_##T##_##H##_##NTH##_CPU);
+
+#define BM_GRU_SEQUENCE_NTH(OP, ATT, B, T, H)    \
+  BM_GRU_SEQUENCE(Fused, OP, ATT, B, T, H, 1);   \
+  BM_GRU_SEQUENCE(Fused, OP, ATT, B, T, H, 8);   \
+  BM_GRU_SEQUENCE(Unfused, OP, ATT, B, T, H, 1); \
+  BM_GRU_SEQUENCE(Unfused, OP, ATT, B, T, H, 8);
+
+// The two GRUs of modelzoo/dien: 50 steps of 36 units.
+BM_GRU_SEQUENCE_NTH(GRUSequence, false, 512, 50, 36);
+BM_GRU_SEQUENCE_NTH(GRUSequence, false, 2048, 50, 36);
+BM_GRU_SEQUENCE_NTH(AUGRUSequence, true, 512, 50, 36);
+BM_GRU_SEQUENCE_NTH(AUGRUSequence, true, 2048, 50, 36);
+
+}  // namespace
+}  // namespace tensorflow
@@ -123,6 +123,7 @@ class KvResourceLookupIDOp : public OpKernel {
       ev->GetOrCreateKey(ev_ctx, indices,
                          reinterpret_cast<void**>(out_base),
                          indices_size);
+      ev->UpdateHeavyHitters(indices);
     }
   }
 };
@@ -296,12 +297,13 @@ class KvResourceGatherOp : public OpKernel {
       } else {
         ev->GetEmbeddings(ev_ctx, (TKey*)indices.data(), out_base, N);
         if (has_counts) {
-          const Tensor& indices_counts = c->input(2);
+          const Tensor& indices_counts = c->input(3);
           ev->UpdateCache(indices, indices_counts, true);
         } else {
           ev->UpdateCache(indices, true);
         }
       }
+      ev->UpdateHeavyHitters(indices, has_counts ? &c->input(3) : nullptr);
     }
   }
 
@@ -415,11 +417,13 @@ class KvResourceGatherGPUOp : public OpKernel {
         ev->GetEmbeddings(ev_ctx, (TKey*)indices_host.data(),
                           out_base, N);
         if (has_counts) {
-          const Tensor& indices_counts = c->input(2);
+          const Tensor& indices_counts = c->input(3);
           ev->UpdateCache(indices_host, indices_counts, true);
         } else {
           ev->UpdateCache(indices_host, true);
         }
+        ev->UpdateHeavyHitters(indices_host,
+                               has_counts ? &c->input(3) : nullptr);
       }
     }
   }
@@ -497,6 +501,76 @@ TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
 
+template <typename TKey, typename TValue>
+class KvResourceHeavyHittersOp : public OpKernel {
+ public:
+  explicit KvResourceHeavyHittersOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("k", &k_));
+    OP_REQUIRES_OK(c, c->GetAttr("coverages", &coverages_));
+    for (float coverage : coverages_) {
+      OP_REQUIRES(c, coverage > 0 && coverage <= 1,
+          errors::InvalidArgument("coverages must be in (0, 1], got ",
+                                  coverage));
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    std::unique_ptr<embedding::HeavyHitterSketch> merged;
+    for (int i = 0; i < ctx->num_inputs(); ++i) {
+      EmbeddingVar<TKey, TValue>* ev = nullptr;
+      OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, i), &ev));
+      core::ScopedUnref unref_me(ev);
+      embedding::HeavyHitterSketch* sketch = ev->HeavyHitters();
+      OP_REQUIRES(ctx, sketch != nullptr,
+          errors::FailedPrecondition(
+              "No heavy hitter sketch for EmbeddingVariable ", ev->Name(),
+              ", set TF_EV_HEAVY_HITTER_CAPACITY to enable it."));
+      if (!merged) {
+        merged.reset(new embedding::HeavyHitterSketch(sketch->capacity()));
+      }
+      merged->Merge(*sketch);
+    }
+
+    embedding::HeavyHitterReport report;
+    merged->Report(k_, coverages_, &report);
+    const int64 num_ids = report.ids.size();
+    Tensor* ids = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, {num_ids}, &ids));
+    Tensor* freqs = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(1, {num_ids}, &freqs));
+    for (int64 i = 0; i < num_ids; ++i) {
+      ids->flat<TKey>()(i) = static_cast<TKey>(report.ids[i]);
+      freqs->flat<int64>()(i) = report.freqs[i];
+    }
+    Tensor* working_set_sizes = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+        2, {static_cast<int64>(coverages_.size())}, &working_set_sizes));
+    std::copy(report.working_set_sizes.begin(),
+              report.working_set_sizes.end(),
+              working_set_sizes->flat<int64>().data());
+    Tensor* total = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(3, {}, &total));
+    total->scalar<int64>()() = report.total;
+  }
+
+ private:
+  int64 k_;
+  std::vector<float> coverages_;
+};
+
+#define REGISTER_KERNELS(ktype, vtype)                          \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceHeavyHitters")        \
+                            .Device(DEVICE_CPU)                 \
+                            .TypeConstraint<ktype>("Tkeys")     \
+                            .TypeConstraint<vtype>("dtype"),    \
+                          KvResourceHeavyHittersOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(type)                              \
+  REGISTER_KERNELS(int32, type)                                 \
+  REGISTER_KERNELS(int64, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_ALL)
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+
 template <typename TKey, typename TValue>
 class EVGetVersionOp : public OpKernel {
  public:
@@ -267,8 +267,11 @@ class KvResourceImportV2Op: public AsyncOpKernel {
                    << s.ToString();
       }
 
-      ev->Restore(name_string, file_name_string, partition_id_, partition_num_, 
-                  false, &reader, reset_version_);
+      OP_REQUIRES_OK_ASYNC(
+          context,
+          ev->Restore(name_string, file_name_string, partition_id_,
+                      partition_num_, false, &reader, reset_version_),
+          done);
       ev->SetInitialized();
       done();
     };
@@ -395,12 +398,20 @@ class KvResourceImportV3Op: public AsyncOpKernel {
         se::cuda::ScopedActivateExecutorContext scoped_activation{
             context->op_device_context()->stream()->parent()};
         const Eigen::GpuDevice& device = context->eigen_gpu_device();
-        ev->Restore(name_string, file_name_string, partition_id_, partition_num_, 
-                    false, &reader, reset_version_, &device);
+        OP_REQUIRES_OK_ASYNC(
+            context,
+            ev->Restore(name_string, file_name_string, partition_id_,
+                        partition_num_, false, &reader, reset_version_,
+                        &device),
+            done);
 #endif
       } else {
-        ev->Restore(name_string, file_name_string, partition_id_, partition_num_, 
-                    false, &reader, reset_version_, nullptr);
+        OP_REQUIRES_OK_ASYNC(
+            context,
+            ev->Restore(name_string, file_name_string, partition_id_,
+                        partition_num_, false, &reader, reset_version_,
+                        nullptr),
+            done);
       }
       ev->SetInitialized();
       done();
@@ -486,8 +497,11 @@ class KvResourceIncrImportOp: public AsyncOpKernel {
               << "partition_num:"
               << partition_num_;
 
-    ev->Restore(name_string, file_name_string, partition_id_, partition_num_, 
-                true, &reader);
+    OP_REQUIRES_OK_ASYNC(
+        context,
+        ev->Restore(name_string, file_name_string, partition_id_,
+                    partition_num_, true, &reader),
+        done);
     ev->SetInitialized();
     done();
   }
@@ -525,5 +539,87 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_KERNELS_GPU)
 
 #undef REGISTER_KERNELS_ALL
 #undef REGISTER_KERNELS
-}  // namespace tensorflow
 
+template <typename TKey, typename TValue>
+class KvResourceImportKeysOp : public OpKernel {
+ public:
+  explicit KvResourceImportKeysOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("partition_id", &partition_id_));
+    OP_REQUIRES(c, partition_id_ >= 0,
+        errors::InvalidArgument(
+          "partition_id must >= 0, ", std::to_string(partition_id_)));
+    OP_REQUIRES_OK(c, c->GetAttr("partition_num", &partition_num_));
+    OP_REQUIRES(c, partition_num_ >= 1,
+        errors::InvalidArgument(
+          "partition_num must >= 1, ", std::to_string(partition_num_)));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingVar<TKey, TValue>* ev = nullptr;
+    OP_REQUIRES_OK(context,
+        LookupResource(context, HandleFromInput(context, 0), &ev));
+    core::ScopedUnref unref_me(ev);
+    OP_REQUIRES(context, !ev->IsUseHbm(),
+        errors::Unimplemented(
+          "Importing keys into an HBM EmbeddingVariable is not supported"));
+
+    const Tensor& keys = context->input(1);
+    const Tensor& values = context->input(2);
+    const Tensor& versions = context->input(3);
+    const Tensor& freqs = context->input(4);
+    const int64 num_keys = keys.NumElements();
+    OP_REQUIRES(context,
+        values.dims() == 2 && values.dim_size(0) == num_keys &&
+        values.dim_size(1) == ev->ValueLen(),
+        errors::InvalidArgument(
+          "values must be of shape [", num_keys, ", ", ev->ValueLen(),
+          "], got ", values.shape().DebugString()));
+    OP_REQUIRES(context,
+        versions.NumElements() == 0 || versions.NumElements() == num_keys,
+        errors::InvalidArgument(
+          "versions must be empty or have ", num_keys, " elements"));
+    OP_REQUIRES(context,
+        freqs.NumElements() == 0 || freqs.NumElements() == num_keys,
+        errors::InvalidArgument(
+          "freqs must be empty or have ", num_keys, " elements"));
+
+    // Filter policies read a version and a frequency for every key.
+    std::vector<int64> default_versions;
+    const int64* version_list = versions.flat<int64>().data();
+    if (versions.NumElements() == 0) {
+      default_versions.assign(num_keys, -1);
+      version_list = default_versions.data();
+    }
+    std::vector<int64> default_freqs;
+    const int64* freq_list = freqs.flat<int64>().data();
+    if (freqs.NumElements() == 0) {
+      default_freqs.assign(num_keys, 0);
+      freq_list = default_freqs.data();
+    }
+    OP_REQUIRES_OK(context, ev->RestoreFromKeysAndValues(
+        num_keys, partition_id_, partition_num_, keys.flat<TKey>().data(),
+        values.flat<TValue>().data(), version_list, freq_list));
+    ev->SetInitialized();
+  }
+
+ private:
+  int64 partition_id_;
+  int64 partition_num_;
+};
+
+#define REGISTER_KERNELS(dev, ktype, vtype)                    \
+  REGISTER_KERNEL_BUILDER(Name("KvResourceImportKeys")         \
+                            .Device(DEVICE_##dev)              \
+                            .TypeConstraint<ktype>("Tkeys")    \
+                            .TypeConstraint<vtype>("dtype"),   \
+                          KvResourceImportKeysOp<ktype, vtype>);
+#define REGISTER_KERNELS_ALL(dev, type)                        \
+  REGISTER_KERNELS(dev, int32, type)                           \
+  REGISTER_KERNELS(dev, int64, type)
+#define REGISTER_KERNELS_CPU(type) REGISTER_KERNELS_ALL(CPU, type)
+TF_CALL_FLOAT_TYPES(REGISTER_KERNELS_CPU)
+#undef REGISTER_KERNELS_CPU
+
+#undef REGISTER_KERNELS_ALL
+#undef REGISTER_KERNELS
+}  // namespace tensorflow
@@ -0,0 +1,470 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/fused_layer_norm/fused_layer_norm.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+// Examples run through the whole block kBatchBlock at a time, so that the
+// aggregation, the mask and the masked hidden input of the block stay in
+// cache between the GEMMs, and are never materialized for the whole batch
+// before the next GEMM starts. Smaller blocks spend more time packing the
+// weights, which each GEMM of a block does again.
+constexpr int64 kBatchBlock = 128;
+
+struct MaskBlockShape {
+  int64 batch = 0;
+  int64 embedding = 0;
+  int64 hidden = 0;
+  int64 aggregation = 0;
+  int64 output = 0;
+
+  // Flops of an example, forward.
+  int64 Cost() const {
+    return 2 * (embedding * aggregation + aggregation * hidden +
+                hidden * output) +
+           10 * output;
+  }
+};
+
+// The weights of a block, and their gradients.
+struct MaskBlockWeights {
+  MaskBlockWeights(const MaskBlockShape& shape, const float* aggregation_kernel,
+                   const float* projection_kernel, const float* output_kernel)
+      : aggregation_kernel(aggregation_kernel, shape.embedding,
+                           shape.aggregation),
+        projection_kernel(projection_kernel, shape.aggregation, shape.hidden),
+        output_kernel(output_kernel, shape.hidden, shape.output) {}
+
+  // [E, R], [R, H] and [H, O].
+  ConstMatrixMap aggregation_kernel;
+  ConstMatrixMap projection_kernel;
+  ConstMatrixMap output_kernel;
+};
+
+// The weight gradients of a range of examples, summed over the ranges in
+// order, so that the results do not depend on the scheduling.
+struct MaskBlockGradAccumulator {
+  explicit MaskBlockGradAccumulator(const MaskBlockShape& shape)
+      : aggregation_kernel(
+            Matrix::Zero(shape.embedding, shape.aggregation)),
+        aggregation_bias(Eigen::RowVectorXf::Zero(shape.aggregation)),
+        projection_kernel(Matrix::Zero(shape.aggregation, shape.hidden)),
+        projection_bias(Eigen::RowVectorXf::Zero(shape.hidden)),
+        output_kernel(Matrix::Zero(shape.hidden, shape.output)),
+        gamma(Eigen::RowVectorXf::Zero(shape.output)),
+        beta(Eigen::RowVectorXf::Zero(shape.output)) {}
+
+  Matrix aggregation_kernel;
+  Eigen::RowVectorXf aggregation_bias;
+  Matrix projection_kernel;
+  Eigen::RowVectorXf projection_bias;
+  Matrix output_kernel;
+  Eigen::RowVectorXf gamma;
+  Eigen::RowVectorXf beta;
+};
+
+Status CheckShape(const Tensor& tensor, const TensorShape& expected,
+                  const char* name) {
+  if (tensor.shape() != expected) {
+    return errors::InvalidArgument(name, " must be ", expected.DebugString(),
+                                   ", got ", tensor.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+// Checks the inputs shared by the op and its gradient.
+Status GetMaskBlockShape(const Tensor& embedding, const Tensor& hidden,
+                         const Tensor& aggregation_kernel,
+                         const Tensor& projection_kernel,
+                         const Tensor& output_kernel, const Tensor& gamma,
+                         MaskBlockShape* shape) {
+  if (embedding.dims() != 2) {
+    return errors::InvalidArgument("embedding must be 2-D, got ",
+                                   embedding.shape().DebugString());
+  }
+  if (aggregation_kernel.dims() != 2 || output_kernel.dims() != 2) {
+    return errors::InvalidArgument(
+        "aggregation_kernel and output_kernel must be 2-D, got ",
+        aggregation_kernel.shape().DebugString(), " and ",
+        output_kernel.shape().DebugString());
+  }
+  shape->batch = embedding.dim_size(0);
+  shape->embedding = embedding.dim_size(1);
+  shape->aggregation = aggregation_kernel.dim_size(1);
+  shape->hidden = output_kernel.dim_size(0);
+  shape->output = output_kernel.dim_size(1);
+  TF_RETURN_IF_ERROR(CheckShape(hidden,
+                                TensorShape({shape->batch, shape->hidden}),
+                                "hidden"));
+  TF_RETURN_IF_ERROR(CheckShape(
+      aggregation_kernel, TensorShape({shape->embedding, shape->aggregation}),
+      "aggregation_kernel"));
+  TF_RETURN_IF_ERROR(CheckShape(
+      projection_kernel, TensorShape({shape->aggregation, shape->hidden}),
+      "projection_kernel"));
+  TF_RETURN_IF_ERROR(
+      CheckShape(gamma, TensorShape({shape->output}), "gamma"));
+  return Status::OK();
+}
+
+// Runs the examples [start, start + rows) through the block.
+void ForwardBlock(const MaskBlockShape& shape, const MaskBlockWeights& weights,
+                  bool mask_relu, float epsilon, int64 start, int64 rows,
+                  const float* embedding_data, const float* hidden_data,
+                  const float* aggregation_bias, const float* projection_bias,
+                  const float* gamma, const float* beta, float* output_data,
+                  float* aggregation_data, float* mask_data,
+                  float* norm_input_data, float* mean, float* rvariance,
+                  Matrix* masked) {
+  ConstMatrixMap embedding(embedding_data + start * shape.embedding, rows,
+                           shape.embedding);
+  ConstMatrixMap hidden(hidden_data + start * shape.hidden, rows,
+                        shape.hidden);
+  MatrixMap aggregation(aggregation_data + start * shape.aggregation, rows,
+                        shape.aggregation);
+  MatrixMap mask(mask_data + start * shape.hidden, rows, shape.hidden);
+  MatrixMap norm_input(norm_input_data + start * shape.output, rows,
+                       shape.output);
+
+  aggregation.noalias() = embedding * weights.aggregation_kernel;
+  aggregation.rowwise() +=
+      ConstRowVectorMap(aggregation_bias, shape.aggregation);
+  aggregation = aggregation.cwiseMax(0.0f);
+  mask.noalias() = aggregation * weights.projection_kernel;
+  mask.rowwise() += ConstRowVectorMap(projection_bias, shape.hidden);
+  if (mask_relu) mask = mask.cwiseMax(0.0f);
+  masked->resize(rows, shape.hidden);
+  *masked = mask.cwiseProduct(hidden);
+  norm_input.noalias() = *masked * weights.output_kernel;
+
+  float* output = output_data + start * shape.output;
+  std::fill(mean + start, mean + start + rows, 0.0f);
+  std::fill(rvariance + start, rvariance + start + rows, 0.0f);
+  layer_norm_forward_rows(norm_input.data(), gamma, beta, output,
+                          mean + start, rvariance + start, shape.output, 0,
+                          rows, epsilon);
+  MatrixMap output_map(output, rows, shape.output);
+  output_map = output_map.cwiseMax(0.0f);
+}
+
+// Backpropagates the examples [start, start + rows) through the block from
+// the saved aggregation, mask and layer normalization, and accumulates the
+// weight gradients.
+void BackwardBlock(const MaskBlockShape& shape,
+                   const MaskBlockWeights& weights, bool mask_relu,
+                   int64 start, int64 rows, const float* embedding_data,
+                   const float* hidden_data, const float* gamma,
+                   const float* output_data, const float* aggregation_data,
+                   const float* mask_data, const float* norm_input_data,
+                   const float* mean, const float* rvariance,
+                   const float* output_grad_data, float* embedding_grad_data,
+                   float* hidden_grad_data, Matrix* scratch,
+                   Matrix* norm_input_grad, Matrix* masked_grad,
+                   MaskBlockGradAccumulator* acc) {
+  ConstMatrixMap embedding(embedding_data + start * shape.embedding, rows,
+                           shape.embedding);
+  ConstMatrixMap hidden(hidden_data + start * shape.hidden, rows,
+                        shape.hidden);
+  ConstMatrixMap output(output_data + start * shape.output, rows,
+                        shape.output);
+  ConstMatrixMap aggregation(aggregation_data + start * shape.aggregation,
+                             rows, shape.aggregation);
+  ConstMatrixMap mask(mask_data + start * shape.hidden, rows, shape.hidden);
+  ConstMatrixMap output_grad(output_grad_data + start * shape.output, rows,
+                             shape.output);
+  MatrixMap embedding_grad(embedding_grad_data + start * shape.embedding, rows,
+                           shape.embedding);
+  MatrixMap hidden_grad(hidden_grad_data + start * shape.hidden, rows,
+                        shape.hidden);
+
+  // Through the relu and the layer normalization.
+  scratch->resize(rows, shape.output);
+  *scratch = (output.array() > 0.0f).select(output_grad, 0.0f);
+  norm_input_grad->resize(rows, shape.output);
+  layer_norm_backward_rows(scratch->data(),
+                           norm_input_data + start * shape.output,
+                           mean + start, rvariance + start, gamma,
+                           norm_input_grad->data(), acc->gamma.data(),
+                           acc->beta.data(), shape.output, 0, rows);
+
+  // Through the output kernel and the mask multiply.
+  scratch->resize(rows, shape.hidden);
+  *scratch = mask.cwiseProduct(hidden);
+  acc->output_kernel.noalias() += scratch->transpose() * *norm_input_grad;
+  masked_grad->resize(rows, shape.hidden);
+  masked_grad->noalias() =
+      *norm_input_grad * weights.output_kernel.transpose();
+  hidden_grad = masked_grad->cwiseProduct(mask);
+  *masked_grad = masked_grad->cwiseProduct(hidden);
+  if (mask_relu) {
+    *masked_grad = (mask.array() > 0.0f).select(*masked_grad, 0.0f);
+  }
+
+  // Through the projection and the aggregation layers.
+  acc->projection_kernel.noalias() += aggregation.transpose() * *masked_grad;
+  acc->projection_bias += masked_grad->colwise().sum();
+  scratch->resize(rows, shape.aggregation);
+  scratch->noalias() = *masked_grad * weights.projection_kernel.transpose();
+  *scratch = (aggregation.array() > 0.0f).select(*scratch, 0.0f);
+  acc->aggregation_kernel.noalias() += embedding.transpose() * *scratch;
+  acc->aggregation_bias += scratch->colwise().sum();
+  embedding_grad.noalias() = *scratch * weights.aggregation_kernel.transpose();
+}
+
+}  // namespace
+
+// MaskBlock. Each task runs blocks of kBatchBlock examples through the two
+// GEMMs of the mask, the mask multiply, the output GEMM and the layer
+// normalization, which reuses the row kernels of FusedLayerNorm.
+class MaskBlockOp : public OpKernel {
+ public:
+  explicit MaskBlockOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("mask_relu", &mask_relu_));
+    OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& embedding = context->input(0);
+    const Tensor& hidden = context->input(1);
+    const Tensor& aggregation_kernel = context->input(2);
+    const Tensor& aggregation_bias = context->input(3);
+    const Tensor& projection_kernel = context->input(4);
+    const Tensor& projection_bias = context->input(5);
+    const Tensor& output_kernel = context->input(6);
+    const Tensor& gamma = context->input(7);
+    const Tensor& beta = context->input(8);
+    MaskBlockShape shape;
+    OP_REQUIRES_OK(context, GetMaskBlockShape(embedding, hidden,
+                                              aggregation_kernel,
+                                              projection_kernel, output_kernel,
+                                              gamma, &shape));
+    const int64 b = shape.batch;
+    OP_REQUIRES_OK(context,
+                   CheckShape(aggregation_bias,
+                              TensorShape({shape.aggregation}),
+                              "aggregation_bias"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(projection_bias, TensorShape({shape.hidden}),
+                              "projection_bias"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(beta, TensorShape({shape.output}), "beta"));
+
+    Tensor* output = nullptr;
+    Tensor* aggregation = nullptr;
+    Tensor* mask = nullptr;
+    Tensor* norm_input = nullptr;
+    Tensor* mean = nullptr;
+    Tensor* rvariance = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({b, shape.output}), &output));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       1, TensorShape({b, shape.aggregation}), &aggregation));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({b, shape.hidden}), &mask));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       3, TensorShape({b, shape.output}), &norm_input));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(4, TensorShape({b}), &mean));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(5, TensorShape({b}), &rvariance));
+    if (b == 0) return;
+
+    const MaskBlockWeights weights(shape,
+                                   aggregation_kernel.flat<float>().data(),
+                                   projection_kernel.flat<float>().data(),
+                                   output_kernel.flat<float>().data());
+    const int64 num_blocks = (b + kBatchBlock - 1) / kBatchBlock;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        num_blocks, kBatchBlock * shape.Cost(),
+        [&](int64 begin, int64 end) {
+          Matrix masked;
+          for (int64 block = begin; block < end; ++block) {
+            const int64 start = block * kBatchBlock;
+            ForwardBlock(shape, weights, mask_relu_, epsilon_, start,
+                         std::min(kBatchBlock, b - start),
+                         embedding.flat<float>().data(),
+                         hidden.flat<float>().data(),
+                         aggregation_bias.flat<float>().data(),
+                         projection_bias.flat<float>().data(),
+                         gamma.flat<float>().data(), beta.flat<float>().data(),
+                         output->flat<float>().data(),
+                         aggregation->flat<float>().data(),
+                         mask->flat<float>().data(),
+                         norm_input->flat<float>().data(),
+                         mean->flat<float>().data(),
+                         rvariance->flat<float>().data(), &masked);
+          }
+        });
+  }
+
+ private:
+  bool mask_relu_;
+  float epsilon_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("MaskBlock").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    MaskBlockOp);
+
+// The gradients of MaskBlock, from its saved outputs. The batch is split
+// into one range of examples per thread, whose weight gradients are
+// accumulated over its blocks, then summed in order: the weights are
+// usually much larger than a block, so they are not accumulated per block.
+class MaskBlockGradOp : public OpKernel {
+ public:
+  explicit MaskBlockGradOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("mask_relu", &mask_relu_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& embedding = context->input(0);
+    const Tensor& hidden = context->input(1);
+    const Tensor& aggregation_kernel = context->input(2);
+    const Tensor& projection_kernel = context->input(3);
+    const Tensor& output_kernel = context->input(4);
+    const Tensor& gamma = context->input(5);
+    const Tensor& output = context->input(6);
+    const Tensor& aggregation = context->input(7);
+    const Tensor& mask = context->input(8);
+    const Tensor& norm_input = context->input(9);
+    const Tensor& mean = context->input(10);
+    const Tensor& rvariance = context->input(11);
+    const Tensor& output_grad = context->input(12);
+    MaskBlockShape shape;
+    OP_REQUIRES_OK(context, GetMaskBlockShape(embedding, hidden,
+                                              aggregation_kernel,
+                                              projection_kernel, output_kernel,
+                                              gamma, &shape));
+    const int64 b = shape.batch;
+    const TensorShape output_shape({b, shape.output});
+    OP_REQUIRES_OK(context, CheckShape(output, output_shape, "output"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(aggregation,
+                              TensorShape({b, shape.aggregation}),
+                              "aggregation"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(mask, TensorShape({b, shape.hidden}), "mask"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(norm_input, output_shape, "norm_input"));
+    OP_REQUIRES_OK(context, CheckShape(mean, TensorShape({b}), "mean"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(rvariance, TensorShape({b}), "rvariance"));
+    OP_REQUIRES_OK(context,
+                   CheckShape(output_grad, output_shape, "output_grad"));
+
+    Tensor* embedding_grad = nullptr;
+    Tensor* hidden_grad = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, embedding.shape(),
+                                                     &embedding_grad));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, hidden.shape(), &hidden_grad));
+
+    const MaskBlockWeights weights(shape,
+                                   aggregation_kernel.flat<float>().data(),
+                                   projection_kernel.flat<float>().data(),
+                                   output_kernel.flat<float>().data());
+    const int64 num_blocks = (b + kBatchBlock - 1) / kBatchBlock;
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 num_ranges =
+        std::max<int64>(1, std::min<int64>(num_blocks,
+                                           worker_threads.num_threads));
+    const int64 blocks_per_range = (num_blocks + num_ranges - 1) / num_ranges;
+    std::vector<MaskBlockGradAccumulator> accumulators(
+        num_ranges, MaskBlockGradAccumulator(shape));
+    worker_threads.workers->ParallelFor(
+        num_ranges, blocks_per_range * kBatchBlock * 2 * shape.Cost(),
+        [&](int64 begin, int64 end) {
+          Matrix scratch;
+          Matrix norm_input_grad;
+          Matrix masked_grad;
+          for (int64 range = begin; range < end; ++range) {
+            const int64 end_block =
+                std::min(num_blocks, (range + 1) * blocks_per_range);
+            for (int64 block = range * blocks_per_range; block < end_block;
+                 ++block) {
+              const int64 start = block * kBatchBlock;
+              BackwardBlock(
+                  shape, weights, mask_relu_, start,
+                  std::min(kBatchBlock, b - start),
+                  embedding.flat<float>().data(), hidden.flat<float>().data(),
+                  gamma.flat<float>().data(), output.flat<float>().data(),
+                  aggregation.flat<float>().data(), mask.flat<float>().data(),
+                  norm_input.flat<float>().data(), mean.flat<float>().data(),
+                  rvariance.flat<float>().data(),
+                  output_grad.flat<float>().data(),
+                  embedding_grad->flat<float>().data(),
+                  hidden_grad->flat<float>().data(), &scratch,
+                  &norm_input_grad, &masked_grad, &accumulators[range]);
+            }
+          }
+        });
+
+    MaskBlockGradAccumulator sum(shape);
+    for (const auto& acc : accumulators) {
+      sum.aggregation_kernel += acc.aggregation_kernel;
+      sum.aggregation_bias += acc.aggregation_bias;
+      sum.projection_kernel += acc.projection_kernel;
+      sum.projection_bias += acc.projection_bias;
+      sum.output_kernel += acc.output_kernel;
+      sum.gamma += acc.gamma;
+      sum.beta += acc.beta;
+    }
+    OP_REQUIRES_OK(context, Output(context, 2, sum.aggregation_kernel));
+    OP_REQUIRES_OK(context, Output(context, 3, sum.aggregation_bias));
+    OP_REQUIRES_OK(context, Output(context, 4, sum.projection_kernel));
+    OP_REQUIRES_OK(context, Output(context, 5, sum.projection_bias));
+    OP_REQUIRES_OK(context, Output(context, 6, sum.output_kernel));
+    OP_REQUIRES_OK(context, Output(context, 7, sum.gamma));
+    OP_REQUIRES_OK(context, Output(context, 8, sum.beta));
+  }
+
+ private:
+  static Status Output(OpKernelContext* context, int index,
+                       const Matrix& value) {
+    Tensor* output = nullptr;
+    TF_RETURN_IF_ERROR(context->allocate_output(
+        index, TensorShape({value.rows(), value.cols()}), &output));
+    MatrixMap(output->flat<float>().data(), value.rows(), value.cols()) =
+        value;
+    return Status::OK();
+  }
+
+  static Status Output(OpKernelContext* context, int index,
+                       const Eigen::RowVectorXf& value) {
+    Tensor* output = nullptr;
+    TF_RETURN_IF_ERROR(context->allocate_output(
+        index, TensorShape({value.size()}), &output));
+    RowVectorMap(output->flat<float>().data(), value.size()) = value;
+    return Status::OK();
+  }
+
+  bool mask_relu_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("MaskBlockGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    MaskBlockGradOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr float kEpsilon = 1e-3;
+
+// The inputs of MaskBlock.
+struct MaskBlockInputs {
+  MaskBlockInputs(bool mask_relu, int batch, int embedding_dim,
+                  int aggregation_dim, int hidden_dim, int output_dim)
+      : mask_relu(mask_relu), batch(batch), embedding_dim(embedding_dim),
+        aggregation_dim(aggregation_dim), hidden_dim(hidden_dim),
+        output_dim(output_dim) {
+    Fill(&embedding, batch * embedding_dim, 0);
+    Fill(&hidden, batch * hidden_dim, 1);
+    Fill(&aggregation_kernel, embedding_dim * aggregation_dim, 2);
+    Fill(&aggregation_bias, aggregation_dim, 3);
+    Fill(&projection_kernel, aggregation_dim * hidden_dim, 4);
+    Fill(&projection_bias, hidden_dim, 5);
+    Fill(&output_kernel, hidden_dim * output_dim, 6);
+    Fill(&gamma, output_dim, 7);
+    Fill(&beta, output_dim, 8);
+    for (float& g : gamma) g += 1.0f;
+  }
+
+  void Fill(std::vector<float>* v, int n, int seed) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = 0.5f * std::sin(0.37f * i + 0.11f * n + seed);
+    }
+  }
+
+  // The unfused mask block of modelzoo/masknet, without batch normalization.
+  std::vector<double> Output() const {
+    std::vector<double> output(batch * output_dim);
+    for (int b = 0; b < batch; ++b) {
+      std::vector<double> aggregation(aggregation_dim);
+      for (int r = 0; r < aggregation_dim; ++r) {
+        double z = aggregation_bias[r];
+        for (int e = 0; e < embedding_dim; ++e) {
+          z += embedding[b * embedding_dim + e] *
+               aggregation_kernel[e * aggregation_dim + r];
+        }
+        aggregation[r] = std::max(z, 0.0);
+      }
+      std::vector<double> masked(hidden_dim);
+      for (int h = 0; h < hidden_dim; ++h) {
+        double z = projection_bias[h];
+        for (int r = 0; r < aggregation_dim; ++r) {
+          z += aggregation[r] * projection_kernel[r * hidden_dim + h];
+        }
+        if (mask_relu) z = std::max(z, 0.0);
+        masked[h] = z * hidden[b * hidden_dim + h];
+      }
+      std::vector<double> y(output_dim);
+      double mean = 0;
+      for (int o = 0; o < output_dim; ++o) {
+        for (int h = 0; h < hidden_dim; ++h) {
+          y[o] += masked[h] * output_kernel[h * output_dim + o];
+        }
+        mean += y[o] / output_dim;
+      }
+      double variance = 0;
+      for (int o = 0; o < output_dim; ++o) {
+        variance += (y[o] - mean) * (y[o] - mean) / output_dim;
+      }
+      for (int o = 0; o < output_dim; ++o) {
+        const double norm = (y[o] - mean) / std::sqrt(variance + kEpsilon);
+        output[b * output_dim + o] = std::max(gamma[o] * norm + beta[o], 0.0);
+      }
+    }
+    return output;
+  }
+
+  // The inputs of the examples [begin, end).
+  MaskBlockInputs Slice(int begin, int end) const {
+    MaskBlockInputs slice = *this;
+    slice.batch = end - begin;
+    slice.embedding.assign(embedding.begin() + begin * embedding_dim,
+                           embedding.begin() + end * embedding_dim);
+    slice.hidden.assign(hidden.begin() + begin * hidden_dim,
+                        hidden.begin() + end * hidden_dim);
+    return slice;
+  }
+
+  // sum(output * output_grad).
+  double Loss(const std::vector<float>& output_grad) const {
+    std::vector<double> output = Output();
+    double loss = 0;
+    for (int i = 0; i < output.size(); ++i) loss += output[i] * output_grad[i];
+    return loss;
+  }
+
+  // The inputs in the order of the gradients.
+  std::vector<std::vector<float>*> Params() {
+    return {&embedding, &hidden, &aggregation_kernel, &aggregation_bias,
+            &projection_kernel, &projection_bias, &output_kernel, &gamma,
+            &beta};
+  }
+
+  bool mask_relu;
+  int batch, embedding_dim, aggregation_dim, hidden_dim, output_dim;
+  std::vector<float> embedding, hidden;
+  std::vector<float> aggregation_kernel, aggregation_bias;
+  std::vector<float> projection_kernel, projection_bias;
+  std::vector<float> output_kernel, gamma, beta;
+};
+
+class MaskBlockOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool grad, const MaskBlockInputs& in) {
+    NodeDefBuilder builder("mask_block", grad ? "MaskBlockGrad" : "MaskBlock");
+    const int num_inputs = grad ? 13 : 9;
+    for (int i = 0; i < num_inputs; ++i) builder.Input(FakeInput(DT_FLOAT));
+    builder.Attr("T", DT_FLOAT).Attr("mask_relu", in.mask_relu);
+    if (!grad) builder.Attr("epsilon", kEpsilon);
+    TF_EXPECT_OK(builder.Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const MaskBlockInputs& in) {
+    const int b = in.batch;
+    AddInputFromArray<float>(TensorShape({b, in.embedding_dim}),
+                             in.embedding);
+    AddInputFromArray<float>(TensorShape({b, in.hidden_dim}), in.hidden);
+    AddInputFromArray<float>(
+        TensorShape({in.embedding_dim, in.aggregation_dim}),
+        in.aggregation_kernel);
+    AddInputFromArray<float>(TensorShape({in.aggregation_dim}),
+                             in.aggregation_bias);
+    AddInputFromArray<float>(TensorShape({in.aggregation_dim, in.hidden_dim}),
+                             in.projection_kernel);
+    AddInputFromArray<float>(TensorShape({in.hidden_dim}), in.projection_bias);
+    AddInputFromArray<float>(TensorShape({in.hidden_dim, in.output_dim}),
+                             in.output_kernel);
+    AddInputFromArray<float>(TensorShape({in.output_dim}), in.gamma);
+    AddInputFromArray<float>(TensorShape({in.output_dim}), in.beta);
+  }
+
+  void ExpectMatchesUnfused(const MaskBlockInputs& in) {
+    MakeOp(false, in);
+    AddInputs(in);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({in.batch, in.output_dim}));
+    std::vector<double> output = in.Output();
+    for (int i = 0; i < output.size(); ++i) {
+      expected.flat<float>()(i) = output[i];
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-4);
+  }
+
+  // Runs MaskBlock, then MaskBlockGrad from its saved outputs.
+  std::vector<Tensor> RunGrad(const MaskBlockInputs& in,
+                              const std::vector<float>& output_grad) {
+    MakeOp(false, in);
+    AddInputs(in);
+    TF_CHECK_OK(RunOpKernel());
+    std::vector<Tensor> saved;
+    for (int i = 0; i < 6; ++i) saved.push_back(*GetOutput(i));
+    inputs_.clear();
+
+    MakeOp(true, in);
+    const int b = in.batch;
+    AddInputFromArray<float>(TensorShape({b, in.embedding_dim}),
+                             in.embedding);
+    AddInputFromArray<float>(TensorShape({b, in.hidden_dim}), in.hidden);
+    AddInputFromArray<float>(
+        TensorShape({in.embedding_dim, in.aggregation_dim}),
+        in.aggregation_kernel);
+    AddInputFromArray<float>(TensorShape({in.aggregation_dim, in.hidden_dim}),
+                             in.projection_kernel);
+    AddInputFromArray<float>(TensorShape({in.hidden_dim, in.output_dim}),
+                             in.output_kernel);
+    AddInputFromArray<float>(TensorShape({in.output_dim}), in.gamma);
+    for (const Tensor& t : saved) {
+      AddInputFromArray<float>(
+          t.shape(),
+          gtl::ArraySlice<float>(t.flat<float>().data(), t.NumElements()));
+    }
+    AddInputFromArray<float>(TensorShape({b, in.output_dim}), output_grad);
+    TF_CHECK_OK(RunOpKernel());
+    std::vector<Tensor> grads;
+    for (int i = 0; i < 9; ++i) grads.push_back(*GetOutput(i));
+    inputs_.clear();
+    return grads;
+  }
+
+  void ExpectGradMatchesFiniteDifferences(MaskBlockInputs in) {
+    std::vector<float> output_grad;
+    in.Fill(&output_grad, in.batch * in.output_dim, 0);
+    std::vector<Tensor> grads = RunGrad(in, output_grad);
+
+    std::vector<std::vector<float>*> params = in.Params();
+    for (int p = 0; p < params.size(); ++p) {
+      std::vector<float>& param = *params[p];
+      auto grad = grads[p].flat<float>();
+      ASSERT_EQ(param.size(), grad.size());
+      for (int i = 0; i < param.size(); ++i) {
+        const float value = param[i];
+        const float delta = 1e-3;
+        param[i] = value + delta;
+        const double loss_plus = in.Loss(output_grad);
+        param[i] = value - delta;
+        const double loss_minus = in.Loss(output_grad);
+        param[i] = value;
+        EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 2e-3)
+            << "input " << p << " element " << i;
+      }
+    }
+  }
+};
+
+TEST_F(MaskBlockOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(MaskBlockInputs(true, 5, 6, 4, 5, 3));
+}
+
+TEST_F(MaskBlockOpTest, LinearMaskMatchesUnfused) {
+  ExpectMatchesUnfused(MaskBlockInputs(false, 5, 6, 4, 5, 3));
+}
+
+// 300 examples span three blocks of examples, and output_dim 37 the AVX512
+// blocks and remainders of the layer normalization.
+TEST_F(MaskBlockOpTest, MatchesUnfusedAcrossBlocks) {
+  ExpectMatchesUnfused(MaskBlockInputs(true, 300, 24, 16, 20, 37));
+}
+
+TEST_F(MaskBlockOpTest, GradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(MaskBlockInputs(true, 5, 6, 4, 5, 3));
+}
+
+TEST_F(MaskBlockOpTest, LinearMaskGradMatchesFiniteDifferences) {
+  ExpectGradMatchesFiniteDifferences(MaskBlockInputs(false, 5, 6, 4, 5, 3));
+}
+
+// The gradients of 260 examples, over three blocks of examples, are those
+// of the examples of each block, concatenated for the inputs and summed for
+// the weights. The finite differences of so many relus are not reliable.
+TEST_F(MaskBlockOpTest, GradAcrossBlocksMatchesSlices) {
+  MaskBlockInputs in(true, 260, 4, 3, 4, 18);
+  std::vector<float> output_grad;
+  in.Fill(&output_grad, in.batch * in.output_dim, 0);
+  std::vector<Tensor> grads = RunGrad(in, output_grad);
+
+  std::vector<std::vector<float>> expected(grads.size());
+  for (int begin = 0; begin < in.batch; begin += 100) {
+    const int end = std::min(begin + 100, in.batch);
+    std::vector<Tensor> slice_grads = RunGrad(
+        in.Slice(begin, end),
+        std::vector<float>(output_grad.begin() + begin * in.output_dim,
+                           output_grad.begin() + end * in.output_dim));
+    for (int p = 0; p < grads.size(); ++p) {
+      auto slice_grad = slice_grads[p].flat<float>();
+      if (p < 2) {
+        expected[p].insert(expected[p].end(), slice_grad.data(),
+                           slice_grad.data() + slice_grad.size());
+      } else {
+        expected[p].resize(slice_grad.size());
+        for (int i = 0; i < slice_grad.size(); ++i) {
+          expected[p][i] += slice_grad(i);
+        }
+      }
+    }
+  }
+  for (int p = 0; p < grads.size(); ++p) {
+    auto grad = grads[p].flat<float>();
+    ASSERT_EQ(expected[p].size(), grad.size());
+    for (int i = 0; i < grad.size(); ++i) {
+      EXPECT_NEAR(expected[p][i], grad(i),
+                  1e-5 * std::max(1.0f, std::abs(grad(i))))
+          << "input " << p << " element " << i;
+    }
+  }
+}
+
+TEST_F(MaskBlockOpTest, InvalidHiddenShape) {
+  MaskBlockInputs in(true, 2, 3, 2, 3, 2);
+  MakeOp(false, in);
+  in.hidden.resize(2 * 4);
+  in.hidden_dim = 4;
+  AddInputs(in);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+// The weights of a mask block of modelzoo/masknet over the [B, E]
+// embedding and the [B, H] hidden input, with reduction_ratio 1 and 64
+// outputs.
+struct MaskBlockWeights {
+  MaskBlockWeights(const Scope& s, int embedding_dim, int hidden_dim)
+      : aggregation_kernel(RandomConst(s, {embedding_dim, hidden_dim})),
+        aggregation_bias(RandomConst(s, {hidden_dim})),
+        projection_kernel(RandomConst(s, {hidden_dim, hidden_dim})),
+        projection_bias(RandomConst(s, {hidden_dim})),
+        output_kernel(RandomConst(s, {hidden_dim, 64})),
+        gamma(RandomConst(s, {64})),
+        beta(RandomConst(s, {64})) {}
+
+  std::vector<Output> inputs() const {
+    return {aggregation_kernel, aggregation_bias, projection_kernel,
+            projection_bias,    output_kernel,    gamma,
+            beta};
+  }
+
+  Output aggregation_kernel, aggregation_bias;
+  Output projection_kernel, projection_bias;
+  Output output_kernel, gamma, beta;
+};
+
+// The dense layers, mask multiply and Keras LayerNormalization of the
+// unfused block, without batch normalization.
+static Output UnfusedMaskBlock(const Scope& s, const MaskBlockWeights& w,
+                               Output embedding, Output hidden) {
+  auto aggregation = ops::Relu(
+      s, ops::BiasAdd(s, ops::MatMul(s, embedding, w.aggregation_kernel),
+                      w.aggregation_bias));
+  auto mask = ops::Relu(
+      s, ops::BiasAdd(s, ops::MatMul(s, aggregation, w.projection_kernel),
+                      w.projection_bias));
+  auto y = ops::MatMul(s, ops::Mul(s, mask, hidden), w.output_kernel);
+  auto mean = ops::Mean(s, y, {1}, ops::Mean::KeepDims(true));
+  auto variance = ops::Mean(s, ops::SquaredDifference(s, y, mean), {1},
+                            ops::Mean::KeepDims(true));
+  auto norm = ops::Mul(s, ops::Sub(s, y, mean),
+                       ops::Rsqrt(s, ops::Add(s, variance, kEpsilon)));
+  return ops::Relu(
+      s, ops::Add(s, ops::Mul(s, norm, w.gamma), w.beta));
+}
+
+// The MaskNet blocks of modelzoo/masknet over a [batch, 432] embedding,
+// 27 features of 16 dimensions: each over the embedding in the parallel
+// model, or each over the output of the previous one in the serial model.
+static Graph* MaskNet(bool fused, bool serial, int batch, int num_blocks) {
+  const int embedding_dim = 432;
+  Scope s = Scope::NewRootScope();
+  Output embedding = RandomConst(s, {batch, embedding_dim});
+  std::vector<MaskBlockWeights> weights;
+  for (int i = 0; i < num_blocks; ++i) {
+    const int hidden_dim = (serial && i > 0) ? 64 : embedding_dim;
+    weights.emplace_back(s, embedding_dim, hidden_dim);
+  }
+  Output hidden = embedding;
+  if (!fused) {
+    for (const MaskBlockWeights& w : weights) {
+      Output output = UnfusedMaskBlock(s, w, embedding, hidden);
+      if (serial) hidden = output;
+    }
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  if (!fused) return g;
+
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  Node* embedding_node = nodes[embedding.node()->name()];
+  Node* hidden_node = embedding_node;
+  for (const MaskBlockWeights& w : weights) {
+    NodeBuilder builder(g->NewName("mask_block"), "MaskBlock");
+    builder.Input(embedding_node).Input(hidden_node);
+    for (const Output& input : w.inputs()) {
+      builder.Input(nodes[input.node()->name()]);
+    }
+    Node* block;
+    TF_CHECK_OK(builder.Attr("epsilon", kEpsilon).Finalize(g, &block));
+    if (serial) hidden_node = block;
+  }
+  return g;
+}
+
+static Graph* FusedMaskNet(bool serial, int batch, int num_blocks) {
+  return MaskNet(true, serial, batch, num_blocks);
+}
+
+static Graph* UnfusedMaskNet(bool serial, int batch, int num_blocks) {
+  return MaskNet(false, serial, batch, num_blocks);
+}
+
+#define BM_MASK_NET(KIND, MODEL, SERIAL, B, N, NTH)                        \
+  static void BM_##KIND##MODEL##MaskNet_##B##_##N##_##NTH##_CPU(int iters) { \
+    testing::UseRealTime();                                                \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                \
+    SessionOptions opts;                                                   \
+    opts.config.set_intra_op_parallelism_threads(NTH);                     \
+    test::Benchmark("cpu", KIND##MaskNet(SERIAL, B, N), &opts).Run(iters); \
+  }                                                                        \
+  BENCHMARK(BM_##KIND##MODEL##MaskNet_##B##_##N##_##NTH##_CPU);
+
+#define BM_MASK_NET_NTH(MODEL, SERIAL, B, N)    \
+  BM_MASK_NET(Fused, MODEL, SERIAL, B, N, 1);   \
+  BM_MASK_NET(Fused, MODEL, SERIAL, B, N, 8);   \
+  BM_MASK_NET(Unfused, MODEL, SERIAL, B, N, 1); \
+  BM_MASK_NET(Unfused, MODEL, SERIAL, B, N, 8);
+
+// The 5 blocks of modelzoo/masknet.
+BM_MASK_NET_NTH(Parallel, false, 512, 5);
+BM_MASK_NET_NTH(Parallel, false, 2048, 5);
+BM_MASK_NET_NTH(Serial, true, 512, 5);
+BM_MASK_NET_NTH(Serial, true, 2048, 5);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,284 @@
+/* Copyright 2023 The DeepRec Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/micro_batch_context.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+// Returns the micro batch context of the step, or nullptr if the step is
+// not split into micro batches. The caller owns a reference.
+MicroBatchContext* LookupMicroBatchContext(OpKernelContext* ctx) {
+  if (ctx->step_container() == nullptr) return nullptr;
+  MicroBatchContext* context = nullptr;
+  if (!ctx->step_container()
+           ->Lookup(ctx->resource_manager(), MicroBatchContext::kResourceName,
+                    &context)
+           .ok()) {
+    return nullptr;
+  }
+  if (context->num_micro_batches() <= 1) {
+    context->Unref();
+    return nullptr;
+  }
+  return context;
+}
+
+template <typename T>
+Status LookupOrCreateAccumulator(OpKernelContext* ctx, const string& name,
+                                 T** accumulator) {
+  return ctx->step_container()->LookupOrCreate<T>(
+      ctx->resource_manager(), name, accumulator, [](T** ret) {
+        *ret = new T;
+        return Status::OK();
+      });
+}
+
+void SetIsLast(OpKernelContext* ctx, int index, bool is_last) {
+  Tensor* out = nullptr;
+  OP_REQUIRES_OK(ctx, ctx->allocate_output(index, TensorShape({}), &out));
+  out->scalar<bool>()() = is_last;
+}
+
+// Sum of the dense gradients of the micro batches seen so far.
+class DenseGradientAccumulator : public ResourceBase {
+ public:
+  string DebugString() const override { return "DenseGradientAccumulator"; }
+
+  mutex mu;
+  Tensor sum GUARDED_BY(mu);
+};
+
+// Sparse gradients of the micro batches seen so far, merged in the last one.
+class SparseGradientAccumulator : public ResourceBase {
+ public:
+  string DebugString() const override { return "SparseGradientAccumulator"; }
+
+  mutex mu;
+  std::vector<Tensor> grads GUARDED_BY(mu);
+  std::vector<Tensor> indices GUARDED_BY(mu);
+  std::vector<Tensor> counts GUARDED_BY(mu);
+};
+
+}  // namespace
+
+template <typename T>
+class MicroBatchAccumulateOp : public OpKernel {
+ public:
+  explicit MicroBatchAccumulateOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& grad = ctx->input(0);
+    MicroBatchContext* context = LookupMicroBatchContext(ctx);
+    if (context == nullptr) {
+      ctx->set_output(0, grad);
+      SetIsLast(ctx, 1, true);
+      return;
+    }
+    core::ScopedUnref unref_context(context);
+
+    DenseGradientAccumulator* accumulator = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateAccumulator(ctx, name(), &accumulator));
+    core::ScopedUnref unref_accumulator(accumulator);
+
+    const bool is_last = context->is_last();
+    mutex_lock l(accumulator->mu);
+    if (!accumulator->sum.IsInitialized()) {
+      accumulator->sum = tensor::DeepCopy(grad);
+    } else {
+      OP_REQUIRES(ctx, accumulator->sum.shape() == grad.shape(),
+                  errors::InvalidArgument(
+                      "Gradient shape ", grad.shape().DebugString(),
+                      " of micro batch ", context->index(),
+                      " differs from ", accumulator->sum.shape().DebugString()));
+      accumulator->sum.flat<T>().device(ctx->eigen_device<CPUDevice>()) +=
+          grad.flat<T>();
+    }
+    // Only the last micro batch passes the output on to the apply op, the
+    // others are dropped by the following Switch.
+    ctx->set_output(0, is_last ? accumulator->sum : grad);
+    SetIsLast(ctx, 1, is_last);
+  }
+};
+
+template <typename T, typename Tindex>
+class MicroBatchSparseAccumulateOp : public OpKernel {
+ public:
+  explicit MicroBatchSparseAccumulateOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_counts", &num_counts_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& grad = ctx->input(0);
+    const Tensor& indices = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVectorOrHigher(grad.shape()),
+                errors::InvalidArgument("grad must be at least 1-D"));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices must be 1-D"));
+    OP_REQUIRES(ctx, indices.dim_size(0) == grad.dim_size(0),
+                errors::InvalidArgument(
+                    "grad and indices must have the same first dimension"));
+    for (int i = 0; i < num_counts_; ++i) {
+      OP_REQUIRES(ctx, ctx->input(2 + i).shape() == indices.shape(),
+                  errors::InvalidArgument(
+                      "counts and indices must have the same shape"));
+    }
+    const int is_last_index = 2 + num_counts_;
+
+    MicroBatchContext* context = LookupMicroBatchContext(ctx);
+    if (context == nullptr) {
+      ctx->set_output(0, grad);
+      ctx->set_output(1, indices);
+      for (int i = 0; i < num_counts_; ++i) {
+        ctx->set_output(2 + i, ctx->input(2 + i));
+      }
+      SetIsLast(ctx, is_last_index, true);
+      return;
+    }
+    core::ScopedUnref unref_context(context);
+
+    SparseGradientAccumulator* accumulator = nullptr;
+    OP_REQUIRES_OK(ctx, LookupOrCreateAccumulator(ctx, name(), &accumulator));
+    core::ScopedUnref unref_accumulator(accumulator);
+
+    mutex_lock l(accumulator->mu);
+    // The inputs are kept by reference until the last micro batch.
+    accumulator->grads.push_back(grad);
+    accumulator->indices.push_back(indices);
+    for (int i = 0; i < num_counts_; ++i) {
+      accumulator->counts.push_back(ctx->input(2 + i));
+    }
+    if (!context->is_last()) {
+      ctx->set_output(0, grad);
+      ctx->set_output(1, indices);
+      for (int i = 0; i < num_counts_; ++i) {
+        ctx->set_output(2 + i, ctx->input(2 + i));
+      }
+      SetIsLast(ctx, is_last_index, false);
+      return;
+    }
+    Merge(ctx, accumulator);
+    accumulator->grads.clear();
+    accumulator->indices.clear();
+    accumulator->counts.clear();
+    SetIsLast(ctx, is_last_index, true);
+  }
+
+ private:
+  // Outputs the unique indices of all micro batches in order of first
+  // occurrence, with the sum of their gradient rows and counts.
+  void Merge(OpKernelContext* ctx, SparseGradientAccumulator* accumulator)
+      EXCLUSIVE_LOCKS_REQUIRED(accumulator->mu) {
+    const TensorShape& first_shape = accumulator->grads[0].shape();
+    int64 row_size = 1;
+    for (int d = 1; d < first_shape.dims(); ++d) {
+      row_size *= first_shape.dim_size(d);
+    }
+    gtl::FlatMap<Tindex, int64> slots;
+    std::vector<Tindex> unique;
+    std::vector<int64> rows;  // Unique slot of every input row.
+    for (const Tensor& indices : accumulator->indices) {
+      auto vec = indices.vec<Tindex>();
+      for (int64 i = 0; i < vec.size(); ++i) {
+        auto it = slots.emplace(vec(i), unique.size());
+        if (it.second) unique.push_back(vec(i));
+        rows.push_back(it.first->second);
+      }
+    }
+
+    TensorShape sum_shape = first_shape;
+    sum_shape.set_dim(0, unique.size());
+    Tensor* sum = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, sum_shape, &sum));
+    auto sum_rows = sum->shaped<T, 2>({static_cast<int64>(unique.size()),
+                                       row_size});
+    sum_rows.setZero();
+    int64 row = 0;
+    for (const Tensor& grad : accumulator->grads) {
+      OP_REQUIRES(ctx, grad.NumElements() == grad.dim_size(0) * row_size,
+                  errors::InvalidArgument(
+                      "Gradient rows of the micro batches differ in size"));
+      auto grad_rows = grad.shaped<T, 2>({grad.dim_size(0), row_size});
+      for (int64 i = 0; i < grad.dim_size(0); ++i, ++row) {
+        sum_rows.template chip<0>(rows[row]) += grad_rows.template chip<0>(i);
+      }
+    }
+
+    Tensor* unique_indices = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            1, TensorShape({static_cast<int64>(unique.size())}),
+                            &unique_indices));
+    std::copy(unique.begin(), unique.end(),
+              unique_indices->vec<Tindex>().data());
+
+    for (int c = 0; c < num_counts_; ++c) {
+      Tensor* unique_counts = nullptr;
+      OP_REQUIRES_OK(
+          ctx, ctx->allocate_output(
+                   2 + c, TensorShape({static_cast<int64>(unique.size())}),
+                   &unique_counts));
+      auto out = unique_counts->vec<int64>();
+      out.setZero();
+      int64 row = 0;
+      for (size_t b = c; b < accumulator->counts.size(); b += num_counts_) {
+        auto counts = accumulator->counts[b].vec<int64>();
+        for (int64 i = 0; i < counts.size(); ++i, ++row) {
+          out(rows[row]) += counts(i);
+        }
+      }
+    }
+  }
+
+  int num_counts_;
+};
+
+#define REGISTER_KERNELS(type)                               \
+  REGISTER_KERNEL_BUILDER(Name("_MicroBatchAccumulate")      \
+                              .Device(DEVICE_CPU)            \
+                              .TypeConstraint<type>("T"),    \
+                          MicroBatchAccumulateOp<type>);
+TF_CALL_NUMBER_TYPES(REGISTER_KERNELS);
+#undef REGISTER_KERNELS
+
+#define REGISTER_KERNELS(type, index_type)                             \
+  REGISTER_KERNEL_BUILDER(Name("_MicroBatchSparseAccumulate")          \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<type>("T")               \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          MicroBatchSparseAccumulateOp<type, index_type>);
+#define REGISTER_CPU_KERNELS(type) \
+  REGISTER_KERNELS(type, int32);   \
+  REGISTER_KERNELS(type, int64);
+TF_CALL_NUMBER_TYPES(REGISTER_CPU_KERNELS);
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
@@ -0,0 +1,190 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Eigen::RowVectorXf> RowVectorMap;
+typedef Eigen::Map<const Eigen::RowVectorXf> ConstRowVectorMap;
+
+// Rows of a GroupedDense task. The layers are split into tasks of kRowBlock
+// rows of one layer, which are scheduled together, so that small layers
+// use all the threads instead of one multithreaded GEMM after the other.
+constexpr int64 kRowBlock = 64;
+
+struct GroupedDenseTask {
+  int64 layer;
+  int64 row;
+};
+
+}  // namespace
+
+// N dense layers in one op, see the GroupedDense op. Each task is a
+// single-threaded GEMM of kRowBlock rows of a layer with its kernel,
+// followed by the bias and activation while the rows are in cache.
+template <typename T>
+class GroupedDenseOp : public OpKernel {
+ public:
+  explicit GroupedDenseOp(OpKernelConstruction* context) : OpKernel(context) {
+    string activation;
+    OP_REQUIRES_OK(context, context->GetAttr("activation", &activation));
+    relu_ = activation == "Relu";
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OpInputList inputs;
+    OpInputList kernels;
+    OpInputList biases;
+    OP_REQUIRES_OK(context, context->input_list("inputs", &inputs));
+    OP_REQUIRES_OK(context, context->input_list("kernels", &kernels));
+    OP_REQUIRES_OK(context, context->input_list("biases", &biases));
+    OpOutputList outputs;
+    OP_REQUIRES_OK(context, context->output_list("outputs", &outputs));
+    const int64 n = kernels.size();
+    OP_REQUIRES(context, inputs.size() == 1 || inputs.size() == n,
+                errors::InvalidArgument("Expected 1 or ", n, " inputs, got ",
+                                        inputs.size()));
+
+    std::vector<GroupedDenseTask> tasks;
+    int64 flops = 0;
+    for (int64 i = 0; i < n; ++i) {
+      const Tensor& input = inputs[inputs.size() > 1 ? i : 0];
+      OP_REQUIRES(context, input.dims() == 2,
+                  errors::InvalidArgument("inputs[", i, "] must be 2-D, got ",
+                                          input.shape().DebugString()));
+      OP_REQUIRES(context,
+                  kernels[i].dims() == 2 &&
+                      kernels[i].dim_size(0) == input.dim_size(1),
+                  errors::InvalidArgument(
+                      "kernels[", i, "] must be [", input.dim_size(1),
+                      ", U], got ", kernels[i].shape().DebugString()));
+      const int64 units = kernels[i].dim_size(1);
+      OP_REQUIRES(context, biases[i].shape() == TensorShape({units}),
+                  errors::InvalidArgument("biases[", i, "] must be [", units,
+                                          "], got ",
+                                          biases[i].shape().DebugString()));
+      Tensor* output = nullptr;
+      OP_REQUIRES_OK(context, outputs.allocate(
+                                  i, TensorShape({input.dim_size(0), units}),
+                                  &output));
+      for (int64 row = 0; row < input.dim_size(0); row += kRowBlock) {
+        tasks.push_back({i, row});
+      }
+      flops = std::max(flops, 2 * input.dim_size(1) * units + 2 * units);
+    }
+    if (tasks.empty()) return;
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        tasks.size(), kRowBlock * flops, [&](int64 begin, int64 end) {
+          for (int64 t = begin; t < end; ++t) {
+            const int64 i = tasks[t].layer;
+            const Tensor& input = inputs[inputs.size() > 1 ? i : 0];
+            const int64 k = input.dim_size(1);
+            const int64 u = kernels[i].dim_size(1);
+            const int64 row = tasks[t].row;
+            const int64 rows = std::min(kRowBlock, input.dim_size(0) - row);
+            MatrixMap output(outputs[i]->flat<T>().data() + row * u, rows, u);
+            output.noalias() =
+                ConstMatrixMap(input.flat<T>().data() + row * k, rows, k) *
+                ConstMatrixMap(kernels[i].flat<T>().data(), k, u);
+            output.rowwise() +=
+                ConstRowVectorMap(biases[i].flat<T>().data(), u);
+            if (relu_) output = output.cwiseMax(0.0f);
+          }
+        });
+  }
+
+ private:
+  bool relu_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("GroupedDense").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GroupedDenseOp<float>);
+
+// Gated combine of experts, see the GatedExpertCombine op. Each output row
+// is accumulated from the expert rows, instead of stacking the experts into
+// a [B, N, D] tensor and multiplying it by the broadcast gate.
+template <typename T>
+class GatedExpertCombineOp : public OpKernel {
+ public:
+  explicit GatedExpertCombineOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("softmax", &softmax_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OpInputList experts;
+    OP_REQUIRES_OK(context, context->input_list("experts", &experts));
+    const int64 n = experts.size();
+    const Tensor& gate = context->input(n);
+    OP_REQUIRES(context, experts[0].dims() == 2,
+                errors::InvalidArgument("experts[0] must be 2-D, got ",
+                                        experts[0].shape().DebugString()));
+    for (int64 i = 1; i < n; ++i) {
+      OP_REQUIRES(context, experts[i].shape() == experts[0].shape(),
+                  errors::InvalidArgument(
+                      "experts[", i, "] must be ",
+                      experts[0].shape().DebugString(), ", got ",
+                      experts[i].shape().DebugString()));
+    }
+    const int64 batch = experts[0].dim_size(0);
+    const int64 d = experts[0].dim_size(1);
+    OP_REQUIRES(context, gate.shape() == TensorShape({batch, n}),
+                errors::InvalidArgument("gate must be [", batch, ", ", n,
+                                        "], got ",
+                                        gate.shape().DebugString()));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, experts[0].shape(), &output_tensor));
+    if (output_tensor->NumElements() == 0) return;
+    T* output = output_tensor->flat<T>().data();
+    const T* gates = gate.flat<T>().data();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        batch, n * (2 * d + 4), [&](int64 begin, int64 end) {
+          Eigen::RowVectorXf weights(n);
+          for (int64 b = begin; b < end; ++b) {
+            weights = ConstRowVectorMap(gates + b * n, n);
+            if (softmax_) {
+              weights = (weights.array() - weights.maxCoeff()).exp();
+              weights /= weights.sum();
+            }
+            RowVectorMap out(output + b * d, d);
+            out = weights(0) *
+                  ConstRowVectorMap(experts[0].flat<T>().data() + b * d, d);
+            for (int64 i = 1; i < n; ++i) {
+              out += weights(i) *
+                     ConstRowVectorMap(experts[i].flat<T>().data() + b * d, d);
+            }
+          }
+        });
+  }
+
+ private:
+  bool softmax_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("GatedExpertCombine").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    GatedExpertCombineOp<float>);
+
+}  // namespace tensorflow
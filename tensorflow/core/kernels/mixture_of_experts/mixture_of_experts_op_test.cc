@@ -0,0 +1,281 @@
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+std::vector<float> Fill(int n, int seed) {
+  std::vector<float> v(n);
+  for (int i = 0; i < n; ++i) v[i] = std::sin(0.37f * i + 0.11f * seed);
+  return v;
+}
+
+class GroupedDenseOpTest : public OpsTestBase {
+ protected:
+  // Runs n layers of `units` units on inputs of `rows[i]` rows, shared if
+  // there is only one, and checks them against the unfused layers.
+  void ExpectMatchesUnfused(int n, const std::vector<int>& rows, int depth,
+                            int units, const string& activation) {
+    const int num_inputs = rows.size();
+    TF_EXPECT_OK(NodeDefBuilder("grouped_dense", "GroupedDense")
+                     .Input(FakeInput(num_inputs, DT_FLOAT))
+                     .Input(FakeInput(n, DT_FLOAT))
+                     .Input(FakeInput(n, DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("N", n)
+                     .Attr("num_inputs", num_inputs)
+                     .Attr("activation", activation)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+    std::vector<std::vector<float>> inputs;
+    for (int i = 0; i < num_inputs; ++i) {
+      inputs.push_back(Fill(rows[i] * depth, i));
+      AddInputFromArray<float>(TensorShape({rows[i], depth}), inputs[i]);
+    }
+    std::vector<std::vector<float>> kernels;
+    for (int i = 0; i < n; ++i) {
+      kernels.push_back(Fill(depth * units, 10 + i));
+      AddInputFromArray<float>(TensorShape({depth, units}), kernels[i]);
+    }
+    std::vector<std::vector<float>> biases;
+    for (int i = 0; i < n; ++i) {
+      biases.push_back(Fill(units, 20 + i));
+      AddInputFromArray<float>(TensorShape({units}), biases[i]);
+    }
+    TF_ASSERT_OK(RunOpKernel());
+
+    for (int i = 0; i < n; ++i) {
+      const int input = num_inputs > 1 ? i : 0;
+      const int m = rows[input];
+      Tensor expected(DT_FLOAT, TensorShape({m, units}));
+      for (int r = 0; r < m; ++r) {
+        for (int u = 0; u < units; ++u) {
+          double value = biases[i][u];
+          for (int k = 0; k < depth; ++k) {
+            value += inputs[input][r * depth + k] * kernels[i][k * units + u];
+          }
+          if (activation == "Relu") value = std::max(value, 0.0);
+          expected.matrix<float>()(r, u) = value;
+        }
+      }
+      test::ExpectTensorNear<float>(expected, *GetOutput(i), 1e-5);
+    }
+  }
+};
+
+TEST_F(GroupedDenseOpTest, SharedInput) {
+  ExpectMatchesUnfused(3, {5}, 7, 4, "Relu");
+}
+
+TEST_F(GroupedDenseOpTest, SharedInputOfSeveralRowBlocks) {
+  ExpectMatchesUnfused(2, {150}, 9, 6, "None");
+}
+
+TEST_F(GroupedDenseOpTest, Inputs) {
+  ExpectMatchesUnfused(3, {5, 70, 0}, 7, 4, "Relu");
+}
+
+class GatedExpertCombineOpTest : public OpsTestBase {
+ protected:
+  void ExpectMatchesUnfused(int n, int batch, int dim, bool softmax) {
+    TF_EXPECT_OK(NodeDefBuilder("gated_expert_combine", "GatedExpertCombine")
+                     .Input(FakeInput(n, DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("N", n)
+                     .Attr("softmax", softmax)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+    std::vector<std::vector<float>> experts;
+    for (int i = 0; i < n; ++i) {
+      experts.push_back(Fill(batch * dim, i));
+      AddInputFromArray<float>(TensorShape({batch, dim}), experts[i]);
+    }
+    const std::vector<float> gate = Fill(batch * n, n);
+    AddInputFromArray<float>(TensorShape({batch, n}), gate);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({batch, dim}));
+    for (int b = 0; b < batch; ++b) {
+      std::vector<double> weights(gate.begin() + b * n,
+                                  gate.begin() + (b + 1) * n);
+      if (softmax) {
+        double sum = 0;
+        for (double& w : weights) sum += (w = std::exp(w));
+        for (double& w : weights) w /= sum;
+      }
+      for (int j = 0; j < dim; ++j) {
+        double value = 0;
+        for (int i = 0; i < n; ++i) {
+          value += weights[i] * experts[i][b * dim + j];
+        }
+        expected.matrix<float>()(b, j) = value;
+      }
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  }
+};
+
+TEST_F(GatedExpertCombineOpTest, MatchesUnfused) {
+  ExpectMatchesUnfused(3, 5, 7, false);
+}
+
+TEST_F(GatedExpertCombineOpTest, MatchesUnfusedWithSoftmax) {
+  ExpectMatchesUnfused(4, 5, 7, true);
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+static Output RandomConst(const Scope& s, const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return ops::Const(s, Input::Initializer(t));
+}
+
+static Graph* ToGraph(const Scope& s) {
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+static Node* FindNode(Graph* g, const Output& output) {
+  for (Node* node : g->nodes()) {
+    if (node->name() == output.node()->name()) return node;
+  }
+  return nullptr;
+}
+
+// n experts of `units` units with ReLU on a shared [batch, depth] input.
+static Graph* FusedExperts(int n, int batch, int depth, int units) {
+  Scope s = Scope::NewRootScope();
+  Output input = RandomConst(s, {batch, depth});
+  std::vector<Output> kernels;
+  std::vector<Output> biases;
+  for (int i = 0; i < n; ++i) {
+    kernels.push_back(RandomConst(s, {depth, units}));
+    biases.push_back(RandomConst(s, {units}));
+  }
+  Graph* g = ToGraph(s);
+  std::vector<NodeBuilder::NodeOut> kernel_nodes;
+  std::vector<NodeBuilder::NodeOut> bias_nodes;
+  for (int i = 0; i < n; ++i) {
+    kernel_nodes.emplace_back(FindNode(g, kernels[i]));
+    bias_nodes.emplace_back(FindNode(g, biases[i]));
+  }
+  TF_CHECK_OK(NodeBuilder(g->NewName("grouped_dense"), "GroupedDense")
+                  .Input(std::vector<NodeBuilder::NodeOut>{
+                      NodeBuilder::NodeOut(FindNode(g, input))})
+                  .Input(kernel_nodes)
+                  .Input(bias_nodes)
+                  .Attr("num_inputs", 1)
+                  .Attr("activation", "Relu")
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// The expert layers of modelzoo/mmoe and modelzoo/ple.
+static Graph* UnfusedExperts(int n, int batch, int depth, int units) {
+  Scope s = Scope::NewRootScope();
+  Output input = RandomConst(s, {batch, depth});
+  for (int i = 0; i < n; ++i) {
+    ops::Relu(s, ops::BiasAdd(s,
+                              ops::MatMul(s, input,
+                                          RandomConst(s, {depth, units})),
+                              RandomConst(s, {units})));
+  }
+  return ToGraph(s);
+}
+
+#define BM_EXPERTS(KIND, N, B, K, U, NTH)                                    \
+  static void BM_##KIND##Experts_##N##_##B##_##K##_##U##_##NTH##_CPU(        \
+      int iters) {                                                           \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                  \
+    SessionOptions opts;                                                     \
+    opts.config.set_intra_op_parallelism_threads(NTH);                       \
+    test::Benchmark("cpu", KIND##Experts(N, B, K, U), &opts).Run(iters);     \
+  }                                                                          \
+  BENCHMARK(BM_##KIND##Experts_##N##_##B##_##K##_##U##_##NTH##_CPU);
+
+#define BM_EXPERTS_NTH(N, B, K, U)      \
+  BM_EXPERTS(Fused, N, B, K, U, 1);     \
+  BM_EXPERTS(Fused, N, B, K, U, 8);     \
+  BM_EXPERTS(Unfused, N, B, K, U, 1);   \
+  BM_EXPERTS(Unfused, N, B, K, U, 8);
+
+// The first layer of the 5 experts of a modelzoo/ple extraction layer, and
+// of the 4 experts of modelzoo/mmoe, on 512 embedding features.
+BM_EXPERTS_NTH(5, 512, 512, 256);
+BM_EXPERTS_NTH(5, 2048, 512, 256);
+BM_EXPERTS_NTH(4, 2048, 512, 256);
+// The last expert layer of modelzoo/ple.
+BM_EXPERTS_NTH(5, 2048, 128, 64);
+
+static Graph* FusedCombine(int n, int batch, int dim) {
+  Scope s = Scope::NewRootScope();
+  std::vector<Output> experts;
+  for (int i = 0; i < n; ++i) experts.push_back(RandomConst(s, {batch, dim}));
+  Output gate = RandomConst(s, {batch, n});
+  Graph* g = ToGraph(s);
+  std::vector<NodeBuilder::NodeOut> expert_nodes;
+  for (const Output& expert : experts) {
+    expert_nodes.emplace_back(FindNode(g, expert));
+  }
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("gated_expert_combine"), "GatedExpertCombine")
+          .Input(expert_nodes)
+          .Input(FindNode(g, gate))
+          .Attr("softmax", true)
+          .Finalize(g, nullptr));
+  return g;
+}
+
+// The gated combine of a modelzoo/mmoe tower.
+static Graph* UnfusedCombine(int n, int batch, int dim) {
+  Scope s = Scope::NewRootScope();
+  std::vector<Output> experts;
+  for (int i = 0; i < n; ++i) experts.push_back(RandomConst(s, {batch, dim}));
+  auto gate = ops::ExpandDims(s, ops::Softmax(s, RandomConst(s, {batch, n})),
+                              -1);
+  ops::Sum(s, ops::Mul(s, ops::Stack(s, experts, ops::Stack::Axis(1)), gate),
+           1);
+  return ToGraph(s);
+}
+
+#define BM_COMBINE(KIND, N, B, D, NTH)                                       \
+  static void BM_##KIND##Combine_##N##_##B##_##D##_##NTH##_CPU(int iters) {  \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                  \
+    SessionOptions opts;                                                     \
+    opts.config.set_intra_op_parallelism_threads(NTH);                       \
+    test::Benchmark("cpu", KIND##Combine(N, B, D), &opts).Run(iters);        \
+  }                                                                          \
+  BENCHMARK(BM_##KIND##Combine_##N##_##B##_##D##_##NTH##_CPU);
+
+#define BM_COMBINE_NTH(N, B, D)      \
+  BM_COMBINE(Fused, N, B, D, 1);     \
+  BM_COMBINE(Fused, N, B, D, 8);     \
+  BM_COMBINE(Unfused, N, B, D, 1);   \
+  BM_COMBINE(Unfused, N, B, D, 8);
+
+BM_COMBINE_NTH(5, 2048, 64);
+BM_COMBINE_NTH(4, 2048, 256);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,424 @@
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<Matrix> MatrixMap;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+// The columns of one head in a [T, D] matrix.
+typedef Eigen::Map<Matrix, 0, Eigen::OuterStride<>> HeadMap;
+typedef Eigen::Map<const Matrix, 0, Eigen::OuterStride<>> ConstHeadMap;
+
+// Queries and keys are processed in blocks of these sizes, so that the
+// scores of a block stay in L1 and the packed keys and values of a head in
+// L2 for typical head sizes.
+const int64 kQueryBlock = 32;
+const int64 kKeyBlock = 64;
+
+struct MultiHeadAttentionShape {
+  int64 batch = 0;
+  int64 query_len = 0;
+  int64 key_len = 0;
+  int64 dim = 0;
+  int64 value_dim = 0;
+  int64 head_count = 0;
+
+  int64 head_dim() const { return dim / head_count; }
+  int64 head_value_dim() const { return value_dim / head_count; }
+
+  // Flops of one head of one batch row.
+  int64 HeadCost() const {
+    return query_len * key_len * (2 * head_dim() + 2 * head_value_dim() + 20);
+  }
+};
+
+// Checks the inputs shared by the forward and backward ops, which start at
+// input `first`.
+Status GetMultiHeadAttentionShape(OpKernelContext* context, int first,
+                                  int64 head_count,
+                                  MultiHeadAttentionShape* shape) {
+  const Tensor& query = context->input(first);
+  const Tensor& key = context->input(first + 1);
+  const Tensor& value = context->input(first + 2);
+  const Tensor& key_mask = context->input(first + 3);
+  if (query.dims() != 3 || key.dims() != 3 || value.dims() != 3) {
+    return errors::InvalidArgument(
+        "query, key and value must be 3-D, got ", query.shape().DebugString(),
+        ", ", key.shape().DebugString(), " and ", value.shape().DebugString());
+  }
+  shape->batch = query.dim_size(0);
+  shape->query_len = query.dim_size(1);
+  shape->dim = query.dim_size(2);
+  shape->key_len = key.dim_size(1);
+  shape->value_dim = value.dim_size(2);
+  shape->head_count = head_count;
+  if (key.dim_size(0) != shape->batch || key.dim_size(2) != shape->dim) {
+    return errors::InvalidArgument("key must be [", shape->batch, ", Tk, ",
+                                   shape->dim, "], got ",
+                                   key.shape().DebugString());
+  }
+  if (value.dim_size(0) != shape->batch ||
+      value.dim_size(1) != shape->key_len) {
+    return errors::InvalidArgument("value must be [", shape->batch, ", ",
+                                   shape->key_len, ", Dv], got ",
+                                   value.shape().DebugString());
+  }
+  if (key_mask.dims() != 2 || key_mask.dim_size(0) != shape->batch ||
+      key_mask.dim_size(1) != shape->key_len) {
+    return errors::InvalidArgument("key_mask must be [", shape->batch, ", ",
+                                   shape->key_len, "], got ",
+                                   key_mask.shape().DebugString());
+  }
+  if (shape->dim % head_count != 0 || shape->value_dim % head_count != 0) {
+    return errors::InvalidArgument(
+        "The last dimensions of query and value, ", shape->dim, " and ",
+        shape->value_dim, ", must be multiples of head_count ", head_count);
+  }
+  return Status::OK();
+}
+
+// One head of one batch row. The keys and values of the unmasked positions
+// are packed into contiguous buffers, so masked positions cost nothing.
+class AttentionHead {
+ public:
+  AttentionHead(OpKernelContext* context, int first,
+                const MultiHeadAttentionShape& shape, float scale)
+      : shape_(shape),
+        scale_(scale),
+        query_(context->input(first).flat<float>().data()),
+        key_(context->input(first + 1).flat<float>().data()),
+        value_(context->input(first + 2).flat<float>().data()),
+        key_mask_(context->input(first + 3).flat<bool>().data()) {
+    valid_.reserve(shape_.key_len);
+    keys_.resize(shape_.key_len * shape_.head_dim());
+    values_.resize(shape_.key_len * shape_.head_value_dim());
+    scores_.resize(kQueryBlock * kKeyBlock);
+  }
+
+  // Packs the keys and values of head `h` of row `b`. Rows without any
+  // unmasked key attend to all keys, like the unfused -1e9 padding does.
+  void Pack(int64 b, int64 h) {
+    const int64 dk = shape_.head_dim();
+    const int64 dv = shape_.head_value_dim();
+    const bool* mask = key_mask_ + b * shape_.key_len;
+    valid_.clear();
+    for (int64 i = 0; i < shape_.key_len; ++i) {
+      if (mask[i]) valid_.push_back(i);
+    }
+    if (valid_.empty()) {
+      for (int64 i = 0; i < shape_.key_len; ++i) valid_.push_back(i);
+    }
+    const float* key = key_ + b * shape_.key_len * shape_.dim + h * dk;
+    const float* value =
+        value_ + b * shape_.key_len * shape_.value_dim + h * dv;
+    for (int64 i = 0; i < num_valid(); ++i) {
+      std::copy_n(key + valid_[i] * shape_.dim, dk, keys_.data() + i * dk);
+      std::copy_n(value + valid_[i] * shape_.value_dim, dv,
+                  values_.data() + i * dv);
+    }
+  }
+
+  ConstHeadMap Query(int64 b, int64 h, int64 begin, int64 rows) const {
+    return ConstHeadMap(
+        query_ + (b * shape_.query_len + begin) * shape_.dim +
+            h * shape_.head_dim(),
+        rows, shape_.head_dim(), Eigen::OuterStride<>(shape_.dim));
+  }
+
+  ConstMatrixMap Keys(int64 begin, int64 rows) const {
+    return ConstMatrixMap(keys_.data() + begin * shape_.head_dim(), rows,
+                          shape_.head_dim());
+  }
+
+  ConstMatrixMap Values(int64 begin, int64 rows) const {
+    return ConstMatrixMap(values_.data() + begin * shape_.head_value_dim(),
+                          rows, shape_.head_value_dim());
+  }
+
+  // The scaled scores of a block of queries and packed keys.
+  MatrixMap Scores(const ConstHeadMap& query, int64 key_begin,
+                   int64 key_rows) {
+    MatrixMap scores(scores_.data(), query.rows(), key_rows);
+    scores.noalias() = query * Keys(key_begin, key_rows).transpose();
+    scores *= scale_;
+    return scores;
+  }
+
+  int64 num_valid() const { return valid_.size(); }
+  int64 valid(int64 i) const { return valid_[i]; }
+  float scale() const { return scale_; }
+
+ private:
+  const MultiHeadAttentionShape& shape_;
+  const float scale_;
+  const float* query_;
+  const float* key_;
+  const float* value_;
+  const bool* key_mask_;
+
+  std::vector<int64> valid_;
+  std::vector<float> keys_;
+  std::vector<float> values_;
+  std::vector<float> scores_;
+};
+
+}  // namespace
+
+// Fused multi-head attention, see the MultiHeadAttention op. Each head of
+// each batch row is computed by one thread, block by block with an online
+// softmax, so the [B, head_count, Tq, Tk] scores are never materialized.
+template <typename T>
+class MultiHeadAttentionOp : public OpKernel {
+ public:
+  explicit MultiHeadAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("head_count", &head_count_));
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    MultiHeadAttentionShape shape;
+    OP_REQUIRES_OK(context,
+                   GetMultiHeadAttentionShape(context, 0, head_count_, &shape));
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0,
+                       TensorShape({shape.batch, shape.query_len,
+                                    shape.value_dim}),
+                       &output_tensor));
+    Tensor* logsumexp_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       1,
+                       TensorShape({shape.batch, shape.head_count,
+                                    shape.query_len}),
+                       &logsumexp_tensor));
+    if (shape.key_len == 0) {
+      output_tensor->flat<T>().setZero();
+      logsumexp_tensor->flat<T>().setConstant(
+          -std::numeric_limits<T>::infinity());
+      return;
+    }
+    T* output = output_tensor->flat<T>().data();
+    T* logsumexp = logsumexp_tensor->flat<T>().data();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        shape.batch * shape.head_count, shape.HeadCost(),
+        [&](int64 begin, int64 end) {
+          AttentionHead head(context, 0, shape, scale_);
+          std::vector<float> buffer(kQueryBlock * (2 + shape.head_value_dim()));
+          for (int64 i = begin; i < end; ++i) {
+            const int64 b = i / shape.head_count;
+            const int64 h = i % shape.head_count;
+            head.Pack(b, h);
+            for (int64 q = 0; q < shape.query_len; q += kQueryBlock) {
+              ForwardBlock(shape, b, h, q,
+                           std::min(kQueryBlock, shape.query_len - q),
+                           buffer.data(), &head, output,
+                           logsumexp + i * shape.query_len + q);
+            }
+          }
+        });
+  }
+
+ private:
+  void ForwardBlock(const MultiHeadAttentionShape& shape, int64 b, int64 h,
+                    int64 query_begin, int64 rows, float* buffer,
+                    AttentionHead* head, float* output, float* logsumexp) {
+    const int64 dv = shape.head_value_dim();
+    Eigen::Map<Eigen::VectorXf> row_max(buffer, rows);
+    Eigen::Map<Eigen::VectorXf> row_sum(buffer + rows, rows);
+    HeadMap out(output + (b * shape.query_len + query_begin) * shape.value_dim +
+                    h * dv,
+                rows, dv, Eigen::OuterStride<>(shape.value_dim));
+    row_max.setConstant(-std::numeric_limits<float>::infinity());
+    row_sum.setZero();
+    out.setZero();
+
+    ConstHeadMap query = head->Query(b, h, query_begin, rows);
+    const int64 n = head->num_valid();
+    for (int64 k = 0; k < n; k += kKeyBlock) {
+      const int64 cols = std::min(kKeyBlock, n - k);
+      MatrixMap scores = head->Scores(query, k, cols);
+      for (int64 r = 0; r < rows; ++r) {
+        const float new_max = std::max(row_max(r), scores.row(r).maxCoeff());
+        const float correction = std::exp(row_max(r) - new_max);
+        row_max(r) = new_max;
+        scores.row(r) = (scores.row(r).array() - new_max).exp().matrix();
+        row_sum(r) = row_sum(r) * correction + scores.row(r).sum();
+        out.row(r) *= correction;
+      }
+      out.noalias() += scores * head->Values(k, cols);
+    }
+    for (int64 r = 0; r < rows; ++r) {
+      out.row(r) /= row_sum(r);
+      logsumexp[r] = row_max(r) + std::log(row_sum(r));
+    }
+  }
+
+  int64 head_count_;
+  float scale_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("MultiHeadAttention").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    MultiHeadAttentionOp<float>);
+
+// Gradients of MultiHeadAttention. The attention weights of each block are
+// recomputed from logsumexp. Every head of every batch row writes its own
+// slices of the gradients, so the result does not depend on scheduling.
+template <typename T>
+class MultiHeadAttentionGradOp : public OpKernel {
+ public:
+  explicit MultiHeadAttentionGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("head_count", &head_count_));
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    MultiHeadAttentionShape shape;
+    OP_REQUIRES_OK(context,
+                   GetMultiHeadAttentionShape(context, 1, head_count_, &shape));
+    const TensorShape output_shape(
+        {shape.batch, shape.query_len, shape.value_dim});
+    const TensorShape logsumexp_shape(
+        {shape.batch, shape.head_count, shape.query_len});
+    const Tensor& output_grad = context->input(0);
+    const Tensor& output = context->input(5);
+    const Tensor& logsumexp = context->input(6);
+    OP_REQUIRES(context,
+                output_grad.shape() == output_shape &&
+                    output.shape() == output_shape,
+                errors::InvalidArgument(
+                    "output_grad and output must be ",
+                    output_shape.DebugString(), ", got ",
+                    output_grad.shape().DebugString(), " and ",
+                    output.shape().DebugString()));
+    OP_REQUIRES(context, logsumexp.shape() == logsumexp_shape,
+                errors::InvalidArgument("logsumexp must be ",
+                                        logsumexp_shape.DebugString(),
+                                        ", got ",
+                                        logsumexp.shape().DebugString()));
+
+    Tensor* grads[3];
+    for (int i = 0; i < 3; ++i) {
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  i, context->input(i + 1).shape(), &grads[i]));
+      grads[i]->flat<T>().setZero();
+    }
+    if (shape.key_len == 0) return;
+
+    const float* dout = output_grad.flat<T>().data();
+    const float* out = output.flat<T>().data();
+    const float* lse = logsumexp.flat<T>().data();
+    float* dquery = grads[0]->flat<T>().data();
+    float* dkey = grads[1]->flat<T>().data();
+    float* dvalue = grads[2]->flat<T>().data();
+    const int64 dk = shape.head_dim();
+    const int64 dv = shape.head_value_dim();
+
+    auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    worker_threads.workers->ParallelFor(
+        shape.batch * shape.head_count, 2 * shape.HeadCost(),
+        [&](int64 begin, int64 end) {
+          AttentionHead head(context, 1, shape, scale_);
+          std::vector<float> dkeys(shape.key_len * dk);
+          std::vector<float> dvalues(shape.key_len * dv);
+          std::vector<float> buffer(kQueryBlock * (kKeyBlock + 1));
+          for (int64 i = begin; i < end; ++i) {
+            const int64 b = i / shape.head_count;
+            const int64 h = i % shape.head_count;
+            head.Pack(b, h);
+            const int64 n = head.num_valid();
+            MatrixMap dk_packed(dkeys.data(), n, dk);
+            MatrixMap dv_packed(dvalues.data(), n, dv);
+            dk_packed.setZero();
+            dv_packed.setZero();
+            for (int64 q = 0; q < shape.query_len; q += kQueryBlock) {
+              const int64 rows = std::min(kQueryBlock, shape.query_len - q);
+              const int64 offset =
+                  (b * shape.query_len + q) * shape.value_dim + h * dv;
+              BackwardBlock(
+                  b, h, q, rows,
+                  ConstHeadMap(dout + offset, rows, dv,
+                               Eigen::OuterStride<>(shape.value_dim)),
+                  ConstHeadMap(out + offset, rows, dv,
+                               Eigen::OuterStride<>(shape.value_dim)),
+                  lse + i * shape.query_len + q, buffer.data(), &head,
+                  HeadMap(dquery + (b * shape.query_len + q) * shape.dim +
+                              h * dk,
+                          rows, dk, Eigen::OuterStride<>(shape.dim)),
+                  &dk_packed, &dv_packed);
+            }
+            // Scatter the gradients of the unmasked keys and values.
+            for (int64 j = 0; j < n; ++j) {
+              const int64 t = b * shape.key_len + head.valid(j);
+              std::copy_n(dkeys.data() + j * dk, dk,
+                          dkey + t * shape.dim + h * dk);
+              std::copy_n(dvalues.data() + j * dv, dv,
+                          dvalue + t * shape.value_dim + h * dv);
+            }
+          }
+        });
+  }
+
+ private:
+  void BackwardBlock(int64 b, int64 h, int64 query_begin, int64 rows,
+                     const ConstHeadMap& dout, const ConstHeadMap& out,
+                     const float* logsumexp, float* buffer,
+                     AttentionHead* head, HeadMap dquery, MatrixMap* dkeys,
+                     MatrixMap* dvalues) {
+    // delta = rowsum(dout * out), the softmax term shared by all keys.
+    Eigen::Map<Eigen::VectorXf> delta(buffer, rows);
+    delta = dout.cwiseProduct(out).rowwise().sum();
+    Eigen::Map<const Eigen::VectorXf> lse(logsumexp, rows);
+
+    ConstHeadMap query = head->Query(b, h, query_begin, rows);
+    const int64 n = head->num_valid();
+    for (int64 k = 0; k < n; k += kKeyBlock) {
+      const int64 cols = std::min(kKeyBlock, n - k);
+      // The attention weights of the block.
+      MatrixMap weights = head->Scores(query, k, cols);
+      weights.colwise() -= lse;
+      weights = weights.array().exp().matrix();
+      dvalues->middleRows(k, cols).noalias() += weights.transpose() * dout;
+
+      MatrixMap ds(buffer + kQueryBlock, rows, cols);
+      ds.noalias() = dout * head->Values(k, cols).transpose();
+      ds.colwise() -= delta;
+      ds = (ds.array() * weights.array() * head->scale()).matrix();
+      dquery.noalias() += ds * head->Keys(k, cols);
+      dkeys->middleRows(k, cols).noalias() += ds.transpose() * query;
+    }
+  }
+
+  int64 head_count_;
+  float scale_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiHeadAttentionGrad")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        MultiHeadAttentionGradOp<float>);
+
+}  // namespace tensorflow
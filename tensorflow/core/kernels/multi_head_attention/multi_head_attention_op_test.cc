@@ -0,0 +1,291 @@
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+// Inputs of a multi-head attention layer, the first batch row partly
+// masked and the last one fully masked.
+struct MultiHeadAttentionInputs {
+  MultiHeadAttentionInputs(int batch, int query_len, int key_len, int dim,
+                           int value_dim, int head_count, float scale)
+      : batch(batch), query_len(query_len), key_len(key_len), dim(dim),
+        value_dim(value_dim), head_count(head_count), scale(scale) {
+    Fill(&query, batch * query_len * dim);
+    Fill(&key, batch * key_len * dim);
+    Fill(&value, batch * key_len * value_dim);
+    key_mask.assign(batch * key_len, true);
+    key_mask[1] = false;
+    key_mask[key_len - 1] = false;
+    for (int t = 0; t < key_len; ++t) {
+      key_mask[(batch - 1) * key_len + t] = false;
+    }
+  }
+
+  void Fill(std::vector<float>* v, int n) {
+    v->resize(n);
+    for (int i = 0; i < n; ++i) {
+      (*v)[i] = std::sin(0.37f * i + 0.11f * n);
+    }
+  }
+
+  // The unfused computation of output[b, t, :].
+  std::vector<double> Output(int b, int t) const {
+    const int dk = dim / head_count;
+    const int dv = value_dim / head_count;
+    bool any_valid = false;
+    for (int k = 0; k < key_len; ++k) any_valid |= key_mask[b * key_len + k];
+    std::vector<double> output(value_dim, 0.0);
+    for (int h = 0; h < head_count; ++h) {
+      std::vector<double> weights(key_len);
+      double max_score = -std::numeric_limits<double>::infinity();
+      for (int k = 0; k < key_len; ++k) {
+        double score = 0;
+        for (int i = 0; i < dk; ++i) {
+          score += query[(b * query_len + t) * dim + h * dk + i] *
+                   key[(b * key_len + k) * dim + h * dk + i];
+        }
+        weights[k] = any_valid && !key_mask[b * key_len + k]
+                         ? -std::numeric_limits<double>::infinity()
+                         : scale * score;
+        max_score = std::max(max_score, weights[k]);
+      }
+      double sum = 0;
+      for (double& w : weights) {
+        w = std::exp(w - max_score);
+        sum += w;
+      }
+      for (int k = 0; k < key_len; ++k) {
+        const float* v = &value[(b * key_len + k) * value_dim + h * dv];
+        for (int j = 0; j < dv; ++j) {
+          output[h * dv + j] += weights[k] / sum * v[j];
+        }
+      }
+    }
+    return output;
+  }
+
+  // sum(output * output_grad).
+  double Loss(const std::vector<float>& output_grad) const {
+    double loss = 0;
+    for (int b = 0; b < batch; ++b) {
+      for (int t = 0; t < query_len; ++t) {
+        std::vector<double> output = Output(b, t);
+        for (int j = 0; j < value_dim; ++j) {
+          loss += output[j] * output_grad[(b * query_len + t) * value_dim + j];
+        }
+      }
+    }
+    return loss;
+  }
+
+  int batch, query_len, key_len, dim, value_dim, head_count;
+  float scale;
+  std::vector<float> query, key, value;
+  std::vector<bool> key_mask;
+};
+
+class MultiHeadAttentionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const MultiHeadAttentionInputs& in) {
+    NodeDefBuilder builder("multi_head_attention", op);
+    if (op == "MultiHeadAttentionGrad") builder.Input(FakeInput(DT_FLOAT));
+    builder.Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_BOOL));
+    if (op == "MultiHeadAttentionGrad") {
+      builder.Input(FakeInput(DT_FLOAT)).Input(FakeInput(DT_FLOAT));
+    }
+    TF_EXPECT_OK(builder.Attr("T", DT_FLOAT)
+                     .Attr("head_count", in.head_count)
+                     .Attr("scale", in.scale)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+
+  void AddInputs(const MultiHeadAttentionInputs& in) {
+    AddInputFromArray<float>(
+        TensorShape({in.batch, in.query_len, in.dim}), in.query);
+    AddInputFromArray<float>(TensorShape({in.batch, in.key_len, in.dim}),
+                             in.key);
+    AddInputFromArray<float>(
+        TensorShape({in.batch, in.key_len, in.value_dim}), in.value);
+    AddInput<bool>(TensorShape({in.batch, in.key_len}),
+                   [&in](int i) -> bool { return in.key_mask[i]; });
+  }
+};
+
+TEST_F(MultiHeadAttentionOpTest, MatchesUnfused) {
+  // More queries and keys than fit in one block.
+  MultiHeadAttentionInputs in(3, 37, 70, 8, 12, 2, 0.5f);
+  MakeOp("MultiHeadAttention", in);
+  AddInputs(in);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(DT_FLOAT,
+                  TensorShape({in.batch, in.query_len, in.value_dim}));
+  auto output = expected.flat<float>();
+  for (int b = 0; b < in.batch; ++b) {
+    for (int t = 0; t < in.query_len; ++t) {
+      std::vector<double> row = in.Output(b, t);
+      for (int j = 0; j < in.value_dim; ++j) {
+        output((b * in.query_len + t) * in.value_dim + j) = row[j];
+      }
+    }
+  }
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(MultiHeadAttentionOpTest, GradMatchesFiniteDifferences) {
+  MultiHeadAttentionInputs in(2, 5, 6, 4, 6, 2, 0.7f);
+  MakeOp("MultiHeadAttention", in);
+  AddInputs(in);
+  TF_ASSERT_OK(RunOpKernel());
+  const Tensor output = *GetOutput(0);
+  const Tensor logsumexp = *GetOutput(1);
+
+  std::vector<float> output_grad(in.batch * in.query_len * in.value_dim);
+  in.Fill(&output_grad, output_grad.size());
+  inputs_.clear();
+  MakeOp("MultiHeadAttentionGrad", in);
+  AddInputFromArray<float>(output.shape(), output_grad);
+  AddInputs(in);
+  AddInput<float>(output.shape(), [&output](int i) -> float {
+    return output.flat<float>()(i);
+  });
+  AddInput<float>(logsumexp.shape(), [&logsumexp](int i) -> float {
+    return logsumexp.flat<float>()(i);
+  });
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<std::vector<float>*> params = {&in.query, &in.key, &in.value};
+  for (int p = 0; p < params.size(); ++p) {
+    std::vector<float>& param = *params[p];
+    auto grad = GetOutput(p)->flat<float>();
+    ASSERT_EQ(param.size(), grad.size());
+    for (int i = 0; i < param.size(); ++i) {
+      const float value = param[i];
+      const float delta = 1e-3;
+      param[i] = value + delta;
+      const double loss_plus = in.Loss(output_grad);
+      param[i] = value - delta;
+      const double loss_minus = in.Loss(output_grad);
+      param[i] = value;
+      EXPECT_NEAR((loss_plus - loss_minus) / (2 * delta), grad(i), 1e-4)
+          << "input " << p << " element " << i;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Performance benchmarks                                                     //
+//----------------------------------------------------------------------------//
+struct MultiHeadAttentionGraphInputs {
+  MultiHeadAttentionGraphInputs(const Scope& s, int batch, int seq_len,
+                                int dim) {
+    auto random = [&s](const TensorShape& shape) {
+      Tensor t(DT_FLOAT, shape);
+      t.flat<float>().setRandom();
+      return ops::Const(s, Input::Initializer(t));
+    };
+    query = random({batch, seq_len, dim});
+    key = random({batch, seq_len, dim});
+    value = random({batch, seq_len, dim});
+    // Sequences of 3/4 of the maximum length on average.
+    Tensor sequence_mask(DT_BOOL, TensorShape({batch, seq_len}));
+    for (int b = 0; b < batch; ++b) {
+      const int length = seq_len / 2 + b % (seq_len / 2 + 1);
+      for (int t = 0; t < seq_len; ++t) {
+        sequence_mask.matrix<bool>()(b, t) = t < length;
+      }
+    }
+    key_mask = ops::Const(s, Input::Initializer(sequence_mask));
+  }
+
+  Output query, key, value, key_mask;
+};
+
+static Graph* FusedMultiHeadAttention(int batch, int seq_len, int dim,
+                                      int head_count) {
+  Scope s = Scope::NewRootScope();
+  MultiHeadAttentionGraphInputs in(s, batch, seq_len, dim);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  std::unordered_map<string, Node*> nodes;
+  for (Node* node : g->nodes()) nodes[node->name()] = node;
+  NodeBuilder builder(g->NewName("multi_head_attention"),
+                      "MultiHeadAttention");
+  for (const Output& input : {in.query, in.key, in.value, in.key_mask}) {
+    builder.Input(nodes[input.node()->name()]);
+  }
+  TF_CHECK_OK(builder.Attr("head_count", head_count).Finalize(g, nullptr));
+  return g;
+}
+
+// The subgraph of modelzoo/bst _multihead_attention that
+// MultiHeadAttentionFusion rewrites.
+static Graph* UnfusedMultiHeadAttention(int batch, int seq_len, int dim,
+                                        int head_count) {
+  Scope s = Scope::NewRootScope();
+  MultiHeadAttentionGraphInputs in(s, batch, seq_len, dim);
+  auto split_heads = [&s, head_count](Output x) {
+    return ops::Concat(s, ops::Split(s, -1, x, head_count).output, 0).output;
+  };
+  auto scores = ops::BatchMatMul(s, split_heads(in.query),
+                                 split_heads(in.key),
+                                 ops::BatchMatMul::AdjY(true));
+  auto masks = ops::Reshape(
+      s, ops::Tile(s, in.key_mask, ops::Const(s, {head_count, seq_len})),
+      ops::Const(s, {-1, seq_len, seq_len}));
+  auto padding = ops::Mul(
+      s, ops::Const(s, 1e9f),
+      ops::Cast(s, ops::LogicalNot(s, masks), DT_FLOAT));
+  auto weights = ops::Softmax(s, ops::Sub(s, scores, padding));
+  auto output = ops::BatchMatMul(s, weights, split_heads(in.value));
+  ops::Concat(s, ops::Split(s, 0, output, head_count).output, 2);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(s.ToGraph(g));
+  return g;
+}
+
+#define BM_MULTI_HEAD_ATTENTION(KIND, B, T, D, H, NTH)                        \
+  static void BM_##KIND##MultiHeadAttention_##B##_##T##_##D##_##H##_##NTH(    \
+      int iters) {                                                            \
+    testing::UseRealTime();                                                   \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B);                   \
+    SessionOptions opts;                                                      \
+    opts.config.set_intra_op_parallelism_threads(NTH);                        \
+    test::Benchmark("cpu", KIND##MultiHeadAttention(B, T, D, H), &opts)       \
+        .Run(iters);                                                          \
+  }                                                                           \
+  BENCHMARK(BM_##KIND##MultiHeadAttention_##B##_##T##_##D##_##H##_##NTH);
+
+#define BM_MULTI_HEAD_ATTENTION_NTH(B, T, D, H)       \
+  BM_MULTI_HEAD_ATTENTION(Fused, B, T, D, H, 1);      \
+  BM_MULTI_HEAD_ATTENTION(Fused, B, T, D, H, 8);      \
+  BM_MULTI_HEAD_ATTENTION(Unfused, B, T, D, H, 1);    \
+  BM_MULTI_HEAD_ATTENTION(Unfused, B, T, D, H, 8);
+
+// The BST tower of modelzoo/bst, and a longer sequence.
+BM_MULTI_HEAD_ATTENTION_NTH(512, 50, 32, 4);
+BM_MULTI_HEAD_ATTENTION_NTH(512, 200, 64, 4);
+
+}  // namespace
+}  // namespace tensorflow
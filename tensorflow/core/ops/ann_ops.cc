@@ -0,0 +1,122 @@
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// A hierarchical navigable small world graph index of dim-dimensional
+// vectors, e.g. of the item embeddings of a two-tower model, searched for
+// the largest inner products or the smallest L2 distances. The index is
+// created on the first run and shared by the ops with the same container
+// and shared_name, or node name.
+REGISTER_OP("HnswIndex")
+    .Output("index: resource")
+    .Attr("dim: int >= 1")
+    .Attr("metric: {'inner_product', 'l2'} = 'inner_product'")
+    .Attr("max_neighbors: int >= 2 = 16")
+    .Attr("ef_construction: int >= 1 = 200")
+    .Attr("seed: int = 0")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape);
+
+// An inverted file index of product quantized vectors, in num_lists lists
+// of codes of num_subquantizers bytes. dim must be a multiple of
+// num_subquantizers. The quantizers are trained by the first update.
+REGISTER_OP("IvfPqIndex")
+    .Output("index: resource")
+    .Attr("dim: int >= 1")
+    .Attr("metric: {'inner_product', 'l2'} = 'inner_product'")
+    .Attr("num_lists: int >= 1 = 1024")
+    .Attr("num_subquantizers: int >= 1 = 8")
+    .Attr("seed: int = 0")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape);
+
+// Inserts or replaces the [N, dim] vectors of the N ids. num_updated is the
+// number of vectors that were not already in the index, so that running the
+// update again on the restored embeddings of a delta model load only
+// re-indexes the changed items.
+REGISTER_OP("AnnIndexUpdate")
+    .Input("index: resource")
+    .Input("ids: int64")
+    .Input("vectors: float")
+    .Output("num_updated: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      ShapeHandle vectors;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &vectors));
+      DimensionHandle n;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(ids, 0), c->Dim(vectors, 0), &n));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+// Removes the N ids from the search results, e.g. of items that were
+// retired from the catalog. num_removed is the number of ids that were in
+// the index. A later update of a removed id inserts it again.
+REGISTER_OP("AnnIndexRemove")
+    .Input("index: resource")
+    .Input("ids: int64")
+    .Output("num_removed: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+// The ids of the k nearest neighbors of each of the [B, dim] queries and
+// their scores, best first: the inner products, or the negated squared L2
+// distances. probe trades speed for recall: the size of the candidate list
+// of an HNSW search, or the number of inverted lists scanned by IVF-PQ.
+// Missing neighbors of a smaller index have id -1 and score -inf.
+REGISTER_OP("AnnIndexSearch")
+    .Input("index: resource")
+    .Input("queries: float")
+    .Input("k: int32")
+    .Input("probe: int32")
+    .Output("scores: float")
+    .Output("ids: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      ShapeHandle queries;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &queries));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      DimensionHandle k;
+      TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(2, &k));
+      ShapeHandle output = c->MakeShape({c->Dim(queries, 0), k});
+      c->set_output(0, output);
+      c->set_output(1, output);
+      return Status::OK();
+    });
+
+// The number of vectors of the index.
+REGISTER_OP("AnnIndexSize")
+    .Input("index: resource")
+    .Output("size: int64")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
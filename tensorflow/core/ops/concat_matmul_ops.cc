@@ -0,0 +1,111 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+// Merges the batch of the N [B, D_i] inputs and checks that the [K, O]
+// kernel has K = sum(D_i) rows.
+Status MergeConcatMatMulDims(InferenceContext* c, int n,
+                             DimensionHandle* batch,
+                             DimensionHandle* units) {
+  *batch = c->UnknownDim();
+  DimensionHandle depth = c->MakeDim(0);
+  for (int i = 0; i < n; ++i) {
+    ShapeHandle input;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 2, &input));
+    TF_RETURN_IF_ERROR(c->Merge(*batch, c->Dim(input, 0), batch));
+    TF_RETURN_IF_ERROR(c->Add(depth, c->Dim(input, 1), &depth));
+  }
+  ShapeHandle kernel;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(n), 2, &kernel));
+  DimensionHandle unused;
+  TF_RETURN_IF_ERROR(c->Merge(depth, c->Dim(kernel, 0), &unused));
+  *units = c->Dim(kernel, 1);
+  return Status::OK();
+}
+
+Status GetNumBias(InferenceContext* c, int* num_bias) {
+  TF_RETURN_IF_ERROR(c->GetAttr("num_bias", num_bias));
+  if (*num_bias > 1) {
+    return errors::InvalidArgument("num_bias must be 0 or 1, got ",
+                                   *num_bias);
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// The dense layer of the concatenation of N [B, D_i] inputs, e.g. the
+// pooled embeddings of an input layer, with a [sum(D_i), O] kernel:
+//
+//   output = activation(concat(inputs, 1) kernel + bias)
+//
+// with the [O] bias if num_bias is 1. The product is accumulated over
+// column panels of the inputs, so the [B, sum(D_i)] concatenation is never
+// materialized.
+REGISTER_OP("ConcatMatMul")
+    .Input("inputs: N * T")
+    .Input("kernel: T")
+    .Input("bias: num_bias * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("N: int >= 1")
+    .Attr("num_bias: int >= 0 = 0")
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .SetShapeFn([](InferenceContext* c) {
+      int n;
+      int num_bias;
+      TF_RETURN_IF_ERROR(c->GetAttr("N", &n));
+      TF_RETURN_IF_ERROR(GetNumBias(c, &num_bias));
+      DimensionHandle batch;
+      DimensionHandle units;
+      TF_RETURN_IF_ERROR(MergeConcatMatMulDims(c, n, &batch, &units));
+      if (num_bias == 1) {
+        ShapeHandle bias;
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(n + 1), 1, &bias));
+        TF_RETURN_IF_ERROR(c->Merge(units, c->Dim(bias, 0), &units));
+      }
+      c->set_output(0, c->Matrix(batch, units));
+      return Status::OK();
+    });
+
+// The gradients of ConcatMatMul with respect to its inputs, kernel and
+// bias, from its output and output_grad. The input gradients are written
+// per input and the kernel gradient per kernel panel, without the
+// concatenated input or its gradient.
+REGISTER_OP("ConcatMatMulGrad")
+    .Input("inputs: N * T")
+    .Input("kernel: T")
+    .Input("output: T")
+    .Input("output_grad: T")
+    .Output("inputs_grad: N * T")
+    .Output("kernel_grad: T")
+    .Output("bias_grad: num_bias * T")
+    .Attr("T: {float}")
+    .Attr("N: int >= 1")
+    .Attr("num_bias: int >= 0 = 0")
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .SetShapeFn([](InferenceContext* c) {
+      int n;
+      int num_bias;
+      TF_RETURN_IF_ERROR(c->GetAttr("N", &n));
+      TF_RETURN_IF_ERROR(GetNumBias(c, &num_bias));
+      DimensionHandle batch;
+      DimensionHandle units;
+      TF_RETURN_IF_ERROR(MergeConcatMatMulDims(c, n, &batch, &units));
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Merge(c->input(n + 1), c->input(n + 2), &output));
+      TF_RETURN_IF_ERROR(
+          c->Merge(output, c->Matrix(batch, units), &output));
+      for (int i = 0; i <= n; ++i) c->set_output(i, c->input(i));
+      if (num_bias == 1) c->set_output(n + 1, c->Vector(c->Dim(output, 1)));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
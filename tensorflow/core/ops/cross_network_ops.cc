@@ -0,0 +1,107 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+Status CrossNetworkShapeFn(InferenceContext* c) {
+  ShapeHandle x0;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &x0));
+  c->set_output(0, x0);
+  return Status::OK();
+}
+
+// The gradients have the shapes of the inputs after output_grad.
+Status CrossNetworkGradShapeFn(InferenceContext* c) {
+  for (int i = 1; i < c->num_inputs(); ++i) {
+    c->set_output(i - 1, c->input(i));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// The DCN cross network, num_layers cross layers of the [B, D] input x0
+// with kernels[l] and biases[l] of shape [D]:
+//
+//   x[0] = x0
+//   x[l + 1] = x0 * (x[l] . kernels[l]) + biases[l] + x[l]
+//
+// where x[l] . kernels[l] is the [B, 1] dot product of each row.
+REGISTER_OP("CrossNetwork")
+    .Input("x0: T")
+    .Input("kernels: num_layers * T")
+    .Input("biases: num_layers * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_layers: int >= 1")
+    .SetShapeFn(CrossNetworkShapeFn);
+
+REGISTER_OP("CrossNetworkGrad")
+    .Input("output_grad: T")
+    .Input("x0: T")
+    .Input("kernels: num_layers * T")
+    .Input("biases: num_layers * T")
+    .Output("x0_grad: T")
+    .Output("kernels_grad: num_layers * T")
+    .Output("biases_grad: num_layers * T")
+    .Attr("T: {float}")
+    .Attr("num_layers: int >= 1")
+    .SetShapeFn(CrossNetworkGradShapeFn);
+
+// The DCNv2 cross network, num_layers cross layers of the [B, D] input x0
+// with [D, D] kernels and [D] biases:
+//
+//   x[0] = x0
+//   x[l + 1] = x0 * (x[l] kernels[l] + biases[l]) + x[l]
+//
+// With num_projections == num_layers the layers are low rank, the [R, D]
+// kernels applied to x[l] projection_kernels[l] + projection_biases[l], of
+// shapes [D, R] and [R]. With input_residual, x0 is added instead of x[l].
+REGISTER_OP("CrossNetworkV2")
+    .Input("x0: T")
+    .Input("kernels: num_layers * T")
+    .Input("biases: num_layers * T")
+    .Input("projection_kernels: num_projections * T")
+    .Input("projection_biases: num_projections * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_layers: int >= 1")
+    .Attr("num_projections: int >= 0 = 0")
+    .Attr("input_residual: bool = false")
+    .SetShapeFn([](InferenceContext* c) {
+      int num_layers;
+      int num_projections;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_layers", &num_layers));
+      TF_RETURN_IF_ERROR(c->GetAttr("num_projections", &num_projections));
+      if (num_projections != 0 && num_projections != num_layers) {
+        return errors::InvalidArgument(
+            "num_projections must be 0 or num_layers, got ", num_projections,
+            " and ", num_layers);
+      }
+      return CrossNetworkShapeFn(c);
+    });
+
+REGISTER_OP("CrossNetworkV2Grad")
+    .Input("output_grad: T")
+    .Input("x0: T")
+    .Input("kernels: num_layers * T")
+    .Input("biases: num_layers * T")
+    .Input("projection_kernels: num_projections * T")
+    .Input("projection_biases: num_projections * T")
+    .Output("x0_grad: T")
+    .Output("kernels_grad: num_layers * T")
+    .Output("biases_grad: num_layers * T")
+    .Output("projection_kernels_grad: num_projections * T")
+    .Output("projection_biases_grad: num_projections * T")
+    .Attr("T: {float}")
+    .Attr("num_layers: int >= 1")
+    .Attr("num_projections: int >= 0 = 0")
+    .Attr("input_residual: bool = false")
+    .SetShapeFn(CrossNetworkGradShapeFn);
+
+}  // namespace tensorflow
@@ -869,6 +869,30 @@ REGISTER_OP("MultiDeviceIteratorFromStringHandle")
     .Attr("output_shapes: list(shape) >= 0 = []")
     .SetShapeFn(shape_inference::ScalarShape);
 
+// Bounds the bytes buffered between a streaming source and its consumers,
+// groups elements into tumbling event-time windows that are released by a
+// watermark, and drops or compacts stale elements.
+REGISTER_OP("StreamingWindowDataset")
+    .Input("input_dataset: variant")
+    .Input("max_buffered_bytes: int64")
+    .Input("window_size_ms: int64")
+    .Input("max_out_of_orderness_ms: int64")
+    .Input("max_staleness_ms: int64")
+    .Output("handle: variant")
+    .Attr("timestamp_index: int >= 0")
+    .Attr("key_index: int = -1")
+    .Attr("stale_policy: {'drop', 'compact', 'keep'} = 'drop'")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("IOKafkaDataset")
     .Input("topics: string")
     .Input("servers: string")
@@ -879,6 +903,7 @@ REGISTER_OP("IOKafkaDataset")
     .Input("config_topic: string")
     .Input("message_key: bool")
     .Output("handle: variant")
+    .Attr("message_timestamp: bool = false")
     .SetIsStateful()
     .SetShapeFn(shape_inference::ScalarShape);
 
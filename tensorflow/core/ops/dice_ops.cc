@@ -20,4 +20,61 @@ REGISTER_OP("Dice")
                     return Status::OK();
                 });
 
+namespace {
+
+// Merges the channels, the last dimension of x, with the size of the 1-D
+// input `input`.
+Status MergeDiceChannels(InferenceContext* c, int input,
+                         DimensionHandle* channels) {
+  ShapeHandle x;
+  ShapeHandle vector;
+  TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &x));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(input), 1, &vector));
+  return c->Merge(c->Dim(x, -1), c->Dim(vector, 0), channels);
+}
+
+}  // namespace
+
+// Dice fusion op for training: normalizes x with the mean and variance of the
+// current batch, computed over all dimensions but the last, and also outputs
+// them, as mean and rvar = 1 / (sqrt(variance + epsilon) + epsilon).
+REGISTER_OP("DiceTraining")
+    .Input("x: T")
+    .Input("gamma: T")
+    .Output("y: T")
+    .Output("mean: T")
+    .Output("rvar: T")
+    .Attr("T: {float}")
+    .Attr("epsilon: float = 1e-9")
+    .SetShapeFn([](InferenceContext* c) {
+      DimensionHandle channels;
+      TF_RETURN_IF_ERROR(MergeDiceChannels(c, 1, &channels));
+      c->set_output(0, c->input(0));
+      c->set_output(1, c->Vector(channels));
+      c->set_output(2, c->Vector(channels));
+      return Status::OK();
+    });
+
+REGISTER_OP("DiceTrainingGrad")
+    .Input("y_grad: T")
+    .Input("x: T")
+    .Input("gamma: T")
+    .Input("mean: T")
+    .Input("rvar: T")
+    .Output("x_grad: T")
+    .Output("gamma_grad: T")
+    .Attr("T: {float}")
+    .Attr("epsilon: float = 1e-9")
+    .SetShapeFn([](InferenceContext* c) {
+      DimensionHandle channels;
+      for (int input = 2; input < 5; ++input) {
+        TF_RETURN_IF_ERROR(MergeDiceChannels(c, input, &channels));
+      }
+      ShapeHandle x;
+      TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &x));
+      c->set_output(0, x);
+      c->set_output(1, c->Vector(channels));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
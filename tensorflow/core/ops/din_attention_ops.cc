@@ -0,0 +1,73 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// DIN local activation unit: scores the facts against the query with a
+// [q, f, q-f, q*f] -> sigmoid dense -> sigmoid dense -> dense MLP, sets
+// the scores of masked facts to padding_value, and returns the softmax
+// weighted sum of the facts and the weights.
+REGISTER_OP("DinAttention")
+    .Input("query: T")
+    .Input("facts: T")
+    .Input("mask: bool")
+    .Input("w1: T")
+    .Input("b1: T")
+    .Input("w2: T")
+    .Input("b2: T")
+    .Input("w3: T")
+    .Input("b3: T")
+    .Output("output: T")
+    .Output("alphas: T")
+    .Attr("T: {float}")
+    .Attr("padding_value: float = -4294967295.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query;
+      ShapeHandle facts;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &query));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 3, &facts));
+      DimensionHandle batch;
+      DimensionHandle dim;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(query, 0), c->Dim(facts, 0), &batch));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(query, 1), c->Dim(facts, 2), &dim));
+      c->set_output(0, c->MakeShape({batch, 1, dim}));
+      c->set_output(1, c->MakeShape({batch, 1, c->Dim(facts, 1)}));
+      return Status::OK();
+    });
+
+REGISTER_OP("DinAttentionGrad")
+    .Input("output_grad: T")
+    .Input("alphas_grad: T")
+    .Input("query: T")
+    .Input("facts: T")
+    .Input("mask: bool")
+    .Input("w1: T")
+    .Input("b1: T")
+    .Input("w2: T")
+    .Input("b2: T")
+    .Input("w3: T")
+    .Input("b3: T")
+    .Output("query_grad: T")
+    .Output("facts_grad: T")
+    .Output("w1_grad: T")
+    .Output("b1_grad: T")
+    .Output("w2_grad: T")
+    .Output("b2_grad: T")
+    .Output("w3_grad: T")
+    .Output("b3_grad: T")
+    .Attr("T: {float}")
+    .Attr("padding_value: float = -4294967295.0")
+    .SetShapeFn([](InferenceContext* c) {
+      for (int i = 0; i < 8; ++i) {
+        // query, facts, then the weights and biases.
+        c->set_output(i, c->input(i < 2 ? i + 2 : i + 3));
+      }
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
@@ -0,0 +1,62 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// DLRM dot interaction: the pairwise dot products of the F features of
+// each example, features[b, i] . features[b, j] for j < i in row major
+// order, optionally after the dense features:
+//
+//   output[b] = concat(dense[b], lower_triangle(features[b] features[b]^T))
+REGISTER_OP("DotInteraction")
+    .Input("features: T")
+    .Input("dense: num_dense * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_dense: int >= 0 = 0")
+    .SetShapeFn([](InferenceContext* c) {
+      int num_dense;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_dense", &num_dense));
+      if (num_dense > 1) {
+        return errors::InvalidArgument("num_dense must be 0 or 1, got ",
+                                       num_dense);
+      }
+      ShapeHandle features;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &features));
+      DimensionHandle batch = c->Dim(features, 0);
+      DimensionHandle output_dim = c->UnknownDim();
+      if (c->ValueKnown(c->Dim(features, 1))) {
+        const int64 f = c->Value(c->Dim(features, 1));
+        output_dim = c->MakeDim(f * (f - 1) / 2);
+      }
+      if (num_dense == 1) {
+        ShapeHandle dense;
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &dense));
+        TF_RETURN_IF_ERROR(c->Merge(batch, c->Dim(dense, 0), &batch));
+        TF_RETURN_IF_ERROR(
+            c->Add(c->Dim(dense, 1), output_dim, &output_dim));
+      }
+      c->set_output(0, c->MakeShape({batch, output_dim}));
+      return Status::OK();
+    });
+
+REGISTER_OP("DotInteractionGrad")
+    .Input("output_grad: T")
+    .Input("features: T")
+    .Input("dense: num_dense * T")
+    .Output("features_grad: T")
+    .Output("dense_grad: num_dense * T")
+    .Attr("T: {float}")
+    .Attr("num_dense: int >= 0 = 0")
+    .SetShapeFn([](InferenceContext* c) {
+      for (int i = 1; i < c->num_inputs(); ++i) {
+        c->set_output(i - 1, c->input(i));
+      }
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
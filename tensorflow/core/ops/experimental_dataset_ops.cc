@@ -117,6 +117,29 @@ REGISTER_OP("ExperimentalChooseFastestDataset")
     .Attr("output_shapes: list(shape) >= 1")
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("BucketBySequenceLengthDataset")
+    .Input("input_dataset: variant")
+    .Input("bucket_boundaries: int64")
+    .Input("bucket_batch_sizes: int64")
+    .Input("padding_values: Toutput_types")
+    .Input("drop_remainder: bool")
+    .Output("handle: variant")
+    .Attr("length_index: int")
+    .Attr("pad_to_bucket_boundary: bool = false")
+    .Attr("Toutput_types: list(type) >= 1")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // `bucket_boundaries` and `bucket_batch_sizes` must be vectors.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &unused));
+      // `drop_remainder` must be a scalar.
+      TF_RETURN_IF_ERROR(
+          c->WithRank(c->input(c->num_inputs() - 1), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("CSVDataset")
     .Input("filenames: string")
     .Input("compression_type: string")
@@ -201,6 +224,46 @@ REGISTER_OP("ExperimentalCSVDataset")
       return shape_inference::ScalarShape(c);
     });
 
+REGISTER_OP("ParallelCSVDataset")
+    .Input("filenames: string")
+    .Input("batch_size: int64")
+    .Input("num_parallel_reads: int64")
+    .Input("block_size: int64")
+    .Input("header: bool")
+    .Input("field_delim: string")
+    .Input("use_quote_delim: bool")
+    .Input("na_value: string")
+    .Input("select_cols: int64")
+    .Input("record_defaults: output_types")
+    .Output("handle: variant")
+    .Attr("output_types: list({float,double,int32,int64,string}) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetIsStateful()  // TODO(b/123753214): Source dataset ops must be marked
+                      // stateful to inhibit constant folding.
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // `batch_size`, `num_parallel_reads`, `block_size`, `header`,
+      // `field_delim`, `use_quote_delim`, `na_value` must be scalars
+      for (int i = 1; i < 8; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      // `select_cols` must be a vector
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(8), 1, &unused));
+      // `record_defaults` must be lists of scalars
+      for (size_t i = 9; i < c->num_inputs(); ++i) {
+        shape_inference::ShapeHandle v;
+        TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(i), 1, &v));
+        if (c->Rank(c->input(i)) == 1 && c->Value(c->Dim(v, 0)) > 1) {
+          return errors::InvalidArgument(
+              "Shape of a default must be a length-0 or length-1 vector, or a "
+              "scalar.");
+        }
+      }
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("DatasetCardinality")
     .Input("input_dataset: variant")
     .Output("cardinality: int64")
@@ -406,6 +469,33 @@ REGISTER_OP("ExperimentalLatencyStatsDataset")
       return shape_inference::ScalarShape(c);
     });
 
+// Shuffles the records of a set of TFRecord files by permuting an index of
+// record offsets instead of buffering elements. Records are read back one
+// window of `window_size` records at a time, in file-offset order within the
+// window, through a memory mapping (`use_mmap`) or positional reads. With
+// `reshuffle_each_iteration`, each iterator draws new seeds from the given
+// ones, so every epoch is a different permutation.
+REGISTER_OP("IndexedShuffleTFRecordDataset")
+    .Input("filenames: string")
+    .Input("window_size: int64")
+    .Input("seed: int64")
+    .Input("seed2: int64")
+    .Output("handle: variant")
+    .Attr("use_mmap: bool = true")
+    .Attr("reshuffle_each_iteration: bool = true")
+    .SetIsStateful()  // TODO(b/123753214): Source dataset ops must be marked
+                      // stateful to inhibit constant folding.
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // `window_size`, `seed` and `seed2` must be scalars.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      return shape_inference::ScalarShape(c);
+    });
+
 REGISTER_OP("LMDBDataset")
     .Input("filenames: string")
     .Output("handle: variant")
@@ -0,0 +1,187 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+// Merges the batch, time and unit sizes of the inputs of GRUSequence, or of
+// AUGRUSequence with `attention`.
+Status MergeGRUSequenceDims(InferenceContext* c, bool attention,
+                            DimensionHandle* batch, DimensionHandle* time,
+                            DimensionHandle* units) {
+  const int first = attention ? 2 : 1;
+  ShapeHandle x;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &x));
+  *batch = c->Dim(x, 0);
+  *time = c->Dim(x, 1);
+  if (attention) {
+    ShapeHandle att_scores;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &att_scores));
+    TF_RETURN_IF_ERROR(c->Merge(*batch, c->Dim(att_scores, 0), batch));
+    TF_RETURN_IF_ERROR(c->Merge(*time, c->Dim(att_scores, 1), time));
+  }
+  ShapeHandle sequence_length;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first), 1, &sequence_length));
+  TF_RETURN_IF_ERROR(c->Merge(*batch, c->Dim(sequence_length, 0), batch));
+  ShapeHandle initial_state;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 1), 2, &initial_state));
+  TF_RETURN_IF_ERROR(c->Merge(*batch, c->Dim(initial_state, 0), batch));
+  *units = c->Dim(initial_state, 1);
+
+  ShapeHandle gate_kernel;
+  ShapeHandle gate_bias;
+  ShapeHandle candidate_kernel;
+  ShapeHandle candidate_bias;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 2), 2, &gate_kernel));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 3), 1, &gate_bias));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 4), 2, &candidate_kernel));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 5), 1, &candidate_bias));
+  TF_RETURN_IF_ERROR(c->Merge(*units, c->Dim(candidate_kernel, 1), units));
+  TF_RETURN_IF_ERROR(c->Merge(*units, c->Dim(candidate_bias, 0), units));
+  DimensionHandle gate_units;
+  TF_RETURN_IF_ERROR(c->Multiply(*units, 2, &gate_units));
+  TF_RETURN_IF_ERROR(
+      c->Merge(gate_units, c->Dim(gate_kernel, 1), &gate_units));
+  TF_RETURN_IF_ERROR(c->Merge(gate_units, c->Dim(gate_bias, 0), &gate_units));
+  return Status::OK();
+}
+
+// The inputs are x, [att_scores,] sequence_length, initial_state,
+// gate_kernel, gate_bias, candidate_kernel and candidate_bias.
+Status GRUSequenceShapeFn(InferenceContext* c, bool attention) {
+  DimensionHandle batch;
+  DimensionHandle time;
+  DimensionHandle units;
+  TF_RETURN_IF_ERROR(MergeGRUSequenceDims(c, attention, &batch, &time,
+                                          &units));
+  DimensionHandle gate_units;
+  TF_RETURN_IF_ERROR(c->Multiply(units, 2, &gate_units));
+  c->set_output(0, c->MakeShape({batch, time, units}));
+  c->set_output(1, c->MakeShape({batch, units}));
+  c->set_output(2, c->MakeShape({batch, time, gate_units}));
+  c->set_output(3, c->MakeShape({batch, time, units}));
+  return Status::OK();
+}
+
+// The gradients have the shapes of x, [att_scores,] initial_state and of
+// the weights.
+Status GRUSequenceGradShapeFn(InferenceContext* c, bool attention) {
+  const int first = attention ? 2 : 1;
+  ShapeHandle gate_kernel;
+  ShapeHandle candidate_kernel;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 2), 2, &gate_kernel));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(first + 3), 2, &candidate_kernel));
+  int output = 0;
+  c->set_output(output++, c->input(0));
+  if (attention) c->set_output(output++, c->input(1));
+  c->set_output(output++, c->input(first + 1));
+  c->set_output(output++, gate_kernel);
+  c->set_output(output++, c->Vector(c->Dim(gate_kernel, 1)));
+  c->set_output(output++, candidate_kernel);
+  c->set_output(output++, c->Vector(c->Dim(candidate_kernel, 1)));
+  return Status::OK();
+}
+
+}  // namespace
+
+// A GRU over the [B, T, I] padded sequences x, as tf.nn.dynamic_rnn of a
+// tf.nn.rnn_cell.GRUCell with H units. From h = initial_state, for each
+// example b and step t < sequence_length[b]:
+//
+//   r, u = split(sigmoid(concat(x[b, t], h) gate_kernel + gate_bias))
+//   c = tanh(concat(x[b, t], r * h) candidate_kernel + candidate_bias)
+//   h = u * h + (1 - u) * c
+//
+// with gate_kernel of shape [I + H, 2 * H] and candidate_kernel of shape
+// [I + H, H]. outputs[b, t] is h, or zeros past the sequence length, and
+// final_state[b] the last h. The gates r and u and the candidates c are
+// saved for GRUSequenceGrad.
+REGISTER_OP("GRUSequence")
+    .Input("x: T")
+    .Input("sequence_length: int32")
+    .Input("initial_state: T")
+    .Input("gate_kernel: T")
+    .Input("gate_bias: T")
+    .Input("candidate_kernel: T")
+    .Input("candidate_bias: T")
+    .Output("outputs: T")
+    .Output("final_state: T")
+    .Output("gates: T")
+    .Output("candidates: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      return GRUSequenceShapeFn(c, /*attention=*/false);
+    });
+
+// The GRU with attentional update gate of DIEN, a GRUSequence with the
+// update gate u scaled by 1 - att_scores[b, t].
+REGISTER_OP("AUGRUSequence")
+    .Input("x: T")
+    .Input("att_scores: T")
+    .Input("sequence_length: int32")
+    .Input("initial_state: T")
+    .Input("gate_kernel: T")
+    .Input("gate_bias: T")
+    .Input("candidate_kernel: T")
+    .Input("candidate_bias: T")
+    .Output("outputs: T")
+    .Output("final_state: T")
+    .Output("gates: T")
+    .Output("candidates: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      return GRUSequenceShapeFn(c, /*attention=*/true);
+    });
+
+REGISTER_OP("GRUSequenceGrad")
+    .Input("x: T")
+    .Input("sequence_length: int32")
+    .Input("initial_state: T")
+    .Input("gate_kernel: T")
+    .Input("candidate_kernel: T")
+    .Input("outputs: T")
+    .Input("gates: T")
+    .Input("candidates: T")
+    .Input("outputs_grad: T")
+    .Input("final_state_grad: T")
+    .Output("x_grad: T")
+    .Output("initial_state_grad: T")
+    .Output("gate_kernel_grad: T")
+    .Output("gate_bias_grad: T")
+    .Output("candidate_kernel_grad: T")
+    .Output("candidate_bias_grad: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      return GRUSequenceGradShapeFn(c, /*attention=*/false);
+    });
+
+REGISTER_OP("AUGRUSequenceGrad")
+    .Input("x: T")
+    .Input("att_scores: T")
+    .Input("sequence_length: int32")
+    .Input("initial_state: T")
+    .Input("gate_kernel: T")
+    .Input("candidate_kernel: T")
+    .Input("outputs: T")
+    .Input("gates: T")
+    .Input("candidates: T")
+    .Input("outputs_grad: T")
+    .Input("final_state_grad: T")
+    .Output("x_grad: T")
+    .Output("att_scores_grad: T")
+    .Output("initial_state_grad: T")
+    .Output("gate_kernel_grad: T")
+    .Output("gate_bias_grad: T")
+    .Output("candidate_kernel_grad: T")
+    .Output("candidate_bias_grad: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      return GRUSequenceGradShapeFn(c, /*attention=*/true);
+    });
+
+}  // namespace tensorflow
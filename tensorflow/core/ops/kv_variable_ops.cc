@@ -819,6 +819,46 @@ REGISTER_OP("KvResourceIncrImport")
      })
     .Doc(R"doc()doc");
 
+REGISTER_OP("KvResourceImportKeys")
+    .Input("resource_handle: resource")
+    .Input("keys: Tkeys")
+    .Input("values: dtype")
+    .Input("versions: int64")
+    .Input("freqs: int64")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .Attr("partition_id: int = 0")
+    .Attr("partition_num: int = 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      ShapeHandle keys;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &keys));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &values));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(keys, 0), c->Dim(values, 0), &unused));
+      ShapeHandle counts;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &counts));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 1, &counts));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Inserts `keys` with their `values` into the EmbeddingVariable.
+
+Only keys that belong to `partition_id` of `partition_num` partitions are
+inserted, with the same rule that restoring a checkpoint uses. `versions` and
+`freqs` are either empty or indexed in parallel with `keys`; empty ones are
+restored as unset.
+
+resource_handle: Handle to the EmbeddingVariable.
+keys: Vector of keys to insert.
+values: Values of `keys`, one row per key.
+versions: Versions of `keys`, or an empty vector.
+freqs: Frequencies of `keys`, or an empty vector.
+)doc");
+
 REGISTER_OP("KvResourceExport")
     .Input("resource_handle: resource")
     .Output("keys: Tkeys")
@@ -860,6 +900,41 @@ REGISTER_OP("EVGetFrequency")
     })
     .Doc(R"doc()doc");
 
+REGISTER_OP("KvResourceHeavyHitters")
+    .Input("resource_handles: num_partitions * resource")
+    .Output("ids: Tkeys")
+    .Output("freqs: int64")
+    .Output("working_set_sizes: int64")
+    .Output("total: int64")
+    .Attr("num_partitions: int >= 1")
+    .Attr("k: int >= 0")
+    .Attr("coverages: list(float) = [0.5, 0.8, 0.9, 0.95, 0.99]")
+    .Attr("Tkeys: {int64, int32}")
+    .Attr("dtype: type")
+    .SetShapeFn([](InferenceContext* c) {
+      std::vector<float> coverages;
+      TF_RETURN_IF_ERROR(c->GetAttr("coverages", &coverages));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(2, c->Vector(coverages.size()));
+      c->set_output(3, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Outputs the most frequently looked up ids of an EmbeddingVariable, estimated
+by the sketch enabled with TF_EV_HEAVY_HITTER_CAPACITY.
+
+resource_handles: Handles to the partitions of the EmbeddingVariable, their
+  sketches are merged.
+ids: Up to `k` ids by decreasing estimated frequency.
+freqs: Estimated frequencies of `ids`, overestimated by at most the smallest
+  count tracked by the sketch.
+working_set_sizes: For each of `coverages`, the estimated number of ids that
+  receive that fraction of all lookups, -1 if it exceeds the capacity of the
+  sketch.
+total: The number of ids looked up, with repetitions.
+)doc");
+
 REGISTER_OP("EVGetVersion")
     .Input("resource_handle: resource")
     .Input("ids: Tkeys")
@@ -0,0 +1,133 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+// Merges the sizes of the embedding, hidden and weight inputs of MaskBlock
+// and MaskBlockGrad, which come first in both: E, H, R and O.
+Status MergeMaskBlockDims(InferenceContext* c, int aggregation_kernel,
+                          int projection_kernel, int output_kernel,
+                          int gamma, DimensionHandle* batch,
+                          DimensionHandle* output_dim) {
+  ShapeHandle embedding;
+  ShapeHandle hidden;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &embedding));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &hidden));
+  TF_RETURN_IF_ERROR(c->Merge(c->Dim(embedding, 0), c->Dim(hidden, 0), batch));
+  DimensionHandle embedding_dim = c->Dim(embedding, 1);
+  DimensionHandle hidden_dim = c->Dim(hidden, 1);
+
+  ShapeHandle kernel;
+  DimensionHandle unused;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(aggregation_kernel), 2, &kernel));
+  TF_RETURN_IF_ERROR(c->Merge(embedding_dim, c->Dim(kernel, 0), &unused));
+  DimensionHandle aggregation_dim = c->Dim(kernel, 1);
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(projection_kernel), 2, &kernel));
+  TF_RETURN_IF_ERROR(c->Merge(aggregation_dim, c->Dim(kernel, 0), &unused));
+  TF_RETURN_IF_ERROR(c->Merge(hidden_dim, c->Dim(kernel, 1), &unused));
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(output_kernel), 2, &kernel));
+  TF_RETURN_IF_ERROR(c->Merge(hidden_dim, c->Dim(kernel, 0), &unused));
+  *output_dim = c->Dim(kernel, 1);
+  ShapeHandle vector;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(gamma), 1, &vector));
+  TF_RETURN_IF_ERROR(c->Merge(*output_dim, c->Dim(vector, 0), output_dim));
+  return Status::OK();
+}
+
+}  // namespace
+
+// The MaskBlock of MaskNet, with the instance-guided mask of the [B, E]
+// embedding applied to the [B, H] hidden input, which is the embedding
+// itself in the parallel model or the previous block in the serial one:
+//
+//   aggregation = relu(embedding aggregation_kernel + aggregation_bias)
+//   mask = aggregation projection_kernel + projection_bias
+//   output = relu(layer_norm((mask * hidden) output_kernel))
+//
+// with mask relu'ed too if mask_relu, as in modelzoo/masknet, and
+// layer_norm of gamma, beta and epsilon. The kernels are of shapes [E, R],
+// [R, H] and [H, O]. The aggregation, mask, the input of the layer
+// normalization and its mean and rvariance are saved for MaskBlockGrad.
+REGISTER_OP("MaskBlock")
+    .Input("embedding: T")
+    .Input("hidden: T")
+    .Input("aggregation_kernel: T")
+    .Input("aggregation_bias: T")
+    .Input("projection_kernel: T")
+    .Input("projection_bias: T")
+    .Input("output_kernel: T")
+    .Input("gamma: T")
+    .Input("beta: T")
+    .Output("output: T")
+    .Output("aggregation: T")
+    .Output("mask: T")
+    .Output("norm_input: T")
+    .Output("mean: T")
+    .Output("rvariance: T")
+    .Attr("T: {float}")
+    .Attr("mask_relu: bool = true")
+    .Attr("epsilon: float = 0.001")
+    .SetShapeFn([](InferenceContext* c) {
+      DimensionHandle batch;
+      DimensionHandle output_dim;
+      TF_RETURN_IF_ERROR(MergeMaskBlockDims(c, 2, 4, 6, 7, &batch,
+                                            &output_dim));
+      ShapeHandle output = c->MakeShape({batch, output_dim});
+      c->set_output(0, output);
+      c->set_output(1, c->MakeShape({batch, c->Dim(c->input(2), 1)}));
+      c->set_output(2, c->MakeShape({batch, c->Dim(c->input(1), 1)}));
+      c->set_output(3, output);
+      c->set_output(4, c->Vector(batch));
+      c->set_output(5, c->Vector(batch));
+      return Status::OK();
+    });
+
+REGISTER_OP("MaskBlockGrad")
+    .Input("embedding: T")
+    .Input("hidden: T")
+    .Input("aggregation_kernel: T")
+    .Input("projection_kernel: T")
+    .Input("output_kernel: T")
+    .Input("gamma: T")
+    .Input("output: T")
+    .Input("aggregation: T")
+    .Input("mask: T")
+    .Input("norm_input: T")
+    .Input("mean: T")
+    .Input("rvariance: T")
+    .Input("output_grad: T")
+    .Output("embedding_grad: T")
+    .Output("hidden_grad: T")
+    .Output("aggregation_kernel_grad: T")
+    .Output("aggregation_bias_grad: T")
+    .Output("projection_kernel_grad: T")
+    .Output("projection_bias_grad: T")
+    .Output("output_kernel_grad: T")
+    .Output("gamma_grad: T")
+    .Output("beta_grad: T")
+    .Attr("T: {float}")
+    .Attr("mask_relu: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      DimensionHandle batch;
+      DimensionHandle output_dim;
+      TF_RETURN_IF_ERROR(MergeMaskBlockDims(c, 2, 3, 4, 5, &batch,
+                                            &output_dim));
+      c->set_output(0, c->input(0));
+      c->set_output(1, c->input(1));
+      c->set_output(2, c->input(2));
+      c->set_output(3, c->Vector(c->Dim(c->input(2), 1)));
+      c->set_output(4, c->input(3));
+      c->set_output(5, c->Vector(c->Dim(c->input(3), 1)));
+      c->set_output(6, c->input(4));
+      c->set_output(7, c->Vector(output_dim));
+      c->set_output(8, c->Vector(output_dim));
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
@@ -0,0 +1,90 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+Status GroupedDenseShapeFn(InferenceContext* c) {
+  int n;
+  int num_inputs;
+  TF_RETURN_IF_ERROR(c->GetAttr("N", &n));
+  TF_RETURN_IF_ERROR(c->GetAttr("num_inputs", &num_inputs));
+  if (num_inputs != 1 && num_inputs != n) {
+    return errors::InvalidArgument("num_inputs must be 1 or N = ", n,
+                                   ", got ", num_inputs);
+  }
+  for (int i = 0; i < n; ++i) {
+    ShapeHandle input;
+    ShapeHandle kernel;
+    ShapeHandle bias;
+    TF_RETURN_IF_ERROR(
+        c->WithRank(c->input(num_inputs > 1 ? i : 0), 2, &input));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(num_inputs + i), 2, &kernel));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(num_inputs + n + i), 1, &bias));
+    DimensionHandle unused;
+    TF_RETURN_IF_ERROR(
+        c->Merge(c->Dim(input, 1), c->Dim(kernel, 0), &unused));
+    DimensionHandle units;
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(kernel, 1), c->Dim(bias, 0), &units));
+    c->set_output(i, c->Matrix(c->Dim(input, 0), units));
+  }
+  return Status::OK();
+}
+
+Status GatedExpertCombineShapeFn(InferenceContext* c) {
+  int n;
+  TF_RETURN_IF_ERROR(c->GetAttr("N", &n));
+  ShapeHandle output;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &output));
+  for (int i = 1; i < n; ++i) {
+    TF_RETURN_IF_ERROR(c->Merge(output, c->input(i), &output));
+  }
+  ShapeHandle gate;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(n), 2, &gate));
+  DimensionHandle unused;
+  TF_RETURN_IF_ERROR(c->WithValue(c->Dim(gate, 1), n, &unused));
+  DimensionHandle batch;
+  TF_RETURN_IF_ERROR(c->Merge(c->Dim(output, 0), c->Dim(gate, 0), &batch));
+  c->set_output(0, c->Matrix(batch, c->Dim(output, 1)));
+  return Status::OK();
+}
+
+}  // namespace
+
+// N dense layers in one op, as the parallel experts, gates and towers of
+// MMoE and PLE:
+//
+//   outputs[i] = activation(inputs[i] kernels[i] + biases[i])
+//
+// with [M_i, K] inputs, [K, U] kernels and [U] biases. With num_inputs == 1
+// all the layers share inputs[0].
+REGISTER_OP("GroupedDense")
+    .Input("inputs: num_inputs * T")
+    .Input("kernels: N * T")
+    .Input("biases: N * T")
+    .Output("outputs: N * T")
+    .Attr("T: {float}")
+    .Attr("N: int >= 1")
+    .Attr("num_inputs: int >= 1")
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .SetShapeFn(GroupedDenseShapeFn);
+
+// The gated combine of N [B, D] experts of MMoE and PLE, with the [B, N]
+// gate, or softmax(gate) with softmax:
+//
+//   output[b] = sum_i gate[b, i] * experts[i][b]
+REGISTER_OP("GatedExpertCombine")
+    .Input("experts: N * T")
+    .Input("gate: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("N: int >= 1")
+    .Attr("softmax: bool = false")
+    .SetShapeFn(GatedExpertCombineShapeFn);
+
+}  // namespace tensorflow
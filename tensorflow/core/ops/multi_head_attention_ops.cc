@@ -0,0 +1,76 @@
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+// Multi-head attention of the queries over the keys and values, split into
+// head_count heads along their last dimension:
+//
+//   output[:, :, head] = softmax(scale * query[head] key[head]^T) value[head]
+//
+// Keys whose key_mask is false get no weight, unless all keys of a row are
+// masked. logsumexp holds the log of the softmax normalizers of each query,
+// which the gradient uses instead of the [B, head_count, Tq, Tk] weights.
+REGISTER_OP("MultiHeadAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("key_mask: bool")
+    .Output("output: T")
+    .Output("logsumexp: T")
+    .Attr("T: {float}")
+    .Attr("head_count: int >= 1")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query;
+      ShapeHandle key;
+      ShapeHandle value;
+      ShapeHandle key_mask;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &query));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 3, &key));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 3, &value));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 2, &key_mask));
+      DimensionHandle batch;
+      DimensionHandle key_len;
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(query, 0), c->Dim(key, 0), &batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, c->Dim(value, 0), &batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, c->Dim(key_mask, 0), &batch));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(key, 1), c->Dim(value, 1), &key_len));
+      TF_RETURN_IF_ERROR(c->Merge(key_len, c->Dim(key_mask, 1), &key_len));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(query, 2), c->Dim(key, 2), &unused));
+      int64 head_count;
+      TF_RETURN_IF_ERROR(c->GetAttr("head_count", &head_count));
+      c->set_output(0, c->MakeShape({batch, c->Dim(query, 1),
+                                     c->Dim(value, 2)}));
+      c->set_output(1, c->MakeShape({batch, head_count, c->Dim(query, 1)}));
+      return Status::OK();
+    });
+
+REGISTER_OP("MultiHeadAttentionGrad")
+    .Input("output_grad: T")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("key_mask: bool")
+    .Input("output: T")
+    .Input("logsumexp: T")
+    .Output("query_grad: T")
+    .Output("key_grad: T")
+    .Output("value_grad: T")
+    .Attr("T: {float}")
+    .Attr("head_count: int >= 1")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      for (int i = 0; i < 3; ++i) {
+        c->set_output(i, c->input(i + 1));
+      }
+      return Status::OK();
+    });
+
+}  // namespace tensorflow
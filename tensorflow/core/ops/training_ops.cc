@@ -1230,4 +1230,51 @@ REGISTER_OP("ResourceApplyPowerSign")
       return ApplyPowerSignShapeFn(c, /*sparse=*/false);
     });
 
+// Gradient accumulation for runtime micro batching, inserted in front of the
+// gradient inputs of the apply ops by GraphExecutionState. `is_last` is true
+// in the last micro batch of a step, where the outputs hold the gradients of
+// all micro batches of the step.
+REGISTER_OP("_MicroBatchAccumulate")
+    .Input("grad: T")
+    .Output("sum: T")
+    .Output("is_last: bool")
+    .Attr("T: numbertype")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->input(0));
+      c->set_output(1, c->Scalar());
+      return Status::OK();
+    });
+
+// Sparse variant, rows of duplicate indices are summed in the last micro
+// batch. `counts` are the optional indices_counts of the *WithCounts apply
+// ops.
+REGISTER_OP("_MicroBatchSparseAccumulate")
+    .Input("grad: T")
+    .Input("indices: Tindices")
+    .Input("counts: num_counts * int64")
+    .Output("sum: T")
+    .Output("unique_indices: Tindices")
+    .Output("unique_counts: num_counts * int64")
+    .Output("is_last: bool")
+    .Attr("T: numbertype")
+    .Attr("Tindices: {int32, int64}")
+    .Attr("num_counts: int >= 0 = 0")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grad;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &grad));
+      ShapeHandle sum;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(grad, 0, c->UnknownDim(), &sum));
+      c->set_output(0, sum);
+      c->set_output(1, c->Vector(InferenceContext::kUnknownDim));
+      int num_counts;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_counts", &num_counts));
+      for (int i = 0; i < num_counts; ++i) {
+        c->set_output(2 + i, c->Vector(InferenceContext::kUnknownDim));
+      }
+      c->set_output(2 + num_counts, c->Scalar());
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
@@ -46,7 +46,7 @@ class CsvDatasetBenchmark(test.Benchmark):
     gfile.MakeDirs(googletest.GetTempDir())
     self._temp_dir = tempfile.mkdtemp(dir=googletest.GetTempDir())
 
-    self._num_cols = [4, 64, 256]
+    self._num_cols = [4, 64, 256, 500]
     self._num_per_iter = 5000
     self._filenames = []
     for n in self._num_cols:
@@ -61,7 +61,7 @@ class CsvDatasetBenchmark(test.Benchmark):
   def _tear_down(self):
     gfile.DeleteRecursively(self._temp_dir)
 
-  def _run_benchmark(self, dataset, num_cols, prefix):
+  def _run_benchmark(self, dataset, num_cols, prefix, records_per_element=1):
     dataset = dataset.skip(self._num_per_iter - 1)
     options = dataset_ops.Options()
     options.experimental_optimization.apply_default_optimizations = False
@@ -81,7 +81,8 @@ class CsvDatasetBenchmark(test.Benchmark):
         end = time.time()
       deltas.append(end - start)
     # Median wall time per CSV record read and decoded
-    median_wall_time = np.median(deltas) / self._num_per_iter
+    median_wall_time = np.median(deltas) / (
+        self._num_per_iter * records_per_element)
     self.report_benchmark(
         iters=self._num_per_iter,
         wall_time=median_wall_time,
@@ -127,5 +128,31 @@ class CsvDatasetBenchmark(test.Benchmark):
       self._run_benchmark(dataset, num_cols, 'csv_strings_fused_dataset')
     self._tear_down()
 
+  def benchmark_parallel_csv_dataset_with_floats(self):
+    self._set_up(self.FLOAT_VAL)
+    # Divides the 100 rows of each file, so that all batches are full.
+    batch_size = 50
+    for i in range(len(self._filenames)):
+      num_cols = self._num_cols[i]
+      dataset = readers.ParallelCsvDataset(
+          self._filenames[i], [[0.0]] * num_cols, batch_size=batch_size,
+          block_size=64 * 1024).repeat()
+      self._run_benchmark(dataset, num_cols, 'csv_float_parallel_dataset',
+                          records_per_element=batch_size)
+    self._tear_down()
+
+  def benchmark_csv_dataset_batched_with_floats(self):
+    self._set_up(self.FLOAT_VAL)
+    # Divides the 100 rows of each file, so that all batches are full.
+    batch_size = 50
+    for i in range(len(self._filenames)):
+      num_cols = self._num_cols[i]
+      kwargs = {'record_defaults': [[0.0]] * num_cols}
+      dataset = readers.CsvDataset(self._filenames[i], **kwargs).repeat()  # pylint: disable=cell-var-from-loop
+      dataset = dataset.batch(batch_size)
+      self._run_benchmark(dataset, num_cols, 'csv_float_fused_dataset_batched',
+                          records_per_element=batch_size)
+    self._tear_down()
+
 if __name__ == '__main__':
   test.main()
@@ -465,5 +465,98 @@ class BucketBySequenceLengthTest(test_base.DatasetTestBase,
     self.assertEqual(batches, expected_batches)
 
 
+
+@test_util.run_all_in_graph_and_eager_modes
+class BucketBySequenceLengthWithMaskTest(test_base.DatasetTestBase,
+                                         parameterized.TestCase):
+
+  def _build_dataset(self, lengths):
+
+    def element_gen():
+      for i, length in enumerate(lengths):
+        yield {"seq": [i + 1] * length, "label": i}
+
+    return dataset_ops.Dataset.from_generator(
+        element_gen, {"seq": dtypes.int64, "label": dtypes.int64},
+        {"seq": [None], "label": []})
+
+  def _read_all(self, dataset):
+    get_next = self.getNext(dataset)
+    output = []
+    with self.assertRaises(errors.OutOfRangeError):
+      while True:
+        output.append(self.evaluate(get_next()))
+    return output
+
+  @parameterized.parameters((False,), (True,))
+  def testBucketsPadsAndMasks(self, pad_to_bucket_boundary):
+    lengths = [1, 7, 2, 9, 3, 8, 1, 6]
+    dataset = self._build_dataset(lengths).apply(
+        grouping.bucket_by_sequence_length_with_mask(
+            "seq", [5], [2, 2],
+            padding_values={"seq": -1, "label": 0},
+            pad_to_bucket_boundary=pad_to_bucket_boundary))
+    batches = self._read_all(dataset)
+    self.assertLen(batches, 4)
+    seen = []
+    for batch, mask, seq_lengths in batches:
+      seq = batch["seq"]
+      self.assertEqual(mask.shape, seq.shape)
+      short = max(seq_lengths) < 5
+      if pad_to_bucket_boundary and short:
+        self.assertEqual(seq.shape[1], 4)
+      else:
+        self.assertEqual(seq.shape[1], max(seq_lengths))
+      for row, valid, length, label in zip(seq, mask, seq_lengths,
+                                           batch["label"]):
+        self.assertEqual(length, lengths[label])
+        self.assertEqual(list(valid), [j < length for j in range(len(row))])
+        self.assertEqual(list(row),
+                         [label + 1] * length + [-1] * (len(row) - length))
+        # All elements of a batch come from the same bucket.
+        self.assertEqual(length < 5, short)
+        seen.append(label)
+    self.assertCountEqual(seen, range(len(lengths)))
+
+  def testPadToBoundaryOnlyPadsSequenceFeatures(self):
+    lengths = [2, 7, 3, 9]
+
+    def element_gen():
+      for i, length in enumerate(lengths):
+        yield {"seq": [i + 1] * length, "cate": [i] * length, "tags": [i]}
+
+    dataset = dataset_ops.Dataset.from_generator(
+        element_gen,
+        {"seq": dtypes.int64, "cate": dtypes.int64, "tags": dtypes.int64},
+        {"seq": [None], "cate": [None], "tags": [None]})
+    dataset = dataset.apply(
+        grouping.bucket_by_sequence_length_with_mask(
+            "seq", [5], [2, 2], pad_to_bucket_boundary=True))
+    batches = self._read_all(dataset)
+    self.assertLen(batches, 2)
+    for batch, mask, seq_lengths in batches:
+      if max(seq_lengths) < 5:
+        # "cate" has the length of "seq", so both go to the boundary.
+        self.assertEqual(batch["seq"].shape, (2, 4))
+        self.assertEqual(batch["cate"].shape, (2, 4))
+        self.assertEqual(mask.shape, (2, 4))
+      else:
+        self.assertEqual(batch["seq"].shape, (2, 9))
+        self.assertEqual(batch["cate"].shape, (2, 9))
+      # "tags" is not a sequence feature and keeps its own length.
+      self.assertEqual(batch["tags"].shape, (2, 1))
+
+  @parameterized.parameters((False, 3), (True, 2))
+  def testRemainder(self, drop_remainder, expected_batches):
+    dataset = self._build_dataset([1, 2, 3, 9, 8]).apply(
+        grouping.bucket_by_sequence_length_with_mask(
+            "seq", [5], [2, 2], drop_remainder=drop_remainder))
+    self.assertLen(self._read_all(dataset), expected_batches)
+
+  def testInvalidBucketBatchSizes(self):
+    with self.assertRaises(ValueError):
+      grouping.bucket_by_sequence_length_with_mask("seq", [5, 10], [2, 2])
+
+
 if __name__ == "__main__":
   test.main()
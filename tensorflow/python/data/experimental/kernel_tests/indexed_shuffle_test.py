@@ -0,0 +1,109 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for `IndexedShuffleTFRecordDataset`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+from absl.testing import parameterized
+
+from tensorflow.python.data.experimental.ops import indexed_shuffle_ops
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.framework import errors
+from tensorflow.python.framework import test_util
+from tensorflow.python.lib.io import python_io
+from tensorflow.python.platform import test
+from tensorflow.python.util import compat
+
+
+@test_util.run_all_in_graph_and_eager_modes
+class IndexedShuffleTFRecordDatasetTest(test_base.DatasetTestBase,
+                                        parameterized.TestCase):
+
+  def setUp(self):
+    super(IndexedShuffleTFRecordDatasetTest, self).setUp()
+    self._num_files = 3
+    self._num_records = 37
+    self._filenames = []
+    self._records = []
+    for i in range(self._num_files):
+      filename = os.path.join(self.get_temp_dir(), "tf_record.%d.txt" % i)
+      self._filenames.append(filename)
+      writer = python_io.TFRecordWriter(filename)
+      for j in range(self._num_records):
+        # Variable sized records exercise the offset index.
+        record = compat.as_bytes("Record %d of file %d " % (j, i) + "x" * j)
+        self._records.append(record)
+        writer.write(record)
+      writer.close()
+
+  @parameterized.parameters((1, True), (7, True), (1000, True), (7, False))
+  def testProducesPermutation(self, window_size, use_mmap):
+    dataset = indexed_shuffle_ops.IndexedShuffleTFRecordDataset(
+        self._filenames, window_size=window_size, seed=42, use_mmap=use_mmap)
+    self.assertDatasetProduces(
+        dataset, expected_output=self._records, assert_items_equal=True)
+
+  def _readAll(self, dataset):
+    get_next = self.getNext(dataset)
+    output = []
+    while True:
+      try:
+        output.append(self.evaluate(get_next()))
+      except errors.OutOfRangeError:
+        return output
+
+  def testDeterministicWithSeed(self):
+    first = self._readAll(
+        indexed_shuffle_ops.IndexedShuffleTFRecordDataset(
+            self._filenames, window_size=5, seed=7))
+    second = self._readAll(
+        indexed_shuffle_ops.IndexedShuffleTFRecordDataset(
+            self._filenames, window_size=11, seed=7))
+    # The permutation only depends on the seed, not on the window size.
+    self.assertEqual(first, second)
+    self.assertNotEqual(first, self._records)
+
+  def testReshuffleEachIteration(self):
+    dataset = indexed_shuffle_ops.IndexedShuffleTFRecordDataset(
+        self._filenames, window_size=5, seed=7).repeat(2)
+    output = self._readAll(dataset)
+    num_records = len(self._records)
+    first, second = output[:num_records], output[num_records:]
+    self.assertCountEqual(first, self._records)
+    self.assertCountEqual(second, self._records)
+    self.assertNotEqual(first, second)
+
+  def testNoReshuffleEachIteration(self):
+    dataset = indexed_shuffle_ops.IndexedShuffleTFRecordDataset(
+        self._filenames, window_size=5, seed=7,
+        reshuffle_each_iteration=False).repeat(2)
+    output = self._readAll(dataset)
+    num_records = len(self._records)
+    self.assertEqual(output[:num_records], output[num_records:])
+
+  def testCorruptedFile(self):
+    filename = os.path.join(self.get_temp_dir(), "corrupted.txt")
+    with open(filename, "wb") as f:
+      f.write(b"this is not a TFRecord file")
+    dataset = indexed_shuffle_ops.IndexedShuffleTFRecordDataset([filename])
+    self.assertDatasetProduces(
+        dataset, expected_error=(errors.DataLossError, ""))
+
+
+if __name__ == "__main__":
+  test.main()
@@ -0,0 +1,116 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for `ParallelCsvDataset`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+from absl.testing import parameterized
+
+from tensorflow.python.data.experimental.ops import readers
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import errors
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import test
+
+
+@test_util.run_all_in_graph_and_eager_modes
+class ParallelCsvDatasetTest(test_base.DatasetTestBase,
+                             parameterized.TestCase):
+
+  def _setup_files(self, inputs, linebreak='\n'):
+    filenames = []
+    for i, ip in enumerate(inputs):
+      fn = os.path.join(self.get_temp_dir(), 'temp_%d.csv' % i)
+      with open(fn, 'wb') as f:
+        f.write(linebreak.join(ip).encode('utf-8'))
+      filenames.append(fn)
+    return filenames
+
+  def _inputs(self):
+    files = []
+    for i in range(3):
+      rows = ['id,score,name,count']
+      for j in range(41 + i):
+        name = '"a,""%d"""' % j if j % 5 == 0 else 'n%d' % j
+        score = '' if j % 7 == 0 else '%d.5' % j
+        rows.append('%d,%s,%s,%d' % (i * 100 + j, score, name, j * j))
+      files.append(rows)
+    return files
+
+  def _test_by_comparison(self, inputs, batch_size, linebreak='\n', **kwargs):
+    """Checks that ParallelCsvDataset is equiv to CsvDataset->batch."""
+    filenames = self._setup_files(inputs, linebreak)
+    expected = readers.CsvDataset(filenames, **kwargs).batch(batch_size)
+    actual = readers.ParallelCsvDataset(
+        filenames, batch_size=batch_size, **kwargs)
+    self.assertDatasetsEqual(actual, expected)
+
+  @parameterized.parameters((1, 4, 1), (3, 16, 7), (4, 64, 10), (2, 1 << 20, 8))
+  def testMatchesCsvDataset(self, num_parallel_reads, block_size, batch_size):
+    self._test_by_comparison(
+        self._inputs(),
+        batch_size,
+        record_defaults=[dtypes.int64, [-1.0], dtypes.string, dtypes.int32],
+        header=True,
+        num_parallel_reads=num_parallel_reads,
+        block_size=block_size)
+
+  def testSelectColsAndCrlf(self):
+    self._test_by_comparison(
+        self._inputs(),
+        6,
+        linebreak='\r\n',
+        record_defaults=[[0.0], dtypes.int32],
+        select_cols=[1, 3],
+        header=True,
+        num_parallel_reads=3,
+        block_size=32)
+
+  def testNaValueAndDelimiter(self):
+    inputs = [['1|NA|x', '2|3|NA', '3||y']]
+    self._test_by_comparison(
+        inputs,
+        2,
+        record_defaults=[dtypes.int64, [0], ['z']],
+        field_delim='|',
+        na_value='NA',
+        num_parallel_reads=2,
+        block_size=4)
+
+  def testMissingRequiredField(self):
+    filenames = self._setup_files([['1,2', '3,']])
+    dataset = readers.ParallelCsvDataset(
+        filenames, [dtypes.int32, dtypes.int32], batch_size=2)
+    self.assertDatasetProduces(
+        dataset,
+        expected_error=(errors.InvalidArgumentError,
+                        'Field 1 is required but missing in record'))
+
+  def testWrongFieldCount(self):
+    filenames = self._setup_files([['1,2', '3,4,5']])
+    dataset = readers.ParallelCsvDataset(
+        filenames, [dtypes.int32, dtypes.int32], batch_size=2)
+    self.assertDatasetProduces(
+        dataset,
+        expected_error=(errors.InvalidArgumentError,
+                        'Expect 2 fields but have more in record'))
+
+
+if __name__ == '__main__':
+  test.main()
@@ -35,12 +35,15 @@ class ParquetDatasetTest(test_base.DatasetTestBase):
   @classmethod
   def setUpClass(self):
     os.environ['CUDA_VISIBLE_DEVICES'] = ''
+    os.environ['PARQUET_DATASET_CACHE_MB'] = '64'
     self._workspace = tempfile.mkdtemp()
     self._filename = os.path.join(self._workspace, 'test.parquet')
     self._df = pd.DataFrame(
         np.random.randint(0, 100, size=(200, 4), dtype=np.int64),
     columns=list('ABCd'))
     self._df.to_parquet(self._filename)
+    self._multi_rg_filename = os.path.join(self._workspace, 'multi_rg.parquet')
+    self._df.to_parquet(self._multi_rg_filename, row_group_size=40)
 
   def test_read(self):
     batch_size = 32
@@ -192,6 +195,63 @@ class ParquetDatasetTest(test_base.DatasetTestBase):
       with self.assertRaises(tf.errors.OutOfRangeError):
         sess.run(batch)
 
+  def test_read_cached_row_groups(self):
+    batch_size = 20
+    with tf.Graph().as_default() as graph:
+      fields = [parquet_dataset_ops.DataFrame.Field('A', tf.int64),
+                parquet_dataset_ops.DataFrame.Field('C', tf.int64)]
+      ds0 = parquet_dataset_ops.ParquetDataset(
+        self._multi_rg_filename, batch_size=batch_size, fields=fields)
+      ds1 = parquet_dataset_ops.ParquetDataset(
+        self._multi_rg_filename, batch_size=batch_size, fields=fields)
+      ds = tf.data.Dataset.zip((ds0, ds1))
+      batch = tf.data.make_one_shot_iterator(ds).get_next()
+
+    a = self._df['A']
+    c = self._df['C']
+    with tf.Session(graph=graph) as sess:
+      for i in xrange(len(self._df) // batch_size):
+        result = sess.run(batch)
+        start_row = i * batch_size
+        end_row = (i + 1) * batch_size
+        for r in result:
+          np.testing.assert_equal(r['A'], a[start_row:end_row].to_numpy())
+          np.testing.assert_equal(r['C'], c[start_row:end_row].to_numpy())
+      with self.assertRaises(tf.errors.OutOfRangeError):
+        sess.run(batch)
+
+  def _read_across_row_groups(self, drop_remainder):
+    # 30 does not divide the row group size of 40, so batches span row groups.
+    batch_size = 30
+    with tf.Graph().as_default() as graph:
+      ds = parquet_dataset_ops.ParquetDataset(
+        self._multi_rg_filename,
+        batch_size=batch_size,
+        fields=[parquet_dataset_ops.DataFrame.Field('A', tf.int64),
+                parquet_dataset_ops.DataFrame.Field('C', tf.int64)],
+        drop_remainder=drop_remainder)
+      batch = tf.data.make_one_shot_iterator(ds).get_next()
+
+    a = self._df['A']
+    c = self._df['C']
+    num_rows = len(self._df)
+    if drop_remainder:
+      num_rows -= num_rows % batch_size
+    with tf.Session(graph=graph) as sess:
+      for start_row in xrange(0, num_rows, batch_size):
+        result = sess.run(batch)
+        end_row = min(start_row + batch_size, num_rows)
+        np.testing.assert_equal(result['A'], a[start_row:end_row].to_numpy())
+        np.testing.assert_equal(result['C'], c[start_row:end_row].to_numpy())
+      with self.assertRaises(tf.errors.OutOfRangeError):
+        sess.run(batch)
+
+  def test_read_across_row_groups(self):
+    self._read_across_row_groups(drop_remainder=False)
+
+  def test_read_across_row_groups_drop_remainder(self):
+    self._read_across_row_groups(drop_remainder=True)
+
 
 if __name__ == "__main__":
     test.main()
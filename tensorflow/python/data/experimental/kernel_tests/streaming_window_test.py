@@ -0,0 +1,92 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for `streaming_window()`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+
+from tensorflow.python.data.experimental.ops import streaming_ops
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import test
+
+
+@test_util.run_all_in_graph_and_eager_modes
+class StreamingWindowTest(test_base.DatasetTestBase):
+
+  def _dataset(self):
+    keys = [b"a", b"a", b"b", b"a", b"a", b"c"]
+    timestamps = np.array([5, 1, 12, 3, 4, 25], dtype=np.int64)
+    return dataset_ops.Dataset.from_tensor_slices((keys, timestamps))
+
+  def testReleasesWindowsInSampleTimeOrder(self):
+    dataset = self._dataset().apply(
+        streaming_ops.streaming_window(timestamp_index=1, window_size_ms=10))
+    # 3 and 4 arrive after their window was released and are dropped.
+    self.assertDatasetProduces(
+        dataset,
+        expected_output=[(b"a", 1), (b"a", 5), (b"b", 12), (b"c", 25)])
+
+  def testKeepStale(self):
+    dataset = self._dataset().apply(
+        streaming_ops.streaming_window(
+            timestamp_index=1, window_size_ms=10, stale_policy="keep"))
+    self.assertDatasetProduces(
+        dataset,
+        expected_output=[(b"a", 1), (b"a", 5), (b"a", 3), (b"a", 4),
+                         (b"b", 12), (b"c", 25)])
+
+  def testCompactStale(self):
+    dataset = self._dataset().apply(
+        streaming_ops.streaming_window(
+            timestamp_index=1,
+            window_size_ms=10,
+            stale_policy="compact",
+            key_index=0))
+    # Only the newest stale element of key "a" survives.
+    self.assertDatasetProduces(
+        dataset,
+        expected_output=[(b"a", 1), (b"a", 5), (b"a", 4), (b"b", 12),
+                         (b"c", 25)])
+
+  def testOutOfOrdernessDelaysWatermark(self):
+    dataset = self._dataset().apply(
+        streaming_ops.streaming_window(
+            timestamp_index=1, window_size_ms=10, max_out_of_orderness_ms=5))
+    self.assertDatasetProduces(
+        dataset,
+        expected_output=[(b"a", 1), (b"a", 3), (b"a", 4), (b"a", 5),
+                         (b"b", 12), (b"c", 25)])
+
+  def testBufferBudgetReleasesEarly(self):
+    dataset = self._dataset().apply(
+        streaming_ops.streaming_window(
+            timestamp_index=1,
+            max_buffered_bytes=1,
+            window_size_ms=10,
+            stale_policy="keep"))
+    # With a one byte budget nothing is held back, the stream passes through
+    # in arrival order.
+    self.assertDatasetProduces(
+        dataset,
+        expected_output=[(b"a", 5), (b"a", 1), (b"b", 12), (b"a", 3),
+                         (b"a", 4), (b"c", 25)])
+
+
+if __name__ == "__main__":
+  test.main()
@@ -244,6 +244,66 @@ def bucket_by_sequence_length(element_length_func,
     return _apply_fn
 
 
+def bucket_by_sequence_length_with_mask(sequence_key,
+                                        bucket_boundaries,
+                                        bucket_batch_sizes,
+                                        padding_values=None,
+                                        pad_to_bucket_boundary=False,
+                                        drop_remainder=False):
+  """A transformation that buckets elements by length and emits their mask.
+
+  Like `bucket_by_sequence_length`, but the length is read from dimension 0 of
+  one component instead of a function, the grouping and padding run in a
+  single kernel, and each batch comes with the mask and lengths of that
+  component. Elements of the resulting dataset are
+  `(batch, mask, lengths)`, where `batch` has the structure of the input
+  padded to a common shape, `mask` is a `tf.bool` tensor of shape
+  `[batch_size, max_length]` that is `True` on the valid positions of the
+  sequence component, and `lengths` is a `tf.int32` vector.
+
+  Padding is bounded by the width of the bucket of each batch, so when most
+  sequences are short the embedding lookups and attention over padded
+  positions shrink accordingly.
+
+  Args:
+    sequence_key: The sequence component: a key (or tuple of keys, for nested
+      structures) into the input element, whose dimension 0 is the length.
+      Use `None` when the element is a single tensor.
+    bucket_boundaries: `list<int>`, upper length boundaries of the buckets.
+    bucket_batch_sizes: `list<int>`, batch size per bucket. Length should be
+      `len(bucket_boundaries) + 1`.
+    padding_values: (Optional.) Values to pad with, a structure of scalars
+      matching the input. Defaults to 0 or the empty string.
+    pad_to_bucket_boundary: bool, if `True`, the dimension 0 of the sequence
+      features is padded to the bucket boundary minus 1 instead of the longest
+      length in the batch. The sequence features are the sequence component
+      and the other variable length components whose dimension 0 equals the
+      sequence length in every element, so they stay aligned with `mask`.
+      Other components are padded to the largest element in the batch.
+    drop_remainder: (Optional.) A `tf.bool` scalar `tf.Tensor`, whether the
+      partial batches left in the buckets at the end of the input are dropped.
+
+  Returns:
+    A `Dataset` transformation function, which can be passed to
+    `tf.data.Dataset.apply`.
+
+  Raises:
+    ValueError: if `len(bucket_batch_sizes) != len(bucket_boundaries) + 1`.
+  """
+  if len(bucket_batch_sizes) != (len(bucket_boundaries) + 1):
+    raise ValueError(
+        "len(bucket_batch_sizes) must equal len(bucket_boundaries) + 1")
+
+  def _apply_fn(dataset):
+    return _BucketBySequenceLengthDataset(dataset, sequence_key,
+                                          bucket_boundaries, bucket_batch_sizes,
+                                          padding_values,
+                                          pad_to_bucket_boundary,
+                                          drop_remainder)
+
+  return _apply_fn
+
+
 class _GroupByReducerDataset(dataset_ops.UnaryDataset):
   """A `Dataset` that groups its input and performs a reduction."""
 
@@ -439,6 +499,77 @@ class _GroupByWindowDataset(dataset_ops.UnaryDataset):
     return "tf.data.experimental.group_by_window()"
 
 
+class _BucketBySequenceLengthDataset(dataset_ops.UnaryDataset):
+  """A `Dataset` that batches and pads its input by sequence length."""
+
+  def __init__(self, input_dataset, sequence_key, bucket_boundaries,
+               bucket_batch_sizes, padding_values, pad_to_bucket_boundary,
+               drop_remainder):
+    """See `bucket_by_sequence_length_with_mask()` for details."""
+    self._input_dataset = input_dataset
+    input_types = dataset_ops.get_legacy_output_types(input_dataset)
+    input_shapes = dataset_ops.get_legacy_output_shapes(input_dataset)
+    input_classes = dataset_ops.get_legacy_output_classes(input_dataset)
+    if any(c is not ops.Tensor for c in nest.flatten(input_classes)):
+      raise TypeError(
+          "bucket_by_sequence_length_with_mask only supports dense tensors")
+
+    flat_types = nest.flatten(input_types)
+    indices = nest.pack_sequence_as(input_types, list(range(len(flat_types))))
+    if sequence_key is not None:
+      keys = sequence_key if isinstance(sequence_key, tuple) else (
+          sequence_key,)
+      for key in keys:
+        indices = indices[key]
+    if not isinstance(indices, int):
+      raise ValueError("`sequence_key` must select a single component, got %s"
+                       % (sequence_key,))
+    self._length_index = indices
+
+    padding_values = (
+        padding_values if padding_values is not None else
+        dataset_ops._default_padding(input_dataset))  # pylint: disable=protected-access
+    self._padding_values = nest.map_structure_up_to(
+        input_shapes, dataset_ops._padding_value_to_tensor, padding_values,  # pylint: disable=protected-access
+        input_types)
+    self._bucket_boundaries = ops.convert_to_tensor(
+        bucket_boundaries, dtype=dtypes.int64, name="bucket_boundaries")
+    self._bucket_batch_sizes = ops.convert_to_tensor(
+        bucket_batch_sizes, dtype=dtypes.int64, name="bucket_batch_sizes")
+    self._drop_remainder = ops.convert_to_tensor(
+        drop_remainder, dtype=dtypes.bool, name="drop_remainder")
+
+    def _batch_shape(shape):
+      shape = tensor_shape.TensorShape(shape)
+      return tensor_shape.TensorShape([None]).concatenate(shape)
+
+    batch_shapes = nest.map_structure(_batch_shape, input_shapes)
+    flat_batch_shapes = nest.flatten(batch_shapes)
+    length_shape = flat_batch_shapes[self._length_index]
+    if length_shape.rank is not None and length_shape.rank < 2:
+      raise ValueError("The sequence component must have rank >= 1")
+    self._structure = (
+        structure.convert_legacy_structure(input_types, batch_shapes,
+                                           input_classes),
+        tensor_spec.TensorSpec([None, None], dtypes.bool),
+        tensor_spec.TensorSpec([None], dtypes.int32))
+    variant_tensor = ged_ops.bucket_by_sequence_length_dataset(
+        self._input_dataset._variant_tensor,  # pylint: disable=protected-access
+        bucket_boundaries=self._bucket_boundaries,
+        bucket_batch_sizes=self._bucket_batch_sizes,
+        padding_values=nest.flatten(self._padding_values),
+        drop_remainder=self._drop_remainder,
+        length_index=self._length_index,
+        pad_to_bucket_boundary=pad_to_bucket_boundary,
+        **self._flat_structure)
+    super(_BucketBySequenceLengthDataset, self).__init__(
+        input_dataset, variant_tensor)
+
+  @property
+  def element_spec(self):
+    return self._structure
+
+
 @tf_export("data.experimental.Reducer")
 class Reducer(object):
   """A reducer is used for reducing a set of elements.
@@ -0,0 +1,88 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Out-of-core shuffling of TFRecord files through a record offset index."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.data.util import convert
+from tensorflow.python.data.util import random_seed
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import tensor_spec
+from tensorflow.python.ops import gen_experimental_dataset_ops
+
+
+class IndexedShuffleTFRecordDataset(dataset_ops.DatasetSource):
+  """A `Dataset` of the records of TFRecord files in a global random order.
+
+  Unlike `Dataset.shuffle`, which keeps `buffer_size` records in memory, this
+  dataset keeps only the offset and length of every record and shuffles those.
+  The memory footprint is 16 bytes per record regardless of the record size,
+  the first element is available as soon as the record headers are scanned,
+  and every epoch is a uniform permutation over all input files.
+
+  Records are fetched `window_size` at a time. Reads within a window are issued
+  in file/offset order to keep the I/O mostly sequential.
+
+  ```python
+  dataset = IndexedShuffleTFRecordDataset(filenames, window_size=4096, seed=1)
+  dataset = dataset.map(parse_fn).batch(512)
+  ```
+  """
+
+  def __init__(self,
+               filenames,
+               window_size=1024,
+               seed=None,
+               use_mmap=True,
+               reshuffle_each_iteration=None):
+    """Creates an `IndexedShuffleTFRecordDataset`.
+
+    Args:
+      filenames: A `tf.string` tensor containing one or more uncompressed
+        TFRecord filenames.
+      window_size: (Optional.) A `tf.int64` scalar, the number of records read
+        together. Larger windows give more read locality at the cost of
+        `window_size` buffered records.
+      seed: (Optional.) A `tf.int64` scalar `tf.Tensor`, representing the
+        random seed that will be used to create the permutation. See
+        `tf.compat.v1.set_random_seed` for behavior.
+      use_mmap: (Optional.) Whether to memory map the files. Positional reads
+        are used when False or when the file system does not support it.
+      reshuffle_each_iteration: (Optional.) A boolean, which if true indicates
+        that the dataset should be pseudorandomly reshuffled each time it is
+        iterated over. (Defaults to `True`.)
+    """
+    self._filenames = ops.convert_to_tensor(
+        filenames, dtype=dtypes.string, name="filenames")
+    self._window_size = convert.optional_param_to_tensor(
+        "window_size", window_size, argument_default=1024)
+    self._seed, self._seed2 = random_seed.get_seed(seed)
+    if reshuffle_each_iteration is None:
+      reshuffle_each_iteration = True
+    variant_tensor = gen_experimental_dataset_ops.indexed_shuffle_tf_record_dataset(
+        self._filenames,
+        window_size=self._window_size,
+        seed=self._seed,
+        seed2=self._seed2,
+        use_mmap=use_mmap,
+        reshuffle_each_iteration=reshuffle_each_iteration)
+    super(IndexedShuffleTFRecordDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return tensor_spec.TensorSpec([], dtypes.string)
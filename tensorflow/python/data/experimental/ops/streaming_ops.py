@@ -0,0 +1,114 @@
+# Copyright 2023 The DeepRec Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Bounded-memory event-time windowing for streaming input pipelines."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import gen_dataset_ops
+
+
+class _StreamingWindowDataset(dataset_ops.UnaryUnchangedStructureDataset):
+  """A `Dataset` that windows a stream by sample time with bounded memory."""
+
+  def __init__(self, input_dataset, timestamp_index, max_buffered_bytes,
+               window_size_ms, max_out_of_orderness_ms, max_staleness_ms,
+               stale_policy, key_index):
+    self._input_dataset = input_dataset
+    self._max_buffered_bytes = ops.convert_to_tensor(
+        max_buffered_bytes, dtype=dtypes.int64, name="max_buffered_bytes")
+    self._window_size_ms = ops.convert_to_tensor(
+        window_size_ms, dtype=dtypes.int64, name="window_size_ms")
+    self._max_out_of_orderness_ms = ops.convert_to_tensor(
+        max_out_of_orderness_ms, dtype=dtypes.int64,
+        name="max_out_of_orderness_ms")
+    self._max_staleness_ms = ops.convert_to_tensor(
+        max_staleness_ms, dtype=dtypes.int64, name="max_staleness_ms")
+    variant_tensor = gen_dataset_ops.streaming_window_dataset(
+        self._input_dataset._variant_tensor,  # pylint: disable=protected-access
+        max_buffered_bytes=self._max_buffered_bytes,
+        window_size_ms=self._window_size_ms,
+        max_out_of_orderness_ms=self._max_out_of_orderness_ms,
+        max_staleness_ms=self._max_staleness_ms,
+        timestamp_index=timestamp_index,
+        key_index=-1 if key_index is None else key_index,
+        stale_policy=stale_policy,
+        **self._flat_structure)
+    super(_StreamingWindowDataset, self).__init__(input_dataset,
+                                                  variant_tensor)
+
+
+def streaming_window(timestamp_index,
+                     max_buffered_bytes=64 << 20,
+                     window_size_ms=1000,
+                     max_out_of_orderness_ms=0,
+                     max_staleness_ms=0,
+                     stale_policy="drop",
+                     key_index=None):
+  """Windows a streaming dataset by sample time under a memory budget.
+
+  The transformation pulls from its input only while less than
+  `max_buffered_bytes` are buffered, so a slow trainer throttles the upstream
+  consumer (e.g. a `KafkaDataset`) instead of growing prefetch buffers.
+  Elements are grouped into tumbling windows of `window_size_ms` by their
+  sample time. A window is released, sorted by sample time, once the largest
+  sample time seen minus `max_out_of_orderness_ms` passes its end, so batches
+  built downstream respect sample time.
+
+  Elements older than `max_staleness_ms` relative to the wall clock, or whose
+  window has already been released, are handled by `stale_policy`: "drop"
+  discards them, "compact" keeps only the newest one per `key_index` value and
+  "keep" produces them ahead of the next window.
+
+  The buffered bytes, the lag between wall clock and sample time and the
+  number of dropped elements are exported as
+  `/tensorflow/data/streaming/{buffered_bytes,lag_ms,dropped_elements}` and,
+  when a stats aggregator is attached, as scalars of the dataset node.
+
+  ```python
+  dataset = tf.data.KafkaDataset(topics, message_timestamp=True)
+  dataset = dataset.apply(streaming_window(
+      timestamp_index=1, max_buffered_bytes=256 << 20, window_size_ms=60000,
+      max_staleness_ms=3600 * 1000))
+  ```
+
+  Args:
+    timestamp_index: The index of the flattened `tf.int64` component holding
+      the sample time in milliseconds since the epoch.
+    max_buffered_bytes: (Optional.) The memory budget of the stage in bytes.
+    window_size_ms: (Optional.) The window length in milliseconds.
+    max_out_of_orderness_ms: (Optional.) How far behind the largest sample
+      time the watermark is kept.
+    max_staleness_ms: (Optional.) The maximum age of an element relative to
+      the wall clock. Values <= 0 disable the check.
+    stale_policy: (Optional.) One of "drop", "compact" or "keep".
+    key_index: (Optional.) The index of the flattened component identifying a
+      sample, required by the "compact" policy.
+
+  Returns:
+    A `Dataset` transformation function, which can be passed to
+    `tf.data.Dataset.apply`.
+  """
+
+  def _apply_fn(dataset):
+    return _StreamingWindowDataset(dataset, timestamp_index,
+                                   max_buffered_bytes, window_size_ms,
+                                   max_out_of_orderness_ms, max_staleness_ms,
+                                   stale_policy, key_index)
+
+  return _apply_fn
@@ -511,6 +511,7 @@ class KafkaDataset(dataset_ops.Dataset):
         config_global=None,
         config_topic=None,
         message_key=False,
+        message_timestamp=False,
     ):
         """Create a KafkaReader.
 
@@ -535,6 +536,9 @@ class KafkaDataset(dataset_ops.Dataset):
                     please refer to 'Topic configuration properties'
                     in librdkafka doc.
       message_key: If True, the kafka will output both message value and key.
+      message_timestamp: If True, the message timestamp in milliseconds is
+                         output as an extra `tf.int64` component after the
+                         message value (and key).
     """
         self._topics = ops.convert_to_tensor(topics, dtype=dtypes.string, name="topics")
         self._servers = ops.convert_to_tensor(
@@ -554,6 +558,7 @@ class KafkaDataset(dataset_ops.Dataset):
             config_topic, dtype=dtypes.string, name="config_topic"
         )
         self._message_key = message_key
+        self._message_timestamp = message_timestamp
         super(KafkaDataset, self).__init__()
 
     def _inputs(self):
@@ -569,25 +574,32 @@ class KafkaDataset(dataset_ops.Dataset):
             self._config_global,
             self._config_topic,
             self._message_key,
+            message_timestamp=self._message_timestamp,
         )
 
+    def _output_components(self):
+        components = [dtypes.string]
+        if self._message_key:
+            components.append(dtypes.string)
+        if self._message_timestamp:
+            components.append(dtypes.int64)
+        return components
+
     @property
     def output_classes(self):
-        return (ops.Tensor) if not self._message_key else (ops.Tensor, ops.Tensor)
+        classes = tuple(ops.Tensor for _ in self._output_components())
+        return classes[0] if len(classes) == 1 else classes
 
     @property
     def output_shapes(self):
-        return (
-            (tensor_shape.TensorShape([]))
-            if not self._message_key
-            else (tensor_shape.TensorShape([]), tensor_shape.TensorShape([]))
-        )
+        shapes = tuple(
+            tensor_shape.TensorShape([]) for _ in self._output_components())
+        return shapes[0] if len(shapes) == 1 else shapes
 
     @property
     def output_types(self):
-        return (
-            (dtypes.string) if not self._message_key else (dtypes.string, dtypes.string)
-        )
+        types = tuple(self._output_components())
+        return types[0] if len(types) == 1 else types
 
 
 def write_kafka(message, topic, servers="localhost", name=None):
@@ -34,12 +34,15 @@ from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.framework.sparse_tensor import SparseTensor
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import bitwise_ops
+from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import gen_kv_variable_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.ops import variables
 from tensorflow.python.ops import sparse_ops
 from tensorflow.python.ops import init_ops
+from tensorflow.python.training.saving import saveable_object
 from tensorflow.python.util import nest
 
 class CoalescedScopeBase(object):
@@ -135,7 +138,10 @@ class EmbeddingAttributes(object):
                combiner,
                trainable,
                hash_combiner='',
-               bucket_size=None):
+               bucket_size=None,
+               ev_option=None,
+               partition_num=None,
+               key_dtype=None):
     self._dimension = dimension
     self._dtype = dtype
     self._initializer = initializer
@@ -143,6 +149,9 @@ class EmbeddingAttributes(object):
     self._trainable = trainable
     self._hash_combiner = hash_combiner
     self._bucket_size = bucket_size
+    self._ev_option = ev_option
+    self._partition_num = partition_num
+    self._key_dtype = key_dtype
 
   @property
   def dimension(self):
@@ -172,6 +181,23 @@ class EmbeddingAttributes(object):
   def bucket_size(self):
     return self._bucket_size
 
+  @property
+  def ev_option(self):
+    """`EmbeddingVariableOption` of columns backed by an EmbeddingVariable."""
+    return self._ev_option
+
+  @property
+  def partition_num(self):
+    return self._partition_num
+
+  @property
+  def key_dtype(self):
+    return self._key_dtype
+
+  @property
+  def is_embedding_variable(self):
+    return self._ev_option is not None
+
 class CoalescedSaveSliceInfo(object):
   def __init__(self,
                full_name,
@@ -250,13 +276,31 @@ def get_embedding_signature():
 
 def add_embedding_signature(column, dimension, combiner, initializer,
                             trainable, bucket_size, dtype=dtypes.float32,
-                            hash_combiner=''):
+                            hash_combiner='', ev_option=None,
+                            partition_num=None, key_dtype=None):
   global _embedding_signatures
   if column in _embedding_signatures:
     raise ValueError('EmbeddingColumn already exists: {}'.format(column))
   _embedding_signatures[column] = EmbeddingAttributes(
       dimension, dtype, initializer, combiner, trainable, hash_combiner,
-      bucket_size)
+      bucket_size, ev_option, partition_num, key_dtype)
+
+def _option_signature(option):
+  """Returns a JSON serializable description of an option object."""
+  if option is None or isinstance(option, (bool, int, float,
+                                           six.string_types)):
+    return option
+  if isinstance(option, dtypes.DType):
+    return option.name
+  if isinstance(option, (list, tuple)):
+    return [_option_signature(o) for o in option]
+  if isinstance(option, dict):
+    return {str(k): _option_signature(v) for k, v in option.items()}
+  if hasattr(option, '__dict__'):
+    signature = {k: _option_signature(v) for k, v in vars(option).items()}
+    signature['__type__'] = type(option).__name__
+    return signature
+  return str(option)
 
 def make_cluster_signature(column, hashtable_column=False):
   if hashtable_column:
@@ -272,6 +316,14 @@ def make_cluster_signature(column, hashtable_column=False):
       'initializer': type(attr.initializer).__name__,
       'initializer_config': attr.initializer.get_config(),
   }
+  if not hashtable_column and attr.is_embedding_variable:
+    # Columns share an EmbeddingVariable only if it would be created with the
+    # same options for each of them.
+    signature['embedding_variable'] = {
+        'ev_option': _option_signature(attr.ev_option),
+        'partition_num': attr.partition_num,
+        'key_dtype': dtypes.as_dtype(attr.key_dtype).name,
+    }
   return json.dumps(signature, sort_keys=True)
 
 def _make_runtime_signature(column, hashtable_column=False):
@@ -298,6 +350,122 @@ def get_signature_attributes(column):
     raise ValueError('signautre not found for column: {}'.format(column))
   return _embedding_signatures[column]
 
+# Keys of coalesced EmbeddingVariables carry the index of their feature in
+# the high bits, and the low bits of the original key.
+FEATURE_INDEX_LENGTH = 12
+FEATURE_KEY_LENGTH = 64 - FEATURE_INDEX_LENGTH
+FEATURE_KEY_MASK = (1 << FEATURE_KEY_LENGTH) - 1
+MAX_COALESCED_FEATURES = 1 << FEATURE_INDEX_LENGTH
+
+def encode_feature_keys(keys, index, hashed=False):
+  """Encodes int64 `keys` of the feature at `index` of a coalesced storage.
+
+  Ids must be less than 2**FEATURE_KEY_LENGTH, so that the keys of different
+  features never collide; a larger id fails the lookup instead of being
+  truncated. Negative ids are left as they are, so that they are pruned like
+  the invalid ids of an uncoalesced column. Hashed keys, e.g. of string
+  features, are reduced to a FEATURE_KEY_LENGTH-bit hash.
+  """
+  if hashed:
+    keys = bitwise_ops.bitwise_and(
+        keys, constant_op.constant(FEATURE_KEY_MASK, dtypes.int64))
+  else:
+    check = control_flow_ops.Assert(
+        math_ops.reduce_all(math_ops.less_equal(
+            keys, constant_op.constant(FEATURE_KEY_MASK, dtypes.int64))),
+        ['Ids of coalesced EmbeddingVariable columns must be less than 2**%d, '
+         'got max id:' % FEATURE_KEY_LENGTH, math_ops.reduce_max(keys)])
+    with ops.control_dependencies([check]):
+      keys = array_ops.identity(keys)
+  encoded = bitwise_ops.bitwise_or(
+      keys, constant_op.constant(index << FEATURE_KEY_LENGTH, dtypes.int64))
+  if hashed:
+    return encoded
+  return array_ops.where(math_ops.less(keys, 0), keys, encoded)
+
+def decode_feature_keys(keys):
+  """Returns (feature indices, original keys) of encoded `keys`."""
+  indices = bitwise_ops.right_shift(
+      keys, constant_op.constant(FEATURE_KEY_LENGTH, dtypes.int64))
+  indices = bitwise_ops.bitwise_and(
+      indices, constant_op.constant(MAX_COALESCED_FEATURES - 1, dtypes.int64))
+  keys = bitwise_ops.bitwise_and(
+      keys, constant_op.constant(FEATURE_KEY_MASK, dtypes.int64))
+  return indices, keys
+
+class CoalescedFeatureSaveable(saveable_object.SaveableObject):
+  """Saves the keys of one integer feature of a coalesced EmbeddingVariable.
+
+  The tensors are written in the checkpoint format of an EmbeddingVariable
+  named `name`, with the keys decoded to the ids of the feature, so that an
+  uncoalesced EmbeddingVariable of the feature restores them directly. On
+  restore the ids are encoded again and inserted into the coalesced storage.
+  String features can not be saved this way: only the low bits of their
+  hashes are stored.
+  """
+
+  def __init__(self, var, index, name):
+    if isinstance(var, variables.PartitionedVariable):
+      self._parts = list(var)
+    else:
+      self._parts = [var]
+    self._index = index
+    keys_list = []
+    values_list = []
+    versions_list = []
+    freqs_list = []
+    for part in self._parts:
+      keys, values, versions, freqs = part.export()
+      keys = math_ops.cast(keys, dtypes.int64)
+      num_keys = array_ops.size(keys)
+      # Versions and frequencies are only exported when they are recorded.
+      versions = control_flow_ops.cond(
+          math_ops.equal(array_ops.size(versions), num_keys),
+          lambda v=versions: v,
+          lambda n=num_keys: array_ops.fill(
+              [n], constant_op.constant(-1, dtypes.int64)))
+      freqs = control_flow_ops.cond(
+          math_ops.equal(array_ops.size(freqs), num_keys),
+          lambda f=freqs: f,
+          lambda n=num_keys: array_ops.zeros([n], dtypes.int64))
+      indices, keys = decode_feature_keys(keys)
+      mask = math_ops.equal(indices, index)
+      keys_list.append(array_ops.boolean_mask(keys, mask))
+      values_list.append(array_ops.boolean_mask(values, mask))
+      versions_list.append(array_ops.boolean_mask(versions, mask))
+      freqs_list.append(array_ops.boolean_mask(freqs, mask))
+    device = self._parts[0].device
+    specs = [
+        saveable_object.SaveSpec(array_ops.concat(keys_list, 0), '',
+                                 name + '-keys', device=device),
+        saveable_object.SaveSpec(array_ops.concat(values_list, 0), '',
+                                 name + '-values', device=device),
+        saveable_object.SaveSpec(array_ops.concat(versions_list, 0), '',
+                                 name + '-versions', device=device),
+        saveable_object.SaveSpec(array_ops.concat(freqs_list, 0), '',
+                                 name + '-freqs', device=device),
+    ]
+    super(CoalescedFeatureSaveable, self).__init__(var, specs, name)
+
+  def restore(self, restored_tensors, unused_restored_shapes):
+    keys, values, versions, freqs = restored_tensors
+    keys = encode_feature_keys(keys, self._index)
+    restore_dependency = ops.get_collection(
+        ops.GraphKeys.EMBEDDING_VARIABLE_RESTORE_DEPENDENCY)
+    restore_ops = []
+    for i, part in enumerate(self._parts):
+      dependencies = []
+      if restore_dependency:
+        # pylint: disable=protected-access
+        dependencies = restore_dependency[0].get(part._primary_handle, [])
+      with ops.colocate_with(part.handle), \
+           ops.control_dependencies(dependencies):
+        restore_ops.append(gen_kv_variable_ops.kv_resource_import_keys(
+            part.handle, math_ops.cast(keys, part._invalid_key_type),
+            values, versions, freqs, partition_id=i,
+            partition_num=len(self._parts)))
+    return control_flow_ops.group(restore_ops)
+
 def check_coalesced_columns_compatible(columns, hashtable_column=False):
   base = None
   for i, c in enumerate(columns):
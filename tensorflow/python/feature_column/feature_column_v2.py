@@ -972,9 +972,18 @@ def embedding_column(categorical_column,
     fused_scope.add_column(column)
   if coalesced_scope:
     coalesced_scope.add_column(column)
-    coalesced_utils.add_embedding_signature(
-        column, dimension, combiner, initializer, trainable,
-        categorical_column._num_buckets)
+    if isinstance(categorical_column, EmbeddingCategoricalColumn):
+      key_dtype = (dtypes.int64 if categorical_column.dtype == dtypes.string
+                   else categorical_column.dtype)
+      coalesced_utils.add_embedding_signature(
+          column, dimension, combiner, initializer, trainable, None,
+          ev_option=categorical_column.ev_option,
+          partition_num=categorical_column.partition_num,
+          key_dtype=key_dtype)
+    else:
+      coalesced_utils.add_embedding_signature(
+          column, dimension, combiner, initializer, trainable,
+          categorical_column._num_buckets)
   return column
 
 
@@ -5917,8 +5926,13 @@ class CoalescedEmbeddingScope(coalesced_utils.CoalescedScopeBase):
     for h, names_and_columns in cluster.items():
       names, columns = zip(*names_and_columns)
       coalesced_name = self.get_name()
-      coalesced_column = CoalescedEmbeddingColumn(
-          columns, coalesced_name, self._num_partitions)
+      attr = coalesced_utils.get_signature_attributes(columns[0])
+      if attr.is_embedding_variable:
+        coalesced_column = CoalescedEmbeddingVariableColumn(
+            columns, coalesced_name)
+      else:
+        coalesced_column = CoalescedEmbeddingColumn(
+            columns, coalesced_name, self._num_partitions)
       for name in names:
         self._coalesced_map[name] = coalesced_column
     self._built = True
@@ -6207,6 +6221,234 @@ class CoalescedEmbeddingColumn(object):
     return list(zip(*sorted(embedding_outputs)))[1]
 
 
+def _variable_name(var):
+  """Returns the name a (partitioned) variable is saved under."""
+  if isinstance(var, variables.PartitionedVariable):
+    return var.name
+  return var.op.name
+
+
+class CoalescedEmbeddingVariableColumn(object):
+  """Coalescing EmbeddingColumns backed by EmbeddingVariables into one.
+
+  Columns with the same signature, i.e. the same dimension, initializer and
+  `EmbeddingVariableOption`, share one EmbeddingVariable keyed by
+  (feature index, key), where the index of the feature is kept in the high
+  `coalesced_utils.FEATURE_INDEX_LENGTH` bits of the key. The ids of all the
+  features are looked up, and their gradients applied, in one batch instead of
+  once per feature.
+
+  Args:
+    columns: An iterable of `EmbeddingColumn`s over
+      `EmbeddingCategoricalColumn`s with compatible signatures.
+    name: Name of the coalesced column, used as variable scope of the shared
+      EmbeddingVariable.
+
+  Raises:
+    ValueError: if `columns` is empty, contains unsupported columns or more
+      columns than can be encoded in the key.
+  """
+
+  def __init__(self, columns, name):
+    if len(columns) == 0:
+      raise ValueError('columns cannot be empty')
+    for i, c in enumerate(columns):
+      if not isinstance(c, EmbeddingColumn) or not isinstance(
+          c.categorical_column, EmbeddingCategoricalColumn):
+        raise ValueError('columns must be EmbeddingColumns over '
+                         'EmbeddingCategoricalColumns, '
+                         'Given {} at index {}'.format(c, i))
+      if c not in coalesced_utils.get_embedding_signature():
+        raise ValueError('signature not found for column: {}'.format(c))
+    coalesced_utils.check_coalesced_columns_compatible(columns)
+
+    self._columns = columns
+    self._name = name
+    self._default_attr = coalesced_utils.get_signature_attributes(columns[0])
+    self._unique_columns, self._indices_map = \
+        coalesced_utils.deduplicate_shared_embedding(self._columns)
+    if len(self._unique_columns) > coalesced_utils.MAX_COALESCED_FEATURES:
+      raise ValueError('Cannot coalesce more than {} EmbeddingVariables, '
+                       'got {}'.format(coalesced_utils.MAX_COALESCED_FEATURES,
+                                       len(self._unique_columns)))
+    self._runtime_columns = collections.defaultdict(list)
+    for i, column in enumerate(columns):
+      h = coalesced_utils._make_runtime_signature(column)
+      self._runtime_columns[h].append((i, column))
+
+  @property
+  def name(self):
+    return self._name
+
+  @property
+  def columns(self):
+    return self._columns
+
+  def _get_unique_index(self, column):
+    name = column.name
+    if name not in self._indices_map:
+      raise ValueError('column {} not coalesced'.format(name))
+    return self._indices_map[name]
+
+  def encode(self, data, index, hashed=False):
+    if not isinstance(data, sparse_tensor_lib.SparseTensor):
+      raise ValueError('data should be a SparseTensor, Given {}'.format(data))
+    values = coalesced_utils.encode_feature_keys(
+        math_ops.cast(data.values, dtype=dtypes.int64), index, hashed)
+    return sparse_tensor_lib.SparseTensor(indices=data.indices,
+                                          values=values,
+                                          dense_shape=data.dense_shape)
+
+  def make_sparse_inputs(self, transformation_cache, state_manager):
+    result_list = []
+    for runtime_columns in self._runtime_columns.values():
+      ids_list = []
+      weights_list = []
+      weight_type = None
+      for c in runtime_columns:
+        sparse_tensors = c[1].categorical_column.get_sparse_tensors(
+            transformation_cache, state_manager)
+        ids, weights = fc_utils.parse_sparse_data(sparse_tensors)
+        if ids is None:
+          raise ValueError('sparse ids cannot be None')
+        # String ids are already hashed to int64 by the categorical column.
+        hashed = c[1].categorical_column.dtype == dtypes.string
+        ids_list.append(self.encode(ids, self._get_unique_index(c[1]), hashed))
+        weights_list.append(weights)
+        if weights is not None:
+          if weight_type is None:
+            weight_type = weights.dtype
+          elif weight_type != weights.dtype:
+            raise ValueError('all weights should have same dtype, but got '
+                             '{} and {}'.format(weight_type, weights.dtype))
+      if weight_type is None:
+        weight_type = dtypes.float32
+      result_list.append(coalesced_utils.coalesce_sparse_data(
+          ids_list, weights_list, weight_type))
+    return result_list
+
+  def get_or_create_embedding_weights(self):
+    if not hasattr(self, '_embedding_weights'):
+      attr = self._default_attr
+      if attr.partition_num is None:
+        partitioner = None
+      else:
+        partitioner = partitioned_variables.fixed_size_partitioner(
+            attr.partition_num)
+      self._embedding_weights = variable_scope.get_embedding_variable_internal(
+          name='embedding_weights',
+          embedding_dim=attr.dimension,
+          key_dtype=dtypes.int64,
+          initializer=attr.initializer,
+          trainable=attr.trainable,
+          partitioner=partitioner,
+          ev_option=attr.ev_option)
+    return self._embedding_weights
+
+  def feature_view(self, column):
+    """Returns the `(keys, values)` that `column` has in the shared storage.
+
+    The keys are decoded back to the ids of the feature, so the result can be
+    exported or compared with a per-feature EmbeddingVariable.
+    """
+    index = self._get_unique_index(column)
+    embedding_weights = self.get_or_create_embedding_weights()
+    if isinstance(embedding_weights, variables.PartitionedVariable):
+      parts = list(embedding_weights)
+    else:
+      parts = [embedding_weights]
+    keys_list = []
+    values_list = []
+    for part in parts:
+      keys, values, _, _ = part.export()
+      indices, keys = coalesced_utils.decode_feature_keys(
+          math_ops.cast(keys, dtypes.int64))
+      mask = math_ops.equal(indices, index)
+      keys_list.append(array_ops.boolean_mask(keys, mask))
+      values_list.append(array_ops.boolean_mask(values, mask))
+    return (array_ops.concat(keys_list, axis=0),
+            array_ops.concat(values_list, axis=0))
+
+  def feature_saveables(self, var=None, name_fn=None):
+    """Returns `SaveableObject`s that checkpoint each feature separately.
+
+    Each feature of integer ids is written under the name of the
+    EmbeddingVariable it would have without coalescing, in the
+    EmbeddingVariable checkpoint format with the original ids as keys, and
+    is restored into the shared storage by re-encoding the ids. Pass them to
+    a `Saver` to exchange checkpoints with models that do not coalesce the
+    columns.
+
+    Args:
+      var: The coalesced EmbeddingVariable, or one of its optimizer slots.
+        Defaults to the embedding weights.
+      name_fn: Maps a column to the checkpoint name of its EmbeddingVariable.
+        Defaults to `<column name>/embedding_weights` in the scope that
+        contains the coalesced storage, which is the name the column has
+        without coalescing. The name of the slot is appended for a slot
+        variable.
+
+    Returns:
+      A list with one `SaveableObject` per unique feature.
+
+    Raises:
+      ValueError: If a feature has string ids. The shared storage only keeps
+        a 52-bit hash of them, which an uncoalesced column can not look up.
+    """
+    for c in self._unique_columns:
+      if c.categorical_column.dtype == dtypes.string:
+        raise ValueError(
+            'Column {} has string ids, which are only saved as 52-bit hashes '
+            'in a coalesced EmbeddingVariable and can not be checkpointed per '
+            'feature.'.format(c.name))
+    embedding_weights = self.get_or_create_embedding_weights()
+    if var is None:
+      var = embedding_weights
+    weights_name = _variable_name(embedding_weights)
+    var_name = _variable_name(var)
+    if var_name != weights_name and not var_name.startswith(weights_name + '/'):
+      raise ValueError('{} is not a slot of {}'.format(var_name, weights_name))
+    suffix = var_name[len(weights_name):]
+    if name_fn is None:
+      scope = weights_name.rsplit('/', 2)
+      prefix = scope[0] + '/' if len(scope) == 3 else ''
+      name_fn = lambda c: '{}{}/embedding_weights'.format(prefix, c.name)
+    return [coalesced_utils.CoalescedFeatureSaveable(
+                var, self._get_unique_index(c), name_fn(c) + suffix)
+            for c in self._unique_columns]
+
+  def _get_dense_tensor(self, inputs, weight_collections=None, trainable=None):
+    return _raise_shared_embedding_column_error()
+
+  def get_dense_tensor(self, transformation_cache, state_manager):
+    embedding_weights = self.get_or_create_embedding_weights()
+    lookup_input_list = self.make_sparse_inputs(
+        transformation_cache, state_manager)
+    embedding_outputs = []
+    for lookup_input, cids_and_columns in zip(lookup_input_list,
+                                              self._runtime_columns.values()):
+      cids, columns = zip(*cids_and_columns)
+      embeddings = embedding_ops.safe_embedding_lookup_sparse(
+          embedding_weights=embedding_weights,
+          sparse_ids=lookup_input[0],
+          sparse_weights=lookup_input[1],
+          combiner=coalesced_utils.get_signature_attributes(
+              columns[0]).combiner)
+      values = array_ops.split(embeddings, lookup_input[2])
+      results = []
+      for value, origin_shape in zip(values, lookup_input[3]):
+        origin_rank = array_ops.size(origin_shape)
+        value = array_ops.reshape(
+            value,
+            array_ops.concat([
+                array_ops.slice(origin_shape, [0], [origin_rank - 1]),
+                array_ops.slice(array_ops.shape(value), [1], [-1])
+            ], 0))
+        results.append(value)
+      embedding_outputs.extend(zip(cids, results))
+    return list(zip(*sorted(embedding_outputs)))[1]
+
+
 def _check_shape(shape, key):
   """Returns shape if it's valid, raises error otherwise."""
   assert shape is not None
@@ -55,6 +55,7 @@ from tensorflow.python.training import rmsprop
 from tensorflow.python.training import saver as saver_module
 from tensorflow.python.training import adagrad
 from tensorflow.python.training import ftrl
+from tensorflow.python.training import gradient_descent
 from tensorflow.python.training import checkpoint_utils
 
 
@@ -2260,6 +2261,177 @@ class CoalescedEmbeddingColumnTest(test.TestCase):
             'bias/Adagrad']
         self.assertItemsEqual(sorted(expected_vars), sorted(vars))
 
+  @test_util.run_deprecated_v1
+  def test_coalesce_embedding_variables(self):
+    input_a = sparse_tensor.SparseTensorValue(
+        indices=((0, 0), (1, 0), (1, 1), (3, 0)),
+        values=np.array((7, 3, 5, 7), dtype=np.int64),
+        dense_shape=(4, 2))
+    input_b = sparse_tensor.SparseTensorValue(
+        indices=((0, 0), (2, 0), (3, 0)),
+        values=np.array((7, 9, 11), dtype=np.int64),
+        dense_shape=(4, 1))
+    with fc.coalesced_embedding_scope() as scope:
+      aaa = fc.categorical_column_with_embedding('aaa', dtype=dtypes.int64)
+      e1 = fc.embedding_column(
+          aaa, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+      bbb = fc.categorical_column_with_embedding('bbb', dtype=dtypes.int64)
+      e2 = fc.embedding_column(
+          bbb, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+    dense_features = df.DenseFeatures(
+        feature_columns=(e1, e2))({
+        'aaa': input_a,
+        'bbb': input_b})
+    cc = scope.get_coalesced_column_by_column(e1)
+    self.assertIsInstance(cc, fc.CoalescedEmbeddingVariableColumn)
+    global_vars = ops.get_collection(ops.GraphKeys.GLOBAL_VARIABLES)
+    self.assertItemsEqual(
+        ['dense_features/CoalescedEmbedding/embedding_weights:0'],
+        [v.name for v in global_vars])
+
+    loss = math_ops.reduce_sum(dense_features)
+    train = gradient_descent.GradientDescentOptimizer(0.5).minimize(loss)
+    keys_a, _ = cc.feature_view(e1)
+    keys_b, values_b = cc.feature_view(e2)
+    with self.cached_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(variables_lib.global_variables_initializer())
+      self.assertAllEqual(
+          ((1., 1., 1., 1.),
+           (2., 2., 0., 0.),
+           (0., 0., 1., 1.),
+           (1., 1., 1., 1.)),
+          sess.run(dense_features))
+      sess.run(train)
+      # Key 7 of both features must be two distinct entries.
+      self.assertItemsEqual([3, 5, 7], sess.run(keys_a))
+      keys, values = sess.run([keys_b, values_b])
+      self.assertItemsEqual([7, 9, 11], keys)
+      self.assertAllClose(np.full((3, 2), 0.5), values)
+
+  @test_util.run_deprecated_v1
+  def test_coalesce_embedding_variables_rejects_wide_ids(self):
+    input_a = sparse_tensor.SparseTensorValue(
+        indices=((0, 0), (1, 0)),
+        values=np.array((-1, 3), dtype=np.int64),
+        dense_shape=(2, 1))
+    input_b = array_ops.sparse_placeholder(dtypes.int64)
+    with fc.coalesced_embedding_scope():
+      aaa = fc.categorical_column_with_embedding('aaa', dtype=dtypes.int64)
+      e1 = fc.embedding_column(
+          aaa, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+      bbb = fc.categorical_column_with_embedding('bbb', dtype=dtypes.int64)
+      e2 = fc.embedding_column(
+          bbb, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+    dense_features = df.DenseFeatures(feature_columns=(e1, e2))({
+        'aaa': input_a,
+        'bbb': input_b})
+    with self.cached_session() as sess:
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(variables_lib.global_variables_initializer())
+      # Negative ids are pruned like those of an uncoalesced column.
+      self.assertAllEqual(
+          ((0., 0., 1., 1.),
+           (1., 1., 0., 0.)),
+          sess.run(dense_features, feed_dict={
+              input_b: sparse_tensor.SparseTensorValue(
+                  indices=((0, 0),),
+                  values=np.array((3,), dtype=np.int64),
+                  dense_shape=(2, 1))}))
+      # An id that does not fit in the key would collide with id 3.
+      with self.assertRaisesRegexp(errors.InvalidArgumentError,
+                                   'must be less than 2\\*\\*52'):
+        sess.run(dense_features, feed_dict={
+            input_b: sparse_tensor.SparseTensorValue(
+                indices=((0, 0), (1, 0)),
+                values=np.array((3, 3 + (1 << 52)), dtype=np.int64),
+                dense_shape=(2, 1))})
+
+  @test_util.run_deprecated_v1
+  def test_coalesce_embedding_variables_feature_checkpoint(self):
+    input_a = sparse_tensor.SparseTensorValue(
+        indices=((0, 0), (1, 0), (1, 1), (3, 0)),
+        values=np.array((7, 3, 5, 7), dtype=np.int64),
+        dense_shape=(4, 2))
+    input_b = sparse_tensor.SparseTensorValue(
+        indices=((0, 0), (2, 0), (3, 0)),
+        values=np.array((7, 9, 11), dtype=np.int64),
+        dense_shape=(4, 1))
+    expected = ((0., 0., .5, .5),
+                (1., 1., 0., 0.),
+                (0., 0., .5, .5),
+                (0., 0., .5, .5))
+    checkpoint_prefix = os.path.join(self.get_temp_dir(), 'ckpt')
+
+    def make_columns():
+      aaa = fc.categorical_column_with_embedding('aaa', dtype=dtypes.int64)
+      e1 = fc.embedding_column(
+          aaa, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+      bbb = fc.categorical_column_with_embedding('bbb', dtype=dtypes.int64)
+      e2 = fc.embedding_column(
+          bbb, dimension=2, initializer=init_ops.Ones(), combiner='sum')
+      return e1, e2
+
+    def build(coalesced):
+      scope = None
+      if coalesced:
+        with fc.coalesced_embedding_scope() as scope:
+          e1, e2 = make_columns()
+      else:
+        e1, e2 = make_columns()
+      dense_features = df.DenseFeatures(feature_columns=(e1, e2))({
+          'aaa': input_a,
+          'bbb': input_b})
+      if scope is None:
+        return dense_features, None
+      return dense_features, scope.get_coalesced_column_by_column(e1)
+
+    with ops.Graph().as_default() as g, self.session(graph=g) as sess:
+      dense_features, cc = build(coalesced=True)
+      loss = math_ops.reduce_sum(dense_features)
+      train = gradient_descent.GradientDescentOptimizer(0.5).minimize(loss)
+      saver = saver_module.Saver(cc.feature_saveables())
+      sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+      sess.run(variables_lib.global_variables_initializer())
+      sess.run(train)
+      self.assertAllClose(expected, sess.run(dense_features))
+      save_path = saver.save(sess, checkpoint_prefix)
+    names = [name for name, _ in checkpoint_utils.list_variables(save_path)]
+    for feature in ('aaa', 'bbb'):
+      for suffix in ('keys', 'values', 'versions', 'freqs'):
+        self.assertIn('dense_features/{}_embedding/embedding_weights-{}'.format(
+            feature, suffix), names)
+
+    # A model without coalescing restores the features directly.
+    with ops.Graph().as_default() as g, self.session(graph=g) as sess:
+      dense_features, _ = build(coalesced=False)
+      saver_module.Saver().restore(sess, save_path)
+      self.assertAllClose(expected, sess.run(dense_features))
+
+    # A coalesced model restores them into its shared storage.
+    with ops.Graph().as_default() as g, self.session(graph=g) as sess:
+      dense_features, cc = build(coalesced=True)
+      saver_module.Saver(cc.feature_saveables()).restore(sess, save_path)
+      self.assertAllClose(expected, sess.run(dense_features))
+
+  @test_util.run_deprecated_v1
+  def test_coalesce_embedding_variables_feature_checkpoint_string(self):
+    with fc.coalesced_embedding_scope() as scope:
+      aaa = fc.categorical_column_with_embedding('aaa', dtype=dtypes.int64)
+      e1 = fc.embedding_column(aaa, dimension=2, initializer=init_ops.Ones())
+      bbb = fc.categorical_column_with_embedding('bbb', dtype=dtypes.string)
+      e2 = fc.embedding_column(bbb, dimension=2, initializer=init_ops.Ones())
+    df.DenseFeatures(feature_columns=(e1, e2))({
+        'aaa': sparse_tensor.SparseTensor(
+            indices=((0, 0),), values=np.array((7,), dtype=np.int64),
+            dense_shape=(1, 1)),
+        'bbb': sparse_tensor.SparseTensor(
+            indices=((0, 0),), values=('x',), dense_shape=(1, 1))})
+    cc = scope.get_coalesced_column_by_column(e1)
+    # Only a 52-bit hash of the string ids is kept.
+    with self.assertRaisesRegexp(ValueError, 'bbb_embedding has string ids'):
+      cc.feature_saveables()
+
 
 class BucketizedColumnTest(test.TestCase):
 
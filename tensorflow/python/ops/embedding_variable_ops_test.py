@@ -23,6 +23,7 @@ from tensorflow.python.framework import constant_op
 from tensorflow.python.ops import string_ops
 from tensorflow.python.ops.check_ops import assert_equal
 from tensorflow.python.platform import googletest
+from tensorflow.python.platform import test
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import embedding_ops
 from tensorflow.python.ops import kv_variable_ops
@@ -435,6 +436,38 @@ class EmbeddingVariableTest(test_util.TensorFlowTestCase):
       print(sess.run([emb, train_op,loss]))
       print(sess.run([emb, train_op,loss]))
 
+  def testEmbeddingVariableHeavyHitters(self):
+    print("testEmbeddingVariableHeavyHitters")
+    with test.mock.patch.dict(os.environ,
+                              {"TF_EV_HEAVY_HITTER_CAPACITY": "3"}):
+      with ops.device("/cpu:0"):
+        var = variable_scope.get_embedding_variable("var_heavy_hitters",
+                embedding_dim = 3,
+                initializer=init_ops.ones_initializer(dtypes.float32))
+      sp_ids = sparse_tensor.SparseTensor(
+          indices=[[0,0],[0,1],[1,0],[2,0],[3,0],[4,0]],
+          values=math_ops.cast([1,1,1,2,2,3], dtypes.int64),
+          dense_shape=[5, 2])
+      emb = embedding_ops.embedding_lookup_sparse(var, sp_ids, None)
+      loss = math_ops.reduce_sum(emb)
+      opt = adagrad.AdagradOptimizer(0.1)
+      g_v = opt.compute_gradients(loss)
+      train_op = opt.apply_gradients(g_v)
+      heavy_hitters = var.heavy_hitters(2, coverages=[0.5, 0.8])
+      init = variables.global_variables_initializer()
+      with self.test_session() as sess:
+        sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_VAR_OPS))
+        sess.run(ops.get_collection(ops.GraphKeys.EV_INIT_SLOT_OPS))
+        sess.run([init])
+        sess.run(train_op)
+        sess.run(train_op)
+        ids, freqs, working_set_sizes, total = sess.run(heavy_hitters)
+      # Every lookup is counted once, not once per unique id of a batch.
+      self.assertAllEqual(ids, [1, 2])
+      self.assertAllEqual(freqs, [6, 4])
+      self.assertEqual(total, 12)
+      self.assertAllEqual(working_set_sizes, [1, 2])
+
   def testEmbeddingVariableForLookupInt32(self):
     print("testEmbeddingVariableForLookupInt32")
     checkpoint_directory = self.get_temp_dir()
@@ -44,6 +44,14 @@ from tensorflow.python.util import deprecation
 __all__ = ["EmbeddingVariable"]
 
 
+def _heavy_hitters_enabled():
+  """Whether EmbeddingVariables maintain a heavy-hitter sketch.
+
+  The sketch counts the ids of every lookup, so lookups pass the counts of
+  the unique ids when it is enabled.
+  """
+  return int(os.environ.get("TF_EV_HEAVY_HITTER_CAPACITY", "0")) > 0
+
 
 class EmbeddingVariable(resource_variable_ops.ResourceVariable):
   """Embedding Variable based on resource variable.
@@ -286,6 +294,7 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
 
     self._record_freq = (os.environ.get("TF_RECORD_FREQ", "0") == "1")
     self._record_version = (os.environ.get("TF_RECORD_VERSION", "0") == "1")
+    self._count_heavy_hitters = _heavy_hitters_enabled()
     self._l2_weight_threshold = evconfig.l2_weight_threshold
     self._storage_type = evconfig.storage_type
     self._storage_path = evconfig.storage_path
@@ -445,6 +454,19 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
         elif ops.GraphKeys.GLOBAL_STEP in collections:
           ops.add_to_collections(ops.GraphKeys.GLOBAL_STEP, self)
 
+  def heavy_hitters(self, k, coverages=(0.5, 0.8, 0.9, 0.95, 0.99)):
+    """Returns the most frequently looked up ids of this variable.
+
+    Requires the environment variable TF_EV_HEAVY_HITTER_CAPACITY to be set,
+    see `KvResourceHeavyHitters`.
+
+    Returns:
+      A tuple `(ids, freqs, working_set_sizes, total)`.
+    """
+    return gen_kv_variable_ops.kv_resource_heavy_hitters(
+        [self._handle], k=k, coverages=list(coverages),
+        Tkeys=self._invalid_key_type, dtype=self.dtype)
+
   def export(self):
     return gen_kv_variable_ops.kv_resource_export(self._handle, Tkeys=self._invalid_key_type)
 
@@ -493,7 +515,8 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
         self.collect_restore_denpendencies()
 
   def need_counts(self):
-    return (self._record_freq or (self._filter_freq > 0) or self._is_multi_tier)
+    return (self._record_freq or (self._filter_freq > 0) or self._is_multi_tier
+            or self._count_heavy_hitters)
   @property
   def gather_op(self):
     return self._gather_op
@@ -612,6 +635,7 @@ class EmbeddingVariable(resource_variable_ops.ResourceVariable):
     self._default_value_no_permission= init_op.get_attr("default_value_no_permission")
     self._record_freq = init_op.get_attr("record_freq")
     self._record_version = init_op.get_attr("record_version")
+    self._count_heavy_hitters = _heavy_hitters_enabled()
     self._storage_cache_strategy = config_pb2.CacheStrategy.LFU
     if cache_op:
       self._storage_cache_strategy = cache_op.get_attr("cache_strategy")
@@ -27,6 +27,14 @@ from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import gen_nn_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn_ops
+from tensorflow.python.ops import gen_din_attention_ops
+from tensorflow.python.ops import gen_multi_head_attention_ops
+from tensorflow.python.ops import gen_dot_interaction_ops
+from tensorflow.python.ops import gen_cross_network_ops
+from tensorflow.python.ops import gen_gru_sequence_ops
+from tensorflow.python.ops import gen_mask_block_ops
+from tensorflow.python.ops import gen_concat_matmul_ops
+from tensorflow.python.ops import gen_dice_ops
 from tensorflow.python.ops import gen_fused_l2_normalize_ops
 
 
@@ -1181,6 +1189,123 @@ def _FusedL2NormalizeGrad(op, grad):
   return gen_fused_l2_normalize_ops.fused_l2_normalize_grad(
     grad, x, axis=axis, epsilon=epsilon)
 
+@ops.RegisterGradient("DinAttention")
+def _DinAttentionGrad(op, output_grad, alphas_grad):
+  """Return the gradients for DinAttention"""
+  if alphas_grad is None:
+    alphas_grad = array_ops.zeros_like(op.outputs[1])
+  grads = gen_din_attention_ops.din_attention_grad(
+      output_grad, alphas_grad, *op.inputs,
+      padding_value=op.get_attr("padding_value"))
+  # No gradient for the mask, the unfused layer only uses it as the condition
+  # of a where.
+  return [grads[0], grads[1], None] + list(grads[2:])
+
+@ops.RegisterGradient("MultiHeadAttention")
+def _MultiHeadAttentionGrad(op, output_grad, _):
+  """Return the gradients for MultiHeadAttention"""
+  if output_grad is None:
+    output_grad = array_ops.zeros_like(op.outputs[0])
+  query_grad, key_grad, value_grad = (
+      gen_multi_head_attention_ops.multi_head_attention_grad(
+          output_grad, *(list(op.inputs) + list(op.outputs)),
+          head_count=op.get_attr("head_count"), scale=op.get_attr("scale")))
+  # No gradient for the mask.
+  return [query_grad, key_grad, value_grad, None]
+
+@ops.RegisterGradient("DotInteraction")
+def _DotInteractionGrad(op, grad):
+  """Return the gradients for DotInteraction"""
+  features_grad, dense_grad = gen_dot_interaction_ops.dot_interaction_grad(
+      grad, op.inputs[0], op.inputs[1:])
+  return [features_grad] + list(dense_grad)
+
+@ops.RegisterGradient("CrossNetwork")
+def _CrossNetworkGrad(op, grad):
+  """Return the gradients for CrossNetwork"""
+  num_layers = op.get_attr("num_layers")
+  x0_grad, kernels_grad, biases_grad = gen_cross_network_ops.cross_network_grad(
+      grad, op.inputs[0], op.inputs[1:1 + num_layers],
+      op.inputs[1 + num_layers:])
+  return [x0_grad] + list(kernels_grad) + list(biases_grad)
+
+@ops.RegisterGradient("CrossNetworkV2")
+def _CrossNetworkV2Grad(op, grad):
+  """Return the gradients for CrossNetworkV2"""
+  num_layers = op.get_attr("num_layers")
+  num_projections = op.get_attr("num_projections")
+  inputs = list(op.inputs[1:])
+  grads = gen_cross_network_ops.cross_network_v2_grad(
+      grad, op.inputs[0], inputs[:num_layers],
+      inputs[num_layers:2 * num_layers],
+      inputs[2 * num_layers:2 * num_layers + num_projections],
+      inputs[2 * num_layers + num_projections:],
+      input_residual=op.get_attr("input_residual"))
+  return [grads[0]] + [g for grad_list in grads[1:] for g in grad_list]
+
+def _GRUSequenceOutputGrads(op, outputs_grad, final_state_grad):
+  """The saved outputs and the output gradients of (AU)GRUSequenceGrad."""
+  if outputs_grad is None:
+    outputs_grad = array_ops.zeros_like(op.outputs[0])
+  if final_state_grad is None:
+    final_state_grad = array_ops.zeros_like(op.outputs[1])
+  return [op.outputs[0], op.outputs[2], op.outputs[3], outputs_grad,
+          final_state_grad]
+
+@ops.RegisterGradient("GRUSequence")
+def _GRUSequenceGrad(op, outputs_grad, final_state_grad, *_):
+  """Return the gradients for GRUSequence"""
+  # The biases are not needed.
+  grads = gen_gru_sequence_ops.gru_sequence_grad(
+      *(op.inputs[:4] + [op.inputs[5]] +
+        _GRUSequenceOutputGrads(op, outputs_grad, final_state_grad)))
+  # No gradient for the sequence lengths.
+  return [grads[0], None] + list(grads[1:])
+
+@ops.RegisterGradient("AUGRUSequence")
+def _AUGRUSequenceGrad(op, outputs_grad, final_state_grad, *_):
+  """Return the gradients for AUGRUSequence"""
+  grads = gen_gru_sequence_ops.augru_sequence_grad(
+      *(op.inputs[:5] + [op.inputs[6]] +
+        _GRUSequenceOutputGrads(op, outputs_grad, final_state_grad)))
+  # No gradient for the sequence lengths.
+  return [grads[0], grads[1], None] + list(grads[2:])
+
+ops.NotDifferentiable("HnswIndex")
+ops.NotDifferentiable("IvfPqIndex")
+ops.NotDifferentiable("AnnIndexUpdate")
+ops.NotDifferentiable("AnnIndexRemove")
+ops.NotDifferentiable("AnnIndexSearch")
+ops.NotDifferentiable("AnnIndexSize")
+
+@ops.RegisterGradient("MaskBlock")
+def _MaskBlockGrad(op, grad, *_):
+  """Return the gradients for MaskBlock"""
+  # The biases and beta are not needed.
+  inputs = op.inputs
+  return gen_mask_block_ops.mask_block_grad(
+      inputs[0], inputs[1], inputs[2], inputs[4], inputs[6], inputs[7],
+      *(list(op.outputs) + [grad]), mask_relu=op.get_attr("mask_relu"))
+
+@ops.RegisterGradient("ConcatMatMul")
+def _ConcatMatMulGrad(op, grad):
+  """Return the gradients for ConcatMatMul"""
+  n = op.get_attr("N")
+  inputs_grad, kernel_grad, bias_grad = (
+      gen_concat_matmul_ops.concat_matmul_grad(
+          op.inputs[:n], op.inputs[n], op.outputs[0], grad,
+          num_bias=op.get_attr("num_bias"),
+          activation=op.get_attr("activation")))
+  return list(inputs_grad) + [kernel_grad] + list(bias_grad)
+
+@ops.RegisterGradient("DiceTraining")
+def _DiceTrainingGrad(op, grad, *_):
+  """Return the gradients for DiceTraining"""
+  # As for FusedBatchNorm, the batch statistics are not differentiated.
+  return gen_dice_ops.dice_training_grad(
+      grad, op.inputs[0], op.inputs[1], op.outputs[1], op.outputs[2],
+      epsilon=op.get_attr("epsilon"))
+
 @ops.RegisterGradient("FusedLayerNorm")
 def _FusedLayerNormalizeGrad(op, grad, *args):
   """Return the gradients for FusedLayerNorm"""
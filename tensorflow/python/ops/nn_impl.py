@@ -27,6 +27,7 @@ from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import candidate_sampling_ops
+from tensorflow.python.ops import gen_din_attention_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import custom_gradient
 from tensorflow.python.ops import embedding_ops
@@ -36,6 +37,14 @@ from tensorflow.python.ops import linalg_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn_ops
 from tensorflow.python.ops import gen_fused_l2_normalize_ops
+from tensorflow.python.ops import gen_multi_head_attention_ops
+from tensorflow.python.ops import gen_dot_interaction_ops
+from tensorflow.python.ops import gen_cross_network_ops
+from tensorflow.python.ops import gen_gru_sequence_ops
+from tensorflow.python.ops import gen_ann_ops
+from tensorflow.python.ops import gen_mask_block_ops
+from tensorflow.python.ops import gen_concat_matmul_ops
+from tensorflow.python.ops import gen_dice_ops
 from tensorflow.python.ops import gen_sparse_ops
 from tensorflow.python.ops import init_ops
 from tensorflow.python.ops import variables
@@ -744,6 +753,441 @@ def fused_layer_normalize(
     return gen_nn_ops.fused_layer_norm(
               x, gamma=gamma, beta=beta, epsilon=epsilon, name=name)[0]
 
+@tf_export("nn.din_attention")
+def din_attention(query, facts, mask, w1, b1, w2, b2, w3, b3,
+                  padding_value=-2**32 + 1, name=None):
+  """DIN target attention (local activation unit) of `query` over `facts`.
+
+  Computes in one op, as `_attention` of modelzoo/din:
+
+      queries = tile(query, [1, T]) reshaped to [B, T, D]
+      din_all = concat([queries, facts, queries - facts, queries * facts], -1)
+      scores = dense(sigmoid(dense(sigmoid(dense(din_all, w1, b1)), w2, b2)),
+                     w3, b3)
+      alphas = softmax(where(mask, scores, padding_value))
+      output = matmul(alphas, facts)
+
+  Facts that are masked out skip the dense layers. The gradient of `mask`
+  is `None`, as for the condition of `where` in the unfused layer.
+
+  Args:
+    query: A `Tensor` of shape `[B, D]`.
+    facts: A `Tensor` of shape `[B, T, D]`.
+    mask: A bool `Tensor` of shape `[B, T]`, e.g. from `tf.sequence_mask`.
+    w1: Kernel of the first layer, `[4 * D, H1]`.
+    b1: Bias of the first layer, `[H1]`.
+    w2: Kernel of the second layer, `[H1, H2]`.
+    b2: Bias of the second layer, `[H2]`.
+    w3: Kernel of the score layer, `[H2, 1]`.
+    b3: Bias of the score layer, `[1]`.
+    padding_value: Score of the masked facts.
+    name: A name for this operation (optional).
+
+  Returns:
+    A tuple `(output, alphas)` of shapes `[B, 1, D]` and `[B, 1, T]`.
+  """
+  with ops.name_scope(name, "din_attention", [query, facts, mask]) as name:
+    return gen_din_attention_ops.din_attention(
+        query, facts, mask, w1, b1, w2, b2, w3, b3,
+        padding_value=padding_value, name=name)
+
+@tf_export("nn.multi_head_attention")
+def multi_head_attention(query, key, value, head_count, key_mask=None,
+                         sequence_length=None, scale=1.0, name=None):
+  """Multi-head attention of `query` over `key` and `value`.
+
+  Computes in one op, as `_multihead_attention` of modelzoo/bst after the
+  dense projections:
+
+      heads(x) = concat(split(x, head_count, axis=-1), axis=0)
+      scores = scale * matmul(heads(query), heads(key), transpose_b=True)
+      weights = softmax(scores - 1e9 * cast(logical_not(key_mask)))
+      output = concat(split(matmul(weights, heads(value)), head_count,
+                            axis=0), axis=-1)
+
+  Masked keys are skipped and the softmax is computed block by block, so
+  the `[B, head_count, Tq, Tk]` weights are never materialized.
+
+  Args:
+    query: A `Tensor` of shape `[B, Tq, D]`.
+    key: A `Tensor` of shape `[B, Tk, D]`.
+    value: A `Tensor` of shape `[B, Tk, Dv]`.
+    head_count: Number of heads, which must divide `D` and `Dv`.
+    key_mask: An optional bool `Tensor` of shape `[B, Tk]`.
+    sequence_length: An optional `Tensor` of shape `[B]`, the number of
+      valid keys of each row. Only used if `key_mask` is None.
+    scale: Factor of the scores, e.g. `1 / sqrt(D / head_count)`.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[B, Tq, Dv]`.
+  """
+  with ops.name_scope(name, "multi_head_attention",
+                      [query, key, value, key_mask, sequence_length]) as name:
+    key = ops.convert_to_tensor(key, name="key")
+    if key_mask is None:
+      key_len = array_ops.shape(key)[1]
+      if sequence_length is not None:
+        key_mask = array_ops.sequence_mask(sequence_length, key_len)
+      else:
+        key_mask = array_ops.ones([array_ops.shape(key)[0], key_len],
+                                  dtype=dtypes.bool)
+    return gen_multi_head_attention_ops.multi_head_attention(
+        query, key, value, key_mask, head_count=head_count, scale=scale,
+        name=name)[0]
+
+@tf_export("nn.dot_interaction")
+def dot_interaction(features, dense=None, name=None):
+  """Pairwise dot products of the features, as the DLRM dot interaction.
+
+  Computes in one op, as `_dot_op` of modelzoo/dlrm followed by the concat
+  with the dense features:
+
+      products = matmul(features, features, transpose_b=True)
+      pairs = the strictly lower triangle of products, row by row
+      output = concat([dense, pairs], axis=1)
+
+  Only the `F * (F - 1) / 2` pairs are computed, so the `[B, F, F]` products
+  and the mask are never materialized.
+
+  Args:
+    features: A `Tensor` of shape `[B, F, D]`.
+    dense: An optional `Tensor` of shape `[B, Dd]` written before the pairs.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[B, Dd + F * (F - 1) / 2]`.
+  """
+  with ops.name_scope(name, "dot_interaction", [features, dense]) as name:
+    return gen_dot_interaction_ops.dot_interaction(
+        features, [dense] if dense is not None else [], name=name)
+
+@tf_export("nn.cross_network")
+def cross_network(x0, kernels, biases, name=None):
+  """The cross network of DCN, as `_cross_net` of modelzoo/dcn.
+
+  Computes all the layers in one op, from `x[0] = x0`:
+
+      xw = reduce_sum(x[l] * kernels[l], axis=1, keepdims=True)
+      x[l + 1] = x0 * xw + biases[l] + x[l]
+
+  Args:
+    x0: A `Tensor` of shape `[B, D]`.
+    kernels: A list of `Tensor`s of shape `[D]`, one per layer.
+    biases: A list of `Tensor`s of shape `[D]`, one per layer.
+    name: A name for this operation (optional).
+
+  Returns:
+    The output of the last layer, a `Tensor` of shape `[B, D]`.
+  """
+  with ops.name_scope(name, "cross_network",
+                      [x0] + list(kernels) + list(biases)) as name:
+    return gen_cross_network_ops.cross_network(x0, kernels, biases, name=name)
+
+@tf_export("nn.cross_network_v2")
+def cross_network_v2(x0, kernels, biases, projection_kernels=None,
+                     projection_biases=None, input_residual=False, name=None):
+  """The cross network of DCN-V2, as `_cross_net` of modelzoo/dcnv2.
+
+  Computes all the layers in one op, from `x[0] = x0`:
+
+      h = matmul(x[l], kernels[l]) + biases[l]
+      x[l + 1] = x0 * h + x[l]  # or x0 * h + x0 if input_residual
+
+  For the low rank cross network, `x[l]` is first projected by
+  `matmul(x[l], projection_kernels[l]) + projection_biases[l]`.
+
+  Args:
+    x0: A `Tensor` of shape `[B, D]`.
+    kernels: A list of `Tensor`s of shape `[D, D]`, or `[R, D]` with
+      projections, one per layer.
+    biases: A list of `Tensor`s of shape `[D]`, one per layer.
+    projection_kernels: An optional list of `Tensor`s of shape `[D, R]`.
+    projection_biases: An optional list of `Tensor`s of shape `[R]`.
+    input_residual: Whether the layers add x0 instead of their input.
+    name: A name for this operation (optional).
+
+  Returns:
+    The output of the last layer, a `Tensor` of shape `[B, D]`.
+  """
+  projection_kernels = list(projection_kernels or [])
+  projection_biases = list(projection_biases or [])
+  with ops.name_scope(name, "cross_network_v2",
+                      [x0] + list(kernels) + list(biases) +
+                      projection_kernels + projection_biases) as name:
+    return gen_cross_network_ops.cross_network_v2(
+        x0, kernels, biases, projection_kernels, projection_biases,
+        input_residual=input_residual, name=name)
+
+@tf_export("nn.gru_sequence")
+def gru_sequence(inputs, gate_kernel, gate_bias, candidate_kernel,
+                 candidate_bias, sequence_length=None, initial_state=None,
+                 att_scores=None, name=None):
+  """A GRU over padded sequences, as `dynamic_rnn` of a `GRUCell`.
+
+  Runs all the steps in one op, from `h = initial_state`:
+
+      r, u = split(sigmoid(matmul(concat([x[:, t], h], 1), gate_kernel)
+                           + gate_bias), 2, axis=1)
+      c = tanh(matmul(concat([x[:, t], r * h], 1), candidate_kernel)
+               + candidate_bias)
+      h = u * h + (1 - u) * c
+
+  With `att_scores`, the update gate is first scaled by `1 - att_scores[:, t]`,
+  as the AUGRU of DIEN (`VecAttGRUCell` of modelzoo/dien). The kernels and
+  biases are the `gates` and `candidate` variables of the `GRUCell`.
+
+  Args:
+    inputs: A `Tensor` of shape `[B, T, I]`.
+    gate_kernel: A `Tensor` of shape `[I + H, 2 * H]`.
+    gate_bias: A `Tensor` of shape `[2 * H]`.
+    candidate_kernel: A `Tensor` of shape `[I + H, H]`.
+    candidate_bias: A `Tensor` of shape `[H]`.
+    sequence_length: An optional int32 `Tensor` of shape `[B]`, `T` by
+      default. The outputs past the lengths are zeros.
+    initial_state: An optional `Tensor` of shape `[B, H]`, zeros by default.
+    att_scores: An optional `Tensor` of shape `[B, T]` or `[B, T, 1]`.
+    name: A name for this operation (optional).
+
+  Returns:
+    A pair `(outputs, final_state)` of `Tensor`s of shapes `[B, T, H]` and
+    `[B, H]`, as returned by `dynamic_rnn`.
+  """
+  with ops.name_scope(name, "gru_sequence",
+                      [inputs, gate_kernel, gate_bias, candidate_kernel,
+                       candidate_bias, sequence_length, initial_state,
+                       att_scores]) as name:
+    inputs = ops.convert_to_tensor(inputs, name="inputs")
+    shape = array_ops.shape(inputs)
+    if sequence_length is None:
+      sequence_length = array_ops.fill(shape[:1], shape[1])
+    sequence_length = math_ops.cast(sequence_length, dtypes.int32)
+    if initial_state is None:
+      initial_state = array_ops.zeros(
+          array_ops.stack([shape[0], array_ops.shape(candidate_bias)[0]]),
+          dtype=inputs.dtype)
+    if att_scores is None:
+      outputs = gen_gru_sequence_ops.gru_sequence(
+          inputs, sequence_length, initial_state, gate_kernel, gate_bias,
+          candidate_kernel, candidate_bias, name=name)
+    else:
+      att_scores = array_ops.reshape(att_scores, shape[:2])
+      outputs = gen_gru_sequence_ops.augru_sequence(
+          inputs, att_scores, sequence_length, initial_state, gate_kernel,
+          gate_bias, candidate_kernel, candidate_bias, name=name)
+    return outputs[0], outputs[1]
+
+@tf_export("nn.hnsw_index")
+def hnsw_index(dim, metric="inner_product", max_neighbors=16,
+               ef_construction=200, seed=0, shared_name=None, name=None):
+  """An HNSW approximate nearest neighbor index of `dim`-d vectors.
+
+  The index is a hierarchical navigable small world graph, created on the
+  first run and shared by the ops of the same `shared_name`, or name, e.g. by
+  the serving sessions of a model. Fill it with `ann_index_update` and query
+  it with `ann_index_search`.
+
+  Args:
+    dim: The dimension of the vectors.
+    metric: `"inner_product"` or `"l2"`.
+    max_neighbors: The number of links of the nodes, twice as many on the
+      bottom level.
+    ef_construction: The number of candidates of the insertions.
+    seed: The seed of the levels of the nodes.
+    shared_name: An optional name of the index.
+    name: A name for this operation (optional).
+
+  Returns:
+    A resource `Tensor`, the handle of the index.
+  """
+  return gen_ann_ops.hnsw_index(
+      dim=dim, metric=metric, max_neighbors=max_neighbors,
+      ef_construction=ef_construction, seed=seed,
+      shared_name=shared_name or "", name=name)
+
+@tf_export("nn.ivf_pq_index")
+def ivf_pq_index(dim, metric="inner_product", num_lists=1024,
+                 num_subquantizers=8, seed=0, shared_name=None, name=None):
+  """An IVF-PQ approximate nearest neighbor index of `dim`-d vectors.
+
+  The vectors are assigned to `num_lists` k-means centroids, and their
+  residuals encoded by `num_subquantizers` bytes. The quantizers are trained
+  by the first `ann_index_update`. See `hnsw_index` for the sharing.
+
+  Args:
+    dim: The dimension of the vectors, a multiple of `num_subquantizers`.
+    metric: `"inner_product"` or `"l2"`.
+    num_lists: The number of inverted lists.
+    num_subquantizers: The number of codes of a vector.
+    seed: The seed of the k-means.
+    shared_name: An optional name of the index.
+    name: A name for this operation (optional).
+
+  Returns:
+    A resource `Tensor`, the handle of the index.
+  """
+  return gen_ann_ops.ivf_pq_index(
+      dim=dim, metric=metric, num_lists=num_lists,
+      num_subquantizers=num_subquantizers, seed=seed,
+      shared_name=shared_name or "", name=name)
+
+@tf_export("nn.ann_index_update")
+def ann_index_update(index, ids, vectors, name=None):
+  """Inserts or replaces the vectors of `ids` in an ANN index.
+
+  Vectors already in the index are skipped, so that running the update again
+  on the restored item embeddings of a delta model load, e.g. from the
+  `main_op` of a SavedModel, only re-indexes the changed items.
+
+  Args:
+    index: The handle of an `hnsw_index` or `ivf_pq_index`.
+    ids: An int64 `Tensor` of shape `[N]`.
+    vectors: A float32 `Tensor` of shape `[N, dim]`.
+    name: A name for this operation (optional).
+
+  Returns:
+    An int64 scalar `Tensor`, the number of inserted or replaced vectors.
+  """
+  with ops.name_scope(name, "ann_index_update", [index, ids, vectors]) as name:
+    ids = math_ops.cast(ids, dtypes.int64)
+    return gen_ann_ops.ann_index_update(index, ids, vectors, name=name)
+
+@tf_export("nn.ann_index_remove")
+def ann_index_remove(index, ids, name=None):
+  """Removes `ids` from the search results of an ANN index.
+
+  E.g. for the items retired from the catalog of a delta model. A later
+  `ann_index_update` of a removed id inserts it again.
+
+  Args:
+    index: The handle of an `hnsw_index` or `ivf_pq_index`.
+    ids: An int64 `Tensor` of shape `[N]`.
+    name: A name for this operation (optional).
+
+  Returns:
+    An int64 scalar `Tensor`, the number of `ids` that were in the index.
+  """
+  with ops.name_scope(name, "ann_index_remove", [index, ids]) as name:
+    ids = math_ops.cast(ids, dtypes.int64)
+    return gen_ann_ops.ann_index_remove(index, ids, name=name)
+
+@tf_export("nn.ann_index_search")
+def ann_index_search(index, queries, k, probe=64, name=None):
+  """The approximate `k` nearest neighbors of the queries in an ANN index.
+
+  Args:
+    index: The handle of an `hnsw_index` or `ivf_pq_index`.
+    queries: A float32 `Tensor` of shape `[B, dim]`.
+    k: The number of neighbors.
+    probe: The number of candidates of an HNSW search, or of lists scanned
+      by IVF-PQ. Larger values trade speed for recall.
+    name: A name for this operation (optional).
+
+  Returns:
+    A pair `(scores, ids)` of `Tensor`s of shape `[B, k]`, best first: the
+    inner products or negated squared L2 distances, and the int64 ids. The
+    missing neighbors of a smaller index have score `-inf` and id -1.
+  """
+  with ops.name_scope(name, "ann_index_search", [index, queries]) as name:
+    return gen_ann_ops.ann_index_search(index, queries, k, probe, name=name)
+
+@tf_export("nn.ann_index_size")
+def ann_index_size(index, name=None):
+  """The number of vectors of an ANN index, an int64 scalar `Tensor`."""
+  return gen_ann_ops.ann_index_size(index, name=name)
+
+@tf_export("nn.mask_block")
+def mask_block(embedding, hidden, aggregation_kernel, aggregation_bias,
+               projection_kernel, projection_bias, output_kernel, gamma, beta,
+               mask_relu=True, epsilon=1e-3, name=None):
+  """The MaskBlock of MaskNet, with an instance-guided mask, in one op.
+
+  Computes, with the layer normalization of
+  `tf.keras.layers.LayerNormalization`:
+
+      aggregation = relu(matmul(embedding, aggregation_kernel)
+                         + aggregation_bias)
+      mask = matmul(aggregation, projection_kernel) + projection_bias
+      output = relu(layer_norm(matmul(mask * hidden, output_kernel)))
+
+  where `mask` is relu'ed too if `mask_relu`, as in modelzoo/masknet. The
+  intermediate values are computed by blocks of examples, in cache.
+
+  Args:
+    embedding: A `Tensor` of shape `[B, E]`, the input of the mask.
+    hidden: A `Tensor` of shape `[B, H]`, masked: the embedding in the
+      parallel MaskNet, or the output of the previous block in the serial one.
+    aggregation_kernel: A `Tensor` of shape `[E, R]`.
+    aggregation_bias: A `Tensor` of shape `[R]`.
+    projection_kernel: A `Tensor` of shape `[R, H]`.
+    projection_bias: A `Tensor` of shape `[H]`.
+    output_kernel: A `Tensor` of shape `[H, O]`.
+    gamma: A `Tensor` of shape `[O]`, the scale of the layer normalization.
+    beta: A `Tensor` of shape `[O]`, its offset.
+    mask_relu: Whether to apply a relu to the mask.
+    epsilon: The variance epsilon of the layer normalization.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[B, O]`.
+  """
+  return gen_mask_block_ops.mask_block(
+      embedding, hidden, aggregation_kernel, aggregation_bias,
+      projection_kernel, projection_bias, output_kernel, gamma, beta,
+      mask_relu=mask_relu, epsilon=epsilon, name=name)[0]
+
+@tf_export("nn.concat_matmul")
+def concat_matmul(inputs, kernel, bias=None, relu=False, name=None):
+  """The dense layer of concatenated inputs, e.g. pooled embeddings.
+
+  Computes in one op:
+
+      output = matmul(concat(inputs, axis=1), kernel) + bias
+
+  followed by a relu if `relu`. The product is accumulated over column
+  panels of the inputs, and the gradient is written to each input, so
+  neither the `[B, K]` concatenation nor its gradient are materialized.
+
+  Args:
+    inputs: A list of `Tensor`s of shapes `[B, D_i]`.
+    kernel: A `Tensor` of shape `[K, O]`, with `K = sum(D_i)`.
+    bias: An optional `Tensor` of shape `[O]`.
+    relu: Whether to apply a relu to the output.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of shape `[B, O]`.
+  """
+  return gen_concat_matmul_ops.concat_matmul(
+      inputs, kernel, [bias] if bias is not None else [],
+      activation="Relu" if relu else "None", name=name)
+
+@tf_export("nn.dice")
+def dice(x, gamma, epsilon=1e-9, name=None):
+  """The Dice activation of DIN, in training mode, in one op.
+
+  Computes, with the mean and the variance of `x` over the current batch,
+  i.e. over all dimensions but the last:
+
+      p = sigmoid((x - mean) / (sqrt(variance + epsilon) + epsilon))
+      output = gamma * (1 - p) * x + p * x
+
+  as the `dice` of the DIEN scripts of modelzoo. The statistics and the
+  output are computed in two passes over `x`, and the gradient in two passes
+  over `x` and the gradient of the output.
+
+  Args:
+    x: A `Tensor` of shape `[..., C]`.
+    gamma: A `Tensor` of shape `[C]`, the slope of the negative part.
+    epsilon: A small float added to the variance and to the standard
+      deviation.
+    name: A name for this operation (optional).
+
+  Returns:
+    A `Tensor` of the shape of `x`.
+  """
+  return gen_dice_ops.dice_training(x, gamma, epsilon=epsilon, name=name)[0]
+
 def _count_nonzero(input_tensor, dtype=dtypes.int64):
   """Same as math_ops.count_nonzero.
 
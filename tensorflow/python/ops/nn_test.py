@@ -19,6 +19,7 @@ from __future__ import division
 from __future__ import print_function
 
 import math
+import os
 
 from absl.testing import parameterized
 import numpy as np
@@ -33,16 +34,46 @@ from tensorflow.python.framework import tensor_spec
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import gradient_checker
+from tensorflow.python.ops import gradients_impl
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn_impl
 from tensorflow.python.ops import nn_ops
 from tensorflow.python.ops import partitioned_variables
+from tensorflow.python.ops import rnn
+from tensorflow.python.ops import rnn_cell_impl
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.ops import variables
 from tensorflow.python.ops import gen_fused_l2_normalize_ops
 import tensorflow.python.ops.nn_grad  # pylint: disable=unused-import
 from tensorflow.python.ops.nn_impl import _compute_sampled_logits
 from tensorflow.python.platform import test as test_lib
+from tensorflow.python.util import nest
+
+
+def _random_constants(*shapes):
+  """Returns float32 constants of the given shapes, uniform in [-1, 1)."""
+  return [constant_op.constant(np.random.uniform(-1, 1, s), dtypes.float32)
+          for s in shapes]
+
+
+def _assert_same_outputs_and_grads(test, outputs, unfused_outputs, params,
+                                   atol=1e-5, grad_rtol=1e-6, grad_atol=1e-5):
+  """Checks a fused op against its unfused ops, outputs and gradients.
+
+  `outputs` and `unfused_outputs` are tensors or matching structures of
+  tensors. The gradients are those of the sum of their squares with respect
+  to `params`.
+  """
+  test.assertAllClose(test.evaluate(unfused_outputs), test.evaluate(outputs),
+                      atol=atol)
+  loss = math_ops.add_n(
+      [math_ops.reduce_sum(x * x) for x in nest.flatten(outputs)])
+  unfused_loss = math_ops.add_n(
+      [math_ops.reduce_sum(x * x) for x in nest.flatten(unfused_outputs)])
+  grads = gradients_impl.gradients(loss, params)
+  unfused_grads = gradients_impl.gradients(unfused_loss, params)
+  test.assertAllClose(test.evaluate(unfused_grads), test.evaluate(grads),
+                      rtol=grad_rtol, atol=grad_atol)
 
 
 class ZeroFractionTest(test_lib.TestCase):
@@ -369,6 +400,461 @@ class LayerNormalizeTest(test_lib.TestCase):
     self.assertLess(err, 1e-3)
 
 
+class DinAttentionTest(test_lib.TestCase):
+
+  def _inputs(self):
+    np.random.seed(0)
+    b, t, d, h1, h2 = 3, 5, 4, 6, 3
+    shapes = [[b, d], [b, t, d], [4 * d, h1], [h1], [h1, h2], [h2], [h2, 1],
+              [1]]
+    params = [constant_op.constant(np.random.uniform(-1, 1, s), dtypes.float32)
+              for s in shapes]
+    mask = constant_op.constant([[1, 1, 1, 0, 0], [1, 1, 1, 1, 1],
+                                 [0, 0, 0, 0, 0]], dtypes.bool)
+    return params, mask
+
+  def _unfused(self, query, facts, mask, w1, b1, w2, b2, w3, b3):
+    queries = array_ops.reshape(
+        array_ops.tile(query, [1, array_ops.shape(facts)[1]]),
+        array_ops.shape(facts))
+    din_all = array_ops.concat(
+        [queries, facts, queries - facts, queries * facts], axis=-1)
+    layer_1 = math_ops.sigmoid(math_ops.tensordot(din_all, w1, 1) + b1)
+    layer_2 = math_ops.sigmoid(math_ops.tensordot(layer_1, w2, 1) + b2)
+    scores = array_ops.reshape(math_ops.tensordot(layer_2, w3, 1) + b3,
+                               [-1, 1, array_ops.shape(facts)[1]])
+    paddings = array_ops.ones_like(scores) * (-2**32 + 1)
+    scores = array_ops.where(array_ops.expand_dims(mask, 1), scores, paddings)
+    alphas = nn_ops.softmax(scores)
+    return math_ops.matmul(alphas, facts), alphas
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    params, mask = self._inputs()
+    query, facts, w1, b1, w2, b2, w3, b3 = params
+    fused = nn_impl.din_attention(query, facts, mask, w1, b1, w2, b2, w3, b3)
+    unfused = self._unfused(query, facts, mask, w1, b1, w2, b2, w3, b3)
+    self.assertAllClose(self.evaluate(unfused), self.evaluate(fused))
+
+  @test_util.run_deprecated_v1
+  def testGradientMatchesUnfused(self):
+    params, mask = self._inputs()
+    query, facts, w1, b1, w2, b2, w3, b3 = params
+    output, alphas = nn_impl.din_attention(
+        query, facts, mask, w1, b1, w2, b2, w3, b3)
+    unfused_output, unfused_alphas = self._unfused(
+        query, facts, mask, w1, b1, w2, b2, w3, b3)
+    loss = math_ops.reduce_sum(output * output) + math_ops.reduce_sum(
+        alphas * math_ops.range(5, dtype=dtypes.float32))
+    unfused_loss = math_ops.reduce_sum(
+        unfused_output * unfused_output) + math_ops.reduce_sum(
+            unfused_alphas * math_ops.range(5, dtype=dtypes.float32))
+    grads = gradients_impl.gradients(loss, params)
+    unfused_grads = gradients_impl.gradients(unfused_loss, params)
+    self.assertAllClose(self.evaluate(unfused_grads), self.evaluate(grads),
+                        atol=1e-5)
+
+
+class MultiHeadAttentionTest(test_lib.TestCase):
+
+  def _inputs(self):
+    np.random.seed(0)
+    b, tq, tk, d, dv = 3, 4, 5, 6, 4
+    params = [constant_op.constant(np.random.uniform(-1, 1, s), dtypes.float32)
+              for s in [[b, tq, d], [b, tk, d], [b, tk, dv]]]
+    sequence_length = constant_op.constant([3, 5, 1])
+    return params, sequence_length
+
+  def _unfused(self, query, key, value, sequence_length, head_count, scale):
+    heads = lambda x: array_ops.concat(
+        array_ops.split(x, head_count, axis=-1), axis=0)
+    scores = scale * math_ops.matmul(heads(query), heads(key),
+                                     transpose_b=True)
+    mask = array_ops.sequence_mask(sequence_length, array_ops.shape(key)[1])
+    masks = array_ops.expand_dims(array_ops.tile(mask, [head_count, 1]), 1)
+    scores -= 1.e9 * math_ops.cast(math_ops.logical_not(masks),
+                                   dtype=scores.dtype)
+    output = math_ops.matmul(nn_ops.softmax(scores), heads(value))
+    return array_ops.concat(array_ops.split(output, head_count, axis=0),
+                            axis=-1)
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    (query, key, value), sequence_length = self._inputs()
+    fused = nn_impl.multi_head_attention(
+        query, key, value, 2, sequence_length=sequence_length, scale=0.5)
+    unfused = self._unfused(query, key, value, sequence_length, 2, 0.5)
+    self.assertAllClose(self.evaluate(unfused), self.evaluate(fused))
+
+  @test_util.run_deprecated_v1
+  def testGradientMatchesUnfused(self):
+    params, sequence_length = self._inputs()
+    query, key, value = params
+    output = nn_impl.multi_head_attention(
+        query, key, value, 2, sequence_length=sequence_length)
+    unfused_output = self._unfused(query, key, value, sequence_length, 2, 1.0)
+    grads = gradients_impl.gradients(
+        math_ops.reduce_sum(output * output), params)
+    unfused_grads = gradients_impl.gradients(
+        math_ops.reduce_sum(unfused_output * unfused_output), params)
+    self.assertAllClose(self.evaluate(unfused_grads), self.evaluate(grads),
+                        atol=1e-5)
+
+
+class DotInteractionTest(test_lib.TestCase):
+
+  def _inputs(self):
+    np.random.seed(0)
+    return [constant_op.constant(np.random.uniform(-1, 1, s), dtypes.float32)
+            for s in [[3, 5, 4], [3, 4]]]
+
+  def _unfused(self, features, dense):
+    products = math_ops.matmul(features, features, transpose_b=True)
+    ones = array_ops.ones_like(products)
+    mask = math_ops.cast(ones - array_ops.matrix_band_part(ones, 0, -1),
+                         dtypes.bool)
+    pairs = array_ops.reshape(array_ops.boolean_mask(products, mask), [3, 10])
+    return array_ops.concat([dense, pairs], 1)
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    features, dense = self._inputs()
+    fused = nn_impl.dot_interaction(features, dense=dense)
+    unfused = self._unfused(features, dense)
+    self.assertAllClose(self.evaluate(unfused), self.evaluate(fused))
+    self.assertAllClose(self.evaluate(unfused[:, 4:]),
+                        self.evaluate(nn_impl.dot_interaction(features)))
+
+  @test_util.run_deprecated_v1
+  def testGradientMatchesUnfused(self):
+    params = self._inputs()
+    output = nn_impl.dot_interaction(*params)
+    unfused_output = self._unfused(*params)
+    grads = gradients_impl.gradients(
+        math_ops.reduce_sum(output * output), params)
+    unfused_grads = gradients_impl.gradients(
+        math_ops.reduce_sum(unfused_output * unfused_output), params)
+    self.assertAllClose(self.evaluate(unfused_grads), self.evaluate(grads),
+                        atol=1e-5)
+
+
+class CrossNetworkTest(test_lib.TestCase):
+
+  def _dense(self, x, kernel, bias):
+    return nn_ops.bias_add(math_ops.matmul(x, kernel), bias)
+
+  def _unfused_v2(self, x0, kernels, biases, projection_kernels,
+                  projection_biases, input_residual):
+    x = x0
+    for l, (kernel, bias) in enumerate(zip(kernels, biases)):
+      h = x
+      if projection_kernels:
+        h = self._dense(h, projection_kernels[l], projection_biases[l])
+      x = x0 * self._dense(h, kernel, bias) + (x0 if input_residual else x)
+    return x
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    np.random.seed(0)
+    x0, k0, k1, b0, b1 = _random_constants([3, 5], [5], [5], [5], [5])
+    params = [x0, k0, k1, b0, b1]
+    output = nn_impl.cross_network(x0, [k0, k1], [b0, b1])
+    unfused_output = x0
+    for kernel, bias in [(k0, b0), (k1, b1)]:
+      xw = math_ops.reduce_sum(unfused_output * kernel, axis=1, keepdims=True)
+      unfused_output = x0 * xw + bias + unfused_output
+    _assert_same_outputs_and_grads(self, output, unfused_output, params,
+                                   atol=1e-6)
+
+  @test_util.run_deprecated_v1
+  def testV2MatchesUnfused(self):
+    np.random.seed(0)
+    for low_rank in [False, True]:
+      for input_residual in [False, True]:
+        x0, = _random_constants([3, 5])
+        if low_rank:
+          kernels = _random_constants([2, 5], [2, 5])
+          projection_kernels = _random_constants([5, 2], [5, 2])
+          projection_biases = _random_constants([2], [2])
+        else:
+          kernels = _random_constants([5, 5], [5, 5])
+          projection_kernels, projection_biases = [], []
+        biases = _random_constants([5], [5])
+        args = [x0, kernels, biases, projection_kernels, projection_biases,
+                input_residual]
+        params = ([x0] + kernels + biases + projection_kernels +
+                  projection_biases)
+        output = nn_impl.cross_network_v2(*args)
+        unfused_output = self._unfused_v2(*args)
+        _assert_same_outputs_and_grads(self, output, unfused_output, params,
+                                       atol=1e-6)
+
+
+class GRUSequenceTest(test_lib.TestCase):
+
+  def _unfused_augru(self, x, att_scores, sequence_length, h, gate_kernel,
+                     gate_bias, candidate_kernel, candidate_bias):
+    outputs = []
+    for t in range(x.shape.as_list()[1]):
+      g = math_ops.sigmoid(nn_ops.bias_add(math_ops.matmul(
+          array_ops.concat([x[:, t], h], 1), gate_kernel), gate_bias))
+      r, u = array_ops.split(g, 2, axis=1)
+      c = math_ops.tanh(nn_ops.bias_add(math_ops.matmul(
+          array_ops.concat([x[:, t], r * h], 1), candidate_kernel),
+                                        candidate_bias))
+      u = (1.0 - att_scores[:, t:t + 1]) * u
+      next_h = u * h + (1 - u) * c
+      valid = math_ops.cast(
+          array_ops.expand_dims(t < sequence_length, 1), dtypes.float32)
+      h = valid * next_h + (1 - valid) * h
+      outputs.append(valid * next_h)
+    return array_ops.stack(outputs, axis=1), h
+
+  @test_util.run_deprecated_v1
+  def testMatchesDynamicRNN(self):
+    np.random.seed(0)
+    x, h = _random_constants([4, 5, 3], [4, 2])
+    sequence_length = constant_op.constant([5, 0, 3, 7])
+    cell = rnn_cell_impl.GRUCell(2)
+    unfused_outputs = rnn.dynamic_rnn(cell, x, sequence_length, h)
+    weights = cell.trainable_weights
+    self.evaluate(variables.global_variables_initializer())
+    outputs = nn_impl.gru_sequence(x, *weights,
+                                   sequence_length=sequence_length,
+                                   initial_state=h)
+    _assert_same_outputs_and_grads(self, outputs, unfused_outputs,
+                                   [x, h] + weights)
+
+  @test_util.run_deprecated_v1
+  def testAUGRUMatchesUnfused(self):
+    np.random.seed(0)
+    params = _random_constants([4, 5, 3], [4, 5, 1], [4, 2], [5, 4], [4],
+                               [5, 2], [2])
+    x, att_scores, h = params[:3]
+    att_scores = math_ops.abs(att_scores)
+    sequence_length = constant_op.constant([5, 0, 3, 7])
+    outputs = nn_impl.gru_sequence(x, *params[3:],
+                                   sequence_length=sequence_length,
+                                   initial_state=h, att_scores=att_scores)
+    unfused_outputs = self._unfused_augru(
+        x, array_ops.squeeze(att_scores, 2), sequence_length, h, *params[3:])
+    _assert_same_outputs_and_grads(self, outputs, unfused_outputs, params)
+
+  @test_util.run_deprecated_v1
+  def testDynamicRNNFusedGRU(self):
+    np.random.seed(0)
+    x, = _random_constants([4, 5, 3])
+    sequence_length = constant_op.constant([5, 0, 3, 7])
+    with variable_scope.variable_scope("gru") as scope:
+      unfused_outputs = rnn.dynamic_rnn(
+          rnn_cell_impl.GRUCell(2), x, sequence_length, dtype=dtypes.float32)
+    num_variables = len(variables.global_variables())
+    os.environ["TF_FUSED_GRU"] = "1"
+    try:
+      with variable_scope.variable_scope(scope, reuse=True):
+        outputs = rnn.dynamic_rnn(
+            rnn_cell_impl.GRUCell(2, reuse=True), x, sequence_length,
+            dtype=dtypes.float32)
+    finally:
+      del os.environ["TF_FUSED_GRU"]
+    # The fused GRU reuses the variables of the cell.
+    self.assertEqual(num_variables, len(variables.global_variables()))
+    self.assertEqual("GRUSequence", outputs[0].op.type)
+    self.evaluate(variables.global_variables_initializer())
+    _assert_same_outputs_and_grads(self, outputs, unfused_outputs,
+                                   [x] + variables.trainable_variables())
+
+
+class AnnIndexTest(test_lib.TestCase):
+
+  def _vectors(self, n):
+    vectors = np.random.normal(size=[n, 16]).astype(np.float32)
+    return vectors / np.linalg.norm(vectors, axis=1, keepdims=True)
+
+  @test_util.run_deprecated_v1
+  def testHnswMatchesBruteForce(self):
+    np.random.seed(0)
+    items = self._vectors(500)
+    queries = self._vectors(20)
+    ids = np.arange(100, 600, dtype=np.int64)
+    index = nn_impl.hnsw_index(16, max_neighbors=8, shared_name="items")
+    update = nn_impl.ann_index_update(index, ids, items)
+    self.assertEqual(500, self.evaluate(update))
+    # The items are already indexed.
+    self.assertEqual(0, self.evaluate(update))
+    self.assertEqual(500, self.evaluate(nn_impl.ann_index_size(index)))
+
+    scores, found = self.evaluate(
+        nn_impl.ann_index_search(index, queries, 5, probe=64))
+    exact = ids[np.argsort(-np.dot(queries, items.T), axis=1)[:, :5]]
+    recall = np.mean([len(set(f) & set(e)) / 5. for f, e in zip(found, exact)])
+    self.assertGreaterEqual(recall, 0.95)
+    self.assertAllClose(
+        np.sum(queries[:, None, :] * items[found - 100], axis=2), scores,
+        atol=1e-5)
+
+  @test_util.run_deprecated_v1
+  def testIvfPqDeltaUpdate(self):
+    np.random.seed(0)
+    items = self._vectors(500)
+    ids = np.arange(500, dtype=np.int64)
+    embeddings = variables.Variable(items)
+    index = nn_impl.ivf_pq_index(16, metric="l2", num_lists=8,
+                                 num_subquantizers=4)
+    update = nn_impl.ann_index_update(index, ids, embeddings)
+    self.evaluate(embeddings.initializer)
+    self.assertEqual(500, self.evaluate(update))
+
+    # A delta model load restores 3 changed items.
+    queries = self._vectors(3)
+    self.evaluate(embeddings[:3].assign(queries))
+    self.assertEqual(3, self.evaluate(update))
+    scores, found = self.evaluate(
+        nn_impl.ann_index_search(index, queries, 2, probe=8))
+    self.assertAllEqual([0, 1, 2], found[:, 0])
+    self.assertAllClose([0, 0, 0], scores[:, 0], atol=1e-6)
+    self.assertEqual(500, self.evaluate(nn_impl.ann_index_size(index)))
+
+    # The next delta retires them.
+    self.assertEqual(3, self.evaluate(
+        nn_impl.ann_index_remove(index, [0, 1, 2])))
+    self.assertEqual(497, self.evaluate(nn_impl.ann_index_size(index)))
+    _, found = self.evaluate(
+        nn_impl.ann_index_search(index, queries, 2, probe=8))
+    self.assertFalse(np.any(found < 3))
+
+  @test_util.run_deprecated_v1
+  def testSearchEmptyIndex(self):
+    index = nn_impl.hnsw_index(16)
+    scores, found = self.evaluate(
+        nn_impl.ann_index_search(index, self._vectors(2), 3))
+    self.assertAllEqual(-np.ones([2, 3]), found)
+    self.assertTrue(np.all(np.isneginf(scores)))
+
+  @test_util.run_deprecated_v1
+  def testInvalidDim(self):
+    index = nn_impl.ivf_pq_index(16, num_subquantizers=3)
+    with self.assertRaisesOpError("multiple"):
+      self.evaluate(index)
+
+
+
+class MaskBlockTest(test_lib.TestCase):
+
+  def _params(self, embedding_dim, hidden_dim, output_dim):
+    return _random_constants([embedding_dim, hidden_dim], [hidden_dim],
+                             [hidden_dim, hidden_dim], [hidden_dim],
+                             [hidden_dim, output_dim], [output_dim],
+                             [output_dim])
+
+  def _unfused_mask_block(self, embedding, hidden, aggregation_kernel,
+                          aggregation_bias, projection_kernel,
+                          projection_bias, output_kernel, gamma, beta):
+    aggregation = nn_ops.relu(nn_ops.bias_add(
+        math_ops.matmul(embedding, aggregation_kernel), aggregation_bias))
+    mask = nn_ops.relu(nn_ops.bias_add(
+        math_ops.matmul(aggregation, projection_kernel), projection_bias))
+    y = math_ops.matmul(mask * hidden, output_kernel)
+    mean, variance = nn_impl.moments(y, [1], keep_dims=True)
+    return nn_ops.relu(
+        (y - mean) * math_ops.rsqrt(variance + 1e-3) * gamma + beta)
+
+  @test_util.run_deprecated_v1
+  def testParallelMatchesUnfused(self):
+    np.random.seed(0)
+    embedding, = _random_constants([150, 12])
+    params = self._params(12, 12, 8)
+    output = nn_impl.mask_block(embedding, embedding, *params)
+    unfused_output = self._unfused_mask_block(embedding, embedding, *params)
+    _assert_same_outputs_and_grads(self, output, unfused_output,
+                                   [embedding] + params, grad_rtol=1e-4,
+                                   grad_atol=1e-4)
+
+  @test_util.run_deprecated_v1
+  def testSerialMatchesUnfused(self):
+    np.random.seed(0)
+    embedding, = _random_constants([150, 12])
+    params = [self._params(12, 12, 8), self._params(12, 8, 8)]
+    output = embedding
+    unfused_output = embedding
+    for block_params in params:
+      output = nn_impl.mask_block(embedding, output, *block_params)
+      unfused_output = self._unfused_mask_block(embedding, unfused_output,
+                                                *block_params)
+    _assert_same_outputs_and_grads(self, output, unfused_output,
+                                   [embedding] + params[0] + params[1],
+                                   grad_rtol=1e-4, grad_atol=1e-4)
+
+
+class ConcatMatMulTest(test_lib.TestCase):
+
+  def _assertMatchesUnfused(self, dims, with_bias, relu):
+    np.random.seed(0)
+    inputs = [constant_op.constant(np.random.uniform(-1, 1, [70, d]),
+                                   dtypes.float32) for d in dims]
+    kernel = constant_op.constant(
+        np.random.uniform(-1, 1, [sum(dims), 9]), dtypes.float32)
+    bias = constant_op.constant(np.random.uniform(-1, 1, [9]),
+                                dtypes.float32) if with_bias else None
+    output = nn_impl.concat_matmul(inputs, kernel, bias=bias, relu=relu)
+    unfused_output = math_ops.matmul(array_ops.concat(inputs, 1), kernel)
+    if with_bias:
+      unfused_output = nn_ops.bias_add(unfused_output, bias)
+    if relu:
+      unfused_output = nn_ops.relu(unfused_output)
+    self.assertAllClose(self.evaluate(unfused_output), self.evaluate(output),
+                        atol=1e-5)
+
+    params = inputs + [kernel] + ([bias] if with_bias else [])
+    grads = gradients_impl.gradients(math_ops.reduce_sum(output * output),
+                                     params)
+    unfused_grads = gradients_impl.gradients(
+        math_ops.reduce_sum(unfused_output * unfused_output), params)
+    self.assertAllClose(self.evaluate(unfused_grads), self.evaluate(grads),
+                        rtol=1e-4, atol=1e-4)
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    self._assertMatchesUnfused([16, 8, 3], with_bias=False, relu=False)
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfusedWithBiasAndRelu(self):
+    self._assertMatchesUnfused([200, 16, 150], with_bias=True, relu=True)
+
+class DiceTest(test_lib.TestCase):
+
+  def _assertMatchesUnfused(self, shape):
+    np.random.seed(0)
+    x = constant_op.constant(np.random.normal(3, 2, shape), dtypes.float32)
+    gamma = constant_op.constant(np.random.uniform(-0.5, 0.5, shape[-1:]),
+                                 dtypes.float32)
+    epsilon = 1e-9
+    output = nn_impl.dice(x, gamma, epsilon=epsilon)
+    # The dice of the DIEN scripts of modelzoo.
+    axes = list(range(len(shape) - 1))
+    mean = math_ops.reduce_mean(x, axis=axes)
+    std = math_ops.sqrt(math_ops.reduce_mean(
+        math_ops.square(x - mean) + epsilon, axis=axes))
+    p = math_ops.sigmoid((x - mean) / (std + epsilon))
+    unfused_output = gamma * (1.0 - p) * x + p * x
+    self.assertAllClose(self.evaluate(unfused_output), self.evaluate(output),
+                        rtol=1e-5, atol=1e-5)
+
+    grad = constant_op.constant(np.random.uniform(-1, 1, shape),
+                                dtypes.float32)
+    grads = gradients_impl.gradients(output, [x, gamma], grad)
+    unfused_grads = gradients_impl.gradients(unfused_output, [x, gamma], grad)
+    self.assertAllClose(self.evaluate(unfused_grads), self.evaluate(grads),
+                        rtol=1e-4, atol=1e-4)
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused(self):
+    self._assertMatchesUnfused([300, 37])
+
+  @test_util.run_deprecated_v1
+  def testMatchesUnfused3D(self):
+    self._assertMatchesUnfused([4, 5, 16])
+
 class DropoutTest(test_lib.TestCase):
 
   def testDropout(self):
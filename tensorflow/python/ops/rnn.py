@@ -17,6 +17,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import os
+
 from tensorflow.python.eager import context
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
@@ -27,6 +29,7 @@ from tensorflow.python.keras.engine import base_layer
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import control_flow_util
+from tensorflow.python.ops import gen_gru_sequence_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import rnn_cell_impl
 from tensorflow.python.ops import tensor_array_ops
@@ -142,6 +145,47 @@ def _should_cache():
   return control_flow_util.GetContainingWhileContext(ctxt) is None
 
 
+def _use_fused_gru(cell, flat_input, state):
+  """Returns True if `dynamic_rnn` can run `cell` as one GRUSequence op.
+
+  Opt-in with TF_FUSED_GRU=1, for a plain `GRUCell` over a float32 input.
+  GRUSequence only has a CPU kernel.
+  """
+  if os.environ.get("TF_FUSED_GRU", "0") != "1":
+    return False
+  if context.executing_eagerly():
+    return False
+  # Subclasses may override call().
+  if type(cell) is not rnn_cell_impl.GRUCell:  # pylint: disable=unidiomatic-typecheck
+    return False
+  # pylint: disable=protected-access
+  if cell._activation is not math_ops.tanh or cell._keras_style:
+    return False
+  # pylint: enable=protected-access
+  if len(flat_input) != 1 or not isinstance(state, ops.Tensor):
+    return False
+  x = flat_input[0]
+  return (x.dtype == dtypes.float32 and state.dtype == dtypes.float32 and
+          x.shape.rank == 3 and
+          tensor_shape.dimension_value(x.shape[-1]) is not None)
+
+
+def _fused_gru(cell, inputs, state, sequence_length):
+  """Runs the `GRUCell` over the batch-major `inputs` with GRUSequence."""
+  if not cell.built:
+    # As the first call of the cell would, in the same variable scope.
+    cell.build(inputs.shape)
+  if sequence_length is None:
+    shape = array_ops.shape(inputs)
+    sequence_length = array_ops.fill(shape[:1], shape[1])
+  # pylint: disable=protected-access
+  outputs, final_state, _, _ = gen_gru_sequence_ops.gru_sequence(
+      inputs, sequence_length, state, cell._gate_kernel, cell._gate_bias,
+      cell._candidate_kernel, cell._candidate_bias)
+  # pylint: enable=protected-access
+  return outputs, final_state
+
+
 def _is_keras_rnn_cell(rnn_cell):
   """Check whether the cell is a Keras RNN cell.
 
@@ -563,6 +607,9 @@ def dynamic_rnn(cell,
                                      dtype=tf.float32)
   ```
 
+  With the environment variable TF_FUSED_GRU=1, a `GRUCell` over a float32
+  `Tensor` runs as one `tf.nn.gru_sequence` op instead of the while loop,
+  with the same variables.
 
   Args:
     cell: An instance of RNNCell.
@@ -695,6 +742,14 @@ def dynamic_rnn(cell,
         sequence_length = array_ops.identity(
             sequence_length, name="CheckSeqLen")
 
+    if _use_fused_gru(cell, flat_input, state):
+      if not time_major:
+        return _fused_gru(cell, ops.convert_to_tensor(nest.flatten(inputs)[0]),
+                          state, sequence_length)
+      outputs, final_state = _fused_gru(
+          cell, _transpose_batch_time(flat_input[0]), state, sequence_length)
+      return (_transpose_batch_time(outputs), final_state)
+
     inputs = nest.pack_sequence_as(structure=inputs, flat_sequence=flat_input)
 
     (outputs, final_state) = _dynamic_rnn_loop(